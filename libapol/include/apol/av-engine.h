@@ -0,0 +1,167 @@
+/**
+ * @file
+ *
+ * An offline equivalent of the kernel's security_compute_av().  An
+ * engine answers, for a source context, a target context, and an
+ * object class, which permissions the policy allows, audits, and
+ * does not audit.  The answer combines the policy's access vector
+ * rules with its current boolean state and its constraints.  As in
+ * the kernel, a process transition or dyntransition between two
+ * roles needs a role allow rule, and a type bounded by another is
+ * allowed no more than its bounding type.  Unlike the kernel, the
+ * bounding type's permissions come from its rules alone; constraints
+ * are not evaluated for it.
+ *
+ * When an engine is created it copies the policy's allow, auditallow,
+ * and dontaudit rules into a table keyed by (source type, target
+ * type, class).  It also records the attributes of every type, so
+ * that a rule on an attribute is found the way the kernel finds it.
+ * Constraints are compiled by an apol_constraint_eval_t, which also
+ * holds the contexts and numbers the permissions.  Answers may be
+ * kept in a fixed-size cache, much like the kernel's access vector
+ * cache.
+ *
+ * Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef APOL_AV_ENGINE_H
+#define APOL_AV_ENGINE_H
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#include "policy.h"
+#include "constraint-eval.h"
+#include <stddef.h>
+#include <stdint.h>
+
+	typedef struct apol_av_engine apol_av_engine_t;
+
+/**
+ * The answer to one access vector computation.  Permissions are
+ * numbered as by apol_constraint_eval_get_perm().
+ */
+	typedef struct apol_av_decision
+	{
+		/** permissions allowed by the policy's allow rules and not
+		 *  denied by its constraints */
+		uint32_t allowed;
+		/** permissions that would be audited if granted */
+		uint32_t auditallow;
+		/** permissions that would be audited if denied; those
+		 *  not named by a dontaudit rule */
+		uint32_t auditdeny;
+		/** permissions allowed by allow rules but denied by a
+		 *  constraint */
+		uint32_t constrained;
+	} apol_av_decision_t;
+
+/**
+ * Build an engine from a policy.  The policy must have its rules
+ * loaded, and must be neither modified nor destroyed while the engine
+ * is in use.  An engine must not be used by more than one thread at
+ * a time.
+ *
+ * @param p Policy whose rules and constraints to use.
+ * @param cache_size Number of answers to keep.  The number is rounded
+ * up to a power of two; 0 disables the cache.
+ *
+ * @return An allocated engine, or NULL upon error.  The caller must
+ * call apol_av_engine_destroy() afterwards.
+ */
+	extern apol_av_engine_t *apol_av_engine_create(const apol_policy_t * p, size_t cache_size);
+
+/**
+ * Deallocate all space associated with an engine, including its
+ * constraint evaluator.
+ *
+ * @param e Reference to the engine to destroy.  The pointer will be
+ * set to NULL afterwards.
+ */
+	extern void apol_av_engine_destroy(apol_av_engine_t ** e);
+
+/**
+ * Get the constraint evaluator used by an engine.  Add contexts to
+ * it with apol_constraint_eval_append_context(), and look up classes
+ * and permissions with apol_constraint_eval_get_perm().
+ *
+ * @param e Engine to query.
+ *
+ * @return The engine's evaluator, or NULL upon error.  The caller
+ * must not destroy the evaluator.
+ */
+	extern apol_constraint_eval_t *apol_av_engine_get_constraint_eval(const apol_av_engine_t * e);
+
+/**
+ * Compute the access vector of a source context, a target context,
+ * and an object class.
+ *
+ * @param e Engine with which to compute.
+ * @param scontext Index of the source context within the engine's
+ * constraint evaluator.
+ * @param tcontext Index of the target context.
+ * @param class_index Index of the object class.
+ * @param avd Decision to fill.
+ *
+ * @return 0 on success, < 0 on error (including if an index is out of
+ * range).
+ */
+	extern int apol_av_engine_compute(apol_av_engine_t * e, size_t scontext, size_t tcontext, size_t class_index,
+					  apol_av_decision_t * avd);
+
+/**
+ * Compute the access vectors of many requests.  The perms member of
+ * each request is ignored.
+ *
+ * @param e Engine with which to compute.
+ * @param requests Array of requests.
+ * @param num_requests Number of requests within the array.
+ * @param avds Array of at least num_requests decisions to fill.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int apol_av_engine_compute_batch(apol_av_engine_t * e, const apol_constraint_eval_request_t * requests,
+						size_t num_requests, apol_av_decision_t * avds);
+
+/**
+ * Reread the state of each of the policy's conditional expressions,
+ * after its booleans have been changed and qpol_policy_reevaluate_conds()
+ * has been called, and empty the cache.
+ *
+ * @param e Engine to refresh.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int apol_av_engine_refresh_conds(apol_av_engine_t * e);
+
+/**
+ * Get the number of computations answered from and added to the
+ * cache since the engine was created.
+ *
+ * @param e Engine to query.
+ * @param hits Reference to the number of answers found in the cache.
+ * @param misses Reference to the number of answers computed.
+ */
+	extern void apol_av_engine_get_cache_stats(const apol_av_engine_t * e, size_t * hits, size_t * misses);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,103 @@
+/**
+ * @file
+ *
+ * Routines to build a lookup table of a policy's access vector rules,
+ * for when many (source, target, class) lookups are to be performed
+ * against the same policy.  Unlike apol_avrule_get_by_query(), which
+ * scans every rule within the policy for each query, the index scans
+ * the rules once and thereafter answers each lookup with a binary
+ * search per pair of candidate types.
+ *
+ * Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef APOL_AVRULE_INDEX_H
+#define APOL_AVRULE_INDEX_H
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#include "policy.h"
+#include "vector.h"
+#include <qpol/policy.h>
+
+	typedef struct apol_avrule_index apol_avrule_index_t;
+
+/**
+ * Build an index of the access vector rules within a policy.  The
+ * index holds pointers to the policy's rules; the policy must not be
+ * destroyed while the index is in use.
+ *
+ * @param p Policy whose rules to index.
+ * @param rule_type Bit-wise or'ed set of QPOL_RULE_ALLOW,
+ * QPOL_RULE_NEVERALLOW, QPOL_RULE_AUDITALLOW, and QPOL_RULE_DONTAUDIT
+ * specifying which rules to index.
+ *
+ * @return An allocated index, or NULL upon error.  The caller must
+ * call apol_avrule_index_destroy() afterwards.
+ */
+	extern apol_avrule_index_t *apol_avrule_index_create(const apol_policy_t * p, uint32_t rule_type);
+
+/**
+ * Deallocate all space associated with an index.  This does not
+ * affect the indexed policy.
+ *
+ * @param idx Reference to the index to destroy.  The pointer will be
+ * set to NULL afterwards.
+ */
+	extern void apol_avrule_index_destroy(apol_avrule_index_t ** idx);
+
+/**
+ * Return the number of rules within an index.
+ *
+ * @param idx Index to query.
+ *
+ * @return Number of indexed rules.
+ */
+	extern size_t apol_avrule_index_get_size(const apol_avrule_index_t * idx);
+
+/**
+ * Find all indexed rules that apply to a particular source type,
+ * target type, and object class.  A rule applies if its source is
+ * the given source type or an attribute containing it, and likewise
+ * for its target.  If a permission is given then only rules that
+ * include that permission are returned.  Both enabled and disabled
+ * conditional rules are returned; use qpol_avrule_get_is_enabled()
+ * to distinguish them.
+ *
+ * @param idx Index to search.
+ * @param source Source type or attribute.
+ * @param target Target type or attribute, or NULL to find rules with
+ * any target.
+ * @param obj_class Object class, or NULL to find rules of any class.
+ * @param perm If non-NULL, only find rules with this permission.
+ * @param v Vector to which append matching qpol_avrule_t pointers.
+ * Each rule will be appended at most once.
+ *
+ * @return 0 on success (including no matches), < 0 on error.
+ */
+	extern int apol_avrule_index_get_rules(const apol_avrule_index_t * idx, const qpol_type_t * source,
+					       const qpol_type_t * target, const qpol_class_t * obj_class, const char *perm,
+					       apol_vector_t * v);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
@@ -35,9 +35,24 @@ extern "C"
 #include "policy.h"
 #include "vector.h"
 #include <qpol/policy.h>
+#include <stdio.h>
 
 	typedef struct apol_avrule_query apol_avrule_query_t;
 
+/**
+ * Function invoked by apol_avrule_foreach_by_query() for each
+ * matching rule, as soon as it has been found.
+ *
+ * @param arg Arbitrary argument given to
+ * apol_avrule_foreach_by_query().
+ * @param p Policy being searched.
+ * @param rule Rule that matched the query.
+ *
+ * @return 0 to continue searching, > 0 to stop searching, or < 0 on
+ * error.
+ */
+	typedef int (*apol_avrule_fn_t) (void *arg, const apol_policy_t * p, const qpol_avrule_t * rule);
+
 /**
  * Execute a query against all access vector rules within the policy.
  *
@@ -53,6 +68,101 @@ extern "C"
  */
 	extern int apol_avrule_get_by_query(const apol_policy_t * p, const apol_avrule_query_t * a, apol_vector_t ** v);
 
+/**
+ * Execute a query against all access vector rules within the policy,
+ * passing each matching rule to a function as it is found rather
+ * than collecting them into a vector.  Rules are visited in the same
+ * order as apol_avrule_get_by_query() would return them.
+ *
+ * @param p Policy within which to look up avrules.
+ * @param a Structure containing parameters for query.	If this is
+ * NULL then visit all avrules.
+ * @param fn Function to invoke for each matching rule.
+ * @param arg Arbitrary argument to pass to fn.
+ *
+ * @return 0 once every matching rule has been visited, the positive
+ * value returned by fn if it stopped the search early, or negative on
+ * error (including if fn returned < 0).
+ */
+	extern int apol_avrule_foreach_by_query(const apol_policy_t * p, const apol_avrule_query_t * a, apol_avrule_fn_t fn,
+						void *arg);
+
+	typedef struct apol_avrule_batch apol_avrule_batch_t;
+
+/**
+ * Function invoked by apol_avrule_batch_run() for each rule that
+ * matches a query within the batch.  A rule that matches several
+ * queries is passed once for each of them.
+ *
+ * @param arg Arbitrary argument given to apol_avrule_batch_run().
+ * @param p Policy being searched.
+ * @param query_id Index of the matching query within the batch.
+ * @param rule Rule that matched the query.
+ *
+ * @return 0 to continue searching, > 0 to stop searching, or < 0 on
+ * error.
+ */
+	typedef int (*apol_avrule_batch_fn_t) (void *arg, const apol_policy_t * p, size_t query_id, const qpol_avrule_t * rule);
+
+/**
+ * Allocate an empty batch of access vector rule queries.  A batch runs
+ * any number of queries in a single pass over the policy's rules.
+ * Queries that name the same source, target, or default symbol share
+ * one candidate type list.  The policy must not be destroyed while
+ * the batch is in use.
+ *
+ * @param p Policy against which to run queries.
+ *
+ * @return An allocated batch, or NULL upon error.  The caller must
+ * call apol_avrule_batch_destroy() afterwards.
+ */
+	extern apol_avrule_batch_t *apol_avrule_batch_create(const apol_policy_t * p);
+
+/**
+ * Deallocate all space associated with a batch.
+ *
+ * @param b Reference to the batch to destroy.  The pointer will be
+ * set to NULL afterwards.
+ */
+	extern void apol_avrule_batch_destroy(apol_avrule_batch_t ** b);
+
+/**
+ * Add a query to the end of a batch.  The query's symbols are looked
+ * up immediately; the batch does not keep a reference to the query.
+ *
+ * @param b Batch to which to add.
+ * @param a Query to add.  If NULL then the query matches all rules.
+ *
+ * @return 0 on success, < 0 on error.  On success the query's
+ * identifier is one less than the batch's new size.
+ */
+	extern int apol_avrule_batch_append(apol_avrule_batch_t * b, const apol_avrule_query_t * a);
+
+/**
+ * Return the number of queries within a batch.
+ *
+ * @param b Batch to query.
+ *
+ * @return Number of queries.
+ */
+	extern size_t apol_avrule_batch_get_size(const apol_avrule_batch_t * b);
+
+/**
+ * Run every query within a batch, with a single pass over the
+ * policy's rules.  For each query, rules are passed to fn in the same
+ * order as apol_avrule_foreach_by_query() would visit them; matches
+ * for different queries are interleaved.
+ *
+ * @param b Batch to run.
+ * @param fn Function to invoke for each match.
+ * @param arg Arbitrary argument to pass to fn.
+ *
+ * @return 0 once every match has been visited, the positive value
+ * returned by fn if it stopped the search early, or negative on error
+ * (including if fn returned < 0).
+ */
+	extern int apol_avrule_batch_run(apol_avrule_batch_t * b, apol_avrule_batch_fn_t fn, void *arg);
+
 /**
  * Execute a query against all syntactic access vector rules within
  * the policy.  If the policy has line numbers, then the returned list
@@ -354,6 +464,20 @@ extern "C"
  */
 	extern char *apol_avrule_render(const apol_policy_t * policy, const qpol_avrule_t * rule);
 
+/**
+ *  Render an avrule directly to a stream, without allocating a
+ *  string.  The output is the same as apol_avrule_render(), without
+ *  a trailing newline.
+ *
+ *  @param policy Policy handler, to report errors.
+ *  @param rule The rule to render.
+ *  @param fp Stream to which to write.
+ *
+ *  @return 0 on success, < 0 on failure; if the call fails, errno
+ *  will be set.
+ */
+	extern int apol_avrule_render_file(const apol_policy_t * policy, const qpol_avrule_t * rule, FILE * fp);
+
 /**
  *  Render a syntactic avrule to a string.
  *
@@ -0,0 +1,159 @@
+/**
+ * @file
+ *
+ * Routines to ask which conditional rules would change state if a
+ * policy's booleans were set differently, without changing the
+ * policy itself.  An index records, for each boolean, the
+ * conditional expressions that depend upon it, and for each
+ * expression a compiled form and the rules within its true and false
+ * lists.  A what-if query then evaluates only those expressions that
+ * depend upon a changed boolean.  The index is not modified by a
+ * query, so any number of queries may run at once.
+ *
+ * Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef APOL_COND_WHATIF_H
+#define APOL_COND_WHATIF_H
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#include "policy.h"
+#include "vector.h"
+#include <qpol/policy.h>
+#include <stddef.h>
+
+	typedef struct apol_cond_index apol_cond_index_t;
+
+/**
+ * The rules whose state would change under a boolean assignment.
+ * The vectors hold pointers to rules owned by the policy.
+ */
+	typedef struct apol_cond_delta
+	{
+		/** av rules (qpol_avrule_t *) that would become enabled */
+		apol_vector_t *avrules_enabled;
+		/** av rules that would become disabled */
+		apol_vector_t *avrules_disabled;
+		/** te rules (qpol_terule_t *) that would become enabled */
+		apol_vector_t *terules_enabled;
+		/** te rules that would become disabled */
+		apol_vector_t *terules_disabled;
+	} apol_cond_delta_t;
+
+/**
+ * Build the conditional index of a policy.  The booleans' current
+ * states become the index's baseline, against which what-if queries
+ * are compared.  The policy must have its rules loaded, and must be
+ * neither modified nor destroyed while the index is in use.
+ *
+ * @param p Policy whose conditionals to index.
+ *
+ * @return An allocated index, or NULL upon error.  The caller must
+ * call apol_cond_index_destroy() afterwards.
+ */
+	extern apol_cond_index_t *apol_cond_index_create(const apol_policy_t * p);
+
+/**
+ * Deallocate all space associated with an index.
+ *
+ * @param idx Reference to the index to destroy.  The pointer will be
+ * set to NULL afterwards.
+ */
+	extern void apol_cond_index_destroy(apol_cond_index_t ** idx);
+
+/**
+ * Return the number of entries within a boolean assignment vector,
+ * which is the largest boolean value within the policy.
+ *
+ * @param idx Index to query.
+ *
+ * @return Number of booleans, or 0 upon error.
+ */
+	extern size_t apol_cond_index_get_num_bools(const apol_cond_index_t * idx);
+
+/**
+ * Find the position of a boolean within an assignment vector.
+ *
+ * @param idx Index to query.
+ * @param name Name of the boolean.
+ * @param i Reference to the boolean's position.
+ *
+ * @return 0 on success, < 0 on error (including if the boolean does
+ * not exist).
+ */
+	extern int apol_cond_index_get_bool_index(const apol_cond_index_t * idx, const char *name, size_t * i);
+
+/**
+ * Copy the baseline assignment, the booleans' states when the index
+ * was built, into an assignment vector.
+ *
+ * @param idx Index to query.
+ * @param states Array of apol_cond_index_get_num_bools() entries, each
+ * set to 1 if that boolean was true and 0 if false.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int apol_cond_index_get_baseline(const apol_cond_index_t * idx, unsigned char *states);
+
+/**
+ * Find the rules whose state would differ from the baseline under a
+ * boolean assignment.  The policy is not changed.
+ *
+ * @param idx Index to query.
+ * @param states Array of apol_cond_index_get_num_bools() entries, the
+ * state of each boolean; non-zero means true.
+ *
+ * @return An allocated delta, or NULL upon error.  The caller must
+ * call apol_cond_delta_destroy() afterwards.
+ */
+	extern apol_cond_delta_t *apol_cond_index_whatif(const apol_cond_index_t * idx, const unsigned char *states);
+
+/**
+ * Find the deltas of many boolean assignments.  The assignments are
+ * divided among as many threads as there are processors.
+ *
+ * @param idx Index to query.
+ * @param states Array of num_assignments assignments, one after
+ * another, each of apol_cond_index_get_num_bools() entries.
+ * @param num_assignments Number of assignments.
+ * @param deltas Array of num_assignments entries.  Upon success each
+ * is an allocated delta, which the caller must destroy with
+ * apol_cond_delta_destroy(); upon error each is NULL.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int apol_cond_index_whatif_batch(const apol_cond_index_t * idx, const unsigned char *states, size_t num_assignments,
+						apol_cond_delta_t ** deltas);
+
+/**
+ * Deallocate all space associated with a delta, but not the rules
+ * within it.
+ *
+ * @param delta Reference to the delta to destroy.  The pointer will
+ * be set to NULL afterwards.
+ */
+	extern void apol_cond_delta_destroy(apol_cond_delta_t ** delta);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
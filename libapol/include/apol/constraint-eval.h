@@ -0,0 +1,177 @@
+/**
+ * @file
+ *
+ * Routines to evaluate a policy's constraints and validatetrans
+ * statements against concrete security contexts.  When an evaluator
+ * is created, every constrain, mlsconstrain, validatetrans, and
+ * mlsvalidatetrans expression within the policy is compiled into a
+ * short program over user, role, and type values and MLS category
+ * bitmaps.  Contexts are resolved once, as they are added to the
+ * evaluator.  Each evaluation then runs those programs without any
+ * name lookups, iterators, or allocations, so that very many
+ * (source context, target context, class, permission) requests may be
+ * checked, such as when deciding which denials within an audit log
+ * were caused by a constraint rather than by a missing allow rule.
+ *
+ * Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef APOL_CONSTRAINT_EVAL_H
+#define APOL_CONSTRAINT_EVAL_H
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#include "policy.h"
+#include "context-query.h"
+#include <stddef.h>
+#include <stdint.h>
+
+	typedef struct apol_constraint_eval apol_constraint_eval_t;
+
+/**
+ * A single request to check against a policy's constraints.  Each
+ * class's permissions are numbered by the evaluator; use
+ * apol_constraint_eval_get_perm() to find the class index and the
+ * bit of a permission.
+ */
+	typedef struct apol_constraint_eval_request
+	{
+		/** index of the source context, as returned by
+		 *  apol_constraint_eval_append_context() */
+		size_t scontext;
+		/** index of the target context */
+		size_t tcontext;
+		/** index of the object class */
+		size_t class_index;
+		/** bitwise-or of the permissions requested */
+		uint32_t perms;
+	} apol_constraint_eval_request_t;
+
+/**
+ * Compile every constraint and validatetrans statement within a
+ * policy.  The policy must not be destroyed while the evaluator is in
+ * use.
+ *
+ * Type names within an expression are expanded as they are compiled:
+ * an attribute stands for its member types, and a subtracted type is
+ * removed from the set.  Wildcard and complemented type sets within
+ * source policies are not recorded by the policy, and are therefore
+ * evaluated as if they had been written as plain sets.
+ *
+ * @param p Policy whose constraints to compile.
+ *
+ * @return An allocated evaluator, or NULL upon error.  The caller
+ * must call apol_constraint_eval_destroy() afterwards.
+ */
+	extern apol_constraint_eval_t *apol_constraint_eval_create(const apol_policy_t * p);
+
+/**
+ * Deallocate all space associated with an evaluator, including its
+ * contexts.
+ *
+ * @param e Reference to the evaluator to destroy.  The pointer will
+ * be set to NULL afterwards.
+ */
+	extern void apol_constraint_eval_destroy(apol_constraint_eval_t ** e);
+
+/**
+ * Resolve a context and add it to the end of an evaluator's contexts.
+ * The evaluator does not keep a reference to the context.  The new
+ * context's index is one less than apol_constraint_eval_get_num_contexts()
+ * afterwards.
+ *
+ * @param e Evaluator to which to add the context.
+ * @param context Context to add.  It must have a user, role, and
+ * type; if the policy is MLS then it must also have a range, which
+ * must not be literal (see apol_context_convert()).
+ *
+ * @return 0 on success, < 0 on error (including if a name is not
+ * within the policy).
+ */
+	extern int apol_constraint_eval_append_context(apol_constraint_eval_t * e, const apol_context_t * context);
+
+/**
+ * Return the number of contexts within an evaluator.
+ *
+ * @param e Evaluator to query.
+ *
+ * @return Number of contexts, or 0 upon error.
+ */
+	extern size_t apol_constraint_eval_get_num_contexts(const apol_constraint_eval_t * e);
+
+/**
+ * Look up the index of a class, and optionally the bit of one of its
+ * permissions, for use within an apol_constraint_eval_request_t.
+ *
+ * @param e Evaluator to query.
+ * @param class_name Name of the object class.
+ * @param perm_name Name of a permission of the class, either its own
+ * or one inherited from its common, or NULL to only look up the
+ * class.
+ * @param class_index Reference to the class's index.
+ * @param perm Reference to the permission's bit, or NULL if
+ * perm_name is NULL.  The bit is 0 if perm_name is NULL.
+ *
+ * @return 0 on success, < 0 on error (including if the class or
+ * permission does not exist).
+ */
+	extern int apol_constraint_eval_get_perm(const apol_constraint_eval_t * e, const char *class_name, const char *perm_name,
+						 size_t * class_index, uint32_t * perm);
+
+/**
+ * Check many requests against the policy's constraints.  A request's
+ * permission is denied if any constraint on its class that names the
+ * permission evaluates to false.
+ *
+ * @param e Evaluator whose constraints to use.
+ * @param requests Array of requests to check.
+ * @param num_requests Number of requests within the array.
+ * @param denied Array of at least num_requests entries.  Upon
+ * success, denied[i] is the subset of requests[i].perms that the
+ * constraints deny; it is 0 if the constraints allow all of them.
+ *
+ * @return 0 on success, < 0 on error (including if an index is out of
+ * range).
+ */
+	extern int apol_constraint_eval_check(const apol_constraint_eval_t * e, const apol_constraint_eval_request_t * requests,
+					      size_t num_requests, uint32_t * denied);
+
+/**
+ * Check a transition of an object's context against the policy's
+ * validatetrans statements for the object's class.
+ *
+ * @param e Evaluator whose validatetrans statements to use.
+ * @param oldcontext Index of the object's old context.
+ * @param newcontext Index of the object's new context.
+ * @param taskcontext Index of the context of the process performing
+ * the transition.
+ * @param class_index Index of the object's class.
+ *
+ * @return 1 if every statement allows the transition, 0 if one
+ * denies it, or < 0 on error.
+ */
+	extern int apol_constraint_eval_validatetrans(const apol_constraint_eval_t * e, size_t oldcontext, size_t newcontext,
+						      size_t taskcontext, size_t class_index);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
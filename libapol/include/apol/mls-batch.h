@@ -0,0 +1,207 @@
+/**
+ * @file
+ *
+ * Routines to compare many MLS levels and ranges at once.  Levels and
+ * ranges are resolved against a policy when they are added to a
+ * batch, and stored as sensitivity values plus fixed-width category
+ * bitmaps.  Each comparison is then a handful of word-wise bit
+ * operations with no name lookups or allocations, instead of the
+ * per-call resolution done by apol_mls_level_compare() and
+ * apol_mls_range_contain_subrange().
+ *
+ * Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef APOL_MLS_BATCH_H
+#define APOL_MLS_BATCH_H
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#include "policy.h"
+#include "mls_level.h"
+#include "mls_range.h"
+#include <stddef.h>
+
+	typedef struct apol_mls_level_batch apol_mls_level_batch_t;
+	typedef struct apol_mls_range_batch apol_mls_range_batch_t;
+
+/**
+ * A pair of indices into two batches, naming which elements to
+ * compare.  The same element may appear within any number of pairs.
+ */
+	typedef struct apol_mls_batch_pair
+	{
+		/** index into the first batch */
+		size_t first;
+		/** index into the second batch */
+		size_t second;
+	} apol_mls_batch_pair_t;
+
+/**
+ * Allocate an empty batch of levels.  Only batches created from the
+ * same policy may be compared against each other.  The policy must
+ * not be destroyed while the batch is in use.
+ *
+ * @param p Policy against which to resolve levels.
+ *
+ * @return An allocated batch, or NULL upon error.  The caller must
+ * call apol_mls_level_batch_destroy() afterwards.
+ */
+	extern apol_mls_level_batch_t *apol_mls_level_batch_create(const apol_policy_t * p);
+
+/**
+ * Deallocate all space associated with a batch of levels.
+ *
+ * @param batch Reference to the batch to destroy.  The pointer will
+ * be set to NULL afterwards.
+ */
+	extern void apol_mls_level_batch_destroy(apol_mls_level_batch_t ** batch);
+
+/**
+ * Resolve a level and add it to the end of a batch.  The batch does
+ * not keep a reference to the level.
+ *
+ * @param batch Batch to which to add.
+ * @param level Level to add.  It must not be literal; use
+ * apol_mls_level_convert() first if needed.
+ *
+ * @return 0 on success, < 0 on error (including if the level's
+ * sensitivity or a category is not within the policy).  On success
+ * the level's index is one less than the batch's new size.
+ */
+	extern int apol_mls_level_batch_append(apol_mls_level_batch_t * batch, const apol_mls_level_t * level);
+
+/**
+ * Return the number of levels within a batch.
+ *
+ * @param batch Batch to query.
+ *
+ * @return Number of levels.
+ */
+	extern size_t apol_mls_level_batch_get_size(const apol_mls_level_batch_t * batch);
+
+/**
+ * Allocate an empty batch of ranges.  Only batches created from the
+ * same policy may be compared against each other.  The policy must
+ * not be destroyed while the batch is in use.
+ *
+ * @param p Policy against which to resolve ranges.
+ *
+ * @return An allocated batch, or NULL upon error.  The caller must
+ * call apol_mls_range_batch_destroy() afterwards.
+ */
+	extern apol_mls_range_batch_t *apol_mls_range_batch_create(const apol_policy_t * p);
+
+/**
+ * Deallocate all space associated with a batch of ranges.
+ *
+ * @param batch Reference to the batch to destroy.  The pointer will
+ * be set to NULL afterwards.
+ */
+	extern void apol_mls_range_batch_destroy(apol_mls_range_batch_t ** batch);
+
+/**
+ * Resolve a range and add it to the end of a batch.  The batch does
+ * not keep a reference to the range.
+ *
+ * @param batch Batch to which to add.
+ * @param range Range to add.  It must be valid according to
+ * apol_mls_range_validate().
+ *
+ * @return 0 on success, < 0 on error.  On success the range's index
+ * is one less than the batch's new size.
+ */
+	extern int apol_mls_range_batch_append(apol_mls_range_batch_t * batch, const apol_mls_range_t * range);
+
+/**
+ * Return the number of ranges within a batch.
+ *
+ * @param batch Batch to query.
+ *
+ * @return Number of ranges.
+ */
+	extern size_t apol_mls_range_batch_get_size(const apol_mls_range_batch_t * batch);
+
+/**
+ * Compare pairs of levels.  For each pair, results[i] is set to what
+ * apol_mls_level_compare() would return for the first level against
+ * the second.  Equality is thus results[i] == APOL_MLS_EQ, and
+ * dominance is APOL_MLS_EQ or APOL_MLS_DOM.
+ *
+ * @param l1 Batch from which to take the first level of each pair.
+ * @param l2 Batch from which to take the second level of each pair.
+ * This may be the same batch as l1.
+ * @param pairs Array of indices to compare.  If NULL then compare
+ * l1[i] against l2[i] for each i.
+ * @param num_pairs Number of comparisons to make.
+ * @param results Array of at least num_pairs elements into which to
+ * write APOL_MLS_EQ, APOL_MLS_DOM, APOL_MLS_DOMBY, or APOL_MLS_INCOMP.
+ *
+ * @return 0 on success, < 0 on error (including if an index is out of
+ * bounds or the batches were created from different policies).
+ */
+	extern int apol_mls_level_batch_compare(const apol_mls_level_batch_t * l1, const apol_mls_level_batch_t * l2,
+						const apol_mls_batch_pair_t * pairs, size_t num_pairs, int *results);
+
+/**
+ * Determine if ranges include levels.  For each pair, results[i] is
+ * set to 1 if the first range includes the second level, 0 if not;
+ * this is the same as apol_mls_range_contain_subrange() with a
+ * subrange consisting of only that level.
+ *
+ * @param ranges Batch from which to take the range of each pair.
+ * @param levels Batch from which to take the level of each pair.
+ * @param pairs Array of indices to compare.  If NULL then compare
+ * ranges[i] against levels[i] for each i.
+ * @param num_pairs Number of comparisons to make.
+ * @param results Array of at least num_pairs elements into which to
+ * write the answers.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int apol_mls_range_batch_include_levels(const apol_mls_range_batch_t * ranges, const apol_mls_level_batch_t * levels,
+						       const apol_mls_batch_pair_t * pairs, size_t num_pairs, int *results);
+
+/**
+ * Determine if ranges contain other ranges.  For each pair,
+ * results[i] is set to 1 if the first range contains the second, 0
+ * if not; this is the same as apol_mls_range_contain_subrange().
+ *
+ * @param ranges Batch from which to take the containing range of
+ * each pair.
+ * @param subranges Batch from which to take the contained range of
+ * each pair.  This may be the same batch as ranges.
+ * @param pairs Array of indices to compare.  If NULL then compare
+ * ranges[i] against subranges[i] for each i.
+ * @param num_pairs Number of comparisons to make.
+ * @param results Array of at least num_pairs elements into which to
+ * write the answers.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int apol_mls_range_batch_contain_subranges(const apol_mls_range_batch_t * ranges,
+							  const apol_mls_range_batch_t * subranges, const apol_mls_batch_pair_t * pairs,
+							  size_t num_pairs, int *results);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
@@ -186,6 +186,11 @@ extern "C"
  * set.	 Levels may contain aliases in place of primary names.	If
  * level2 is NULL then this always returns APOL_MLS_EQ.
  *
+ * Each level remembers how it was resolved against the policy, even
+ * though it is passed as const.  A level must therefore not be
+ * compared or validated by two threads at once; give each thread its
+ * own copy.
+ *
  * @param p Policy within which to look up MLS information.
  * @param target Target MLS level to compare.
  * @param search Source MLS level to compare.
@@ -172,8 +172,9 @@ extern "C"
  * Compare two ranges, determining if one matches the other.  The
  * fifth parameter gives how to match the ranges.  For APOL_QUERY_SUB,
  * if search is a subset of target.  For APOL_QUERY_SUPER, if search
- * is a superset of target.  Other valid compare types are
- * APOL_QUERY_EXACT and APOL_QUERY_INTERSECT.  If a range is not valid
+ * is a superset of target.  For APOL_QUERY_INTERSECT, if at least
+ * one level lies within both ranges.  APOL_QUERY_EXACT is also a
+ * valid compare type.  If a range is not valid
  * according to the policy then this function returns -1.  If search
  * is NULL then comparison always succeeds.
  *
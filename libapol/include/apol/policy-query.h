@@ -61,6 +61,7 @@ extern "C"
 #include "bool-query.h"
 #include "isid-query.h"
 #include "mls-query.h"
+#include "mls-batch.h"
 #include "netcon-query.h"
 #include "fscon-query.h"
 #include "context-query.h"
@@ -70,17 +71,22 @@ extern "C"
 #include "default-object-query.h"
 
 #include "avrule-query.h"
+#include "avrule-index.h"
 #include "terule-query.h"
 #include "condrule-query.h"
+#include "cond-whatif.h"
 #include "rbacrule-query.h"
 #include "ftrule-query.h"
 #include "range_trans-query.h"
 #include "constraint-query.h"
+#include "constraint-eval.h"
+#include "av-engine.h"
 
 #include "domain-trans-analysis.h"
 #include "infoflow-analysis.h"
 #include "relabel-analysis.h"
 #include "types-relation-analysis.h"
+#include "type-similarity.h"
 
 #ifdef	__cplusplus
 }
@@ -130,6 +130,18 @@ extern "C"
  */
 	extern char *apol_policy_get_version_type_mls_str(const apol_policy_t * p);
 
+/**
+ * Discard a policy's cached attribute, role, and user memberships.
+ * They are rebuilt upon their next use.  The cache is discarded
+ * automatically once the underlying qpol policy has been rebuilt
+ * (see qpol_policy_get_generation()), so calling this is never
+ * required; it merely frees the memory early.  It must not be called
+ * while another thread queries the policy.
+ *
+ * @param p Policy whose memberships to discard.
+ */
+	extern void apol_policy_reset_membership(apol_policy_t * p);
+
 #define APOL_MSG_ERR 1
 #define APOL_MSG_WARN 2
 #define APOL_MSG_INFO 3
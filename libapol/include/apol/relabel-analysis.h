@@ -44,6 +44,7 @@ extern "C"
 	typedef struct apol_relabel_analysis apol_relabel_analysis_t;
 	typedef struct apol_relabel_result apol_relabel_result_t;
 	typedef struct apol_relabel_result_pair apol_relabel_result_pair_t;
+	typedef struct apol_relabel_domain apol_relabel_domain_t;
 
 /******************** functions to do relabel analysis ********************/
 
@@ -61,6 +62,28 @@ extern "C"
  */
 	extern int apol_relabel_analysis_do(const apol_policy_t * p, apol_relabel_analysis_t * r, apol_vector_t ** v);
 
+/**
+ * Execute a subject relabel analysis for every domain of a policy at
+ * once.  The result for each domain is the same as running
+ * apol_relabel_analysis_do() with direction APOL_RELABEL_DIR_SUBJECT
+ * and that domain as the starting type, but every relabel rule is
+ * read only once.  The analysis's direction and starting type are
+ * ignored; its classes and result regex are honored.  If subjects
+ * have been appended, only those domains (and the types of those
+ * subjects that are attributes) are reported.
+ *
+ * @param p Policy within which to look up allow rules.
+ * @param r A non-NULL structure containing parameters for analysis.
+ * @param v Reference to a vector of apol_relabel_domain_t, one for
+ * each domain that may relabel at least one type, in order of type
+ * value.  The vector will be allocated by this function.  The caller
+ * must call apol_vector_destroy() afterwards.  This will be set to
+ * NULL upon error.
+ *
+ * @return 0 on success, negative on error.
+ */
+	extern int apol_relabel_analysis_do_all_domains(const apol_policy_t * p, apol_relabel_analysis_t * r, apol_vector_t ** v);
+
 /**
  * Allocate and return a new relabel analysis structure.  All fields
  * are cleared; one must fill in the details of the analysis before
@@ -202,6 +225,27 @@ extern "C"
  */
 	extern const qpol_type_t *apol_relabel_result_get_result_type(const apol_relabel_result_t * r);
 
+/**
+ * Return the domain of an apol_relabel_domain node.
+ *
+ * @param d Relabel domain node.
+ *
+ * @return Pointer to the domain's type.
+ */
+	extern const qpol_type_t *apol_relabel_domain_get_domain(const apol_relabel_domain_t * d);
+
+/**
+ * Return the results embedded within an apol_relabel_domain node.
+ * This is a vector of apol_relabel_result_t objects, as would be
+ * returned by a subject analysis of the domain.  The caller shall not
+ * call apol_vector_destroy() upon this pointer.
+ *
+ * @param d Relabel domain node.
+ *
+ * @return Pointer to a vector of results.
+ */
+	extern const apol_vector_t *apol_relabel_domain_get_results(const apol_relabel_domain_t * d);
+
 /**
  * Return the first rule from an apol_relabel_result_pair object.
  *
@@ -0,0 +1,235 @@
+/**
+ * @file
+ *
+ * Routines to measure how alike the accesses of a policy's domains
+ * are, and to group alike domains together.  Each domain's access
+ * signature is the set of (target type, object class, permission)
+ * triples that the policy's allow rules grant it, with attributes
+ * expanded on both sides.  Two domains' similarity is the Jaccard
+ * index of their signatures: the size of their intersection over the
+ * size of their union.  Domains whose signatures are identical are
+ * candidates for merging; groups of alike domains are candidates for
+ * a new attribute.
+ *
+ * Finding every alike pair among thousands of domains compares only
+ * those pairs that could pass the threshold.  Each signature is
+ * summarized by a MinHash sketch, and locality-sensitive hashing over
+ * the sketches picks the candidate pairs, whose similarity is then
+ * computed exactly.  A sketch is an estimate, so a pair just above
+ * the threshold may rarely be missed; without sketches every pair is
+ * compared.
+ *
+ * Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef APOL_TYPE_SIMILARITY_H
+#define APOL_TYPE_SIMILARITY_H
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#include "policy.h"
+#include "vector.h"
+#include <qpol/policy.h>
+#include <stddef.h>
+
+	typedef struct apol_type_similarity apol_type_similarity_t;
+	typedef struct apol_type_similarity_pair apol_type_similarity_pair_t;
+
+/** Default number of hashes within each domain's sketch. */
+#define APOL_TYPE_SIMILARITY_DEFAULT_HASHES 128
+
+/** Attribute whose types are the domains when the caller names none. */
+#define APOL_TYPE_SIMILARITY_DOMAIN_ATTRIB "domain"
+
+/**
+ * Build the access signature of every domain within a policy.  A
+ * domain is any type within the given set that some allow rule grants
+ * an access, whether or not that rule is conditional.  The policy
+ * must have its rules loaded, and must be neither modified nor
+ * destroyed while the engine is in use.
+ *
+ * @param p Policy whose domains to examine.
+ * @param domains Vector of type or attribute names (char *); each
+ * attribute stands for its types.  If NULL then the types of
+ * APOL_TYPE_SIMILARITY_DOMAIN_ATTRIB are used.  A name not within the
+ * policy is an error.
+ * @param num_hashes Number of hashes within each domain's MinHash
+ * sketch, or 0 to keep no sketches and compare every pair exactly.
+ * APOL_TYPE_SIMILARITY_DEFAULT_HASHES suits most policies.
+ *
+ * @return An allocated engine, or NULL upon error.  The caller must
+ * call apol_type_similarity_destroy() afterwards.
+ */
+	extern apol_type_similarity_t *apol_type_similarity_create(const apol_policy_t * p, const apol_vector_t * domains,
+								   size_t num_hashes);
+
+/**
+ * Deallocate all space associated with an engine.
+ *
+ * @param s Reference to the engine to destroy.  The pointer will be
+ * set to NULL afterwards.
+ */
+	extern void apol_type_similarity_destroy(apol_type_similarity_t ** s);
+
+/**
+ * Return the number of domains within an engine.
+ *
+ * @param s Engine to query.
+ *
+ * @return Number of domains, or 0 upon error.
+ */
+	extern size_t apol_type_similarity_get_num_domains(const apol_type_similarity_t * s);
+
+/**
+ * Return one of an engine's domains.  Domains are ordered by type
+ * value.
+ *
+ * @param s Engine to query.
+ * @param i Index of the domain.
+ *
+ * @return The domain, or NULL upon error.
+ */
+	extern const qpol_type_t *apol_type_similarity_get_domain(const apol_type_similarity_t * s, size_t i);
+
+/**
+ * Find the index of a domain within an engine.
+ *
+ * @param s Engine to query.
+ * @param name Name or alias of the domain.
+ * @param i Reference to the domain's index.
+ *
+ * @return 0 on success, < 0 on error (including if the type is not a
+ * domain).
+ */
+	extern int apol_type_similarity_get_domain_index(const apol_type_similarity_t * s, const char *name, size_t * i);
+
+/**
+ * Return the number of (target type, object class, permission)
+ * triples within a domain's access signature.
+ *
+ * @param s Engine to query.
+ * @param i Index of the domain.
+ *
+ * @return Size of the signature, or 0 upon error.
+ */
+	extern size_t apol_type_similarity_get_num_accesses(const apol_type_similarity_t * s, size_t i);
+
+/**
+ * Compute the exact similarity of two domains.
+ *
+ * @param s Engine to query.
+ * @param i Index of one domain.
+ * @param j Index of the other domain.
+ * @param similarity Reference to the Jaccard index of the two
+ * domains' signatures, from 0.0 to 1.0.  A domain with an empty
+ * signature is alike to no other, so this is 0.0 if either
+ * signature is empty.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int apol_type_similarity_compare(const apol_type_similarity_t * s, size_t i, size_t j, double *similarity);
+
+/**
+ * Estimate the similarity of two domains from their sketches.
+ *
+ * @param s Engine to query; it must have been created with sketches.
+ * @param i Index of one domain.
+ * @param j Index of the other domain.
+ * @param similarity Reference to the estimated Jaccard index of the
+ * two domains' signatures, from 0.0 to 1.0; 0.0 if either signature
+ * is empty.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int apol_type_similarity_estimate(const apol_type_similarity_t * s, size_t i, size_t j, double *similarity);
+
+/**
+ * Find the pairs of domains whose similarity is at least a threshold.
+ * Sketches only choose the candidate pairs; the exact similarity of
+ * each candidate is computed by as many threads as there are
+ * processors.  If the sketches are too small to find the pairs at a
+ * threshold with at least 95% probability, every pair is compared
+ * exactly instead, as if the engine had no sketches.
+ *
+ * @param s Engine to query.
+ * @param threshold Least similarity to report, greater than 0.0 and
+ * no more than 1.0.
+ * @param pairs Reference to a vector of apol_type_similarity_pair_t,
+ * ordered by the first and then the other domain's index; the first
+ * domain of each pair precedes the other.  The caller must call
+ * apol_vector_destroy() afterwards.  This will be set to NULL upon
+ * error.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int apol_type_similarity_find_pairs(const apol_type_similarity_t * s, double threshold, apol_vector_t ** pairs);
+
+/**
+ * Group domains so that each domain within a group is joined to
+ * another member by a chain of pairs whose similarity is at least a
+ * threshold (single-linkage clustering).  Domains alike to no other
+ * are not reported.
+ *
+ * @param s Engine to query.
+ * @param threshold Least similarity that joins two domains, greater
+ * than 0.0 and no more than 1.0.
+ * @param clusters Reference to a vector of groups, ordered by each
+ * group's first domain.  Each group is itself a vector of qpol_type_t
+ * pointers, ordered by type value.  The caller must call
+ * apol_vector_destroy() afterwards, which also destroys the groups.
+ * This will be set to NULL upon error.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int apol_type_similarity_find_clusters(const apol_type_similarity_t * s, double threshold, apol_vector_t ** clusters);
+
+/**
+ * Return the first domain of a pair.
+ *
+ * @param pair Pair to query.
+ *
+ * @return The domain, or NULL upon error.
+ */
+	extern const qpol_type_t *apol_type_similarity_pair_get_first(const apol_type_similarity_pair_t * pair);
+
+/**
+ * Return the other domain of a pair.
+ *
+ * @param pair Pair to query.
+ *
+ * @return The domain, or NULL upon error.
+ */
+	extern const qpol_type_t *apol_type_similarity_pair_get_other(const apol_type_similarity_pair_t * pair);
+
+/**
+ * Return the exact similarity of a pair's domains.
+ *
+ * @param pair Pair to query.
+ *
+ * @return The Jaccard index of the domains' signatures, or -1.0 upon
+ * error.
+ */
+	extern double apol_type_similarity_pair_get_similarity(const apol_type_similarity_pair_t * pair);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
@@ -73,6 +73,33 @@ extern "C"
 	extern int apol_types_relation_analysis_do(apol_policy_t * p,
 						   const apol_types_relation_analysis_t * tr, apol_types_relation_result_t ** r);
 
+/**
+ * Execute a two types relationship analysis upon many pairs of types
+ * at once.  Each distinct type's attributes, roles, rules, access
+ * pool, information flows and domain transitions are found only once,
+ * with one flow graph of each kind built for the whole batch; the
+ * pairs are then divided among as many threads as there are
+ * processors.  Each pair's result is the same as that of
+ * apol_types_relation_analysis_do() upon that pair.
+ *
+ * @param p Policy within which to look up relationships.
+ * @param tr A non-NULL structure whose analyses to run.  Its first
+ * and other types are ignored.
+ * @param first_types Array of num_pairs names, the first type of each
+ * pair.
+ * @param other_types Array of num_pairs names, the other type of each
+ * pair.
+ * @param num_pairs Number of pairs.
+ * @param results Array of num_pairs entries.  Upon success each is an
+ * allocated result, which the caller must destroy with
+ * apol_types_relation_result_destroy(); upon error each is NULL.
+ *
+ * @return 0 on success, negative on error.
+ */
+	extern int apol_types_relation_analysis_do_batch(apol_policy_t * p, const apol_types_relation_analysis_t * tr,
+							 const char *const *first_types, const char *const *other_types,
+							 size_t num_pairs, apol_types_relation_result_t ** results);
+
 /**
  * Allocate and return a new two types relationship analysis
  * structure.  All fields are cleared; one must fill in the details of
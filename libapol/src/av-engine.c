@@ -0,0 +1,764 @@
+/**
+ * @file
+ * Implementation of the offline access vector computation engine.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "policy-query-internal.h"
+#include "constraint-eval-internal.h"
+#include <apol/av-engine.h>
+#include <qpol/avrule_query.h>
+#include <qpol/bounds_query.h>
+#include <qpol/cond_query.h>
+#include <qpol/rbacrule_query.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AV_ENGINE_NONE UINT32_MAX
+
+/** Each part of a key is a type or class value; the kernel's own
+ *  table holds them in 16 bits. */
+#define AV_ENGINE_KEY_BITS 21
+
+/**
+ * The rules of one (source, target, class) key.  Unconditional
+ * rules are merged into the node; conditional rules are kept in a
+ * list, because whether they apply depends upon the booleans.
+ */
+typedef struct av_node
+{
+	/** 0 for an empty slot */
+	uint64_t key;
+	uint32_t allowed, auditallow, dontaudit;
+	/** index of the first conditional entry, or AV_ENGINE_NONE */
+	uint32_t conds;
+} av_node_t;
+
+typedef struct av_cond_entry
+{
+	/** index of the rule's conditional expression within conds */
+	uint32_t cond;
+	/** 1 if the rule is within the expression's true list */
+	uint32_t which_list;
+	uint32_t rule_type;
+	uint32_t perms;
+	uint32_t next;
+} av_cond_entry_t;
+
+typedef struct av_cache_slot
+{
+	size_t scontext, tcontext, class_index;
+	int valid;
+	apol_av_decision_t avd;
+} av_cache_slot_t;
+
+struct apol_av_engine
+{
+	const apol_policy_t *policy;
+	apol_constraint_eval_t *ceval;
+	/** open-addressed table of size nodes_mask + 1 */
+	av_node_t *nodes;
+	size_t nodes_mask;
+	av_cond_entry_t *cond_entries;
+	size_t num_cond_entries, cond_entries_cap;
+	/** the policy's conditional expressions, sorted by address */
+	const qpol_cond_t **conds;
+	size_t num_conds;
+	/** non-zero if conds[i] is currently true */
+	unsigned char *cond_state;
+	/** the type of value v and its attributes are
+	 *  attrs[attr_first[v - 1], attr_first[v]) */
+	size_t *attr_first;
+	uint32_t *attrs;
+	size_t num_types;
+	/** value of the type bounding the type of value v is
+	 *  bounds[v - 1], or 0 if it is unbounded; NULL if no type is
+	 *  bounded */
+	uint32_t *bounds;
+	/** role allow rules, as (source << 32 | target) role values,
+	 *  sorted */
+	uint64_t *role_allows;
+	size_t num_role_allows;
+	/** value of the process class, or 0 if the policy has none, and
+	 *  its transition and dyntransition permissions */
+	uint32_t process_class, process_trans_perms;
+	/** direct-mapped cache of size cache_mask + 1, or NULL */
+	av_cache_slot_t *cache;
+	size_t cache_mask;
+	size_t hits, misses;
+};
+
+static inline uint64_t av_engine_key(uint32_t source, uint32_t target, uint32_t class_value)
+{
+	return ((uint64_t) source << (2 * AV_ENGINE_KEY_BITS)) | ((uint64_t) target << AV_ENGINE_KEY_BITS) | class_value;
+}
+
+static inline size_t av_engine_hash(uint64_t key)
+{
+	key *= UINT64_C(0x9e3779b97f4a7c15);
+	return (size_t) (key ^ (key >> 32));
+}
+
+/**
+ * Find the node of a key, or the empty slot where it belongs.
+ */
+static av_node_t *av_engine_probe(const apol_av_engine_t * e, uint64_t key)
+{
+	size_t i = av_engine_hash(key) & e->nodes_mask;
+	while (e->nodes[i].key != 0 && e->nodes[i].key != key) {
+		i = (i + 1) & e->nodes_mask;
+	}
+	return e->nodes + i;
+}
+
+static int av_engine_cond_compare(const void *a, const void *b)
+{
+	const qpol_cond_t *x = *(const qpol_cond_t * const *)a, *y = *(const qpol_cond_t * const *)b;
+	return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+static int av_engine_get_conds(apol_av_engine_t * e)
+{
+	qpol_iterator_t *iter = NULL;
+	size_t size;
+	int error = 0;
+
+	if (qpol_policy_get_cond_iter(e->policy->p, &iter) < 0 || qpol_iterator_get_size(iter, &size) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	if (size > 0 && ((e->conds = malloc(size * sizeof(*e->conds))) == NULL ||
+			 (e->cond_state = calloc(size, sizeof(*e->cond_state))) == NULL)) {
+		error = errno;
+		ERR(e->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter) && e->num_conds < size; qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&e->conds[e->num_conds]) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		e->num_conds++;
+	}
+	qsort(e->conds, e->num_conds, sizeof(*e->conds), av_engine_cond_compare);
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+static int av_engine_push_pair(apol_av_engine_t * e, uint32_t ** pairs, size_t * num_pairs, size_t * pairs_cap,
+			       uint32_t type_value, uint32_t attr_value)
+{
+	uint32_t *tmp;
+	if (*num_pairs + 2 > *pairs_cap) {
+		size_t new_cap = (*pairs_cap == 0 ? 1024 : *pairs_cap * 2);
+		if ((tmp = realloc(*pairs, new_cap * sizeof(*tmp))) == NULL) {
+			ERR(e->policy, "%s", strerror(errno));
+			return -1;
+		}
+		*pairs = tmp;
+		*pairs_cap = new_cap;
+	}
+	(*pairs)[(*num_pairs)++] = type_value;
+	(*pairs)[(*num_pairs)++] = attr_value;
+	if (type_value > e->num_types) {
+		e->num_types = type_value;
+	}
+	return 0;
+}
+
+/**
+ * Record each type's attributes, with the type itself first.
+ * Attributes map only to themselves.
+ */
+static int av_engine_get_attrs(apol_av_engine_t * e)
+{
+	qpol_policy_t *q = e->policy->p;
+	qpol_iterator_t *iter = NULL, *attr_iter = NULL;
+	const qpol_type_t *type, *attr;
+	uint32_t value, attr_value, *pairs = NULL;
+	size_t num_pairs = 0, pairs_cap = 0, i;
+	unsigned char isalias, isattr;
+	int error = 0;
+
+	if (qpol_policy_get_type_iter(q, &iter) < 0) {
+		return -1;
+	}
+	/* gather (type, attribute) pairs, then sort them by type */
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&type) < 0 || qpol_type_get_isalias(q, type, &isalias) < 0 ||
+		    qpol_type_get_isattr(q, type, &isattr) < 0 || qpol_type_get_value(q, type, &value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (isalias) {
+			continue;
+		}
+		if (av_engine_push_pair(e, &pairs, &num_pairs, &pairs_cap, value, value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (isattr) {
+			continue;
+		}
+		if (qpol_type_get_attr_iter(q, type, &attr_iter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		for (; !qpol_iterator_end(attr_iter); qpol_iterator_next(attr_iter)) {
+			if (qpol_iterator_get_item(attr_iter, (void **)&attr) < 0 || qpol_type_get_value(q, attr, &attr_value) < 0 ||
+			    av_engine_push_pair(e, &pairs, &num_pairs, &pairs_cap, value, attr_value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+		}
+		qpol_iterator_destroy(&attr_iter);
+	}
+
+	if ((e->attr_first = calloc(e->num_types + 1, sizeof(*e->attr_first))) == NULL ||
+	    (num_pairs > 0 && (e->attrs = malloc(num_pairs / 2 * sizeof(*e->attrs))) == NULL)) {
+		error = errno;
+		ERR(e->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	/* count each type's entries, then make attr_first[v] the end of
+	 * value v's entries */
+	for (i = 0; i < num_pairs; i += 2) {
+		e->attr_first[pairs[i]]++;
+	}
+	for (i = 1; i <= e->num_types; i++) {
+		e->attr_first[i] += e->attr_first[i - 1];
+	}
+	/* fill from the back, so that each type keeps its gathered
+	 * order (itself first); afterwards attr_first[v] is the start of
+	 * value v's entries */
+	for (i = num_pairs; i > 0; i -= 2) {
+		e->attrs[--e->attr_first[pairs[i - 2]]] = pairs[i - 1];
+	}
+	memmove(e->attr_first, e->attr_first + 1, e->num_types * sizeof(*e->attr_first));
+	e->attr_first[e->num_types] = num_pairs / 2;
+      cleanup:
+	free(pairs);
+	qpol_iterator_destroy(&attr_iter);
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Record the type bounding each type, if any.
+ */
+static int av_engine_get_bounds(apol_av_engine_t * e)
+{
+	qpol_policy_t *q = e->policy->p;
+	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *type, *parent;
+	const char *parent_name;
+	uint32_t value, parent_value;
+	int error = 0;
+
+	if (!qpol_policy_has_capability(q, QPOL_CAP_BOUNDS)) {
+		return 0;
+	}
+	if (qpol_policy_get_type_iter(q, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&type) < 0 ||
+		    qpol_typebounds_get_parent_name(q, (const qpol_typebounds_t *)type, &parent_name) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (parent_name == NULL) {
+			continue;
+		}
+		if (qpol_type_get_value(q, type, &value) < 0 || qpol_policy_get_type_by_name(q, parent_name, &parent) < 0 ||
+		    qpol_type_get_value(q, parent, &parent_value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (e->bounds == NULL && (e->bounds = calloc(e->num_types, sizeof(*e->bounds))) == NULL) {
+			error = errno;
+			ERR(e->policy, "%s", strerror(error));
+			goto cleanup;
+		}
+		if (value <= e->num_types) {
+			e->bounds[value - 1] = parent_value;
+		}
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+static int av_engine_role_allow_compare(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+/**
+ * Record the policy's role allow rules, and the permissions that
+ * they govern.
+ */
+static int av_engine_get_role_allows(apol_av_engine_t * e)
+{
+	qpol_policy_t *q = e->policy->p;
+	qpol_iterator_t *iter = NULL;
+	const qpol_role_allow_t *rule;
+	const qpol_role_t *source, *target;
+	const qpol_class_t *obj_class;
+	const char *class_name;
+	uint32_t source_value, target_value;
+	size_t size;
+	int error = 0;
+
+	/* look for the process class without complaining if the policy
+	 * has none; it then has no transitions to check */
+	if (qpol_policy_get_class_iter(q, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&obj_class) < 0 || qpol_class_get_name(q, obj_class, &class_name) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (strcmp(class_name, "process") == 0) {
+			if (qpol_class_get_value(q, obj_class, &e->process_class) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			break;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	if (e->process_class == 0) {
+		return 0;
+	}
+	e->process_trans_perms = constraint_eval_get_perm_bit(e->ceval, e->process_class - 1, "transition") |
+		constraint_eval_get_perm_bit(e->ceval, e->process_class - 1, "dyntransition");
+
+	if (qpol_policy_get_role_allow_iter(q, &iter) < 0 || qpol_iterator_get_size(iter, &size) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	if (size > 0 && (e->role_allows = malloc(size * sizeof(*e->role_allows))) == NULL) {
+		error = errno;
+		ERR(e->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter) && e->num_role_allows < size; qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&rule) < 0 ||
+		    qpol_role_allow_get_source_role(q, rule, &source) < 0 || qpol_role_get_value(q, source, &source_value) < 0 ||
+		    qpol_role_allow_get_target_role(q, rule, &target) < 0 || qpol_role_get_value(q, target, &target_value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		e->role_allows[e->num_role_allows++] = ((uint64_t) source_value << 32) | target_value;
+	}
+	qsort(e->role_allows, e->num_role_allows, sizeof(*e->role_allows), av_engine_role_allow_compare);
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Add one access vector rule to the table.
+ */
+static int av_engine_add_rule(apol_av_engine_t * e, const qpol_avrule_t * rule)
+{
+	qpol_policy_t *q = e->policy->p;
+	const qpol_type_t *source, *target;
+	const qpol_class_t *obj_class;
+	const qpol_cond_t *cond, **found;
+	qpol_iterator_t *iter = NULL;
+	uint32_t rule_type, source_value, target_value, class_value, perms = 0;
+	av_node_t *node;
+	char *perm;
+	int error = 0;
+
+	if (qpol_avrule_get_rule_type(q, rule, &rule_type) < 0 ||
+	    qpol_avrule_get_source_type(q, rule, &source) < 0 || qpol_type_get_value(q, source, &source_value) < 0 ||
+	    qpol_avrule_get_target_type(q, rule, &target) < 0 || qpol_type_get_value(q, target, &target_value) < 0 ||
+	    qpol_avrule_get_object_class(q, rule, &obj_class) < 0 || qpol_class_get_value(q, obj_class, &class_value) < 0 ||
+	    qpol_avrule_get_cond(q, rule, &cond) < 0 || qpol_avrule_get_perm_iter(q, rule, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&perm) < 0) {
+			error = errno;
+			qpol_iterator_destroy(&iter);
+			errno = error;
+			return -1;
+		}
+		perms |= constraint_eval_get_perm_bit(e->ceval, class_value - 1, perm);
+		free(perm);
+	}
+	qpol_iterator_destroy(&iter);
+
+	node = av_engine_probe(e, av_engine_key(source_value, target_value, class_value));
+	if (node->key == 0) {
+		node->key = av_engine_key(source_value, target_value, class_value);
+		node->conds = AV_ENGINE_NONE;
+	}
+	if (cond == NULL) {
+		if (rule_type == QPOL_RULE_ALLOW) {
+			node->allowed |= perms;
+		} else if (rule_type == QPOL_RULE_AUDITALLOW) {
+			node->auditallow |= perms;
+		} else {
+			node->dontaudit |= perms;
+		}
+		return 0;
+	}
+
+	if ((found = bsearch(&cond, e->conds, e->num_conds, sizeof(*e->conds), av_engine_cond_compare)) == NULL) {
+		ERR(e->policy, "%s", strerror(ENOENT));
+		errno = ENOENT;
+		return -1;
+	}
+	if (e->num_cond_entries >= e->cond_entries_cap) {
+		size_t new_cap = (e->cond_entries_cap == 0 ? 1024 : e->cond_entries_cap * 2);
+		av_cond_entry_t *entries;
+		if (new_cap >= AV_ENGINE_NONE || (entries = realloc(e->cond_entries, new_cap * sizeof(*entries))) == NULL) {
+			error = (new_cap >= AV_ENGINE_NONE ? EOVERFLOW : errno);
+			ERR(e->policy, "%s", strerror(error));
+			errno = error;
+			return -1;
+		}
+		e->cond_entries = entries;
+		e->cond_entries_cap = new_cap;
+	}
+	e->cond_entries[e->num_cond_entries].cond = (uint32_t) (found - e->conds);
+	if (qpol_avrule_get_which_list(q, rule, &e->cond_entries[e->num_cond_entries].which_list) < 0) {
+		return -1;
+	}
+	e->cond_entries[e->num_cond_entries].rule_type = rule_type;
+	e->cond_entries[e->num_cond_entries].perms = perms;
+	e->cond_entries[e->num_cond_entries].next = node->conds;
+	node->conds = (uint32_t) e->num_cond_entries++;
+	return 0;
+}
+
+static int av_engine_add_rules(apol_av_engine_t * e)
+{
+	qpol_iterator_t *iter = NULL;
+	const qpol_avrule_t *rule;
+	size_t size, nodes_size;
+	int error = 0;
+
+	if (qpol_policy_get_avrule_iter(e->policy->p, QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT, &iter) < 0 ||
+	    qpol_iterator_get_size(iter, &size) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	/* no more than one node per rule; keep the table at most half
+	 * full */
+	for (nodes_size = 1024; nodes_size < 2 * size; nodes_size *= 2) ;
+	if ((e->nodes = calloc(nodes_size, sizeof(*e->nodes))) == NULL) {
+		error = errno;
+		ERR(e->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	e->nodes_mask = nodes_size - 1;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&rule) < 0 || av_engine_add_rule(e, rule) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+apol_av_engine_t *apol_av_engine_create(const apol_policy_t * p, size_t cache_size)
+{
+	apol_av_engine_t *e;
+	size_t size;
+	int error;
+
+	if (p == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (!qpol_policy_has_capability(p->p, QPOL_CAP_RULES_LOADED)) {
+		ERR(p, "%s", "Cannot compute access vectors without the policy's rules.");
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((e = calloc(1, sizeof(*e))) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		errno = error;
+		return NULL;
+	}
+	e->policy = p;
+	if ((e->ceval = apol_constraint_eval_create(p)) == NULL || av_engine_get_conds(e) < 0 || av_engine_get_attrs(e) < 0 ||
+	    av_engine_get_bounds(e) < 0 || av_engine_get_role_allows(e) < 0 || av_engine_add_rules(e) < 0 ||
+	    apol_av_engine_refresh_conds(e) < 0) {
+		goto err;
+	}
+	for (size = 1; cache_size > 0 && size < cache_size; size *= 2) ;
+	if (cache_size > 0) {
+		if ((e->cache = calloc(size, sizeof(*e->cache))) == NULL) {
+			ERR(p, "%s", strerror(errno));
+			goto err;
+		}
+		e->cache_mask = size - 1;
+	}
+	return e;
+      err:
+	error = errno;
+	apol_av_engine_destroy(&e);
+	errno = error;
+	return NULL;
+}
+
+void apol_av_engine_destroy(apol_av_engine_t ** e)
+{
+	if (e != NULL && *e != NULL) {
+		apol_constraint_eval_destroy(&(*e)->ceval);
+		free((*e)->nodes);
+		free((*e)->cond_entries);
+		free((*e)->conds);
+		free((*e)->cond_state);
+		free((*e)->attr_first);
+		free((*e)->attrs);
+		free((*e)->bounds);
+		free((*e)->role_allows);
+		free((*e)->cache);
+		free(*e);
+		*e = NULL;
+	}
+}
+
+apol_constraint_eval_t *apol_av_engine_get_constraint_eval(const apol_av_engine_t * e)
+{
+	if (e == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return e->ceval;
+}
+
+/**
+ * Combine the rules of every attribute of the source type with every
+ * attribute of the target type, as does the kernel.
+ */
+static void av_engine_compute_te(const apol_av_engine_t * e, uint32_t stype, uint32_t ttype, uint32_t class_value,
+				 apol_av_decision_t * avd)
+{
+	const uint32_t *s, *s_end = e->attrs + e->attr_first[stype], *t, *t_begin, *t_end;
+	const av_node_t *node;
+	const av_cond_entry_t *entry;
+	uint32_t allowed = 0, auditallow = 0, dontaudit = 0, c;
+
+	t_begin = e->attrs + e->attr_first[ttype - 1];
+	t_end = e->attrs + e->attr_first[ttype];
+	for (s = e->attrs + e->attr_first[stype - 1]; s < s_end; s++) {
+		for (t = t_begin; t < t_end; t++) {
+			node = av_engine_probe(e, av_engine_key(*s, *t, class_value));
+			if (node->key == 0) {
+				continue;
+			}
+			allowed |= node->allowed;
+			auditallow |= node->auditallow;
+			dontaudit |= node->dontaudit;
+			for (c = node->conds; c != AV_ENGINE_NONE; c = entry->next) {
+				entry = e->cond_entries + c;
+				if (e->cond_state[entry->cond] != entry->which_list) {
+					continue;
+				}
+				if (entry->rule_type == QPOL_RULE_ALLOW) {
+					allowed |= entry->perms;
+				} else if (entry->rule_type == QPOL_RULE_AUDITALLOW) {
+					auditallow |= entry->perms;
+				} else {
+					dontaudit |= entry->perms;
+				}
+			}
+		}
+	}
+	avd->allowed = allowed;
+	avd->auditallow = auditallow;
+	avd->auditdeny = ~dontaudit;
+	avd->constrained = 0;
+}
+
+/**
+ * Remove the permissions that a bounded source type is allowed but
+ * its bounding type is not, as does the kernel.  The bounding type is
+ * checked against the target's bounding type if the target is also
+ * bounded, and is itself limited by its own bounds.
+ */
+static uint32_t av_engine_bound_te(const apol_av_engine_t * e, uint32_t stype, uint32_t ttype, uint32_t class_value,
+				   uint32_t allowed)
+{
+	apol_av_decision_t lo;
+	uint32_t lo_stype, lo_ttype;
+
+	/* a chain of bounds is acyclic, and no longer than the number
+	 * of types */
+	while (e->bounds != NULL && allowed != 0 && (lo_stype = e->bounds[stype - 1]) != 0) {
+		lo_ttype = (e->bounds[ttype - 1] != 0 ? e->bounds[ttype - 1] : ttype);
+		av_engine_compute_te(e, lo_stype, lo_ttype, class_value, &lo);
+		allowed &= lo.allowed;
+		stype = lo_stype;
+		ttype = lo_ttype;
+	}
+	return allowed;
+}
+
+/**
+ * Return non-zero if a role allow rule permits a transition from one
+ * role to another.
+ */
+static int av_engine_role_allowed(const apol_av_engine_t * e, uint32_t srole, uint32_t trole)
+{
+	uint64_t key = ((uint64_t) srole << 32) | trole;
+	return bsearch(&key, e->role_allows, e->num_role_allows, sizeof(*e->role_allows), av_engine_role_allow_compare) != NULL;
+}
+
+int apol_av_engine_compute(apol_av_engine_t * e, size_t scontext, size_t tcontext, size_t class_index, apol_av_decision_t * avd)
+{
+	apol_constraint_eval_request_t r;
+	av_cache_slot_t *slot = NULL;
+	uint32_t stype, ttype, denied;
+
+	if (e == NULL || avd == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (scontext >= apol_constraint_eval_get_num_contexts(e->ceval) || tcontext >= apol_constraint_eval_get_num_contexts(e->ceval)
+	    || class_index >= constraint_eval_get_num_classes(e->ceval)) {
+		ERR(e->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (e->cache != NULL) {
+		slot = e->cache + (av_engine_hash(((uint64_t) scontext << 32) ^ ((uint64_t) tcontext << 12) ^ class_index) &
+				   e->cache_mask);
+		if (slot->valid && slot->scontext == scontext && slot->tcontext == tcontext && slot->class_index == class_index) {
+			e->hits++;
+			*avd = slot->avd;
+			return 0;
+		}
+	}
+	e->misses++;
+
+	stype = constraint_eval_get_context_type(e->ceval, scontext);
+	ttype = constraint_eval_get_context_type(e->ceval, tcontext);
+	av_engine_compute_te(e, stype, ttype, (uint32_t) class_index + 1, avd);
+	if (avd->allowed != 0) {
+		r.scontext = scontext;
+		r.tcontext = tcontext;
+		r.class_index = class_index;
+		r.perms = avd->allowed;
+		if (apol_constraint_eval_check(e->ceval, &r, 1, &denied) < 0) {
+			return -1;
+		}
+		avd->allowed &= ~denied;
+		avd->constrained = denied;
+	}
+	/* a process may change role only as a role allow rule permits */
+	if ((uint32_t) class_index + 1 == e->process_class && (avd->allowed & e->process_trans_perms) &&
+	    constraint_eval_get_context_role(e->ceval, scontext) != constraint_eval_get_context_role(e->ceval, tcontext) &&
+	    !av_engine_role_allowed(e, constraint_eval_get_context_role(e->ceval, scontext),
+				    constraint_eval_get_context_role(e->ceval, tcontext))) {
+		avd->allowed &= ~e->process_trans_perms;
+	}
+	avd->allowed = av_engine_bound_te(e, stype, ttype, (uint32_t) class_index + 1, avd->allowed);
+
+	if (slot != NULL) {
+		slot->scontext = scontext;
+		slot->tcontext = tcontext;
+		slot->class_index = class_index;
+		slot->avd = *avd;
+		slot->valid = 1;
+	}
+	return 0;
+}
+
+int apol_av_engine_compute_batch(apol_av_engine_t * e, const apol_constraint_eval_request_t * requests, size_t num_requests,
+				 apol_av_decision_t * avds)
+{
+	size_t i;
+	if (e == NULL || (num_requests > 0 && (requests == NULL || avds == NULL))) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (i = 0; i < num_requests; i++) {
+		if (apol_av_engine_compute(e, requests[i].scontext, requests[i].tcontext, requests[i].class_index, avds + i) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int apol_av_engine_refresh_conds(apol_av_engine_t * e)
+{
+	uint32_t is_true;
+	size_t i;
+	if (e == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (i = 0; i < e->num_conds; i++) {
+		if (qpol_cond_eval(e->policy->p, e->conds[i], &is_true) < 0) {
+			return -1;
+		}
+		e->cond_state[i] = (is_true ? 1 : 0);
+	}
+	if (e->cache != NULL) {
+		memset(e->cache, 0, (e->cache_mask + 1) * sizeof(*e->cache));
+	}
+	return 0;
+}
+
+void apol_av_engine_get_cache_stats(const apol_av_engine_t * e, size_t * hits, size_t * misses)
+{
+	if (hits != NULL) {
+		*hits = (e != NULL ? e->hits : 0);
+	}
+	if (misses != NULL) {
+		*misses = (e != NULL ? e->misses : 0);
+	}
+}
@@ -0,0 +1,373 @@
+/**
+ * @file
+ * Implementation of an access vector rule lookup table.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "policy-query-internal.h"
+#include <apol/avrule-index.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A single indexed rule.  Entries are grouped by source value; within
+ * a group they are sorted by target value and then by class value.
+ */
+typedef struct avrule_index_entry
+{
+	uint32_t source, target, obj_class;
+	const qpol_avrule_t *rule;
+} avrule_index_entry_t;
+
+struct apol_avrule_index
+{
+	const apol_policy_t *policy;
+	/** array of all indexed rules, sorted by avrule_index_entry_comp() */
+	avrule_index_entry_t *entries;
+	size_t num_entries;
+	/** entries for source value s lie within [offsets[s], offsets[s + 1]) */
+	size_t *offsets;
+	/** one more than the largest type value within the policy */
+	uint32_t num_types;
+};
+
+static int avrule_index_entry_comp(const void *a, const void *b)
+{
+	const avrule_index_entry_t *e1 = a;
+	const avrule_index_entry_t *e2 = b;
+	if (e1->source != e2->source) {
+		return (e1->source < e2->source ? -1 : 1);
+	}
+	if (e1->target != e2->target) {
+		return (e1->target < e2->target ? -1 : 1);
+	}
+	if (e1->obj_class != e2->obj_class) {
+		return (e1->obj_class < e2->obj_class ? -1 : 1);
+	}
+	return 0;
+}
+
+/**
+ * Fill in an index's entries array, one entry per rule.
+ */
+static int avrule_index_load_rules(apol_avrule_index_t * idx, uint32_t rule_type)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(idx->policy);
+	qpol_iterator_t *iter = NULL;
+	const qpol_avrule_t *rule;
+	const qpol_type_t *source, *target;
+	const qpol_class_t *obj_class;
+	size_t num_rules, i = 0;
+	int retval = -1, error = 0;
+
+	if (qpol_policy_get_avrule_iter(q, rule_type, &iter) < 0 || qpol_iterator_get_size(iter, &num_rules) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	if (num_rules > 0 && (idx->entries = malloc(num_rules * sizeof(*idx->entries))) == NULL) {
+		error = errno;
+		ERR(idx->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter) && i < num_rules; qpol_iterator_next(iter)) {
+		avrule_index_entry_t *e = idx->entries + i;
+		if (qpol_iterator_get_item(iter, (void **)&rule) < 0 ||
+		    qpol_avrule_get_source_type(q, rule, &source) < 0 ||
+		    qpol_avrule_get_target_type(q, rule, &target) < 0 ||
+		    qpol_avrule_get_object_class(q, rule, &obj_class) < 0 ||
+		    qpol_type_get_value(q, source, &e->source) < 0 ||
+		    qpol_type_get_value(q, target, &e->target) < 0 || qpol_class_get_value(q, obj_class, &e->obj_class) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (e->source >= idx->num_types || e->target >= idx->num_types) {
+			ERR(idx->policy, "%s", "Rule references a type beyond the policy's type table.");
+			error = EIO;
+			goto cleanup;
+		}
+		e->rule = rule;
+		i++;
+	}
+	idx->num_entries = i;
+	retval = 0;
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (retval != 0) {
+		errno = error;
+	}
+	return retval;
+}
+
+/**
+ * Return one more than the largest type value within the policy.
+ */
+static int avrule_index_count_types(const apol_policy_t * p, uint32_t * num_types)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(p);
+	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *type;
+	uint32_t value;
+	*num_types = 1;
+	if (qpol_policy_get_type_iter(q, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&type) < 0 || qpol_type_get_value(q, type, &value) < 0) {
+			int error = errno;
+			qpol_iterator_destroy(&iter);
+			errno = error;
+			return -1;
+		}
+		if (value >= *num_types) {
+			*num_types = value + 1;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	return 0;
+}
+
+apol_avrule_index_t *apol_avrule_index_create(const apol_policy_t * p, uint32_t rule_type)
+{
+	apol_avrule_index_t *idx = NULL;
+	size_t i;
+	uint32_t s;
+	int error = 0;
+
+	if (p == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((idx = calloc(1, sizeof(*idx))) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		goto err;
+	}
+	idx->policy = p;
+	if (avrule_index_count_types(p, &idx->num_types) < 0 || avrule_index_load_rules(idx, rule_type) < 0) {
+		error = errno;
+		goto err;
+	}
+	qsort(idx->entries, idx->num_entries, sizeof(*idx->entries), avrule_index_entry_comp);
+	if ((idx->offsets = calloc(idx->num_types + 1, sizeof(*idx->offsets))) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		goto err;
+	}
+	/* entries are sorted by source, so a single sweep assigns the
+	 * start of each source's group */
+	for (i = 0, s = 0; s <= idx->num_types; s++) {
+		while (i < idx->num_entries && idx->entries[i].source < s) {
+			i++;
+		}
+		idx->offsets[s] = i;
+	}
+	return idx;
+      err:
+	apol_avrule_index_destroy(&idx);
+	errno = error;
+	return NULL;
+}
+
+void apol_avrule_index_destroy(apol_avrule_index_t ** idx)
+{
+	if (idx == NULL || *idx == NULL) {
+		return;
+	}
+	free((*idx)->entries);
+	free((*idx)->offsets);
+	free(*idx);
+	*idx = NULL;
+}
+
+size_t apol_avrule_index_get_size(const apol_avrule_index_t * idx)
+{
+	if (idx == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return idx->num_entries;
+}
+
+/**
+ * Append to a vector the value of a type followed by the values of
+ * all attributes containing it.  If the type is an attribute then
+ * only append its own value.
+ */
+static int avrule_index_get_candidates(const apol_avrule_index_t * idx, const qpol_type_t * type, apol_vector_t * v)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(idx->policy);
+	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *attr;
+	unsigned char isattr;
+	uint32_t value;
+	if (qpol_type_get_value(q, type, &value) < 0 || qpol_type_get_isattr(q, type, &isattr) < 0 ||
+	    apol_vector_append(v, (void *)((size_t) value)) < 0) {
+		return -1;
+	}
+	if (isattr) {
+		return 0;
+	}
+	if (qpol_type_get_attr_iter(q, type, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&attr) < 0 ||
+		    qpol_type_get_value(q, attr, &value) < 0 || apol_vector_append(v, (void *)((size_t) value)) < 0) {
+			int error = errno;
+			qpol_iterator_destroy(&iter);
+			errno = error;
+			return -1;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	return 0;
+}
+
+/**
+ * Return non-zero if a rule includes a permission.
+ */
+static int avrule_index_rule_has_perm(const apol_avrule_index_t * idx, const qpol_avrule_t * rule, const char *perm, int *has_perm)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(idx->policy);
+	qpol_iterator_t *iter = NULL;
+	char *name;
+	*has_perm = 0;
+	if (qpol_avrule_get_perm_iter(q, rule, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&name) < 0) {
+			int error = errno;
+			qpol_iterator_destroy(&iter);
+			errno = error;
+			return -1;
+		}
+		if (strcmp(name, perm) == 0) {
+			*has_perm = 1;
+			break;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	return 0;
+}
+
+/**
+ * Append the rules within a range of entries, optionally filtered by
+ * class and permission.
+ */
+static int avrule_index_append_range(const apol_avrule_index_t * idx, const avrule_index_entry_t * e,
+				     const avrule_index_entry_t * end, const avrule_index_entry_t * key, int match_target,
+				     int match_class, const char *perm, apol_vector_t * v)
+{
+	int has_perm;
+	for (; e < end; e++) {
+		if (match_target && e->target != key->target) {
+			break;
+		}
+		if (match_class && e->obj_class != key->obj_class) {
+			if (match_target) {
+				break;
+			}
+			continue;
+		}
+		if (perm != NULL) {
+			if (avrule_index_rule_has_perm(idx, e->rule, perm, &has_perm) < 0) {
+				return -1;
+			}
+			if (!has_perm) {
+				continue;
+			}
+		}
+		if (apol_vector_append(v, (void *)e->rule) < 0) {
+			ERR(idx->policy, "%s", strerror(errno));
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int apol_avrule_index_get_rules(const apol_avrule_index_t * idx, const qpol_type_t * source, const qpol_type_t * target,
+				const qpol_class_t * obj_class, const char *perm, apol_vector_t * v)
+{
+	apol_vector_t *sources = NULL, *targets = NULL;
+	avrule_index_entry_t key;
+	size_t i, j, lo, hi, mid;
+	int retval = -1, error = 0;
+
+	if (idx == NULL || source == NULL || v == NULL) {
+		ERR((idx ? idx->policy : NULL), "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	memset(&key, 0, sizeof(key));
+	if ((obj_class != NULL && qpol_class_get_value(apol_policy_get_qpol(idx->policy), obj_class, &key.obj_class) < 0) ||
+	    (sources = apol_vector_create(NULL)) == NULL || avrule_index_get_candidates(idx, source, sources) < 0 ||
+	    (target != NULL && ((targets = apol_vector_create(NULL)) == NULL || avrule_index_get_candidates(idx, target, targets) < 0))) {
+		error = errno;
+		ERR(idx->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < apol_vector_get_size(sources); i++) {
+		key.source = (uint32_t) ((size_t) apol_vector_get_element(sources, i));
+		if (key.source >= idx->num_types || idx->offsets[key.source] == idx->offsets[key.source + 1]) {
+			continue;
+		}
+		if (targets == NULL) {
+			/* any target, so scan the source's entire group */
+			if (avrule_index_append_range(idx, idx->entries + idx->offsets[key.source],
+						      idx->entries + idx->offsets[key.source + 1], &key, 0, obj_class != NULL, perm,
+						      v) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			continue;
+		}
+		for (j = 0; j < apol_vector_get_size(targets); j++) {
+			key.target = (uint32_t) ((size_t) apol_vector_get_element(targets, j));
+			/* find the first entry that is not less than the
+			 * key; if no class was given then the key's class is
+			 * 0, which precedes all valid class values */
+			lo = idx->offsets[key.source];
+			hi = idx->offsets[key.source + 1];
+			while (lo < hi) {
+				mid = lo + (hi - lo) / 2;
+				if (avrule_index_entry_comp(idx->entries + mid, &key) < 0) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			if (avrule_index_append_range(idx, idx->entries + lo, idx->entries + idx->offsets[key.source + 1], &key, 1,
+						      obj_class != NULL, perm, v) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+		}
+	}
+	retval = 0;
+      cleanup:
+	apol_vector_destroy(&sources);
+	apol_vector_destroy(&targets);
+	if (retval != 0) {
+		errno = error;
+	}
+	return retval;
+}
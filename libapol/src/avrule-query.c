@@ -44,7 +44,8 @@ struct apol_avrule_query
 /**
  *  Common semantic rule selection routine used in get*rule_by_query.
  *  @param p Policy to search.
- *  @param v Vector of rules to populate (of type qpol_avrule_t).
+ *  @param fn Function to invoke for each matching rule.
+ *  @param arg Argument to pass to fn.
  *  @param rule_type Mask of rules to search.
  *  @param flags Query options as specified by the apol_avrule_query.
  *  @param source_list If non-NULL, list of types to use as source.
@@ -57,9 +58,9 @@ struct apol_avrule_query
  *  If NULL, accept all permissions.
  *  @param bool_name If non-NULL, find conditional rules affected by this boolean.
  *  If NULL, all rules will be considered (including unconditional rules).
- *  @return 0 on success and < 0 on failure.
+ *  @return 0 on success, > 0 if fn stopped the search, and < 0 on failure.
  */
-static int rule_select(const apol_policy_t * p, apol_vector_t * v, uint32_t rule_type, unsigned int flags,
+static int rule_select(const apol_policy_t * p, apol_avrule_fn_t fn, void *arg, uint32_t rule_type, unsigned int flags,
 		       const apol_vector_t * source_list, const apol_vector_t * target_list, const apol_vector_t * class_list,
 		       const apol_vector_t * perm_list, const char *bool_name)
 {
@@ -68,7 +69,7 @@ static int rule_select(const apol_policy_t * p, apol_vector_t * v, uint32_t rule
 	const int is_regex = flags & APOL_QUERY_REGEX;
 	const int source_as_any = flags & APOL_QUERY_SOURCE_AS_ANY;
 	size_t num_perms_to_match = 1;
-	int retv = -1;
+	int retv = -1, stop;
 	regex_t *bool_regex = NULL;
 
 	if ((flags & APOL_QUERY_MATCH_ALL_PERMS) && perm_list != NULL) {
@@ -175,8 +176,8 @@ static int rule_select(const apol_policy_t * p, apol_vector_t * v, uint32_t rule
 			continue;
 		}
 
-		if (apol_vector_append(v, rule)) {
-			ERR(p, "%s", strerror(ENOMEM));
+		if ((stop = fn(arg, p, rule)) != 0) {
+			retv = stop;
 			goto cleanup;
 		}
 	}
@@ -189,14 +190,45 @@ static int rule_select(const apol_policy_t * p, apol_vector_t * v, uint32_t rule
 	return retv;
 }
 
+/**
+ *  Callback for rule_select() that appends each rule to a vector.
+ */
+static int avrule_append(void *arg, const apol_policy_t * p, const qpol_avrule_t * rule)
+{
+	apol_vector_t *v = (apol_vector_t *) arg;
+	if (apol_vector_append(v, (void *)rule)) {
+		ERR(p, "%s", strerror(ENOMEM));
+		return -1;
+	}
+	return 0;
+}
+
 int apol_avrule_get_by_query(const apol_policy_t * p, const apol_avrule_query_t * a, apol_vector_t ** v)
+{
+	if ((*v = apol_vector_create(NULL)) == NULL) {
+		ERR(p, "%s", strerror(errno));
+		return -1;
+	}
+	if (apol_avrule_foreach_by_query(p, a, avrule_append, *v) != 0) {
+		apol_vector_destroy(v);
+		return -1;
+	}
+	return 0;
+}
+
+int apol_avrule_foreach_by_query(const apol_policy_t * p, const apol_avrule_query_t * a, apol_avrule_fn_t fn, void *arg)
 {
 	apol_vector_t *source_list = NULL, *target_list = NULL, *class_list = NULL, *perm_list = NULL;
 	int retval = -1, source_as_any = 0, is_regex = 0;
 	char *bool_name = NULL;
-	*v = NULL;
 	unsigned int flags = 0;
 
+	if (p == NULL || fn == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+
 	uint32_t rule_type = QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT;
 //	if (qpol_policy_has_capability(apol_policy_get_qpol(p), QPOL_CAP_NEVERALLOW)) {
 		rule_type |= QPOL_RULE_NEVERALLOW;
@@ -238,20 +270,8 @@ int apol_avrule_get_by_query(const apol_policy_t * p, const apol_avrule_query_t
 		}
 	}
 
-	if ((*v = apol_vector_create(NULL)) == NULL) {
-		ERR(p, "%s", strerror(errno));
-		goto cleanup;
-	}
-
-	if (rule_select(p, *v, rule_type, flags, source_list, target_list, class_list, perm_list, bool_name)) {
-		goto cleanup;
-	}
-
-	retval = 0;
+	retval = rule_select(p, fn, arg, rule_type, flags, source_list, target_list, class_list, perm_list, bool_name);
       cleanup:
-	if (retval != 0) {
-		apol_vector_destroy(v);
-	}
 	apol_vector_destroy(&source_list);
 	if (!source_as_any) {
 		apol_vector_destroy(&target_list);
@@ -261,6 +281,276 @@ int apol_avrule_get_by_query(const apol_policy_t * p, const apol_avrule_query_t
 	return retval;
 }
 
+/** A query within a batch, with its symbols already looked up. */
+typedef struct avrule_batch_query
+{
+	uint32_t rule_type;
+	unsigned int flags;
+	/** candidate maps; NULL to accept any value.  The type maps are
+	 *  owned by the batch's cache. */
+	const apol_query_value_map_t *source, *target;
+	apol_query_value_map_t *classes;
+	/** permission names, or NULL to accept any */
+	apol_vector_t *perms;
+	char *bool_name;
+	regex_t *bool_regex;
+} avrule_batch_query_t;
+
+struct apol_avrule_batch
+{
+	const apol_policy_t *p;
+	/** vector of avrule_batch_query_t */
+	apol_vector_t *queries;
+	apol_query_type_cache_t *cache;
+	/** union of the queries' rule types */
+	uint32_t rule_type;
+};
+
+static void avrule_batch_query_free(void *elem)
+{
+	avrule_batch_query_t *q = elem;
+	if (q != NULL) {
+		apol_query_value_map_destroy(&q->classes);
+		apol_vector_destroy(&q->perms);
+		free(q->bool_name);
+		apol_regex_destroy(&q->bool_regex);
+		free(q);
+	}
+}
+
+apol_avrule_batch_t *apol_avrule_batch_create(const apol_policy_t * p)
+{
+	apol_avrule_batch_t *b = NULL;
+	int error;
+	if (p == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((b = calloc(1, sizeof(*b))) == NULL || (b->queries = apol_vector_create(avrule_batch_query_free)) == NULL ||
+	    (b->cache = apol_query_type_cache_create()) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		apol_avrule_batch_destroy(&b);
+		errno = error;
+		return NULL;
+	}
+	b->p = p;
+	return b;
+}
+
+void apol_avrule_batch_destroy(apol_avrule_batch_t ** b)
+{
+	if (b != NULL && *b != NULL) {
+		apol_vector_destroy(&(*b)->queries);
+		apol_query_type_cache_destroy(&(*b)->cache);
+		free(*b);
+		*b = NULL;
+	}
+}
+
+int apol_avrule_batch_append(apol_avrule_batch_t * b, const apol_avrule_query_t * a)
+{
+	avrule_batch_query_t *q = NULL;
+	apol_vector_t *class_list = NULL;
+	int error = 0, is_regex;
+
+	if (b == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((q = calloc(1, sizeof(*q))) == NULL) {
+		error = errno;
+		ERR(b->p, "%s", strerror(error));
+		goto err;
+	}
+	q->rule_type = QPOL_RULE_ALLOW | QPOL_RULE_NEVERALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT;
+	if (a != NULL) {
+		if (a->rules != 0) {
+			q->rule_type &= a->rules;
+		}
+		q->flags = a->flags;
+		is_regex = a->flags & APOL_QUERY_REGEX;
+		if (a->source != NULL &&
+		    (q->source =
+		     apol_query_type_cache_get(b->p, b->cache, a->source, is_regex, a->flags & APOL_QUERY_SOURCE_INDIRECT,
+					       ((a->flags & (APOL_QUERY_SOURCE_TYPE | APOL_QUERY_SOURCE_ATTRIBUTE)) /
+						APOL_QUERY_SOURCE_TYPE))) == NULL) {
+			error = errno;
+			goto err;
+		}
+		if ((a->flags & APOL_QUERY_SOURCE_AS_ANY) && a->source != NULL) {
+			q->target = q->source;
+		} else if (a->target != NULL &&
+			   (q->target =
+			    apol_query_type_cache_get(b->p, b->cache, a->target, is_regex, a->flags & APOL_QUERY_TARGET_INDIRECT,
+						      ((a->flags & (APOL_QUERY_TARGET_TYPE | APOL_QUERY_TARGET_ATTRIBUTE)) /
+						       APOL_QUERY_TARGET_TYPE))) == NULL) {
+			error = errno;
+			goto err;
+		}
+		if (a->classes != NULL && apol_vector_get_size(a->classes) > 0) {
+			if ((class_list = apol_query_create_candidate_class_list(b->p, a->classes)) == NULL ||
+			    (q->classes = apol_query_value_map_create(b->p, class_list, 1)) == NULL) {
+				error = errno;
+				goto err;
+			}
+			apol_vector_destroy(&class_list);
+		}
+		if (a->perms != NULL && apol_vector_get_size(a->perms) > 0 &&
+		    (q->perms = apol_vector_create_from_vector(a->perms, apol_str_strdup, NULL, free)) == NULL) {
+			error = errno;
+			ERR(b->p, "%s", strerror(error));
+			goto err;
+		}
+		if (a->bool_name != NULL && (q->bool_name = strdup(a->bool_name)) == NULL) {
+			error = errno;
+			ERR(b->p, "%s", strerror(error));
+			goto err;
+		}
+	}
+	if (apol_vector_append(b->queries, q) < 0) {
+		error = errno;
+		ERR(b->p, "%s", strerror(error));
+		goto err;
+	}
+	b->rule_type |= q->rule_type;
+	return 0;
+      err:
+	apol_vector_destroy(&class_list);
+	avrule_batch_query_free(q);
+	errno = error;
+	return -1;
+}
+
+size_t apol_avrule_batch_get_size(const apol_avrule_batch_t * b)
+{
+	if (b == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return apol_vector_get_size(b->queries);
+}
+
+/**
+ * Determine if a rule matches one batched query.  This applies the
+ * same tests as rule_select(), but against the rule's values, which
+ * the caller has already fetched.
+ *
+ * @return > 0 if the rule matches, 0 if not, < 0 on error.
+ */
+static int avrule_batch_query_match(const apol_policy_t * p, avrule_batch_query_t * q, const qpol_avrule_t * rule,
+				    uint32_t rule_type, uint32_t is_enabled, const qpol_cond_t * cond, uint32_t source,
+				    uint32_t target, uint32_t obj_class)
+{
+	const int source_as_any = q->flags & APOL_QUERY_SOURCE_AS_ANY;
+	qpol_iterator_t *perm_iter = NULL;
+	size_t i, match_perm = 0, num_perms_to_match = 1;
+	int match_source;
+
+	if (!(rule_type & q->rule_type)) {
+		return 0;
+	}
+	if (!is_enabled && (q->flags & APOL_QUERY_ONLY_ENABLED)) {
+		return 0;
+	}
+	if (q->bool_name != NULL) {
+		int match_bool;
+		if (cond == NULL) {
+			return 0;
+		}
+		if ((match_bool = apol_compare_cond_expr(p, cond, q->bool_name, q->flags & APOL_QUERY_REGEX, &q->bool_regex)) <= 0) {
+			return match_bool;
+		}
+	}
+	match_source = (q->source == NULL || apol_query_value_map_has(q->source, source));
+	if (!source_as_any && !match_source) {
+		return 0;
+	}
+	if (!(q->target == NULL || (source_as_any && match_source) || apol_query_value_map_has(q->target, target))) {
+		return 0;
+	}
+	if (q->classes != NULL && !apol_query_value_map_has(q->classes, obj_class)) {
+		return 0;
+	}
+	if (q->perms != NULL) {
+		if (q->flags & APOL_QUERY_MATCH_ALL_PERMS) {
+			num_perms_to_match = apol_vector_get_size(q->perms);
+		}
+		for (i = 0; i < apol_vector_get_size(q->perms) && match_perm < num_perms_to_match; i++) {
+			int match;
+			if (qpol_avrule_get_perm_iter(p->p, rule, &perm_iter) < 0) {
+				return -1;
+			}
+			match = apol_compare_iter(p, perm_iter, apol_vector_get_element(q->perms, i), 0, NULL, 1);
+			qpol_iterator_destroy(&perm_iter);
+			if (match < 0) {
+				return -1;
+			} else if (match > 0) {
+				match_perm++;
+			}
+		}
+		if (match_perm < num_perms_to_match) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int apol_avrule_batch_run(apol_avrule_batch_t * b, apol_avrule_batch_fn_t fn, void *arg)
+{
+	qpol_iterator_t *iter = NULL;
+	const apol_policy_t *p;
+	size_t i, num_queries;
+	int retv = -1, stop;
+
+	if (b == NULL || fn == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	p = b->p;
+	if ((num_queries = apol_vector_get_size(b->queries)) == 0) {
+		return 0;
+	}
+	if (qpol_policy_get_avrule_iter(p->p, b->rule_type, &iter) < 0) {
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		qpol_avrule_t *rule;
+		const qpol_type_t *source_type, *target_type;
+		const qpol_class_t *obj_class;
+		const qpol_cond_t *cond;
+		uint32_t rule_type, is_enabled, source, target, class_value;
+		if (qpol_iterator_get_item(iter, (void **)&rule) < 0 ||
+		    qpol_avrule_get_rule_type(p->p, rule, &rule_type) < 0 ||
+		    qpol_avrule_get_is_enabled(p->p, rule, &is_enabled) < 0 ||
+		    qpol_avrule_get_cond(p->p, rule, &cond) < 0 ||
+		    qpol_avrule_get_source_type(p->p, rule, &source_type) < 0 ||
+		    qpol_type_get_value(p->p, source_type, &source) < 0 ||
+		    qpol_avrule_get_target_type(p->p, rule, &target_type) < 0 ||
+		    qpol_type_get_value(p->p, target_type, &target) < 0 ||
+		    qpol_avrule_get_object_class(p->p, rule, &obj_class) < 0 ||
+		    qpol_class_get_value(p->p, obj_class, &class_value) < 0) {
+			goto cleanup;
+		}
+		for (i = 0; i < num_queries; i++) {
+			int match = avrule_batch_query_match(p, apol_vector_get_element(b->queries, i), rule, rule_type,
+							     is_enabled, cond, source, target, class_value);
+			if (match < 0) {
+				goto cleanup;
+			}
+			if (match > 0 && (stop = fn(arg, p, i, rule)) != 0) {
+				retv = stop;
+				goto cleanup;
+			}
+		}
+	}
+	retv = 0;
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	return retv;
+}
+
 int apol_syn_avrule_get_by_query(const apol_policy_t * p, const apol_avrule_query_t * a, apol_vector_t ** v)
 {
 	qpol_iterator_t *iter = NULL, *perm_iter = NULL;
@@ -322,7 +612,7 @@ int apol_syn_avrule_get_by_query(const apol_policy_t * p, const apol_avrule_quer
 		goto cleanup;
 	}
 
-	if (rule_select(p, *v, rule_type, flags, source_list, target_list, class_list, perm_list, bool_name)) {
+	if (rule_select(p, avrule_append, *v, rule_type, flags, source_list, target_list, class_list, perm_list, bool_name)) {
 		goto cleanup;
 	}
 
@@ -738,85 +1028,43 @@ apol_vector_t *apol_avrule_list_to_syn_avrules(const apol_policy_t * p, const ap
 	return v;
 }
 
-char *apol_avrule_render(const apol_policy_t * policy, const qpol_avrule_t * rule)
+int apol_avrule_render_file(const apol_policy_t * policy, const qpol_avrule_t * rule, FILE * fp)
 {
-	char *tmp = NULL;
-	const char *rule_type_str, *tmp_name = NULL;
+	const char *rule_type_str, *source_name, *target_name, *class_name;
 	int error = 0;
 	uint32_t rule_type = 0;
 	const qpol_type_t *type = NULL;
 	const qpol_class_t *obj_class = NULL;
 	qpol_iterator_t *iter = NULL;
-	size_t tmp_sz = 0, num_perms = 0;
+	size_t num_perms = 0;
 
-	if (!policy || !rule) {
+	if (!policy || !rule || !fp) {
 		ERR(policy, "%s", strerror(EINVAL));
 		errno = EINVAL;
-		return NULL;
+		return -1;
 	}
 
 	/* rule type */
 	if (qpol_avrule_get_rule_type(policy->p, rule, &rule_type)) {
-		return NULL;
+		return -1;
 	}
 	if (!(rule_type &= (QPOL_RULE_ALLOW | QPOL_RULE_NEVERALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT))) {
 		ERR(policy, "%s", "Invalid AV rule type");
 		errno = EINVAL;
-		return NULL;
+		return -1;
 	}
 	if (!(rule_type_str = apol_rule_type_to_str(rule_type))) {
 		ERR(policy, "%s", "Could not get AV rule type's string");
 		errno = EINVAL;
-		return NULL;
-	}
-	if (apol_str_appendf(&tmp, &tmp_sz, "%s ", rule_type_str)) {
-		error = errno;
-		ERR(policy, "%s", strerror(error));
-		goto err;
-	}
-
-	/* source type */
-	if (qpol_avrule_get_source_type(policy->p, rule, &type)) {
-		error = errno;
-		goto err;
-	}
-	if (qpol_type_get_name(policy->p, type, &tmp_name)) {
-		error = errno;
-		goto err;
-	}
-	if (apol_str_appendf(&tmp, &tmp_sz, "%s ", tmp_name)) {
-		error = errno;
-		ERR(policy, "%s", strerror(error));
-		goto err;
-	}
-
-	/* target type */
-	if (qpol_avrule_get_target_type(policy->p, rule, &type)) {
-		error = errno;
-		goto err;
-	}
-	if (qpol_type_get_name(policy->p, type, &tmp_name)) {
-		error = errno;
-		goto err;
-	}
-	if (apol_str_appendf(&tmp, &tmp_sz, "%s : ", tmp_name)) {
-		error = errno;
-		ERR(policy, "%s", strerror(error));
-		goto err;
+		return -1;
 	}
 
-	/* object class */
-	if (qpol_avrule_get_object_class(policy->p, rule, &obj_class)) {
-		error = errno;
-		goto err;
-	}
-	if (qpol_class_get_name(policy->p, obj_class, &tmp_name)) {
-		error = errno;
-		goto err;
-	}
-	if (apol_str_appendf(&tmp, &tmp_sz, "%s ", tmp_name)) {
+	/* source type, target type, and object class */
+	if (qpol_avrule_get_source_type(policy->p, rule, &type) || qpol_type_get_name(policy->p, type, &source_name) ||
+	    qpol_avrule_get_target_type(policy->p, rule, &type) || qpol_type_get_name(policy->p, type, &target_name) ||
+	    qpol_avrule_get_object_class(policy->p, rule, &obj_class) ||
+	    qpol_class_get_name(policy->p, obj_class, &class_name)) {
 		error = errno;
-		ERR(policy, "%s", strerror(error));
 		goto err;
 	}
 
@@ -830,12 +1078,10 @@ char *apol_avrule_render(const apol_policy_t * policy, const qpol_avrule_t * rul
 		ERR(policy, "%s", strerror(error));
 		goto err;
 	}
-	if (num_perms > 1) {
-		if (apol_str_append(&tmp, &tmp_sz, "{ ")) {
-			error = errno;
-			ERR(policy, "%s", strerror(error));
-			goto err;
-		}
+	if (fprintf(fp, "%s %s %s : %s %s", rule_type_str, source_name, target_name, class_name, (num_perms > 1 ? "{ " : "")) < 0) {
+		error = errno;
+		ERR(policy, "%s", strerror(error));
+		goto err;
 	}
 	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
 		char *perm_name = NULL;
@@ -844,37 +1090,62 @@ char *apol_avrule_render(const apol_policy_t * policy, const qpol_avrule_t * rul
 			ERR(policy, "%s", strerror(error));
 			goto err;
 		}
-		if (apol_str_appendf(&tmp, &tmp_sz, "%s ", perm_name)) {
+		if (fputs(perm_name, fp) == EOF || putc(' ', fp) == EOF) {
 			error = errno;
 			free(perm_name);
 			ERR(policy, "%s", strerror(error));
 			goto err;
 		}
 		free(perm_name);
-		tmp_name = NULL;
-	}
-	if (num_perms > 1) {
-		if (apol_str_append(&tmp, &tmp_sz, "} ")) {
-			error = errno;
-			ERR(policy, "%s", strerror(error));
-			goto err;
-		}
 	}
-
-	if (apol_str_append(&tmp, &tmp_sz, ";")) {
+	if (fputs((num_perms > 1 ? "} ;" : ";"), fp) == EOF) {
 		error = errno;
 		ERR(policy, "%s", strerror(error));
 		goto err;
 	}
 
 	qpol_iterator_destroy(&iter);
-	return tmp;
+	return 0;
 
       err:
-	free(tmp);
 	qpol_iterator_destroy(&iter);
 	errno = error;
-	return NULL;
+	return -1;
+}
+
+char *apol_avrule_render(const apol_policy_t * policy, const qpol_avrule_t * rule)
+{
+	char *tmp = NULL;
+	size_t tmp_sz = 0;
+	FILE *fp;
+	int error;
+
+	if (!policy || !rule) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((fp = open_memstream(&tmp, &tmp_sz)) == NULL) {
+		error = errno;
+		ERR(policy, "%s", strerror(error));
+		errno = error;
+		return NULL;
+	}
+	if (apol_avrule_render_file(policy, rule, fp) < 0) {
+		error = errno;
+		fclose(fp);
+		free(tmp);
+		errno = error;
+		return NULL;
+	}
+	if (fclose(fp) != 0) {
+		error = errno;
+		ERR(policy, "%s", strerror(error));
+		free(tmp);
+		errno = error;
+		return NULL;
+	}
+	return tmp;
 }
 
 char *apol_syn_avrule_render(const apol_policy_t * policy, const qpol_syn_avrule_t * rule)
@@ -325,3 +325,55 @@ int apol_perm_query_set_regex(const apol_policy_t * p, apol_perm_query_t * pq, i
 {
 	return apol_query_set_regex(p, &pq->flags, is_regex);
 }
+
+apol_vector_t *class_perm_get_numbered(const apol_policy_t * p, const qpol_class_t * obj_class)
+{
+	const qpol_common_t *common;
+	qpol_iterator_t *iter = NULL;
+	apol_vector_t *perms = NULL;
+	char *perm;
+	int pass, error = 0;
+
+	if (qpol_class_get_common(p->p, obj_class, &common) < 0) {
+		return NULL;
+	}
+	if ((perms = apol_vector_create(NULL)) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (pass = 0; pass < 2; pass++) {
+		if (pass == 0) {
+			if (common == NULL) {
+				continue;
+			}
+			if (qpol_common_get_perm_iter(p->p, common, &iter) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+		} else if (qpol_class_get_perm_iter(p->p, obj_class, &iter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+			if (qpol_iterator_get_item(iter, (void **)&perm) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			if (apol_vector_append(perms, perm) < 0) {
+				error = errno;
+				ERR(p, "%s", strerror(error));
+				goto cleanup;
+			}
+		}
+		qpol_iterator_destroy(&iter);
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		apol_vector_destroy(&perms);
+		errno = error;
+		return NULL;
+	}
+	return perms;
+}
@@ -0,0 +1,616 @@
+/**
+ * @file
+ * Implementation of boolean what-if queries over conditional rules.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "policy-query-internal.h"
+#include <apol/cond-whatif.h>
+#include <qpol/avrule_query.h>
+#include <qpol/bool_query.h>
+#include <qpol/cond_query.h>
+#include <qpol/terule_query.h>
+#include <qpol/util.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Deepest expression the evaluator's stack holds. */
+#define COND_WHATIF_MAX_DEPTH 64
+
+#define COND_WHATIF_AV_MASK (QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT)
+#define COND_WHATIF_TE_MASK (QPOL_RULE_TYPE_TRANS | QPOL_RULE_TYPE_CHANGE | QPOL_RULE_TYPE_MEMBER)
+
+/** One step of a conditional expression, in the policy's own postfix
+ *  order; arg is the boolean's index for QPOL_COND_EXPR_BOOL. */
+typedef struct cond_whatif_insn
+{
+	uint32_t expr_type;
+	uint32_t arg;
+} cond_whatif_insn_t;
+
+typedef struct cond_whatif_cond
+{
+	size_t first_insn, num_insns;
+	/** the expression's value under the baseline assignment */
+	int baseline;
+	apol_vector_t *av_true, *av_false, *te_true, *te_false;
+} cond_whatif_cond_t;
+
+struct apol_cond_index
+{
+	const apol_policy_t *policy;
+	/** the booleans' states when the index was built, by value - 1 */
+	unsigned char *baseline;
+	size_t num_bools;
+	cond_whatif_insn_t *insns;
+	size_t num_insns, insns_cap;
+	cond_whatif_cond_t *conds;
+	size_t num_conds;
+	/** the expressions that depend upon boolean i are
+	 *  deps[dep_first[i], dep_first[i + 1]) */
+	size_t *dep_first;
+	uint32_t *deps;
+};
+
+/**
+ * Evaluate a compiled expression under an assignment.
+ */
+static int cond_whatif_eval(const apol_cond_index_t * idx, const cond_whatif_cond_t * c, const unsigned char *states)
+{
+	const cond_whatif_insn_t *insn = idx->insns + c->first_insn, *end = insn + c->num_insns;
+	uint64_t stack = 0;
+	uint64_t top;
+	for (; insn < end; insn++) {
+		switch (insn->expr_type) {
+		case QPOL_COND_EXPR_BOOL:
+			stack = (stack << 1) | (states[insn->arg] != 0);
+			break;
+		case QPOL_COND_EXPR_NOT:
+			stack ^= 1;
+			break;
+		default:
+			top = stack & 1;
+			stack >>= 1;
+			switch (insn->expr_type) {
+			case QPOL_COND_EXPR_OR:
+				stack |= top;
+				break;
+			case QPOL_COND_EXPR_AND:
+				stack &= ~(uint64_t) 1 | top;
+				break;
+			case QPOL_COND_EXPR_XOR:
+			case QPOL_COND_EXPR_NEQ:
+				stack ^= top;
+				break;
+			case QPOL_COND_EXPR_EQ:
+				stack ^= top ^ 1;
+				break;
+			}
+		}
+	}
+	return (int)(stack & 1);
+}
+
+static int cond_whatif_get_bools(apol_cond_index_t * idx)
+{
+	qpol_policy_t *q = idx->policy->p;
+	qpol_iterator_t *iter = NULL;
+	const qpol_bool_t *b;
+	uint32_t value;
+	size_t size;
+	int state, error = 0;
+
+	if (qpol_policy_get_bool_iter(q, &iter) < 0 || qpol_iterator_get_size(iter, &size) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	if (size > 0 && (idx->baseline = calloc(size, sizeof(*idx->baseline))) == NULL) {
+		error = errno;
+		ERR(idx->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	idx->num_bools = size;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&b) < 0 || qpol_bool_get_value(q, b, &value) < 0 ||
+		    qpol_bool_get_state(q, b, &state) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (value == 0 || value > size) {
+			error = EILSEQ;
+			ERR(idx->policy, "%s", strerror(error));
+			goto cleanup;
+		}
+		idx->baseline[value - 1] = (state != 0);
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Append a conditional expression's postfix steps to the index,
+ * checking that they fit within the evaluator's stack.
+ */
+static int cond_whatif_compile(apol_cond_index_t * idx, const qpol_cond_t * cond, cond_whatif_cond_t * c)
+{
+	qpol_policy_t *q = idx->policy->p;
+	qpol_iterator_t *iter = NULL;
+	const qpol_cond_expr_node_t *node;
+	qpol_bool_t *b;
+	uint32_t expr_type, value;
+	size_t depth = 0;
+	int error = 0;
+
+	c->first_insn = idx->num_insns;
+	if (qpol_cond_get_expr_node_iter(q, cond, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&node) < 0 || qpol_cond_expr_node_get_expr_type(q, node, &expr_type) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (idx->num_insns >= idx->insns_cap) {
+			size_t new_cap = (idx->insns_cap == 0 ? 256 : idx->insns_cap * 2);
+			cond_whatif_insn_t *insns;
+			if ((insns = realloc(idx->insns, new_cap * sizeof(*insns))) == NULL) {
+				error = errno;
+				ERR(idx->policy, "%s", strerror(error));
+				goto cleanup;
+			}
+			idx->insns = insns;
+			idx->insns_cap = new_cap;
+		}
+		idx->insns[idx->num_insns].expr_type = expr_type;
+		idx->insns[idx->num_insns].arg = 0;
+		if (expr_type == QPOL_COND_EXPR_BOOL) {
+			if (qpol_cond_expr_node_get_bool(q, node, &b) < 0 || qpol_bool_get_value(q, b, &value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			if (value == 0 || value > idx->num_bools || ++depth > COND_WHATIF_MAX_DEPTH) {
+				error = (value == 0 || value > idx->num_bools ? EILSEQ : EOVERFLOW);
+				ERR(idx->policy, "%s", strerror(error));
+				goto cleanup;
+			}
+			idx->insns[idx->num_insns].arg = value - 1;
+		} else if (expr_type != QPOL_COND_EXPR_NOT) {
+			if (expr_type < QPOL_COND_EXPR_OR || expr_type > QPOL_COND_EXPR_NEQ || depth < 2) {
+				error = EILSEQ;
+				ERR(idx->policy, "%s", strerror(error));
+				goto cleanup;
+			}
+			depth--;
+		} else if (depth < 1) {
+			error = EILSEQ;
+			ERR(idx->policy, "%s", strerror(error));
+			goto cleanup;
+		}
+		idx->num_insns++;
+	}
+	if (depth != 1) {
+		error = EILSEQ;
+		ERR(idx->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	c->num_insns = idx->num_insns - c->first_insn;
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Copy the rules of one of a conditional expression's lists into a
+ * new vector.
+ */
+static apol_vector_t *cond_whatif_get_rules(apol_cond_index_t * idx, const qpol_cond_t * cond,
+					    int (*get_iter) (const qpol_policy_t *, const qpol_cond_t *, uint32_t,
+							     qpol_iterator_t **), uint32_t mask)
+{
+	qpol_iterator_t *iter = NULL;
+	apol_vector_t *v = NULL;
+	int error;
+
+	if (get_iter(idx->policy->p, cond, mask, &iter) < 0) {
+		return NULL;
+	}
+	if ((v = apol_vector_create_from_iter(iter, NULL)) == NULL) {
+		error = errno;
+		ERR(idx->policy, "%s", strerror(error));
+		qpol_iterator_destroy(&iter);
+		errno = error;
+		return NULL;
+	}
+	qpol_iterator_destroy(&iter);
+	return v;
+}
+
+static int cond_whatif_get_conds(apol_cond_index_t * idx)
+{
+	qpol_policy_t *q = idx->policy->p;
+	qpol_iterator_t *iter = NULL;
+	const qpol_cond_t *cond;
+	cond_whatif_cond_t *c;
+	size_t size;
+	int error = 0;
+
+	if (qpol_policy_get_cond_iter(q, &iter) < 0 || qpol_iterator_get_size(iter, &size) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	if (size > 0 && (idx->conds = calloc(size, sizeof(*idx->conds))) == NULL) {
+		error = errno;
+		ERR(idx->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter) && idx->num_conds < size; qpol_iterator_next(iter)) {
+		c = idx->conds + idx->num_conds;
+		if (qpol_iterator_get_item(iter, (void **)&cond) < 0 || cond_whatif_compile(idx, cond, c) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		/* count the expression now, so that its vectors are
+		 * destroyed along with the index should one fail */
+		idx->num_conds++;
+		if ((c->av_true = cond_whatif_get_rules(idx, cond, qpol_cond_get_av_true_iter, COND_WHATIF_AV_MASK)) == NULL ||
+		    (c->av_false = cond_whatif_get_rules(idx, cond, qpol_cond_get_av_false_iter, COND_WHATIF_AV_MASK)) == NULL ||
+		    (c->te_true = cond_whatif_get_rules(idx, cond, qpol_cond_get_te_true_iter, COND_WHATIF_TE_MASK)) == NULL ||
+		    (c->te_false = cond_whatif_get_rules(idx, cond, qpol_cond_get_te_false_iter, COND_WHATIF_TE_MASK)) == NULL) {
+			error = errno;
+			goto cleanup;
+		}
+		c->baseline = cond_whatif_eval(idx, c, idx->baseline);
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Record which expressions depend upon each boolean.  An expression
+ * that names a boolean more than once is recorded only once.
+ */
+static int cond_whatif_get_deps(apol_cond_index_t * idx)
+{
+	const cond_whatif_insn_t *insn;
+	size_t i, j, k, num_deps = 0;
+	int error;
+
+	if ((idx->dep_first = calloc(idx->num_bools + 1, sizeof(*idx->dep_first))) == NULL ||
+	    (idx->num_insns > 0 && (idx->deps = malloc(idx->num_insns * sizeof(*idx->deps))) == NULL)) {
+		error = errno;
+		ERR(idx->policy, "%s", strerror(error));
+		errno = error;
+		return -1;
+	}
+	/* first pass counts, second pass fills; a boolean named again
+	 * within the same expression is skipped both times */
+	for (i = 0; i < idx->num_conds; i++) {
+		insn = idx->insns + idx->conds[i].first_insn;
+		for (j = 0; j < idx->conds[i].num_insns; j++) {
+			if (insn[j].expr_type != QPOL_COND_EXPR_BOOL) {
+				continue;
+			}
+			for (k = 0; k < j; k++) {
+				if (insn[k].expr_type == QPOL_COND_EXPR_BOOL && insn[k].arg == insn[j].arg) {
+					break;
+				}
+			}
+			if (k == j) {
+				idx->dep_first[insn[j].arg + 1]++;
+				num_deps++;
+			}
+		}
+	}
+	for (i = 1; i <= idx->num_bools; i++) {
+		idx->dep_first[i] += idx->dep_first[i - 1];
+	}
+	for (i = idx->num_conds; i > 0; i--) {
+		insn = idx->insns + idx->conds[i - 1].first_insn;
+		for (j = 0; j < idx->conds[i - 1].num_insns; j++) {
+			if (insn[j].expr_type != QPOL_COND_EXPR_BOOL) {
+				continue;
+			}
+			for (k = 0; k < j; k++) {
+				if (insn[k].expr_type == QPOL_COND_EXPR_BOOL && insn[k].arg == insn[j].arg) {
+					break;
+				}
+			}
+			if (k == j) {
+				idx->deps[--idx->dep_first[insn[j].arg + 1]] = (uint32_t) (i - 1);
+			}
+		}
+	}
+	/* the fill above moved each count back to its list's start */
+	memmove(idx->dep_first, idx->dep_first + 1, idx->num_bools * sizeof(*idx->dep_first));
+	idx->dep_first[idx->num_bools] = num_deps;
+	return 0;
+}
+
+apol_cond_index_t *apol_cond_index_create(const apol_policy_t * p)
+{
+	apol_cond_index_t *idx = NULL;
+	int error;
+
+	if (p == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return NULL;
+	}
+	if (!qpol_policy_has_capability(p->p, QPOL_CAP_RULES_LOADED)) {
+		ERR(p, "%s", "Conditional rules have not been loaded.");
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((idx = calloc(1, sizeof(*idx))) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		errno = error;
+		return NULL;
+	}
+	idx->policy = p;
+	if (cond_whatif_get_bools(idx) < 0 || cond_whatif_get_conds(idx) < 0 || cond_whatif_get_deps(idx) < 0) {
+		error = errno;
+		apol_cond_index_destroy(&idx);
+		errno = error;
+		return NULL;
+	}
+	return idx;
+}
+
+void apol_cond_index_destroy(apol_cond_index_t ** idx)
+{
+	size_t i;
+	if (idx == NULL || *idx == NULL) {
+		return;
+	}
+	for (i = 0; i < (*idx)->num_conds; i++) {
+		apol_vector_destroy(&(*idx)->conds[i].av_true);
+		apol_vector_destroy(&(*idx)->conds[i].av_false);
+		apol_vector_destroy(&(*idx)->conds[i].te_true);
+		apol_vector_destroy(&(*idx)->conds[i].te_false);
+	}
+	free((*idx)->conds);
+	free((*idx)->insns);
+	free((*idx)->baseline);
+	free((*idx)->dep_first);
+	free((*idx)->deps);
+	free(*idx);
+	*idx = NULL;
+}
+
+size_t apol_cond_index_get_num_bools(const apol_cond_index_t * idx)
+{
+	if (idx == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return idx->num_bools;
+}
+
+int apol_cond_index_get_bool_index(const apol_cond_index_t * idx, const char *name, size_t * i)
+{
+	qpol_bool_t *b;
+	uint32_t value;
+	if (idx == NULL || name == NULL || i == NULL) {
+		ERR(idx == NULL ? NULL : idx->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (qpol_policy_get_bool_by_name(idx->policy->p, name, &b) < 0 || qpol_bool_get_value(idx->policy->p, b, &value) < 0) {
+		return -1;
+	}
+	*i = value - 1;
+	return 0;
+}
+
+int apol_cond_index_get_baseline(const apol_cond_index_t * idx, unsigned char *states)
+{
+	if (idx == NULL || (states == NULL && idx->num_bools > 0)) {
+		ERR(idx == NULL ? NULL : idx->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (idx->num_bools > 0) {
+		memcpy(states, idx->baseline, idx->num_bools * sizeof(*states));
+	}
+	return 0;
+}
+
+void apol_cond_delta_destroy(apol_cond_delta_t ** delta)
+{
+	if (delta == NULL || *delta == NULL) {
+		return;
+	}
+	apol_vector_destroy(&(*delta)->avrules_enabled);
+	apol_vector_destroy(&(*delta)->avrules_disabled);
+	apol_vector_destroy(&(*delta)->terules_enabled);
+	apol_vector_destroy(&(*delta)->terules_disabled);
+	free(*delta);
+	*delta = NULL;
+}
+
+/**
+ * Compute one delta.  Only the expressions that depend upon a
+ * boolean whose state differs from the baseline are evaluated; seen
+ * marks those already evaluated, and must be all zero on entry.  It
+ * is cleared again before returning.
+ */
+static apol_cond_delta_t *cond_whatif_delta(const apol_cond_index_t * idx, const unsigned char *states, unsigned char *seen)
+{
+	apol_cond_delta_t *delta = NULL;
+	const cond_whatif_cond_t *c;
+	size_t i, j;
+	int error = 0;
+
+	if ((delta = calloc(1, sizeof(*delta))) == NULL ||
+	    (delta->avrules_enabled = apol_vector_create(NULL)) == NULL ||
+	    (delta->avrules_disabled = apol_vector_create(NULL)) == NULL ||
+	    (delta->terules_enabled = apol_vector_create(NULL)) == NULL ||
+	    (delta->terules_disabled = apol_vector_create(NULL)) == NULL) {
+		error = errno;
+		goto cleanup;
+	}
+	for (i = 0; i < idx->num_bools; i++) {
+		if ((states[i] != 0) == idx->baseline[i]) {
+			continue;
+		}
+		for (j = idx->dep_first[i]; j < idx->dep_first[i + 1]; j++) {
+			if (seen[idx->deps[j]]) {
+				continue;
+			}
+			seen[idx->deps[j]] = 1;
+			c = idx->conds + idx->deps[j];
+			if (cond_whatif_eval(idx, c, states) == c->baseline) {
+				continue;
+			}
+			if ((apol_vector_cat(delta->avrules_enabled, c->baseline ? c->av_false : c->av_true) < 0) ||
+			    (apol_vector_cat(delta->avrules_disabled, c->baseline ? c->av_true : c->av_false) < 0) ||
+			    (apol_vector_cat(delta->terules_enabled, c->baseline ? c->te_false : c->te_true) < 0) ||
+			    (apol_vector_cat(delta->terules_disabled, c->baseline ? c->te_true : c->te_false) < 0)) {
+				error = errno;
+				goto cleanup;
+			}
+		}
+	}
+      cleanup:
+	for (i = 0; i < idx->num_bools; i++) {
+		if ((states[i] != 0) != idx->baseline[i]) {
+			for (j = idx->dep_first[i]; j < idx->dep_first[i + 1]; j++) {
+				seen[idx->deps[j]] = 0;
+			}
+		}
+	}
+	if (error != 0) {
+		apol_cond_delta_destroy(&delta);
+		errno = error;
+		return NULL;
+	}
+	return delta;
+}
+
+apol_cond_delta_t *apol_cond_index_whatif(const apol_cond_index_t * idx, const unsigned char *states)
+{
+	apol_cond_delta_t *delta;
+	unsigned char *seen;
+	int error;
+
+	if (idx == NULL || (states == NULL && idx->num_bools > 0)) {
+		ERR(idx == NULL ? NULL : idx->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((seen = calloc(idx->num_conds + 1, sizeof(*seen))) == NULL) {
+		error = errno;
+		ERR(idx->policy, "%s", strerror(error));
+		errno = error;
+		return NULL;
+	}
+	if ((delta = cond_whatif_delta(idx, states, seen)) == NULL) {
+		error = errno;
+		ERR(idx->policy, "%s", strerror(error));
+		free(seen);
+		errno = error;
+		return NULL;
+	}
+	free(seen);
+	return delta;
+}
+
+/** The assignments of a batch, shared by every thread computing it. */
+typedef struct cond_whatif_batch
+{
+	const apol_cond_index_t *idx;
+	const unsigned char *states;
+	apol_cond_delta_t **deltas;
+} cond_whatif_batch_t;
+
+/**
+ * Compute a range of a batch's assignments.  This runs upon worker
+ * threads, so it reports no errors itself.
+ */
+static int cond_whatif_worker(void *arg, size_t first, size_t last)
+{
+	cond_whatif_batch_t *batch = arg;
+	const apol_cond_index_t *idx = batch->idx;
+	unsigned char *seen;
+	size_t i;
+	int error = 0;
+
+	if ((seen = calloc(idx->num_conds + 1, sizeof(*seen))) == NULL) {
+		return errno;
+	}
+	for (i = first; i < last; i++) {
+		if ((batch->deltas[i] = cond_whatif_delta(idx, batch->states + i * idx->num_bools, seen)) == NULL) {
+			error = errno;
+			break;
+		}
+	}
+	free(seen);
+	return error;
+}
+
+int apol_cond_index_whatif_batch(const apol_cond_index_t * idx, const unsigned char *states, size_t num_assignments,
+				 apol_cond_delta_t ** deltas)
+{
+	cond_whatif_batch_t batch;
+	size_t i;
+	int error;
+
+	if (idx == NULL || (num_assignments > 0 && (deltas == NULL || (states == NULL && idx->num_bools > 0)))) {
+		ERR(idx == NULL ? NULL : idx->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (num_assignments == 0) {
+		return 0;
+	}
+	memset(deltas, 0, num_assignments * sizeof(*deltas));
+	batch.idx = idx;
+	batch.states = states;
+	batch.deltas = deltas;
+
+	/* assignments are independent and the index is only read, so
+	 * split them among threads */
+	error = qpol_parallel_run(num_assignments, 1, cond_whatif_worker, &batch);
+	if (error != 0) {
+		for (i = 0; i < num_assignments; i++) {
+			apol_cond_delta_destroy(deltas + i);
+		}
+		ERR(idx->policy, "%s", strerror(error));
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
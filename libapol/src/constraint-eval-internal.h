@@ -0,0 +1,54 @@
+/**
+ * @file
+ *
+ * Routines that give other parts of libapol access to the contexts and
+ * permission numbering of a constraint evaluator.
+ *
+ * Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef APOL_CONSTRAINT_EVAL_INTERNAL_H
+#define APOL_CONSTRAINT_EVAL_INTERNAL_H
+
+#include <apol/constraint-eval.h>
+#include <stdint.h>
+
+/**
+ * Return the type value of a context, which must be within the
+ * evaluator.
+ */
+extern uint32_t constraint_eval_get_context_type(const apol_constraint_eval_t * e, size_t context);
+
+/**
+ * Return the role value of a context, which must be within the
+ * evaluator.
+ */
+extern uint32_t constraint_eval_get_context_role(const apol_constraint_eval_t * e, size_t context);
+
+/**
+ * Return the number of classes within an evaluator.  The class of
+ * index i is the class of value i + 1.
+ */
+extern size_t constraint_eval_get_num_classes(const apol_constraint_eval_t * e);
+
+/**
+ * Return the bit of one of a class's permissions, or 0 if the class
+ * does not have the permission.
+ */
+extern uint32_t constraint_eval_get_perm_bit(const apol_constraint_eval_t * e, size_t class_index, const char *perm_name);
+
+#endif
@@ -0,0 +1,1001 @@
+/**
+ * @file
+ * Implementation of the compiled constraint and validatetrans
+ * evaluator.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "policy-query-internal.h"
+#include "mls-internal.h"
+#include "constraint-eval-internal.h"
+#include <qpol/constraint_query.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Expressions are evaluated on a stack of single bits held within
+ *  one word, so no expression may nest deeper than this.  (The kernel
+ *  limits expressions to a depth of 5.) */
+#define CEVAL_MAX_DEPTH 64
+
+/** The kernel's access vectors are 32 bits wide. */
+#define CEVAL_MAX_PERMS 32
+
+typedef enum ceval_opcode
+{
+	/* pop one or two results and push their combination */
+	CEVAL_NOT = 0,
+	CEVAL_AND,
+	CEVAL_OR,
+	/* push whether two contexts' users, roles, or types are equal */
+	CEVAL_USER_EQ,
+	CEVAL_ROLE_EQ,
+	CEVAL_TYPE_EQ,
+	/* push how two contexts' roles compare within the role dominance
+	 * hierarchy */
+	CEVAL_ROLE_DOM,
+	CEVAL_ROLE_DOMBY,
+	CEVAL_ROLE_INCOMP,
+	/* push whether a context's user, role, or type is within a set
+	 * of names */
+	CEVAL_USER_IN,
+	CEVAL_ROLE_IN,
+	CEVAL_TYPE_IN,
+	/* push how two levels compare */
+	CEVAL_LEVEL
+} ceval_opcode_e;
+
+typedef struct ceval_insn
+{
+	uint8_t opcode;
+	/** non-zero to invert the instruction's result, for the !=
+	 *  operator */
+	uint8_t negate;
+	/** context operands: 0 for the source (or old) context, 1 for
+	 *  the target (or new) context, 2 for the task context.  For
+	 *  CEVAL_LEVEL the context is shifted left by one, and the low
+	 *  bit selects the high level instead of the low level. */
+	uint8_t a, b;
+	/** for the *_IN opcodes, the offset of the set's first word
+	 *  within set_words; for CEVAL_LEVEL, one of QPOL_CEXPR_OP_* */
+	uint32_t arg;
+} ceval_insn_t;
+
+typedef struct ceval_program
+{
+	/** program is insns[first, first + num_insns) */
+	size_t first, num_insns;
+	/** permissions to which a constraint applies; 0 for a
+	 *  validatetrans statement */
+	uint32_t perms;
+} ceval_program_t;
+
+typedef struct ceval_class
+{
+	/** class's permissions, common permissions first, as const
+	 *  char * owned by the policy; permission i is bit (1 << i) */
+	apol_vector_t *perms;
+	/** constraints are programs[first_constr, first_constr + num_constr) */
+	size_t first_constr, num_constr;
+	/** validatetrans statements are programs[first_vtrans, first_vtrans + num_vtrans) */
+	size_t first_vtrans, num_vtrans;
+} ceval_class_t;
+
+typedef struct ceval_context
+{
+	uint32_t user, role, type;
+	/** only resolved if the policy is MLS */
+	mls_bitmap_range_t range;
+} ceval_context_t;
+
+struct apol_constraint_eval
+{
+	const apol_policy_t *policy;
+	int is_mls;
+	ceval_insn_t *insns;
+	size_t num_insns, insns_cap;
+	ceval_program_t *programs;
+	size_t num_programs, programs_cap;
+	/** class of value v is classes[v - 1] */
+	ceval_class_t *classes;
+	size_t num_classes;
+	/** name sets; every user set is user_stride words wide, and
+	 *  likewise for roles and types */
+	uint64_t *set_words;
+	size_t num_set_words, set_words_cap;
+	size_t user_stride, role_stride, type_stride;
+	/** roles dominated by the role of value v lie within
+	 *  [role_dom + (v - 1) * role_stride, role_dom + v * role_stride) */
+	uint64_t *role_dom;
+	ceval_context_t *contexts;
+	size_t num_contexts, contexts_cap;
+};
+
+/**
+ * Ensure that an array has room for at least needed elements.
+ */
+static int ceval_reserve(const apol_policy_t * p, void **array, size_t * cap, size_t needed, size_t elem_size)
+{
+	void *a;
+	size_t new_cap;
+	if (needed <= *cap) {
+		return 0;
+	}
+	for (new_cap = (*cap == 0 ? 64 : *cap * 2); new_cap < needed; new_cap *= 2) ;
+	if ((a = realloc(*array, new_cap * elem_size)) == NULL) {
+		ERR(p, "%s", strerror(errno));
+		return -1;
+	}
+	*array = a;
+	*cap = new_cap;
+	return 0;
+}
+
+static inline int ceval_bit_get(const uint64_t * words, uint32_t value)
+{
+	return (int)((words[(value - 1) / 64] >> ((value - 1) % 64)) & 1);
+}
+
+static inline void ceval_bit_set(uint64_t * words, uint32_t value, int on)
+{
+	uint64_t mask = (uint64_t) 1 << ((value - 1) % 64);
+	if (on) {
+		words[(value - 1) / 64] |= mask;
+	} else {
+		words[(value - 1) / 64] &= ~mask;
+	}
+}
+
+/**
+ * Find the number of words needed to hold a bitmap of every user,
+ * role, and type within the policy.
+ */
+static int ceval_get_strides(apol_constraint_eval_t * e)
+{
+	qpol_policy_t *q = e->policy->p;
+	qpol_iterator_t *iter = NULL;
+	void *item;
+	uint32_t value, max_value;
+	int kind, error = 0;
+
+	for (kind = 0; kind < 3; kind++) {
+		max_value = 0;
+		if ((kind == 0 ? qpol_policy_get_user_iter(q, &iter) :
+		     kind == 1 ? qpol_policy_get_role_iter(q, &iter) : qpol_policy_get_type_iter(q, &iter)) < 0) {
+			return -1;
+		}
+		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+			if (qpol_iterator_get_item(iter, &item) < 0 ||
+			    (kind == 0 ? qpol_user_get_value(q, item, &value) :
+			     kind == 1 ? qpol_role_get_value(q, item, &value) : qpol_type_get_value(q, item, &value)) < 0) {
+				error = errno;
+				qpol_iterator_destroy(&iter);
+				errno = error;
+				return -1;
+			}
+			if (value > max_value) {
+				max_value = value;
+			}
+		}
+		qpol_iterator_destroy(&iter);
+		value = (max_value + 63) / 64;
+		if (kind == 0) {
+			e->user_stride = value;
+		} else if (kind == 1) {
+			e->role_stride = value;
+		} else {
+			e->type_stride = value;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Build the table of which roles each role dominates.  By convention
+ * a role always dominates itself.
+ */
+static int ceval_build_role_dom(apol_constraint_eval_t * e)
+{
+	qpol_policy_t *q = e->policy->p;
+	qpol_iterator_t *iter = NULL, *dom_iter = NULL;
+	const qpol_role_t *role, *dom;
+	uint32_t value, dom_value;
+	int error = 0;
+
+	if (e->role_stride == 0) {
+		return 0;
+	}
+	if ((e->role_dom = calloc(e->role_stride * e->role_stride * 64, sizeof(*e->role_dom))) == NULL) {
+		error = errno;
+		ERR(e->policy, "%s", strerror(error));
+		errno = error;
+		return -1;
+	}
+	if (qpol_policy_get_role_iter(q, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		uint64_t *words;
+		if (qpol_iterator_get_item(iter, (void **)&role) < 0 || qpol_role_get_value(q, role, &value) < 0 ||
+		    qpol_role_get_dominate_iter(q, role, &dom_iter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		words = e->role_dom + (value - 1) * e->role_stride;
+		ceval_bit_set(words, value, 1);
+		for (; !qpol_iterator_end(dom_iter); qpol_iterator_next(dom_iter)) {
+			if (qpol_iterator_get_item(dom_iter, (void **)&dom) < 0 || qpol_role_get_value(q, dom, &dom_value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			ceval_bit_set(words, dom_value, 1);
+		}
+		qpol_iterator_destroy(&dom_iter);
+	}
+      cleanup:
+	qpol_iterator_destroy(&dom_iter);
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Set or clear the bit of a type, or of each member of an attribute.
+ */
+static int ceval_set_type(apol_constraint_eval_t * e, uint64_t * words, const char *name, int on)
+{
+	qpol_policy_t *q = e->policy->p;
+	const qpol_type_t *type;
+	qpol_iterator_t *iter = NULL;
+	unsigned char isattr;
+	uint32_t value;
+	int error = 0;
+
+	if (qpol_policy_get_type_by_name(q, name, &type) < 0 || qpol_type_get_isattr(q, type, &isattr) < 0) {
+		return -1;
+	}
+	if (!isattr) {
+		if (qpol_type_get_value(q, type, &value) < 0) {
+			return -1;
+		}
+		ceval_bit_set(words, value, on);
+		return 0;
+	}
+	if (qpol_type_get_type_iter(q, type, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&type) < 0 || qpol_type_get_value(q, type, &value) < 0) {
+			error = errno;
+			qpol_iterator_destroy(&iter);
+			errno = error;
+			return -1;
+		}
+		ceval_bit_set(words, value, on);
+	}
+	qpol_iterator_destroy(&iter);
+	return 0;
+}
+
+/**
+ * Build the set of a names expression node, returning the offset of
+ * its first word within set_words.  The node's names iterator returns
+ * every included name before any subtracted name, so clearing each
+ * subtracted type as it is seen gives the included types less the
+ * subtracted ones.
+ */
+static int ceval_compile_names(apol_constraint_eval_t * e, const qpol_constraint_expr_node_t * node, int sym,
+			       uint32_t * offset)
+{
+	qpol_policy_t *q = e->policy->p;
+	qpol_iterator_t *iter = NULL;
+	size_t stride;
+	uint64_t *words;
+	char *name = NULL;
+	int error = 0;
+
+	stride = (sym == QPOL_CEXPR_SYM_USER ? e->user_stride : sym == QPOL_CEXPR_SYM_ROLE ? e->role_stride : e->type_stride);
+	if (ceval_reserve(e->policy, (void **)&e->set_words, &e->set_words_cap, e->num_set_words + stride,
+			  sizeof(*e->set_words)) < 0) {
+		return -1;
+	}
+	if (e->num_set_words > UINT32_MAX) {
+		ERR(e->policy, "%s", strerror(EOVERFLOW));
+		errno = EOVERFLOW;
+		return -1;
+	}
+	*offset = (uint32_t) e->num_set_words;
+	words = e->set_words + e->num_set_words;
+	memset(words, 0, stride * sizeof(*words));
+
+	if (qpol_constraint_expr_node_get_names_iter(q, node, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		const qpol_user_t *user;
+		const qpol_role_t *role;
+		uint32_t value;
+		if (qpol_iterator_get_item(iter, (void **)&name) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (sym == QPOL_CEXPR_SYM_USER) {
+			if (qpol_policy_get_user_by_name(q, name, &user) < 0 || qpol_user_get_value(q, user, &value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			ceval_bit_set(words, value, 1);
+		} else if (sym == QPOL_CEXPR_SYM_ROLE) {
+			if (qpol_policy_get_role_by_name(q, name, &role) < 0 || qpol_role_get_value(q, role, &value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			ceval_bit_set(words, value, 1);
+		} else if (name[0] == '-') {
+			if (ceval_set_type(e, words, name + 1, 0) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+		} else if (ceval_set_type(e, words, name, 1) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		free(name);
+		name = NULL;
+	}
+	e->num_set_words += stride;
+      cleanup:
+	free(name);
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Translate one expression node into an instruction.
+ *
+ * @param num_contexts Number of contexts the expression may refer to:
+ * 2 for a constraint, 3 for a validatetrans statement.
+ * @param depth Reference to the depth of the evaluation stack, which
+ * is updated by the instruction.
+ */
+static int ceval_compile_node(apol_constraint_eval_t * e, const qpol_constraint_expr_node_t * node, int num_contexts,
+			      size_t * depth, ceval_insn_t * insn)
+{
+	qpol_policy_t *q = e->policy->p;
+	uint32_t expr_type, sym, op;
+	int ctx;
+
+	memset(insn, 0, sizeof(*insn));
+	if (qpol_constraint_expr_node_get_expr_type(q, node, &expr_type) < 0 ||
+	    qpol_constraint_expr_node_get_sym_type(q, node, &sym) < 0 || qpol_constraint_expr_node_get_op(q, node, &op) < 0) {
+		return -1;
+	}
+	switch (expr_type) {
+	case QPOL_CEXPR_TYPE_NOT:
+		if (*depth < 1) {
+			goto malformed;
+		}
+		insn->opcode = CEVAL_NOT;
+		return 0;
+	case QPOL_CEXPR_TYPE_AND:
+	case QPOL_CEXPR_TYPE_OR:
+		if (*depth < 2) {
+			goto malformed;
+		}
+		insn->opcode = (expr_type == QPOL_CEXPR_TYPE_AND ? CEVAL_AND : CEVAL_OR);
+		(*depth)--;
+		return 0;
+	case QPOL_CEXPR_TYPE_ATTR:
+	case QPOL_CEXPR_TYPE_NAMES:
+		break;
+	default:
+		goto malformed;
+	}
+	if (++(*depth) > CEVAL_MAX_DEPTH) {
+		goto malformed;
+	}
+	if (op == QPOL_CEXPR_OP_NEQ) {
+		insn->negate = 1;
+	} else if (op != QPOL_CEXPR_OP_EQ && !(op >= QPOL_CEXPR_OP_DOM && op <= QPOL_CEXPR_OP_INCOMP)) {
+		goto malformed;
+	}
+
+	if (expr_type == QPOL_CEXPR_TYPE_NAMES) {
+		ctx = (sym & QPOL_CEXPR_SYM_XTARGET ? 2 : sym & QPOL_CEXPR_SYM_TARGET ? 1 : 0);
+		sym &= ~(QPOL_CEXPR_SYM_TARGET | QPOL_CEXPR_SYM_XTARGET);
+		if (ctx >= num_contexts || (op != QPOL_CEXPR_OP_EQ && op != QPOL_CEXPR_OP_NEQ)) {
+			goto malformed;
+		}
+		switch (sym) {
+		case QPOL_CEXPR_SYM_USER:
+			insn->opcode = CEVAL_USER_IN;
+			break;
+		case QPOL_CEXPR_SYM_ROLE:
+			insn->opcode = CEVAL_ROLE_IN;
+			break;
+		case QPOL_CEXPR_SYM_TYPE:
+			insn->opcode = CEVAL_TYPE_IN;
+			break;
+		default:
+			goto malformed;
+		}
+		insn->a = (uint8_t) ctx;
+		return ceval_compile_names(e, node, (int)sym, &insn->arg);
+	}
+
+	/* an attribute comparison between the first two contexts */
+	insn->a = 0;
+	insn->b = 1;
+	switch (sym) {
+	case QPOL_CEXPR_SYM_USER:
+	case QPOL_CEXPR_SYM_TYPE:
+		if (op != QPOL_CEXPR_OP_EQ && op != QPOL_CEXPR_OP_NEQ) {
+			goto malformed;
+		}
+		insn->opcode = (sym == QPOL_CEXPR_SYM_USER ? CEVAL_USER_EQ : CEVAL_TYPE_EQ);
+		return 0;
+	case QPOL_CEXPR_SYM_ROLE:
+		insn->opcode = (op == QPOL_CEXPR_OP_DOM ? CEVAL_ROLE_DOM :
+				op == QPOL_CEXPR_OP_DOMBY ? CEVAL_ROLE_DOMBY :
+				op == QPOL_CEXPR_OP_INCOMP ? CEVAL_ROLE_INCOMP : CEVAL_ROLE_EQ);
+		return 0;
+	case QPOL_CEXPR_SYM_L1L2:
+		insn->a = 0 << 1;
+		insn->b = 1 << 1;
+		break;
+	case QPOL_CEXPR_SYM_L1H2:
+		insn->a = 0 << 1;
+		insn->b = (1 << 1) | 1;
+		break;
+	case QPOL_CEXPR_SYM_H1L2:
+		insn->a = (0 << 1) | 1;
+		insn->b = 1 << 1;
+		break;
+	case QPOL_CEXPR_SYM_H1H2:
+		insn->a = (0 << 1) | 1;
+		insn->b = (1 << 1) | 1;
+		break;
+	case QPOL_CEXPR_SYM_L1H1:
+		insn->a = 0 << 1;
+		insn->b = (0 << 1) | 1;
+		break;
+	case QPOL_CEXPR_SYM_L2H2:
+		insn->a = 1 << 1;
+		insn->b = (1 << 1) | 1;
+		break;
+	default:
+		goto malformed;
+	}
+	if (!e->is_mls) {
+		goto malformed;
+	}
+	insn->opcode = CEVAL_LEVEL;
+	insn->negate = 0;
+	insn->arg = op;
+	return 0;
+
+      malformed:
+	ERR(e->policy, "%s", "Malformed constraint expression.");
+	errno = EINVAL;
+	return -1;
+}
+
+/**
+ * Compile a constraint or validatetrans expression into a new program.
+ */
+static int ceval_compile_expr(apol_constraint_eval_t * e, qpol_iterator_t * expr_iter, int num_contexts, uint32_t perms)
+{
+	const qpol_constraint_expr_node_t *node;
+	ceval_program_t *prog;
+	size_t depth = 0;
+
+	if (ceval_reserve(e->policy, (void **)&e->programs, &e->programs_cap, e->num_programs + 1, sizeof(*e->programs)) < 0) {
+		return -1;
+	}
+	prog = e->programs + e->num_programs;
+	prog->first = e->num_insns;
+	prog->num_insns = 0;
+	prog->perms = perms;
+	for (; !qpol_iterator_end(expr_iter); qpol_iterator_next(expr_iter)) {
+		if (qpol_iterator_get_item(expr_iter, (void **)&node) < 0 ||
+		    ceval_reserve(e->policy, (void **)&e->insns, &e->insns_cap, e->num_insns + 1, sizeof(*e->insns)) < 0 ||
+		    ceval_compile_node(e, node, num_contexts, &depth, e->insns + e->num_insns) < 0) {
+			return -1;
+		}
+		e->num_insns++;
+		prog->num_insns++;
+	}
+	if (depth != 1) {
+		ERR(e->policy, "%s", "Malformed constraint expression.");
+		errno = EINVAL;
+		return -1;
+	}
+	e->num_programs++;
+	return 0;
+}
+
+/**
+ * Number a class's permissions, common permissions first.
+ */
+static int ceval_class_get_perms(apol_constraint_eval_t * e, const qpol_class_t * obj_class, ceval_class_t * c)
+{
+	if ((c->perms = class_perm_get_numbered(e->policy, obj_class)) == NULL) {
+		return -1;
+	}
+	if (apol_vector_get_size(c->perms) > CEVAL_MAX_PERMS) {
+		ERR(e->policy, "%s", strerror(EOVERFLOW));
+		errno = EOVERFLOW;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Compile the constraints of a class.
+ */
+static int ceval_compile_constraints(apol_constraint_eval_t * e, const qpol_class_t * obj_class, ceval_class_t * c)
+{
+	qpol_policy_t *q = e->policy->p;
+	qpol_iterator_t *iter = NULL, *perm_iter = NULL, *expr_iter = NULL;
+	qpol_constraint_t *constr = NULL;
+	char *perm = NULL;
+	size_t i;
+	uint32_t perms;
+	int error = 0;
+
+	c->first_constr = e->num_programs;
+	if (qpol_class_get_constraint_iter(q, obj_class, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&constr) < 0 || qpol_constraint_get_perm_iter(q, constr, &perm_iter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		perms = 0;
+		for (; !qpol_iterator_end(perm_iter); qpol_iterator_next(perm_iter)) {
+			if (qpol_iterator_get_item(perm_iter, (void **)&perm) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			if (apol_vector_get_index(c->perms, perm, apol_str_strcmp, NULL, &i) < 0) {
+				error = ENOENT;
+				ERR(e->policy, "Unknown permission %s within a constraint.", perm);
+				goto cleanup;
+			}
+			perms |= (uint32_t) 1 << i;
+			free(perm);
+			perm = NULL;
+		}
+		qpol_iterator_destroy(&perm_iter);
+		if (qpol_constraint_get_expr_iter(q, constr, &expr_iter) < 0 || ceval_compile_expr(e, expr_iter, 2, perms) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		qpol_iterator_destroy(&expr_iter);
+		free(constr);
+		constr = NULL;
+	}
+	c->num_constr = e->num_programs - c->first_constr;
+      cleanup:
+	free(perm);
+	free(constr);
+	qpol_iterator_destroy(&expr_iter);
+	qpol_iterator_destroy(&perm_iter);
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Compile the validatetrans statements of a class.
+ */
+static int ceval_compile_validatetrans(apol_constraint_eval_t * e, const qpol_class_t * obj_class, ceval_class_t * c)
+{
+	qpol_policy_t *q = e->policy->p;
+	qpol_iterator_t *iter = NULL, *expr_iter = NULL;
+	qpol_validatetrans_t *vtrans = NULL;
+	int error = 0;
+
+	c->first_vtrans = e->num_programs;
+	if (qpol_class_get_validatetrans_iter(q, obj_class, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&vtrans) < 0 ||
+		    qpol_validatetrans_get_expr_iter(q, vtrans, &expr_iter) < 0 || ceval_compile_expr(e, expr_iter, 3, 0) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		qpol_iterator_destroy(&expr_iter);
+		free(vtrans);
+		vtrans = NULL;
+	}
+	c->num_vtrans = e->num_programs - c->first_vtrans;
+      cleanup:
+	free(vtrans);
+	qpol_iterator_destroy(&expr_iter);
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+static int ceval_compile_classes(apol_constraint_eval_t * e)
+{
+	qpol_policy_t *q = e->policy->p;
+	qpol_iterator_t *iter = NULL;
+	const qpol_class_t *obj_class;
+	uint32_t value;
+	size_t size;
+	int error = 0;
+
+	if (qpol_policy_get_class_iter(q, &iter) < 0 || qpol_iterator_get_size(iter, &size) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	/* class values run from 1 to the number of classes */
+	if (size > 0 && (e->classes = calloc(size, sizeof(*e->classes))) == NULL) {
+		error = errno;
+		ERR(e->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	e->num_classes = size;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		ceval_class_t *c;
+		if (qpol_iterator_get_item(iter, (void **)&obj_class) < 0 || qpol_class_get_value(q, obj_class, &value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (value < 1 || value > e->num_classes) {
+			error = EINVAL;
+			ERR(e->policy, "%s", strerror(error));
+			goto cleanup;
+		}
+		c = e->classes + value - 1;
+		if (ceval_class_get_perms(e, obj_class, c) < 0 || ceval_compile_constraints(e, obj_class, c) < 0 ||
+		    ceval_compile_validatetrans(e, obj_class, c) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+apol_constraint_eval_t *apol_constraint_eval_create(const apol_policy_t * p)
+{
+	apol_constraint_eval_t *e;
+	int error;
+	if (p == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((e = calloc(1, sizeof(*e))) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		errno = error;
+		return NULL;
+	}
+	e->policy = p;
+	e->is_mls = apol_policy_is_mls(p);
+	if (ceval_get_strides(e) < 0 || ceval_build_role_dom(e) < 0 || ceval_compile_classes(e) < 0) {
+		error = errno;
+		apol_constraint_eval_destroy(&e);
+		errno = error;
+		return NULL;
+	}
+	return e;
+}
+
+void apol_constraint_eval_destroy(apol_constraint_eval_t ** e)
+{
+	size_t i;
+	if (e != NULL && *e != NULL) {
+		for (i = 0; i < (*e)->num_classes; i++) {
+			apol_vector_destroy(&(*e)->classes[i].perms);
+		}
+		for (i = 0; i < (*e)->num_contexts; i++) {
+			mls_bitmap_range_fini(&(*e)->contexts[i].range);
+		}
+		free((*e)->insns);
+		free((*e)->programs);
+		free((*e)->classes);
+		free((*e)->set_words);
+		free((*e)->role_dom);
+		free((*e)->contexts);
+		free(*e);
+		*e = NULL;
+	}
+}
+
+int apol_constraint_eval_append_context(apol_constraint_eval_t * e, const apol_context_t * context)
+{
+	qpol_policy_t *q;
+	const char *user_name, *role_name, *type_name;
+	const qpol_user_t *user;
+	const qpol_role_t *role;
+	const qpol_type_t *type;
+	ceval_context_t *c;
+
+	if (e == NULL || context == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	q = e->policy->p;
+	user_name = apol_context_get_user(context);
+	role_name = apol_context_get_role(context);
+	type_name = apol_context_get_type(context);
+	if (user_name == NULL || role_name == NULL || type_name == NULL ||
+	    (e->is_mls && apol_context_get_range(context) == NULL)) {
+		ERR(e->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (ceval_reserve(e->policy, (void **)&e->contexts, &e->contexts_cap, e->num_contexts + 1, sizeof(*e->contexts)) < 0) {
+		return -1;
+	}
+	c = e->contexts + e->num_contexts;
+	memset(c, 0, sizeof(*c));
+	if (qpol_policy_get_user_by_name(q, user_name, &user) < 0 || qpol_user_get_value(q, user, &c->user) < 0 ||
+	    qpol_policy_get_role_by_name(q, role_name, &role) < 0 || qpol_role_get_value(q, role, &c->role) < 0 ||
+	    qpol_policy_get_type_by_name(q, type_name, &type) < 0 || qpol_type_get_value(q, type, &c->type) < 0) {
+		return -1;
+	}
+	if (e->is_mls && mls_range_resolve(e->policy, apol_context_get_range(context), &c->range) < 0) {
+		return -1;
+	}
+	e->num_contexts++;
+	return 0;
+}
+
+size_t apol_constraint_eval_get_num_contexts(const apol_constraint_eval_t * e)
+{
+	if (e == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return e->num_contexts;
+}
+
+int apol_constraint_eval_get_perm(const apol_constraint_eval_t * e, const char *class_name, const char *perm_name,
+				  size_t * class_index, uint32_t * perm)
+{
+	const qpol_class_t *obj_class;
+	uint32_t value;
+	size_t i;
+
+	if (perm != NULL) {
+		*perm = 0;
+	}
+	if (e == NULL || class_name == NULL || class_index == NULL || (perm_name != NULL && perm == NULL)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (qpol_policy_get_class_by_name(e->policy->p, class_name, &obj_class) < 0 ||
+	    qpol_class_get_value(e->policy->p, obj_class, &value) < 0) {
+		return -1;
+	}
+	*class_index = value - 1;
+	if (perm_name == NULL) {
+		return 0;
+	}
+	if (apol_vector_get_index(e->classes[value - 1].perms, perm_name, apol_str_strcmp, NULL, &i) < 0) {
+		ERR(e->policy, "Class %s does not have permission %s.", class_name, perm_name);
+		errno = ENOENT;
+		return -1;
+	}
+	*perm = (uint32_t) 1 << i;
+	return 0;
+}
+
+uint32_t constraint_eval_get_context_type(const apol_constraint_eval_t * e, size_t context)
+{
+	return e->contexts[context].type;
+}
+
+uint32_t constraint_eval_get_context_role(const apol_constraint_eval_t * e, size_t context)
+{
+	return e->contexts[context].role;
+}
+
+size_t constraint_eval_get_num_classes(const apol_constraint_eval_t * e)
+{
+	return e->num_classes;
+}
+
+uint32_t constraint_eval_get_perm_bit(const apol_constraint_eval_t * e, size_t class_index, const char *perm_name)
+{
+	size_t i;
+	if (class_index >= e->num_classes ||
+	    apol_vector_get_index(e->classes[class_index].perms, perm_name, apol_str_strcmp, NULL, &i) < 0) {
+		return 0;
+	}
+	return (uint32_t) 1 << i;
+}
+
+static inline const mls_bitmap_level_t *ceval_level(const ceval_context_t * const *ctx, uint8_t sel)
+{
+	const ceval_context_t *c = ctx[sel >> 1];
+	return (sel & 1 ? &c->range.high : &c->range.low);
+}
+
+/**
+ * Run a program against contexts, returning non-zero if its
+ * expression is true.  Results are kept on a stack of bits within a
+ * single word, with the top of the stack in the lowest bit.
+ */
+static int ceval_run(const apol_constraint_eval_t * e, const ceval_program_t * prog, const ceval_context_t * const *ctx)
+{
+	const ceval_insn_t *insn = e->insns + prog->first, *end = insn + prog->num_insns;
+	uint64_t stack = 0, top;
+	int s, cmp;
+
+	for (; insn < end; insn++) {
+		switch (insn->opcode) {
+		case CEVAL_NOT:
+			stack ^= 1;
+			continue;
+		case CEVAL_AND:
+			top = stack & 1;
+			stack = (stack >> 1) & (~(uint64_t) 1 | top);
+			continue;
+		case CEVAL_OR:
+			top = stack & 1;
+			stack = (stack >> 1) | top;
+			continue;
+		case CEVAL_USER_EQ:
+			s = (ctx[0]->user == ctx[1]->user);
+			break;
+		case CEVAL_ROLE_EQ:
+			s = (ctx[0]->role == ctx[1]->role);
+			break;
+		case CEVAL_TYPE_EQ:
+			s = (ctx[0]->type == ctx[1]->type);
+			break;
+		case CEVAL_ROLE_DOM:
+			s = ceval_bit_get(e->role_dom + (ctx[0]->role - 1) * e->role_stride, ctx[1]->role);
+			break;
+		case CEVAL_ROLE_DOMBY:
+			s = ceval_bit_get(e->role_dom + (ctx[1]->role - 1) * e->role_stride, ctx[0]->role);
+			break;
+		case CEVAL_ROLE_INCOMP:
+			s = !ceval_bit_get(e->role_dom + (ctx[0]->role - 1) * e->role_stride, ctx[1]->role) &&
+				!ceval_bit_get(e->role_dom + (ctx[1]->role - 1) * e->role_stride, ctx[0]->role);
+			break;
+		case CEVAL_USER_IN:
+			s = ceval_bit_get(e->set_words + insn->arg, ctx[insn->a]->user);
+			break;
+		case CEVAL_ROLE_IN:
+			s = ceval_bit_get(e->set_words + insn->arg, ctx[insn->a]->role);
+			break;
+		case CEVAL_TYPE_IN:
+			s = ceval_bit_get(e->set_words + insn->arg, ctx[insn->a]->type);
+			break;
+		case CEVAL_LEVEL:
+			cmp = mls_bitmap_level_compare(ceval_level(ctx, insn->a), ceval_level(ctx, insn->b));
+			switch (insn->arg) {
+			case QPOL_CEXPR_OP_EQ:
+				s = (cmp == APOL_MLS_EQ);
+				break;
+			case QPOL_CEXPR_OP_NEQ:
+				s = (cmp != APOL_MLS_EQ);
+				break;
+			case QPOL_CEXPR_OP_DOM:
+				s = (cmp == APOL_MLS_EQ || cmp == APOL_MLS_DOM);
+				break;
+			case QPOL_CEXPR_OP_DOMBY:
+				s = (cmp == APOL_MLS_EQ || cmp == APOL_MLS_DOMBY);
+				break;
+			default:
+				s = (cmp == APOL_MLS_INCOMP);
+			}
+			break;
+		default:
+			s = 0;
+		}
+		stack = (stack << 1) | (uint64_t) (s ^ insn->negate);
+	}
+	return (int)(stack & 1);
+}
+
+int apol_constraint_eval_check(const apol_constraint_eval_t * e, const apol_constraint_eval_request_t * requests,
+			       size_t num_requests, uint32_t * denied)
+{
+	const ceval_context_t *ctx[2];
+	const ceval_program_t *prog, *end;
+	const ceval_class_t *c;
+	size_t i;
+	uint32_t d, applies;
+
+	if (e == NULL || (num_requests > 0 && (requests == NULL || denied == NULL))) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (i = 0; i < num_requests; i++) {
+		const apol_constraint_eval_request_t *r = requests + i;
+		if (r->scontext >= e->num_contexts || r->tcontext >= e->num_contexts || r->class_index >= e->num_classes) {
+			ERR(e->policy, "%s", strerror(EINVAL));
+			errno = EINVAL;
+			return -1;
+		}
+		ctx[0] = e->contexts + r->scontext;
+		ctx[1] = e->contexts + r->tcontext;
+		c = e->classes + r->class_index;
+		d = 0;
+		end = e->programs + c->first_constr + c->num_constr;
+		for (prog = e->programs + c->first_constr; prog < end; prog++) {
+			/* skip constraints that could not deny anything more */
+			applies = prog->perms & r->perms & ~d;
+			if (applies != 0 && !ceval_run(e, prog, ctx)) {
+				d |= applies;
+			}
+		}
+		denied[i] = d;
+	}
+	return 0;
+}
+
+int apol_constraint_eval_validatetrans(const apol_constraint_eval_t * e, size_t oldcontext, size_t newcontext,
+				       size_t taskcontext, size_t class_index)
+{
+	const ceval_context_t *ctx[3];
+	const ceval_program_t *prog, *end;
+	const ceval_class_t *c;
+
+	if (e == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (oldcontext >= e->num_contexts || newcontext >= e->num_contexts || taskcontext >= e->num_contexts ||
+	    class_index >= e->num_classes) {
+		ERR(e->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	ctx[0] = e->contexts + oldcontext;
+	ctx[1] = e->contexts + newcontext;
+	ctx[2] = e->contexts + taskcontext;
+	c = e->classes + class_index;
+	end = e->programs + c->first_vtrans + c->num_vtrans;
+	for (prog = e->programs + c->first_vtrans; prog < end; prog++) {
+		if (!ceval_run(e, prog, ctx)) {
+			return 0;
+		}
+	}
+	return 1;
+}
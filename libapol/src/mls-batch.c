@@ -0,0 +1,426 @@
+/**
+ * @file
+ * Implementation of batched MLS level and range comparisons.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "policy-query-internal.h"
+#include "mls-internal.h"
+#include <apol/mls-batch.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Levels are stored as parallel arrays.  Every level's categories
+ * occupy exactly stride words, so that the comparison loops below
+ * have a fixed trip count and no data-dependent branches, which lets
+ * the compiler vectorize them.
+ */
+struct apol_mls_level_batch
+{
+	const apol_policy_t *policy;
+	/** sensitivity value of each level */
+	uint32_t *sens;
+	/** categories of level i lie within [cats + i * stride, cats + (i + 1) * stride) */
+	uint64_t *cats;
+	/** number of words needed to hold every category within the policy */
+	size_t stride;
+	size_t size, capacity;
+};
+
+struct apol_mls_range_batch
+{
+	/** low and high level of each range; if a range has no high
+	 * level then its low level is stored in both */
+	apol_mls_level_batch_t *low, *high;
+	/** non-zero for a range whose high level is its low level */
+	unsigned char *is_single;
+};
+
+/**
+ * Return the number of words needed to store a bitmap of every
+ * category within a policy.
+ */
+static int mls_batch_get_stride(const apol_policy_t * p, size_t * stride)
+{
+	qpol_iterator_t *iter = NULL;
+	const qpol_cat_t *cat;
+	uint32_t value, max_value = 0;
+	int error = 0;
+
+	if (qpol_policy_get_cat_iter(p->p, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&cat) < 0 || qpol_cat_get_value(p->p, cat, &value) < 0) {
+			error = errno;
+			qpol_iterator_destroy(&iter);
+			errno = error;
+			return -1;
+		}
+		if (value > max_value) {
+			max_value = value;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	*stride = (max_value + APOL_MLS_BITMAP_WORD_BITS - 1) / APOL_MLS_BITMAP_WORD_BITS;
+	return 0;
+}
+
+/**
+ * Append an already resolved level to a batch.
+ */
+static int mls_level_batch_push(apol_mls_level_batch_t * batch, const mls_bitmap_level_t * b)
+{
+	uint64_t *dest;
+	if (b->num_words > batch->stride) {
+		/* the level has a category that was not counted by
+		 * mls_batch_get_stride() */
+		ERR(batch->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (batch->size >= batch->capacity) {
+		size_t new_capacity = (batch->capacity == 0 ? 128 : batch->capacity * 2);
+		uint32_t *sens;
+		uint64_t *cats;
+		if ((sens = realloc(batch->sens, new_capacity * sizeof(*sens))) == NULL) {
+			ERR(batch->policy, "%s", strerror(errno));
+			return -1;
+		}
+		batch->sens = sens;
+		if (batch->stride > 0) {
+			if ((cats = realloc(batch->cats, new_capacity * batch->stride * sizeof(*cats))) == NULL) {
+				ERR(batch->policy, "%s", strerror(errno));
+				return -1;
+			}
+			batch->cats = cats;
+		}
+		batch->capacity = new_capacity;
+	}
+	batch->sens[batch->size] = b->sens;
+	if (batch->stride > 0) {
+		dest = batch->cats + batch->size * batch->stride;
+		memset(dest, 0, batch->stride * sizeof(*dest));
+		if (b->num_words > 0) {
+			memcpy(dest, b->cats, b->num_words * sizeof(*dest));
+		}
+	}
+	batch->size++;
+	return 0;
+}
+
+apol_mls_level_batch_t *apol_mls_level_batch_create(const apol_policy_t * p)
+{
+	apol_mls_level_batch_t *batch;
+	int error;
+	if (p == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((batch = calloc(1, sizeof(*batch))) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		errno = error;
+		return NULL;
+	}
+	batch->policy = p;
+	if (mls_batch_get_stride(p, &batch->stride) < 0) {
+		error = errno;
+		free(batch);
+		errno = error;
+		return NULL;
+	}
+	return batch;
+}
+
+void apol_mls_level_batch_destroy(apol_mls_level_batch_t ** batch)
+{
+	if (batch != NULL && *batch != NULL) {
+		free((*batch)->sens);
+		free((*batch)->cats);
+		free(*batch);
+		*batch = NULL;
+	}
+}
+
+int apol_mls_level_batch_append(apol_mls_level_batch_t * batch, const apol_mls_level_t * level)
+{
+	mls_bitmap_level_t b;
+	int retval, error;
+	if (batch == NULL || level == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (mls_level_resolve(batch->policy, level, &b) < 0) {
+		return -1;
+	}
+	retval = mls_level_batch_push(batch, &b);
+	error = errno;
+	mls_bitmap_level_fini(&b);
+	errno = error;
+	return retval;
+}
+
+size_t apol_mls_level_batch_get_size(const apol_mls_level_batch_t * batch)
+{
+	if (batch == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return batch->size;
+}
+
+apol_mls_range_batch_t *apol_mls_range_batch_create(const apol_policy_t * p)
+{
+	apol_mls_range_batch_t *batch;
+	int error;
+	if (p == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((batch = calloc(1, sizeof(*batch))) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		errno = error;
+		return NULL;
+	}
+	if ((batch->low = apol_mls_level_batch_create(p)) == NULL || (batch->high = apol_mls_level_batch_create(p)) == NULL) {
+		error = errno;
+		apol_mls_range_batch_destroy(&batch);
+		errno = error;
+		return NULL;
+	}
+	return batch;
+}
+
+void apol_mls_range_batch_destroy(apol_mls_range_batch_t ** batch)
+{
+	if (batch != NULL && *batch != NULL) {
+		apol_mls_level_batch_destroy(&(*batch)->low);
+		apol_mls_level_batch_destroy(&(*batch)->high);
+		free((*batch)->is_single);
+		free(*batch);
+		*batch = NULL;
+	}
+}
+
+int apol_mls_range_batch_append(apol_mls_range_batch_t * batch, const apol_mls_range_t * range)
+{
+	mls_bitmap_range_t b;
+	const apol_policy_t *p;
+	int error = 0;
+	if (batch == NULL || range == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	p = batch->low->policy;
+	if (apol_mls_range_validate(p, range) != 1) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (mls_range_resolve(p, range, &b) < 0) {
+		return -1;
+	}
+	if (batch->low->size >= batch->low->capacity) {
+		/* the low batch is about to grow, so grow is_single to
+		 * match */
+		size_t new_capacity = (batch->low->capacity == 0 ? 128 : batch->low->capacity * 2);
+		unsigned char *is_single;
+		if ((is_single = realloc(batch->is_single, new_capacity * sizeof(*is_single))) == NULL) {
+			error = errno;
+			ERR(p, "%s", strerror(error));
+			goto cleanup;
+		}
+		batch->is_single = is_single;
+	}
+	if (mls_level_batch_push(batch->low, &b.low) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	if (mls_level_batch_push(batch->high, &b.high) < 0) {
+		error = errno;
+		batch->low->size--;
+		goto cleanup;
+	}
+	batch->is_single[batch->low->size - 1] = (b.is_single != 0);
+      cleanup:
+	mls_bitmap_range_fini(&b);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+size_t apol_mls_range_batch_get_size(const apol_mls_range_batch_t * batch)
+{
+	if (batch == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return batch->low->size;
+}
+
+/******************** comparison kernels ********************/
+
+/**
+ * Compare two levels stored within batches of the same stride, with
+ * the same results as mls_bitmap_level_compare().
+ */
+static int mls_batch_level_compare(uint32_t sens1, const uint64_t * cats1, uint32_t sens2, const uint64_t * cats2, size_t stride)
+{
+	uint64_t only1 = 0, only2 = 0;
+	size_t i;
+	for (i = 0; i < stride; i++) {
+		only1 |= cats1[i] & ~cats2[i];
+		only2 |= cats2[i] & ~cats1[i];
+	}
+	if (sens1 == sens2 && only1 == 0 && only2 == 0)
+		return APOL_MLS_EQ;
+	if (sens1 >= sens2 && only2 == 0)
+		return APOL_MLS_DOM;
+	if (sens1 <= sens2 && only1 == 0)
+		return APOL_MLS_DOMBY;
+	return APOL_MLS_INCOMP;
+}
+
+/**
+ * Return non-zero if range r of a range batch includes level l of a
+ * level batch, with the same results as
+ * mls_bitmap_range_include_level().  The level's categories must
+ * be a subset of the high level's, and unless the range is a single
+ * level the low level's categories must be a subset of the level's.
+ */
+static int mls_batch_range_include(const apol_mls_range_batch_t * ranges, size_t r, const apol_mls_level_batch_t * levels,
+				   size_t l)
+{
+	size_t stride = levels->stride, i;
+	const uint64_t *low = ranges->low->cats + r * stride;
+	const uint64_t *high = ranges->high->cats + r * stride;
+	const uint64_t *level = levels->cats + l * stride;
+	uint32_t sens = levels->sens[l];
+	uint64_t low_mask = (ranges->is_single[r] ? 0 : ~((uint64_t) 0));
+	uint64_t missing = 0;
+	for (i = 0; i < stride; i++) {
+		missing |= (level[i] & ~high[i]) | (low[i] & ~level[i] & low_mask);
+	}
+	if (missing != 0 || ranges->high->sens[r] < sens) {
+		return 0;
+	}
+	if (ranges->is_single[r]) {
+		return ranges->low->sens[r] == sens;
+	}
+	return ranges->low->sens[r] <= sens;
+}
+
+/**
+ * Check that two level batches may be compared, and that every pair
+ * is within bounds.
+ */
+static int mls_batch_check_pairs(const apol_mls_level_batch_t * b1, size_t size1, const apol_mls_level_batch_t * b2,
+				 size_t size2, const apol_mls_batch_pair_t * pairs, size_t num_pairs)
+{
+	size_t i;
+	if (b1->policy != b2->policy || b1->stride != b2->stride) {
+		ERR(b1->policy, "%s", "Cannot compare MLS batches from different policies.");
+		errno = EINVAL;
+		return -1;
+	}
+	if (pairs == NULL) {
+		if (num_pairs > size1 || num_pairs > size2) {
+			ERR(b1->policy, "%s", strerror(EINVAL));
+			errno = EINVAL;
+			return -1;
+		}
+		return 0;
+	}
+	for (i = 0; i < num_pairs; i++) {
+		if (pairs[i].first >= size1 || pairs[i].second >= size2) {
+			ERR(b1->policy, "%s", strerror(EINVAL));
+			errno = EINVAL;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int apol_mls_level_batch_compare(const apol_mls_level_batch_t * l1, const apol_mls_level_batch_t * l2,
+				 const apol_mls_batch_pair_t * pairs, size_t num_pairs, int *results)
+{
+	size_t i, first, second, stride;
+	if (l1 == NULL || l2 == NULL || (num_pairs > 0 && results == NULL)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (mls_batch_check_pairs(l1, l1->size, l2, l2->size, pairs, num_pairs) < 0) {
+		return -1;
+	}
+	stride = l1->stride;
+	for (i = 0; i < num_pairs; i++) {
+		first = (pairs == NULL ? i : pairs[i].first);
+		second = (pairs == NULL ? i : pairs[i].second);
+		results[i] = mls_batch_level_compare(l1->sens[first], l1->cats + first * stride,
+						     l2->sens[second], l2->cats + second * stride, stride);
+	}
+	return 0;
+}
+
+int apol_mls_range_batch_include_levels(const apol_mls_range_batch_t * ranges, const apol_mls_level_batch_t * levels,
+					const apol_mls_batch_pair_t * pairs, size_t num_pairs, int *results)
+{
+	size_t i, first, second;
+	if (ranges == NULL || levels == NULL || (num_pairs > 0 && results == NULL)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (mls_batch_check_pairs(ranges->low, ranges->low->size, levels, levels->size, pairs, num_pairs) < 0) {
+		return -1;
+	}
+	for (i = 0; i < num_pairs; i++) {
+		first = (pairs == NULL ? i : pairs[i].first);
+		second = (pairs == NULL ? i : pairs[i].second);
+		results[i] = mls_batch_range_include(ranges, first, levels, second);
+	}
+	return 0;
+}
+
+int apol_mls_range_batch_contain_subranges(const apol_mls_range_batch_t * ranges,
+					   const apol_mls_range_batch_t * subranges, const apol_mls_batch_pair_t * pairs,
+					   size_t num_pairs, int *results)
+{
+	size_t i, first, second;
+	if (ranges == NULL || subranges == NULL || (num_pairs > 0 && results == NULL)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (mls_batch_check_pairs(ranges->low, ranges->low->size, subranges->low, subranges->low->size, pairs, num_pairs) < 0) {
+		return -1;
+	}
+	for (i = 0; i < num_pairs; i++) {
+		first = (pairs == NULL ? i : pairs[i].first);
+		second = (pairs == NULL ? i : pairs[i].second);
+		results[i] = mls_batch_range_include(ranges, first, subranges->low, second) &&
+			mls_batch_range_include(ranges, first, subranges->high, second);
+	}
+	return 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file
+ *
+ * Protected routines for MLS levels and ranges.  Levels and ranges
+ * store their sensitivity and categories by name; these routines
+ * resolve them against a policy into values and category bitmaps, so
+ * that dominance and containment become word-wise bit operations.
+ *
+ * Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef APOL_MLS_INTERNAL_H
+#define APOL_MLS_INTERNAL_H
+
+#include <apol/mls_level.h>
+#include <apol/mls_range.h>
+#include <apol/vector.h>
+#include <stdint.h>
+
+#define APOL_MLS_BITMAP_WORD_BITS 64
+
+/** A level resolved against a particular policy. */
+typedef struct mls_bitmap_level
+{
+	/** value of the level's sensitivity */
+	uint32_t sens;
+	/** bit (v - 1) is set for each category of value v; words beyond
+	 *  num_words are implicitly zero */
+	uint64_t *cats;
+	size_t num_words;
+} mls_bitmap_level_t;
+
+/** A range resolved against a particular policy.  If the range has
+ *  no high level then high is a copy of low. */
+typedef struct mls_bitmap_range
+{
+	mls_bitmap_level_t low, high;
+	/** non-zero if the range's low and high levels are the same
+	 *  object, which apol_mls_range_contain_subrange() treats
+	 *  specially */
+	int is_single;
+} mls_bitmap_range_t;
+
+/**
+ * Resolve a level's sensitivity and categories into values, as a copy
+ * of mls_level_get_bitmap()'s result.
+ *
+ * @param p Policy within which to look up names.
+ * @param level Level to resolve; it must not be literal.
+ * @param b Resolved level to fill.  Call mls_bitmap_level_fini()
+ * afterwards.
+ *
+ * @return 0 on success, < 0 on error (including if a name is not
+ * within the policy).
+ */
+extern int mls_level_resolve(const apol_policy_t * p, const apol_mls_level_t * level, mls_bitmap_level_t * b);
+
+/**
+ * Get a level resolved against a policy.  The result is cached within
+ * the level, and reused until the level changes, is resolved against
+ * another policy, or the policy is rebuilt.  The cache is written
+ * without any lock, even through a const level, so a level must not
+ * be shared among threads; a thread that needs to resolve a shared
+ * level should use mls_level_resolve() upon its own copy, or resolve
+ * it before the threads start.
+ *
+ * @param p Policy within which to look up names.
+ * @param level Level to resolve; it must not be literal.
+ *
+ * @return Resolved level, owned by the level, or NULL on error
+ * (including if a name is not within the policy).
+ */
+extern const mls_bitmap_level_t *mls_level_get_bitmap(const apol_policy_t * p, const apol_mls_level_t * level);
+
+/**
+ * Free the space used by a resolved level (but not the struct itself).
+ */
+extern void mls_bitmap_level_fini(mls_bitmap_level_t * b);
+
+/**
+ * Set the bit for a category value within a resolved level.
+ *
+ * @return 0 on success, < 0 on out of memory.
+ */
+extern int mls_bitmap_level_set_cat(mls_bitmap_level_t * b, uint32_t cat_value);
+
+/**
+ * Return non-zero if a resolved level includes a category value.
+ */
+extern int mls_bitmap_level_has_cat(const mls_bitmap_level_t * b, uint32_t cat_value);
+
+/**
+ * Compare two resolved levels.
+ *
+ * @return One of APOL_MLS_EQ, APOL_MLS_DOM, APOL_MLS_DOMBY, or
+ * APOL_MLS_INCOMP, with the same meaning as apol_mls_level_compare().
+ */
+extern int mls_bitmap_level_compare(const mls_bitmap_level_t * l1, const mls_bitmap_level_t * l2);
+
+/**
+ * Return non-zero if every category of sub is also in super.
+ */
+extern int mls_bitmap_cats_subset(const mls_bitmap_level_t * sub, const mls_bitmap_level_t * super);
+
+/**
+ * Resolve both levels of a range.
+ *
+ * @param p Policy within which to look up names.
+ * @param range Range to resolve; it must have a low level.
+ * @param b Resolved range to fill.  Call mls_bitmap_range_fini()
+ * afterwards.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+extern int mls_range_resolve(const apol_policy_t * p, const apol_mls_range_t * range, mls_bitmap_range_t * b);
+
+/**
+ * Free the space used by a resolved range (but not the struct itself).
+ */
+extern void mls_bitmap_range_fini(mls_bitmap_range_t * b);
+
+/**
+ * Return non-zero if a resolved range includes a resolved level.
+ */
+extern int mls_bitmap_range_include_level(const mls_bitmap_range_t * range, const mls_bitmap_level_t * level);
+
+/**
+ * Replace a level's categories with a vector of names, which must
+ * already be sorted by name.  The level takes ownership of the vector
+ * and its strings.
+ */
+extern void mls_level_set_cats_vector(apol_mls_level_t * level, apol_vector_t * cats);
+
+#endif
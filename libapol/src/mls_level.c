@@ -33,6 +33,7 @@
 #include <string.h>
 
 #include "policy-query-internal.h"
+#include "mls-internal.h"
 
 #include <qpol/iterator.h>
 #include <apol/vector.h>
@@ -42,28 +43,26 @@ struct apol_mls_level
 	char *sens;
 	apol_vector_t *cats;	       // if NULL, then level is incomplete
 	char *literal_cats;
+	/* sensitivity and categories as values within resolved_policy
+	 * as of its resolved_generation, built upon first use by
+	 * mls_level_get_bitmap() and discarded whenever the level
+	 * changes */
+	const apol_policy_t *resolved_policy;
+	unsigned int resolved_generation;
+	mls_bitmap_level_t resolved;
 };
 
 /********************* miscellaneous routines *********************/
 
-/* Given a category datum and a category name, returns < 0 if a has
- * higher value than b, > 0 if b is higher according to the given
- * policy.  If the two are equal or upon error, return 0.
+/**
+ * Discard a level's resolved form, after its sensitivity or
+ * categories have changed.
  */
-static int apol_mls_cat_vector_compare(const void *a, const void *b, void *data)
+static void mls_level_forget(apol_mls_level_t * level)
 {
-	const qpol_cat_t *cat1 = a;
-	const char *cat2_name = b;
-	apol_policy_t *p = (apol_policy_t *) data;
-	const qpol_cat_t *cat2;
-	uint32_t cat_value1, cat_value2;
-	if (qpol_policy_get_cat_by_name(p->p, cat2_name, &cat2) < 0) {
-		return 0;
-	}
-	if (qpol_cat_get_value(p->p, cat1, &cat_value1) < 0 || qpol_cat_get_value(p->p, cat2, &cat_value2) < 0) {
-		return 0;
-	}
-	return (cat_value2 - cat_value1);
+	mls_bitmap_level_fini(&level->resolved);
+	level->resolved_policy = NULL;
+	level->resolved_generation = 0;
 }
 
 /**
@@ -306,6 +305,7 @@ static void mls_level_free(void *level)
 		free(l->sens);
 		apol_vector_destroy(&l->cats);
 		free(l->literal_cats);
+		mls_level_forget(l);
 		free(l);
 	}
 }
@@ -325,6 +325,7 @@ int apol_mls_level_set_sens(const apol_policy_t * p, apol_mls_level_t * level, c
 		errno = EINVAL;
 		return -1;
 	}
+	mls_level_forget(level);
 	return apol_query_set(p, &level->sens, NULL, sens);
 }
 
@@ -346,6 +347,7 @@ int apol_mls_level_append_cats(const apol_policy_t * p, apol_mls_level_t * level
 		return -1;
 	}
 
+	mls_level_forget(level);
 	if (level->cats == NULL && (level->cats = apol_vector_create(free)) == NULL) {
 		ERR(p, "%s", strerror(errno));
 		return -1;
@@ -370,66 +372,29 @@ const apol_vector_t *apol_mls_level_get_cats(const apol_mls_level_t * level)
 
 int apol_mls_level_compare(const apol_policy_t * p, const apol_mls_level_t * l1, const apol_mls_level_t * l2)
 {
-	const qpol_level_t *level_datum1, *level_datum2;
-	int level1_sens, level2_sens, sens_cmp;
-	size_t l1_size, l2_size, i, j;
-	int m_list, ucat = 0;
-	apol_vector_t *cat_list_master, *cat_list_subset;
+	const mls_bitmap_level_t *b1, *b2;
 	if (l2 == NULL) {
 		return APOL_MLS_EQ;
 	}
-	if ((l1 != NULL && l1->cats == NULL) || (l2->cats == NULL)) {
+	if (l1 == NULL || l1->cats == NULL || l2->cats == NULL) {
 		errno = EINVAL;
 		return -1;
 	}
-	if (qpol_policy_get_level_by_name(p->p, l1->sens, &level_datum1) < 0 ||
-	    qpol_policy_get_level_by_name(p->p, l2->sens, &level_datum2) < 0) {
-		return -1;
-	}
-
-	/* compare the level's senstitivity value */
-	if (qpol_level_get_value(p->p, level_datum1, (uint32_t *) (&level1_sens)) < 0 ||
-	    qpol_level_get_value(p->p, level_datum2, (uint32_t *) (&level2_sens)) < 0) {
+	if ((b1 = mls_level_get_bitmap(p, l1)) == NULL || (b2 = mls_level_get_bitmap(p, l2)) == NULL) {
 		return -1;
 	}
-	sens_cmp = level1_sens - level2_sens;
-
-	/* determine if all the categories in one level are in the other set */
-	l1_size = apol_vector_get_size(l1->cats);
-	l2_size = apol_vector_get_size(l2->cats);
-	if (l1_size < l2_size) {
-		m_list = 2;
-		cat_list_master = l2->cats;
-		cat_list_subset = l1->cats;
-	} else {
-		m_list = 1;
-		cat_list_master = l1->cats;
-		cat_list_subset = l2->cats;
-	}
-	for (i = 0; i < apol_vector_get_size(cat_list_subset); i++) {
-		char *cat = (char *)apol_vector_get_element(cat_list_subset, i);
-		if (apol_vector_get_index(cat_list_master, cat, apol_mls_cat_name_compare, (void *)p, &j) < 0) {
-			ucat = 1;
-			break;
-		}
-	}
-
-	if (!sens_cmp && !ucat && l1_size == l2_size)
-		return APOL_MLS_EQ;
-	if (sens_cmp >= 0 && m_list == 1 && !ucat)
-		return APOL_MLS_DOM;
-	if (sens_cmp <= 0 && (m_list == 2 || l1_size == l2_size) && !ucat)
-		return APOL_MLS_DOMBY;
-	return APOL_MLS_INCOMP;
+	return mls_bitmap_level_compare(b1, b2);
 }
 
 int apol_mls_level_validate(const apol_policy_t * p, const apol_mls_level_t * level)
 {
 	const qpol_level_t *level_datum;
+	const qpol_cat_t *cat;
 	qpol_iterator_t *iter = NULL;
-	apol_vector_t *cat_vector;
-	int retval = -1;
-	size_t i, j;
+	const mls_bitmap_level_t *b;
+	mls_bitmap_level_t allowed;
+	uint32_t cat_value;
+	int retval = -1, error = 0;
 
 	if (p == NULL || level == NULL || level->cats == NULL) {
 		ERR(p, "%s", strerror(EINVAL));
@@ -439,27 +404,35 @@ int apol_mls_level_validate(const apol_policy_t * p, const apol_mls_level_t * le
 	if (level->sens == NULL) {
 		return 0;
 	}
+	memset(&allowed, 0, sizeof(allowed));
 	if (qpol_policy_get_level_by_name(p->p, level->sens, &level_datum) < 0 ||
 	    qpol_level_get_cat_iter(p->p, level_datum, &iter) < 0) {
-		return -1;
-	}
-	if ((cat_vector = apol_vector_create_from_iter(iter, NULL)) == NULL) {
-		ERR(p, "%s", strerror(errno));
+		error = errno;
 		goto cleanup;
 	}
-
-	for (i = 0; i < apol_vector_get_size(level->cats); i++) {
-		char *cat_name = (char *)apol_vector_get_element(level->cats, i);
-		if (apol_vector_get_index(cat_vector, cat_name, apol_mls_cat_vector_compare, (void *)p, &j) < 0) {
-			retval = 0;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&cat) < 0 || qpol_cat_get_value(p->p, cat, &cat_value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (mls_bitmap_level_set_cat(&allowed, cat_value) < 0) {
+			error = errno;
+			ERR(p, "%s", strerror(error));
 			goto cleanup;
 		}
 	}
-
-	retval = 1;
+	/* a category not within the policy cannot be valid */
+	if ((b = mls_level_get_bitmap(p, level)) == NULL) {
+		retval = 0;
+		goto cleanup;
+	}
+	retval = mls_bitmap_cats_subset(b, &allowed) ? 1 : 0;
       cleanup:
 	qpol_iterator_destroy(&iter);
-	apol_vector_destroy(&cat_vector);
+	mls_bitmap_level_fini(&allowed);
+	if (retval < 0) {
+		errno = error;
+	}
 	return retval;
 }
 
@@ -598,6 +571,7 @@ int apol_mls_level_convert(const apol_policy_t * p, apol_mls_level_t * level)
 		goto err;
 	}
 
+	mls_level_forget(level);
 	apol_vector_destroy(&level->cats);
 	if (level->literal_cats[0] == '\0') {
 		if ((level->cats = apol_vector_create_with_capacity(1, free)) == NULL) {
@@ -759,6 +733,169 @@ int apol_mls_level_convert(const apol_policy_t * p, apol_mls_level_t * level)
 	return -1;
 }
 
+/******************** resolved levels ********************/
+
+/**
+ * Look up a level's sensitivity and categories by name.
+ */
+static int mls_level_build_bitmap(const apol_policy_t * p, const apol_mls_level_t * level, mls_bitmap_level_t * b)
+{
+	const qpol_level_t *level_datum;
+	const qpol_cat_t *cat;
+	uint32_t cat_value;
+	size_t i;
+	int error = 0;
+
+	memset(b, 0, sizeof(*b));
+	if (p == NULL || level == NULL || level->sens == NULL || level->cats == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (qpol_policy_get_level_by_name(p->p, level->sens, &level_datum) < 0 ||
+	    qpol_level_get_value(p->p, level_datum, &b->sens) < 0) {
+		return -1;
+	}
+	for (i = 0; i < apol_vector_get_size(level->cats); i++) {
+		const char *cat_name = apol_vector_get_element(level->cats, i);
+		if (qpol_policy_get_cat_by_name(p->p, cat_name, &cat) < 0 || qpol_cat_get_value(p->p, cat, &cat_value) < 0) {
+			error = errno;
+			goto err;
+		}
+		if (mls_bitmap_level_set_cat(b, cat_value) < 0) {
+			error = errno;
+			ERR(p, "%s", strerror(error));
+			goto err;
+		}
+	}
+	return 0;
+      err:
+	mls_bitmap_level_fini(b);
+	errno = error;
+	return -1;
+}
+
+const mls_bitmap_level_t *mls_level_get_bitmap(const apol_policy_t * p, const apol_mls_level_t * level)
+{
+	apol_mls_level_t *l = (apol_mls_level_t *) level;
+	unsigned int generation;
+	if (p == NULL || level == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return NULL;
+	}
+	/* the generation tells apart a rebuilt policy, and another
+	 * policy allocated where this one once was */
+	if (qpol_policy_get_generation(p->p, &generation) < 0) {
+		return NULL;
+	}
+	if (level->resolved_policy == p && level->resolved_generation == generation) {
+		return &level->resolved;
+	}
+	mls_level_forget(l);
+	if (mls_level_build_bitmap(p, level, &l->resolved) < 0) {
+		return NULL;
+	}
+	l->resolved_policy = p;
+	l->resolved_generation = generation;
+	return &l->resolved;
+}
+
+int mls_level_resolve(const apol_policy_t * p, const apol_mls_level_t * level, mls_bitmap_level_t * b)
+{
+	const mls_bitmap_level_t *cached;
+
+	memset(b, 0, sizeof(*b));
+	if ((cached = mls_level_get_bitmap(p, level)) == NULL) {
+		return -1;
+	}
+	if (cached->num_words > 0) {
+		if ((b->cats = malloc(cached->num_words * sizeof(*b->cats))) == NULL) {
+			ERR(p, "%s", strerror(errno));
+			return -1;
+		}
+		memcpy(b->cats, cached->cats, cached->num_words * sizeof(*b->cats));
+		b->num_words = cached->num_words;
+	}
+	b->sens = cached->sens;
+	return 0;
+}
+
+void mls_bitmap_level_fini(mls_bitmap_level_t * b)
+{
+	if (b != NULL) {
+		free(b->cats);
+		b->cats = NULL;
+		b->num_words = 0;
+	}
+}
+
+int mls_bitmap_level_set_cat(mls_bitmap_level_t * b, uint32_t cat_value)
+{
+	size_t word;
+	if (cat_value == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	word = (cat_value - 1) / APOL_MLS_BITMAP_WORD_BITS;
+	if (word >= b->num_words) {
+		uint64_t *cats = realloc(b->cats, (word + 1) * sizeof(*cats));
+		if (cats == NULL) {
+			return -1;
+		}
+		memset(cats + b->num_words, 0, (word + 1 - b->num_words) * sizeof(*cats));
+		b->cats = cats;
+		b->num_words = word + 1;
+	}
+	b->cats[word] |= ((uint64_t) 1) << ((cat_value - 1) % APOL_MLS_BITMAP_WORD_BITS);
+	return 0;
+}
+
+int mls_bitmap_level_has_cat(const mls_bitmap_level_t * b, uint32_t cat_value)
+{
+	size_t word;
+	if (cat_value == 0) {
+		return 0;
+	}
+	word = (cat_value - 1) / APOL_MLS_BITMAP_WORD_BITS;
+	if (word >= b->num_words) {
+		return 0;
+	}
+	return (b->cats[word] >> ((cat_value - 1) % APOL_MLS_BITMAP_WORD_BITS)) & 1;
+}
+
+int mls_bitmap_cats_subset(const mls_bitmap_level_t * sub, const mls_bitmap_level_t * super)
+{
+	size_t i;
+	for (i = 0; i < sub->num_words; i++) {
+		uint64_t super_word = (i < super->num_words ? super->cats[i] : 0);
+		if (sub->cats[i] & ~super_word) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int mls_bitmap_level_compare(const mls_bitmap_level_t * l1, const mls_bitmap_level_t * l2)
+{
+	int l1_has_all = mls_bitmap_cats_subset(l2, l1);
+	int l2_has_all = mls_bitmap_cats_subset(l1, l2);
+	if (l1->sens == l2->sens && l1_has_all && l2_has_all)
+		return APOL_MLS_EQ;
+	if (l1->sens >= l2->sens && l1_has_all)
+		return APOL_MLS_DOM;
+	if (l1->sens <= l2->sens && l2_has_all)
+		return APOL_MLS_DOMBY;
+	return APOL_MLS_INCOMP;
+}
+
+void mls_level_set_cats_vector(apol_mls_level_t * level, apol_vector_t * cats)
+{
+	mls_level_forget(level);
+	apol_vector_destroy(&level->cats);
+	level->cats = cats;
+}
+
 int apol_mls_level_is_literal(const apol_mls_level_t * level)
 {
 	if (level == NULL) {
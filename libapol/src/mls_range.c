@@ -32,6 +32,7 @@
 #include <string.h>
 
 #include "policy-query-internal.h"
+#include "mls-internal.h"
 
 #include <qpol/iterator.h>
 #include <apol/vector.h>
@@ -283,10 +284,70 @@ const apol_mls_level_t *apol_mls_range_get_high(const apol_mls_range_t * range)
 	return range->high;
 }
 
+/**
+ * Return non-zero if every level of sub lies within range.
+ */
+static int mls_bitmap_range_contain(const mls_bitmap_range_t * range, const mls_bitmap_range_t * sub)
+{
+	return mls_bitmap_range_include_level(range, &sub->low) && mls_bitmap_range_include_level(range, &sub->high);
+}
+
+/**
+ * Point b at the resolved forms cached within a range's levels.  b
+ * must not be passed to mls_bitmap_range_fini().
+ */
+static int apol_mls_range_get_bitmaps(const apol_policy_t * p, const apol_mls_range_t * range, mls_bitmap_range_t * b)
+{
+	const apol_mls_level_t *high = (range->high != NULL ? range->high : range->low);
+	const mls_bitmap_level_t *low_bitmap, *high_bitmap;
+	if ((low_bitmap = mls_level_get_bitmap(p, range->low)) == NULL ||
+	    (high_bitmap = mls_level_get_bitmap(p, high)) == NULL) {
+		return -1;
+	}
+	b->low = *low_bitmap;
+	b->high = *high_bitmap;
+	b->is_single = (high == range->low);
+	return 0;
+}
+
+static uint64_t mls_bitmap_word(const mls_bitmap_level_t * b, size_t i)
+{
+	return (i < b->num_words ? b->cats[i] : 0);
+}
+
+/**
+ * Return non-zero if some level lies within both ranges.  The least
+ * such level has the higher of the two low sensitivities and the
+ * union of the low categories; it must be dominated by the greatest
+ * level within both, which has the lower of the two high
+ * sensitivities and the intersection of the high categories.
+ */
+static int mls_bitmap_range_intersect(const mls_bitmap_range_t * r1, const mls_bitmap_range_t * r2)
+{
+	uint32_t low_sens = (r1->low.sens > r2->low.sens ? r1->low.sens : r2->low.sens);
+	uint32_t high_sens = (r1->high.sens < r2->high.sens ? r1->high.sens : r2->high.sens);
+	size_t num_words = r1->low.num_words, i;
+	if (low_sens > high_sens) {
+		return 0;
+	}
+	if (r2->low.num_words > num_words) {
+		num_words = r2->low.num_words;
+	}
+	for (i = 0; i < num_words; i++) {
+		uint64_t low_word = mls_bitmap_word(&r1->low, i) | mls_bitmap_word(&r2->low, i);
+		uint64_t high_word = mls_bitmap_word(&r1->high, i) & mls_bitmap_word(&r2->high, i);
+		if (low_word & ~high_word) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
 int apol_mls_range_compare(const apol_policy_t * p, const apol_mls_range_t * target, const apol_mls_range_t * search,
 			   unsigned int range_compare_type)
 {
-	int ans1 = -1, ans2 = -1;
+	mls_bitmap_range_t t, s;
+	int ans1 = -1, ans2 = -1, ans3 = -1, retval = -1;
 	if (search == NULL) {
 		return 1;
 	}
@@ -295,77 +356,51 @@ int apol_mls_range_compare(const apol_policy_t * p, const apol_mls_range_t * tar
 		errno = EINVAL;
 		return -1;
 	}
-	/* FIX ME:  intersect does not work */
-	if ((range_compare_type & APOL_QUERY_SUB) || (range_compare_type & APOL_QUERY_INTERSECT)) {
-		ans1 = apol_mls_range_contain_subrange(p, target, search);
-		if (ans1 < 0) {
-			return -1;
-		}
+	if (((range_compare_type & (APOL_QUERY_SUB | APOL_QUERY_INTERSECT)) && apol_mls_range_validate(p, search) != 1) ||
+	    ((range_compare_type & (APOL_QUERY_SUPER | APOL_QUERY_INTERSECT)) && apol_mls_range_validate(p, target) != 1)) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
 	}
-	if ((range_compare_type & APOL_QUERY_SUPER) || (range_compare_type & APOL_QUERY_INTERSECT)) {
-		ans2 = apol_mls_range_contain_subrange(p, search, target);
-		if (ans2 < 0) {
-			return -1;
-		}
+	if (apol_mls_range_get_bitmaps(p, target, &t) < 0 || apol_mls_range_get_bitmaps(p, search, &s) < 0) {
+		return -1;
+	}
+	if (range_compare_type & APOL_QUERY_SUB) {
+		ans1 = mls_bitmap_range_contain(&t, &s);
+	}
+	if (range_compare_type & APOL_QUERY_SUPER) {
+		ans2 = mls_bitmap_range_contain(&s, &t);
+	}
+	if (range_compare_type & APOL_QUERY_INTERSECT) {
+		ans3 = mls_bitmap_range_intersect(&t, &s);
 	}
 	/* EXACT has to come first because its bits are both SUB and SUPER */
 	if ((range_compare_type & APOL_QUERY_EXACT) == APOL_QUERY_EXACT) {
-		return (ans1 && ans2);
+		retval = (ans1 && ans2);
 	} else if (range_compare_type & APOL_QUERY_SUB) {
-		return ans1;
+		retval = ans1;
 	} else if (range_compare_type & APOL_QUERY_SUPER) {
-		return ans2;
+		retval = ans2;
 	} else if (range_compare_type & APOL_QUERY_INTERSECT) {
-		return (ans1 || ans2);
-	}
-	ERR(p, "%s", "Invalid range compare type argument.");
-	errno = EINVAL;
-	return -1;
-}
-
-static int apol_mls_range_does_include_level(const apol_policy_t * p, const apol_mls_range_t * range,
-					     const apol_mls_level_t * level)
-{
-	int high_cmp = -1, low_cmp = -1;
-
-	if (range->low != range->high) {
-		low_cmp = apol_mls_level_compare(p, range->low, level);
-		if (low_cmp < 0) {
-			return -1;
-		}
-	}
-	const apol_mls_level_t *high_level = (range->high != NULL ? range->high : range->low);
-	high_cmp = apol_mls_level_compare(p, high_level, level);
-	if (high_cmp < 0) {
-		return -1;
-	}
-
-	if (high_cmp == APOL_MLS_EQ || high_cmp == APOL_MLS_DOM) {
-		if ((low_cmp == APOL_MLS_EQ || low_cmp == APOL_MLS_DOMBY) && range->low != high_level) {
-			return 1;
-		} else if (range->low == high_level) {
-			return apol_mls_sens_compare(p, apol_mls_level_get_sens(range->low), apol_mls_level_get_sens(level));
-		}
+		retval = ans3;
+	} else {
+		ERR(p, "%s", "Invalid range compare type argument.");
+		errno = EINVAL;
 	}
-
-	return 0;
+	return retval;
 }
 
 int apol_mls_range_contain_subrange(const apol_policy_t * p, const apol_mls_range_t * range, const apol_mls_range_t * subrange)
 {
-	if (p == NULL || apol_mls_range_validate(p, subrange) != 1) {
+	mls_bitmap_range_t r, sub;
+	if (p == NULL || range == NULL || range->low == NULL || apol_mls_range_validate(p, subrange) != 1) {
 		ERR(p, "%s", strerror(EINVAL));
 		return -1;
 	}
-	/* parent range validity will be checked via
-	 * apol_mls_range_include_level() */
-
-	if (apol_mls_range_does_include_level(p, range, subrange->low)) {
-		if (subrange->high == NULL || apol_mls_range_does_include_level(p, range, subrange->high)) {
-			return 1;
-		}
+	if (apol_mls_range_get_bitmaps(p, range, &r) < 0 || apol_mls_range_get_bitmaps(p, subrange, &sub) < 0) {
+		return -1;
 	}
-	return 0;
+	return mls_bitmap_range_contain(&r, &sub);
 }
 
 int apol_mls_range_validate(const apol_policy_t * p, const apol_mls_range_t * range)
@@ -416,16 +451,6 @@ static int mls_range_comp(const void *a, const void *b, void *data)
 	return low_value - high_value;
 }
 
-static int mls_level_name_to_cat_comp(const void *a, const void *b, void *data)
-{
-	const qpol_cat_t *cat = a;
-	const char *name = (const char *)b;
-	qpol_policy_t *q = (qpol_policy_t *) data;
-	const char *cat_name = "";
-	qpol_cat_get_name(q, cat, &cat_name);
-	return strcmp(name, cat_name);
-}
-
 static void mls_level_free(void *elem)
 {
 	apol_mls_level_t *level = elem;
@@ -435,12 +460,17 @@ static void mls_level_free(void *elem)
 apol_vector_t *apol_mls_range_get_levels(const apol_policy_t * p, const apol_mls_range_t * range)
 {
 	qpol_policy_t *q = apol_policy_get_qpol(p);
-	apol_vector_t *v = NULL, *catv = NULL;
+	apol_vector_t *v = NULL, *cats = NULL;
 	const qpol_level_t *l;
-	uint32_t low_value, high_value, value;
+	const qpol_cat_t *cat;
+	uint32_t low_value, high_value, value, *high_cat_values = NULL;
+	mls_bitmap_level_t allowed;
+	const apol_vector_t *high_cats;
+	size_t i;
 	int error = 0;
 	qpol_iterator_t *iter = NULL, *catiter = NULL;
 
+	memset(&allowed, 0, sizeof(allowed));
 	if (p == NULL || range == NULL || range->low == NULL) {
 		error = EINVAL;
 		ERR(p, "%s", strerror(error));
@@ -464,6 +494,25 @@ apol_vector_t *apol_mls_range_get_levels(const apol_policy_t * p, const apol_mls
 		goto err;
 	}
 	assert(low_value <= high_value);
+
+	/* look up each of the high level's categories once, rather than
+	 * once per sensitivity */
+	high_cats = apol_mls_level_get_cats(high_level);
+	if (apol_vector_get_size(high_cats) > 0 &&
+	    (high_cat_values = malloc(apol_vector_get_size(high_cats) * sizeof(*high_cat_values))) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		goto err;
+	}
+	for (i = 0; i < apol_vector_get_size(high_cats); i++) {
+		/* categories that are not legal under the given policy
+		 * are never members of a level */
+		if (qpol_policy_get_cat_by_name(q, apol_vector_get_element(high_cats, i), &cat) < 0 ||
+		    qpol_cat_get_value(q, cat, &high_cat_values[i]) < 0) {
+			high_cat_values[i] = 0;
+		}
+	}
+
 	if ((v = apol_vector_create(mls_level_free)) == NULL) {
 		error = errno;
 		ERR(p, "%s", strerror(error));
@@ -491,32 +540,47 @@ apol_vector_t *apol_mls_range_get_levels(const apol_policy_t * p, const apol_mls
 			goto err;
 		}
 
-		if (qpol_level_get_cat_iter(q, l, &catiter) < 0 || (catv = apol_vector_create_from_iter(catiter, NULL)) == NULL) {
+		mls_bitmap_level_fini(&allowed);
+		if (qpol_level_get_cat_iter(q, l, &catiter) < 0) {
 			error = errno;
+			apol_mls_level_destroy(&ml);
 			goto err;
 		}
+		for (; !qpol_iterator_end(catiter); qpol_iterator_next(catiter)) {
+			if (qpol_iterator_get_item(catiter, (void **)&cat) < 0 || qpol_cat_get_value(q, cat, &value) < 0 ||
+			    mls_bitmap_level_set_cat(&allowed, value) < 0) {
+				error = errno;
+				apol_mls_level_destroy(&ml);
+				goto err;
+			}
+		}
+		qpol_iterator_destroy(&catiter);
 
-		const apol_vector_t *high_cats = apol_mls_level_get_cats(high_level);
-		for (size_t i = 0; i < apol_vector_get_size(high_cats); i++) {
-			char *cat_name = apol_vector_get_element(high_cats, i);
-
-			size_t j;
-			/* do not add categories that are not members of
-			   the level */
-			if (apol_vector_get_index(catv, cat_name, mls_level_name_to_cat_comp, q, &j) < 0) {
-				/* this category is not legal under the given policy */
+		/* do not add categories that are not members of the
+		 * level; the high level's categories are already sorted,
+		 * so the subset is too */
+		if ((cats = apol_vector_create_with_capacity(apol_vector_get_size(high_cats), free)) == NULL) {
+			error = errno;
+			apol_mls_level_destroy(&ml);
+			ERR(p, "%s", strerror(error));
+			goto err;
+		}
+		for (i = 0; i < apol_vector_get_size(high_cats); i++) {
+			char *cat_name;
+			if (!mls_bitmap_level_has_cat(&allowed, high_cat_values[i])) {
 				continue;
 			}
-			if (apol_mls_level_append_cats(p, ml, cat_name) < 0) {
+			if ((cat_name = strdup(apol_vector_get_element(high_cats, i))) == NULL ||
+			    apol_vector_append(cats, cat_name) < 0) {
 				error = errno;
+				free(cat_name);
 				apol_mls_level_destroy(&ml);
 				ERR(p, "%s", strerror(error));
 				goto err;
 			}
 		}
-
-		qpol_iterator_destroy(&catiter);
-		apol_vector_destroy(&catv);
+		mls_level_set_cats_vector(ml, cats);
+		cats = NULL;
 
 		if (apol_vector_append(v, ml) < 0) {
 			error = errno;
@@ -527,14 +591,16 @@ apol_vector_t *apol_mls_range_get_levels(const apol_policy_t * p, const apol_mls
 	}
 	apol_vector_sort(v, mls_range_comp, q);
 	qpol_iterator_destroy(&iter);
-	qpol_iterator_destroy(&catiter);
-	apol_vector_destroy(&catv);
+	mls_bitmap_level_fini(&allowed);
+	free(high_cat_values);
 	return v;
       err:
 	qpol_iterator_destroy(&iter);
 	qpol_iterator_destroy(&catiter);
 	apol_vector_destroy(&v);
-	apol_vector_destroy(&catv);
+	apol_vector_destroy(&cats);
+	mls_bitmap_level_fini(&allowed);
+	free(high_cat_values);
 	errno = error;
 	return NULL;
 }
@@ -625,6 +691,53 @@ int apol_mls_range_convert(const apol_policy_t * p, apol_mls_range_t * range)
 	return 0;
 }
 
+/******************** resolved ranges ********************/
+
+int mls_range_resolve(const apol_policy_t * p, const apol_mls_range_t * range, mls_bitmap_range_t * b)
+{
+	const apol_mls_level_t *high;
+	int error;
+
+	memset(b, 0, sizeof(*b));
+	if (range == NULL || range->low == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	high = (range->high != NULL ? range->high : range->low);
+	b->is_single = (high == range->low);
+	if (mls_level_resolve(p, range->low, &b->low) < 0 || mls_level_resolve(p, high, &b->high) < 0) {
+		error = errno;
+		mls_bitmap_range_fini(b);
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+void mls_bitmap_range_fini(mls_bitmap_range_t * b)
+{
+	if (b != NULL) {
+		mls_bitmap_level_fini(&b->low);
+		mls_bitmap_level_fini(&b->high);
+	}
+}
+
+int mls_bitmap_range_include_level(const mls_bitmap_range_t * range, const mls_bitmap_level_t * level)
+{
+	int high_cmp = mls_bitmap_level_compare(&range->high, level);
+	if (high_cmp != APOL_MLS_EQ && high_cmp != APOL_MLS_DOM) {
+		return 0;
+	}
+	/* a range consisting of a single level includes those levels
+	 * with its sensitivity that it dominates */
+	if (range->is_single) {
+		return range->low.sens == level->sens;
+	}
+	int low_cmp = mls_bitmap_level_compare(&range->low, level);
+	return (low_cmp == APOL_MLS_EQ || low_cmp == APOL_MLS_DOMBY);
+}
+
 int apol_mls_range_is_literal(const apol_mls_range_t * range)
 {
 	if (range == NULL) {
@@ -0,0 +1,407 @@
+/**
+ * @file
+ * Implementation of a policy's cached memberships: the types of each
+ * attribute, the attributes of each type, the types of each role,
+ * and the roles of each user.  Walking a qpol iterator for these
+ * (and, for roles, expanding the role's type set) upon every query is
+ * costly.  The first three are instead read from the qpol policy's
+ * summary, and the users' roles from a table built here; both are
+ * built once, upon first use, and then shared by every query and
+ * analysis upon that policy.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "policy-query-internal.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MEMBERSHIP_ROW_SIZE(n) (((size_t) (n) + CHAR_BIT - 1) / CHAR_BIT)
+#define MEMBERSHIP_HAS_BIT(row, i) ((row)[(i) / CHAR_BIT] & (1U << ((i) % CHAR_BIT)))
+#define MEMBERSHIP_SET_BIT(row, i) ((row)[(i) / CHAR_BIT] |= (unsigned char)(1U << ((i) % CHAR_BIT)))
+
+/** The tables are never changed once published; a new generation of
+ *  the qpol policy gets new tables. */
+struct apol_membership
+{
+	/** generation of the qpol policy from which these were built */
+	unsigned int generation;
+	/** one more than the greatest role value */
+	uint32_t num_roles;
+	/** one more than the greatest user value */
+	uint32_t num_users;
+	/** bit r of row u is set if user value u may hold role value r */
+	unsigned char *user_roles;
+};
+
+void membership_destroy(apol_membership_t ** m)
+{
+	if (m != NULL && *m != NULL) {
+		free((*m)->user_roles);
+		free(*m);
+		*m = NULL;
+	}
+}
+
+/**
+ * Find one more than the greatest value among a qpol iterator's roles
+ * or users.
+ *
+ * @param p Policy containing the symbols.
+ * @param iter Iterator over the symbols; it is consumed.
+ * @param get_value Function that returns a symbol's value.
+ * @param num Reference to the result.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int membership_count_values(const apol_policy_t * p, qpol_iterator_t * iter,
+				   int (*get_value) (const qpol_policy_t *, const void *, uint32_t *), uint32_t * num)
+{
+	void *item;
+	uint32_t value;
+
+	*num = 1;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, &item) < 0 || get_value(p->p, item, &value) < 0) {
+			return -1;
+		}
+		if (value >= *num) {
+			*num = value + 1;
+		}
+	}
+	return 0;
+}
+
+static int membership_role_value(const qpol_policy_t * q, const void *role, uint32_t * value)
+{
+	return qpol_role_get_value(q, role, value);
+}
+
+static int membership_user_value(const qpol_policy_t * q, const void *user, uint32_t * value)
+{
+	return qpol_user_get_value(q, user, value);
+}
+
+/**
+ * Build the table of the roles that each user may hold.  This reads
+ * the policy but changes nothing, so it may run upon several threads
+ * at once; it reports no errors, leaving that to the caller.
+ *
+ * @param p Policy whose users to index.
+ * @param generation Generation of the policy's qpol policy.
+ *
+ * @return The tables, or NULL upon error.
+ */
+static apol_membership_t *membership_build(const apol_policy_t * p, unsigned int generation)
+{
+	qpol_iterator_t *iter = NULL, *role_iter = NULL;
+	apol_membership_t *m;
+	const qpol_user_t *user;
+	const qpol_role_t *role;
+	unsigned char *row;
+	uint32_t value, role_value;
+	size_t row_size;
+	int error = 0;
+
+	if ((m = calloc(1, sizeof(*m))) == NULL) {
+		return NULL;
+	}
+	m->generation = generation;
+	if (qpol_policy_get_role_iter(p->p, &iter) < 0 ||
+	    membership_count_values(p, iter, membership_role_value, &m->num_roles) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	qpol_iterator_destroy(&iter);
+	if (qpol_policy_get_user_iter(p->p, &iter) < 0 ||
+	    membership_count_values(p, iter, membership_user_value, &m->num_users) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	qpol_iterator_destroy(&iter);
+	row_size = MEMBERSHIP_ROW_SIZE(m->num_roles);
+	if ((m->user_roles = calloc(m->num_users, row_size)) == NULL || qpol_policy_get_user_iter(p->p, &iter) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&user) < 0 || qpol_user_get_value(p->p, user, &value) < 0 ||
+		    qpol_user_get_role_iter(p->p, user, &role_iter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		row = m->user_roles + value * row_size;
+		for (; !qpol_iterator_end(role_iter); qpol_iterator_next(role_iter)) {
+			if (qpol_iterator_get_item(role_iter, (void **)&role) < 0 ||
+			    qpol_role_get_value(p->p, role, &role_value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			if (role_value < m->num_roles) {
+				MEMBERSHIP_SET_BIT(row, role_value);
+			}
+		}
+		qpol_iterator_destroy(&role_iter);
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	qpol_iterator_destroy(&role_iter);
+	if (error != 0) {
+		membership_destroy(&m);
+		errno = error;
+	}
+	return m;
+}
+
+/**
+ * Return a policy's membership tables, building them, and the qpol
+ * policy's summary, if this is their first use since the qpol policy
+ * was last rebuilt.  Once published the tables are never changed, so
+ * they are read without any lock; the lock only serializes their
+ * publication.  The caller must not use the tables after the policy
+ * is rebuilt or apol_policy_reset_membership() is called, neither of
+ * which may happen while another thread queries the policy.
+ *
+ * @param p Policy whose tables to get.
+ *
+ * @return The tables, or NULL upon error.
+ */
+static const apol_membership_t *membership_get(const apol_policy_t * p)
+{
+	apol_policy_t *policy = (apol_policy_t *) p;
+	apol_membership_t *m, *built;
+	unsigned int generation;
+	int error = 0;
+
+	if (qpol_policy_get_generation(p->p, &generation) < 0) {
+		return NULL;
+	}
+	m = __atomic_load_n(&policy->membership, __ATOMIC_ACQUIRE);
+	if (m != NULL && m->generation == generation) {
+		return m;
+	}
+
+	/* build outside of the lock, so that this sends no message
+	 * while it is held; should another thread publish first, its
+	 * tables are used instead */
+	if ((built = membership_build(p, generation)) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		errno = error;
+		return NULL;
+	}
+	pthread_mutex_lock(&policy->membership_lock);
+	m = policy->membership;
+	if (m == NULL || m->generation != generation) {
+		/* the summary is shared by every user of the qpol policy,
+		 * so it too is built only while the lock is held */
+		if (qpol_policy_build_summary(p->p) < 0) {
+			error = errno;
+		} else {
+			/* a rebuilt qpol policy has freed every cached
+			 * type, role, and user */
+			membership_destroy(&policy->membership);
+			__atomic_store_n(&policy->membership, built, __ATOMIC_RELEASE);
+			m = built;
+			built = NULL;
+		}
+	}
+	pthread_mutex_unlock(&policy->membership_lock);
+	membership_destroy(&built);
+	if (error != 0) {
+		errno = error;
+		return NULL;
+	}
+	return m;
+}
+
+void apol_policy_reset_membership(apol_policy_t * p)
+{
+	if (p == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&p->membership_lock);
+	membership_destroy(&p->membership);
+	pthread_mutex_unlock(&p->membership_lock);
+}
+
+/**
+ * Append to a vector the types of an attribute, or the attributes of
+ * a type, in order of value.
+ *
+ * @param p Policy containing the type.
+ * @param type Type or attribute to look up.
+ * @param want_attr If non-zero then type must be an attribute,
+ * otherwise it must not be one.
+ * @param v Vector to which append qpol_type_t pointers.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int membership_append_type_members(const apol_policy_t * p, const qpol_type_t * type, int want_attr, apol_vector_t * v)
+{
+	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *const *members;
+	unsigned char isattr, isalias;
+	size_t num_members, i;
+	void *item;
+	int retval = -1, error = 0;
+
+	if (p == NULL || type == NULL || v == NULL) {
+		error = EINVAL;
+		ERR(p, "%s", strerror(error));
+		goto cleanup;
+	}
+	if (qpol_type_get_isattr(p->p, type, &isattr) < 0 || qpol_type_get_isalias(p->p, type, &isalias) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	if ((isattr != 0) != (want_attr != 0)) {
+		error = EINVAL;
+		ERR(p, "%s", strerror(error));
+		goto cleanup;
+	}
+	if (!isalias) {
+		if (membership_get(p) == NULL ||
+		    (isattr && qpol_summary_get_attr_types(p->p, type, &members, &num_members) != 0) ||
+		    (!isattr && qpol_summary_get_type_attrs(p->p, type, &members, &num_members) != 0)) {
+			error = errno;
+			goto cleanup;
+		}
+		for (i = 0; i < num_members; i++) {
+			if (apol_vector_append(v, (void *)members[i]) < 0) {
+				error = errno;
+				ERR(p, "%s", strerror(error));
+				goto cleanup;
+			}
+		}
+	} else {
+		/* an alias datum has its own membership */
+		if ((isattr && qpol_type_get_type_iter(p->p, type, &iter) < 0) ||
+		    (!isattr && qpol_type_get_attr_iter(p->p, type, &iter) < 0)) {
+			error = errno;
+			goto cleanup;
+		}
+		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+			if (qpol_iterator_get_item(iter, &item) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			if (apol_vector_append(v, item) < 0) {
+				error = errno;
+				ERR(p, "%s", strerror(error));
+				goto cleanup;
+			}
+		}
+	}
+	retval = 0;
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (retval < 0) {
+		errno = error;
+	}
+	return retval;
+}
+
+int apol_membership_append_types(const apol_policy_t * p, const qpol_type_t * attr, apol_vector_t * v)
+{
+	return membership_append_type_members(p, attr, 1, v);
+}
+
+int apol_membership_append_attribs(const apol_policy_t * p, const qpol_type_t * type, apol_vector_t * v)
+{
+	return membership_append_type_members(p, type, 0, v);
+}
+
+int apol_membership_append_role_types(const apol_policy_t * p, const qpol_role_t * role, apol_vector_t * v)
+{
+	const qpol_type_t *const *types;
+	size_t num_types, i;
+	int error;
+
+	if (p == NULL || role == NULL || v == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (membership_get(p) == NULL || qpol_summary_get_role_types(p->p, role, &types, &num_types) < 0) {
+		return -1;
+	}
+	for (i = 0; i < num_types; i++) {
+		if (apol_vector_append(v, (void *)types[i]) < 0) {
+			error = errno;
+			ERR(p, "%s", strerror(error));
+			errno = error;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int apol_membership_role_has_type(const apol_policy_t * p, const qpol_role_t * role, const qpol_type_t * type)
+{
+	const qpol_type_t *const *types;
+	size_t num_types, lo, hi, mid;
+	uint32_t type_value, value;
+
+	if (p == NULL || role == NULL || type == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (qpol_type_get_value(p->p, type, &type_value) < 0 || membership_get(p) == NULL ||
+	    qpol_summary_get_role_types(p->p, role, &types, &num_types) < 0) {
+		return -1;
+	}
+	/* the role's types are in order of value */
+	for (lo = 0, hi = num_types; lo < hi;) {
+		mid = lo + (hi - lo) / 2;
+		if (qpol_type_get_value(p->p, types[mid], &value) < 0) {
+			return -1;
+		}
+		if (value == type_value) {
+			return 1;
+		} else if (value < type_value) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return 0;
+}
+
+int apol_membership_user_has_role(const apol_policy_t * p, const qpol_user_t * user, const qpol_role_t * role)
+{
+	const apol_membership_t *m;
+	uint32_t value, role_value;
+
+	if (p == NULL || user == NULL || role == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (qpol_user_get_value(p->p, user, &value) < 0 || qpol_role_get_value(p->p, role, &role_value) < 0 ||
+	    (m = membership_get(p)) == NULL) {
+		return -1;
+	}
+	return (value < m->num_users && role_value < m->num_roles &&
+		MEMBERSHIP_HAS_BIT(m->user_roles + value * MEMBERSHIP_ROW_SIZE(m->num_roles), role_value)) ? 1 : 0;
+}
@@ -40,6 +40,7 @@ extern "C"
 #include <apol/util.h>
 #include <apol/vector.h>
 
+#include <pthread.h>
 #include <regex.h>
 #include <stdlib.h>
 #include <qpol/policy.h>
@@ -53,6 +54,9 @@ extern "C"
 /* declared in perm-map.c */
 	typedef struct apol_permmap apol_permmap_t;
 
+/* forward declaration. the definition resides within policy-membership.c */
+	typedef struct apol_membership apol_membership_t;
+
 	struct apol_policy
 	{
 		qpol_policy_t *p;
@@ -63,6 +67,11 @@ extern "C"
 		struct apol_permmap *pmap;
 	/** for domain trans analysis; table built as needed */
 		struct apol_domain_trans_table *domain_trans_table;
+	/** user memberships; built upon first use, then published and
+	 *  never changed, so that they are read without a lock */
+		apol_membership_t *membership;
+	/** serializes the publication of membership */
+		pthread_mutex_t membership_lock;
 	};
 
 /** Every query allows the treatment of strings as regular expressions
@@ -414,6 +423,59 @@ extern "C"
  */
 	apol_vector_t *apol_query_create_candidate_class_list(const apol_policy_t * p, apol_vector_t * classes);
 
+/**
+ * A set of types or classes, held as one byte per symbol value so
+ * that testing membership is an array lookup rather than a search
+ * through a candidate list.
+ */
+	typedef struct apol_query_value_map
+	{
+		unsigned char *map;
+		size_t size;
+	} apol_query_value_map_t;
+
+/**
+ * Build a value map from a candidate list.
+ *
+ * @param p Policy from which the list's items come.
+ * @param v Vector of qpol_type_t pointers (if is_class is 0) or
+ * qpol_class_t pointers (if non-zero).
+ * @param is_class Non-zero if v holds classes.
+ *
+ * @return An allocated map, or NULL upon error.  Caller must call
+ * apol_query_value_map_destroy() afterwards.
+ */
+	apol_query_value_map_t *apol_query_value_map_create(const apol_policy_t * p, const apol_vector_t * v, int is_class);
+
+/**
+ * Deallocate a value map, then set the reference to NULL.
+ */
+	void apol_query_value_map_destroy(apol_query_value_map_t ** m);
+
+/**
+ * Return non-zero if a type or class value is within a value map.
+ */
+	int apol_query_value_map_has(const apol_query_value_map_t * m, uint32_t value);
+
+/** Candidate type lists shared by many queries run against the same
+ *  policy, so that each distinct symbol is expanded only once. */
+	typedef struct apol_query_type_cache apol_query_type_cache_t;
+
+	apol_query_type_cache_t *apol_query_type_cache_create(void);
+	void apol_query_type_cache_destroy(apol_query_type_cache_t ** c);
+
+/**
+ * Return the candidate types for a symbol as a value map, building
+ * it with apol_query_create_candidate_type_list() the first time
+ * this combination of arguments is seen.
+ *
+ * @return Map of candidate types, owned by the cache, or NULL upon
+ * error.
+ */
+	const apol_query_value_map_t *apol_query_type_cache_get(const apol_policy_t * p, apol_query_type_cache_t * c,
+								const char *symbol, int do_regex, int do_indirect,
+								unsigned int ta_flag);
+
 /**
  * Given a type, return a vector of qpol_type_t pointers to which the
  * type expands.  If the type is just a type or an alias, the vector
@@ -499,6 +561,20 @@ extern "C"
  */
 	int apol_obj_perm_compare_class(const void *a, const void *b, void *policy);
 
+/**
+ * Number a class's permissions: those of its common, if any, then
+ * its own, each in the order that qpol iterates them.  Analyses that
+ * need a bit per permission share this numbering.
+ *
+ * @param p Policy containing the class.
+ * @param obj_class Class whose permissions to number.
+ *
+ * @return Vector of permission names (char *), indexed by number, or
+ * NULL on error.  The caller must call apol_vector_destroy() upon it,
+ * but not free the names.
+ */
+	apol_vector_t *class_perm_get_numbered(const apol_policy_t * p, const qpol_class_t * obj_class);
+
 /**
  *  Determine if a syntactic type set directly uses any of the types in v.
  *  @param p Policy from which the type set and types come.
@@ -523,6 +599,76 @@ extern "C"
  */
 	void domain_trans_table_destroy(apol_domain_trans_table_t ** table);
 
+/**
+ * Deallocate all space associated with a policy's membership tables,
+ * including the pointer itself.  Afterwards set the pointer to NULL.
+ *
+ * @param m Reference to an apol_membership_t to destroy.
+ */
+	void membership_destroy(apol_membership_t ** m);
+
+/**
+ * Append to a vector the types of an attribute, in order of value,
+ * from the qpol policy's summary.
+ *
+ * @param p Policy containing the attribute.
+ * @param attr Attribute whose types to append.
+ * @param v Vector to which append qpol_type_t pointers.
+ *
+ * @return 0 on success, < 0 on error (including if attr is not an
+ * attribute).
+ */
+	int apol_membership_append_types(const apol_policy_t * p, const qpol_type_t * attr, apol_vector_t * v);
+
+/**
+ * Append to a vector the attributes of a type, in order of value,
+ * from the qpol policy's summary.
+ *
+ * @param p Policy containing the type.
+ * @param type Type whose attributes to append.
+ * @param v Vector to which append qpol_type_t pointers.
+ *
+ * @return 0 on success, < 0 on error (including if type is an
+ * attribute).
+ */
+	int apol_membership_append_attribs(const apol_policy_t * p, const qpol_type_t * type, apol_vector_t * v);
+
+/**
+ * Append to a vector the types that a role may hold, in order of
+ * value, from the qpol policy's summary.
+ *
+ * @param p Policy containing the role.
+ * @param role Role whose types to append.
+ * @param v Vector to which append qpol_type_t pointers.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	int apol_membership_append_role_types(const apol_policy_t * p, const qpol_role_t * role, apol_vector_t * v);
+
+/**
+ * Determine if a role may hold a type, from the qpol policy's
+ * summary.
+ *
+ * @param p Policy containing the role and type.
+ * @param role Role to check.
+ * @param type Type to find.
+ *
+ * @return 1 if the role may hold the type, 0 if not, < 0 on error.
+ */
+	int apol_membership_role_has_type(const apol_policy_t * p, const qpol_role_t * role, const qpol_type_t * type);
+
+/**
+ * Determine if a user may hold a role, from the policy's membership
+ * tables.
+ *
+ * @param p Policy containing the user and role.
+ * @param user User to check.
+ * @param role Role to find.
+ *
+ * @return 1 if the user may hold the role, 0 if not, < 0 on error.
+ */
+	int apol_membership_user_has_role(const apol_policy_t * p, const qpol_user_t * user, const qpol_role_t * role);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -456,23 +456,11 @@ apol_vector_t *apol_query_create_candidate_type_list(const apol_policy_t * p, co
 			if (isalias) {
 				continue;
 			}
-			if ((isattr &&
-			     qpol_type_get_type_iter(p->p, type, &iter) < 0) ||
-			    (!isattr && qpol_type_get_attr_iter(p->p, type, &iter) < 0)) {
+			if ((isattr && apol_membership_append_types(p, type, list) < 0) ||
+			    (!isattr && apol_membership_append_attribs(p, type, list) < 0)) {
 				error = errno;
 				goto cleanup;
 			}
-			for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-				if (qpol_iterator_get_item(iter, (void **)&type) < 0) {
-					error = errno;
-					goto cleanup;
-				}
-				if (apol_query_append_type(p, list, type)) {
-					error = errno;
-					goto cleanup;
-				}
-			}
-			qpol_iterator_destroy(&iter);
 		}
 	}
 
@@ -603,22 +591,11 @@ apol_vector_t *apol_query_create_candidate_syn_type_list(const apol_policy_t * p
 		}
 		if (!do_indirect && !isattr)
 			continue;
-		if ((isattr && qpol_type_get_type_iter(p->p, type, &iter) < 0) ||
-		    (!isattr && qpol_type_get_attr_iter(p->p, type, &iter) < 0)) {
+		if ((isattr && apol_membership_append_types(p, type, list) < 0) ||
+		    (!isattr && apol_membership_append_attribs(p, type, list) < 0)) {
 			error = errno;
 			goto cleanup;
 		}
-		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-			if (qpol_iterator_get_item(iter, (void **)&type) < 0) {
-				error = errno;
-				goto cleanup;
-			}
-			if (apol_query_append_type(p, list, type)) {
-				error = errno;
-				goto cleanup;
-			}
-		}
-		qpol_iterator_destroy(&iter);
 	}
 
 	apol_vector_sort_uniquify(list, NULL, NULL);
@@ -725,12 +702,154 @@ apol_vector_t *apol_query_create_candidate_class_list(const apol_policy_t * p, a
 	return list;
 }
 
+apol_query_value_map_t *apol_query_value_map_create(const apol_policy_t * p, const apol_vector_t * v, int is_class)
+{
+	apol_query_value_map_t *m = NULL;
+	uint32_t *values = NULL, max = 0;
+	size_t i, n = apol_vector_get_size(v);
+	int error = 0;
+
+	if ((m = calloc(1, sizeof(*m))) == NULL || (n > 0 && (values = malloc(n * sizeof(*values))) == NULL)) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		goto err;
+	}
+	for (i = 0; i < n; i++) {
+		void *elem = apol_vector_get_element(v, i);
+		if ((is_class ? qpol_class_get_value(p->p, elem, values + i) : qpol_type_get_value(p->p, elem, values + i)) < 0) {
+			error = errno;
+			goto err;
+		}
+		if (values[i] > max) {
+			max = values[i];
+		}
+	}
+	m->size = (size_t) max + 1;
+	if ((m->map = calloc(m->size, 1)) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		goto err;
+	}
+	for (i = 0; i < n; i++) {
+		m->map[values[i]] = 1;
+	}
+	free(values);
+	return m;
+      err:
+	free(values);
+	apol_query_value_map_destroy(&m);
+	errno = error;
+	return NULL;
+}
+
+void apol_query_value_map_destroy(apol_query_value_map_t ** m)
+{
+	if (m != NULL && *m != NULL) {
+		free((*m)->map);
+		free(*m);
+		*m = NULL;
+	}
+}
+
+int apol_query_value_map_has(const apol_query_value_map_t * m, uint32_t value)
+{
+	return value < m->size && m->map[value];
+}
+
+typedef struct type_cache_entry
+{
+	char *symbol;
+	int do_regex, do_indirect;
+	unsigned int ta_flag;
+	apol_query_value_map_t *map;
+} type_cache_entry_t;
+
+struct apol_query_type_cache
+{
+	/** vector of type_cache_entry_t */
+	apol_vector_t *entries;
+};
+
+static void type_cache_entry_free(void *elem)
+{
+	type_cache_entry_t *e = elem;
+	if (e != NULL) {
+		free(e->symbol);
+		apol_query_value_map_destroy(&e->map);
+		free(e);
+	}
+}
+
+apol_query_type_cache_t *apol_query_type_cache_create(void)
+{
+	apol_query_type_cache_t *c = calloc(1, sizeof(*c));
+	if (c == NULL || (c->entries = apol_vector_create(type_cache_entry_free)) == NULL) {
+		free(c);
+		return NULL;
+	}
+	return c;
+}
+
+void apol_query_type_cache_destroy(apol_query_type_cache_t ** c)
+{
+	if (c != NULL && *c != NULL) {
+		apol_vector_destroy(&(*c)->entries);
+		free(*c);
+		*c = NULL;
+	}
+}
+
+const apol_query_value_map_t *apol_query_type_cache_get(const apol_policy_t * p, apol_query_type_cache_t * c, const char *symbol,
+							int do_regex, int do_indirect, unsigned int ta_flag)
+{
+	type_cache_entry_t *e = NULL;
+	apol_vector_t *list = NULL;
+	size_t i;
+	int error = 0;
+
+	do_regex = !!do_regex;
+	do_indirect = !!do_indirect;
+	for (i = 0; i < apol_vector_get_size(c->entries); i++) {
+		e = apol_vector_get_element(c->entries, i);
+		if (e->do_regex == do_regex && e->do_indirect == do_indirect && e->ta_flag == ta_flag &&
+		    strcmp(e->symbol, symbol) == 0) {
+			return e->map;
+		}
+	}
+	if ((list = apol_query_create_candidate_type_list(p, symbol, do_regex, do_indirect, ta_flag)) == NULL) {
+		return NULL;
+	}
+	if ((e = calloc(1, sizeof(*e))) == NULL || (e->symbol = strdup(symbol)) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		goto err;
+	}
+	e->do_regex = do_regex;
+	e->do_indirect = do_indirect;
+	e->ta_flag = ta_flag;
+	if ((e->map = apol_query_value_map_create(p, list, 0)) == NULL) {
+		error = errno;
+		goto err;
+	}
+	if (apol_vector_append(c->entries, e) < 0) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		goto err;
+	}
+	apol_vector_destroy(&list);
+	return e->map;
+      err:
+	apol_vector_destroy(&list);
+	type_cache_entry_free(e);
+	errno = error;
+	return NULL;
+}
+
 apol_vector_t *apol_query_expand_type(const apol_policy_t * p, const qpol_type_t * t)
 {
 	apol_vector_t *v = NULL;
 	int retval = -1;
 	unsigned char isattr;
-	qpol_iterator_t *iter = NULL;
 
 	if ((v = apol_vector_create(NULL)) == NULL) {
 		ERR(p, "%s", strerror(errno));
@@ -744,24 +863,11 @@ apol_vector_t *apol_query_expand_type(const apol_policy_t * p, const qpol_type_t
 			ERR(p, "%s", strerror(ENOMEM));
 			goto cleanup;
 		}
-	} else {
-		if (qpol_type_get_type_iter(p->p, t, &iter) < 0) {
-			goto cleanup;
-		}
-		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-			qpol_type_t *type;
-			if (qpol_iterator_get_item(iter, (void **)&type) < 0) {
-				goto cleanup;
-			}
-			if (apol_vector_append(v, type) < 0) {
-				ERR(p, "%s", strerror(ENOMEM));
-				goto cleanup;
-			}
-		}
+	} else if (apol_membership_append_types(p, t, v) < 0) {
+		goto cleanup;
 	}
 	retval = 0;
       cleanup:
-	qpol_iterator_destroy(&iter);
 	if (retval != 0) {
 		apol_vector_destroy(&v);
 		return NULL;
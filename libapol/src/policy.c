@@ -87,6 +87,7 @@ apol_policy_t *apol_policy_create_from_policy_path(const apol_policy_path_t * pa
 		ERR(NULL, "%s", strerror(ENOMEM));
 		return NULL;	       /* errno set by calloc */
 	}
+	pthread_mutex_init(&policy->membership_lock, NULL);
 	if (msg_callback != NULL) {
 		policy->msg_callback = msg_callback;
 	} else {
@@ -109,23 +110,50 @@ apol_policy_t *apol_policy_create_from_policy_path(const apol_policy_path_t * pa
 			return policy;
 		}
 		const apol_vector_t *modules = apol_policy_path_get_modules(path);
-		size_t i;
-		for (i = 0; i < apol_vector_get_size(modules); i++) {
-			const char *module_path = apol_vector_get_element(modules, i);
-			qpol_module_t *mod = NULL;
-			INFO(policy, "Loading module %s.", module_path);
-			if (qpol_module_create_from_file(module_path, &mod)) {
-				ERR(policy, "Error loading module %s.", module_path);
-				apol_policy_destroy(&policy);
-				return NULL;
-			}
-			if (qpol_policy_append_module(policy->p, mod)) {
-				ERR(policy, "Error loading module %s.", module_path);
+		size_t i, num_modules = apol_vector_get_size(modules), failed = 0;
+		const char **module_paths = NULL;
+		qpol_module_t **mods = NULL;
+		int error;
+		if (num_modules > 0 &&
+		    ((module_paths = calloc(num_modules, sizeof(*module_paths))) == NULL ||
+		     (mods = calloc(num_modules, sizeof(*mods))) == NULL)) {
+			error = errno;
+			ERR(policy, "%s", strerror(error));
+			free(module_paths);
+			apol_policy_destroy(&policy);
+			errno = error;
+			return NULL;
+		}
+		for (i = 0; i < num_modules; i++) {
+			module_paths[i] = apol_vector_get_element(modules, i);
+		}
+		/* the packages are independent, so read them all at once */
+		INFO(policy, "Loading %zu modules.", num_modules);
+		if (qpol_module_create_from_files(policy->p, module_paths, num_modules, mods, 0, &failed)) {
+			error = errno;
+			ERR(policy, "Error loading module %s.", module_paths[failed]);
+			free(module_paths);
+			free(mods);
+			apol_policy_destroy(&policy);
+			errno = error;
+			return NULL;
+		}
+		for (i = 0; i < num_modules; i++) {
+			if (qpol_policy_append_module(policy->p, mods[i])) {
+				error = errno;
+				ERR(policy, "Error loading module %s.", module_paths[i]);
+				for (; i < num_modules; i++) {
+					qpol_module_destroy(&mods[i]);
+				}
+				free(module_paths);
+				free(mods);
 				apol_policy_destroy(&policy);
-				qpol_module_destroy(&mod);
+				errno = error;
 				return NULL;
 			}
 		}
+		free(module_paths);
+		free(mods);
 		INFO(policy, "%s", "Linking modules into base policy.");
 		if (qpol_policy_rebuild(policy->p, options)) {
 			apol_policy_destroy(&policy);
@@ -141,6 +169,8 @@ void apol_policy_destroy(apol_policy_t ** policy)
 		qpol_policy_destroy(&((*policy)->p));
 		permmap_destroy(&(*policy)->pmap);
 		domain_trans_table_destroy(&(*policy)->domain_trans_table);
+		membership_destroy(&(*policy)->membership);
+		pthread_mutex_destroy(&(*policy)->membership_lock);
 		free(*policy);
 		*policy = NULL;
 	}
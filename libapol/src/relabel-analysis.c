@@ -25,6 +25,8 @@
 #include "policy-query-internal.h"
 
 #include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* defines for mode */
@@ -57,11 +59,92 @@ struct apol_relabel_result_pair
 	const qpol_type_t *intermed;
 };
 
+/**
+ * Domains in all-domains mode, each with its own list of
+ * apol_relabel_result_t nodes.
+ */
+struct apol_relabel_domain
+{
+	const qpol_type_t *domain;
+	apol_vector_t *results;
+};
+
 #define PERM_RELABELTO "relabelto"
 #define PERM_RELABELFROM "relabelfrom"
 
+/**
+ * Tables shared by one run of an analysis, each indexed by type
+ * value.
+ */
+typedef struct relabel_index
+{
+	/** one more than the largest type value */
+	size_t num_values;
+	/** the result node of each type, or NULL if there is none yet */
+	apol_relabel_result_t **nodes;
+	/** 0 if the type has not yet been compared against the result
+	 *  regex, else 1 if it matches and 2 if not */
+	unsigned char *regex_match;
+} relabel_index_t;
+
 /******************** actual analysis rountines ********************/
 
+static int relabel_index_init(const apol_policy_t * p, relabel_index_t * idx)
+{
+	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *type;
+	uint32_t value;
+	int retval = -1;
+
+	memset(idx, 0, sizeof(*idx));
+	if (qpol_policy_get_type_iter(p->p, &iter) < 0) {
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&type) < 0 || qpol_type_get_value(p->p, type, &value) < 0) {
+			goto cleanup;
+		}
+		if (value >= idx->num_values) {
+			idx->num_values = (size_t) value + 1;
+		}
+	}
+	if ((idx->nodes = calloc(idx->num_values, sizeof(*idx->nodes))) == NULL ||
+	    (idx->regex_match = calloc(idx->num_values, sizeof(*idx->regex_match))) == NULL) {
+		ERR(p, "%s", strerror(errno));
+		goto cleanup;
+	}
+	retval = 0;
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	return retval;
+}
+
+static void relabel_index_fini(relabel_index_t * idx)
+{
+	free(idx->nodes);
+	free(idx->regex_match);
+	memset(idx, 0, sizeof(*idx));
+}
+
+/**
+ * Get the value of a type, checking that it fits within the index.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int relabel_index_get_value(const apol_policy_t * p, const relabel_index_t * idx, const qpol_type_t * type,
+				   uint32_t * value)
+{
+	if (qpol_type_get_value(p->p, type, value) < 0) {
+		return -1;
+	}
+	if (*value >= idx->num_values) {
+		ERR(p, "%s", strerror(ERANGE));
+		errno = ERANGE;
+		return -1;
+	}
+	return 0;
+}
+
 /**
  * Given an avrule, determine which relabel direction it has (to,
  * from, or both).
@@ -105,24 +188,6 @@ static int relabel_analysis_get_direction(const apol_policy_t * p, const qpol_av
 	return retval;
 }
 
-/**
- * Given an apol_relabel_result_t node and a qpol_type_t, determine if
- * the two match.
- *
- * @param a Pointer to a apol_relabel_result_t.
- * @param b Pointer to a type.
- * @param data (Unused).
- *
- * @return 0 if the result node's type matches the given type,
- * non-zero if not.
- */
-static int relabel_result_comp_func(const void *a, const void *b, void *data __attribute__ ((unused)))
-{
-	apol_relabel_result_t *r = (apol_relabel_result_t *) a;
-	qpol_type_t *t = (qpol_type_t *) b;
-	return (int)((char *)r->type - (char *)t);
-}
-
 static void relabel_result_free(void *result)
 {
 	if (result != NULL) {
@@ -134,26 +199,41 @@ static void relabel_result_free(void *result)
 	}
 }
 
+static void relabel_domain_free(void *domain)
+{
+	if (domain != NULL) {
+		apol_relabel_domain_t *d = (apol_relabel_domain_t *) domain;
+		apol_vector_destroy(&d->results);
+		free(domain);
+	}
+}
+
 /**
- * Given a qpol_type_t pointer, find and return the first
- * apol_relabel_result_t node within vector v that matches the type.
- * If there does not exist a node with that type, then allocate a new
- * one, append it to the vector, and return it.  The caller is
- * expected to eventually call apol_vector_destroy() upon the vector.
+ * Given a qpol_type_t pointer, find and return the
+ * apol_relabel_result_t node within vector v for that type.  If
+ * there does not exist a node with that type, then allocate a new
+ * one, append it to the vector, and record it within the index.  The
+ * caller is expected to eventually call apol_vector_destroy() upon
+ * the vector.
  *
  * @param p Policy, used for error handling.
+ * @param idx Index of the nodes already within results.
  * @param results A vector of apol_relabel_result_t nodes.
  * @param type Target type to find.
  *
  * @return An apol_relabel_result_t node from which to append results,
  * or NULL upon error.
  */
-static apol_relabel_result_t *relabel_result_get_node(const apol_policy_t * p, apol_vector_t * results, const qpol_type_t * type)
+static apol_relabel_result_t *relabel_result_get_node(const apol_policy_t * p, relabel_index_t * idx, apol_vector_t * results,
+						      const qpol_type_t * type)
 {
 	apol_relabel_result_t *result;
-	size_t i;
-	if (apol_vector_get_index(results, type, relabel_result_comp_func, NULL, &i) == 0) {
-		return (apol_relabel_result_t *) apol_vector_get_element(results, i);
+	uint32_t value;
+	if (relabel_index_get_value(p, idx, type, &value) < 0) {
+		return NULL;
+	}
+	if (idx->nodes[value] != NULL) {
+		return idx->nodes[value];
 	}
 	/* make a new result node */
 	if ((result = calloc(1, sizeof(*result))) == NULL ||
@@ -165,99 +245,108 @@ static apol_relabel_result_t *relabel_result_get_node(const apol_policy_t * p, a
 		return NULL;
 	}
 	result->type = type;
+	idx->nodes[value] = result;
 	return result;
 }
 
 /**
- * Given a vector of strings representing type names, allocate and
- * return a vector of qpol_type_t pointers into the given policy for
- * those types.  If a type name is really an alias, obtain and store
- * its primary instead.
+ * Forget the index's record of each node within a results vector,
+ * so that the index may be used to build another vector.
+ */
+static void relabel_index_clear_nodes(const apol_policy_t * p, relabel_index_t * idx, const apol_vector_t * results)
+{
+	const apol_relabel_result_t *result;
+	uint32_t value;
+	size_t i;
+	for (i = 0; i < apol_vector_get_size(results); i++) {
+		result = apol_vector_get_element(results, i);
+		if (relabel_index_get_value(p, idx, result->type, &value) == 0) {
+			idx->nodes[value] = NULL;
+		}
+	}
+}
+
+/**
+ * Determine if a result type matches the analysis's result regex,
+ * remembering the answer within the index.
+ *
+ * @return 1 if the type matches, 0 if not, < 0 on error.
+ */
+static int relabel_analysis_match_result(const apol_policy_t * p, apol_relabel_analysis_t * r, relabel_index_t * idx,
+					 const qpol_type_t * type)
+{
+	uint32_t value;
+	int compval;
+	if (relabel_index_get_value(p, idx, type, &value) < 0) {
+		return -1;
+	}
+	if (idx->regex_match[value] == 0) {
+		compval = apol_compare_type(p, type, r->result, APOL_QUERY_REGEX, &r->result_regex);
+		if (compval < 0) {
+			return -1;
+		}
+		idx->regex_match[value] = (compval ? 1 : 2);
+	}
+	return idx->regex_match[value] == 1;
+}
+
+/**
+ * Given the analysis's subject names, allocate and return a map of
+ * the subjects' type values.  If a type name is really an alias, its
+ * primary is used instead.
  *
  * @param p Policy to which look up types
+ * @param idx Index whose number of type values to use.
  * @param v Vector of strings.
+ * @param expand If non-zero, also set the values of the types of
+ * each subject that is an attribute.
  *
- * @return A newly allocated apol_vector_t, which the caller must free
- * with apol_vector_destroy().  If a type name was not found or upon
- * other error return NULL.
+ * @return An array of idx->num_values entries, which the caller must
+ * free().  If a type name was not found or upon other error return
+ * NULL.
  */
-static apol_vector_t *relabel_analysis_get_type_vector(const apol_policy_t * p, const apol_vector_t * v)
+static unsigned char *relabel_analysis_get_subjects(const apol_policy_t * p, const relabel_index_t * idx, const apol_vector_t * v,
+						    int expand)
 {
+	unsigned char *subjects = NULL;
 	apol_vector_t *types = NULL;
-	size_t i;
+	const qpol_type_t *type;
+	uint32_t value;
+	size_t i, j;
 	int retval = -1;
 
-	if ((types = apol_vector_create_with_capacity(apol_vector_get_size(v), NULL)) == NULL) {
+	if ((subjects = calloc(idx->num_values, sizeof(*subjects))) == NULL) {
 		ERR(p, "%s", strerror(errno));
 		goto cleanup;
 	}
 	for (i = 0; i < apol_vector_get_size(v); i++) {
 		char *s = (char *)apol_vector_get_element(v, i);
-		const qpol_type_t *type;
-		if (apol_query_get_type(p, s, &type) < 0) {
+		if (apol_query_get_type(p, s, &type) < 0 || relabel_index_get_value(p, idx, type, &value) < 0) {
 			goto cleanup;
 		}
-		if (apol_vector_append(types, (void *)type)) {
-			ERR(p, "%s", strerror(errno));
+		subjects[value] = 1;
+		if (!expand) {
+			continue;
+		}
+		if ((types = apol_query_expand_type(p, type)) == NULL) {
 			goto cleanup;
 		}
+		for (j = 0; j < apol_vector_get_size(types); j++) {
+			if (relabel_index_get_value(p, idx, apol_vector_get_element(types, j), &value) < 0) {
+				goto cleanup;
+			}
+			subjects[value] = 1;
+		}
+		apol_vector_destroy(&types);
 	}
-
 	retval = 0;
       cleanup:
+	apol_vector_destroy(&types);
 	if (retval == -1) {
-		apol_vector_destroy(&types);
+		free(subjects);
 		return NULL;
 	}
-	return types;
-}
-
-/**
- * Given a type, see if it is an element within a vector of
- * qpol_type_t pointers.  If the type is really an attribute, also
- * check if any of the attribute's types are a member of v.  If v is
- * NULL then the comparison always succeeds.
- *
- * @param p Policy to which look up types.
- * @param v Target vector of qpol_type_t pointers.
- * @param type Source type to find.
- *
- * @return 1 if type is a member of v, 0 if not, < 0 on error.
- */
-static int relabel_analysis_compare_type_to_vector(const apol_policy_t * p, const apol_vector_t * v, const qpol_type_t * type)
-{
-	size_t i;
-	unsigned char isattr;
-	qpol_iterator_t *iter = NULL;
-	int retval = -1;
-	if (v == NULL || apol_vector_get_index(v, type, NULL, NULL, &i) == 0) {
-		retval = 1;	       /* found it */
-		goto cleanup;
-	}
-	if (qpol_type_get_isattr(p->p, type, &isattr) < 0) {
-		goto cleanup;
-	}
-	if (!isattr) {		       /* not an attribute, so comparison failed */
-		retval = 0;
-		goto cleanup;
-	}
-	if (qpol_type_get_type_iter(p->p, type, &iter) < 0) {
-		goto cleanup;
-	}
-	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-		qpol_type_t *t;
-		if (qpol_iterator_get_item(iter, (void **)&t) < 0) {
-			goto cleanup;
-		}
-		if (apol_vector_get_index(v, t, NULL, NULL, &i) == 0) {
-			retval = 1;
-			goto cleanup;
-		}
-	}
-	retval = 0;		       /* no matches */
-      cleanup:
-	qpol_iterator_destroy(&iter);
-	return retval;
+	return subjects;
 }
 
 /**
@@ -268,26 +357,29 @@ static int relabel_analysis_compare_type_to_vector(const apol_policy_t * p, cons
  *
  * @param p Policy containing avrule.
  * @param r Relabel analysis query object, containing filtering options.
+ * @param idx Index of the result nodes.
+ * @param start_type Type at which the analysis began.
  * @param ruleA First AV rule to add.
+ * @param dirA Relabel direction of ruleA.
  * @param ruleB Other AV rule to add.
+ * @param dirB Relabel direction of ruleB.
+ * @param target_v Types of ruleB's target.
  * @param result Results vector being built.
  *
  * @return 0 on success, < 0 on error.
  */
 static int append_avrules_to_object_vector(const apol_policy_t * p,
-					   apol_relabel_analysis_t * r,
-					   const qpol_avrule_t * ruleA, const qpol_avrule_t * ruleB, apol_vector_t * results)
+					   apol_relabel_analysis_t * r, relabel_index_t * idx, const qpol_type_t * start_type,
+					   const qpol_avrule_t * ruleA, int dirA, const qpol_avrule_t * ruleB, int dirB,
+					   const apol_vector_t * target_v, apol_vector_t * results)
 {
 	const qpol_type_t *sourceA, *sourceB, *target, *intermed;
 	unsigned char isattrA, isattrB;
-	apol_vector_t *target_v = NULL, *result_list;
+	apol_vector_t *result_list;
 	size_t i;
 	apol_relabel_result_t *result;
 	apol_relabel_result_pair_t *pair = NULL;
-	int retval = -1, compval, dirA, dirB;
-	if (qpol_avrule_get_target_type(p->p, ruleB, &target) < 0 || (target_v = apol_query_expand_type(p, target)) == NULL) {
-		goto cleanup;
-	}
+	int retval = -1, compval;
 	if (qpol_avrule_get_source_type(p->p, ruleA, &sourceA) < 0 ||
 	    qpol_avrule_get_source_type(p->p, ruleB, &sourceB) < 0 ||
 	    qpol_type_get_isattr(p->p, sourceA, &isattrA) < 0 || qpol_type_get_isattr(p->p, sourceB, &isattrB) < 0) {
@@ -304,22 +396,16 @@ static int append_avrules_to_object_vector(const apol_policy_t * p,
 	for (i = 0; i < apol_vector_get_size(target_v); i++) {
 		target = (qpol_type_t *) apol_vector_get_element(target_v, i);
 		/* exclude if B(t) does not match search criteria */
-		compval = apol_compare_type(p, target, r->type, 0, NULL);
-		if (compval < 0) {
-			goto cleanup;
-		} else if (compval == 1) {
+		if (target == start_type) {
 			continue;      /* don't care about relabels to itself */
 		}
-		compval = apol_compare_type(p, target, r->result, APOL_QUERY_REGEX, &r->result_regex);
+		compval = relabel_analysis_match_result(p, r, idx, target);
 		if (compval < 0) {
 			goto cleanup;
 		} else if (compval == 0) {
 			continue;
 		}
-		if ((result = relabel_result_get_node(p, results, target)) == NULL) {
-			goto cleanup;
-		}
-		if ((dirA = relabel_analysis_get_direction(p, ruleA)) < 0 || (dirB = relabel_analysis_get_direction(p, ruleB)) < 0) {
+		if ((result = relabel_result_get_node(p, idx, results, target)) == NULL) {
 			goto cleanup;
 		}
 		if ((pair = calloc(1, sizeof(*pair))) == NULL) {
@@ -349,78 +435,177 @@ static int append_avrules_to_object_vector(const apol_policy_t * p,
 	retval = 0;
       cleanup:
 	free(pair);
-	apol_vector_destroy(&target_v);
 	return retval;
 }
 
+static int relabel_analysis_index_compare(const void *a, const void *b)
+{
+	size_t x = *(const size_t *)a, y = *(const size_t *)b;
+	return (x < y ? -1 : x > y ? 1 : 0);
+}
+
 /**
  * Search through sets av and bv, finding pairs of avrules that
- * satisfy a relabel and adding those pairs to result vector v.
+ * satisfy a relabel and adding those pairs to result vector v.  The
+ * rules of bv are first indexed by the value of each type their
+ * source covers, so that the rules sharing a source type with a rule
+ * of av are found without scanning all of bv.
  *
  * @param p Policy containing avrules.
  * @param r Relabel analysis query object.
- * @param v Vector of apol_relabel_result_t nodes.
+ * @param idx Index of the result nodes.
  * @param av Vector of qpol_avrule_t pointers.
  * @param bv Vector of qpol_avrule_t pointers.
- * @param subjects_v Vector of permitted qpol_type_t subjects, or NULL
- * to allow all types.
+ * @param subjects Map of permitted subjects' type values, or NULL to
+ * allow all types.
+ * @param v Vector of apol_relabel_result_t nodes.
  *
  * @return 0 on success, < 0 upon error.
  */
 static int relabel_analysis_matchup(const apol_policy_t * p,
-				    apol_relabel_analysis_t * r,
-				    apol_vector_t * av, apol_vector_t * bv, const apol_vector_t * subjects_v, apol_vector_t * v)
+				    apol_relabel_analysis_t * r, relabel_index_t * idx,
+				    const apol_vector_t * av, const apol_vector_t * bv, const unsigned char *subjects,
+				    apol_vector_t * v)
 {
-	const qpol_avrule_t *a_avrule, *b_avrule;
-	const qpol_type_t *a_source, *a_target, *b_source, *b_target, *start_type;
-	const qpol_class_t *a_class, *b_class;
-	apol_vector_t *start_v = NULL;
-	size_t i, j;
-	int compval, retval = -1;
+	const qpol_avrule_t *a_avrule;
+	const qpol_type_t *a_source, *start_type, *type;
+	const qpol_class_t *a_class;
+	const qpol_class_t **b_classes = NULL;
+	const qpol_type_t **b_targets = NULL;
+	apol_vector_t *start_v = NULL, **b_source_v = NULL, **b_target_v = NULL;
+	int *b_dirs = NULL, a_dir, permitted;
+	size_t *b_first = NULL, *b_stamp = NULL, *cands = NULL, *b_index = NULL;
+	size_t num_b = apol_vector_get_size(bv), num_entries = 0, num_cands, i, j, k;
+	uint32_t value;
+	int retval = -1;
 
 	if (apol_query_get_type(p, r->type, &start_type) < 0) {
 		goto cleanup;
 	}
+	if ((b_first = calloc(idx->num_values + 1, sizeof(*b_first))) == NULL ||
+	    (num_b > 0 &&
+	     ((b_classes = calloc(num_b, sizeof(*b_classes))) == NULL ||
+	      (b_targets = calloc(num_b, sizeof(*b_targets))) == NULL ||
+	      (b_source_v = calloc(num_b, sizeof(*b_source_v))) == NULL ||
+	      (b_target_v = calloc(num_b, sizeof(*b_target_v))) == NULL ||
+	      (b_dirs = calloc(num_b, sizeof(*b_dirs))) == NULL ||
+	      (b_stamp = calloc(num_b, sizeof(*b_stamp))) == NULL || (cands = calloc(num_b, sizeof(*cands))) == NULL))) {
+		ERR(p, "%s", strerror(errno));
+		goto cleanup;
+	}
+
+	/* index each B by the types of its source; count each type's
+	 * rules, then lay them out in order of type value */
+	for (j = 0; j < num_b; j++) {
+		const qpol_avrule_t *b_avrule = apol_vector_get_element(bv, j);
+		const qpol_type_t *b_source;
+		if (qpol_avrule_get_source_type(p->p, b_avrule, &b_source) < 0 ||
+		    qpol_avrule_get_target_type(p->p, b_avrule, &b_targets[j]) < 0 ||
+		    qpol_avrule_get_object_class(p->p, b_avrule, &b_classes[j]) < 0 ||
+		    (b_dirs[j] = relabel_analysis_get_direction(p, b_avrule)) < 0 ||
+		    (b_source_v[j] = apol_query_expand_type(p, b_source)) == NULL) {
+			goto cleanup;
+		}
+		for (k = 0; k < apol_vector_get_size(b_source_v[j]); k++) {
+			if (relabel_index_get_value(p, idx, apol_vector_get_element(b_source_v[j], k), &value) < 0) {
+				goto cleanup;
+			}
+			b_first[value + 1]++;
+			num_entries++;
+		}
+	}
+	if (num_entries > 0 && (b_index = malloc(num_entries * sizeof(*b_index))) == NULL) {
+		ERR(p, "%s", strerror(errno));
+		goto cleanup;
+	}
+	for (k = 1; k <= idx->num_values; k++) {
+		b_first[k] += b_first[k - 1];
+	}
+	/* filling advances b_first[value] to the start of the next
+	 * value's entries, so shift the starts back afterwards */
+	for (j = 0; j < num_b; j++) {
+		for (k = 0; k < apol_vector_get_size(b_source_v[j]); k++) {
+			relabel_index_get_value(p, idx, apol_vector_get_element(b_source_v[j], k), &value);
+			b_index[b_first[value]++] = j;
+		}
+		apol_vector_destroy(&b_source_v[j]);
+	}
+	memmove(b_first + 1, b_first, idx->num_values * sizeof(*b_first));
+	b_first[0] = 0;
+
 	for (i = 0; i < apol_vector_get_size(av); i++) {
 		a_avrule = apol_vector_get_element(av, i);
 		if (qpol_avrule_get_source_type(p->p, a_avrule, &a_source) < 0 ||
-		    qpol_avrule_get_target_type(p->p, a_avrule, &a_target) < 0 ||
-		    qpol_avrule_get_object_class(p->p, a_avrule, &a_class) < 0) {
+		    qpol_avrule_get_object_class(p->p, a_avrule, &a_class) < 0 || (start_v = apol_query_expand_type(p, a_source)) == NULL) {
 			goto cleanup;
 		}
-		compval = relabel_analysis_compare_type_to_vector(p, subjects_v, a_source);
-		if (compval < 0) {
-			goto cleanup;
-		} else if (compval == 0) {
+		permitted = (subjects == NULL);
+		if (!permitted) {
+			if (relabel_index_get_value(p, idx, a_source, &value) < 0) {
+				goto cleanup;
+			}
+			permitted = subjects[value];
+		}
+
+		/* find each B s.t. B(s) covers a type of A(s), B(t) !=
+		 * r->type and B(o) = A(o); visit them in their original
+		 * order */
+		num_cands = 0;
+		for (j = 0; j < apol_vector_get_size(start_v); j++) {
+			type = apol_vector_get_element(start_v, j);
+			if (relabel_index_get_value(p, idx, type, &value) < 0) {
+				goto cleanup;
+			}
+			permitted = permitted || subjects[value];
+			for (k = b_first[value]; k < b_first[value + 1]; k++) {
+				size_t b = b_index[k];
+				if (b_stamp[b] == i + 1 || b_classes[b] != a_class || b_targets[b] == start_type) {
+					continue;
+				}
+				b_stamp[b] = i + 1;
+				cands[num_cands++] = b;
+			}
+		}
+		apol_vector_destroy(&start_v);
+		if (!permitted || num_cands == 0) {
 			continue;
 		}
-		if ((start_v = apol_query_expand_type(p, a_source)) == NULL) {
+		if ((a_dir = relabel_analysis_get_direction(p, a_avrule)) < 0) {
 			goto cleanup;
 		}
-
-		/* check if there exists a B s.t. B(s) = source and
-		 * B(t) != r->type and B(o) = A(o) */
-		for (j = 0; j < apol_vector_get_size(bv); j++) {
-			b_avrule = apol_vector_get_element(bv, j);
-			if (qpol_avrule_get_source_type(p->p, b_avrule, &b_source) < 0 ||
-			    qpol_avrule_get_target_type(p->p, b_avrule, &b_target) < 0 ||
-			    qpol_avrule_get_object_class(p->p, b_avrule, &b_class) < 0) {
+		qsort(cands, num_cands, sizeof(*cands), relabel_analysis_index_compare);
+		for (j = 0; j < num_cands; j++) {
+			size_t b = cands[j];
+			if (b_target_v[b] == NULL && (b_target_v[b] = apol_query_expand_type(p, b_targets[b])) == NULL) {
 				goto cleanup;
 			}
-			if (relabel_analysis_compare_type_to_vector(p, start_v, b_source) != 1 ||
-			    b_target == start_type || a_class != b_class) {
-				continue;
-			}
-			if (append_avrules_to_object_vector(p, r, a_avrule, b_avrule, v) < 0) {
+			if (append_avrules_to_object_vector(p, r, idx, start_type, a_avrule, a_dir,
+							    apol_vector_get_element(bv, b), b_dirs[b], b_target_v[b], v) < 0) {
 				goto cleanup;
 			}
 		}
-		apol_vector_destroy(&start_v);
 	}
 
 	retval = 0;
       cleanup:
 	apol_vector_destroy(&start_v);
+	for (j = 0; j < num_b; j++) {
+		if (b_source_v != NULL) {
+			apol_vector_destroy(&b_source_v[j]);
+		}
+		if (b_target_v != NULL) {
+			apol_vector_destroy(&b_target_v[j]);
+		}
+	}
+	free(b_classes);
+	free(b_targets);
+	free(b_source_v);
+	free(b_target_v);
+	free(b_dirs);
+	free(b_first);
+	free(b_index);
+	free(b_stamp);
+	free(cands);
 	return retval;
 }
 
@@ -428,19 +613,20 @@ static int relabel_analysis_matchup(const apol_policy_t * p,
  * Get a list of allow rules, whose target type matches r->type and
  * whose permission is <i>opposite</i> of the direction given (e.g.,
  * relabelfrom if given DIR_TO).  Only include rules whose class is a
- * member of r->classes and whose source is a member of subjects_v.
+ * member of r->classes and whose source is a member of subjects.
  *
  * @param p Policy to which look up rules.
  * @param r Structure containing parameters for subject relabel analysis.
+ * @param idx Index of the result nodes.
  * @param v Target vector to which append discovered rules.
  * @param direction Relabelling direction to search.
- * @param subjects_v If not NULL, then a vector of qpol_type_t pointers.
+ * @param subjects If not NULL, then a map of permitted type values.
  *
  * @return 0 on success, < 0 on error.
  */
 static int relabel_analysis_object(const apol_policy_t * p,
-				   apol_relabel_analysis_t * r,
-				   apol_vector_t * v, unsigned int direction, const apol_vector_t * subjects_v)
+				   apol_relabel_analysis_t * r, relabel_index_t * idx,
+				   apol_vector_t * v, unsigned int direction, const unsigned char *subjects)
 {
 	apol_avrule_query_t *a = NULL, *b = NULL;
 	apol_vector_t *a_rules = NULL, *b_rules = NULL;
@@ -489,7 +675,7 @@ static int relabel_analysis_object(const apol_policy_t * p,
 		goto cleanup;
 	}
 
-	if (relabel_analysis_matchup(p, r, a_rules, b_rules, subjects_v, v) < 0) {
+	if (relabel_analysis_matchup(p, r, idx, a_rules, b_rules, subjects, v) < 0) {
 		goto cleanup;
 	}
 	retval = 0;
@@ -509,41 +695,38 @@ static int relabel_analysis_object(const apol_policy_t * p,
  *
  * @param p Policy containing avrule.
  * @param r Relabel analysis query object, containing filtering options.
+ * @param idx Index of the result nodes.
+ * @param subject Subject whose relabels are being found.
  * @param avrule AV rule to add.
+ * @param dir Relabel direction of avrule.
+ * @param target_v Types of avrule's target.
  * @param result Results vector being built.
  *
  * @return 0 on success, < 0 on error.
  */
 static int append_avrule_to_subject_vector(const apol_policy_t * p,
-					   apol_relabel_analysis_t * r, const qpol_avrule_t * avrule, apol_vector_t * results)
+					   apol_relabel_analysis_t * r, relabel_index_t * idx, const qpol_type_t * subject,
+					   const qpol_avrule_t * avrule, int dir, const apol_vector_t * target_v,
+					   apol_vector_t * results)
 {
 	const qpol_type_t *target;
-	apol_vector_t *target_v = NULL, *result_list = NULL;
+	apol_vector_t *result_list = NULL;
 	size_t i;
 	apol_relabel_result_t *result;
 	apol_relabel_result_pair_t *pair = NULL;
-	int retval = -1, dir, compval;
-	if ((dir = relabel_analysis_get_direction(p, avrule)) < 0) {
-		goto cleanup;
-	}
-	if (qpol_avrule_get_target_type(p->p, avrule, &target) < 0 || (target_v = apol_query_expand_type(p, target)) == NULL) {
-		goto cleanup;
-	}
+	int retval = -1, compval;
 	for (i = 0; i < apol_vector_get_size(target_v); i++) {
 		target = (qpol_type_t *) apol_vector_get_element(target_v, i);
-		compval = apol_compare_type(p, target, r->type, 0, NULL);
-		if (compval < 0) {
-			goto cleanup;
-		} else if (compval == 1) {
+		if (target == subject) {
 			continue;      /* don't care about relabels to itself */
 		}
-		compval = apol_compare_type(p, target, r->result, APOL_QUERY_REGEX, &r->result_regex);
+		compval = relabel_analysis_match_result(p, r, idx, target);
 		if (compval < 0) {
 			goto cleanup;
 		} else if (compval == 0) {
 			continue;
 		}
-		if ((result = relabel_result_get_node(p, results, target)) == NULL) {
+		if ((result = relabel_result_get_node(p, idx, results, target)) == NULL) {
 			goto cleanup;
 		}
 		if ((pair = calloc(1, sizeof(*pair))) == NULL) {
@@ -572,28 +755,27 @@ static int append_avrule_to_subject_vector(const apol_policy_t * p,
 	}
 	retval = 0;
       cleanup:
-	apol_vector_destroy(&target_v);
 	free(pair);
 	return retval;
 }
 
 /**
- * Get a list of all allow rules, whose source type matches r->type
- * and whose permission list has either "relabelto" or "relabelfrom".
- * Only include rules whose class is a member of r->classes.  Add
- * instances of those to the result vector.
+ * Get a list of all allow rules with either "relabelto" or
+ * "relabelfrom", whose class is a member of r->classes.  If source is
+ * not NULL then only rules whose source type matches it, directly or
+ * through an attribute, are included.
  *
  * @param p Policy to which look up rules.
  * @param r Structure containing parameters for subject relabel analysis.
- * @param v Target vector to which append discovered rules.
+ * @param source Name of the source type, or NULL for all types.
+ * @param v Reference to the vector of rules found.
  *
  * @return 0 on success, < 0 on error.
  */
-static int relabel_analysis_subject(const apol_policy_t * p, apol_relabel_analysis_t * r, apol_vector_t * v)
+static int relabel_analysis_get_subject_rules(const apol_policy_t * p, apol_relabel_analysis_t * r, const char *source,
+					      apol_vector_t ** v)
 {
 	apol_avrule_query_t *a = NULL;
-	apol_vector_t *avrules_v = NULL;
-	const qpol_avrule_t *avrule;
 	size_t i;
 	int retval = -1;
 
@@ -602,7 +784,7 @@ static int relabel_analysis_subject(const apol_policy_t * p, apol_relabel_analys
 		goto cleanup;
 	}
 	if (apol_avrule_query_set_rules(p, a, QPOL_RULE_ALLOW) < 0 ||
-	    apol_avrule_query_set_source(p, a, r->type, 1) < 0 ||
+	    (source != NULL && apol_avrule_query_set_source(p, a, source, 1) < 0) ||
 	    apol_avrule_query_append_perm(p, a, PERM_RELABELTO) < 0 || apol_avrule_query_append_perm(p, a, PERM_RELABELFROM) < 0) {
 		goto cleanup;
 	}
@@ -611,21 +793,53 @@ static int relabel_analysis_subject(const apol_policy_t * p, apol_relabel_analys
 			goto cleanup;
 		}
 	}
-	if (apol_avrule_get_by_query(p, a, &avrules_v) < 0) {
+	if (apol_avrule_get_by_query(p, a, v) < 0) {
 		goto cleanup;
 	}
+	retval = 0;
+      cleanup:
+	apol_avrule_query_destroy(&a);
+	return retval;
+}
 
+/**
+ * Get a list of all allow rules, whose source type matches r->type
+ * and whose permission list has either "relabelto" or "relabelfrom".
+ * Only include rules whose class is a member of r->classes.  Add
+ * instances of those to the result vector.
+ *
+ * @param p Policy to which look up rules.
+ * @param r Structure containing parameters for subject relabel analysis.
+ * @param idx Index of the result nodes.
+ * @param v Target vector to which append discovered rules.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int relabel_analysis_subject(const apol_policy_t * p, apol_relabel_analysis_t * r, relabel_index_t * idx, apol_vector_t * v)
+{
+	apol_vector_t *avrules_v = NULL, *target_v = NULL;
+	const qpol_avrule_t *avrule;
+	const qpol_type_t *subject, *target;
+	size_t i;
+	int retval = -1, dir;
+
+	if (apol_query_get_type(p, r->type, &subject) < 0 || relabel_analysis_get_subject_rules(p, r, r->type, &avrules_v) < 0) {
+		goto cleanup;
+	}
 	for (i = 0; i < apol_vector_get_size(avrules_v); i++) {
 		avrule = (qpol_avrule_t *) apol_vector_get_element(avrules_v, i);
-		if (append_avrule_to_subject_vector(p, r, avrule, v) < 0) {
+		if ((dir = relabel_analysis_get_direction(p, avrule)) < 0 ||
+		    qpol_avrule_get_target_type(p->p, avrule, &target) < 0 || (target_v = apol_query_expand_type(p, target)) == NULL ||
+		    append_avrule_to_subject_vector(p, r, idx, subject, avrule, dir, target_v, v) < 0) {
 			goto cleanup;
 		}
+		apol_vector_destroy(&target_v);
 	}
 
 	retval = 0;
       cleanup:
-	apol_avrule_query_destroy(&a);
 	apol_vector_destroy(&avrules_v);
+	apol_vector_destroy(&target_v);
 	return retval;
 }
 
@@ -633,10 +847,12 @@ static int relabel_analysis_subject(const apol_policy_t * p, apol_relabel_analys
 
 int apol_relabel_analysis_do(const apol_policy_t * p, apol_relabel_analysis_t * r, apol_vector_t ** v)
 {
-	apol_vector_t *subjects_v = NULL;
+	relabel_index_t idx;
+	unsigned char *subjects = NULL;
 	const qpol_type_t *start_type;
 	int retval = -1;
 	*v = NULL;
+	memset(&idx, 0, sizeof(idx));
 
 	if (r->mode == 0 || r->type == NULL) {
 		ERR(p, "%s", strerror(EINVAL));
@@ -645,6 +861,9 @@ int apol_relabel_analysis_do(const apol_policy_t * p, apol_relabel_analysis_t *
 	if (apol_query_get_type(p, r->type, &start_type) < 0) {
 		goto cleanup;
 	}
+	if (relabel_index_init(p, &idx) < 0) {
+		goto cleanup;
+	}
 
 	if ((*v = apol_vector_create(relabel_result_free)) == NULL) {
 		ERR(p, "%s", strerror(ENOMEM));
@@ -652,25 +871,152 @@ int apol_relabel_analysis_do(const apol_policy_t * p, apol_relabel_analysis_t *
 	}
 
 	if (r->mode == APOL_RELABEL_MODE_OBJ) {
-		if (r->subjects != NULL && (subjects_v = relabel_analysis_get_type_vector(p, r->subjects)) == NULL) {
+		if (r->subjects != NULL && (subjects = relabel_analysis_get_subjects(p, &idx, r->subjects, 0)) == NULL) {
 			goto cleanup;
 		}
-		if ((r->direction & APOL_RELABEL_DIR_TO) && relabel_analysis_object(p, r, *v, APOL_RELABEL_DIR_TO, subjects_v) < 0) {
+		if ((r->direction & APOL_RELABEL_DIR_TO) &&
+		    relabel_analysis_object(p, r, &idx, *v, APOL_RELABEL_DIR_TO, subjects) < 0) {
 			goto cleanup;
 		}
 		if ((r->direction & APOL_RELABEL_DIR_FROM) &&
-		    relabel_analysis_object(p, r, *v, APOL_RELABEL_DIR_FROM, subjects_v) < 0) {
+		    relabel_analysis_object(p, r, &idx, *v, APOL_RELABEL_DIR_FROM, subjects) < 0) {
 			goto cleanup;
 		}
 	} else {
-		if (relabel_analysis_subject(p, r, *v) < 0) {
+		if (relabel_analysis_subject(p, r, &idx, *v) < 0) {
 			goto cleanup;
 		}
 	}
 
 	retval = 0;
       cleanup:
-	apol_vector_destroy(&subjects_v);
+	free(subjects);
+	relabel_index_fini(&idx);
+	if (retval != 0) {
+		apol_vector_destroy(v);
+	}
+	return retval;
+}
+
+int apol_relabel_analysis_do_all_domains(const apol_policy_t * p, apol_relabel_analysis_t * r, apol_vector_t ** v)
+{
+	relabel_index_t idx;
+	unsigned char *subjects = NULL;
+	apol_vector_t *avrules_v = NULL, **source_v = NULL, **target_v = NULL;
+	const qpol_type_t **domains = NULL, *type;
+	const qpol_avrule_t *avrule;
+	apol_relabel_domain_t *d = NULL;
+	size_t *rule_first = NULL, *rule_index = NULL, num_rules = 0, num_entries = 0, i, j;
+	int *dirs = NULL, retval = -1;
+	uint32_t value;
+
+	if (v != NULL) {
+		*v = NULL;
+	}
+	memset(&idx, 0, sizeof(idx));
+	if (p == NULL || r == NULL || v == NULL) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (relabel_index_init(p, &idx) < 0 ||
+	    (r->subjects != NULL && (subjects = relabel_analysis_get_subjects(p, &idx, r->subjects, 1)) == NULL) ||
+	    relabel_analysis_get_subject_rules(p, r, NULL, &avrules_v) < 0) {
+		goto cleanup;
+	}
+	num_rules = apol_vector_get_size(avrules_v);
+	if ((rule_first = calloc(idx.num_values + 1, sizeof(*rule_first))) == NULL ||
+	    (domains = calloc(idx.num_values, sizeof(*domains))) == NULL ||
+	    (num_rules > 0 &&
+	     ((source_v = calloc(num_rules, sizeof(*source_v))) == NULL ||
+	      (target_v = calloc(num_rules, sizeof(*target_v))) == NULL || (dirs = calloc(num_rules, sizeof(*dirs))) == NULL)) ||
+	    (*v = apol_vector_create(relabel_domain_free)) == NULL) {
+		ERR(p, "%s", strerror(errno));
+		goto cleanup;
+	}
+
+	/* one pass over the rules finds every domain each one grants;
+	 * index the rules by domain, keeping their order */
+	for (i = 0; i < num_rules; i++) {
+		avrule = apol_vector_get_element(avrules_v, i);
+		if (qpol_avrule_get_source_type(p->p, avrule, &type) < 0 || (source_v[i] = apol_query_expand_type(p, type)) == NULL ||
+		    qpol_avrule_get_target_type(p->p, avrule, &type) < 0 || (target_v[i] = apol_query_expand_type(p, type)) == NULL ||
+		    (dirs[i] = relabel_analysis_get_direction(p, avrule)) < 0) {
+			goto cleanup;
+		}
+		for (j = 0; j < apol_vector_get_size(source_v[i]); j++) {
+			type = apol_vector_get_element(source_v[i], j);
+			if (relabel_index_get_value(p, &idx, type, &value) < 0) {
+				goto cleanup;
+			}
+			domains[value] = type;
+			rule_first[value + 1]++;
+			num_entries++;
+		}
+	}
+	if (num_entries > 0 && (rule_index = malloc(num_entries * sizeof(*rule_index))) == NULL) {
+		ERR(p, "%s", strerror(errno));
+		goto cleanup;
+	}
+	for (j = 1; j <= idx.num_values; j++) {
+		rule_first[j] += rule_first[j - 1];
+	}
+	for (i = 0; i < num_rules; i++) {
+		for (j = 0; j < apol_vector_get_size(source_v[i]); j++) {
+			relabel_index_get_value(p, &idx, apol_vector_get_element(source_v[i], j), &value);
+			rule_index[rule_first[value]++] = i;
+		}
+	}
+	memmove(rule_first + 1, rule_first, idx.num_values * sizeof(*rule_first));
+	rule_first[0] = 0;
+
+	for (value = 0; value < idx.num_values; value++) {
+		if (rule_first[value] == rule_first[value + 1] || (subjects != NULL && !subjects[value])) {
+			continue;
+		}
+		if ((d = calloc(1, sizeof(*d))) == NULL || (d->results = apol_vector_create(relabel_result_free)) == NULL) {
+			ERR(p, "%s", strerror(errno));
+			goto cleanup;
+		}
+		d->domain = domains[value];
+		for (j = rule_first[value]; j < rule_first[value + 1]; j++) {
+			i = rule_index[j];
+			if (append_avrule_to_subject_vector(p, r, &idx, d->domain, apol_vector_get_element(avrules_v, i), dirs[i],
+							    target_v[i], d->results) < 0) {
+				relabel_index_clear_nodes(p, &idx, d->results);
+				goto cleanup;
+			}
+		}
+		relabel_index_clear_nodes(p, &idx, d->results);
+		if (apol_vector_get_size(d->results) == 0) {
+			relabel_domain_free(d);
+		} else if (apol_vector_append(*v, d) < 0) {
+			ERR(p, "%s", strerror(errno));
+			goto cleanup;
+		}
+		d = NULL;
+	}
+
+	retval = 0;
+      cleanup:
+	relabel_domain_free(d);
+	for (i = 0; i < num_rules; i++) {
+		if (source_v != NULL) {
+			apol_vector_destroy(&source_v[i]);
+		}
+		if (target_v != NULL) {
+			apol_vector_destroy(&target_v[i]);
+		}
+	}
+	free(source_v);
+	free(target_v);
+	free(dirs);
+	free(domains);
+	free(rule_first);
+	free(rule_index);
+	free(subjects);
+	apol_vector_destroy(&avrules_v);
+	relabel_index_fini(&idx);
 	if (retval != 0) {
 		apol_vector_destroy(v);
 	}
@@ -811,3 +1157,13 @@ const qpol_type_t *apol_relabel_result_pair_get_intermediate_type(const apol_rel
 {
 	return p->intermed;
 }
+
+const qpol_type_t *apol_relabel_domain_get_domain(const apol_relabel_domain_t * d)
+{
+	return d->domain;
+}
+
+const apol_vector_t *apol_relabel_domain_get_results(const apol_relabel_domain_t * d)
+{
+	return d->results;
+}
@@ -42,7 +42,9 @@ struct apol_role_query
 
 int apol_role_get_by_query(const apol_policy_t * p, apol_role_query_t * r, apol_vector_t ** v)
 {
-	qpol_iterator_t *iter = NULL, *type_iter = NULL;
+	qpol_iterator_t *iter = NULL;
+	apol_vector_t *types = NULL;
+	size_t i;
 	int retval = -1, append_role;
 	*v = NULL;
 	if (qpol_policy_get_role_iter(p->p, &iter) < 0) {
@@ -73,16 +75,18 @@ int apol_role_get_by_query(const apol_policy_t * p, apol_role_query_t * r, apol_
 			if (r->type_name == NULL || r->type_name[0] == '\0') {
 				goto end_of_query;
 			}
-			if (qpol_role_get_type_iter(p->p, role, &type_iter) < 0) {
+			apol_vector_destroy(&types);
+			if ((types = apol_vector_create(NULL)) == NULL) {
+				ERR(p, "%s", strerror(errno));
+				goto cleanup;
+			}
+			if (apol_membership_append_role_types(p, role, types) < 0) {
 				goto cleanup;
 			}
 			append_role = 0;
-			for (; !qpol_iterator_end(type_iter); qpol_iterator_next(type_iter)) {
-				qpol_type_t *type;
-				if (qpol_iterator_get_item(type_iter, (void **)&type) < 0) {
-					goto cleanup;
-				}
-				compval = apol_compare_type(p, type, r->type_name, r->flags, &(r->type_regex));
+			for (i = 0; i < apol_vector_get_size(types); i++) {
+				compval = apol_compare_type(p, apol_vector_get_element(types, i), r->type_name, r->flags,
+							    &(r->type_regex));
 				if (compval < 0) {
 					goto cleanup;
 				} else if (compval == 1) {
@@ -90,7 +94,6 @@ int apol_role_get_by_query(const apol_policy_t * p, apol_role_query_t * r, apol_
 					break;
 				}
 			}
-			qpol_iterator_destroy(&type_iter);
 		}
 	      end_of_query:
 		if (append_role && apol_vector_append(*v, role)) {
@@ -105,7 +108,7 @@ int apol_role_get_by_query(const apol_policy_t * p, apol_role_query_t * r, apol_
 		apol_vector_destroy(v);
 	}
 	qpol_iterator_destroy(&iter);
-	qpol_iterator_destroy(&type_iter);
+	apol_vector_destroy(&types);
 	return retval;
 }
 
@@ -143,25 +146,5 @@ int apol_role_query_set_regex(const apol_policy_t * p, apol_role_query_t * r, in
 
 int apol_role_has_type(const apol_policy_t * p, const qpol_role_t * r, const qpol_type_t * t)
 {
-	qpol_iterator_t *iter = NULL;
-	qpol_type_t *tmp_type;
-	uint32_t type_value, t_type_value;
-	int retval = -1;
-
-	if (qpol_type_get_value(p->p, t, &t_type_value) < 0 || qpol_role_get_type_iter(p->p, r, &iter) < 0) {
-		goto cleanup;
-	}
-
-	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-		qpol_iterator_get_item(iter, (void **)(&tmp_type));
-		qpol_type_get_value(p->p, tmp_type, &type_value);
-		if (t_type_value == type_value) {
-			retval = 1;
-			goto cleanup;
-		}
-	}
-	retval = 0;
-      cleanup:
-	qpol_iterator_destroy(&iter);
-	return retval;
+	return apol_membership_role_has_type(p, r, t);
 }
@@ -0,0 +1,1166 @@
+/**
+ * @file
+ * Implementation of the domain access similarity engine.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "policy-query-internal.h"
+#include <apol/type-similarity.h>
+#include <qpol/avrule_query.h>
+#include <qpol/util.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** An access is packed into one word: the target type's value in the
+ *  upper half, then the class's value, then the permission's position
+ *  within its class in the lowest TYPE_SIMILARITY_PERM_BITS bits. */
+#define TYPE_SIMILARITY_PERM_BITS 8
+
+/** Each class has at most this many permissions. */
+#define TYPE_SIMILARITY_MAX_PERMS 32
+
+/** Candidate pairs are chosen so that b * t^r is at least this, where
+ *  b is the number of bands, r the rows within each, and t the
+ *  threshold.  A pair exactly at the threshold then becomes a
+ *  candidate with probability of at least 1 - e^-3, or 95%. */
+#define TYPE_SIMILARITY_BAND_MARGIN 3.0
+
+/** An allow rule reduced to values, its permissions as a bitmap of
+ *  positions within its class. */
+typedef struct type_similarity_rule
+{
+	uint32_t source, target, class_value, perms;
+} type_similarity_rule_t;
+
+/** What the engine needs only while it is being built. */
+typedef struct type_similarity_build
+{
+	/** the types (not attributes) that value v stands for are
+	 *  members[member_first[v], member_first[v + 1]) */
+	size_t *member_first;
+	uint32_t *members;
+	/** each class's permission names, common permissions first,
+	 *  indexed by class value */
+	apol_vector_t **class_perms;
+	size_t num_classes;
+	type_similarity_rule_t *rules;
+	size_t num_rules;
+	/** rule i's accesses, sorted, whichever domain it grants them
+	 *  to, are keys[key_first[i], key_first[i + 1]) */
+	uint64_t *keys;
+	size_t *key_first;
+	/** non-zero for each type value within the domain set */
+	unsigned char *is_domain;
+	/** the type of each value, or NULL for an attribute */
+	const qpol_type_t **type_of_value;
+} type_similarity_build_t;
+
+struct apol_type_similarity
+{
+	const apol_policy_t *policy;
+	/** domains, ordered by type value */
+	const qpol_type_t **domains;
+	size_t num_domains;
+	/** largest type value within the policy */
+	size_t num_values;
+	/** for each type value, 1 + the index of its domain, or 0 */
+	size_t *domain_of_value;
+	/** domain i's accesses, sorted and distinct, are
+	 *  accesses[first[i], first[i] + len[i]) */
+	uint64_t *accesses;
+	size_t *first, *len;
+	/** domain i's sketch is sketches[i * num_hashes, (i + 1) * num_hashes) */
+	uint64_t *sketches;
+	size_t num_hashes;
+};
+
+struct apol_type_similarity_pair
+{
+	const qpol_type_t *first, *other;
+	double similarity;
+};
+
+/** Candidate pairs whose exact similarities are being found. */
+typedef struct type_similarity_verify
+{
+	const apol_type_similarity_t *s;
+	/** candidate pairs, each the lesser domain index in the upper
+	 *  half, and their similarities */
+	const uint64_t *candidates;
+	double *similarities;
+} type_similarity_verify_t;
+
+static inline uint64_t type_similarity_mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= UINT64_C(0xbf58476d1ce4e5b9);
+	x ^= x >> 27;
+	x *= UINT64_C(0x94d049bb133111eb);
+	return x ^ (x >> 31);
+}
+
+static int type_similarity_u64_compare(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x < y ? -1 : x > y ? 1 : 0);
+}
+
+static size_t type_similarity_popcount(uint32_t x)
+{
+	size_t n = 0;
+	for (; x != 0; x &= x - 1) {
+		n++;
+	}
+	return n;
+}
+
+static void type_similarity_build_fini(type_similarity_build_t * b)
+{
+	size_t i;
+	free(b->member_first);
+	free(b->members);
+	for (i = 0; b->class_perms != NULL && i <= b->num_classes; i++) {
+		apol_vector_destroy(&b->class_perms[i]);
+	}
+	free(b->class_perms);
+	free(b->rules);
+	free(b->keys);
+	free(b->key_first);
+	free(b->is_domain);
+	free(b->type_of_value);
+}
+
+static int type_similarity_push_pair(const apol_type_similarity_t * s, uint32_t ** pairs, size_t * num_pairs, size_t * pairs_cap,
+				     uint32_t value, uint32_t type_value)
+{
+	uint32_t *tmp;
+	if (*num_pairs + 2 > *pairs_cap) {
+		size_t new_cap = (*pairs_cap == 0 ? 1024 : *pairs_cap * 2);
+		if ((tmp = realloc(*pairs, new_cap * sizeof(*tmp))) == NULL) {
+			ERR(s->policy, "%s", strerror(errno));
+			return -1;
+		}
+		*pairs = tmp;
+		*pairs_cap = new_cap;
+	}
+	(*pairs)[(*num_pairs)++] = value;
+	(*pairs)[(*num_pairs)++] = type_value;
+	return 0;
+}
+
+/**
+ * Record the types that each type or attribute value stands for.  A
+ * type stands for itself; an attribute stands for its member types.
+ */
+static int type_similarity_get_members(apol_type_similarity_t * s, type_similarity_build_t * b)
+{
+	qpol_policy_t *q = s->policy->p;
+	qpol_iterator_t *iter = NULL, *attr_iter = NULL;
+	const qpol_type_t *type, *attr;
+	uint32_t value, attr_value, *pairs = NULL;
+	size_t num_pairs = 0, pairs_cap = 0, i;
+	unsigned char isalias, isattr;
+	int error = 0;
+
+	if (qpol_policy_get_type_iter(q, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&type) < 0 || qpol_type_get_value(q, type, &value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (value > s->num_values) {
+			s->num_values = value;
+		}
+	}
+	if ((b->type_of_value = calloc(s->num_values + 1, sizeof(*b->type_of_value))) == NULL ||
+	    (b->member_first = calloc(s->num_values + 2, sizeof(*b->member_first))) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+
+	/* gather (value, member type) pairs */
+	qpol_iterator_destroy(&iter);
+	if (qpol_policy_get_type_iter(q, &iter) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&type) < 0 || qpol_type_get_isalias(q, type, &isalias) < 0 ||
+		    qpol_type_get_isattr(q, type, &isattr) < 0 || qpol_type_get_value(q, type, &value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (isalias || isattr) {
+			continue;
+		}
+		b->type_of_value[value] = type;
+		if (qpol_type_get_attr_iter(q, type, &attr_iter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (type_similarity_push_pair(s, &pairs, &num_pairs, &pairs_cap, value, value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		for (; !qpol_iterator_end(attr_iter); qpol_iterator_next(attr_iter)) {
+			if (qpol_iterator_get_item(attr_iter, (void **)&attr) < 0 || qpol_type_get_value(q, attr, &attr_value) < 0 ||
+			    type_similarity_push_pair(s, &pairs, &num_pairs, &pairs_cap, attr_value, value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+		}
+		qpol_iterator_destroy(&attr_iter);
+	}
+
+	/* then sort them by value */
+	if (num_pairs > 0 && (b->members = malloc(num_pairs / 2 * sizeof(*b->members))) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < num_pairs; i += 2) {
+		b->member_first[pairs[i] + 1]++;
+	}
+	for (i = 1; i < s->num_values + 2; i++) {
+		b->member_first[i] += b->member_first[i - 1];
+	}
+	for (i = 0; i < num_pairs; i += 2) {
+		b->members[b->member_first[pairs[i]]++] = pairs[i + 1];
+	}
+	memmove(b->member_first + 1, b->member_first, (s->num_values + 1) * sizeof(*b->member_first));
+	b->member_first[0] = 0;
+      cleanup:
+	free(pairs);
+	qpol_iterator_destroy(&attr_iter);
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Number each class's permissions, common permissions first.
+ */
+static int type_similarity_get_classes(apol_type_similarity_t * s, type_similarity_build_t * b)
+{
+	qpol_policy_t *q = s->policy->p;
+	qpol_iterator_t *iter = NULL;
+	const qpol_class_t *obj_class;
+	uint32_t value;
+	int error = 0;
+
+	if (qpol_policy_get_class_iter(q, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&obj_class) < 0 || qpol_class_get_value(q, obj_class, &value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (value > b->num_classes) {
+			b->num_classes = value;
+		}
+	}
+	if ((b->class_perms = calloc(b->num_classes + 1, sizeof(*b->class_perms))) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	qpol_iterator_destroy(&iter);
+	if (qpol_policy_get_class_iter(q, &iter) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&obj_class) < 0 || qpol_class_get_value(q, obj_class, &value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if ((b->class_perms[value] = class_perm_get_numbered(s->policy, obj_class)) == NULL) {
+			error = errno;
+			goto cleanup;
+		}
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Reduce every allow rule to values.
+ */
+static int type_similarity_get_rules(apol_type_similarity_t * s, type_similarity_build_t * b)
+{
+	qpol_policy_t *q = s->policy->p;
+	qpol_iterator_t *iter = NULL, *perm_iter = NULL;
+	const qpol_avrule_t *rule;
+	const qpol_type_t *source, *target;
+	const qpol_class_t *obj_class;
+	type_similarity_rule_t *r;
+	size_t size, i;
+	char *perm;
+	int error = 0;
+
+	if (qpol_policy_get_avrule_iter(q, QPOL_RULE_ALLOW, &iter) < 0 || qpol_iterator_get_size(iter, &size) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	if (size > 0 && (b->rules = malloc(size * sizeof(*b->rules))) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter) && b->num_rules < size; qpol_iterator_next(iter)) {
+		r = b->rules + b->num_rules;
+		if (qpol_iterator_get_item(iter, (void **)&rule) < 0 ||
+		    qpol_avrule_get_source_type(q, rule, &source) < 0 || qpol_type_get_value(q, source, &r->source) < 0 ||
+		    qpol_avrule_get_target_type(q, rule, &target) < 0 || qpol_type_get_value(q, target, &r->target) < 0 ||
+		    qpol_avrule_get_object_class(q, rule, &obj_class) < 0 ||
+		    qpol_class_get_value(q, obj_class, &r->class_value) < 0 || qpol_avrule_get_perm_iter(q, rule, &perm_iter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		r->perms = 0;
+		for (; !qpol_iterator_end(perm_iter); qpol_iterator_next(perm_iter)) {
+			if (qpol_iterator_get_item(perm_iter, (void **)&perm) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			if (r->class_value <= b->num_classes &&
+			    apol_vector_get_index(b->class_perms[r->class_value], perm, apol_str_strcmp, NULL, &i) == 0 &&
+			    i < TYPE_SIMILARITY_MAX_PERMS) {
+				r->perms |= (uint32_t) 1 << i;
+			}
+			free(perm);
+		}
+		qpol_iterator_destroy(&perm_iter);
+		if (r->perms != 0) {
+			b->num_rules++;
+		}
+	}
+      cleanup:
+	qpol_iterator_destroy(&perm_iter);
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Mark the domain set: the types of each named type or attribute, or
+ * of APOL_TYPE_SIMILARITY_DOMAIN_ATTRIB if none are named.
+ */
+static int type_similarity_get_domain_set(apol_type_similarity_t * s, type_similarity_build_t * b, const apol_vector_t * domains)
+{
+	const qpol_type_t *type;
+	const char *name;
+	uint32_t value;
+	size_t num_names = (domains == NULL ? 1 : apol_vector_get_size(domains)), i, k;
+	int error;
+
+	if ((b->is_domain = calloc(s->num_values + 1, sizeof(*b->is_domain))) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		errno = error;
+		return -1;
+	}
+	for (i = 0; i < num_names; i++) {
+		name = (domains == NULL ? APOL_TYPE_SIMILARITY_DOMAIN_ATTRIB : apol_vector_get_element(domains, i));
+		if (apol_query_get_type(s->policy, name, &type) < 0 || qpol_type_get_value(s->policy->p, type, &value) < 0) {
+			return -1;
+		}
+		for (k = b->member_first[value]; k < b->member_first[value + 1]; k++) {
+			b->is_domain[b->members[k]] = 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Expand each rule's targets and permissions into the accesses it
+ * grants.  These do not depend upon the rule's source, so a rule is
+ * expanded once however many domains it grants them to.
+ */
+static int type_similarity_expand_rules(apol_type_similarity_t * s, type_similarity_build_t * b)
+{
+	const type_similarity_rule_t *r;
+	const uint32_t *tgt, *tgt_end;
+	size_t total = 0, i;
+	uint32_t perms;
+	uint64_t key, *k;
+	int error;
+
+	if ((b->key_first = malloc((b->num_rules + 1) * sizeof(*b->key_first))) == NULL) {
+		goto err;
+	}
+	for (i = 0; i < b->num_rules; i++) {
+		r = b->rules + i;
+		b->key_first[i] = total;
+		total += (b->member_first[r->target + 1] - b->member_first[r->target]) * type_similarity_popcount(r->perms);
+	}
+	b->key_first[b->num_rules] = total;
+	if (total > 0 && (b->keys = malloc(total * sizeof(*b->keys))) == NULL) {
+		goto err;
+	}
+	for (i = 0; i < b->num_rules; i++) {
+		r = b->rules + i;
+		k = b->keys + b->key_first[i];
+		tgt_end = b->members + b->member_first[r->target + 1];
+		for (tgt = b->members + b->member_first[r->target]; tgt < tgt_end; tgt++) {
+			key = ((uint64_t) * tgt << 32) | ((uint64_t) r->class_value << TYPE_SIMILARITY_PERM_BITS);
+			for (perms = r->perms; perms != 0; perms &= perms - 1) {
+				*k++ = key | (uint64_t) type_similarity_popcount((perms & -perms) - 1);
+			}
+		}
+		/* a rule's targets are distinct, so its accesses are too */
+		qsort(b->keys + b->key_first[i], b->key_first[i + 1] - b->key_first[i], sizeof(*b->keys),
+		      type_similarity_u64_compare);
+	}
+	return 0;
+      err:
+	error = errno;
+	ERR(s->policy, "%s", strerror(error));
+	errno = error;
+	return -1;
+}
+
+/**
+ * Merge two sorted, distinct arrays into a third, keeping one of
+ * each element within both.
+ *
+ * @return Number of elements written to out.
+ */
+static size_t type_similarity_merge(const uint64_t * a, size_t na, const uint64_t * b, size_t nb, uint64_t * out)
+{
+	size_t i = 0, j = 0, n = 0;
+	while (i < na && j < nb) {
+		if (a[i] < b[j]) {
+			out[n++] = a[i++];
+		} else if (a[i] > b[j]) {
+			out[n++] = b[j++];
+		} else {
+			out[n++] = a[i++];
+			j++;
+		}
+	}
+	while (i < na) {
+		out[n++] = a[i++];
+	}
+	while (j < nb) {
+		out[n++] = b[j++];
+	}
+	return n;
+}
+
+static int type_similarity_reserve(const apol_type_similarity_t * s, uint64_t ** v, size_t * cap, size_t n)
+{
+	uint64_t *tmp;
+	size_t new_cap;
+	int error;
+	if (n <= *cap) {
+		return 0;
+	}
+	for (new_cap = (*cap == 0 ? 1024 : *cap); new_cap < n; new_cap *= 2) ;
+	if ((tmp = realloc(*v, new_cap * sizeof(*tmp))) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		errno = error;
+		return -1;
+	}
+	*v = tmp;
+	*cap = new_cap;
+	return 0;
+}
+
+/**
+ * Gather each domain's accesses: the union of the accesses of every
+ * rule that grants it any.  Each rule's accesses are merged into the
+ * union as they are reached, so no duplicate is ever held.  The
+ * domains are those types of the domain set granted at least one
+ * access.
+ */
+static int type_similarity_get_accesses(apol_type_similarity_t * s, type_similarity_build_t * b)
+{
+	const type_similarity_rule_t *r;
+	const uint32_t *src, *src_end;
+	size_t *rule_first = NULL, *rule_of = NULL;
+	uint64_t *acc = NULL, *tmp = NULL, *swap;
+	size_t acc_cap = 0, tmp_cap = 0, accesses_cap = 0, swap_cap, n, nk, total = 0, i, d, v;
+	int error = 0;
+
+	if (type_similarity_expand_rules(s, b) < 0) {
+		return -1;
+	}
+
+	/* index, by source type value, the rules that grant each domain
+	 * any access */
+	if ((rule_first = calloc(s->num_values + 2, sizeof(*rule_first))) == NULL ||
+	    (s->domain_of_value = calloc(s->num_values + 1, sizeof(*s->domain_of_value))) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < b->num_rules; i++) {
+		r = b->rules + i;
+		if (b->key_first[i] == b->key_first[i + 1]) {
+			continue;
+		}
+		src_end = b->members + b->member_first[r->source + 1];
+		for (src = b->members + b->member_first[r->source]; src < src_end; src++) {
+			if (b->is_domain[*src]) {
+				rule_first[*src + 1]++;
+			}
+		}
+	}
+	for (v = 1; v <= s->num_values; v++) {
+		if (rule_first[v + 1] > 0) {
+			s->num_domains++;
+		}
+		rule_first[v + 1] += rule_first[v];
+	}
+	if (rule_first[s->num_values + 1] > 0 &&
+	    (rule_of = malloc(rule_first[s->num_values + 1] * sizeof(*rule_of))) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	/* fill using rule_first as each value's cursor, then shift it
+	 * back */
+	for (i = 0; i < b->num_rules; i++) {
+		r = b->rules + i;
+		if (b->key_first[i] == b->key_first[i + 1]) {
+			continue;
+		}
+		src_end = b->members + b->member_first[r->source + 1];
+		for (src = b->members + b->member_first[r->source]; src < src_end; src++) {
+			if (b->is_domain[*src]) {
+				rule_of[rule_first[*src]++] = i;
+			}
+		}
+	}
+	memmove(rule_first + 1, rule_first, (s->num_values + 1) * sizeof(*rule_first));
+	rule_first[0] = 0;
+
+	if (s->num_domains > 0 &&
+	    ((s->domains = malloc(s->num_domains * sizeof(*s->domains))) == NULL ||
+	     (s->first = malloc(s->num_domains * sizeof(*s->first))) == NULL ||
+	     (s->len = calloc(s->num_domains, sizeof(*s->len))) == NULL)) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (v = 1, d = 0; v <= s->num_values; v++) {
+		if (rule_first[v] == rule_first[v + 1]) {
+			continue;
+		}
+		for (n = 0, i = rule_first[v]; i < rule_first[v + 1]; i++) {
+			nk = b->key_first[rule_of[i] + 1] - b->key_first[rule_of[i]];
+			if (type_similarity_reserve(s, &tmp, &tmp_cap, n + nk) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			n = type_similarity_merge(acc, n, b->keys + b->key_first[rule_of[i]], nk, tmp);
+			swap = acc;
+			acc = tmp;
+			tmp = swap;
+			swap_cap = acc_cap;
+			acc_cap = tmp_cap;
+			tmp_cap = swap_cap;
+		}
+		if (type_similarity_reserve(s, &s->accesses, &accesses_cap, total + n) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		memcpy(s->accesses + total, acc, n * sizeof(*acc));
+		s->domains[d] = b->type_of_value[v];
+		s->domain_of_value[v] = d + 1;
+		s->first[d] = total;
+		s->len[d++] = n;
+		total += n;
+	}
+      cleanup:
+	free(rule_first);
+	free(rule_of);
+	free(acc);
+	free(tmp);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Sketch a range of domains' accesses.
+ */
+static int type_similarity_sketch_domains(void *arg, size_t first, size_t last)
+{
+	apol_type_similarity_t *s = arg;
+	const uint64_t *a;
+	uint64_t *sketch, x;
+	size_t d, i, h;
+
+	for (d = first; d < last; d++) {
+		a = s->accesses + s->first[d];
+		sketch = s->sketches + d * s->num_hashes;
+		for (h = 0; h < s->num_hashes; h++) {
+			sketch[h] = UINT64_MAX;
+		}
+		for (i = 0; i < s->len[d]; i++) {
+			for (h = 0; h < s->num_hashes; h++) {
+				x = type_similarity_mix(a[i] ^ (UINT64_C(0x9e3779b97f4a7c15) * (h + 1)));
+				if (x < sketch[h]) {
+					sketch[h] = x;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * Compute the Jaccard index of two domains' accesses.  A domain
+ * without accesses is alike to no other, not even to another such
+ * domain, so an empty union gives 0.0 rather than 0/0.
+ */
+static double type_similarity_jaccard(const apol_type_similarity_t * s, size_t i, size_t j)
+{
+	const uint64_t *a = s->accesses + s->first[i], *a_end = a + s->len[i];
+	const uint64_t *b = s->accesses + s->first[j], *b_end = b + s->len[j];
+	size_t common = 0;
+
+	if (s->len[i] == 0 || s->len[j] == 0) {
+		return 0.0;
+	}
+	while (a < a_end && b < b_end) {
+		if (*a < *b) {
+			a++;
+		} else if (*a > *b) {
+			b++;
+		} else {
+			common++;
+			a++;
+			b++;
+		}
+	}
+	return (double)common / (double)(s->len[i] + s->len[j] - common);
+}
+
+static int type_similarity_verify_pairs(void *arg, size_t first, size_t last)
+{
+	type_similarity_verify_t *v = arg;
+	size_t k;
+	for (k = first; k < last; k++) {
+		v->similarities[k] =
+			type_similarity_jaccard(v->s, (size_t) (v->candidates[k] >> 32), (size_t) (v->candidates[k] & UINT32_MAX));
+	}
+	return 0;
+}
+
+apol_type_similarity_t *apol_type_similarity_create(const apol_policy_t * p, const apol_vector_t * domains, size_t num_hashes)
+{
+	apol_type_similarity_t *s;
+	type_similarity_build_t b;
+	int error;
+
+	if (p == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if (!qpol_policy_has_capability(p->p, QPOL_CAP_RULES_LOADED)) {
+		ERR(p, "%s", "Cannot compare domains without the policy's rules.");
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((s = calloc(1, sizeof(*s))) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		errno = error;
+		return NULL;
+	}
+	s->policy = p;
+	s->num_hashes = num_hashes;
+	memset(&b, 0, sizeof(b));
+	if (type_similarity_get_members(s, &b) < 0 || type_similarity_get_domain_set(s, &b, domains) < 0 ||
+	    type_similarity_get_classes(s, &b) < 0 || type_similarity_get_rules(s, &b) < 0 ||
+	    type_similarity_get_accesses(s, &b) < 0) {
+		goto err;
+	}
+	if (num_hashes > 0 && s->num_domains > 0 &&
+	    (s->sketches = malloc(s->num_domains * num_hashes * sizeof(*s->sketches))) == NULL) {
+		ERR(p, "%s", strerror(errno));
+		goto err;
+	}
+	if (num_hashes > 0) {
+		qpol_parallel_run(s->num_domains, 1, type_similarity_sketch_domains, s);
+	}
+	type_similarity_build_fini(&b);
+	return s;
+      err:
+	error = errno;
+	type_similarity_build_fini(&b);
+	apol_type_similarity_destroy(&s);
+	errno = error;
+	return NULL;
+}
+
+void apol_type_similarity_destroy(apol_type_similarity_t ** s)
+{
+	if (s != NULL && *s != NULL) {
+		free((*s)->domains);
+		free((*s)->domain_of_value);
+		free((*s)->accesses);
+		free((*s)->first);
+		free((*s)->len);
+		free((*s)->sketches);
+		free(*s);
+		*s = NULL;
+	}
+}
+
+size_t apol_type_similarity_get_num_domains(const apol_type_similarity_t * s)
+{
+	if (s == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return s->num_domains;
+}
+
+const qpol_type_t *apol_type_similarity_get_domain(const apol_type_similarity_t * s, size_t i)
+{
+	if (s == NULL || i >= s->num_domains) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return s->domains[i];
+}
+
+int apol_type_similarity_get_domain_index(const apol_type_similarity_t * s, const char *name, size_t * i)
+{
+	const qpol_type_t *type;
+	uint32_t value;
+
+	if (s == NULL || name == NULL || i == NULL) {
+		ERR(s == NULL ? NULL : s->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (apol_query_get_type(s->policy, name, &type) < 0 || qpol_type_get_value(s->policy->p, type, &value) < 0) {
+		return -1;
+	}
+	if (value > s->num_values || s->domain_of_value[value] == 0) {
+		ERR(s->policy, "%s is not granted any access.", name);
+		errno = ENOENT;
+		return -1;
+	}
+	*i = s->domain_of_value[value] - 1;
+	return 0;
+}
+
+size_t apol_type_similarity_get_num_accesses(const apol_type_similarity_t * s, size_t i)
+{
+	if (s == NULL || i >= s->num_domains) {
+		errno = EINVAL;
+		return 0;
+	}
+	return s->len[i];
+}
+
+int apol_type_similarity_compare(const apol_type_similarity_t * s, size_t i, size_t j, double *similarity)
+{
+	if (s == NULL || i >= s->num_domains || j >= s->num_domains || similarity == NULL) {
+		ERR(s == NULL ? NULL : s->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	*similarity = type_similarity_jaccard(s, i, j);
+	return 0;
+}
+
+int apol_type_similarity_estimate(const apol_type_similarity_t * s, size_t i, size_t j, double *similarity)
+{
+	const uint64_t *a, *b;
+	size_t h, same = 0;
+
+	if (s == NULL || i >= s->num_domains || j >= s->num_domains || similarity == NULL || s->num_hashes == 0) {
+		ERR(s == NULL ? NULL : s->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	/* empty sketches are all alike, but their domains are not */
+	if (s->len[i] == 0 || s->len[j] == 0) {
+		*similarity = 0.0;
+		return 0;
+	}
+	a = s->sketches + i * s->num_hashes;
+	b = s->sketches + j * s->num_hashes;
+	for (h = 0; h < s->num_hashes; h++) {
+		if (a[h] == b[h]) {
+			same++;
+		}
+	}
+	*similarity = (double)same / (double)s->num_hashes;
+	return 0;
+}
+
+/**
+ * Choose the number of sketch rows within each band, the most for
+ * which b * t^r is at least TYPE_SIMILARITY_BAND_MARGIN.  More rows
+ * mean fewer candidates that are not alike.  Returns 0 if even one
+ * row falls short, for the sketches are then too small to find the
+ * pairs at this threshold reliably.
+ */
+static size_t type_similarity_get_rows(size_t num_hashes, double threshold)
+{
+	size_t rows, best = 0, i;
+	double t;
+	for (rows = 1; rows <= num_hashes; rows++) {
+		for (t = 1.0, i = 0; i < rows; i++) {
+			t *= threshold;
+		}
+		if (t * (double)(num_hashes / rows) >= TYPE_SIMILARITY_BAND_MARGIN) {
+			best = rows;
+		}
+	}
+	return best;
+}
+
+static int type_similarity_push(const apol_type_similarity_t * s, uint64_t ** v, size_t * n, size_t * cap, uint64_t x)
+{
+	uint64_t *tmp;
+	if (*n >= *cap) {
+		size_t new_cap = (*cap == 0 ? 1024 : *cap * 2);
+		if ((tmp = realloc(*v, new_cap * sizeof(*tmp))) == NULL) {
+			ERR(s->policy, "%s", strerror(errno));
+			return -1;
+		}
+		*v = tmp;
+		*cap = new_cap;
+	}
+	(*v)[(*n)++] = x;
+	return 0;
+}
+
+/**
+ * Find the candidate pairs: those that share a band of their
+ * sketches, or every pair if there are no sketches or they are too
+ * small for the threshold.  Each is the
+ * lesser domain index in the upper half; they are sorted and
+ * distinct.  Domains without accesses are never candidates: they are
+ * alike to none, and their sketches would all share every band.
+ */
+static int type_similarity_get_candidates(const apol_type_similarity_t * s, double threshold, uint64_t ** candidates,
+					  size_t * num_candidates)
+{
+	uint64_t *bands = NULL, x;
+	size_t cap = 0, rows, num_bands, band, d, i, j, n, run, row;
+	int error = 0;
+
+	*candidates = NULL;
+	*num_candidates = 0;
+	if (s->num_hashes == 0 || (rows = type_similarity_get_rows(s->num_hashes, threshold)) == 0) {
+		for (i = 0; i < s->num_domains; i++) {
+			for (j = i + 1; j < s->num_domains; j++) {
+				if (s->len[i] == 0 || s->len[j] == 0) {
+					continue;
+				}
+				if (type_similarity_push(s, candidates, num_candidates, &cap, ((uint64_t) i << 32) | j) < 0) {
+					error = errno;
+					goto cleanup;
+				}
+			}
+		}
+		return 0;
+	}
+
+	num_bands = s->num_hashes / rows;
+	if (s->num_domains > 0 && (bands = malloc(s->num_domains * sizeof(*bands))) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (band = 0; band < num_bands; band++) {
+		/* hash each domain's band into the upper half, keeping
+		 * its index in the lower, so sorting groups equal bands
+		 * in domain order */
+		for (d = n = 0; d < s->num_domains; d++) {
+			if (s->len[d] == 0) {
+				continue;
+			}
+			x = band + 1;
+			for (row = 0; row < rows; row++) {
+				x = type_similarity_mix(x ^ s->sketches[d * s->num_hashes + band * rows + row]);
+			}
+			bands[n++] = (x & ~(uint64_t) UINT32_MAX) | d;
+		}
+		qsort(bands, n, sizeof(*bands), type_similarity_u64_compare);
+		for (i = 0; i < n; i = run) {
+			for (run = i + 1; run < n && (bands[run] >> 32) == (bands[i] >> 32); run++) ;
+			for (j = i; j < run; j++) {
+				for (d = j + 1; d < run; d++) {
+					if (type_similarity_push(s, candidates, num_candidates, &cap,
+								 ((bands[j] & UINT32_MAX) << 32) | (bands[d] & UINT32_MAX)) < 0) {
+						error = errno;
+						goto cleanup;
+					}
+				}
+			}
+		}
+	}
+	qsort(*candidates, *num_candidates, sizeof(**candidates), type_similarity_u64_compare);
+	for (i = j = 0; i < *num_candidates; i++) {
+		if (j == 0 || (*candidates)[i] != (*candidates)[j - 1]) {
+			(*candidates)[j++] = (*candidates)[i];
+		}
+	}
+	*num_candidates = j;
+      cleanup:
+	free(bands);
+	if (error != 0) {
+		free(*candidates);
+		*candidates = NULL;
+		*num_candidates = 0;
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Find the pairs whose exact similarity is at least the threshold,
+ * sorted as the candidates are.
+ */
+static int type_similarity_get_pairs(const apol_type_similarity_t * s, double threshold, uint64_t ** pairs, double **similarities,
+				     size_t * num_pairs)
+{
+	type_similarity_verify_t v;
+	size_t num_candidates, i, n;
+	int error;
+
+	*similarities = NULL;
+	*num_pairs = 0;
+	if (!(threshold > 0.0 && threshold <= 1.0)) {
+		ERR(s->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (type_similarity_get_candidates(s, threshold, pairs, &num_candidates) < 0) {
+		return -1;
+	}
+	if (num_candidates > 0 && (*similarities = malloc(num_candidates * sizeof(**similarities))) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		free(*pairs);
+		*pairs = NULL;
+		errno = error;
+		return -1;
+	}
+	v.s = s;
+	v.candidates = *pairs;
+	v.similarities = *similarities;
+	qpol_parallel_run(num_candidates, 1, type_similarity_verify_pairs, &v);
+	for (i = n = 0; i < num_candidates; i++) {
+		if ((*similarities)[i] >= threshold) {
+			(*pairs)[n] = (*pairs)[i];
+			(*similarities)[n++] = (*similarities)[i];
+		}
+	}
+	*num_pairs = n;
+	return 0;
+}
+
+int apol_type_similarity_find_pairs(const apol_type_similarity_t * s, double threshold, apol_vector_t ** pairs)
+{
+	apol_type_similarity_pair_t *pair;
+	uint64_t *found = NULL;
+	double *similarities = NULL;
+	size_t num_found, i;
+	int error = 0;
+
+	if (pairs != NULL) {
+		*pairs = NULL;
+	}
+	if (s == NULL || pairs == NULL) {
+		ERR(s == NULL ? NULL : s->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (type_similarity_get_pairs(s, threshold, &found, &similarities, &num_found) < 0) {
+		return -1;
+	}
+	if ((*pairs = apol_vector_create_with_capacity(num_found, free)) == NULL) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < num_found; i++) {
+		if ((pair = malloc(sizeof(*pair))) == NULL || apol_vector_append(*pairs, pair) < 0) {
+			error = errno;
+			ERR(s->policy, "%s", strerror(error));
+			free(pair);
+			goto cleanup;
+		}
+		pair->first = s->domains[found[i] >> 32];
+		pair->other = s->domains[found[i] & UINT32_MAX];
+		pair->similarity = similarities[i];
+	}
+      cleanup:
+	free(found);
+	free(similarities);
+	if (error != 0) {
+		apol_vector_destroy(pairs);
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+static size_t type_similarity_find_root(size_t * parent, size_t i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+static void type_similarity_cluster_free(void *elem)
+{
+	apol_vector_t *v = elem;
+	apol_vector_destroy(&v);
+}
+
+int apol_type_similarity_find_clusters(const apol_type_similarity_t * s, double threshold, apol_vector_t ** clusters)
+{
+	uint64_t *found = NULL;
+	double *similarities = NULL;
+	size_t *parent = NULL, *size = NULL, *cluster_of = NULL, num_found, i, a, b;
+	apol_vector_t *v;
+	int error = 0;
+
+	if (clusters != NULL) {
+		*clusters = NULL;
+	}
+	if (s == NULL || clusters == NULL) {
+		ERR(s == NULL ? NULL : s->policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (type_similarity_get_pairs(s, threshold, &found, &similarities, &num_found) < 0) {
+		return -1;
+	}
+	if ((*clusters = apol_vector_create(type_similarity_cluster_free)) == NULL ||
+	    (s->num_domains > 0 &&
+	     ((parent = malloc(s->num_domains * sizeof(*parent))) == NULL ||
+	      (size = calloc(s->num_domains, sizeof(*size))) == NULL ||
+	      (cluster_of = calloc(s->num_domains, sizeof(*cluster_of))) == NULL))) {
+		error = errno;
+		ERR(s->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < s->num_domains; i++) {
+		parent[i] = i;
+	}
+	for (i = 0; i < num_found; i++) {
+		a = type_similarity_find_root(parent, (size_t) (found[i] >> 32));
+		b = type_similarity_find_root(parent, (size_t) (found[i] & UINT32_MAX));
+		if (a != b) {
+			parent[a > b ? a : b] = (a < b ? a : b);
+		}
+	}
+	for (i = 0; i < s->num_domains; i++) {
+		size[type_similarity_find_root(parent, i)]++;
+	}
+	/* domains are visited in order, so each group is created when
+	 * its first domain is reached */
+	for (i = 0; i < s->num_domains; i++) {
+		a = type_similarity_find_root(parent, i);
+		if (size[a] < 2) {
+			continue;
+		}
+		if (cluster_of[a] == 0) {
+			if ((v = apol_vector_create_with_capacity(size[a], NULL)) == NULL || apol_vector_append(*clusters, v) < 0) {
+				error = errno;
+				ERR(s->policy, "%s", strerror(error));
+				apol_vector_destroy(&v);
+				goto cleanup;
+			}
+			cluster_of[a] = apol_vector_get_size(*clusters);
+		}
+		v = apol_vector_get_element(*clusters, cluster_of[a] - 1);
+		if (apol_vector_append(v, (void *)s->domains[i]) < 0) {
+			error = errno;
+			ERR(s->policy, "%s", strerror(error));
+			goto cleanup;
+		}
+	}
+      cleanup:
+	free(found);
+	free(similarities);
+	free(parent);
+	free(size);
+	free(cluster_of);
+	if (error != 0) {
+		apol_vector_destroy(clusters);
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+const qpol_type_t *apol_type_similarity_pair_get_first(const apol_type_similarity_pair_t * pair)
+{
+	if (pair == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return pair->first;
+}
+
+const qpol_type_t *apol_type_similarity_pair_get_other(const apol_type_similarity_pair_t * pair)
+{
+	if (pair == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return pair->other;
+}
+
+double apol_type_similarity_pair_get_similarity(const apol_type_similarity_pair_t * pair)
+{
+	if (pair == NULL) {
+		errno = EINVAL;
+		return -1.0;
+	}
+	return pair->similarity;
+}
@@ -25,8 +25,11 @@
 #include "policy-query-internal.h"
 #include "domain-trans-analysis-internal.h"
 #include "infoflow-analysis-internal.h"
+#include <qpol/util.h>
 
 #include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 struct apol_types_relation_analysis
@@ -92,23 +95,22 @@ static int apol_types_relation_common_attribs(const apol_policy_t * p,
 					      const qpol_type_t * typeA, const qpol_type_t * typeB,
 					      apol_types_relation_result_t * r)
 {
-	qpol_iterator_t *iA = NULL, *iB = NULL;
 	apol_vector_t *vA = NULL, *vB = NULL;
 	int retval = -1;
 
-	if (qpol_type_get_attr_iter(p->p, typeA, &iA) < 0 || qpol_type_get_attr_iter(p->p, typeB, &iB) < 0) {
+	if ((vA = apol_vector_create(NULL)) == NULL || (vB = apol_vector_create(NULL)) == NULL) {
+		ERR(p, "%s", strerror(errno));
+		goto cleanup;
+	}
+	if (apol_membership_append_attribs(p, typeA, vA) < 0 || apol_membership_append_attribs(p, typeB, vB) < 0) {
 		goto cleanup;
 	}
-	if ((vA = apol_vector_create_from_iter(iA, NULL)) == NULL ||
-	    (vB = apol_vector_create_from_iter(iB, NULL)) == NULL ||
-	    (r->attribs = apol_vector_create_from_intersection(vA, vB, NULL, NULL)) == NULL) {
+	if ((r->attribs = apol_vector_create_from_intersection(vA, vB, NULL, NULL)) == NULL) {
 		ERR(p, "%s", strerror(errno));
 	}
 
 	retval = 0;
       cleanup:
-	qpol_iterator_destroy(&iA);
-	qpol_iterator_destroy(&iB);
 	apol_vector_destroy(&vA);
 	apol_vector_destroy(&vB);
 	return retval;
@@ -178,7 +180,7 @@ static int apol_types_relation_common_users(const apol_policy_t * p,
 	const char *nameA, *nameB;
 	apol_role_query_t *rq = NULL;
 	apol_vector_t *vA = NULL, *vB = NULL;
-	qpol_iterator_t *iter = NULL, *riter = NULL;
+	qpol_iterator_t *iter = NULL;
 	int retval = -1;
 
 	if (qpol_type_get_name(p->p, typeA, &nameA) < 0 || qpol_type_get_name(p->p, typeB, &nameB) < 0) {
@@ -208,22 +210,16 @@ static int apol_types_relation_common_users(const apol_policy_t * p,
 		if (qpol_iterator_get_item(iter, (void **)&user) < 0) {
 			goto cleanup;
 		}
-		if (qpol_user_get_role_iter(p->p, user, &riter) < 0) {
-			goto cleanup;
-		}
-		for (; (!inA || !inB) && !qpol_iterator_end(riter); qpol_iterator_next(riter)) {
-			qpol_role_t *role;
-			if (qpol_iterator_get_item(riter, (void **)&role) < 0) {
+		for (i = 0; !inA && i < apol_vector_get_size(vA); i++) {
+			if ((inA = apol_membership_user_has_role(p, user, apol_vector_get_element(vA, i))) < 0) {
 				goto cleanup;
 			}
-			if (!inA && apol_vector_get_index(vA, role, NULL, NULL, &i) == 0) {
-				inA = 1;
-			}
-			if (!inB && apol_vector_get_index(vB, role, NULL, NULL, &i) == 0) {
-				inB = 1;
+		}
+		for (i = 0; inA && !inB && i < apol_vector_get_size(vB); i++) {
+			if ((inB = apol_membership_user_has_role(p, user, apol_vector_get_element(vB, i))) < 0) {
+				goto cleanup;
 			}
 		}
-		qpol_iterator_destroy(&riter);
 		if (inA && inB && apol_vector_append(r->users, user) < 0) {
 			ERR(p, "%s", strerror(ENOMEM));
 			goto cleanup;
@@ -236,7 +232,6 @@ static int apol_types_relation_common_users(const apol_policy_t * p,
 	apol_vector_destroy(&vA);
 	apol_vector_destroy(&vB);
 	qpol_iterator_destroy(&iter);
-	qpol_iterator_destroy(&riter);
 	return retval;
 }
 
@@ -396,83 +391,67 @@ static int apol_types_relation_create_access_pools(const apol_policy_t * p,
 /**
  * Allocate a new apol_types_relation_access_t and append it to a
  * vector.  The new access node's type will be set to a's type.  The
- * rules will be a clone of a's rules.
+ * rules will be a clone of a's rules.  Errors are not reported, so
+ * that this may be called from a batch's worker threads.
  *
- * @param p Policy from which rule originated.
  * @param a Access node to duplicate.
  * @param access Vector of apol_types_relation_access_t to append.
  *
- * @return 0 on success, < 0 on error.
+ * @return 0 on success, < 0 on error and errno will be set.
  */
-static int apol_types_relation_access_append(const apol_policy_t * p, const apol_types_relation_access_t * a,
-					     apol_vector_t * access)
+static int apol_types_relation_access_append(const apol_types_relation_access_t * a, apol_vector_t * access)
 {
 	apol_types_relation_access_t *new_a;
-	int retval = -1;
+	int error;
 	if ((new_a = calloc(1, sizeof(*new_a))) == NULL
 	    || (new_a->rules = apol_vector_create_from_vector(a->rules, NULL, NULL, NULL)) == NULL) {
-		ERR(p, "%s", strerror(errno));
-		goto cleanup;
+		goto err;
 	}
 	new_a->type = a->type;
 	if (apol_vector_append(access, new_a) < 0) {
-		ERR(p, "%s", strerror(ENOMEM));
-		goto cleanup;
-	}
-	retval = 0;
-      cleanup:
-	if (retval != 0) {
-		apol_types_relation_access_free(new_a);
+		goto err;
 	}
-	return retval;
+	return 0;
+      err:
+	error = errno;
+	apol_types_relation_access_free(new_a);
+	errno = error;
+	return -1;
 }
 
 /**
- * Find accesses, both similar and dissimilar, between both typeA and
- * typeB.
+ * Compare the sorted access pools of typeA and typeB, and append
+ * clones of their common and unique accesses to the results.  Errors
+ * are not reported, so that this may be called from a batch's worker
+ * threads.
  *
- * @param p Policy containing types' information.
- * @param typeA First type to check.
- * @param typeB Other type to check.
+ * @param accessesA Vector of apol_types_relation_access_t for typeA,
+ * sorted by type.
+ * @param accessesB Vector of apol_types_relation_access_t for typeB,
+ * sorted by type.
  * @param do_similar 1 if to calculate similar accesses, 0 to skip.
  * @param do_dissimilar 1 if to calculate dissimilar accesses, 0 to skip.
  * @param r Result structure to fill.
  *
- * @return 0 on success, < 0 on error.
+ * @return 0 on success, < 0 on error and errno will be set.
  */
-static int apol_types_relation_accesses(const apol_policy_t * p,
-					const qpol_type_t * typeA,
-					const qpol_type_t * typeB, int do_similar, int do_dissimilar,
-					apol_types_relation_result_t * r)
+static int apol_types_relation_compare_accesses(const apol_vector_t * accessesA,
+						const apol_vector_t * accessesB, int do_similar, int do_dissimilar,
+						apol_types_relation_result_t * r)
 {
-	apol_vector_t *accessesA = NULL, *accessesB = NULL;
 	apol_types_relation_access_t *a, *b;
 	size_t i, j;
-	int retval = -1;
-
-	if ((accessesA = apol_vector_create(apol_types_relation_access_free)) == NULL
-	    || (accessesB = apol_vector_create(apol_types_relation_access_free)) == NULL) {
-		ERR(p, "%s", strerror(errno));
-		goto cleanup;
-	}
-	if (apol_types_relation_create_access_pools(p, typeA, typeB, accessesA, accessesB) < 0) {
-		goto cleanup;
-	}
-	apol_vector_sort(accessesA, apol_types_relation_access_compfunc2, NULL);
-	apol_vector_sort(accessesB, apol_types_relation_access_compfunc2, NULL);
 
 	if (do_similar) {
 		if ((r->simA = apol_vector_create(apol_types_relation_access_free)) == NULL
 		    || (r->simB = apol_vector_create(apol_types_relation_access_free)) == NULL) {
-			ERR(p, "%s", strerror(errno));
-			goto cleanup;
+			return -1;
 		}
 	}
 	if (do_dissimilar) {
 		if ((r->disA = apol_vector_create(apol_types_relation_access_free)) == NULL
 		    || (r->disB = apol_vector_create(apol_types_relation_access_free)) == NULL) {
-			ERR(p, "%s", strerror(errno));
-			goto cleanup;
+			return -1;
 		}
 	}
 
@@ -486,21 +465,21 @@ static int apol_types_relation_accesses(const apol_policy_t * p,
 		b = (apol_types_relation_access_t *) apol_vector_get_element(accessesB, j);
 		if (a->type == b->type) {
 			if (do_similar &&
-			    (apol_types_relation_access_append(p, a, r->simA) < 0 ||
-			     apol_types_relation_access_append(p, b, r->simB) < 0)) {
-				goto cleanup;
+			    (apol_types_relation_access_append(a, r->simA) < 0 ||
+			     apol_types_relation_access_append(b, r->simB) < 0)) {
+				return -1;
 			}
 			i++;
 			j++;
 		} else {
 			if (a->type < b->type) {
-				if (do_dissimilar && apol_types_relation_access_append(p, a, r->disA) < 0) {
-					goto cleanup;
+				if (do_dissimilar && apol_types_relation_access_append(a, r->disA) < 0) {
+					return -1;
 				}
 				i++;
 			} else {
-				if (do_dissimilar && apol_types_relation_access_append(p, b, r->disB) < 0) {
-					goto cleanup;
+				if (do_dissimilar && apol_types_relation_access_append(b, r->disB) < 0) {
+					return -1;
 				}
 				j++;
 			}
@@ -508,16 +487,54 @@ static int apol_types_relation_accesses(const apol_policy_t * p,
 	}
 	for (; do_dissimilar && i < apol_vector_get_size(accessesA); i++) {
 		a = (apol_types_relation_access_t *) apol_vector_get_element(accessesA, i);
-		if (apol_types_relation_access_append(p, a, r->disA) < 0) {
-			goto cleanup;
+		if (apol_types_relation_access_append(a, r->disA) < 0) {
+			return -1;
 		}
 	}
 	for (; do_dissimilar && j < apol_vector_get_size(accessesB); j++) {
 		b = (apol_types_relation_access_t *) apol_vector_get_element(accessesB, j);
-		if (apol_types_relation_access_append(p, b, r->disB) < 0) {
-			goto cleanup;
+		if (apol_types_relation_access_append(b, r->disB) < 0) {
+			return -1;
 		}
 	}
+	return 0;
+}
+
+/**
+ * Find accesses, both similar and dissimilar, between both typeA and
+ * typeB.
+ *
+ * @param p Policy containing types' information.
+ * @param typeA First type to check.
+ * @param typeB Other type to check.
+ * @param do_similar 1 if to calculate similar accesses, 0 to skip.
+ * @param do_dissimilar 1 if to calculate dissimilar accesses, 0 to skip.
+ * @param r Result structure to fill.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int apol_types_relation_accesses(const apol_policy_t * p,
+					const qpol_type_t * typeA,
+					const qpol_type_t * typeB, int do_similar, int do_dissimilar,
+					apol_types_relation_result_t * r)
+{
+	apol_vector_t *accessesA = NULL, *accessesB = NULL;
+	int retval = -1;
+
+	if ((accessesA = apol_vector_create(apol_types_relation_access_free)) == NULL
+	    || (accessesB = apol_vector_create(apol_types_relation_access_free)) == NULL) {
+		ERR(p, "%s", strerror(errno));
+		goto cleanup;
+	}
+	if (apol_types_relation_create_access_pools(p, typeA, typeB, accessesA, accessesB) < 0) {
+		goto cleanup;
+	}
+	apol_vector_sort(accessesA, apol_types_relation_access_compfunc2, NULL);
+	apol_vector_sort(accessesB, apol_types_relation_access_compfunc2, NULL);
+	if (apol_types_relation_compare_accesses(accessesA, accessesB, do_similar, do_dissimilar, r) < 0) {
+		ERR(p, "%s", strerror(errno));
+		goto cleanup;
+	}
 
 	retval = 0;
       cleanup:
@@ -918,6 +935,901 @@ static int apol_types_relation_domain(apol_policy_t * p,
 	return retval;
 }
 
+/******************** batch analysis ********************/
+
+/** The type is the first type within some pair. */
+#define APOL_TYPES_RELATION_BATCH_FIRST 0x1
+/** The type is the other type within some pair. */
+#define APOL_TYPES_RELATION_BATCH_OTHER 0x2
+
+/**
+ * What a batch analysis learns once about each type named within its
+ * pairs.  Everything here is built before any pair is examined and is
+ * only read afterwards.
+ */
+typedef struct apol_types_relation_batch_type
+{
+	const qpol_type_t *type;
+	const char *name;
+	uint32_t value;
+	/** bitwise-or of APOL_TYPES_RELATION_BATCH_FIRST and _OTHER */
+	unsigned int sides;
+	/** vector of qpol_type_t pointers, the type's attributes */
+	apol_vector_t *attribs;
+	/** non-zero for the type itself and for each of its attributes,
+	 *  indexed by type value */
+	unsigned char *covers;
+	/** vector of qpol_role_t pointers, roles whose allowed types
+	 *  include the type */
+	apol_vector_t *roles;
+	/** non-zero for each role within roles, indexed by role value */
+	unsigned char *role_set;
+	/** vector of qpol_avrule_t pointers, allow rules whose source is
+	 *  the type or one of its attributes */
+	apol_vector_t *allows;
+	/** vector of apol_types_relation_access_t, built from allows and
+	 *  sorted by type */
+	apol_vector_t *accesses;
+	/** vector of qpol_terule_t pointers, type transition and type
+	 *  change rules whose source is the type or one of its
+	 *  attributes */
+	apol_vector_t *terules;
+	/** vector of apol_infoflow_result_t, direct flows from the type */
+	apol_vector_t *dirflows;
+	/** vector of apol_infoflow_result_t, transitive flows out of the
+	 *  type */
+	apol_vector_t *transflows;
+	/** vector of apol_domain_trans_result_t, forward transitions from
+	 *  the type */
+	apol_vector_t *domains;
+} apol_types_relation_batch_type_t;
+
+typedef struct apol_types_relation_batch
+{
+	apol_policy_t *p;
+	unsigned int analyses;
+	/** largest type value within the policy */
+	size_t num_values;
+	/** largest role value within the policy */
+	size_t num_role_values;
+	apol_types_relation_batch_type_t *types;
+	size_t num_types;
+	/** for each type value, 1 + the index of its entry within
+	 *  types, or 0 if the type is not within any pair */
+	size_t *type_slot;
+	/** the policy's users in policy order; the values of user i's
+	 *  roles are user_roles[user_role_first[i], user_role_first[i + 1]) */
+	const qpol_user_t **users;
+	size_t num_users;
+	size_t *user_role_first;
+	uint32_t *user_roles;
+} apol_types_relation_batch_t;
+
+/** The pairs of a batch, shared by every thread computing them. */
+typedef struct apol_types_relation_batch_pairs
+{
+	const apol_types_relation_batch_t *b;
+	/** index within types of each pair's first and other type */
+	const size_t *pair_first, *pair_other;
+	apol_types_relation_result_t **results;
+} apol_types_relation_batch_pairs_t;
+
+static void apol_types_relation_batch_fini(apol_types_relation_batch_t * b)
+{
+	size_t i;
+	for (i = 0; i < b->num_types; i++) {
+		apol_types_relation_batch_type_t *t = b->types + i;
+		apol_vector_destroy(&t->attribs);
+		free(t->covers);
+		apol_vector_destroy(&t->roles);
+		free(t->role_set);
+		apol_vector_destroy(&t->allows);
+		apol_vector_destroy(&t->accesses);
+		apol_vector_destroy(&t->terules);
+		apol_vector_destroy(&t->dirflows);
+		apol_vector_destroy(&t->transflows);
+		apol_vector_destroy(&t->domains);
+	}
+	free(b->types);
+	free(b->type_slot);
+	free(b->users);
+	free(b->user_role_first);
+	free(b->user_roles);
+}
+
+/**
+ * Find the largest type value and the largest role value within the
+ * batch's policy.
+ *
+ * @param b Batch whose num_values and num_role_values to set.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int apol_types_relation_batch_get_num_values(apol_types_relation_batch_t * b)
+{
+	qpol_policy_t *q = b->p->p;
+	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *type;
+	const qpol_role_t *role;
+	uint32_t value;
+	int error = 0;
+
+	if (qpol_policy_get_type_iter(q, &iter) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&type) < 0 || qpol_type_get_value(q, type, &value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (value > b->num_values) {
+			b->num_values = value;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	if (qpol_policy_get_role_iter(q, &iter) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&role) < 0 || qpol_role_get_value(q, role, &value) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (value > b->num_role_values) {
+			b->num_role_values = value;
+		}
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Look up a type named within a pair, giving it an entry within the
+ * batch if it does not yet have one.
+ *
+ * @param b Batch to which to add the type.
+ * @param name Name of the type.
+ * @param side APOL_TYPES_RELATION_BATCH_FIRST or _OTHER.
+ * @param slot Reference to the index of the type's entry.
+ *
+ * @return 0 on success, < 0 on error (including if the type is an
+ * attribute).
+ */
+static int apol_types_relation_batch_add_type(apol_types_relation_batch_t * b, const char *name, unsigned int side,
+					      size_t * slot)
+{
+	const qpol_type_t *type;
+	unsigned char isattr;
+	uint32_t value;
+	apol_types_relation_batch_type_t *t;
+
+	if (name == NULL) {
+		ERR(b->p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (apol_query_get_type(b->p, name, &type) < 0 ||
+	    qpol_type_get_isattr(b->p->p, type, &isattr) < 0 || qpol_type_get_value(b->p->p, type, &value) < 0) {
+		return -1;
+	}
+	if (isattr) {
+		ERR(b->p, "Symbol %s is an attribute.", name);
+		errno = EINVAL;
+		return -1;
+	}
+	if (value == 0 || value > b->num_values) {
+		ERR(b->p, "%s", strerror(ERANGE));
+		errno = ERANGE;
+		return -1;
+	}
+	if (b->type_slot[value] == 0) {
+		t = b->types + b->num_types;
+		t->type = type;
+		t->value = value;
+		if (qpol_type_get_name(b->p->p, type, &t->name) < 0) {
+			return -1;
+		}
+		b->type_slot[value] = ++b->num_types;
+	}
+	*slot = b->type_slot[value] - 1;
+	b->types[*slot].sides |= side;
+	return 0;
+}
+
+/**
+ * Record the attributes of each type within the batch, and if needed
+ * the roles that may use each type.
+ *
+ * @param b Batch whose types to index.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int apol_types_relation_batch_index_types(apol_types_relation_batch_t * b)
+{
+	qpol_policy_t *q = b->p->p;
+	apol_role_query_t *rq = NULL;
+	qpol_iterator_t *iter = NULL;
+	apol_types_relation_batch_type_t *t;
+	const qpol_type_t *attr;
+	const qpol_role_t *role;
+	uint32_t value;
+	size_t i, j;
+	int do_roles = (b->analyses & (APOL_TYPES_RELATION_COMMON_ROLES | APOL_TYPES_RELATION_COMMON_USERS)) != 0;
+	int error = 0;
+
+	if (do_roles && (rq = apol_role_query_create()) == NULL) {
+		error = errno;
+		ERR(b->p, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < b->num_types; i++) {
+		t = b->types + i;
+		if (qpol_type_get_attr_iter(q, t->type, &iter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if ((t->attribs = apol_vector_create_from_iter(iter, NULL)) == NULL ||
+		    (t->covers = calloc(b->num_values + 1, sizeof(*t->covers))) == NULL) {
+			error = errno;
+			ERR(b->p, "%s", strerror(error));
+			goto cleanup;
+		}
+		qpol_iterator_destroy(&iter);
+		t->covers[t->value] = 1;
+		for (j = 0; j < apol_vector_get_size(t->attribs); j++) {
+			attr = apol_vector_get_element(t->attribs, j);
+			if (qpol_type_get_value(q, attr, &value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			t->covers[value] = 1;
+		}
+		if (!do_roles) {
+			continue;
+		}
+		if (apol_role_query_set_type(b->p, rq, t->name) < 0 || apol_role_get_by_query(b->p, rq, &t->roles) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if ((t->role_set = calloc(b->num_role_values + 1, sizeof(*t->role_set))) == NULL) {
+			error = errno;
+			ERR(b->p, "%s", strerror(error));
+			goto cleanup;
+		}
+		for (j = 0; j < apol_vector_get_size(t->roles); j++) {
+			role = apol_vector_get_element(t->roles, j);
+			if (qpol_role_get_value(q, role, &value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			t->role_set[value] = 1;
+		}
+	}
+      cleanup:
+	apol_role_query_destroy(&rq);
+	qpol_iterator_destroy(&iter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Gather, in one pass over each kind of rule, the allow rules and the
+ * type transition and type change rules of every type within the
+ * batch.  Each type receives its rules in the order that a query upon
+ * that type alone would find them.
+ *
+ * @param b Batch whose types' rules to gather.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int apol_types_relation_batch_index_rules(apol_types_relation_batch_t * b)
+{
+	qpol_policy_t *q = b->p->p;
+	qpol_iterator_t *iter = NULL;
+	apol_types_relation_batch_type_t *t;
+	const qpol_type_t *source;
+	const qpol_avrule_t *avrule;
+	const qpol_terule_t *terule;
+	size_t *first = NULL, *slots = NULL, num_slots = 0, i, k;
+	uint32_t value;
+	int do_allows = (b->analyses & (APOL_TYPES_RELATION_SIMILAR_ACCESS | APOL_TYPES_RELATION_DISSIMILAR_ACCESS |
+					APOL_TYPES_RELATION_ALLOW_RULES)) != 0;
+	int do_terules = (b->analyses & APOL_TYPES_RELATION_TYPE_RULES) != 0;
+	int error = 0;
+
+	if (!do_allows && !do_terules) {
+		return 0;
+	}
+	/* index the batch's types by each type or attribute value that
+	 * a rule's source may name to reach them */
+	if ((first = calloc(b->num_values + 2, sizeof(*first))) == NULL) {
+		error = errno;
+		ERR(b->p, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < b->num_types; i++) {
+		t = b->types + i;
+		for (value = 1; value <= b->num_values; value++) {
+			if (t->covers[value]) {
+				first[value + 1]++;
+				num_slots++;
+			}
+		}
+	}
+	for (i = 1; i < b->num_values + 2; i++) {
+		first[i] += first[i - 1];
+	}
+	if (num_slots > 0 && (slots = malloc(num_slots * sizeof(*slots))) == NULL) {
+		error = errno;
+		ERR(b->p, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < b->num_types; i++) {
+		t = b->types + i;
+		for (value = 1; value <= b->num_values; value++) {
+			if (t->covers[value]) {
+				slots[first[value]++] = i;
+			}
+		}
+	}
+	memmove(first + 1, first, (b->num_values + 1) * sizeof(*first));
+	first[0] = 0;
+
+	for (i = 0; i < b->num_types; i++) {
+		t = b->types + i;
+		if ((do_allows && (t->allows = apol_vector_create(NULL)) == NULL) ||
+		    (do_terules && (t->terules = apol_vector_create(NULL)) == NULL)) {
+			error = errno;
+			ERR(b->p, "%s", strerror(error));
+			goto cleanup;
+		}
+	}
+	if (do_allows) {
+		if (qpol_policy_get_avrule_iter(q, QPOL_RULE_ALLOW, &iter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+			if (qpol_iterator_get_item(iter, (void **)&avrule) < 0 ||
+			    qpol_avrule_get_source_type(q, avrule, &source) < 0 || qpol_type_get_value(q, source, &value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			for (k = first[value]; k < first[value + 1]; k++) {
+				if (apol_vector_append(b->types[slots[k]].allows, (void *)avrule) < 0) {
+					error = errno;
+					ERR(b->p, "%s", strerror(error));
+					goto cleanup;
+				}
+			}
+		}
+		qpol_iterator_destroy(&iter);
+	}
+	if (do_terules) {
+		if (qpol_policy_get_terule_iter(q, QPOL_RULE_TYPE_TRANS | QPOL_RULE_TYPE_CHANGE, &iter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+			if (qpol_iterator_get_item(iter, (void **)&terule) < 0 ||
+			    qpol_terule_get_source_type(q, terule, &source) < 0 || qpol_type_get_value(q, source, &value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			for (k = first[value]; k < first[value + 1]; k++) {
+				if (apol_vector_append(b->types[slots[k]].terules, (void *)terule) < 0) {
+					error = errno;
+					ERR(b->p, "%s", strerror(error));
+					goto cleanup;
+				}
+			}
+		}
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	free(first);
+	free(slots);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Build the access pool of each type within the batch from its allow
+ * rules.  The pools are sorted as apol_types_relation_accesses() sorts
+ * them, so that any two may be compared directly.
+ *
+ * @param b Batch whose types' access pools to build.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int apol_types_relation_batch_accesses(apol_types_relation_batch_t * b)
+{
+	qpol_policy_t *q = b->p->p;
+	apol_types_relation_access_t **access_of = NULL, *a;
+	apol_types_relation_batch_type_t *t;
+	apol_vector_t *expanded = NULL;
+	const qpol_avrule_t *rule;
+	const qpol_type_t *target;
+	uint32_t value;
+	size_t i, j, k;
+	int error = 0;
+
+	if ((access_of = calloc(b->num_values + 1, sizeof(*access_of))) == NULL) {
+		error = errno;
+		ERR(b->p, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < b->num_types; i++) {
+		t = b->types + i;
+		if ((t->accesses = apol_vector_create(apol_types_relation_access_free)) == NULL) {
+			error = errno;
+			ERR(b->p, "%s", strerror(error));
+			goto cleanup;
+		}
+		for (j = 0; j < apol_vector_get_size(t->allows); j++) {
+			rule = apol_vector_get_element(t->allows, j);
+			if (qpol_avrule_get_target_type(q, rule, &target) < 0 || (expanded = apol_query_expand_type(b->p, target)) == NULL) {
+				error = errno;
+				goto cleanup;
+			}
+			for (k = 0; k < apol_vector_get_size(expanded); k++) {
+				target = apol_vector_get_element(expanded, k);
+				if (qpol_type_get_value(q, target, &value) < 0) {
+					error = errno;
+					goto cleanup;
+				}
+				if ((a = access_of[value]) == NULL) {
+					if ((a = calloc(1, sizeof(*a))) == NULL ||
+					    (a->rules = apol_vector_create(NULL)) == NULL || apol_vector_append(t->accesses, a) < 0) {
+						error = errno;
+						ERR(b->p, "%s", strerror(error));
+						apol_types_relation_access_free(a);
+						goto cleanup;
+					}
+					a->type = target;
+					access_of[value] = a;
+				}
+				if (apol_vector_append(a->rules, (void *)rule) < 0) {
+					error = errno;
+					ERR(b->p, "%s", strerror(error));
+					goto cleanup;
+				}
+			}
+			apol_vector_destroy(&expanded);
+		}
+		apol_vector_sort(t->accesses, apol_types_relation_access_compfunc2, NULL);
+		for (j = 0; j < apol_vector_get_size(t->accesses); j++) {
+			a = apol_vector_get_element(t->accesses, j);
+			if (qpol_type_get_value(q, a->type, &value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			access_of[value] = NULL;
+		}
+	}
+      cleanup:
+	apol_vector_destroy(&expanded);
+	free(access_of);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Record the values of each user's roles.
+ *
+ * @param b Batch whose users to index.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int apol_types_relation_batch_index_users(apol_types_relation_batch_t * b)
+{
+	qpol_policy_t *q = b->p->p;
+	qpol_iterator_t *iter = NULL, *riter = NULL;
+	const qpol_user_t *user;
+	const qpol_role_t *role;
+	uint32_t value, *tmp;
+	size_t size, num_user_roles = 0, user_roles_cap = 0;
+	int error = 0;
+
+	if (qpol_policy_get_user_iter(q, &iter) < 0 || qpol_iterator_get_size(iter, &size) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	if ((b->users = calloc(size + 1, sizeof(*b->users))) == NULL ||
+	    (b->user_role_first = calloc(size + 1, sizeof(*b->user_role_first))) == NULL) {
+		error = errno;
+		ERR(b->p, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter) && b->num_users < size; qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&user) < 0 || qpol_user_get_role_iter(q, user, &riter) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		for (; !qpol_iterator_end(riter); qpol_iterator_next(riter)) {
+			if (qpol_iterator_get_item(riter, (void **)&role) < 0 || qpol_role_get_value(q, role, &value) < 0) {
+				error = errno;
+				goto cleanup;
+			}
+			if (num_user_roles >= user_roles_cap) {
+				user_roles_cap = (user_roles_cap == 0 ? 64 : user_roles_cap * 2);
+				if ((tmp = realloc(b->user_roles, user_roles_cap * sizeof(*tmp))) == NULL) {
+					error = errno;
+					ERR(b->p, "%s", strerror(error));
+					goto cleanup;
+				}
+				b->user_roles = tmp;
+			}
+			b->user_roles[num_user_roles++] = value;
+		}
+		qpol_iterator_destroy(&riter);
+		b->users[b->num_users++] = user;
+		b->user_role_first[b->num_users] = num_user_roles;
+	}
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	qpol_iterator_destroy(&riter);
+	if (error != 0) {
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Run an information flow analysis from a type.  The first run builds
+ * the graph; later runs reuse it.
+ *
+ * @param p Policy containing types' information.
+ * @param ia Analysis whose mode and direction are set.
+ * @param g Reference to the graph, or to NULL if not yet built.
+ * @param name Name of the type from which to start.
+ * @param v Reference to the results.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int apol_types_relation_batch_infoflow(const apol_policy_t * p, apol_infoflow_analysis_t * ia, apol_infoflow_graph_t ** g,
+					      const char *name, apol_vector_t ** v)
+{
+	if (*g == NULL) {
+		if (apol_infoflow_analysis_set_type(p, ia, name) < 0 || apol_infoflow_analysis_do(p, ia, v, g) < 0) {
+			return -1;
+		}
+		return 0;
+	}
+	return apol_infoflow_analysis_do_more(p, *g, name, v);
+}
+
+/**
+ * Run the information flow and domain transition analyses from each
+ * type within the batch that needs them.  Each kind of flow graph is
+ * built once for the whole batch.
+ *
+ * @param b Batch whose types' flows and transitions to find.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int apol_types_relation_batch_flows(apol_types_relation_batch_t * b)
+{
+	apol_infoflow_analysis_t *direct = NULL, *trans = NULL;
+	apol_infoflow_graph_t *direct_g = NULL, *trans_g = NULL;
+	apol_domain_trans_analysis_t *dta = NULL;
+	apol_types_relation_batch_type_t *t;
+	unsigned int analyses = b->analyses, is_first, is_other;
+	size_t i;
+	int retval = -1;
+
+	if ((analyses & APOL_TYPES_RELATION_DIRECT_FLOW) &&
+	    ((direct = apol_infoflow_analysis_create()) == NULL ||
+	     apol_infoflow_analysis_set_mode(b->p, direct, APOL_INFOFLOW_MODE_DIRECT) < 0 ||
+	     apol_infoflow_analysis_set_dir(b->p, direct, APOL_INFOFLOW_EITHER) < 0)) {
+		goto cleanup;
+	}
+	if ((analyses & (APOL_TYPES_RELATION_TRANS_FLOW_AB | APOL_TYPES_RELATION_TRANS_FLOW_BA)) &&
+	    ((trans = apol_infoflow_analysis_create()) == NULL ||
+	     apol_infoflow_analysis_set_mode(b->p, trans, APOL_INFOFLOW_MODE_TRANS) < 0 ||
+	     apol_infoflow_analysis_set_dir(b->p, trans, APOL_INFOFLOW_OUT) < 0)) {
+		goto cleanup;
+	}
+	if ((analyses & (APOL_TYPES_RELATION_DOMAIN_TRANS_AB | APOL_TYPES_RELATION_DOMAIN_TRANS_BA)) &&
+	    ((dta = apol_domain_trans_analysis_create()) == NULL ||
+	     apol_policy_build_domain_trans_table(b->p) < 0 ||
+	     apol_domain_trans_analysis_set_direction(b->p, dta, APOL_DOMAIN_TRANS_DIRECTION_FORWARD) < 0)) {
+		goto cleanup;
+	}
+
+	for (i = 0; i < b->num_types; i++) {
+		t = b->types + i;
+		is_first = t->sides & APOL_TYPES_RELATION_BATCH_FIRST;
+		is_other = t->sides & APOL_TYPES_RELATION_BATCH_OTHER;
+		if (direct != NULL && is_first &&
+		    apol_types_relation_batch_infoflow(b->p, direct, &direct_g, t->name, &t->dirflows) < 0) {
+			goto cleanup;
+		}
+		if (trans != NULL &&
+		    ((is_first && (analyses & APOL_TYPES_RELATION_TRANS_FLOW_AB)) ||
+		     (is_other && (analyses & APOL_TYPES_RELATION_TRANS_FLOW_BA))) &&
+		    apol_types_relation_batch_infoflow(b->p, trans, &trans_g, t->name, &t->transflows) < 0) {
+			goto cleanup;
+		}
+		if (dta != NULL &&
+		    ((is_first && (analyses & APOL_TYPES_RELATION_DOMAIN_TRANS_AB)) ||
+		     (is_other && (analyses & APOL_TYPES_RELATION_DOMAIN_TRANS_BA)))) {
+			apol_policy_reset_domain_trans_table(b->p);
+			if (apol_domain_trans_analysis_set_start_type(b->p, dta, t->name) < 0 ||
+			    apol_domain_trans_analysis_do(b->p, dta, &t->domains) < 0) {
+				goto cleanup;
+			}
+		}
+	}
+	retval = 0;
+      cleanup:
+	apol_infoflow_analysis_destroy(&direct);
+	apol_infoflow_analysis_destroy(&trans);
+	apol_infoflow_graph_destroy(&direct_g);
+	apol_infoflow_graph_destroy(&trans_g);
+	apol_domain_trans_analysis_destroy(&dta);
+	return retval;
+}
+
+/**
+ * Deep copy to the results vector those infoflow results whose end
+ * type is covered by a bitmap of type values.
+ *
+ * @param p Policy within which to lookup types.
+ * @param v Vector of existing apol_infoflow_result_t, or NULL.
+ * @param covers Type values to match.
+ * @param results Vector to which clone matching infoflow results.
+ *
+ * @return 0 on success, < 0 on error and errno will be set.
+ */
+static int apol_types_relation_batch_clone_infoflow(const apol_policy_t * p, const apol_vector_t * v, const unsigned char *covers,
+						    apol_vector_t * results)
+{
+	apol_infoflow_result_t *res, *new_res;
+	uint32_t value;
+	size_t i;
+	for (i = 0; i < apol_vector_get_size(v); i++) {
+		res = (apol_infoflow_result_t *) apol_vector_get_element(v, i);
+		if (qpol_type_get_value(p->p, apol_infoflow_result_get_end_type(res), &value) < 0) {
+			return -1;
+		}
+		if (covers[value]) {
+			if ((new_res = infoflow_result_create_from_infoflow_result(res)) == NULL ||
+			    apol_vector_append(results, new_res) < 0) {
+				infoflow_result_free(new_res);
+				errno = ENOMEM;
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * Deep copy to the results vector those domain transition results
+ * whose end type is covered by a bitmap of type values.
+ *
+ * @param p Policy within which to lookup types.
+ * @param v Vector of existing apol_domain_trans_result_t, or NULL.
+ * @param covers Type values to match.
+ * @param results Vector to which clone matching domain transition
+ * results.
+ *
+ * @return 0 on success, < 0 on error and errno will be set.
+ */
+static int apol_types_relation_batch_clone_domaintrans(const apol_policy_t * p, const apol_vector_t * v,
+						       const unsigned char *covers, apol_vector_t * results)
+{
+	apol_domain_trans_result_t *res, *new_res;
+	uint32_t value;
+	size_t i;
+	for (i = 0; i < apol_vector_get_size(v); i++) {
+		res = (apol_domain_trans_result_t *) apol_vector_get_element(v, i);
+		if (qpol_type_get_value(p->p, apol_domain_trans_result_get_end_type(res), &value) < 0) {
+			return -1;
+		}
+		if (covers[value]) {
+			if ((new_res = apol_domain_trans_result_create_from_domain_trans_result(res)) == NULL ||
+			    apol_vector_append(results, new_res) < 0) {
+				domain_trans_result_free(new_res);
+				errno = ENOMEM;
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * Append to a vector those allow rules, or type rules, of one type
+ * whose target (or, for type rules, default type) is covered by a
+ * bitmap of type values.
+ *
+ * @param p Policy containing types' information.
+ * @param rules Vector of qpol_avrule_t or qpol_terule_t pointers.
+ * @param is_terule Non-zero if rules holds qpol_terule_t pointers.
+ * @param covers Type values to match.
+ * @param results Vector to which append matching rules.
+ *
+ * @return 0 on success, < 0 on error and errno will be set.
+ */
+static int apol_types_relation_batch_filter_rules(const apol_policy_t * p, const apol_vector_t * rules, int is_terule,
+						  const unsigned char *covers, apol_vector_t * results)
+{
+	const qpol_type_t *target, *default_type;
+	uint32_t value, default_value = 0;
+	void *rule;
+	size_t i;
+	for (i = 0; i < apol_vector_get_size(rules); i++) {
+		rule = apol_vector_get_element(rules, i);
+		if (is_terule) {
+			if (qpol_terule_get_target_type(p->p, rule, &target) < 0 ||
+			    qpol_terule_get_default_type(p->p, rule, &default_type) < 0 ||
+			    qpol_type_get_value(p->p, default_type, &default_value) < 0) {
+				return -1;
+			}
+		} else if (qpol_avrule_get_target_type(p->p, rule, &target) < 0) {
+			return -1;
+		}
+		if (qpol_type_get_value(p->p, target, &value) < 0) {
+			return -1;
+		}
+		if ((covers[value] || covers[default_value]) && apol_vector_append(results, rule) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Compute the result of one pair from what the batch already knows
+ * about both of its types.  Only reads the batch.  This runs upon the
+ * batch's worker threads, where the policy's message callback may not
+ * be called, so neither it nor the helpers it calls report errors;
+ * apol_types_relation_analysis_do_batch() reports the first failure
+ * once all threads have finished.
+ *
+ * @param b Batch containing the pair's types.
+ * @param ta Entry of the pair's first type.
+ * @param tb Entry of the pair's other type.
+ * @param r Result structure to fill.
+ *
+ * @return 0 on success, < 0 on error and errno will be set.
+ */
+static int apol_types_relation_batch_pair(const apol_types_relation_batch_t * b, const apol_types_relation_batch_type_t * ta,
+					  const apol_types_relation_batch_type_t * tb, apol_types_relation_result_t * r)
+{
+	const apol_policy_t *p = b->p;
+	unsigned int analyses = b->analyses;
+	size_t i, k;
+	int inA, inB;
+
+	if ((analyses & APOL_TYPES_RELATION_COMMON_ATTRIBS) &&
+	    (r->attribs = apol_vector_create_from_intersection(ta->attribs, tb->attribs, NULL, NULL)) == NULL) {
+		return -1;
+	}
+	if ((analyses & APOL_TYPES_RELATION_COMMON_ROLES) &&
+	    (r->roles = apol_vector_create_from_intersection(ta->roles, tb->roles, NULL, NULL)) == NULL) {
+		return -1;
+	}
+	if (analyses & APOL_TYPES_RELATION_COMMON_USERS) {
+		if ((r->users = apol_vector_create(NULL)) == NULL) {
+			return -1;
+		}
+		for (i = 0; i < b->num_users; i++) {
+			inA = inB = 0;
+			for (k = b->user_role_first[i]; (!inA || !inB) && k < b->user_role_first[i + 1]; k++) {
+				inA |= ta->role_set[b->user_roles[k]];
+				inB |= tb->role_set[b->user_roles[k]];
+			}
+			if (inA && inB && apol_vector_append(r->users, (void *)b->users[i]) < 0) {
+				errno = ENOMEM;
+				return -1;
+			}
+		}
+	}
+	if ((analyses & (APOL_TYPES_RELATION_SIMILAR_ACCESS | APOL_TYPES_RELATION_DISSIMILAR_ACCESS)) &&
+	    apol_types_relation_compare_accesses(ta->accesses, tb->accesses, analyses & APOL_TYPES_RELATION_SIMILAR_ACCESS,
+						 analyses & APOL_TYPES_RELATION_DISSIMILAR_ACCESS, r) < 0) {
+		return -1;
+	}
+	if (analyses & APOL_TYPES_RELATION_ALLOW_RULES) {
+		if ((r->allows = apol_vector_create(NULL)) == NULL) {
+			return -1;
+		}
+		if (apol_types_relation_batch_filter_rules(p, ta->allows, 0, tb->covers, r->allows) < 0 ||
+		    apol_types_relation_batch_filter_rules(p, tb->allows, 0, ta->covers, r->allows) < 0) {
+			return -1;
+		}
+	}
+	if (analyses & APOL_TYPES_RELATION_TYPE_RULES) {
+		if ((r->types = apol_vector_create(NULL)) == NULL) {
+			return -1;
+		}
+		if (apol_types_relation_batch_filter_rules(p, ta->terules, 1, tb->covers, r->types) < 0 ||
+		    apol_types_relation_batch_filter_rules(p, tb->terules, 1, ta->covers, r->types) < 0) {
+			return -1;
+		}
+	}
+	if (analyses & APOL_TYPES_RELATION_DIRECT_FLOW) {
+		if ((r->dirflows = apol_vector_create(infoflow_result_free)) == NULL) {
+			return -1;
+		}
+		if (apol_types_relation_batch_clone_infoflow(p, ta->dirflows, tb->covers, r->dirflows) < 0) {
+			return -1;
+		}
+	}
+	if (analyses & APOL_TYPES_RELATION_TRANS_FLOW_AB) {
+		if ((r->transAB = apol_vector_create(infoflow_result_free)) == NULL) {
+			return -1;
+		}
+		if (apol_types_relation_batch_clone_infoflow(p, ta->transflows, tb->covers, r->transAB) < 0) {
+			return -1;
+		}
+	}
+	if (analyses & APOL_TYPES_RELATION_TRANS_FLOW_BA) {
+		if ((r->transBA = apol_vector_create(infoflow_result_free)) == NULL) {
+			return -1;
+		}
+		if (apol_types_relation_batch_clone_infoflow(p, tb->transflows, ta->covers, r->transBA) < 0) {
+			return -1;
+		}
+	}
+	if (analyses & APOL_TYPES_RELATION_DOMAIN_TRANS_AB) {
+		if ((r->domsAB = apol_vector_create(domain_trans_result_free)) == NULL) {
+			return -1;
+		}
+		if (apol_types_relation_batch_clone_domaintrans(p, ta->domains, tb->covers, r->domsAB) < 0) {
+			return -1;
+		}
+	}
+	if (analyses & APOL_TYPES_RELATION_DOMAIN_TRANS_BA) {
+		if ((r->domsBA = apol_vector_create(domain_trans_result_free)) == NULL) {
+			return -1;
+		}
+		if (apol_types_relation_batch_clone_domaintrans(p, tb->domains, ta->covers, r->domsBA) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Compute the results of a range of a batch's pairs.
+ */
+static int apol_types_relation_batch_worker(void *arg, size_t first, size_t last)
+{
+	const apol_types_relation_batch_pairs_t *pairs = arg;
+	const apol_types_relation_batch_t *b = pairs->b;
+	size_t i;
+
+	for (i = first; i < last; i++) {
+		if ((pairs->results[i] = calloc(1, sizeof(*pairs->results[i]))) == NULL ||
+		    apol_types_relation_batch_pair(b, b->types + pairs->pair_first[i], b->types + pairs->pair_other[i],
+						   pairs->results[i]) < 0) {
+			return (errno != 0 ? errno : ENOMEM);
+		}
+	}
+	return 0;
+}
+
 /******************** public functions below ********************/
 
 int apol_types_relation_analysis_do(apol_policy_t * p, const apol_types_relation_analysis_t * tr, apol_types_relation_result_t ** r)
@@ -994,6 +1906,82 @@ int apol_types_relation_analysis_do(apol_policy_t * p, const apol_types_relation
 	return retval;
 }
 
+int apol_types_relation_analysis_do_batch(apol_policy_t * p, const apol_types_relation_analysis_t * tr, const char *const *first_types,
+					  const char *const *other_types, size_t num_pairs, apol_types_relation_result_t ** results)
+{
+	apol_types_relation_batch_t b;
+	apol_types_relation_batch_pairs_t pairs;
+	size_t *pair_first = NULL, *pair_other = NULL, max_types, i;
+	int error = 0, retval = -1;
+
+	if (p == NULL || tr == NULL || (num_pairs > 0 && (first_types == NULL || other_types == NULL || results == NULL))) {
+		ERR(p, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if (num_pairs == 0) {
+		return 0;
+	}
+	memset(results, 0, num_pairs * sizeof(*results));
+	memset(&b, 0, sizeof(b));
+	b.p = p;
+	b.analyses = tr->analyses;
+	if (apol_types_relation_batch_get_num_values(&b) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+	max_types = (2 * num_pairs < b.num_values ? 2 * num_pairs : b.num_values);
+	if ((b.type_slot = calloc(b.num_values + 1, sizeof(*b.type_slot))) == NULL ||
+	    (b.types = calloc(max_types + 1, sizeof(*b.types))) == NULL ||
+	    (pair_first = malloc(num_pairs * sizeof(*pair_first))) == NULL ||
+	    (pair_other = malloc(num_pairs * sizeof(*pair_other))) == NULL) {
+		error = errno;
+		ERR(p, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < num_pairs; i++) {
+		if (apol_types_relation_batch_add_type(&b, first_types[i], APOL_TYPES_RELATION_BATCH_FIRST, pair_first + i) < 0 ||
+		    apol_types_relation_batch_add_type(&b, other_types[i], APOL_TYPES_RELATION_BATCH_OTHER, pair_other + i) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+	}
+
+	/* learn everything about each distinct type once; the flow and
+	 * transition analyses change the policy's domain transition
+	 * table and the graphs they reuse, so this part is serial */
+	if (apol_types_relation_batch_index_types(&b) < 0 || apol_types_relation_batch_index_rules(&b) < 0 ||
+	    ((b.analyses & (APOL_TYPES_RELATION_SIMILAR_ACCESS | APOL_TYPES_RELATION_DISSIMILAR_ACCESS)) &&
+	     apol_types_relation_batch_accesses(&b) < 0) ||
+	    ((b.analyses & APOL_TYPES_RELATION_COMMON_USERS) && apol_types_relation_batch_index_users(&b) < 0) ||
+	    apol_types_relation_batch_flows(&b) < 0) {
+		error = errno;
+		goto cleanup;
+	}
+
+	/* pairs then only read what was learned */
+	pairs.b = &b;
+	pairs.pair_first = pair_first;
+	pairs.pair_other = pair_other;
+	pairs.results = results;
+	if ((error = qpol_parallel_run(num_pairs, 1, apol_types_relation_batch_worker, &pairs)) != 0) {
+		ERR(p, "%s", strerror(error));
+		goto cleanup;
+	}
+	retval = 0;
+      cleanup:
+	apol_types_relation_batch_fini(&b);
+	free(pair_first);
+	free(pair_other);
+	if (retval != 0) {
+		for (i = 0; i < num_pairs; i++) {
+			apol_types_relation_result_destroy(results + i);
+		}
+		errno = error;
+	}
+	return retval;
+}
+
 apol_types_relation_analysis_t *apol_types_relation_analysis_create(void)
 {
 	return calloc(1, sizeof(apol_types_relation_analysis_t));
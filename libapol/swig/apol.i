@@ -3461,6 +3461,17 @@ typedef struct apol_relabel_analysis {} apol_relabel_analysis_t;
 	fail:
 		return v;
 	};
+	%newobject run_all_domains(apol_policy_t*);
+	apol_vector_t *run_all_domains(apol_policy_t *p) {
+		apol_vector_t *v;
+		BEGIN_EXCEPTION
+		if (apol_relabel_analysis_do_all_domains(p, self, &v)) {
+			SWIG_exception(SWIG_RuntimeError, "Could not run relabel analysis");
+		}
+		END_EXCEPTION
+	fail:
+		return v;
+	};
 	%rename(set_dir) wrap_set_dir;
 	void wrap_set_dir(apol_policy_t *p, int direction) {
 		BEGIN_EXCEPTION
@@ -3578,6 +3589,33 @@ typedef struct apol_relabel_result_pair {} apol_relabel_result_pair_t;
 		return (apol_relabel_result_pair_t*)x;
 	};
 %}
+typedef struct apol_relabel_domain {} apol_relabel_domain_t;
+%extend apol_relabel_domain_t {
+	apol_relabel_domain() {
+		BEGIN_EXCEPTION
+		SWIG_exception(SWIG_RuntimeError, "Cannot directly create apol_relabel_domain_t objects");
+		END_EXCEPTION
+	fail:
+		return NULL;
+	};
+	~apol_relabel_domain() {
+		/* no op - vector will destroy */
+		return;
+	};
+	%rename(get_domain) wrap_get_domain;
+	const qpol_type_t *wrap_get_domain() {
+		return apol_relabel_domain_get_domain(self);
+	};
+	%rename(get_results) wrap_get_results;
+	const apol_vector_t *wrap_get_results() {
+		return apol_relabel_domain_get_results(self);
+	};
+};
+%inline %{
+	apol_relabel_domain_t *apol_relabel_domain_from_void(void *x) {
+		return (apol_relabel_domain_t*)x;
+	};
+%}
 
 /* apol type relation analysis */
 #define APOL_TYPES_RELATION_COMMON_ATTRIBS 0x0001
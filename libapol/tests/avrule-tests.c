@@ -26,14 +26,24 @@
 #include <config.h>
 
 #include <CUnit/CUnit.h>
+#include <apol/av-engine.h>
+#include <apol/avrule-index.h>
 #include <apol/avrule-query.h>
+#include <apol/cond-whatif.h>
+#include <apol/policy-query.h>
 #include <apol/policy.h>
 #include <apol/policy-path.h>
+#include <qpol/avrule_query.h>
+#include <qpol/bool_query.h>
+#include <qpol/iterator.h>
 #include <qpol/policy_extend.h>
+#include <qpol/syn_rule_query.h>
+#include <qpol/terule_query.h>
 #include <stdbool.h>
 
 #define BIN_POLICY TEST_POLICIES "/setools-3.3/rules/rules-mls.21"
 #define SOURCE_POLICY TEST_POLICIES "/setools-3.3/rules/rules-mls.conf"
+#define BIG_POLICY TEST_POLICIES "/snapshots/fc4_targeted.policy.conf"
 
 static apol_policy_t *bp = NULL;
 static apol_policy_t *sp = NULL;
@@ -114,11 +124,638 @@ static void avrule_default(void)
 	apol_avrule_query_destroy(&aq);
 }
 
+static void avrule_index(void)
+{
+	apol_avrule_query_t *aq = apol_avrule_query_create();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(aq);
+
+	int retval;
+	qpol_policy_t *bq = apol_policy_get_qpol(bp);
+
+	apol_vector_t *v = NULL;
+	retval = apol_avrule_get_by_query(bp, aq, &v);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+
+	apol_avrule_index_t *idx = apol_avrule_index_create(bp,
+							    QPOL_RULE_ALLOW | QPOL_RULE_NEVERALLOW | QPOL_RULE_AUDITALLOW |
+							    QPOL_RULE_DONTAUDIT);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(idx);
+	CU_ASSERT(apol_avrule_index_get_size(idx) == apol_vector_get_size(v));
+
+	/* every rule must be found when looking up its own source,
+	 * target, and class */
+	size_t i, j;
+	for (i = 0; i < apol_vector_get_size(v); i++) {
+		const qpol_avrule_t *rule = apol_vector_get_element(v, i);
+		const qpol_type_t *source, *target;
+		const qpol_class_t *obj_class;
+		retval = qpol_avrule_get_source_type(bq, rule, &source);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		retval = qpol_avrule_get_target_type(bq, rule, &target);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		retval = qpol_avrule_get_object_class(bq, rule, &obj_class);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+
+		apol_vector_t *found = apol_vector_create(NULL);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(found);
+		retval = apol_avrule_index_get_rules(idx, source, target, obj_class, NULL, found);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		CU_ASSERT(apol_vector_get_index(found, rule, NULL, NULL, &j) == 0);
+		apol_vector_destroy(&found);
+
+		found = apol_vector_create(NULL);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(found);
+		retval = apol_avrule_index_get_rules(idx, source, target, obj_class, "no such permission", found);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		CU_ASSERT(apol_vector_get_size(found) == 0);
+		apol_vector_destroy(&found);
+	}
+
+	apol_avrule_index_destroy(&idx);
+	CU_ASSERT_PTR_NULL(idx);
+	apol_vector_destroy(&v);
+	apol_avrule_query_destroy(&aq);
+}
+
+static int avrule_batch_collect(void *arg, const apol_policy_t * p __attribute__ ((unused)), size_t query_id,
+				const qpol_avrule_t * rule)
+{
+	apol_vector_t **results = arg;
+	return apol_vector_append(results[query_id], (void *)rule);
+}
+
+static void avrule_batch(void)
+{
+	int retval;
+	size_t i, j;
+	qpol_policy_t *bq = apol_policy_get_qpol(bp);
+	apol_vector_t *v = NULL;
+
+	/* build queries from the first rule's own source, class, and
+	 * permission, so that each has something to find */
+	retval = apol_avrule_get_by_query(bp, NULL, &v);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	CU_ASSERT_FATAL(apol_vector_get_size(v) > 0);
+	const qpol_avrule_t *rule = apol_vector_get_element(v, 0);
+	const qpol_type_t *source;
+	const qpol_class_t *obj_class;
+	const char *source_name, *class_name;
+	char *perm_name;
+	qpol_iterator_t *iter = NULL;
+	retval = qpol_avrule_get_source_type(bq, rule, &source);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	retval = qpol_type_get_name(bq, source, &source_name);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	retval = qpol_avrule_get_object_class(bq, rule, &obj_class);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	retval = qpol_class_get_name(bq, obj_class, &class_name);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	retval = qpol_avrule_get_perm_iter(bq, rule, &iter);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	retval = qpol_iterator_get_item(iter, (void **)&perm_name);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	qpol_iterator_destroy(&iter);
+	apol_vector_destroy(&v);
+
+#define NUM_BATCH_QUERIES 5
+	apol_avrule_query_t *aq[NUM_BATCH_QUERIES];
+	for (i = 0; i < NUM_BATCH_QUERIES; i++) {
+		aq[i] = apol_avrule_query_create();
+		CU_ASSERT_PTR_NOT_NULL_FATAL(aq[i]);
+	}
+	apol_avrule_query_set_source(bp, aq[1], source_name, 1);
+	apol_avrule_query_set_source(bp, aq[2], source_name, 1);
+	apol_avrule_query_append_class(bp, aq[2], class_name);
+	apol_avrule_query_set_rules(bp, aq[3], QPOL_RULE_ALLOW);
+	apol_avrule_query_append_perm(bp, aq[3], perm_name);
+	apol_avrule_query_set_source(bp, aq[4], source_name, 0);
+	apol_avrule_query_set_source_component(bp, aq[4], APOL_QUERY_SYMBOL_IS_TYPE | APOL_QUERY_SYMBOL_IS_ATTRIBUTE);
+	apol_avrule_query_set_source_any(bp, aq[4], 1);
+	free(perm_name);
+
+	apol_avrule_batch_t *b = apol_avrule_batch_create(bp);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(b);
+	apol_vector_t *results[NUM_BATCH_QUERIES];
+	for (i = 0; i < NUM_BATCH_QUERIES; i++) {
+		retval = apol_avrule_batch_append(b, aq[i]);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		results[i] = apol_vector_create(NULL);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(results[i]);
+	}
+	CU_ASSERT(apol_avrule_batch_get_size(b) == NUM_BATCH_QUERIES);
+	retval = apol_avrule_batch_run(b, avrule_batch_collect, results);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+
+	/* each query's batched results must be exactly what the query
+	 * finds on its own, in the same order */
+	for (i = 0; i < NUM_BATCH_QUERIES; i++) {
+		retval = apol_avrule_get_by_query(bp, aq[i], &v);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		CU_ASSERT(apol_vector_get_size(v) > 0);
+		CU_ASSERT(apol_vector_compare(v, results[i], NULL, NULL, &j) == 0);
+		apol_vector_destroy(&v);
+		apol_vector_destroy(&results[i]);
+		apol_avrule_query_destroy(&aq[i]);
+	}
+	apol_avrule_batch_destroy(&b);
+	CU_ASSERT_PTR_NULL(b);
+}
+
+/**
+ * Get the line numbers of an av rule's syntactic rules, in the order
+ * returned by qpol_avrule_get_syn_avrule_iter().
+ */
+static apol_vector_t *avrule_syn_linenos(const qpol_policy_t * q, const qpol_avrule_t * rule)
+{
+	qpol_iterator_t *iter = NULL;
+	apol_vector_t *v = apol_vector_create(NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+	int retval = qpol_avrule_get_syn_avrule_iter(q, rule, &iter);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		qpol_syn_avrule_t *syn;
+		unsigned long lineno;
+		retval = qpol_iterator_get_item(iter, (void **)&syn);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		retval = qpol_syn_avrule_get_lineno(q, syn, &lineno);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		retval = apol_vector_append(v, (void *)lineno);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+	}
+	qpol_iterator_destroy(&iter);
+	return v;
+}
+
+static void avrule_lazy_syn(void)
+{
+	apol_policy_path_t *ppath = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, SOURCE_POLICY, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ppath);
+	apol_policy_t *lp = apol_policy_create_from_policy_path(ppath, 0, NULL, NULL);
+	apol_policy_path_destroy(&ppath);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(lp);
+	qpol_policy_t *sq = apol_policy_get_qpol(sp), *lq = apol_policy_get_qpol(lp);
+	int retval = qpol_policy_build_syn_rule_index(lq);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+
+	/* both policies were read from the same file, so their rules
+	 * come in the same order; each rule must trace back to the
+	 * same syntactic rules, whether found through the table or
+	 * through the index */
+	qpol_iterator_t *siter = NULL, *liter = NULL;
+	uint32_t mask = QPOL_RULE_ALLOW | QPOL_RULE_NEVERALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT;
+	retval = qpol_policy_get_avrule_iter(sq, mask, &siter);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	retval = qpol_policy_get_avrule_iter(lq, mask, &liter);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	size_t num_rules = 0, i;
+	for (; !qpol_iterator_end(siter) && !qpol_iterator_end(liter); qpol_iterator_next(siter), qpol_iterator_next(liter)) {
+		qpol_avrule_t *srule, *lrule;
+		retval = qpol_iterator_get_item(siter, (void **)&srule);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		retval = qpol_iterator_get_item(liter, (void **)&lrule);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		apol_vector_t *sv = avrule_syn_linenos(sq, srule);
+		apol_vector_t *lv = avrule_syn_linenos(lq, lrule);
+		CU_ASSERT(apol_vector_get_size(lv) > 0);
+		CU_ASSERT(apol_vector_compare(sv, lv, NULL, NULL, &i) == 0);
+		apol_vector_destroy(&sv);
+		apol_vector_destroy(&lv);
+		/* a second lookup is answered from the cache */
+		lv = avrule_syn_linenos(lq, lrule);
+		CU_ASSERT(apol_vector_get_size(lv) > 0);
+		apol_vector_destroy(&lv);
+		num_rules++;
+	}
+	CU_ASSERT(qpol_iterator_end(siter) && qpol_iterator_end(liter));
+	CU_ASSERT(num_rules > 0);
+	qpol_iterator_destroy(&siter);
+	qpol_iterator_destroy(&liter);
+	apol_policy_destroy(&lp);
+}
+
+#define AV_ENGINE_TYPES 8
+
+/* Build a context for each of the first few types, with the first
+ * user, its first role, and its range. */
+static size_t avrule_engine_contexts(apol_policy_t * p, apol_constraint_eval_t * ce, const char **types)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(p);
+	qpol_iterator_t *iter = NULL;
+	const qpol_user_t *user;
+	const qpol_role_t *role;
+	const qpol_type_t *type;
+	const qpol_mls_range_t *qrange;
+	const char *user_name, *role_name;
+	unsigned char isattr, isalias;
+	size_t n = 0;
+
+	CU_ASSERT_FATAL(qpol_policy_get_user_iter(q, &iter) == 0);
+	CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&user) == 0);
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT_FATAL(qpol_user_get_name(q, user, &user_name) == 0);
+	CU_ASSERT_FATAL(qpol_user_get_role_iter(q, user, &iter) == 0);
+	CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&role) == 0);
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT_FATAL(qpol_role_get_name(q, role, &role_name) == 0);
+	CU_ASSERT_FATAL(qpol_user_get_range(q, user, &qrange) == 0);
+
+	CU_ASSERT_FATAL(qpol_policy_get_type_iter(q, &iter) == 0);
+	for (; n < AV_ENGINE_TYPES && !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		apol_context_t *c;
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&type) == 0);
+		CU_ASSERT_FATAL(qpol_type_get_isattr(q, type, &isattr) == 0);
+		CU_ASSERT_FATAL(qpol_type_get_isalias(q, type, &isalias) == 0);
+		if (isattr || isalias) {
+			continue;
+		}
+		CU_ASSERT_FATAL(qpol_type_get_name(q, type, &types[n]) == 0);
+		c = apol_context_create();
+		CU_ASSERT_PTR_NOT_NULL_FATAL(c);
+		CU_ASSERT_FATAL(apol_context_set_user(p, c, user_name) == 0);
+		CU_ASSERT_FATAL(apol_context_set_role(p, c, role_name) == 0);
+		CU_ASSERT_FATAL(apol_context_set_type(p, c, types[n]) == 0);
+		CU_ASSERT_FATAL(apol_context_set_range(p, c, apol_mls_range_create_from_qpol_mls_range(p, qrange)) == 0);
+		CU_ASSERT_FATAL(apol_constraint_eval_append_context(ce, c) == 0);
+		apol_context_destroy(&c);
+		n++;
+	}
+	qpol_iterator_destroy(&iter);
+	return n;
+}
+
+/** Number of booleans toggled while checking the engine. */
+#define AV_ENGINE_BOOLS 3
+
+/*
+ * Gather the permissions of the enabled rules of one type between
+ * two types, by class index.
+ */
+static void avrule_engine_expected(apol_constraint_eval_t * ce, unsigned int rule_type, const char *source, const char *target,
+				   uint32_t * expected, size_t num_classes)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(bp);
+	apol_avrule_query_t *query;
+	apol_vector_t *v = NULL;
+	qpol_iterator_t *iter = NULL;
+	uint32_t bit;
+	size_t k, class_index;
+
+	query = apol_avrule_query_create();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(query);
+	apol_avrule_query_set_rules(bp, query, rule_type);
+	apol_avrule_query_set_source(bp, query, source, 1);
+	apol_avrule_query_set_target(bp, query, target, 1);
+	apol_avrule_query_set_enabled(bp, query, 1);
+	CU_ASSERT_FATAL(apol_avrule_get_by_query(bp, query, &v) == 0);
+	apol_avrule_query_destroy(&query);
+
+	memset(expected, 0, num_classes * sizeof(*expected));
+	for (k = 0; k < apol_vector_get_size(v); k++) {
+		const qpol_avrule_t *rule = apol_vector_get_element(v, k);
+		const qpol_class_t *obj_class;
+		const char *class_name;
+		char *perm;
+		CU_ASSERT_FATAL(qpol_avrule_get_object_class(q, rule, &obj_class) == 0);
+		CU_ASSERT_FATAL(qpol_class_get_name(q, obj_class, &class_name) == 0);
+		CU_ASSERT_FATAL(qpol_avrule_get_perm_iter(q, rule, &iter) == 0);
+		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+			CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&perm) == 0);
+			CU_ASSERT_FATAL(apol_constraint_eval_get_perm(ce, class_name, perm, &class_index, &bit) == 0);
+			expected[class_index] |= bit;
+			free(perm);
+		}
+		qpol_iterator_destroy(&iter);
+	}
+	apol_vector_destroy(&v);
+}
+
+/*
+ * The engine's answers should agree with semantic queries for the
+ * enabled rules between each pair of types: the allow rules less
+ * whatever the constraints deny, the auditallow rules, and the
+ * dontaudit rules.
+ */
+static void avrule_engine_check(apol_av_engine_t * e, const char **types, size_t n, size_t num_classes)
+{
+	apol_constraint_eval_t *ce = apol_av_engine_get_constraint_eval(e);
+	apol_av_decision_t avd;
+	apol_constraint_eval_request_t r;
+	uint32_t *allowed, *auditallow, *dontaudit, denied;
+	size_t i, j, k;
+
+	allowed = calloc(num_classes, sizeof(*allowed));
+	auditallow = calloc(num_classes, sizeof(*auditallow));
+	dontaudit = calloc(num_classes, sizeof(*dontaudit));
+	CU_ASSERT_FATAL(allowed != NULL && auditallow != NULL && dontaudit != NULL);
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < n; j++) {
+			avrule_engine_expected(ce, QPOL_RULE_ALLOW, types[i], types[j], allowed, num_classes);
+			avrule_engine_expected(ce, QPOL_RULE_AUDITALLOW, types[i], types[j], auditallow, num_classes);
+			avrule_engine_expected(ce, QPOL_RULE_DONTAUDIT, types[i], types[j], dontaudit, num_classes);
+			for (k = 0; k < num_classes; k++) {
+				CU_ASSERT_FATAL(apol_av_engine_compute(e, i, j, k, &avd) == 0);
+				CU_ASSERT_EQUAL(avd.allowed | avd.constrained, allowed[k]);
+				CU_ASSERT_EQUAL(avd.allowed & avd.constrained, 0);
+				CU_ASSERT_EQUAL(avd.auditallow, auditallow[k]);
+				CU_ASSERT_EQUAL(avd.auditdeny, ~dontaudit[k]);
+				r.scontext = i;
+				r.tcontext = j;
+				r.class_index = k;
+				r.perms = allowed[k];
+				CU_ASSERT_FATAL(apol_constraint_eval_check(ce, &r, 1, &denied) == 0);
+				CU_ASSERT_EQUAL(avd.constrained, denied);
+			}
+		}
+	}
+	free(allowed);
+	free(auditallow);
+	free(dontaudit);
+}
+
+static void avrule_engine(void)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(bp);
+	apol_av_engine_t *e = apol_av_engine_create(bp, 1024);
+	apol_constraint_eval_t *ce;
+	apol_av_decision_t avd, cached;
+	qpol_iterator_t *iter = NULL;
+	qpol_bool_t *b;
+	const char *types[AV_ENGINE_TYPES];
+	int state;
+	size_t n, i, num_classes, hits, misses;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(e);
+	ce = apol_av_engine_get_constraint_eval(e);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ce);
+	n = avrule_engine_contexts(bp, ce, types);
+	CU_ASSERT_FATAL(n > 0);
+	CU_ASSERT_FATAL(qpol_policy_get_class_iter(q, &iter) == 0);
+	CU_ASSERT_FATAL(qpol_iterator_get_size(iter, &num_classes) == 0);
+	qpol_iterator_destroy(&iter);
+
+	avrule_engine_check(e, types, n, num_classes);
+
+	/* the second computation of a tuple comes from the cache */
+	apol_av_engine_get_cache_stats(e, &hits, &misses);
+	CU_ASSERT_EQUAL(hits, 0);
+	CU_ASSERT_EQUAL(misses, n * n * num_classes);
+	CU_ASSERT_FATAL(apol_av_engine_compute(e, 0, 0, 0, &avd) == 0);
+	CU_ASSERT_FATAL(apol_av_engine_compute(e, 0, 0, 0, &cached) == 0);
+	CU_ASSERT(memcmp(&avd, &cached, sizeof(avd)) == 0);
+	apol_av_engine_get_cache_stats(e, &hits, NULL);
+	CU_ASSERT(hits >= 1);
+	CU_ASSERT(apol_av_engine_compute(e, n, 0, 0, &avd) < 0);
+
+	/* after a boolean changes, refreshed answers follow the rules
+	 * that are now enabled */
+	CU_ASSERT_FATAL(qpol_policy_get_bool_iter(q, &iter) == 0);
+	for (i = 0; i < AV_ENGINE_BOOLS && !qpol_iterator_end(iter); qpol_iterator_next(iter), i++) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&b) == 0);
+		CU_ASSERT_FATAL(qpol_bool_get_state(q, b, &state) == 0);
+		CU_ASSERT_FATAL(qpol_bool_set_state(q, b, !state) == 0);
+		CU_ASSERT_FATAL(apol_av_engine_refresh_conds(e) == 0);
+		avrule_engine_check(e, types, n, num_classes);
+		CU_ASSERT_FATAL(qpol_bool_set_state(q, b, state) == 0);
+		CU_ASSERT_FATAL(apol_av_engine_refresh_conds(e) == 0);
+	}
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT(i > 0);
+	avrule_engine_check(e, types, n, num_classes);
+
+	apol_av_engine_destroy(&e);
+	CU_ASSERT_PTR_NULL(e);
+}
+
+/** Number of booleans whose every combination is tried. */
+#define WHATIF_BOOLS 4
+
+/**
+ * Get whether each access vector rule (or type rule, if te is
+ * non-zero) is enabled, in iteration order.
+ */
+static uint32_t *avrule_whatif_enabled(qpol_policy_t * q, int te, size_t * n)
+{
+	qpol_iterator_t *iter = NULL;
+	uint32_t *enabled;
+	void *rule;
+	size_t i;
+
+	if (te) {
+		CU_ASSERT_FATAL(qpol_policy_get_terule_iter
+				(q, QPOL_RULE_TYPE_TRANS | QPOL_RULE_TYPE_CHANGE | QPOL_RULE_TYPE_MEMBER, &iter) == 0);
+	} else {
+		CU_ASSERT_FATAL(qpol_policy_get_avrule_iter(q, QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT, &iter)
+				== 0);
+	}
+	CU_ASSERT_FATAL(qpol_iterator_get_size(iter, n) == 0);
+	enabled = calloc(*n + 1, sizeof(*enabled));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(enabled);
+	for (i = 0; !qpol_iterator_end(iter); qpol_iterator_next(iter), i++) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, &rule) == 0);
+		if (te) {
+			CU_ASSERT_FATAL(qpol_terule_get_is_enabled(q, rule, enabled + i) == 0);
+		} else {
+			CU_ASSERT_FATAL(qpol_avrule_get_is_enabled(q, rule, enabled + i) == 0);
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	return enabled;
+}
+
+/**
+ * Set the policy's booleans to an assignment and reevaluate its
+ * conditionals.
+ */
+static void avrule_whatif_set(qpol_policy_t * q, const unsigned char *states)
+{
+	qpol_iterator_t *iter = NULL;
+	qpol_bool_t *b;
+	uint32_t value;
+
+	CU_ASSERT_FATAL(qpol_policy_get_bool_iter(q, &iter) == 0);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&b) == 0);
+		CU_ASSERT_FATAL(qpol_bool_get_value(q, b, &value) == 0);
+		CU_ASSERT_FATAL(qpol_bool_set_state_no_eval(q, b, states[value - 1]) == 0);
+	}
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT_FATAL(qpol_policy_reevaluate_conds(q) == 0);
+}
+
+/**
+ * Check that a delta holds exactly the rules whose state changed.
+ */
+static void avrule_whatif_check(qpol_policy_t * q, int te, const uint32_t * before, const apol_vector_t * enabled,
+				const apol_vector_t * disabled)
+{
+	uint32_t *after, is_enabled;
+	size_t n, i, num_enabled = 0, num_disabled = 0;
+
+	after = avrule_whatif_enabled(q, te, &n);
+	for (i = 0; i < n; i++) {
+		if (after[i] && !before[i]) {
+			num_enabled++;
+		} else if (!after[i] && before[i]) {
+			num_disabled++;
+		}
+	}
+	free(after);
+	CU_ASSERT_EQUAL(apol_vector_get_size(enabled), num_enabled);
+	CU_ASSERT_EQUAL(apol_vector_get_size(disabled), num_disabled);
+	for (i = 0; i < apol_vector_get_size(enabled); i++) {
+		void *rule = apol_vector_get_element(enabled, i);
+		CU_ASSERT_FATAL((te ? qpol_terule_get_is_enabled(q, rule, &is_enabled) :
+				 qpol_avrule_get_is_enabled(q, rule, &is_enabled)) == 0);
+		CU_ASSERT(is_enabled);
+	}
+	for (i = 0; i < apol_vector_get_size(disabled); i++) {
+		void *rule = apol_vector_get_element(disabled, i);
+		CU_ASSERT_FATAL((te ? qpol_terule_get_is_enabled(q, rule, &is_enabled) :
+				 qpol_avrule_get_is_enabled(q, rule, &is_enabled)) == 0);
+		CU_ASSERT(!is_enabled);
+	}
+}
+
+static void avrule_whatif(void)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(bp);
+	apol_cond_index_t *idx = apol_cond_index_create(bp);
+	apol_cond_delta_t **deltas, *delta;
+	unsigned char *states;
+	uint32_t *av_before, *te_before;
+	size_t num_bools, num_flipped, num_assignments, n, i, j;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(idx);
+	num_bools = apol_cond_index_get_num_bools(idx);
+	num_flipped = (num_bools < WHATIF_BOOLS ? num_bools : WHATIF_BOOLS);
+	num_assignments = (size_t) 1 << num_flipped;
+	states = calloc(num_assignments * num_bools + 1, sizeof(*states));
+	deltas = calloc(num_assignments, sizeof(*deltas));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(states);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(deltas);
+
+	/* assignment i flips those of the first booleans named by the
+	 * bits of i; assignment 0 is the baseline */
+	for (i = 0; i < num_assignments; i++) {
+		CU_ASSERT_FATAL(apol_cond_index_get_baseline(idx, states + i * num_bools) == 0);
+		for (j = 0; j < num_flipped; j++) {
+			if (i & ((size_t) 1 << j)) {
+				states[i * num_bools + j] ^= 1;
+			}
+		}
+	}
+	CU_ASSERT_FATAL(apol_cond_index_whatif_batch(idx, states, num_assignments, deltas) == 0);
+	CU_ASSERT_EQUAL(apol_vector_get_size(deltas[0]->avrules_enabled), 0);
+	CU_ASSERT_EQUAL(apol_vector_get_size(deltas[0]->avrules_disabled), 0);
+	CU_ASSERT_EQUAL(apol_vector_get_size(deltas[0]->terules_enabled), 0);
+	CU_ASSERT_EQUAL(apol_vector_get_size(deltas[0]->terules_disabled), 0);
+
+	/* a single query gives the same answer as the batch */
+	delta = apol_cond_index_whatif(idx, states + (num_assignments - 1) * num_bools);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(delta);
+	CU_ASSERT(apol_vector_compare(delta->avrules_enabled, deltas[num_assignments - 1]->avrules_enabled, NULL, NULL, &i)
+		  == 0);
+	CU_ASSERT(apol_vector_compare(delta->terules_disabled, deltas[num_assignments - 1]->terules_disabled, NULL, NULL, &i)
+		  == 0);
+	apol_cond_delta_destroy(&delta);
+	CU_ASSERT_PTR_NULL(delta);
+
+	/* the index did not change the policy, so the policy's rules
+	 * are still in their baseline states; compare each delta with
+	 * what reevaluating the policy itself gives */
+	av_before = avrule_whatif_enabled(q, 0, &n);
+	te_before = avrule_whatif_enabled(q, 1, &n);
+	for (i = 0; i < num_assignments; i++) {
+		avrule_whatif_set(q, states + i * num_bools);
+		avrule_whatif_check(q, 0, av_before, deltas[i]->avrules_enabled, deltas[i]->avrules_disabled);
+		avrule_whatif_check(q, 1, te_before, deltas[i]->terules_enabled, deltas[i]->terules_disabled);
+		apol_cond_delta_destroy(deltas + i);
+	}
+	avrule_whatif_set(q, states);
+
+	free(av_before);
+	free(te_before);
+	free(deltas);
+	free(states);
+	apol_cond_index_destroy(&idx);
+	CU_ASSERT_PTR_NULL(idx);
+}
+
+static void avrule_lazy_syn_grow(void)
+{
+	apol_policy_path_t *ppath = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, BIG_POLICY, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ppath);
+	apol_policy_t *lp = apol_policy_create_from_policy_path(ppath, 0, NULL, NULL);
+	apol_policy_path_destroy(&ppath);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(lp);
+	qpol_policy_t *lq = apol_policy_get_qpol(lp);
+	int retval = qpol_policy_build_syn_rule_index(lq);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+
+	/* keep a traceback iterator open for every rule, so that the
+	 * lookups for later rules grow the table many times over while
+	 * the earlier iterators are still in use */
+	apol_vector_t *iters = apol_vector_create(NULL), *sizes = apol_vector_create(NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(iters);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(sizes);
+	qpol_iterator_t *riter = NULL, *iter;
+	retval = qpol_policy_get_avrule_iter(lq, QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT, &riter);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	for (; !qpol_iterator_end(riter); qpol_iterator_next(riter)) {
+		qpol_avrule_t *rule;
+		size_t size;
+		retval = qpol_iterator_get_item(riter, (void **)&rule);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		retval = qpol_avrule_get_syn_avrule_iter(lq, rule, &iter);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		retval = qpol_iterator_get_size(iter, &size);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		retval = apol_vector_append(iters, iter);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		retval = apol_vector_append(sizes, (void *)size);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+	}
+	qpol_iterator_destroy(&riter);
+	/* the table starts with 4096 slots */
+	CU_ASSERT_FATAL(apol_vector_get_size(iters) > 4096);
+
+	/* each iterator, the first especially, must still report its
+	 * size and walk the same number of rules */
+	size_t i;
+	for (i = 0; i < apol_vector_get_size(iters); i++) {
+		size_t size = 0, count = 0;
+		iter = apol_vector_get_element(iters, i);
+		retval = qpol_iterator_get_size(iter, &size);
+		CU_ASSERT_EQUAL(retval, 0);
+		CU_ASSERT_EQUAL(size, (size_t) apol_vector_get_element(sizes, i));
+		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter))
+			count++;
+		CU_ASSERT_EQUAL(count, size);
+		qpol_iterator_destroy(&iter);
+	}
+	apol_vector_destroy(&iters);
+	apol_vector_destroy(&sizes);
+	apol_policy_destroy(&lp);
+}
+
 CU_TestInfo avrule_tests[] = {
 	{"basic syntactic search", avrule_basic_syn}
 	,
 	{"default query", avrule_default}
 	,
+	{"rule index", avrule_index}
+	,
+	{"batched queries", avrule_batch}
+	,
+	{"syntactic rules on demand", avrule_lazy_syn}
+	,
+	{"syntactic rule iterators across table growth", avrule_lazy_syn_grow}
+	,
+	{"access vector engine", avrule_engine}
+	,
+	{"boolean what-if", avrule_whatif}
+	,
 	CU_TEST_INFO_NULL
 };
 
@@ -31,6 +31,8 @@
 #include <stdbool.h>
 #include <string.h>
 #include <apol/constraint-query.h>
+#include <apol/constraint-eval.h>
+#include <apol/policy-query.h>
 #include <sepol/policydb/policydb.h>
 #include <sepol/policydb/constraint.h>
 #include <libqpol/src/queue.h>
@@ -476,6 +478,388 @@ static void constrain_binary(void)
 }
 
 
+/*
+ * The compiled evaluator is checked against a direct interpretation
+ * of each expression, which compares names rather than values and
+ * uses apol_mls_level_compare() for levels.
+ */
+
+#define EVAL_MAX_USERS 3
+#define EVAL_MAX_ROLES 2
+#define EVAL_MAX_TYPES 4
+#define EVAL_MAX_CONTEXTS (EVAL_MAX_USERS * EVAL_MAX_ROLES * (EVAL_MAX_TYPES + 2) * 2)
+#define EVAL_VTRANS_CONTEXTS 8
+
+/* Return non-zero if a type is the named type or a member of the
+ * named attribute. */
+static int eval_type_match(apol_policy_t * ap, const char *type, const char *name)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(ap);
+	const qpol_type_t *t;
+	qpol_iterator_t *iter = NULL;
+	unsigned char isattr;
+	const char *member;
+	int found = 0;
+	if (strcmp(type, name) == 0) {
+		return 1;
+	}
+	CU_ASSERT_FATAL(qpol_policy_get_type_by_name(q, name, &t) == 0);
+	CU_ASSERT_FATAL(qpol_type_get_isattr(q, t, &isattr) == 0);
+	if (!isattr) {
+		return 0;
+	}
+	CU_ASSERT_FATAL(qpol_type_get_type_iter(q, t, &iter) == 0);
+	for (; !found && !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&t) == 0);
+		CU_ASSERT_FATAL(qpol_type_get_name(q, t, &member) == 0);
+		found = (strcmp(member, type) == 0);
+	}
+	qpol_iterator_destroy(&iter);
+	return found;
+}
+
+/* Return non-zero if role r1 dominates role r2. */
+static int eval_role_dom(apol_policy_t * ap, const char *r1, const char *r2)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(ap);
+	const qpol_role_t *role;
+	qpol_iterator_t *iter = NULL;
+	const char *name;
+	int found = 0;
+	if (strcmp(r1, r2) == 0) {
+		return 1;
+	}
+	CU_ASSERT_FATAL(qpol_policy_get_role_by_name(q, r1, &role) == 0);
+	CU_ASSERT_FATAL(qpol_role_get_dominate_iter(q, role, &iter) == 0);
+	for (; !found && !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&role) == 0);
+		CU_ASSERT_FATAL(qpol_role_get_name(q, role, &name) == 0);
+		found = (strcmp(name, r2) == 0);
+	}
+	qpol_iterator_destroy(&iter);
+	return found;
+}
+
+/* Included names are returned before subtracted ones. */
+static int eval_names(apol_policy_t * ap, const qpol_constraint_expr_node_t * node, uint32_t sym, const char *value)
+{
+	qpol_iterator_t *iter = NULL;
+	char *name;
+	int s = 0;
+	CU_ASSERT_FATAL(qpol_constraint_expr_node_get_names_iter(apol_policy_get_qpol(ap), node, &iter) == 0);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&name) == 0);
+		if (sym != QPOL_CEXPR_SYM_TYPE) {
+			s |= (strcmp(name, value) == 0);
+		} else if (name[0] == '-') {
+			s &= !eval_type_match(ap, value, name + 1);
+		} else {
+			s |= eval_type_match(ap, value, name);
+		}
+		free(name);
+	}
+	qpol_iterator_destroy(&iter);
+	return s;
+}
+
+static const apol_mls_level_t *eval_level(const apol_context_t * c, int high)
+{
+	const apol_mls_range_t *range = apol_context_get_range(c);
+	if (high && apol_mls_range_get_high(range) != NULL) {
+		return apol_mls_range_get_high(range);
+	}
+	return apol_mls_range_get_low(range);
+}
+
+static int eval_expr(apol_policy_t * ap, qpol_iterator_t * expr_iter, apol_context_t ** ctx)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(ap);
+	const qpol_constraint_expr_node_t *node;
+	uint32_t expr_type, sym, op;
+	int stack[64], sp = 0, s = 0, cmp;
+	const apol_context_t *c;
+	const char *v1, *v2;
+
+	for (; !qpol_iterator_end(expr_iter); qpol_iterator_next(expr_iter)) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(expr_iter, (void **)&node) == 0);
+		CU_ASSERT_FATAL(qpol_constraint_expr_node_get_expr_type(q, node, &expr_type) == 0);
+		CU_ASSERT_FATAL(qpol_constraint_expr_node_get_sym_type(q, node, &sym) == 0);
+		CU_ASSERT_FATAL(qpol_constraint_expr_node_get_op(q, node, &op) == 0);
+		switch (expr_type) {
+		case QPOL_CEXPR_TYPE_NOT:
+			stack[sp - 1] = !stack[sp - 1];
+			continue;
+		case QPOL_CEXPR_TYPE_AND:
+			sp--;
+			stack[sp - 1] = stack[sp - 1] && stack[sp];
+			continue;
+		case QPOL_CEXPR_TYPE_OR:
+			sp--;
+			stack[sp - 1] = stack[sp - 1] || stack[sp];
+			continue;
+		case QPOL_CEXPR_TYPE_NAMES:
+			c = ctx[sym & QPOL_CEXPR_SYM_XTARGET ? 2 : sym & QPOL_CEXPR_SYM_TARGET ? 1 : 0];
+			sym &= ~(QPOL_CEXPR_SYM_TARGET | QPOL_CEXPR_SYM_XTARGET);
+			v1 = (sym == QPOL_CEXPR_SYM_USER ? apol_context_get_user(c) :
+			      sym == QPOL_CEXPR_SYM_ROLE ? apol_context_get_role(c) : apol_context_get_type(c));
+			s = eval_names(ap, node, sym, v1);
+			break;
+		default:
+			if (sym == QPOL_CEXPR_SYM_ROLE) {
+				v1 = apol_context_get_role(ctx[0]);
+				v2 = apol_context_get_role(ctx[1]);
+				s = (op == QPOL_CEXPR_OP_DOM ? eval_role_dom(ap, v1, v2) :
+				     op == QPOL_CEXPR_OP_DOMBY ? eval_role_dom(ap, v2, v1) :
+				     op == QPOL_CEXPR_OP_INCOMP ? !eval_role_dom(ap, v1, v2) && !eval_role_dom(ap, v2, v1) :
+				     strcmp(v1, v2) == 0);
+			} else if (sym == QPOL_CEXPR_SYM_USER) {
+				s = (strcmp(apol_context_get_user(ctx[0]), apol_context_get_user(ctx[1])) == 0);
+			} else if (sym == QPOL_CEXPR_SYM_TYPE) {
+				s = (strcmp(apol_context_get_type(ctx[0]), apol_context_get_type(ctx[1])) == 0);
+			} else {
+				const apol_mls_level_t *l1, *l2;
+				switch (sym) {
+				case QPOL_CEXPR_SYM_L1L2:
+					l1 = eval_level(ctx[0], 0), l2 = eval_level(ctx[1], 0);
+					break;
+				case QPOL_CEXPR_SYM_L1H2:
+					l1 = eval_level(ctx[0], 0), l2 = eval_level(ctx[1], 1);
+					break;
+				case QPOL_CEXPR_SYM_H1L2:
+					l1 = eval_level(ctx[0], 1), l2 = eval_level(ctx[1], 0);
+					break;
+				case QPOL_CEXPR_SYM_H1H2:
+					l1 = eval_level(ctx[0], 1), l2 = eval_level(ctx[1], 1);
+					break;
+				case QPOL_CEXPR_SYM_L1H1:
+					l1 = eval_level(ctx[0], 0), l2 = eval_level(ctx[0], 1);
+					break;
+				default:
+					l1 = eval_level(ctx[1], 0), l2 = eval_level(ctx[1], 1);
+				}
+				cmp = apol_mls_level_compare(ap, l1, l2);
+				CU_ASSERT_FATAL(cmp >= 0);
+				s = (op == QPOL_CEXPR_OP_DOM ? cmp == APOL_MLS_EQ || cmp == APOL_MLS_DOM :
+				     op == QPOL_CEXPR_OP_DOMBY ? cmp == APOL_MLS_EQ || cmp == APOL_MLS_DOMBY :
+				     op == QPOL_CEXPR_OP_INCOMP ? cmp == APOL_MLS_INCOMP : cmp == APOL_MLS_EQ);
+			}
+		}
+		if (op == QPOL_CEXPR_OP_NEQ) {
+			s = !s;
+		}
+		CU_ASSERT_FATAL(sp < 64);
+		stack[sp++] = s;
+	}
+	CU_ASSERT_FATAL(sp == 1);
+	return stack[0];
+}
+
+static apol_context_t *eval_context_create(apol_policy_t * ap, const char *user, const char *role, const char *type,
+					   const qpol_user_t * u, int single)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(ap);
+	apol_context_t *c = apol_context_create();
+	apol_mls_range_t *range = NULL;
+	CU_ASSERT_PTR_NOT_NULL_FATAL(c);
+	CU_ASSERT_FATAL(apol_context_set_user(ap, c, user) == 0);
+	CU_ASSERT_FATAL(apol_context_set_role(ap, c, role) == 0);
+	CU_ASSERT_FATAL(apol_context_set_type(ap, c, type) == 0);
+	if (apol_policy_is_mls(ap)) {
+		if (single) {
+			const qpol_mls_level_t *dflt;
+			apol_mls_level_t *level;
+			CU_ASSERT_FATAL(qpol_user_get_dfltlevel(q, u, &dflt) == 0);
+			level = apol_mls_level_create_from_qpol_mls_level(ap, dflt);
+			range = apol_mls_range_create();
+			CU_ASSERT_FATAL(level != NULL && range != NULL);
+			CU_ASSERT_FATAL(apol_mls_range_set_low(ap, range, level) == 0);
+		} else {
+			const qpol_mls_range_t *qrange;
+			CU_ASSERT_FATAL(qpol_user_get_range(q, u, &qrange) == 0);
+			range = apol_mls_range_create_from_qpol_mls_range(ap, qrange);
+			CU_ASSERT_PTR_NOT_NULL_FATAL(range);
+		}
+		CU_ASSERT_FATAL(apol_context_set_range(ap, c, range) == 0);
+	}
+	return c;
+}
+
+/* Build contexts from the first few users, each with a few roles
+ * and types, at both the user's full range and its default level. */
+static size_t eval_build_contexts(apol_policy_t * ap, apol_constraint_eval_t * e, apol_context_t ** ctx)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(ap);
+	qpol_iterator_t *iter = NULL, *role_iter = NULL;
+	const char *types[EVAL_MAX_TYPES + 2], *user_name, *role_name;
+	const qpol_user_t *user;
+	const qpol_role_t *role;
+	const qpol_type_t *type;
+	unsigned char isattr, isalias;
+	size_t num_types = 0, num_users = 0, num_roles, n = 0, i;
+	int single;
+
+	CU_ASSERT_FATAL(qpol_policy_get_type_iter(q, &iter) == 0);
+	for (; num_types < EVAL_MAX_TYPES && !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&type) == 0);
+		CU_ASSERT_FATAL(qpol_type_get_isattr(q, type, &isattr) == 0);
+		CU_ASSERT_FATAL(qpol_type_get_isalias(q, type, &isalias) == 0);
+		if (!isattr && !isalias) {
+			CU_ASSERT_FATAL(qpol_type_get_name(q, type, &types[num_types]) == 0);
+			num_types++;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	/* types named by the test policy's constraints */
+	if (qpol_policy_get_type_by_name(q, "sysadm_t", &type) == 0) {
+		types[num_types++] = "sysadm_t";
+	}
+	if (qpol_policy_get_type_by_name(q, "secadm_t", &type) == 0) {
+		types[num_types++] = "secadm_t";
+	}
+
+	CU_ASSERT_FATAL(qpol_policy_get_user_iter(q, &iter) == 0);
+	for (; num_users < EVAL_MAX_USERS && !qpol_iterator_end(iter); qpol_iterator_next(iter), num_users++) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&user) == 0);
+		CU_ASSERT_FATAL(qpol_user_get_name(q, user, &user_name) == 0);
+		CU_ASSERT_FATAL(qpol_user_get_role_iter(q, user, &role_iter) == 0);
+		for (num_roles = 0; num_roles < EVAL_MAX_ROLES && !qpol_iterator_end(role_iter);
+		     qpol_iterator_next(role_iter), num_roles++) {
+			CU_ASSERT_FATAL(qpol_iterator_get_item(role_iter, (void **)&role) == 0);
+			CU_ASSERT_FATAL(qpol_role_get_name(q, role, &role_name) == 0);
+			for (i = 0; i < num_types; i++) {
+				for (single = 0; single < 2; single++) {
+					ctx[n] = eval_context_create(ap, user_name, role_name, types[i], user, single);
+					CU_ASSERT_FATAL(apol_constraint_eval_append_context(e, ctx[n]) == 0);
+					n++;
+				}
+			}
+		}
+		qpol_iterator_destroy(&role_iter);
+	}
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT_EQUAL(apol_constraint_eval_get_num_contexts(e), n);
+	return n;
+}
+
+static void constrain_eval_test(apol_policy_t * ap)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(ap);
+	apol_constraint_eval_t *e = apol_constraint_eval_create(ap);
+	apol_context_t *ctx[EVAL_MAX_CONTEXTS];
+	apol_constraint_eval_request_t *requests;
+	uint32_t *denied, *expected, bit;
+	qpol_iterator_t *class_iter = NULL, *iter = NULL, *perm_iter = NULL, *expr_iter = NULL;
+	const qpol_class_t *obj_class;
+	qpol_constraint_t *constr;
+	qpol_validatetrans_t *vtrans;
+	const char *class_name;
+	char *perm;
+	size_t n, i, j, k, class_index, num_expected;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(e);
+	n = eval_build_contexts(ap, e, ctx);
+	CU_ASSERT_FATAL(n > 0);
+	/* expected holds a result for every pair of contexts, and then
+	 * for every validatetrans triple */
+	k = (n < EVAL_VTRANS_CONTEXTS ? n : EVAL_VTRANS_CONTEXTS);
+	num_expected = (n * n > k * k * k ? n * n : k * k * k);
+	requests = calloc(n * n, sizeof(*requests));
+	denied = calloc(n * n, sizeof(*denied));
+	expected = calloc(num_expected, sizeof(*expected));
+	CU_ASSERT_FATAL(requests != NULL && denied != NULL && expected != NULL);
+
+	CU_ASSERT_FATAL(qpol_policy_get_class_iter(q, &class_iter) == 0);
+	for (; !qpol_iterator_end(class_iter); qpol_iterator_next(class_iter)) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(class_iter, (void **)&obj_class) == 0);
+		CU_ASSERT_FATAL(qpol_class_get_name(q, obj_class, &class_name) == 0);
+		CU_ASSERT_FATAL(apol_constraint_eval_get_perm(e, class_name, NULL, &class_index, NULL) == 0);
+
+		/* every pair of contexts requests every permission at once */
+		for (i = 0; i < n; i++) {
+			for (j = 0; j < n; j++) {
+				requests[i * n + j].scontext = i;
+				requests[i * n + j].tcontext = j;
+				requests[i * n + j].class_index = class_index;
+				requests[i * n + j].perms = ~(uint32_t) 0;
+			}
+		}
+		memset(expected, 0, n * n * sizeof(*expected));
+		CU_ASSERT_FATAL(qpol_class_get_constraint_iter(q, obj_class, &iter) == 0);
+		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+			uint32_t perms = 0;
+			CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&constr) == 0);
+			CU_ASSERT_FATAL(qpol_constraint_get_perm_iter(q, constr, &perm_iter) == 0);
+			for (; !qpol_iterator_end(perm_iter); qpol_iterator_next(perm_iter)) {
+				CU_ASSERT_FATAL(qpol_iterator_get_item(perm_iter, (void **)&perm) == 0);
+				CU_ASSERT_FATAL(apol_constraint_eval_get_perm(e, class_name, perm, &k, &bit) == 0);
+				CU_ASSERT_EQUAL(k, class_index);
+				perms |= bit;
+				free(perm);
+			}
+			qpol_iterator_destroy(&perm_iter);
+			for (i = 0; i < n * n; i++) {
+				apol_context_t *pair[3] = { ctx[i / n], ctx[i % n], NULL };
+				CU_ASSERT_FATAL(qpol_constraint_get_expr_iter(q, constr, &expr_iter) == 0);
+				if (!eval_expr(ap, expr_iter, pair)) {
+					expected[i] |= perms;
+				}
+				qpol_iterator_destroy(&expr_iter);
+			}
+			free(constr);
+		}
+		qpol_iterator_destroy(&iter);
+		CU_ASSERT_FATAL(apol_constraint_eval_check(e, requests, n * n, denied) == 0);
+		CU_ASSERT(memcmp(denied, expected, n * n * sizeof(*denied)) == 0);
+
+		/* validatetrans, over every triple of the first few contexts */
+		k = (n < EVAL_VTRANS_CONTEXTS ? n : EVAL_VTRANS_CONTEXTS);
+		memset(expected, 0, k * k * k * sizeof(*expected));
+		CU_ASSERT_FATAL(qpol_class_get_validatetrans_iter(q, obj_class, &iter) == 0);
+		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+			CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&vtrans) == 0);
+			for (i = 0; i < k * k * k; i++) {
+				apol_context_t *triple[3] = { ctx[i / (k * k)], ctx[(i / k) % k], ctx[i % k] };
+				CU_ASSERT_FATAL(qpol_validatetrans_get_expr_iter(q, vtrans, &expr_iter) == 0);
+				if (!eval_expr(ap, expr_iter, triple)) {
+					expected[i] = 1;
+				}
+				qpol_iterator_destroy(&expr_iter);
+			}
+			free(vtrans);
+		}
+		qpol_iterator_destroy(&iter);
+		for (i = 0; i < k * k * k; i++) {
+			CU_ASSERT_EQUAL(apol_constraint_eval_validatetrans(e, i / (k * k), (i / k) % k, i % k, class_index),
+					expected[i] ? 0 : 1);
+		}
+	}
+	qpol_iterator_destroy(&class_iter);
+
+	/* out of range requests are rejected */
+	requests[0].scontext = n;
+	CU_ASSERT(apol_constraint_eval_check(e, requests, 1, denied) < 0);
+	CU_ASSERT(apol_constraint_eval_get_perm(e, "no_such_class", NULL, &class_index, NULL) < 0);
+
+	for (i = 0; i < n; i++) {
+		apol_context_destroy(&ctx[i]);
+	}
+	free(requests);
+	free(denied);
+	free(expected);
+	apol_constraint_eval_destroy(&e);
+	CU_ASSERT_PTR_NULL(e);
+}
+
+static void constrain_eval_source(void)
+{
+	constrain_eval_test(ps);
+}
+
+static void constrain_eval_binary(void)
+{
+	constrain_eval_test(pb);
+}
+
 static void constrain_modular(void)
 {
 	CU_PASS("Not yet implemented")
@@ -484,6 +868,8 @@ static void constrain_modular(void)
 CU_TestInfo constrain_tests[] = {
 	{"constrain from source policy", constrain_source},
 	{"constrain from binary policy", constrain_binary},
+	{"compiled evaluator from source policy", constrain_eval_source},
+	{"compiled evaluator from binary policy", constrain_eval_binary},
 //	{"constrain from modular policy", constrain_modular},
 	CU_TEST_INFO_NULL
 };
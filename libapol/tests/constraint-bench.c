@@ -0,0 +1,242 @@
+/**
+ *  @file
+ *
+ *  Benchmark the compiled constraint evaluator.  Contexts are built
+ *  from a policy's users, their roles, and a sample of its types;
+ *  requests for every permission of a constrained class between two
+ *  random contexts are then checked in one batch.
+ *
+ *  Build with "make constraint-bench", then run:
+ *
+ *    constraint-bench POLICY [NUM_REQUESTS]
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <apol/constraint-eval.h>
+#include <apol/context-query.h>
+#include <apol/mls_range.h>
+#include <apol/policy.h>
+#include <apol/policy-path.h>
+#include <qpol/class_perm_query.h>
+#include <qpol/constraint_query.h>
+#include <qpol/iterator.h>
+#include <qpol/role_query.h>
+#include <qpol/type_query.h>
+#include <qpol/user_query.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define DEFAULT_NUM_REQUESTS 10000000
+#define MAX_TYPES 16
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/**
+ * Add a context to the evaluator for each user, each of the user's
+ * roles, and each of the first few types.
+ */
+static int gather_contexts(apol_policy_t * p, apol_constraint_eval_t * e)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(p);
+	qpol_iterator_t *iter = NULL, *role_iter = NULL;
+	const char *types[MAX_TYPES];
+	size_t num_types = 0, i;
+	int retval = -1;
+
+	if (qpol_policy_get_type_iter(q, &iter) < 0) {
+		return -1;
+	}
+	for (; num_types < MAX_TYPES && !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		const qpol_type_t *type;
+		unsigned char isattr, isalias;
+		if (qpol_iterator_get_item(iter, (void **)&type) < 0 || qpol_type_get_isattr(q, type, &isattr) < 0 ||
+		    qpol_type_get_isalias(q, type, &isalias) < 0) {
+			goto cleanup;
+		}
+		if (!isattr && !isalias && qpol_type_get_name(q, type, &types[num_types++]) < 0) {
+			goto cleanup;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+
+	if (qpol_policy_get_user_iter(q, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		const qpol_user_t *user;
+		const char *user_name;
+		if (qpol_iterator_get_item(iter, (void **)&user) < 0 || qpol_user_get_name(q, user, &user_name) < 0 ||
+		    qpol_user_get_role_iter(q, user, &role_iter) < 0) {
+			goto cleanup;
+		}
+		for (; !qpol_iterator_end(role_iter); qpol_iterator_next(role_iter)) {
+			const qpol_role_t *role;
+			const char *role_name;
+			if (qpol_iterator_get_item(role_iter, (void **)&role) < 0 || qpol_role_get_name(q, role, &role_name) < 0) {
+				goto cleanup;
+			}
+			for (i = 0; i < num_types; i++) {
+				apol_context_t *c = apol_context_create();
+				const qpol_mls_range_t *qrange;
+				apol_mls_range_t *range = NULL;
+				int ok = (c != NULL && apol_context_set_user(p, c, user_name) == 0 &&
+					  apol_context_set_role(p, c, role_name) == 0 && apol_context_set_type(p, c, types[i]) == 0);
+				if (ok && apol_policy_is_mls(p)) {
+					ok = (qpol_user_get_range(q, user, &qrange) == 0 &&
+					      (range = apol_mls_range_create_from_qpol_mls_range(p, qrange)) != NULL &&
+					      apol_context_set_range(p, c, range) == 0);
+				}
+				ok = ok && apol_constraint_eval_append_context(e, c) == 0;
+				apol_context_destroy(&c);
+				if (!ok) {
+					goto cleanup;
+				}
+			}
+		}
+		qpol_iterator_destroy(&role_iter);
+	}
+	retval = 0;
+      cleanup:
+	qpol_iterator_destroy(&role_iter);
+	qpol_iterator_destroy(&iter);
+	return retval;
+}
+
+/**
+ * Find the index of each class that has at least one constraint.
+ */
+static int gather_classes(apol_policy_t * p, apol_constraint_eval_t * e, size_t ** classes, size_t * num_classes)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(p);
+	qpol_iterator_t *iter = NULL, *constr_iter = NULL;
+	size_t size, n = 0;
+	int retval = -1;
+
+	if (qpol_policy_get_class_iter(q, &iter) < 0 || qpol_iterator_get_size(iter, &size) < 0 ||
+	    (*classes = malloc((size + 1) * sizeof(**classes))) == NULL) {
+		goto cleanup;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		const qpol_class_t *obj_class;
+		const char *name;
+		size_t num_constr;
+		if (qpol_iterator_get_item(iter, (void **)&obj_class) < 0 || qpol_class_get_name(q, obj_class, &name) < 0 ||
+		    qpol_class_get_constraint_iter(q, obj_class, &constr_iter) < 0 ||
+		    qpol_iterator_get_size(constr_iter, &num_constr) < 0) {
+			goto cleanup;
+		}
+		qpol_iterator_destroy(&constr_iter);
+		if (num_constr > 0 && apol_constraint_eval_get_perm(e, name, NULL, *classes + n, NULL) == 0) {
+			n++;
+		}
+	}
+	*num_classes = n;
+	retval = 0;
+      cleanup:
+	qpol_iterator_destroy(&constr_iter);
+	qpol_iterator_destroy(&iter);
+	return retval;
+}
+
+int main(int argc, char **argv)
+{
+	apol_policy_path_t *ppath = NULL;
+	apol_policy_t *p = NULL;
+	apol_constraint_eval_t *e = NULL;
+	apol_constraint_eval_request_t *requests = NULL;
+	uint32_t *denied = NULL;
+	size_t *classes = NULL, num_classes = 0, num_contexts, num_requests = DEFAULT_NUM_REQUESTS, num_denied = 0, i;
+	double start, compile_time, check_time;
+	int retval = EXIT_FAILURE;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s POLICY [NUM_REQUESTS]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc == 3) {
+		num_requests = strtoul(argv[2], NULL, 10);
+	}
+	if ((ppath = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, argv[1], NULL)) == NULL ||
+	    (p = apol_policy_create_from_policy_path(ppath, QPOL_POLICY_OPTION_NO_RULES, NULL, NULL)) == NULL) {
+		perror("Error opening policy");
+		goto cleanup;
+	}
+	start = now();
+	if ((e = apol_constraint_eval_create(p)) == NULL) {
+		perror("Error compiling constraints");
+		goto cleanup;
+	}
+	compile_time = now() - start;
+	if (gather_contexts(p, e) < 0 || gather_classes(p, e, &classes, &num_classes) < 0) {
+		perror("Error building contexts");
+		goto cleanup;
+	}
+	num_contexts = apol_constraint_eval_get_num_contexts(e);
+	if (num_contexts == 0 || num_classes == 0) {
+		fprintf(stderr, "%s has no contexts or no constrained classes.\n", argv[1]);
+		goto cleanup;
+	}
+	if ((requests = malloc(num_requests * sizeof(*requests))) == NULL ||
+	    (denied = malloc(num_requests * sizeof(*denied))) == NULL) {
+		perror("Error allocating requests");
+		goto cleanup;
+	}
+	srand(1);
+	for (i = 0; i < num_requests; i++) {
+		requests[i].scontext = (size_t) rand() % num_contexts;
+		requests[i].tcontext = (size_t) rand() % num_contexts;
+		requests[i].class_index = classes[(size_t) rand() % num_classes];
+		requests[i].perms = ~(uint32_t) 0;
+	}
+	printf("%zu contexts, %zu constrained classes, %zu requests\n", num_contexts, num_classes, num_requests);
+
+	start = now();
+	if (apol_constraint_eval_check(e, requests, num_requests, denied) < 0) {
+		perror("Error checking requests");
+		goto cleanup;
+	}
+	check_time = now() - start;
+	for (i = 0; i < num_requests; i++) {
+		if (denied[i] != 0) {
+			num_denied++;
+		}
+	}
+
+	printf("compile: %.3f s\n", compile_time);
+	printf("check:   %.3f s (%.1f ns/request, %.2f million requests/s)\n", check_time, check_time * 1e9 / num_requests,
+	       check_time > 0 ? num_requests / check_time / 1e6 : 0.0);
+	printf("%zu requests had at least one permission denied.\n", num_denied);
+	retval = EXIT_SUCCESS;
+      cleanup:
+	free(requests);
+	free(denied);
+	free(classes);
+	apol_constraint_eval_destroy(&e);
+	apol_policy_destroy(&p);
+	apol_policy_path_destroy(&ppath);
+	return retval;
+}
@@ -30,6 +30,7 @@
 #include <apol/perm-map.h>
 #include <apol/policy.h>
 #include <apol/policy-path.h>
+#include <apol/types-relation-analysis.h>
 #include <stdbool.h>
 #include <string.h>
 
@@ -96,11 +97,100 @@ static void infoflow_trans_overview(void)
 	apol_infoflow_graph_destroy(&g);
 }
 
+/**
+ * Check that two vectors of pointers owned by the policy hold the same
+ * elements in the same order.
+ */
+static void types_relation_compare_vectors(const apol_vector_t * v1, const apol_vector_t * v2)
+{
+	size_t i;
+	CU_ASSERT_EQUAL_FATAL(apol_vector_get_size(v1), apol_vector_get_size(v2));
+	for (i = 0; i < apol_vector_get_size(v1); i++) {
+		CU_ASSERT(apol_vector_get_element(v1, i) == apol_vector_get_element(v2, i));
+	}
+}
+
+/**
+ * Check that two vectors of apol_types_relation_access_t hold the same
+ * types and the same rules, in the same order.
+ */
+static void types_relation_compare_accesses(const apol_vector_t * v1, const apol_vector_t * v2)
+{
+	size_t i;
+	CU_ASSERT_EQUAL_FATAL(apol_vector_get_size(v1), apol_vector_get_size(v2));
+	for (i = 0; i < apol_vector_get_size(v1); i++) {
+		const apol_types_relation_access_t *a1 = apol_vector_get_element(v1, i);
+		const apol_types_relation_access_t *a2 = apol_vector_get_element(v2, i);
+		CU_ASSERT(apol_types_relation_access_get_type(a1) == apol_types_relation_access_get_type(a2));
+		types_relation_compare_vectors(apol_types_relation_access_get_rules(a1), apol_types_relation_access_get_rules(a2));
+	}
+}
+
+static void types_relation_batch(void)
+{
+	const char *first[] = { "local_login_t", "agp_device_t", "local_login_t", "local_login_t" };
+	const char *other[] = { "agp_device_t", "local_login_t", "local_login_t", "agp_device_t" };
+	const char *attr[] = { "local_login_t", "domain" };
+	apol_types_relation_result_t *results[4], *r = NULL;
+	apol_types_relation_analysis_t *tr = apol_types_relation_analysis_create();
+	size_t i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(tr);
+	CU_ASSERT_FATAL(apol_types_relation_analysis_set_analyses(p, tr, 0) == 0);
+	// permmap was loaded by infoflow_direct_overview()
+	CU_ASSERT_FATAL(apol_types_relation_analysis_do_batch(p, tr, first, other, 4, results) == 0);
+
+	/* each pair's result is that of analyzing the pair alone */
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT_PTR_NOT_NULL_FATAL(results[i]);
+		CU_ASSERT_FATAL(apol_types_relation_analysis_set_first_type(p, tr, first[i]) == 0);
+		CU_ASSERT_FATAL(apol_types_relation_analysis_set_other_type(p, tr, other[i]) == 0);
+		CU_ASSERT_FATAL(apol_types_relation_analysis_do(p, tr, &r) == 0);
+		types_relation_compare_vectors(apol_types_relation_result_get_attributes(results[i]),
+					       apol_types_relation_result_get_attributes(r));
+		types_relation_compare_vectors(apol_types_relation_result_get_roles(results[i]),
+					       apol_types_relation_result_get_roles(r));
+		types_relation_compare_vectors(apol_types_relation_result_get_users(results[i]),
+					       apol_types_relation_result_get_users(r));
+		types_relation_compare_accesses(apol_types_relation_result_get_similar_first(results[i]),
+						apol_types_relation_result_get_similar_first(r));
+		types_relation_compare_accesses(apol_types_relation_result_get_similar_other(results[i]),
+						apol_types_relation_result_get_similar_other(r));
+		types_relation_compare_accesses(apol_types_relation_result_get_dissimilar_first(results[i]),
+						apol_types_relation_result_get_dissimilar_first(r));
+		types_relation_compare_accesses(apol_types_relation_result_get_dissimilar_other(results[i]),
+						apol_types_relation_result_get_dissimilar_other(r));
+		types_relation_compare_vectors(apol_types_relation_result_get_allowrules(results[i]),
+					       apol_types_relation_result_get_allowrules(r));
+		types_relation_compare_vectors(apol_types_relation_result_get_typerules(results[i]),
+					       apol_types_relation_result_get_typerules(r));
+		CU_ASSERT_EQUAL(apol_vector_get_size(apol_types_relation_result_get_directflows(results[i])),
+				apol_vector_get_size(apol_types_relation_result_get_directflows(r)));
+		CU_ASSERT_EQUAL(apol_vector_get_size(apol_types_relation_result_get_transflowsAB(results[i])),
+				apol_vector_get_size(apol_types_relation_result_get_transflowsAB(r)));
+		CU_ASSERT_EQUAL(apol_vector_get_size(apol_types_relation_result_get_transflowsBA(results[i])),
+				apol_vector_get_size(apol_types_relation_result_get_transflowsBA(r)));
+		CU_ASSERT_EQUAL(apol_vector_get_size(apol_types_relation_result_get_domainsAB(results[i])),
+				apol_vector_get_size(apol_types_relation_result_get_domainsAB(r)));
+		CU_ASSERT_EQUAL(apol_vector_get_size(apol_types_relation_result_get_domainsBA(results[i])),
+				apol_vector_get_size(apol_types_relation_result_get_domainsBA(r)));
+		apol_types_relation_result_destroy(&r);
+		apol_types_relation_result_destroy(results + i);
+	}
+
+	/* an attribute within any pair fails the whole batch */
+	CU_ASSERT(apol_types_relation_analysis_do_batch(p, tr, attr, attr + 1, 1, results) < 0);
+	CU_ASSERT_PTR_NULL(results[0]);
+	apol_types_relation_analysis_destroy(&tr);
+}
+
 CU_TestInfo infoflow_tests[] = {
 	{"infoflow direct overview", infoflow_direct_overview}
 	,
 	{"infoflow trans overview", infoflow_trans_overview}
 	,
+	{"types relation batch", types_relation_batch}
+	,
 	CU_TEST_INFO_NULL
 };
 
@@ -31,9 +31,12 @@
 #include "avrule-tests.h"
 #include "dta-tests.h"
 #include "infoflow-tests.h"
+#include "mls-tests.h"
 #include "policy-21-tests.h"
+#include "relabel-tests.h"
 #include "role-tests.h"
 #include "terule-tests.h"
+#include "type-similarity-tests.h"
 #include "constrain-tests.h"
 #include "user-tests.h"
 
@@ -48,8 +51,11 @@ int main(void)
 		{"AV Rule Query", avrule_init, avrule_cleanup, avrule_tests},
 		{"Domain Transition Analysis", dta_init, dta_cleanup, dta_tests},
 		{"Infoflow Analysis", infoflow_init, infoflow_cleanup, infoflow_tests},
+		{"MLS Comparisons", mls_init, mls_cleanup, mls_tests},
+		{"Relabel Analysis", relabel_init, relabel_cleanup, relabel_tests},
 		{"Role Query", role_init, role_cleanup, role_tests},
 		{"TE Rule Query", terule_init, terule_cleanup, terule_tests},
+		{"Type Similarity", type_similarity_init, type_similarity_cleanup, type_similarity_tests},
 		{"User Query", user_init, user_cleanup, user_tests},
 		{"Constrain query", constrain_init, constrain_cleanup, constrain_tests},
 		CU_SUITE_INFO_NULL
@@ -0,0 +1,214 @@
+/**
+ *  @file
+ *
+ *  Benchmark batched MLS range containment against one-at-a-time
+ *  calls to apol_mls_range_contain_subrange().  Pairs of (user range,
+ *  level) are drawn at random from an MLS policy's users; both paths
+ *  answer every pair and their answers are checked for agreement.
+ *
+ *  Build with "make mls-bench", then run:
+ *
+ *    mls-bench POLICY [NUM_PAIRS]
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <apol/mls-batch.h>
+#include <apol/policy.h>
+#include <apol/policy-path.h>
+#include <apol/user-query.h>
+#include <apol/vector.h>
+#include <qpol/iterator.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define DEFAULT_NUM_PAIRS 1000000
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void range_free(void *elem)
+{
+	apol_mls_range_t *range = elem;
+	apol_mls_range_destroy(&range);
+}
+
+/**
+ * Collect every user's range, and a single-level range for each level
+ * within those ranges.
+ */
+static int gather(apol_policy_t * p, apol_vector_t * ranges, apol_vector_t * subranges)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(p);
+	qpol_iterator_t *iter = NULL;
+	size_t i;
+	if (qpol_policy_get_user_iter(q, &iter) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		qpol_user_t *u;
+		const qpol_mls_range_t *qrange;
+		apol_mls_range_t *range;
+		apol_vector_t *levels;
+		if (qpol_iterator_get_item(iter, (void **)&u) < 0 || qpol_user_get_range(q, u, &qrange) < 0 ||
+		    (range = apol_mls_range_create_from_qpol_mls_range(p, qrange)) == NULL) {
+			qpol_iterator_destroy(&iter);
+			return -1;
+		}
+		if (apol_vector_append(ranges, range) < 0 || (levels = apol_mls_range_get_levels(p, range)) == NULL) {
+			qpol_iterator_destroy(&iter);
+			return -1;
+		}
+		for (i = 0; i < apol_vector_get_size(levels); i++) {
+			apol_mls_range_t *sub = apol_mls_range_create();
+			apol_mls_level_t *l = apol_mls_level_create_from_mls_level(apol_vector_get_element(levels, i));
+			if (sub == NULL || l == NULL || apol_mls_range_set_low(p, sub, l) < 0 || apol_vector_append(subranges, sub) < 0) {
+				apol_mls_range_destroy(&sub);
+				apol_vector_destroy(&levels);
+				qpol_iterator_destroy(&iter);
+				return -1;
+			}
+		}
+		apol_vector_destroy(&levels);
+	}
+	qpol_iterator_destroy(&iter);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	apol_policy_path_t *ppath = NULL;
+	apol_policy_t *p = NULL;
+	apol_vector_t *ranges = NULL, *subranges = NULL;
+	apol_mls_range_batch_t *rb = NULL;
+	apol_mls_level_batch_t *lb = NULL;
+	apol_mls_batch_pair_t *pairs = NULL;
+	int *results = NULL, *batch_results = NULL, retval = EXIT_FAILURE;
+	size_t num_pairs = DEFAULT_NUM_PAIRS, i, mismatches = 0;
+	double start, single_time, build_time, batch_time;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s POLICY [NUM_PAIRS]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc == 3) {
+		num_pairs = strtoul(argv[2], NULL, 10);
+	}
+	if ((ppath = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, argv[1], NULL)) == NULL ||
+	    (p = apol_policy_create_from_policy_path(ppath, QPOL_POLICY_OPTION_NO_RULES, NULL, NULL)) == NULL) {
+		perror("Error opening policy");
+		goto cleanup;
+	}
+	if (!apol_policy_is_mls(p)) {
+		fprintf(stderr, "%s is not an MLS policy.\n", argv[1]);
+		goto cleanup;
+	}
+	if ((ranges = apol_vector_create(range_free)) == NULL || (subranges = apol_vector_create(range_free)) == NULL ||
+	    gather(p, ranges, subranges) < 0) {
+		perror("Error reading ranges");
+		goto cleanup;
+	}
+	if (apol_vector_get_size(ranges) == 0 || apol_vector_get_size(subranges) == 0) {
+		fprintf(stderr, "%s has no user ranges.\n", argv[1]);
+		goto cleanup;
+	}
+	if ((pairs = malloc(num_pairs * sizeof(*pairs))) == NULL || (results = malloc(num_pairs * sizeof(*results))) == NULL) {
+		perror("Error allocating pairs");
+		goto cleanup;
+	}
+	srand(1);
+	for (i = 0; i < num_pairs; i++) {
+		pairs[i].first = (size_t) rand() % apol_vector_get_size(ranges);
+		pairs[i].second = (size_t) rand() % apol_vector_get_size(subranges);
+	}
+	printf("%zu ranges, %zu levels, %zu pairs\n", apol_vector_get_size(ranges), apol_vector_get_size(subranges), num_pairs);
+
+	start = now();
+	for (i = 0; i < num_pairs; i++) {
+		results[i] = apol_mls_range_contain_subrange(p, apol_vector_get_element(ranges, pairs[i].first),
+							     apol_vector_get_element(subranges, pairs[i].second));
+	}
+	single_time = now() - start;
+
+	start = now();
+	if ((rb = apol_mls_range_batch_create(p)) == NULL || (lb = apol_mls_level_batch_create(p)) == NULL) {
+		perror("Error creating batches");
+		goto cleanup;
+	}
+	for (i = 0; i < apol_vector_get_size(ranges); i++) {
+		if (apol_mls_range_batch_append(rb, apol_vector_get_element(ranges, i)) < 0) {
+			perror("Error adding range");
+			goto cleanup;
+		}
+	}
+	for (i = 0; i < apol_vector_get_size(subranges); i++) {
+		const apol_mls_range_t *sub = apol_vector_get_element(subranges, i);
+		if (apol_mls_level_batch_append(lb, apol_mls_range_get_low(sub)) < 0) {
+			perror("Error adding level");
+			goto cleanup;
+		}
+	}
+	build_time = now() - start;
+
+	if ((batch_results = malloc(num_pairs * sizeof(*batch_results))) == NULL) {
+		perror("Error allocating results");
+		goto cleanup;
+	}
+	start = now();
+	if (apol_mls_range_batch_include_levels(rb, lb, pairs, num_pairs, batch_results) < 0) {
+		perror("Error comparing batches");
+		goto cleanup;
+	}
+	batch_time = now() - start;
+
+	for (i = 0; i < num_pairs; i++) {
+		if (results[i] != batch_results[i]) {
+			mismatches++;
+		}
+	}
+
+	printf("one at a time: %.3f s (%.1f ns/pair)\n", single_time, single_time * 1e9 / num_pairs);
+	printf("batch build:   %.3f s\n", build_time);
+	printf("batch compare: %.3f s (%.1f ns/pair)\n", batch_time, batch_time * 1e9 / num_pairs);
+	if (batch_time > 0) {
+		printf("speedup:       %.1fx\n", single_time / (build_time + batch_time));
+	}
+	if (mismatches > 0) {
+		fprintf(stderr, "%zu answers differ.\n", mismatches);
+		goto cleanup;
+	}
+	retval = EXIT_SUCCESS;
+      cleanup:
+	free(pairs);
+	free(results);
+	free(batch_results);
+	apol_mls_range_batch_destroy(&rb);
+	apol_mls_level_batch_destroy(&lb);
+	apol_vector_destroy(&ranges);
+	apol_vector_destroy(&subranges);
+	apol_policy_destroy(&p);
+	apol_policy_path_destroy(&ppath);
+	return retval;
+}
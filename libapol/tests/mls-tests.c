@@ -0,0 +1,303 @@
+/**
+ *  @file
+ *
+ *  Test MLS level and range comparisons.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <CUnit/CUnit.h>
+#include <apol/mls-query.h>
+#include <apol/policy.h>
+#include <apol/policy-path.h>
+#include <apol/policy-query.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SOURCE_POLICY TEST_POLICIES "/setools/apol/user_mls_testing_policy.conf"
+
+static apol_policy_t *sp = NULL;
+static qpol_policy_t *qp = NULL;
+
+/* the lowest and highest sensitivities, and two categories allowed
+ * for both of them */
+static const char *lo, *hi, *c0, *c1;
+
+/**
+ * Create a level from a sensitivity and up to two categories.
+ */
+static apol_mls_level_t *mls_level(const char *sens, const char *cat1, const char *cat2)
+{
+	apol_mls_level_t *l = apol_mls_level_create();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(l);
+	CU_ASSERT_FATAL(apol_mls_level_set_sens(sp, l, sens) == 0);
+	if (cat1 != NULL)
+		CU_ASSERT_FATAL(apol_mls_level_append_cats(sp, l, cat1) == 0);
+	if (cat2 != NULL)
+		CU_ASSERT_FATAL(apol_mls_level_append_cats(sp, l, cat2) == 0);
+	return l;
+}
+
+/**
+ * Create a range from two levels, taking ownership of them.
+ */
+static apol_mls_range_t *mls_range(apol_mls_level_t * low, apol_mls_level_t * high)
+{
+	apol_mls_range_t *r = apol_mls_range_create();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(r);
+	CU_ASSERT_FATAL(apol_mls_range_set_low(sp, r, low) == 0);
+	CU_ASSERT_FATAL(apol_mls_range_set_high(sp, r, high) == 0);
+	return r;
+}
+
+static void mls_level_compare(void)
+{
+	apol_mls_level_t *lo_c0 = mls_level(lo, c0, NULL);
+	apol_mls_level_t *lo_c0_again = mls_level(lo, c0, NULL);
+	apol_mls_level_t *lo_c1 = mls_level(lo, c1, NULL);
+	apol_mls_level_t *hi_c0 = mls_level(hi, c0, NULL);
+	apol_mls_level_t *hi_c0_c1 = mls_level(hi, c0, c1);
+
+	CU_ASSERT(apol_mls_level_compare(sp, lo_c0, lo_c0_again) == APOL_MLS_EQ);
+	CU_ASSERT(apol_mls_level_compare(sp, hi_c0_c1, lo_c0) == APOL_MLS_DOM);
+	CU_ASSERT(apol_mls_level_compare(sp, hi_c0, lo_c0) == APOL_MLS_DOM);
+	CU_ASSERT(apol_mls_level_compare(sp, lo_c0, hi_c0_c1) == APOL_MLS_DOMBY);
+	CU_ASSERT(apol_mls_level_compare(sp, lo_c1, hi_c0_c1) == APOL_MLS_DOMBY);
+	CU_ASSERT(apol_mls_level_compare(sp, lo_c0, lo_c1) == APOL_MLS_INCOMP);
+	CU_ASSERT(apol_mls_level_compare(sp, hi_c0, lo_c1) == APOL_MLS_INCOMP);
+	/* an absent level matches anything */
+	CU_ASSERT(apol_mls_level_compare(sp, lo_c0, NULL) == APOL_MLS_EQ);
+
+	/* comparing the same levels again must give the same answers */
+	CU_ASSERT(apol_mls_level_compare(sp, hi_c0_c1, lo_c0) == APOL_MLS_DOM);
+	CU_ASSERT(apol_mls_level_compare(sp, lo_c0, lo_c1) == APOL_MLS_INCOMP);
+
+	/* and a level that changes after having been compared must be
+	 * compared anew */
+	CU_ASSERT_FATAL(apol_mls_level_append_cats(sp, lo_c0, c1) == 0);
+	CU_ASSERT(apol_mls_level_compare(sp, lo_c0, lo_c1) == APOL_MLS_DOM);
+	CU_ASSERT(apol_mls_level_compare(sp, lo_c0, hi_c0_c1) == APOL_MLS_DOMBY);
+	CU_ASSERT_FATAL(apol_mls_level_set_sens(sp, lo_c0, hi) == 0);
+	CU_ASSERT(apol_mls_level_compare(sp, lo_c0, hi_c0_c1) == APOL_MLS_EQ);
+
+	apol_mls_level_destroy(&lo_c0);
+	apol_mls_level_destroy(&lo_c0_again);
+	apol_mls_level_destroy(&lo_c1);
+	apol_mls_level_destroy(&hi_c0);
+	apol_mls_level_destroy(&hi_c0_c1);
+}
+
+static void mls_level_unknown(void)
+{
+	apol_mls_level_t *known = mls_level(lo, c0, NULL);
+	apol_mls_level_t *unknown_cat = mls_level(lo, c0, "not_a_category");
+	apol_mls_level_t *unknown_sens = mls_level("not_a_sensitivity", c0, NULL);
+
+	CU_ASSERT(apol_mls_level_compare(sp, known, unknown_cat) < 0);
+	CU_ASSERT(apol_mls_level_compare(sp, unknown_cat, known) < 0);
+	CU_ASSERT(apol_mls_level_compare(sp, known, unknown_sens) < 0);
+	CU_ASSERT(apol_mls_level_validate(sp, unknown_cat) == 0);
+	CU_ASSERT(apol_mls_level_validate(sp, known) == 1);
+
+	apol_mls_level_destroy(&known);
+	apol_mls_level_destroy(&unknown_cat);
+	apol_mls_level_destroy(&unknown_sens);
+}
+
+static void mls_range_contain(void)
+{
+	/* lo - hi:c0,c1 */
+	apol_mls_range_t *wide = mls_range(mls_level(lo, NULL, NULL), mls_level(hi, c0, c1));
+	/* lo:c0 - hi:c0 */
+	apol_mls_range_t *narrow = mls_range(mls_level(lo, c0, NULL), mls_level(hi, c0, NULL));
+	/* lo:c1 - hi:c1 */
+	apol_mls_range_t *other = mls_range(mls_level(lo, c1, NULL), mls_level(hi, c1, NULL));
+
+	CU_ASSERT(apol_mls_range_contain_subrange(sp, wide, narrow) == 1);
+	CU_ASSERT(apol_mls_range_contain_subrange(sp, narrow, wide) == 0);
+	CU_ASSERT(apol_mls_range_contain_subrange(sp, wide, wide) == 1);
+	CU_ASSERT(apol_mls_range_contain_subrange(sp, narrow, other) == 0);
+
+	CU_ASSERT(apol_mls_range_compare(sp, wide, narrow, APOL_QUERY_SUB) == 1);
+	CU_ASSERT(apol_mls_range_compare(sp, narrow, wide, APOL_QUERY_SUB) == 0);
+	CU_ASSERT(apol_mls_range_compare(sp, narrow, wide, APOL_QUERY_SUPER) == 1);
+	CU_ASSERT(apol_mls_range_compare(sp, wide, narrow, APOL_QUERY_SUPER) == 0);
+	CU_ASSERT(apol_mls_range_compare(sp, wide, wide, APOL_QUERY_EXACT) == 1);
+	CU_ASSERT(apol_mls_range_compare(sp, wide, narrow, APOL_QUERY_EXACT) == 0);
+
+	apol_mls_range_destroy(&wide);
+	apol_mls_range_destroy(&narrow);
+	apol_mls_range_destroy(&other);
+}
+
+static void mls_range_intersect(void)
+{
+	/* lo - hi:c0 */
+	apol_mls_range_t *r1 = mls_range(mls_level(lo, NULL, NULL), mls_level(hi, c0, NULL));
+	/* lo:c0 - hi:c0,c1 */
+	apol_mls_range_t *r2 = mls_range(mls_level(lo, c0, NULL), mls_level(hi, c0, c1));
+	/* lo:c1 - hi:c1 */
+	apol_mls_range_t *r3 = mls_range(mls_level(lo, c1, NULL), mls_level(hi, c1, NULL));
+	/* hi - hi:c0,c1 */
+	apol_mls_range_t *r4 = mls_range(mls_level(hi, NULL, NULL), mls_level(hi, c0, c1));
+	/* lo - lo:c0,c1 */
+	apol_mls_range_t *r5 = mls_range(mls_level(lo, NULL, NULL), mls_level(lo, c0, c1));
+
+	/* neither of r1 and r2 contains the other, yet both include
+	 * lo:c0, so they intersect */
+	CU_ASSERT(apol_mls_range_compare(sp, r1, r2, APOL_QUERY_SUB) == 0);
+	CU_ASSERT(apol_mls_range_compare(sp, r1, r2, APOL_QUERY_SUPER) == 0);
+	CU_ASSERT(apol_mls_range_compare(sp, r1, r2, APOL_QUERY_INTERSECT) == 1);
+	CU_ASSERT(apol_mls_range_compare(sp, r2, r1, APOL_QUERY_INTERSECT) == 1);
+
+	/* likewise r1 and r4, which both include hi */
+	CU_ASSERT(apol_mls_range_compare(sp, r1, r4, APOL_QUERY_SUB) == 0);
+	CU_ASSERT(apol_mls_range_compare(sp, r1, r4, APOL_QUERY_SUPER) == 0);
+	CU_ASSERT(apol_mls_range_compare(sp, r1, r4, APOL_QUERY_INTERSECT) == 1);
+
+	/* every level of r3 includes c1, which r1 never does, and every
+	 * level of r2 includes c0, which r3 never does */
+	CU_ASSERT(apol_mls_range_compare(sp, r1, r3, APOL_QUERY_INTERSECT) == 0);
+	CU_ASSERT(apol_mls_range_compare(sp, r3, r1, APOL_QUERY_INTERSECT) == 0);
+	CU_ASSERT(apol_mls_range_compare(sp, r2, r3, APOL_QUERY_INTERSECT) == 0);
+
+	/* r4 and r5 share no sensitivity */
+	CU_ASSERT(apol_mls_range_compare(sp, r4, r5, APOL_QUERY_INTERSECT) == 0);
+	CU_ASSERT(apol_mls_range_compare(sp, r1, r5, APOL_QUERY_INTERSECT) == 1);
+
+	apol_mls_range_destroy(&r1);
+	apol_mls_range_destroy(&r2);
+	apol_mls_range_destroy(&r3);
+	apol_mls_range_destroy(&r4);
+	apol_mls_range_destroy(&r5);
+}
+
+CU_TestInfo mls_tests[] = {
+	{"level compare", mls_level_compare}
+	,
+	{"unknown names", mls_level_unknown}
+	,
+	{"range containment", mls_range_contain}
+	,
+	{"range intersection", mls_range_intersect}
+	,
+	CU_TEST_INFO_NULL
+};
+
+/**
+ * Return the name of the sensitivity with the least or greatest
+ * value, or NULL on error.
+ */
+static const char *mls_find_sens(int want_highest)
+{
+	qpol_iterator_t *iter = NULL;
+	const qpol_level_t *level;
+	const char *name, *found = NULL;
+	unsigned char isalias;
+	uint32_t value, found_value = 0;
+
+	if (qpol_policy_get_level_iter(qp, &iter) < 0)
+		return NULL;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&level) < 0 || qpol_level_get_isalias(qp, level, &isalias) < 0 ||
+		    qpol_level_get_value(qp, level, &value) < 0 || qpol_level_get_name(qp, level, &name) < 0) {
+			found = NULL;
+			break;
+		}
+		if (isalias)
+			continue;
+		if (found == NULL || (want_highest ? value > found_value : value < found_value)) {
+			found = name;
+			found_value = value;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	return found;
+}
+
+/**
+ * Return non-zero if a sensitivity allows a category.
+ */
+static int mls_sens_has_cat(const char *sens, const char *cat_name)
+{
+	const qpol_level_t *level;
+	const qpol_cat_t *cat;
+	qpol_iterator_t *iter = NULL;
+	const char *name;
+	int found = 0;
+
+	if (qpol_policy_get_level_by_name(qp, sens, &level) < 0 || qpol_level_get_cat_iter(qp, level, &iter) < 0)
+		return 0;
+	for (; !found && !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&cat) == 0 && qpol_cat_get_name(qp, cat, &name) == 0)
+			found = !strcmp(name, cat_name);
+	}
+	qpol_iterator_destroy(&iter);
+	return found;
+}
+
+int mls_init()
+{
+	apol_policy_path_t *ppath = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, SOURCE_POLICY, NULL);
+	const qpol_level_t *level;
+	const qpol_cat_t *cat;
+	qpol_iterator_t *iter = NULL;
+	const char *name;
+
+	if (ppath == NULL) {
+		return 1;
+	}
+	if ((sp = apol_policy_create_from_policy_path(ppath, QPOL_POLICY_OPTION_NO_RULES, NULL, NULL)) == NULL) {
+		apol_policy_path_destroy(&ppath);
+		return 1;
+	}
+	apol_policy_path_destroy(&ppath);
+	qp = apol_policy_get_qpol(sp);
+
+	if ((lo = mls_find_sens(0)) == NULL || (hi = mls_find_sens(1)) == NULL || !strcmp(lo, hi)) {
+		return 1;
+	}
+	/* pick the first two of the lowest sensitivity's categories that
+	 * the highest sensitivity also allows */
+	c0 = c1 = NULL;
+	if (qpol_policy_get_level_by_name(qp, lo, &level) < 0 || qpol_level_get_cat_iter(qp, level, &iter) < 0) {
+		return 1;
+	}
+	for (; c1 == NULL && !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&cat) < 0 || qpol_cat_get_name(qp, cat, &name) < 0) {
+			break;
+		}
+		if (!mls_sens_has_cat(hi, name)) {
+			continue;
+		}
+		if (c0 == NULL) {
+			c0 = name;
+		} else {
+			c1 = name;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	return (c1 == NULL);
+}
+
+int mls_cleanup()
+{
+	apol_policy_destroy(&sp);
+	return 0;
+}
@@ -0,0 +1,449 @@
+/**
+ *  @file
+ *
+ *  Test the relabel analysis code.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <CUnit/CUnit.h>
+#include <apol/avrule-query.h>
+#include <apol/policy.h>
+#include <apol/policy-path.h>
+#include <apol/relabel-analysis.h>
+#include <qpol/avrule_query.h>
+#include <qpol/type_query.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIG_POLICY TEST_POLICIES "/snapshots/fc4_targeted.policy.conf"
+
+/** Number of domains whose all-domains results are compared against
+ *  a subject analysis of each. */
+#define NUM_COMPARED 16
+
+static apol_policy_t *p = NULL;
+
+/**
+ * Check that two vectors of apol_relabel_result_t hold the same
+ * types and the same rule pairs, in the same order.
+ */
+static void relabel_compare_results(const apol_vector_t * v1, const apol_vector_t * v2)
+{
+	size_t i, j;
+	CU_ASSERT_EQUAL_FATAL(apol_vector_get_size(v1), apol_vector_get_size(v2));
+	for (i = 0; i < apol_vector_get_size(v1); i++) {
+		const apol_relabel_result_t *r1 = apol_vector_get_element(v1, i), *r2 = apol_vector_get_element(v2, i);
+		const apol_vector_t *l1[3], *l2[3];
+		size_t k;
+		CU_ASSERT(apol_relabel_result_get_result_type(r1) == apol_relabel_result_get_result_type(r2));
+		l1[0] = apol_relabel_result_get_to(r1);
+		l1[1] = apol_relabel_result_get_from(r1);
+		l1[2] = apol_relabel_result_get_both(r1);
+		l2[0] = apol_relabel_result_get_to(r2);
+		l2[1] = apol_relabel_result_get_from(r2);
+		l2[2] = apol_relabel_result_get_both(r2);
+		for (k = 0; k < 3; k++) {
+			CU_ASSERT_EQUAL_FATAL(apol_vector_get_size(l1[k]), apol_vector_get_size(l2[k]));
+			for (j = 0; j < apol_vector_get_size(l1[k]); j++) {
+				const apol_relabel_result_pair_t *p1 = apol_vector_get_element(l1[k], j);
+				const apol_relabel_result_pair_t *p2 = apol_vector_get_element(l2[k], j);
+				CU_ASSERT(apol_relabel_result_pair_get_ruleA(p1) == apol_relabel_result_pair_get_ruleA(p2));
+				CU_ASSERT_PTR_NULL(apol_relabel_result_pair_get_ruleB(p1));
+			}
+		}
+	}
+}
+
+static void relabel_all_domains(void)
+{
+	apol_relabel_analysis_t *r = apol_relabel_analysis_create();
+	apol_vector_t *all = NULL, *v = NULL;
+	const apol_relabel_domain_t *d;
+	const char *name;
+	size_t i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(r);
+	CU_ASSERT_FATAL(apol_relabel_analysis_set_dir(p, r, APOL_RELABEL_DIR_SUBJECT) == 0);
+	CU_ASSERT_FATAL(apol_relabel_analysis_do_all_domains(p, r, &all) == 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(all);
+	CU_ASSERT_FATAL(apol_vector_get_size(all) > 0);
+
+	/* each domain's results are those of its own subject analysis */
+	for (i = 0; i < apol_vector_get_size(all) && i < NUM_COMPARED; i++) {
+		d = apol_vector_get_element(all, i);
+		CU_ASSERT(apol_vector_get_size(apol_relabel_domain_get_results(d)) > 0);
+		CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), apol_relabel_domain_get_domain(d), &name) == 0);
+		CU_ASSERT_FATAL(apol_relabel_analysis_set_type(p, r, name) == 0);
+		CU_ASSERT_FATAL(apol_relabel_analysis_do(p, r, &v) == 0);
+		relabel_compare_results(apol_relabel_domain_get_results(d), v);
+		apol_vector_destroy(&v);
+	}
+	apol_vector_destroy(&all);
+
+	/* appending a subject restricts the domains reported */
+	CU_ASSERT_FATAL(apol_relabel_analysis_append_subject(p, r, name) == 0);
+	CU_ASSERT_FATAL(apol_relabel_analysis_do_all_domains(p, r, &all) == 0);
+	CU_ASSERT_EQUAL_FATAL(apol_vector_get_size(all), 1);
+	d = apol_vector_get_element(all, 0);
+	CU_ASSERT_FATAL(apol_relabel_analysis_do(p, r, &v) == 0);
+	relabel_compare_results(apol_relabel_domain_get_results(d), v);
+	apol_vector_destroy(&v);
+	apol_vector_destroy(&all);
+	apol_relabel_analysis_destroy(&r);
+}
+
+/** One pair of rules within one of a result's lists, flattened so
+ *  that whole result sets may be sorted and compared. */
+typedef struct relabel_entry
+{
+	const qpol_type_t *type;
+	/** 0 for the to list, 1 for from, 2 for both */
+	int list;
+	const qpol_avrule_t *ruleA, *ruleB;
+	const qpol_type_t *intermed;
+} relabel_entry_t;
+
+static int relabel_entry_comp(const void *a, const void *b, void *data __attribute__ ((unused)))
+{
+	const relabel_entry_t *x = a, *y = b;
+	if (x->type != y->type)
+		return (x->type < y->type ? -1 : 1);
+	if (x->list != y->list)
+		return x->list - y->list;
+	if (x->ruleA != y->ruleA)
+		return ((const void *)x->ruleA < (const void *)y->ruleA ? -1 : 1);
+	if (x->ruleB != y->ruleB)
+		return ((const void *)x->ruleB < (const void *)y->ruleB ? -1 : 1);
+	if (x->intermed != y->intermed)
+		return (x->intermed < y->intermed ? -1 : 1);
+	return 0;
+}
+
+static void relabel_entry_append(apol_vector_t * v, const qpol_type_t * type, int list, const qpol_avrule_t * ruleA,
+				 const qpol_avrule_t * ruleB, const qpol_type_t * intermed)
+{
+	relabel_entry_t *e = calloc(1, sizeof(*e));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(e);
+	e->type = type;
+	e->list = list;
+	e->ruleA = ruleA;
+	e->ruleB = ruleB;
+	e->intermed = intermed;
+	CU_ASSERT_FATAL(apol_vector_append(v, e) == 0);
+}
+
+/**
+ * Flatten the analysis's results into a sorted vector of
+ * relabel_entry_t.
+ */
+static apol_vector_t *relabel_flatten(const apol_vector_t * results)
+{
+	apol_vector_t *v = apol_vector_create(free);
+	size_t i, j, k;
+	CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+	for (i = 0; i < apol_vector_get_size(results); i++) {
+		const apol_relabel_result_t *res = apol_vector_get_element(results, i);
+		const apol_vector_t *lists[3];
+		lists[0] = apol_relabel_result_get_to(res);
+		lists[1] = apol_relabel_result_get_from(res);
+		lists[2] = apol_relabel_result_get_both(res);
+		for (k = 0; k < 3; k++) {
+			for (j = 0; j < apol_vector_get_size(lists[k]); j++) {
+				const apol_relabel_result_pair_t *pair = apol_vector_get_element(lists[k], j);
+				relabel_entry_append(v, apol_relabel_result_get_result_type(res), (int)k,
+						     apol_relabel_result_pair_get_ruleA(pair), apol_relabel_result_pair_get_ruleB(pair),
+						     apol_relabel_result_pair_get_intermediate_type(pair));
+			}
+		}
+	}
+	apol_vector_sort(v, relabel_entry_comp, NULL);
+	return v;
+}
+
+/** The types of a type, or of an attribute. */
+static apol_vector_t *relabel_ref_expand(const qpol_type_t * type)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(p);
+	qpol_iterator_t *iter = NULL;
+	apol_vector_t *v;
+	unsigned char isattr;
+
+	CU_ASSERT_FATAL(qpol_type_get_isattr(q, type, &isattr) == 0);
+	if (!isattr) {
+		v = apol_vector_create(NULL);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+		CU_ASSERT_FATAL(apol_vector_append(v, (void *)type) == 0);
+		return v;
+	}
+	CU_ASSERT_FATAL(qpol_type_get_type_iter(q, type, &iter) == 0);
+	v = apol_vector_create_from_iter(iter, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+	qpol_iterator_destroy(&iter);
+	return v;
+}
+
+/** Non-zero if a type, or any type of an attribute, is within v. */
+static int relabel_ref_type_in(const apol_vector_t * v, const qpol_type_t * type)
+{
+	apol_vector_t *types;
+	size_t i, j;
+	int found = 0;
+	if (apol_vector_get_index(v, type, NULL, NULL, &i) == 0)
+		return 1;
+	types = relabel_ref_expand(type);
+	for (i = 0; i < apol_vector_get_size(types) && !found; i++) {
+		found = (apol_vector_get_index(v, apol_vector_get_element(types, i), NULL, NULL, &j) == 0);
+	}
+	apol_vector_destroy(&types);
+	return found;
+}
+
+static int relabel_ref_direction(const qpol_avrule_t * rule)
+{
+	qpol_iterator_t *iter = NULL;
+	char *perm;
+	int to = 0, from = 0;
+	CU_ASSERT_FATAL(qpol_avrule_get_perm_iter(apol_policy_get_qpol(p), rule, &iter) == 0);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&perm) == 0);
+		if (strcmp(perm, "relabelto") == 0)
+			to = 1;
+		else if (strcmp(perm, "relabelfrom") == 0)
+			from = 1;
+		free(perm);
+	}
+	qpol_iterator_destroy(&iter);
+	return (to && from ? APOL_RELABEL_DIR_BOTH : to ? APOL_RELABEL_DIR_TO : APOL_RELABEL_DIR_FROM);
+}
+
+static apol_vector_t *relabel_ref_rules(const char *target, const char *perm)
+{
+	apol_avrule_query_t *q = apol_avrule_query_create();
+	apol_vector_t *v = NULL;
+	CU_ASSERT_PTR_NOT_NULL_FATAL(q);
+	CU_ASSERT_FATAL(apol_avrule_query_set_rules(p, q, QPOL_RULE_ALLOW) == 0);
+	CU_ASSERT_FATAL(apol_avrule_query_set_target(p, q, target, 1) == 0);
+	CU_ASSERT_FATAL(apol_avrule_query_append_perm(p, q, perm) == 0);
+	CU_ASSERT_FATAL(apol_avrule_get_by_query(p, q, &v) == 0);
+	apol_avrule_query_destroy(&q);
+	return v;
+}
+
+/**
+ * One direction of an object mode analysis, done the way the
+ * analysis was done before it was indexed: every rule A that may
+ * relabel the start type is paired with every rule B, of the same
+ * class and for a type of A's source, that may relabel some other
+ * type.
+ */
+static void relabel_ref_object(const qpol_type_t * start, const char *start_name, unsigned int dir,
+			       const apol_vector_t * subjects, apol_vector_t * entries)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(p);
+	apol_vector_t *av, *bv, *start_v, *target_v;
+	const qpol_avrule_t *a, *b;
+	const qpol_type_t *a_source, *b_source, *b_target, *target, *intermed;
+	const qpol_class_t *a_class, *b_class;
+	unsigned char isattrA, isattrB;
+	int dirA, dirB, list;
+	size_t i, j, k;
+
+	av = relabel_ref_rules(start_name, dir == APOL_RELABEL_DIR_TO ? "relabelfrom" : "relabelto");
+	bv = relabel_ref_rules(NULL, dir == APOL_RELABEL_DIR_TO ? "relabelto" : "relabelfrom");
+	for (i = 0; i < apol_vector_get_size(av); i++) {
+		a = apol_vector_get_element(av, i);
+		CU_ASSERT_FATAL(qpol_avrule_get_source_type(q, a, &a_source) == 0);
+		CU_ASSERT_FATAL(qpol_avrule_get_object_class(q, a, &a_class) == 0);
+		if (subjects != NULL && !relabel_ref_type_in(subjects, a_source))
+			continue;
+		start_v = relabel_ref_expand(a_source);
+		for (j = 0; j < apol_vector_get_size(bv); j++) {
+			b = apol_vector_get_element(bv, j);
+			CU_ASSERT_FATAL(qpol_avrule_get_source_type(q, b, &b_source) == 0);
+			CU_ASSERT_FATAL(qpol_avrule_get_target_type(q, b, &b_target) == 0);
+			CU_ASSERT_FATAL(qpol_avrule_get_object_class(q, b, &b_class) == 0);
+			if (!relabel_ref_type_in(start_v, b_source) || b_target == start || a_class != b_class)
+				continue;
+			CU_ASSERT_FATAL(qpol_type_get_isattr(q, a_source, &isattrA) == 0);
+			CU_ASSERT_FATAL(qpol_type_get_isattr(q, b_source, &isattrB) == 0);
+			intermed = ((isattrA && isattrB) || !isattrA ? a_source : b_source);
+			dirA = relabel_ref_direction(a);
+			dirB = relabel_ref_direction(b);
+			list = (dirA == APOL_RELABEL_DIR_BOTH && dirB == APOL_RELABEL_DIR_BOTH ? 2 :
+				dirA == APOL_RELABEL_DIR_FROM || dirB == APOL_RELABEL_DIR_TO ? 0 : 1);
+			target_v = relabel_ref_expand(b_target);
+			for (k = 0; k < apol_vector_get_size(target_v); k++) {
+				target = apol_vector_get_element(target_v, k);
+				if (target == start)
+					continue;
+				if (list == 1)
+					relabel_entry_append(entries, target, list, b, a, intermed);
+				else
+					relabel_entry_append(entries, target, list, a, b, intermed);
+			}
+			apol_vector_destroy(&target_v);
+		}
+		apol_vector_destroy(&start_v);
+	}
+	apol_vector_destroy(&av);
+	apol_vector_destroy(&bv);
+}
+
+/**
+ * Check an object mode analysis's results, in both directions,
+ * against those found by relabel_ref_object().
+ */
+static void relabel_object_check(apol_relabel_analysis_t * r, const qpol_type_t * start, const char *start_name,
+				 const apol_vector_t * subjects)
+{
+	apol_vector_t *v = NULL, *actual, *expected = apol_vector_create(free);
+	size_t i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(expected);
+	CU_ASSERT_FATAL(apol_relabel_analysis_set_dir(p, r, APOL_RELABEL_DIR_BOTH) == 0);
+	CU_ASSERT_FATAL(apol_relabel_analysis_do(p, r, &v) == 0);
+	actual = relabel_flatten(v);
+	relabel_ref_object(start, start_name, APOL_RELABEL_DIR_TO, subjects, expected);
+	relabel_ref_object(start, start_name, APOL_RELABEL_DIR_FROM, subjects, expected);
+	apol_vector_sort(expected, relabel_entry_comp, NULL);
+	CU_ASSERT(apol_vector_get_size(expected) > 0);
+	CU_ASSERT_EQUAL(apol_vector_get_size(actual), apol_vector_get_size(expected));
+	CU_ASSERT(apol_vector_compare(actual, expected, relabel_entry_comp, NULL, &i) == 0);
+	apol_vector_destroy(&actual);
+	apol_vector_destroy(&expected);
+	apol_vector_destroy(&v);
+}
+
+static void relabel_object(void)
+{
+	apol_relabel_analysis_t *r = apol_relabel_analysis_create();
+	apol_vector_t *all = NULL, *v = NULL, *w = NULL;
+	const apol_relabel_domain_t *d;
+	const qpol_type_t *start;
+	const char *name;
+	size_t i, j;
+
+	/* start from a type that some domain may relabel */
+	CU_ASSERT_PTR_NOT_NULL_FATAL(r);
+	CU_ASSERT_FATAL(apol_relabel_analysis_do_all_domains(p, r, &all) == 0);
+	CU_ASSERT_FATAL(apol_vector_get_size(all) > 0);
+	d = apol_vector_get_element(all, 0);
+	start = apol_relabel_result_get_result_type(apol_vector_get_element(apol_relabel_domain_get_results(d), 0));
+	apol_vector_destroy(&all);
+	CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), start, &name) == 0);
+
+	CU_ASSERT_FATAL(apol_relabel_analysis_set_dir(p, r, APOL_RELABEL_DIR_BOTH) == 0);
+	CU_ASSERT_FATAL(apol_relabel_analysis_set_type(p, r, name) == 0);
+	CU_ASSERT_FATAL(apol_relabel_analysis_do(p, r, &v) == 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+	for (i = 0; i < apol_vector_get_size(v); i++) {
+		const apol_relabel_result_t *res = apol_vector_get_element(v, i);
+		const apol_vector_t *to = apol_relabel_result_get_to(res);
+		CU_ASSERT(apol_relabel_result_get_result_type(res) != start);
+		for (j = 0; j < apol_vector_get_size(to); j++) {
+			const apol_relabel_result_pair_t *pair = apol_vector_get_element(to, j);
+			CU_ASSERT_PTR_NOT_NULL(apol_relabel_result_pair_get_ruleA(pair));
+			CU_ASSERT_PTR_NOT_NULL(apol_relabel_result_pair_get_ruleB(pair));
+			CU_ASSERT_PTR_NOT_NULL(apol_relabel_result_pair_get_intermediate_type(pair));
+		}
+		/* a type has only one result node */
+		for (j = 0; j < i; j++) {
+			CU_ASSERT(apol_relabel_result_get_result_type(apol_vector_get_element(v, j)) !=
+				  apol_relabel_result_get_result_type(res));
+		}
+	}
+
+	/* each direction on its own finds a subset of the results */
+	CU_ASSERT_FATAL(apol_relabel_analysis_set_dir(p, r, APOL_RELABEL_DIR_TO) == 0);
+	CU_ASSERT_FATAL(apol_relabel_analysis_do(p, r, &w) == 0);
+	CU_ASSERT(apol_vector_get_size(w) <= apol_vector_get_size(v));
+	apol_vector_destroy(&w);
+
+	/* the results are those that pairing every rule finds, with
+	 * and without a subject filter */
+	relabel_object_check(r, start, name, NULL);
+	{
+		const apol_relabel_result_t *res = apol_vector_get_element(v, 0);
+		const apol_relabel_result_pair_t *pair;
+		const qpol_type_t *subject;
+		const char *subject_name;
+		apol_vector_t *subjects;
+		if (apol_vector_get_size(apol_relabel_result_get_to(res)) > 0)
+			pair = apol_vector_get_element(apol_relabel_result_get_to(res), 0);
+		else if (apol_vector_get_size(apol_relabel_result_get_from(res)) > 0)
+			pair = apol_vector_get_element(apol_relabel_result_get_from(res), 0);
+		else
+			pair = apol_vector_get_element(apol_relabel_result_get_both(res), 0);
+		/* filter upon a type, not an attribute, of some pair's
+		 * intermediate */
+		subjects = relabel_ref_expand(apol_relabel_result_pair_get_intermediate_type(pair));
+		CU_ASSERT_FATAL(apol_vector_get_size(subjects) > 0);
+		subject = apol_vector_get_element(subjects, 0);
+		apol_vector_destroy(&subjects);
+		subjects = apol_vector_create(NULL);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(subjects);
+		CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), subject, &subject_name) == 0);
+		CU_ASSERT_FATAL(apol_relabel_analysis_append_subject(p, r, subject_name) == 0);
+		CU_ASSERT_FATAL(apol_vector_append(subjects, (void *)subject) == 0);
+		relabel_object_check(r, start, name, subjects);
+		CU_ASSERT_FATAL(apol_relabel_analysis_append_subject(p, r, NULL) == 0);
+		apol_vector_destroy(&subjects);
+	}
+
+	/* a result regex that matches nothing leaves no results */
+	CU_ASSERT_FATAL(apol_relabel_analysis_set_result_regex(p, r, "^no_such_type_t$") == 0);
+	CU_ASSERT_FATAL(apol_relabel_analysis_do(p, r, &w) == 0);
+	CU_ASSERT_EQUAL(apol_vector_get_size(w), 0);
+	apol_vector_destroy(&w);
+
+	apol_vector_destroy(&v);
+	apol_relabel_analysis_destroy(&r);
+}
+
+CU_TestInfo relabel_tests[] = {
+	{"object mode", relabel_object}
+	,
+	{"all domains", relabel_all_domains}
+	,
+	CU_TEST_INFO_NULL
+};
+
+int relabel_init()
+{
+	apol_policy_path_t *ppath = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, BIG_POLICY, NULL);
+	if (ppath == NULL) {
+		return 1;
+	}
+
+	if ((p = apol_policy_create_from_policy_path(ppath, QPOL_POLICY_OPTION_NO_NEVERALLOWS, NULL, NULL)) == NULL) {
+		apol_policy_path_destroy(&ppath);
+		return 1;
+	}
+	apol_policy_path_destroy(&ppath);
+
+	return 0;
+}
+
+int relabel_cleanup()
+{
+	apol_policy_destroy(&p);
+	return 0;
+}
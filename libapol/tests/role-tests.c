@@ -121,11 +121,87 @@ static void role_regex(void)
 	apol_role_query_destroy(&q);
 }
 
+static void role_has_type(void)
+{
+	qpol_iterator_t *riter = NULL, *titer = NULL, *iter = NULL;
+	apol_vector_t *types = NULL, *role_types = NULL;
+	const qpol_role_t *role;
+	const qpol_type_t *type;
+	unsigned char isattr;
+	size_t i, j;
+	int pass;
+
+	CU_ASSERT_FATAL(qpol_policy_get_type_iter(qp, &titer) == 0);
+	types = apol_vector_create_from_iter(titer, NULL);
+	qpol_iterator_destroy(&titer);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(types);
+
+	/* the second pass follows a reset of the cached memberships */
+	for (pass = 0; pass < 2; pass++) {
+		CU_ASSERT_FATAL(qpol_policy_get_role_iter(qp, &riter) == 0);
+		for (; !qpol_iterator_end(riter); qpol_iterator_next(riter)) {
+			CU_ASSERT_FATAL(qpol_iterator_get_item(riter, (void **)&role) == 0);
+			CU_ASSERT_FATAL(qpol_role_get_type_iter(qp, role, &iter) == 0);
+			role_types = apol_vector_create_from_iter(iter, NULL);
+			qpol_iterator_destroy(&iter);
+			CU_ASSERT_PTR_NOT_NULL_FATAL(role_types);
+			for (i = 0; i < apol_vector_get_size(types); i++) {
+				type = apol_vector_get_element(types, i);
+				CU_ASSERT_FATAL(qpol_type_get_isattr(qp, type, &isattr) == 0);
+				if (isattr) {
+					continue;
+				}
+				CU_ASSERT(apol_role_has_type(sp, role, type) ==
+					  (apol_vector_get_index(role_types, type, NULL, NULL, &j) == 0));
+			}
+			apol_vector_destroy(&role_types);
+		}
+		qpol_iterator_destroy(&riter);
+		apol_policy_reset_membership(sp);
+	}
+	apol_vector_destroy(&types);
+}
+
+static void role_has_type_rebuild(void)
+{
+	apol_role_query_t *q = apol_role_query_create();
+	apol_vector_t *v = NULL;
+	unsigned int before, after;
+	const char *name;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(q);
+	apol_role_query_set_type(sp, q, "file");
+	CU_ASSERT_FATAL(apol_role_get_by_query(sp, q, &v) == 0);
+	CU_ASSERT(apol_vector_get_size(v) == 1);
+	apol_vector_destroy(&v);
+
+	/* the memberships are not reset here; rebuilding the policy
+	 * frees every type and role they hold, so they must notice on
+	 * their own */
+	CU_ASSERT_FATAL(qpol_policy_get_generation(qp, &before) == 0);
+	CU_ASSERT_FATAL(qpol_policy_rebuild(qp, QPOL_POLICY_OPTION_NO_NEVERALLOWS) == 0);
+	CU_ASSERT_FATAL(qpol_policy_get_generation(qp, &after) == 0);
+	CU_ASSERT(after != before);
+
+	CU_ASSERT_FATAL(apol_role_get_by_query(sp, q, &v) == 0);
+	CU_ASSERT_FATAL(v != NULL && apol_vector_get_size(v) == 1);
+	qpol_role_get_name(qp, apol_vector_get_element(v, 0), &name);
+	CU_ASSERT_STRING_EQUAL(name, "object_r");
+	apol_vector_destroy(&v);
+	apol_role_query_destroy(&q);
+
+	role_has_type();
+}
+
 CU_TestInfo role_tests[] = {
 	{"basic query", role_basic}
 	,
 	{"regex query", role_regex}
 	,
+	{"has type", role_has_type}
+	,
+	{"has type after rebuild", role_has_type_rebuild}
+	,
 	CU_TEST_INFO_NULL
 };
 
@@ -0,0 +1,376 @@
+/**
+ *  @file
+ *
+ *  Test the domain access similarity engine.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <CUnit/CUnit.h>
+#include <apol/avrule-query.h>
+#include <apol/policy.h>
+#include <apol/policy-path.h>
+#include <apol/type-similarity.h>
+#include <apol/util.h>
+#include <qpol/avrule_query.h>
+#include <qpol/type_query.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIG_POLICY TEST_POLICIES "/snapshots/fc4_targeted.policy.conf"
+
+static apol_policy_t *p = NULL;
+static apol_type_similarity_t *exact = NULL, *sketched = NULL;
+
+/**
+ * Return true if a vector of pairs holds a pair of these domains.
+ */
+static bool type_similarity_has_pair(const apol_vector_t * pairs, const qpol_type_t * first, const qpol_type_t * other)
+{
+	size_t i;
+	for (i = 0; i < apol_vector_get_size(pairs); i++) {
+		const apol_type_similarity_pair_t *pair = apol_vector_get_element(pairs, i);
+		if (apol_type_similarity_pair_get_first(pair) == first && apol_type_similarity_pair_get_other(pair) == other) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Build a domain's signature without the engine: every allow rule
+ * whose source is the domain or one of its attributes, each expanded
+ * into "target class permission" strings.
+ */
+static apol_vector_t *type_similarity_ref_signature(const char *domain)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(p);
+	apol_avrule_query_t *query = apol_avrule_query_create();
+	apol_vector_t *rules = NULL, *sig = apol_vector_create(free), *targets;
+	qpol_iterator_t *iter = NULL;
+	const qpol_avrule_t *rule;
+	const qpol_type_t *target;
+	const qpol_class_t *obj_class;
+	const char *target_name, *class_name;
+	unsigned char isattr;
+	char *perm, *access;
+	size_t i, j, sz;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(query);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(sig);
+	apol_avrule_query_set_rules(p, query, QPOL_RULE_ALLOW);
+	CU_ASSERT_FATAL(apol_avrule_query_set_source(p, query, domain, 1) == 0);
+	CU_ASSERT_FATAL(apol_avrule_get_by_query(p, query, &rules) == 0);
+	apol_avrule_query_destroy(&query);
+	for (i = 0; i < apol_vector_get_size(rules); i++) {
+		rule = apol_vector_get_element(rules, i);
+		CU_ASSERT_FATAL(qpol_avrule_get_target_type(q, rule, &target) == 0);
+		CU_ASSERT_FATAL(qpol_avrule_get_object_class(q, rule, &obj_class) == 0);
+		CU_ASSERT_FATAL(qpol_class_get_name(q, obj_class, &class_name) == 0);
+		CU_ASSERT_FATAL(qpol_type_get_isattr(q, target, &isattr) == 0);
+		if (isattr) {
+			CU_ASSERT_FATAL(qpol_type_get_type_iter(q, target, &iter) == 0);
+			targets = apol_vector_create_from_iter(iter, NULL);
+			qpol_iterator_destroy(&iter);
+		} else {
+			targets = apol_vector_create(NULL);
+			CU_ASSERT_PTR_NOT_NULL_FATAL(targets);
+			CU_ASSERT_FATAL(apol_vector_append(targets, (void *)target) == 0);
+		}
+		CU_ASSERT_PTR_NOT_NULL_FATAL(targets);
+		for (j = 0; j < apol_vector_get_size(targets); j++) {
+			CU_ASSERT_FATAL(qpol_type_get_name(q, apol_vector_get_element(targets, j), &target_name) == 0);
+			CU_ASSERT_FATAL(qpol_avrule_get_perm_iter(q, rule, &iter) == 0);
+			for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+				CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&perm) == 0);
+				access = NULL;
+				sz = 0;
+				CU_ASSERT_FATAL(apol_str_appendf(&access, &sz, "%s %s %s", target_name, class_name, perm) == 0);
+				CU_ASSERT_FATAL(apol_vector_append(sig, access) == 0);
+				free(perm);
+			}
+			qpol_iterator_destroy(&iter);
+		}
+		apol_vector_destroy(&targets);
+	}
+	apol_vector_destroy(&rules);
+	apol_vector_sort_uniquify(sig, apol_str_strcmp, NULL);
+	return sig;
+}
+
+/**
+ * Check a pair's signatures and exact similarity against those built
+ * without the engine.
+ */
+static void type_similarity_check_pair(size_t a, size_t b)
+{
+	apol_vector_t *sig_a, *sig_b;
+	const char *name;
+	size_t i = 0, j = 0, common = 0;
+	double sim;
+	int cmp;
+
+	CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), apol_type_similarity_get_domain(exact, a), &name) == 0);
+	sig_a = type_similarity_ref_signature(name);
+	CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), apol_type_similarity_get_domain(exact, b), &name) == 0);
+	sig_b = type_similarity_ref_signature(name);
+	CU_ASSERT_EQUAL(apol_type_similarity_get_num_accesses(exact, a), apol_vector_get_size(sig_a));
+	CU_ASSERT_EQUAL(apol_type_similarity_get_num_accesses(exact, b), apol_vector_get_size(sig_b));
+	while (i < apol_vector_get_size(sig_a) && j < apol_vector_get_size(sig_b)) {
+		cmp = strcmp(apol_vector_get_element(sig_a, i), apol_vector_get_element(sig_b, j));
+		if (cmp < 0) {
+			i++;
+		} else if (cmp > 0) {
+			j++;
+		} else {
+			common++;
+			i++;
+			j++;
+		}
+	}
+	CU_ASSERT_FATAL(apol_type_similarity_compare(exact, a, b, &sim) == 0);
+	CU_ASSERT_DOUBLE_EQUAL(sim,
+			       (double)common / (double)(apol_vector_get_size(sig_a) + apol_vector_get_size(sig_b) - common),
+			       1e-9);
+	apol_vector_destroy(&sig_a);
+	apol_vector_destroy(&sig_b);
+}
+
+static void type_similarity_domains(void)
+{
+	size_t n = apol_type_similarity_get_num_domains(exact), i, j;
+	const char *name;
+	double sim, est;
+
+	CU_ASSERT_FATAL(n > 1);
+	CU_ASSERT_EQUAL_FATAL(apol_type_similarity_get_num_domains(sketched), n);
+	for (i = 0; i < n; i++) {
+		CU_ASSERT(apol_type_similarity_get_domain(exact, i) == apol_type_similarity_get_domain(sketched, i));
+		CU_ASSERT(apol_type_similarity_get_num_accesses(exact, i) > 0);
+	}
+	CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), apol_type_similarity_get_domain(exact, n - 1), &name) == 0);
+	CU_ASSERT_FATAL(apol_type_similarity_get_domain_index(exact, name, &i) == 0);
+	CU_ASSERT_EQUAL(i, n - 1);
+	CU_ASSERT(apol_type_similarity_get_domain_index(exact, "no_such_type_t", &i) < 0);
+
+	/* a domain is wholly like itself, and likeness is symmetric */
+	for (i = 0; i < n && i < 16; i++) {
+		CU_ASSERT(apol_type_similarity_compare(exact, i, i, &sim) == 0 && sim == 1.0);
+		CU_ASSERT(apol_type_similarity_estimate(sketched, i, i, &est) == 0 && est == 1.0);
+		j = n - 1 - i;
+		CU_ASSERT_FATAL(apol_type_similarity_compare(exact, i, j, &sim) == 0);
+		CU_ASSERT_FATAL(apol_type_similarity_compare(exact, j, i, &est) == 0);
+		CU_ASSERT(sim == est);
+		CU_ASSERT(sim >= 0.0 && sim <= 1.0);
+	}
+	/* without sketches there is nothing to estimate */
+	CU_ASSERT(apol_type_similarity_estimate(exact, 0, 1, &est) < 0);
+}
+
+static void type_similarity_reference(void)
+{
+	apol_vector_t *found = NULL;
+	size_t n = apol_type_similarity_get_num_domains(exact), a, b;
+	const char *name;
+
+	CU_ASSERT_FATAL(n > 1);
+	type_similarity_check_pair(0, 1);
+	type_similarity_check_pair(0, n - 1);
+
+	/* a pair alike enough to be found, so that the check covers a
+	 * non-trivial overlap */
+	CU_ASSERT_FATAL(apol_type_similarity_find_pairs(exact, 0.5, &found) == 0);
+	if (apol_vector_get_size(found) > 0) {
+		const apol_type_similarity_pair_t *pair = apol_vector_get_element(found, 0);
+		CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), apol_type_similarity_pair_get_first(pair), &name) == 0);
+		CU_ASSERT_FATAL(apol_type_similarity_get_domain_index(exact, name, &a) == 0);
+		CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), apol_type_similarity_pair_get_other(pair), &name) == 0);
+		CU_ASSERT_FATAL(apol_type_similarity_get_domain_index(exact, name, &b) == 0);
+		type_similarity_check_pair(a, b);
+	}
+	apol_vector_destroy(&found);
+}
+
+static void type_similarity_domain_set(void)
+{
+	apol_type_similarity_t *s;
+	apol_vector_t *names = apol_vector_create(NULL);
+	const char *name;
+	size_t i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(names);
+
+	/* naming the default attribute is the same as naming none */
+	CU_ASSERT_FATAL(apol_vector_append(names, APOL_TYPE_SIMILARITY_DOMAIN_ATTRIB) == 0);
+	s = apol_type_similarity_create(p, names, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(s);
+	CU_ASSERT_EQUAL(apol_type_similarity_get_num_domains(s), apol_type_similarity_get_num_domains(exact));
+	apol_type_similarity_destroy(&s);
+
+	/* a single type yields just that domain, with the same signature */
+	CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), apol_type_similarity_get_domain(exact, 1), &name) == 0);
+	apol_vector_destroy(&names);
+	names = apol_vector_create(NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(names);
+	CU_ASSERT_FATAL(apol_vector_append(names, (void *)name) == 0);
+	s = apol_type_similarity_create(p, names, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(s);
+	CU_ASSERT_EQUAL(apol_type_similarity_get_num_domains(s), 1);
+	CU_ASSERT(apol_type_similarity_get_domain(s, 0) == apol_type_similarity_get_domain(exact, 1));
+	CU_ASSERT_EQUAL(apol_type_similarity_get_num_accesses(s, 0), apol_type_similarity_get_num_accesses(exact, 1));
+	CU_ASSERT(apol_type_similarity_get_domain_index(s, name, &i) == 0 && i == 0);
+	apol_type_similarity_destroy(&s);
+
+	/* an unknown name is an error */
+	CU_ASSERT_FATAL(apol_vector_append(names, "no_such_type_t") == 0);
+	s = apol_type_similarity_create(p, names, 0);
+	CU_ASSERT_PTR_NULL(s);
+	apol_vector_destroy(&names);
+}
+
+static void type_similarity_pairs(void)
+{
+	apol_vector_t *all = NULL, *found = NULL;
+	size_t i;
+	double sim, est;
+
+	/* identical signatures have identical sketches, so they are
+	 * never missed */
+	CU_ASSERT_FATAL(apol_type_similarity_find_pairs(exact, 1.0, &all) == 0);
+	CU_ASSERT_FATAL(apol_type_similarity_find_pairs(sketched, 1.0, &found) == 0);
+	CU_ASSERT_EQUAL(apol_vector_get_size(all), apol_vector_get_size(found));
+	for (i = 0; i < apol_vector_get_size(found); i++) {
+		const apol_type_similarity_pair_t *pair = apol_vector_get_element(found, i);
+		CU_ASSERT(apol_type_similarity_pair_get_similarity(pair) == 1.0);
+		CU_ASSERT(type_similarity_has_pair(all, apol_type_similarity_pair_get_first(pair),
+						   apol_type_similarity_pair_get_other(pair)));
+	}
+	apol_vector_destroy(&all);
+	apol_vector_destroy(&found);
+
+	/* below that, the sketches find only pairs that truly pass */
+	CU_ASSERT_FATAL(apol_type_similarity_find_pairs(exact, 0.8, &all) == 0);
+	CU_ASSERT_FATAL(apol_type_similarity_find_pairs(sketched, 0.8, &found) == 0);
+	CU_ASSERT(apol_vector_get_size(found) <= apol_vector_get_size(all));
+	for (i = 0; i < apol_vector_get_size(found); i++) {
+		const apol_type_similarity_pair_t *pair = apol_vector_get_element(found, i);
+		size_t a, b;
+		const char *name;
+		CU_ASSERT(apol_type_similarity_pair_get_similarity(pair) >= 0.8);
+		CU_ASSERT(type_similarity_has_pair(all, apol_type_similarity_pair_get_first(pair),
+						   apol_type_similarity_pair_get_other(pair)));
+		CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), apol_type_similarity_pair_get_first(pair), &name) == 0);
+		CU_ASSERT_FATAL(apol_type_similarity_get_domain_index(sketched, name, &a) == 0);
+		CU_ASSERT_FATAL(qpol_type_get_name(apol_policy_get_qpol(p), apol_type_similarity_pair_get_other(pair), &name) == 0);
+		CU_ASSERT_FATAL(apol_type_similarity_get_domain_index(sketched, name, &b) == 0);
+		CU_ASSERT(a < b);
+		CU_ASSERT_FATAL(apol_type_similarity_compare(sketched, a, b, &sim) == 0);
+		CU_ASSERT(sim == apol_type_similarity_pair_get_similarity(pair));
+		CU_ASSERT_FATAL(apol_type_similarity_estimate(sketched, a, b, &est) == 0);
+		CU_ASSERT(est > sim - 0.25 && est < sim + 0.25);
+	}
+	apol_vector_destroy(&all);
+	apol_vector_destroy(&found);
+
+	CU_ASSERT(apol_type_similarity_find_pairs(exact, 0.0, &found) < 0);
+	CU_ASSERT_PTR_NULL(found);
+	CU_ASSERT(apol_type_similarity_find_pairs(exact, 1.5, &found) < 0);
+}
+
+static void type_similarity_clusters(void)
+{
+	apol_vector_t *pairs = NULL, *clusters = NULL;
+	size_t i, j, k, total = 0;
+	const qpol_type_t *first, *other;
+
+	CU_ASSERT_FATAL(apol_type_similarity_find_pairs(exact, 1.0, &pairs) == 0);
+	CU_ASSERT_FATAL(apol_type_similarity_find_clusters(exact, 1.0, &clusters) == 0);
+	for (i = 0; i < apol_vector_get_size(clusters); i++) {
+		const apol_vector_t *c = apol_vector_get_element(clusters, i);
+		CU_ASSERT(apol_vector_get_size(c) >= 2);
+		total += apol_vector_get_size(c);
+		/* identical signatures are alike to each other */
+		first = apol_vector_get_element(c, 0);
+		for (j = 1; j < apol_vector_get_size(c); j++) {
+			other = apol_vector_get_element(c, j);
+			CU_ASSERT(type_similarity_has_pair(pairs, first, other));
+		}
+	}
+	/* each pair's domains are within the same group */
+	for (i = 0; i < apol_vector_get_size(pairs); i++) {
+		const apol_type_similarity_pair_t *pair = apol_vector_get_element(pairs, i);
+		bool same = false;
+		first = apol_type_similarity_pair_get_first(pair);
+		other = apol_type_similarity_pair_get_other(pair);
+		for (j = 0; j < apol_vector_get_size(clusters) && !same; j++) {
+			const apol_vector_t *c = apol_vector_get_element(clusters, j);
+			if (apol_vector_get_index(c, first, NULL, NULL, &k) == 0) {
+				same = (apol_vector_get_index(c, other, NULL, NULL, &k) == 0);
+				break;
+			}
+		}
+		CU_ASSERT(same);
+	}
+	CU_ASSERT(total <= apol_type_similarity_get_num_domains(exact));
+	apol_vector_destroy(&pairs);
+	apol_vector_destroy(&clusters);
+}
+
+CU_TestInfo type_similarity_tests[] = {
+	{"domains", type_similarity_domains}
+	,
+	{"reference signatures", type_similarity_reference}
+	,
+	{"domain set", type_similarity_domain_set}
+	,
+	{"pairs", type_similarity_pairs}
+	,
+	{"clusters", type_similarity_clusters}
+	,
+	CU_TEST_INFO_NULL
+};
+
+int type_similarity_init()
+{
+	apol_policy_path_t *ppath = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, BIG_POLICY, NULL);
+	if (ppath == NULL) {
+		return 1;
+	}
+
+	if ((p = apol_policy_create_from_policy_path(ppath, QPOL_POLICY_OPTION_NO_NEVERALLOWS, NULL, NULL)) == NULL) {
+		apol_policy_path_destroy(&ppath);
+		return 1;
+	}
+	apol_policy_path_destroy(&ppath);
+
+	if ((exact = apol_type_similarity_create(p, NULL, 0)) == NULL ||
+	    (sketched = apol_type_similarity_create(p, NULL, APOL_TYPE_SIMILARITY_DEFAULT_HASHES)) == NULL) {
+		return 1;
+	}
+	return 0;
+}
+
+int type_similarity_cleanup()
+{
+	apol_type_similarity_destroy(&exact);
+	apol_type_similarity_destroy(&sketched);
+	apol_policy_destroy(&p);
+	return 0;
+}
@@ -26,10 +26,12 @@
 #include <config.h>
 
 #include <CUnit/CUnit.h>
+#include <apol/mls-batch.h>
 #include <apol/user-query.h>
 #include <apol/policy.h>
 #include <apol/policy-path.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #define SOURCE_POLICY TEST_POLICIES "/setools/apol/user_mls_testing_policy.conf"
 
@@ -126,11 +128,140 @@ static void user_regex(void)
 	apol_user_query_destroy(&q);
 }
 
+static void user_mls_batch(void)
+{
+	apol_vector_t *ranges = apol_vector_create(NULL), *levels = apol_vector_create(NULL), *v;
+	CU_ASSERT_PTR_NOT_NULL_FATAL(ranges);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(levels);
+
+	/* gather every user's range, and every level within those
+	 * ranges */
+	qpol_iterator_t *iter = NULL;
+	int retval = qpol_policy_get_user_iter(qp, &iter);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		qpol_user_t *u;
+		const qpol_mls_range_t *qrange;
+		qpol_iterator_get_item(iter, (void **)&u);
+		retval = qpol_user_get_range(qp, u, &qrange);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		apol_mls_range_t *range = apol_mls_range_create_from_qpol_mls_range(sp, qrange);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(range);
+		retval = apol_vector_append(ranges, range);
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+		v = apol_mls_range_get_levels(sp, range);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+		for (size_t k = 0; k < apol_vector_get_size(v); k++) {
+			apol_mls_level_t *l = apol_mls_level_create_from_mls_level(apol_vector_get_element(v, k));
+			CU_ASSERT_PTR_NOT_NULL_FATAL(l);
+			retval = apol_vector_append(levels, l);
+			CU_ASSERT_EQUAL_FATAL(retval, 0);
+		}
+		apol_vector_destroy(&v);
+	}
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT_FATAL(apol_vector_get_size(ranges) > 0 && apol_vector_get_size(levels) > 0);
+
+	apol_mls_range_batch_t *rb = apol_mls_range_batch_create(sp);
+	apol_mls_level_batch_t *lb = apol_mls_level_batch_create(sp);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(rb);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(lb);
+	size_t i, j, num_ranges = apol_vector_get_size(ranges), num_levels = apol_vector_get_size(levels);
+	for (i = 0; i < num_ranges; i++) {
+		retval = apol_mls_range_batch_append(rb, apol_vector_get_element(ranges, i));
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+	}
+	for (i = 0; i < num_levels; i++) {
+		retval = apol_mls_level_batch_append(lb, apol_vector_get_element(levels, i));
+		CU_ASSERT_EQUAL_FATAL(retval, 0);
+	}
+	CU_ASSERT(apol_mls_range_batch_get_size(rb) == num_ranges);
+	CU_ASSERT(apol_mls_level_batch_get_size(lb) == num_levels);
+
+	/* batched answers must match the one-at-a-time answers for
+	 * every pair */
+	apol_mls_batch_pair_t *pairs = calloc(num_ranges * num_levels + num_levels * num_levels, sizeof(*pairs));
+	int *results = calloc(num_ranges * num_levels + num_levels * num_levels, sizeof(*results));
+	CU_ASSERT_PTR_NOT_NULL_FATAL(pairs);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(results);
+
+	for (i = 0; i < num_ranges; i++) {
+		for (j = 0; j < num_levels; j++) {
+			pairs[i * num_levels + j].first = i;
+			pairs[i * num_levels + j].second = j;
+		}
+	}
+	retval = apol_mls_range_batch_include_levels(rb, lb, pairs, num_ranges * num_levels, results);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	for (i = 0; i < num_ranges * num_levels; i++) {
+		apol_mls_range_t *sub = apol_mls_range_create();
+		apol_mls_level_t *l =
+			apol_mls_level_create_from_mls_level(apol_vector_get_element(levels, pairs[i].second));
+		CU_ASSERT_PTR_NOT_NULL_FATAL(sub);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(l);
+		apol_mls_range_set_low(sp, sub, l);
+		retval = apol_mls_range_contain_subrange(sp, apol_vector_get_element(ranges, pairs[i].first), sub);
+		CU_ASSERT(retval == results[i]);
+		apol_mls_range_destroy(&sub);
+	}
+
+	for (i = 0; i < num_ranges; i++) {
+		pairs[i].first = 0;
+		pairs[i].second = i;
+	}
+	retval = apol_mls_range_batch_contain_subranges(rb, rb, pairs, num_ranges, results);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	for (i = 0; i < num_ranges; i++) {
+		retval = apol_mls_range_contain_subrange(sp, apol_vector_get_element(ranges, 0),
+							 apol_vector_get_element(ranges, i));
+		CU_ASSERT(retval == results[i]);
+	}
+
+	for (i = 0; i < num_levels; i++) {
+		for (j = 0; j < num_levels; j++) {
+			pairs[i * num_levels + j].first = i;
+			pairs[i * num_levels + j].second = j;
+		}
+	}
+	retval = apol_mls_level_batch_compare(lb, lb, pairs, num_levels * num_levels, results);
+	CU_ASSERT_EQUAL_FATAL(retval, 0);
+	for (i = 0; i < num_levels * num_levels; i++) {
+		retval = apol_mls_level_compare(sp, apol_vector_get_element(levels, pairs[i].first),
+						apol_vector_get_element(levels, pairs[i].second));
+		CU_ASSERT(retval == results[i]);
+	}
+	CU_ASSERT(results[0] == APOL_MLS_EQ);
+
+	/* out of bounds indices are rejected */
+	pairs[0].first = num_levels;
+	CU_ASSERT(apol_mls_level_batch_compare(lb, lb, pairs, 1, results) < 0);
+	CU_ASSERT(apol_mls_level_batch_compare(lb, lb, NULL, num_levels + 1, results) < 0);
+
+	free(pairs);
+	free(results);
+	apol_mls_range_batch_destroy(&rb);
+	apol_mls_level_batch_destroy(&lb);
+	CU_ASSERT_PTR_NULL(rb);
+	CU_ASSERT_PTR_NULL(lb);
+	for (i = 0; i < num_ranges; i++) {
+		apol_mls_range_t *range = apol_vector_get_element(ranges, i);
+		apol_mls_range_destroy(&range);
+	}
+	for (i = 0; i < num_levels; i++) {
+		apol_mls_level_t *level = apol_vector_get_element(levels, i);
+		apol_mls_level_destroy(&level);
+	}
+	apol_vector_destroy(&ranges);
+	apol_vector_destroy(&levels);
+}
+
 CU_TestInfo user_tests[] = {
 	{"basic query", user_basic}
 	,
 	{"regex query", user_regex}
 	,
+	{"MLS batch comparisons", user_mls_batch}
+	,
 	CU_TEST_INFO_NULL
 };
 
@@ -539,6 +539,8 @@ int poldiff_run(poldiff_t * diff, uint32_t flags)
 		if (qpol_policy_rebuild(diff->mod_qpol, policy_opts)) {
 			return -1;
 		}
+		apol_policy_reset_membership(diff->orig_pol);
+		apol_policy_reset_membership(diff->mod_pol);
 		// force flushing of existing pointers into policies
 		diff->remapped = 1;
 		diff->policy_opts = policy_opts;
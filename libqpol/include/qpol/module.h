@@ -30,7 +30,9 @@ extern "C"
 {
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
+#include <qpol/policy.h>
 
 	typedef struct qpol_module qpol_module_t;
 
@@ -51,6 +53,30 @@ extern "C"
  */
 	extern int qpol_module_create_from_file(const char *path, qpol_module_t ** module);
 
+/**
+ *  Create qpol modules from several policy package files, reading
+ *  (and decompressing) the files concurrently.  Each module is the
+ *  same as qpol_module_create_from_file() would create.
+ *  @param policy (Optional) Policy whose callback receives libsepol's
+ *  messages about each file.  The messages are held while the files
+ *  are read, then delivered by the calling thread in the order of
+ *  paths, each prefixed by its file's path.  If NULL, they are
+ *  printed to stderr.
+ *  @param paths Array of files from which to read the modules.
+ *  @param num_paths Number of files within paths.
+ *  @param modules Array of num_paths references in which to store the
+ *  newly allocated modules, in the same order as paths.  The caller
+ *  is responsible for calling qpol_module_destroy() on each of them.
+ *  @param num_threads Largest number of files to read at once, or 0
+ *  for the number of online processors.
+ *  @param failed (Optional) If non-NULL, set to the index of a file
+ *  that could not be read if the call fails.
+ *  @return 0 on success and < 0 on failure; if the call fails,
+ *  errno will be set and every element of modules will be NULL.
+ */
+	extern int qpol_module_create_from_files(const qpol_policy_t * policy, const char *const *paths, size_t num_paths,
+						 qpol_module_t ** modules, size_t num_threads, size_t * failed);
+
 /**
  *  Free all memory used by a qpol module and set it to NULL.  Does
  *  nothing if the pointer is already NULL.
@@ -59,6 +59,7 @@ extern "C"
 #include <qpol/rbacrule_query.h>
 #include <qpol/ftrule_query.h>
 #include <qpol/role_query.h>
+#include <qpol/summary_query.h>
 #include <qpol/syn_rule_query.h>
 #include <qpol/terule_query.h>
 #include <qpol/type_query.h>
@@ -79,7 +80,9 @@ extern "C"
 
 /**
  *  When loading the policy, do not load any rules;
- *  this option implies QPOL_POLICY_OPTION_NO_NEVERALLOWS.
+ *  this option implies QPOL_POLICY_OPTION_NO_NEVERALLOWS.  The rules
+ *  of a binary policy opened with this option may be loaded later by
+ *  qpol_policy_rebuild().
  */
 #define QPOL_POLICY_OPTION_NO_RULES       0x00000002
 
@@ -220,6 +223,11 @@ extern "C"
  *  modules with the base and then call expand. If the syntactic rule
  *  table was previously built, the caller should call
  *  qpol_policy_build_syn_rule_table() after calling this function.
+ *  For a binary policy that was opened with QPOL_POLICY_OPTION_NO_RULES,
+ *  rebuilding without that option reads its rules from the still mapped
+ *  policy file (which must not have been changed in the meantime);
+ *  all other components remain valid.  Otherwise rebuilding a binary
+ *  policy does nothing.
  *  @param policy The policy to rebuild.
  *  This policy will be altered by this function.
  *  @param options Options to control loading only portions of a policy;
@@ -259,6 +267,21 @@ extern "C"
  */
 	extern int qpol_policy_get_type(const qpol_policy_t * policy, int *type);
 
+/**
+ *  Get the policy's generation, which changes each time
+ *  qpol_policy_rebuild() replaces the policy.  Every qpol_type_t,
+ *  qpol_role_t, and other item obtained before then is freed; callers
+ *  that cache such items may compare generations to detect this.  No
+ *  two policies loaded by a process share a generation, so a policy
+ *  later allocated at the address of a destroyed one is told apart.
+ *  @param policy The policy from which to get the generation.
+ *  @param generation Pointer to the integer in which to store the
+ *  generation.
+ *  @return 0 on success and < 0 on failure; if the call fails,
+ *  errno will be set and *generation will be 0.
+ */
+	extern int qpol_policy_get_generation(const qpol_policy_t * policy, unsigned int *generation);
+
 /**
  *  Determine if a policy has support for a specific capability.
  *  @param policy The policy to check.
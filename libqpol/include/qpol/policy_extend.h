@@ -45,6 +45,25 @@ extern "C"
  */
 	extern int qpol_policy_build_syn_rule_table(qpol_policy_t * policy);
 
+/**
+ *  Index the syntactic rules of a source policy without building the
+ *  syntactic rule table.  The expanded source and target types of
+ *  each rule, and the rules naming each class, are kept; the
+ *  syntactic rules of a semantic rule are then found when first
+ *  asked for, and remembered.  This is much cheaper than
+ *  qpol_policy_build_syn_rule_table() when only a few rules will be
+ *  traced back, such as for a narrow query.  The lookup functions
+ *  below behave the same with either, though in this mode they
+ *  modify the index and so must not be called concurrently on one
+ *  policy.  This function has no effect if either the table or the
+ *  index has already been built.
+ *  @param policy The policy whose rules to index.
+ *  This policy will be modified by this call.
+ *  @return 0 on success and < 0 on error; if the call fails,
+ *  errno will be set.
+ */
+	extern int qpol_policy_build_syn_rule_index(qpol_policy_t * policy);
+
 /* forward declarations: see avrule_query.h and terule_query.h */
 	struct qpol_avrule;
 	struct qpol_terule;
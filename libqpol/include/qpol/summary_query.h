@@ -0,0 +1,155 @@
+/**
+ *  @file
+ *  Defines the public interface for a policy's summary: the number of
+ *  each kind of component and rule, and the members of each attribute
+ *  and role.  The summary is computed once, so that tools which
+ *  report on every component need not walk the policy again for each
+ *  one.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QPOL_SUMMARY_QUERY_H
+#define QPOL_SUMMARY_QUERY_H
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <qpol/policy.h>
+#include <qpol/role_query.h>
+#include <qpol/type_query.h>
+
+/** The counts kept within a policy summary. */
+	typedef enum qpol_summary_count
+	{
+		QPOL_SUMMARY_CLASSES = 0,
+		/** distinct permission names, within classes and commons */
+		QPOL_SUMMARY_PERMS,
+		QPOL_SUMMARY_LEVELS,
+		QPOL_SUMMARY_CATS,
+		/** types, not counting aliases or attributes */
+		QPOL_SUMMARY_TYPES,
+		QPOL_SUMMARY_ATTRIBUTES,
+		QPOL_SUMMARY_USERS,
+		QPOL_SUMMARY_ROLES,
+		QPOL_SUMMARY_BOOLS,
+		QPOL_SUMMARY_CONDS,
+		QPOL_SUMMARY_ALLOWS,
+		QPOL_SUMMARY_NEVERALLOWS,
+		QPOL_SUMMARY_AUDITALLOWS,
+		QPOL_SUMMARY_DONTAUDITS,
+		QPOL_SUMMARY_TYPE_TRANS,
+		QPOL_SUMMARY_TYPE_CHANGES,
+		QPOL_SUMMARY_TYPE_MEMBERS,
+		QPOL_SUMMARY_ROLE_ALLOWS,
+		QPOL_SUMMARY_ROLE_TRANS,
+		QPOL_SUMMARY_RANGE_TRANS,
+		QPOL_SUMMARY_CONSTRAINTS,
+		QPOL_SUMMARY_VALIDATETRANS,
+		QPOL_SUMMARY_ISIDS,
+		QPOL_SUMMARY_FS_USES,
+		QPOL_SUMMARY_GENFSCONS,
+		QPOL_SUMMARY_PORTCONS,
+		QPOL_SUMMARY_NETIFCONS,
+		QPOL_SUMMARY_NODECONS,
+		QPOL_SUMMARY_PERMISSIVES,
+		QPOL_SUMMARY_POLCAPS,
+		QPOL_SUMMARY_NUM_COUNTS
+	} qpol_summary_count_e;
+
+/**
+ *  Compute the summary of a policy.  Every count is taken, and the
+ *  types of each attribute, the attributes of each type, and the
+ *  expanded types of each role are gathered, in a single walk over
+ *  the policy.  Subsequent calls to this function have no effect; the
+ *  summary is discarded if the policy is rebuilt.
+ *  @param policy The policy to summarize.
+ *  @return 0 on success and < 0 on error; if the call fails,
+ *  errno will be set.
+ */
+	extern int qpol_policy_build_summary(qpol_policy_t * policy);
+
+/**
+ *  Get one of the counts within a policy's summary.  The count of
+ *  conditionals and the rule counts, from QPOL_SUMMARY_ALLOWS through
+ *  QPOL_SUMMARY_TYPE_MEMBERS, are 0 if the policy was loaded with
+ *  QPOL_POLICY_OPTION_NO_RULES.
+ *  @param policy The policy, for which qpol_policy_build_summary()
+ *  must have been called.
+ *  @param which The count to get.
+ *  @param count Reference to the count.
+ *  @return 0 on success and < 0 on failure; if the call fails,
+ *  errno will be set and *count will be 0.
+ */
+	extern int qpol_summary_get_count(const qpol_policy_t * policy, qpol_summary_count_e which, size_t * count);
+
+/**
+ *  Get the types assigned to an attribute, in order of their values.
+ *  These are the same types returned by qpol_type_get_type_iter().
+ *  @param policy The policy, for which qpol_policy_build_summary()
+ *  must have been called.
+ *  @param datum The attribute.
+ *  @param types Reference to an array of types.  The caller must not
+ *  free the array; it is valid as long as the policy is unmodified.
+ *  @param num_types Reference to the number of types in the array.
+ *  @return 0 on success, > 0 if the datum is not an attribute, and
+ *  < 0 on failure; if the call fails, errno will be set, *types will
+ *  be NULL, and *num_types will be 0.
+ */
+	extern int qpol_summary_get_attr_types(const qpol_policy_t * policy, const qpol_type_t * datum,
+					       const qpol_type_t * const **types, size_t * num_types);
+
+/**
+ *  Get the attributes of a type, in order of their values.  These are
+ *  the same attributes returned by qpol_type_get_attr_iter().
+ *  @param policy The policy, for which qpol_policy_build_summary()
+ *  must have been called.
+ *  @param datum The type; it must not be an attribute.
+ *  @param attrs Reference to an array of attributes.  The caller must
+ *  not free the array; it is valid as long as the policy is unmodified.
+ *  @param num_attrs Reference to the number of attributes in the array.
+ *  @return 0 on success, > 0 if the datum is an attribute, and < 0 on
+ *  failure; if the call fails, errno will be set, *attrs will be NULL,
+ *  and *num_attrs will be 0.
+ */
+	extern int qpol_summary_get_type_attrs(const qpol_policy_t * policy, const qpol_type_t * datum,
+					       const qpol_type_t * const **attrs, size_t * num_attrs);
+
+/**
+ *  Get the types of a role, in order of their values.  These are the
+ *  same types returned by qpol_role_get_type_iter(), with attributes
+ *  already expanded.
+ *  @param policy The policy, for which qpol_policy_build_summary()
+ *  must have been called.
+ *  @param datum The role.
+ *  @param types Reference to an array of types.  The caller must not
+ *  free the array; it is valid as long as the policy is unmodified.
+ *  @param num_types Reference to the number of types in the array.
+ *  @return 0 on success and < 0 on failure; if the call fails,
+ *  errno will be set, *types will be NULL, and *num_types will be 0.
+ */
+	extern int qpol_summary_get_role_types(const qpol_policy_t * policy, const qpol_role_t * datum,
+					       const qpol_type_t * const **types, size_t * num_types);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif				       /* QPOL_SUMMARY_QUERY_H */
@@ -31,6 +31,8 @@ extern "C"
 {
 #endif
 
+#include <stddef.h>
+
 /**
  * Return an immutable string describing this library's version.
  *
@@ -54,6 +56,39 @@ extern "C"
  * in the file.  Returns -1 if file could not be decompressed. */
 	extern ssize_t qpol_bunzip(FILE *f, char **data);
 
+/**
+ * Work done by one thread of qpol_parallel_run(): items
+ * [first, last) of the whole.
+ *
+ * @param arg Argument given to qpol_parallel_run().
+ * @param first First item to process.
+ * @param last One past the last item to process.
+ *
+ * @return 0 on success, or an error number.
+ */
+	typedef int (qpol_parallel_fn_t) (void *arg, size_t first, size_t last);
+
+/**
+ * Divide items [0, num_items) into contiguous ranges, one for each
+ * online processor, and call fn upon each range from its own thread.
+ * The calling thread takes the first range, and any range whose
+ * thread could not be started; if threads cannot be had at all, fn
+ * is called once upon every item.  The ranges run concurrently, so
+ * fn must neither write anything shared between them nor report
+ * messages through a policy's callback; instead it returns an error
+ * number for the caller to report.
+ *
+ * @param num_items Number of items.
+ * @param min_per_thread Fewest items worth giving a thread of their
+ * own; 0 is treated as 1.
+ * @param fn Function to call upon each range.
+ * @param arg Arbitrary argument to pass to fn.
+ *
+ * @return 0 if every call succeeded, otherwise the error number
+ * returned by the call upon the earliest failing range.
+ */
+	extern int qpol_parallel_run(size_t num_items, size_t min_per_thread, qpol_parallel_fn_t * fn, void *arg);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -26,18 +26,27 @@
 #include <config.h>
 
 #include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <qpol/module.h>
 #include <qpol/util.h>
 #include "qpol_internal.h"
 
+#include <sepol/debug.h>
+#include <sepol/handle.h>
 #include <sepol/policydb.h>
 #include <sepol/policydb/module.h>
 
-int qpol_module_create_from_file(const char *path, qpol_module_t ** module)
+/**
+ *  Read a module package, reporting libsepol's messages through a
+ *  handle, or through libsepol's default handle if sh is NULL.
+ */
+static int module_create_from_file(const char *path, qpol_module_t ** module, sepol_handle_t * sh)
 {
 	sepol_module_package_t *smp = NULL;
 	sepol_policy_file_t *spf = NULL;
@@ -68,6 +77,8 @@ int qpol_module_create_from_file(const char *path, qpol_module_t ** module)
 		error = errno;
 		goto err;
 	}
+	if (sh != NULL)
+		sepol_policy_file_set_handle(spf, sh);
 
 	infile = fopen(path, "rb");
 	if (!infile) {
@@ -148,6 +159,191 @@ int qpol_module_create_from_file(const char *path, qpol_module_t ** module)
 	return STATUS_ERR;
 }
 
+int qpol_module_create_from_file(const char *path, qpol_module_t ** module)
+{
+	return module_create_from_file(path, module, NULL);
+}
+
+/** a message from libsepol, held until it can be delivered */
+typedef struct module_msg
+{
+	int level;
+	char *text;
+	struct module_msg *next;
+} module_msg_t;
+
+/** messages from reading one file, in the order they were sent */
+typedef struct module_msg_list
+{
+	module_msg_t *head, **tail;
+} module_msg_list_t;
+
+static void module_msg_callback(void *varg, sepol_handle_t * sh, const char *fmt, ...)
+{
+	module_msg_list_t *list = varg;
+	module_msg_t *msg;
+	va_list ap;
+	int len;
+
+	if ((msg = calloc(1, sizeof(*msg))) == NULL)
+		return;
+	va_start(ap, fmt);
+	len = vasprintf(&msg->text, fmt, ap);
+	va_end(ap);
+	if (len < 0) {
+		free(msg);
+		return;
+	}
+	msg->level = sepol_msg_get_level(sh);
+	*list->tail = msg;
+	list->tail = &msg->next;
+}
+
+/**
+ *  Deliver a file's held messages to a policy's callback, then free
+ *  them.
+ */
+static void module_msg_list_flush(const qpol_policy_t * policy, const char *path, module_msg_list_t * list)
+{
+	module_msg_t *msg, *next;
+
+	for (msg = list->head; msg != NULL; msg = next) {
+		next = msg->next;
+		qpol_handle_msg(policy, msg->level, "%s: %s", path, msg->text);
+		free(msg->text);
+		free(msg);
+	}
+	list->head = NULL;
+	list->tail = &list->head;
+}
+
+typedef struct module_read_state
+{
+	const char *const *paths;
+	size_t num_paths;
+	qpol_module_t **modules;
+	/** libsepol's messages for each file */
+	module_msg_list_t *msgs;
+	pthread_mutex_t lock;
+	/** index of the next file to read */
+	size_t next;
+	/** lowest index of a file that could not be read, or num_paths */
+	size_t failed;
+	int error;
+} module_read_state_t;
+
+static void *module_read_worker(void *arg)
+{
+	module_read_state_t *s = arg;
+	sepol_handle_t *sh;
+	size_t i;
+	int retv, error;
+
+	for (;;) {
+		pthread_mutex_lock(&s->lock);
+		/* stop handing out files once any of them failed */
+		if (s->next >= s->num_paths || s->failed < s->num_paths) {
+			pthread_mutex_unlock(&s->lock);
+			break;
+		}
+		i = s->next++;
+		pthread_mutex_unlock(&s->lock);
+
+		/* each file gets its own handle, whose messages are held
+		 * for the calling thread to deliver */
+		if ((sh = sepol_handle_create()) == NULL) {
+			retv = STATUS_ERR;
+			error = errno;
+		} else {
+			sepol_msg_set_callback(sh, module_msg_callback, s->msgs + i);
+			retv = module_create_from_file(s->paths[i], s->modules + i, sh);
+			error = errno;
+			sepol_handle_destroy(sh);
+		}
+		if (retv == STATUS_SUCCESS)
+			continue;
+		pthread_mutex_lock(&s->lock);
+		if (i < s->failed) {
+			s->failed = i;
+			s->error = error;
+		}
+		pthread_mutex_unlock(&s->lock);
+	}
+	return NULL;
+}
+
+int qpol_module_create_from_files(const qpol_policy_t * policy, const char *const *paths, size_t num_paths,
+				  qpol_module_t ** modules, size_t num_threads, size_t * failed)
+{
+	module_read_state_t s;
+	pthread_t *threads = NULL;
+	size_t i, num_started = 0;
+	long num_cpus;
+	int error;
+
+	if (failed)
+		*failed = 0;
+	if (num_paths > 0 && (!paths || !modules)) {
+		errno = EINVAL;
+		return STATUS_ERR;
+	}
+	for (i = 0; i < num_paths; i++)
+		modules[i] = NULL;
+
+	memset(&s, 0, sizeof(s));
+	s.paths = paths;
+	s.num_paths = num_paths;
+	s.modules = modules;
+	s.failed = num_paths;
+	if (num_paths > 0 && (s.msgs = calloc(num_paths, sizeof(*s.msgs))) == NULL) {
+		error = errno;
+		ERR(policy, "%s", strerror(error));
+		errno = error;
+		return STATUS_ERR;
+	}
+	for (i = 0; i < num_paths; i++)
+		s.msgs[i].tail = &s.msgs[i].head;
+	if ((error = pthread_mutex_init(&s.lock, NULL)) != 0) {
+		free(s.msgs);
+		errno = error;
+		return STATUS_ERR;
+	}
+
+	if (num_threads == 0) {
+		num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		num_threads = (num_cpus > 0 ? (size_t) num_cpus : 1);
+	}
+	if (num_threads > num_paths)
+		num_threads = num_paths;
+	/* the calling thread is itself a worker, so start one fewer */
+	if (num_threads > 1 && (threads = calloc(num_threads - 1, sizeof(*threads))) != NULL) {
+		for (; num_started < num_threads - 1; num_started++) {
+			if (pthread_create(threads + num_started, NULL, module_read_worker, &s) != 0) {
+				/* fall back to however many threads did start */
+				break;
+			}
+		}
+	}
+	module_read_worker(&s);
+	for (i = 0; i < num_started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	pthread_mutex_destroy(&s.lock);
+	for (i = 0; i < num_paths; i++)
+		module_msg_list_flush(policy, paths[i], s.msgs + i);
+	free(s.msgs);
+
+	if (s.failed < num_paths) {
+		for (i = 0; i < num_paths; i++)
+			qpol_module_destroy(modules + i);
+		if (failed)
+			*failed = s.failed;
+		errno = s.error;
+		return STATUS_ERR;
+	}
+	return STATUS_SUCCESS;
+}
+
 void qpol_module_destroy(qpol_module_t ** module)
 {
 	if (!module || !(*module))
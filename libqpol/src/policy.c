@@ -97,6 +97,15 @@ typedef struct fbuf
 	int err;
 } qpol_fbuf_t;
 
+/* generations are drawn from one counter, so that no two policies
+ * loaded by this process ever share one */
+static unsigned int qpol_last_generation = 0;
+
+static unsigned int qpol_next_generation(void)
+{
+	return __atomic_add_fetch(&qpol_last_generation, 1, __ATOMIC_RELAXED);
+}
+
 static void qpol_handle_route_to_callback(void *varg
 					  __attribute__ ((unused)), const qpol_policy_t * p, int level, const char *fmt,
 					  va_list va_args)
@@ -216,6 +225,140 @@ static int read_source_policy(qpol_policy_t * qpolicy, char *progname, int optio
 	return 0;
 }
 
+/**
+ * Map a policy file into memory.  The mapping is kept within the
+ * policy, and released by qpol_policy_destroy().
+ */
+static int qpol_policy_map_file(qpol_policy_t * policy, FILE * infile, const char *path)
+{
+	struct stat sb;
+	void *data;
+	int fd, error;
+
+	if ((fd = fileno(infile)) < 0)
+		return -1;
+	if (fstat(fd, &sb) < 0) {
+		error = errno;
+		ERR(policy, "Can't stat '%s':	%s\n", path, strerror(error));
+		errno = error;
+		return -1;
+	}
+	data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		error = errno;
+		ERR(policy, "Can't map '%s':  %s\n", path, strerror(error));
+		errno = error;
+		return -1;
+	}
+	policy->file_data = data;
+	policy->file_data_sz = sb.st_size;
+	policy->file_data_type = QPOL_POLICY_FILE_DATA_TYPE_MMAP;
+	return 0;
+}
+
+/**
+ * Release a policy's mapped file, once nothing more will be read
+ * from it.
+ */
+static void qpol_policy_unmap_file(qpol_policy_t * policy)
+{
+	if (policy->file_data_type == QPOL_POLICY_FILE_DATA_TYPE_MMAP) {
+		munmap(policy->file_data, policy->file_data_sz);
+		policy->file_data = NULL;
+		policy->file_data_sz = 0;
+		policy->file_data_type = QPOL_POLICY_FILE_DATA_TYPE_BIN;
+	}
+}
+
+/**
+ * Read a binary policy straight from the policy's mapped file,
+ * rather than through stdio.
+ */
+static int read_binary_policy(qpol_policy_t * policy, sepol_policydb_t * db)
+{
+	sepol_policy_file_t *pfile = NULL;
+	int error;
+
+	if (sepol_policy_file_create(&pfile)) {
+		error = errno;
+		ERR(policy, "%s", strerror(error));
+		errno = error;
+		return -1;
+	}
+	sepol_policy_file_set_handle(pfile, policy->sh);
+	sepol_policy_file_set_mem(pfile, policy->file_data, policy->file_data_sz);
+	if (sepol_policydb_read(db, pfile)) {
+		error = errno;
+		sepol_policy_file_free(pfile);
+		errno = error;
+		return -1;
+	}
+	sepol_policy_file_free(pfile);
+	return 0;
+}
+
+/**
+ * Read the rules of a binary policy that was opened with
+ * QPOL_POLICY_OPTION_NO_RULES.  The policy is read again from its
+ * mapped file, and only its unconditional rules table is kept; every
+ * other component, and so every pointer already handed out for one,
+ * is left as it was.
+ */
+static int qpol_policy_load_binary_rules(qpol_policy_t * policy)
+{
+	sepol_policydb_t *db = NULL;
+	avtab_t avtab;
+	int error = 0;
+
+	if (policy->file_data == NULL) {
+		ERR(policy, "%s", strerror(ENOTSUP));
+		errno = ENOTSUP;
+		return STATUS_ERR;
+	}
+
+	INFO(policy, "%s", "Reading rules from binary policy.");
+	if (sepol_policydb_create(&db)) {
+		error = errno;
+		ERR(policy, "%s", strerror(error));
+		errno = error;
+		return STATUS_ERR;
+	}
+	if (read_binary_policy(policy, db)) {
+		error = errno;
+		sepol_policydb_free(db);
+		errno = error;
+		return STATUS_ERR;
+	}
+	/* the rules index the live policy's symbols by value, so they
+	 * may only come from the same policy */
+	if (db->p.policyvers != policy->p->p.policyvers ||
+	    db->p.p_types.nprim != policy->p->p.p_types.nprim ||
+	    db->p.p_classes.nprim != policy->p->p.p_classes.nprim || db->p.p_bools.nprim != policy->p->p.p_bools.nprim) {
+		sepol_policydb_free(db);
+		ERR(policy, "%s", "Binary policy file no longer matches the loaded policy.");
+		errno = EINVAL;
+		return STATUS_ERR;
+	}
+	avtab = policy->p->p.te_avtab;
+	policy->p->p.te_avtab = db->p.te_avtab;
+	db->p.te_avtab = avtab;
+	sepol_policydb_free(db);
+
+	policy->options &= ~(QPOL_POLICY_OPTION_NO_RULES);
+	if (qpol_policy_add_cond_rule_traceback(policy)) {
+		error = errno;
+		avtab_destroy(&policy->p->p.te_avtab);
+		avtab_init(&policy->p->p.te_avtab);
+		policy->options |= QPOL_POLICY_OPTION_NO_RULES;
+		errno = error;
+		return STATUS_ERR;
+	}
+	/* the summary's rule counts are now stale */
+	qpol_summary_destroy(&policy->summary);
+	qpol_policy_unmap_file(policy);
+	return STATUS_SUCCESS;
+}
+
 static int qpol_init_fbuf(qpol_fbuf_t ** fb)
 {
 	if (fb == NULL)
@@ -795,9 +938,13 @@ int qpol_policy_rebuild_opt(qpol_policy_t * policy, const int options)
 		return STATUS_ERR;
 	}
 
-	/* if kernel binary do nothing */
-	if (policy->type == QPOL_POLICY_KERNEL_BINARY)
+	/* a kernel binary can only have its rules read, if they were not
+	 * loaded when it was opened */
+	if (policy->type == QPOL_POLICY_KERNEL_BINARY) {
+		if ((policy->options & QPOL_POLICY_OPTION_NO_RULES) && !(options & QPOL_POLICY_OPTION_NO_RULES))
+			return qpol_policy_load_binary_rules(policy);
 		return STATUS_SUCCESS;
+	}
 
 	/* if options are the same and the modules were not modified, do nothing */
 	if (options == policy->options && policy->modified == 0)
@@ -808,6 +955,8 @@ int qpol_policy_rebuild_opt(qpol_policy_t * policy, const int options)
 	policy->p = NULL;
 	struct qpol_extended_image *ext = policy->ext;
 	policy->ext = NULL;
+	struct qpol_summary *summary = policy->summary;
+	policy->summary = NULL;
 	old_options = policy->options;
 	policy->options = options;
 
@@ -899,8 +1048,10 @@ int qpol_policy_rebuild_opt(qpol_policy_t * policy, const int options)
 		goto err;
 	}
 	qpol_extended_image_destroy(&ext);
+	qpol_summary_destroy(&summary);
 
 	sepol_policydb_free(old_p);
+	policy->generation = qpol_next_generation();
 
 	return STATUS_SUCCESS;
 
@@ -909,6 +1060,7 @@ int qpol_policy_rebuild_opt(qpol_policy_t * policy, const int options)
 
 	policy->p = old_p;
 	policy->ext = ext;
+	policy->summary = summary;
 	policy->options = old_options;
 	errno = error;
 	return STATUS_ERR;
@@ -958,10 +1110,7 @@ int qpol_policy_open_from_file_opt(const char *path, qpol_policy_t ** policy, qp
 {
 	int error = 0, retv = -1;
 	FILE *infile = NULL;
-	sepol_policy_file_t *pfile = NULL;
 	qpol_module_t *mod = NULL;
-	int fd = 0;
-	struct stat sb;
 
 	if (policy != NULL)
 		*policy = NULL;
@@ -980,6 +1129,7 @@ int qpol_policy_open_from_file_opt(const char *path, qpol_policy_t ** policy, qp
 		goto err;
 	}
 	(*policy)->options = options;
+	(*policy)->generation = qpol_next_generation();
 
 	/* QPOL_POLICY_OPTION_NO_RULES implies QPOL_POLICY_OPTION_NO_NEVERALLOWS */
 	if ((*policy)->options & QPOL_POLICY_OPTION_NO_RULES)
@@ -1006,30 +1156,36 @@ int qpol_policy_open_from_file_opt(const char *path, qpol_policy_t ** policy, qp
 		goto err;
 	}
 
-	if (sepol_policy_file_create(&pfile)) {
-		error = errno;
-		goto err;
-	}
-
 	infile = fopen(path, "rb");
 	if (infile == NULL) {
 		error = errno;
 		goto err;
 	}
 
-	sepol_policy_file_set_handle(pfile, (*policy)->sh);
-
     errno=0;
 	if (qpol_is_file_binpol(infile)) {
 		(*policy)->type = retv = QPOL_POLICY_KERNEL_BINARY;
-		sepol_policy_file_set_fp(pfile, infile);
-		if (sepol_policydb_read((*policy)->p, pfile)) {
-//			error = EIO;
+		if (qpol_policy_map_file(*policy, infile, path)) {
+			error = errno;
 			goto err;
 		}
-		/* By definition, binary policy cannot have neverallow rules and all other rules are always loaded. */
+		if (read_binary_policy(*policy, (*policy)->p)) {
+			error = errno;
+			goto err;
+		}
+		/* By definition, binary policy cannot have neverallow rules. */
 		(*policy)->options |= QPOL_POLICY_OPTION_NO_NEVERALLOWS;
-		(*policy)->options &= ~(QPOL_POLICY_OPTION_NO_RULES);
+		if ((*policy)->options & QPOL_POLICY_OPTION_NO_RULES) {
+			/* Drop the unconditional rules, the bulk of the
+			 * policy.  The file stays mapped so that
+			 * qpol_policy_rebuild() may read them later; its
+			 * pages are handed back until then. */
+			avtab_destroy(&((*policy)->p->p.te_avtab));
+			avtab_init(&((*policy)->p->p.te_avtab));
+			madvise((*policy)->file_data, (*policy)->file_data_sz, MADV_DONTNEED);
+		} else {
+			qpol_policy_unmap_file(*policy);
+		}
 		if (policy_extend(*policy)) {
 			error = errno;
 			goto err;
@@ -1049,32 +1205,16 @@ int qpol_policy_open_from_file_opt(const char *path, qpol_policy_t ** policy, qp
 		}
 	} else {
 		(*policy)->type = retv = QPOL_POLICY_KERNEL_SOURCE;
-		fd = fileno(infile);
-		if (fd < 0) {
+		/* the mapped version is kept for rebuild() */
+		if (qpol_policy_map_file(*policy, infile, path)) {
 			error = errno;
 			goto err;
 		}
-		if (fstat(fd, &sb) < 0) {
-			error = errno;
-			ERR(*policy, "Can't stat '%s':	%s\n", path, strerror(errno));
-			goto err;
-		}
-		qpol_src_input = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-		if (qpol_src_input == MAP_FAILED) {
-			error = errno;
-			ERR(*policy, "Can't map '%s':  %s\n", path, strerror(errno));
-
-			goto err;
-		}
+		qpol_src_input = (*policy)->file_data;
 		qpol_src_inputptr = qpol_src_input;
-		qpol_src_inputlim = &qpol_src_inputptr[sb.st_size - 1];
+		qpol_src_inputlim = &qpol_src_inputptr[(*policy)->file_data_sz - 1];
 		qpol_src_originalinput = qpol_src_input;
 
-		/* store mmaped version for rebuild() */
-		(*policy)->file_data = qpol_src_originalinput;
-		(*policy)->file_data_sz = sb.st_size;
-		(*policy)->file_data_type = QPOL_POLICY_FILE_DATA_TYPE_MMAP;
-
 		(*policy)->p->p.policy_type = POLICY_BASE;
 		if (read_source_policy(*policy, "libqpol", (*policy)->options) < 0) {
 			error = errno;
@@ -1119,13 +1259,11 @@ int qpol_policy_open_from_file_opt(const char *path, qpol_policy_t ** policy, qp
 	}
 
 	fclose(infile);
-	sepol_policy_file_free(pfile);
 	return retv;
 
       err:
 	qpol_policy_destroy(policy);
 	qpol_module_destroy(&mod);
-	sepol_policy_file_free(pfile);
 	if (infile)
 		fclose(infile);
 	errno = error;
@@ -1164,6 +1302,7 @@ int qpol_policy_open_from_memory_opt(qpol_policy_t ** policy, const char *fileda
 		goto err;
 	}
 	(*policy)->options = options;
+	(*policy)->generation = qpol_next_generation();
 
 	/* QPOL_POLICY_OPTION_NO_RULES implies QPOL_POLICY_OPTION_NO_NEVERALLOWS */
 	if ((*policy)->options & QPOL_POLICY_OPTION_NO_RULES)
@@ -1278,6 +1417,7 @@ void qpol_policy_destroy(qpol_policy_t ** policy)
 		sepol_policydb_free((*policy)->p);
 		sepol_handle_destroy((*policy)->sh);
 		qpol_extended_image_destroy(&((*policy)->ext));
+		qpol_summary_destroy(&((*policy)->summary));
 		if ((*policy)->modules) {
 			size_t i = 0;
 			for (i = 0; i < (*policy)->num_modules; i++) {
@@ -1537,6 +1677,22 @@ int qpol_policy_get_type(const qpol_policy_t * policy, int *type)
 	return STATUS_SUCCESS;
 }
 
+int qpol_policy_get_generation(const qpol_policy_t * policy, unsigned int *generation)
+{
+	if (generation != NULL)
+		*generation = 0;
+
+	if (!policy || !generation) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return STATUS_ERR;
+	}
+
+	*generation = policy->generation;
+
+	return STATUS_SUCCESS;
+}
+
 int qpol_policy_has_capability(const qpol_policy_t * policy, qpol_capability_e cap)
 {
 	unsigned int version = 0;
@@ -39,39 +39,34 @@
 #include <qpol/policy.h>
 #include <qpol/policy_extend.h>
 #include <qpol/iterator.h>
+#include <qpol/util.h>
 #include <selinux/selinux.h>
 #include <errno.h>
 #include <assert.h>
+#include <stdint.h>
+#include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "qpol_internal.h"
 #include "iterator_internal.h"
 #include "syn_rule_internal.h"
 
-#ifdef SETOOLS_DEBUG
-#include <math.h>
-#endif
-
 #define OBJECT_R "object_r"
 
-#define QPOL_SYN_RULE_TABLE_BITS 16
-#define QPOL_SYN_RULE_TABLE_SIZE (1 << QPOL_SYN_RULE_TABLE_BITS)
-#define QPOL_SYN_RULE_TABLE_MASK (QPOL_SYN_RULE_TABLE_SIZE - 1)
-
-/* original hashing function below */
-/*
-#define QPOL_SYN_RULE_TABLE_HASH(rule_key) \
-((rule_key->class_val + \
- (rule_key->target_val << 2) +\
- (rule_key->source_val << 9)) & \
- QPOL_SYN_RULE_TABLE_MASK)
-*/
-
-/* new hashing function, introduced in SETools 3.3 */
-#define QPOL_SYN_RULE_TABLE_HASH(rule_key) \
-(((((rule_key->source_val & 0xff) << 8) | (rule_key->target_val & 0xff)) ^ \
- (rule_key->class_val & 0xf) ^ \
- ((int) ((size_t) rule_key->cond) & 0xfff0)) & QPOL_SYN_RULE_TABLE_MASK)
+/** fewest avtab slots worth handing to a thread of their own */
+#define EXTEND_MIN_SLOTS_PER_THREAD (1 << 14)
+
+/** smallest number of slots in the syntactic rule table; a power of two */
+#define QPOL_SYN_RULE_TABLE_MIN_SIZE (1 << 12)
+
+/* rule list entries are allocated a chunk at a time, so that growing
+ * the arena never moves an existing entry */
+#define QPOL_SYN_RULE_CHUNK_BITS 16
+#define QPOL_SYN_RULE_CHUNK_SIZE (1 << QPOL_SYN_RULE_CHUNK_BITS)
+#define QPOL_SYN_RULE_CHUNK_MASK (QPOL_SYN_RULE_CHUNK_SIZE - 1)
+
+/** end of a rule list, and the list of an empty slot */
+#define QPOL_SYN_RULE_NONE UINT32_MAX
 
 typedef struct qpol_syn_rule_key
 {
@@ -82,22 +77,36 @@ typedef struct qpol_syn_rule_key
 	cond_node_t *cond;
 } qpol_syn_rule_key_t;
 
-typedef struct qpol_syn_rule_list
+typedef struct qpol_syn_rule_entry
 {
-	struct qpol_syn_rule *rule;
-	struct qpol_syn_rule_list *next;
-} qpol_syn_rule_list_t;
+	/** index of the rule within the master list */
+	uint32_t rule;
+	/** index of the next entry in the list, or QPOL_SYN_RULE_NONE */
+	uint32_t next;
+} qpol_syn_rule_entry_t;
 
 typedef struct qpol_syn_rule_node
 {
 	qpol_syn_rule_key_t key;
-	qpol_syn_rule_list_t *rules;
-	struct qpol_syn_rule_node *next;
+	/** index of the most recently added entry, or
+	 *  QPOL_SYN_RULE_NONE if this slot is empty */
+	uint32_t rules;
+	uint32_t num_rules;
 } qpol_syn_rule_node_t;
 
+/* The table is open addressed with linear probing.  Each node lives
+ * within the table itself, and each rule list is a chain of indices
+ * through the entry arena, so that building the table costs a
+ * handful of large allocations rather than one per rule. */
 typedef struct qpol_syn_rule_table
 {
-	qpol_syn_rule_node_t **buckets;
+	qpol_syn_rule_node_t *nodes;
+	/** number of slots, always a power of two */
+	size_t size;
+	size_t num_nodes;
+	qpol_syn_rule_entry_t **chunks;
+	size_t num_chunks;
+	uint32_t num_entries;
 } qpol_syn_rule_table_t;
 
 typedef struct qpol_extended_image
@@ -105,6 +114,17 @@ typedef struct qpol_extended_image
 	qpol_syn_rule_table_t *syn_rule_table;
 	struct qpol_syn_rule **syn_rule_master_list;
 	size_t master_list_sz;
+	/** non-zero if syn_rule_table is filled on demand from the
+	 *  index below, rather than built all at once */
+	int lazy;
+	/* the lazy index: each syntactic rule's expanded source and
+	 * target types, indexed as the master list, and the rules
+	 * naming each class, indexed by class value - 1 */
+	ebitmap_t *syn_rule_sources;
+	ebitmap_t *syn_rule_targets;
+	uint32_t **class_rules;
+	size_t *class_num_rules;
+	size_t num_classes;
 } qpol_extended_image_t;
 
 struct extend_bogus_alias_struct
@@ -552,22 +572,59 @@ static int qpol_policy_match_system(qpol_policy_t * policy)
 }
 
 /**
- *  Walks the conditional list and adds links for reverse look up from
- *  a te/av rule to the conditional from which it came.
- *  @param policy The policy to which to add conditional trace backs.
- *  This policy will be altered by this function.
- *  @return 0 on success and < 0 on failure; if the call fails,
- *  errno will be set. On failure, the policy state may be inconsistent.
+ *  Seconds elapsed since a starting time.
+ */
+static double extend_elapsed(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/** The unconditional and conditional avtabs, whose slots are
+ *  numbered as if the second followed the first. */
+typedef struct extend_mark_rules
+{
+	avtab_t *ucond_tab;
+	avtab_t *cond_tab;
+	uint32_t rule_type_mask;
+} extend_mark_rules_t;
+
+/**
+ *  Mark every rule within a range of avtab slots as enabled and
+ *  unconditional.  This is the same walk an avrule and terule
+ *  iterator would make over those slots.
  */
-static int qpol_policy_add_cond_rule_traceback(qpol_policy_t * policy)
+static int extend_mark_rules_worker(void *arg, size_t first, size_t last)
+{
+	extend_mark_rules_t *mark = arg;
+	avtab_t *tab;
+	avtab_ptr_t node;
+	size_t i;
+
+	for (i = first; i < last; i++) {
+		if (i < mark->ucond_tab->nslot)
+			tab = mark->ucond_tab;
+		else
+			tab = mark->cond_tab;
+		if (!tab->htable)
+			continue;
+		for (node = tab->htable[i < mark->ucond_tab->nslot ? i : i - mark->ucond_tab->nslot]; node; node = node->next) {
+			if (!(node->key.specified & mark->rule_type_mask))
+				continue;
+			node->parse_context = NULL;
+			node->merged = QPOL_COND_RULE_ENABLED;
+		}
+	}
+	return 0;
+}
+
+int qpol_policy_add_cond_rule_traceback(qpol_policy_t * policy)
 {
 	policydb_t *db = NULL;
 	cond_node_t *cond = NULL;
 	cond_av_list_t *list_ptr = NULL;
-	qpol_iterator_t *iter = NULL;
-	avtab_ptr_t rule = NULL;
-	int error = 0;
-	uint32_t rules = 0;
+	extend_mark_rules_t mark;
 
 	INFO(policy, "%s", "Building conditional rules tables. (Step 5 of 5)");
 	if (!policy) {
@@ -578,37 +635,19 @@ static int qpol_policy_add_cond_rule_traceback(qpol_policy_t * policy)
 
 	db = &policy->p->p;
 
-	rules = (QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT);
+	/* mark all unconditional rules as enabled; the conditional
+	 * rules are marked again below */
+	memset(&mark, 0, sizeof(mark));
+	mark.ucond_tab = &db->te_avtab;
+	mark.cond_tab = &db->te_cond_avtab;
+	mark.rule_type_mask = (QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT |
+				QPOL_RULE_TYPE_TRANS | QPOL_RULE_TYPE_CHANGE | QPOL_RULE_TYPE_MEMBER);
 	if (!(policy->options & QPOL_POLICY_OPTION_NO_NEVERALLOWS))
-		rules |= QPOL_RULE_NEVERALLOW;
+		mark.rule_type_mask |= QPOL_RULE_NEVERALLOW;
 
-	/* mark all unconditional rules as enabled */
-	if (qpol_policy_get_avrule_iter(policy, rules, &iter))
-		return STATUS_ERR;
-	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-		if (qpol_iterator_get_item(iter, (void **)&rule)) {
-			error = errno;
-			ERR(policy, "%s", strerror(error));
-			errno = error;
-			return STATUS_ERR;
-		}
-		rule->parse_context = NULL;
-		rule->merged = QPOL_COND_RULE_ENABLED;
-	}
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_terule_iter(policy, (QPOL_RULE_TYPE_TRANS | QPOL_RULE_TYPE_CHANGE | QPOL_RULE_TYPE_MEMBER), &iter))
-		return STATUS_ERR;
-	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-		if (qpol_iterator_get_item(iter, (void **)&rule)) {
-			error = errno;
-			ERR(policy, "%s", strerror(error));
-			errno = error;
-			return STATUS_ERR;
-		}
-		rule->parse_context = NULL;
-		rule->merged = QPOL_COND_RULE_ENABLED;
-	}
-	qpol_iterator_destroy(&iter);
+	/* the slots are disjoint, so split them among threads */
+	qpol_parallel_run((size_t) db->te_avtab.nslot + db->te_cond_avtab.nslot, EXTEND_MIN_SLOTS_PER_THREAD,
+			  extend_mark_rules_worker, &mark);
 
 	for (cond = db->cond_list; cond; cond = cond->next) {
 		/* evaluate cond */
@@ -659,193 +698,294 @@ static void qpol_syn_rule_destroy(struct qpol_syn_rule **r)
 }
 
 /**
- *  Free all memory used by a syn rule list.
- *  @param list Reference pointer to the head node of
- *  the syn rule list to destroy. All nodes in the list will
- *  be destroyed.
+ *  Free all memory used by the syntactic rule table.
+ * @param t Reference pointer to the table to destroy.
  */
-static void qpol_syn_rule_list_destroy(qpol_syn_rule_list_t ** list)
+static void qpol_syn_rule_table_destroy(qpol_syn_rule_table_t ** t)
 {
-	qpol_syn_rule_list_t *cur = NULL, *next = NULL;
+	size_t i = 0;
 
-	if (!list || !(*list))
+	if (!t || !(*t))
 		return;
 
-	for (cur = *list; cur; cur = next) {
-		next = cur->next;
-		free(cur);
-	}
+	for (i = 0; i < (*t)->num_chunks; i++)
+		free((*t)->chunks[i]);
+
+	free((*t)->chunks);
+	free((*t)->nodes);
+	free(*t);
+	*t = NULL;
 }
 
 /**
- *  Free all memory used by a syn rule node in the rule table.
- *  @param node Reference pointer to the first node in the chain.
- *  All nodes in the chain will be destroyed.
+ *  Allocate an array of empty table slots.
+ *  @param size Number of slots.
+ *  @return the array, or NULL on failure with errno set.
  */
-static void qpol_syn_rule_node_destroy(qpol_syn_rule_node_t ** node)
+static qpol_syn_rule_node_t *qpol_syn_rule_nodes_create(size_t size)
 {
-	qpol_syn_rule_node_t *cur = NULL, *next = NULL;
-
-	if (!node || !(*node))
-		return;
+	qpol_syn_rule_node_t *nodes = NULL;
+	size_t i;
 
-	for (cur = *node; cur; cur = next) {
-		next = cur->next;
-		qpol_syn_rule_list_destroy(&cur->rules);
-		free(cur);
+	if (!(nodes = malloc(size * sizeof(*nodes))))
+		return NULL;
+	for (i = 0; i < size; i++) {
+		nodes[i].rules = QPOL_SYN_RULE_NONE;
+		nodes[i].num_rules = 0;
 	}
+	return nodes;
 }
 
 /**
- *  Free all memory used by the syntactic rule table.
- * @param t Reference pointer to the table to destroy.
+ *  Create an empty syntactic rule table.
+ *  @param hint Expected number of distinct keys; the table grows
+ *  beyond this as needed.
+ *  @return the new table, or NULL on failure with errno set.
  */
-static void qpol_syn_rule_table_destroy(qpol_syn_rule_table_t ** t)
+static qpol_syn_rule_table_t *qpol_syn_rule_table_create(size_t hint)
 {
-	size_t i = 0;
+	qpol_syn_rule_table_t *table = NULL;
+	size_t size = QPOL_SYN_RULE_TABLE_MIN_SIZE;
+	int error;
 
-	if (!t || !(*t))
-		return;
+	while (size / 4 * 3 < hint)
+		size <<= 1;
 
-	for (i = 0; i < QPOL_SYN_RULE_TABLE_SIZE; i++)
-		qpol_syn_rule_node_destroy(&((*t)->buckets[i]));
+	if (!(table = calloc(1, sizeof(*table))))
+		return NULL;
+	if (!(table->nodes = qpol_syn_rule_nodes_create(size))) {
+		error = errno;
+		free(table);
+		errno = error;
+		return NULL;
+	}
+	table->size = size;
+	return table;
+}
 
-	free((*t)->buckets);
-	free(*t);
-	*t = NULL;
+/**
+ *  Hash the parts of a key that must match exactly; the rule type is
+ *  matched as a mask, so it does not take part.
+ */
+static size_t qpol_syn_rule_table_hash(const qpol_syn_rule_key_t * key)
+{
+	uint64_t h = ((uint64_t) key->source_val << 32) | key->target_val;
+
+	h ^= ((uint64_t) key->class_val << 48) ^ (uint64_t) (uintptr_t) key->cond;
+	h *= UINT64_C(0x9e3779b97f4a7c15);
+	h ^= h >> 29;
+	return (size_t) h;
 }
 
 /**
- *  Find the node in the syntactic rule hash table corresponding to a key.
- *  @param table The table to search.
- *  @param key The key for which to search.
- *  @return a valid qpol_syn_rule_node_t pointer on success or NULL on failure.
+ *  Find the slot holding a key, or else the empty slot at which the
+ *  key would be added.  The table must have at least one empty slot.
  */
-static qpol_syn_rule_node_t *qpol_syn_rule_table_find_node_by_key(const qpol_syn_rule_table_t * table,
-								  const qpol_syn_rule_key_t * key)
+static qpol_syn_rule_node_t *qpol_syn_rule_table_probe(const qpol_syn_rule_table_t * table, const qpol_syn_rule_key_t * key)
 {
+	size_t mask = table->size - 1, i;
 	qpol_syn_rule_node_t *node = NULL;
 
-	for (node = table->buckets[QPOL_SYN_RULE_TABLE_HASH(key)]; node; node = node->next) {
+	for (i = qpol_syn_rule_table_hash(key) & mask;; i = (i + 1) & mask) {
+		node = table->nodes + i;
+		if (node->rules == QPOL_SYN_RULE_NONE)
+			return node;
 		if ((node->key.rule_type & key->rule_type) &&
 		    (node->key.source_val == key->source_val) &&
 		    (node->key.target_val == key->target_val) &&
 		    (node->key.class_val == key->class_val) && (node->key.cond == key->cond))
 			return node;
 	}
+}
+
+/**
+ *  Find the node in the syntactic rule hash table corresponding to a key.
+ *  @param table The table to search.
+ *  @param key The key for which to search.
+ *  @return a valid qpol_syn_rule_node_t pointer on success or NULL on failure.
+ */
+static const qpol_syn_rule_node_t *qpol_syn_rule_table_find_node_by_key(const qpol_syn_rule_table_t * table,
+									const qpol_syn_rule_key_t * key)
+{
+	const qpol_syn_rule_node_t *node = NULL;
+
+	if (!table)
+		return NULL;	       /* policy is not a source policy */
+	node = qpol_syn_rule_table_probe(table, key);
+	return (node->rules == QPOL_SYN_RULE_NONE ? NULL : node);
+}
 
-	return NULL;
+/**
+ *  Get an entry from the table's arena.
+ */
+static qpol_syn_rule_entry_t *qpol_syn_rule_table_get_entry(const qpol_syn_rule_table_t * table, uint32_t idx)
+{
+	return &table->chunks[idx >> QPOL_SYN_RULE_CHUNK_BITS][idx & QPOL_SYN_RULE_CHUNK_MASK];
 }
 
 /**
- *  Given a syn rule key and a syn rule, adds the key/rule pair to the
- *  syn rule table.  Note that this function takes ownership of the
- *  key.
+ *  Double the number of slots in the table.
+ *  @return 0 on success and < 0 on failure with errno set; on
+ *  failure the table is unchanged.
+ */
+static int qpol_syn_rule_table_grow(qpol_syn_rule_table_t * table)
+{
+	qpol_syn_rule_node_t *old_nodes = table->nodes, *new_nodes = NULL;
+	size_t old_size = table->size, i;
+
+	if (!(new_nodes = qpol_syn_rule_nodes_create(old_size * 2)))
+		return -1;
+	table->nodes = new_nodes;
+	table->size = old_size * 2;
+	for (i = 0; i < old_size; i++) {
+		if (old_nodes[i].rules != QPOL_SYN_RULE_NONE)
+			*qpol_syn_rule_table_probe(table, &old_nodes[i].key) = old_nodes[i];
+	}
+	free(old_nodes);
+	return 0;
+}
+
+/**
+ *  Given a syn rule key and the index of a syn rule, adds the
+ *  key/rule pair to the syn rule table.
  *
  *  @param policy Policy associated with the rule.
  *  @param table The table to which to add the rule.
- *  @param key Hashtable key for rule lookup.
- *  @param rule The rule to add.
+ *  @param key Hashtable key for rule lookup; it is copied into the table.
+ *  @param rule Index of the rule within the master list.
  *  @return 0 on success and < 0 on failure; if the call fails,
  *  errno will be set and the table may be in an inconsistent state.
  */
-static int qpol_syn_rule_table_insert_entry(qpol_policy_t * policy,
-					    qpol_syn_rule_table_t * table, qpol_syn_rule_key_t * key, struct qpol_syn_rule *rule)
+static int qpol_syn_rule_table_insert_entry(const qpol_policy_t * policy,
+					    qpol_syn_rule_table_t * table, const qpol_syn_rule_key_t * key, uint32_t rule)
 {
 	int error = 0;
 	qpol_syn_rule_node_t *table_node = NULL;
-	qpol_syn_rule_list_t *list_entry = NULL;
+	qpol_syn_rule_entry_t *list_entry = NULL, **chunks = NULL;
+	uint32_t idx;
 
-	if (!(list_entry = malloc(sizeof(qpol_syn_rule_list_t)))) {
+	/* keep the load factor at or below 3/4 */
+	if ((table->num_nodes + 1) > table->size / 4 * 3 && qpol_syn_rule_table_grow(table)) {
 		error = errno;
 		ERR(policy, "%s", strerror(error));
+		errno = error;
 		return -1;
 	}
-	list_entry->rule = rule;
 
-	table_node = qpol_syn_rule_table_find_node_by_key(table, key);
-	if (table_node) {
-		list_entry->next = table_node->rules;
-		table_node->rules = list_entry;
-	} else {
-		list_entry->next = NULL;
-		if (!(table_node = malloc(sizeof(qpol_syn_rule_node_t)))) {
+	table_node = qpol_syn_rule_table_probe(table, key);
+	/* a rule with "self" whose target set includes the source
+	 * reaches the same key twice in a row */
+	if (table_node->rules != QPOL_SYN_RULE_NONE &&
+	    qpol_syn_rule_table_get_entry(table, table_node->rules)->rule == rule)
+		return 0;
+
+	idx = table->num_entries;
+	if (idx == QPOL_SYN_RULE_NONE) {
+		ERR(policy, "%s", strerror(ERANGE));
+		errno = ERANGE;
+		return -1;
+	}
+	if ((idx & QPOL_SYN_RULE_CHUNK_MASK) == 0) {
+		if (!(chunks = realloc(table->chunks, (table->num_chunks + 1) * sizeof(*chunks)))) {
+			error = errno;
+			ERR(policy, "%s", strerror(error));
+			errno = error;
+			return -1;
+		}
+		table->chunks = chunks;
+		if (!(chunks[table->num_chunks] = malloc(QPOL_SYN_RULE_CHUNK_SIZE * sizeof(qpol_syn_rule_entry_t)))) {
 			error = errno;
 			ERR(policy, "%s", strerror(error));
-			free(list_entry);
+			errno = error;
 			return -1;
 		}
+		table->num_chunks++;
+	}
+	list_entry = qpol_syn_rule_table_get_entry(table, idx);
+	list_entry->rule = rule;
+	list_entry->next = table_node->rules;
+	table->num_entries++;
+
+	if (table_node->rules == QPOL_SYN_RULE_NONE) {
 		table_node->key = *key;
-		table_node->rules = list_entry;
-		size_t hash = QPOL_SYN_RULE_TABLE_HASH(key);
-		table_node->next = table->buckets[hash];
-		table->buckets[hash] = table_node;
+		table->num_nodes++;
 	}
+	table_node->rules = idx;
+	table_node->num_rules++;
 	return 0;
 }
 
+/**
+ *  Expand the source and target type sets of a syntactic rule.  Each
+ *  set holds both the types and attributes named by the rule and the
+ *  types to which those attributes expand.
+ *  @param policy Policy associated with the rule.
+ *  @param rule The rule to expand.
+ *  @param source_types Bitmap to initialize with the source types.
+ *  @param target_types Bitmap to initialize with the target types.
+ *  @return 0 on success and < 0 on failure; if the call fails, errno
+ *  will be set and both bitmaps will be empty.
+ */
+static int qpol_syn_rule_expand_types(const qpol_policy_t * policy, avrule_t * rule, ebitmap_t * source_types,
+				      ebitmap_t * target_types)
+{
+	ebitmap_t source_types2, target_types2;
+	int retval = -1;
+
+	ebitmap_init(source_types);
+	ebitmap_init(target_types);
+	ebitmap_init(&source_types2);
+	ebitmap_init(&target_types2);
+	if (type_set_expand(&rule->stypes, source_types, &policy->p->p, 0) ||
+	    type_set_expand(&rule->stypes, &source_types2, &policy->p->p, 1) ||
+	    type_set_expand(&rule->ttypes, target_types, &policy->p->p, 0) ||
+	    type_set_expand(&rule->ttypes, &target_types2, &policy->p->p, 1) ||
+	    ebitmap_union(source_types, &source_types2) || ebitmap_union(target_types, &target_types2)) {
+		ERR(policy, "%s", strerror(ENOMEM));
+		ebitmap_destroy(source_types);
+		ebitmap_destroy(target_types);
+		errno = ENOMEM;
+		goto cleanup;
+	}
+	retval = 0;
+      cleanup:
+	ebitmap_destroy(&source_types2);
+	ebitmap_destroy(&target_types2);
+	return retval;
+}
+
 /**
  *  Add a syntactic rule (sepol's avrule_t) to the syntactic rule table.
  *  @param policy Policy associated with the rule.
  *  @param table The table to which to add the rule.
- *  @param rule The rule to add.
- *  @param cond The conditional associated with the rule (NULL if
- *  unconditional).  with the rule (needed for conditional tracking).
- *  @param branch If the rule is conditional, then 0 if in the true
- *  branch, 1 if in else.
+ *  @param rule_idx Index of the rule within the master list.
  *  @return 0 on success and < 0 on failure; if the call fails,
  *  errno will be set and the table may be in an inconsistent state.
  */
-static int qpol_syn_rule_table_insert_sepol_avrule(qpol_policy_t * policy, qpol_syn_rule_table_t * table, avrule_t * rule,
-						   cond_node_t * cond, int branch)
+static int qpol_syn_rule_table_insert_sepol_avrule(qpol_policy_t * policy, qpol_syn_rule_table_t * table, uint32_t rule_idx)
 {
 	int error = 0;
 	qpol_syn_rule_key_t key = { 0, 0, 0, 0, NULL };
-	struct qpol_syn_rule *new_rule = NULL;
-	ebitmap_t source_types, source_types2, target_types, target_types2;
+	struct qpol_syn_rule *syn_rule = policy->ext->syn_rule_master_list[rule_idx];
+	avrule_t *rule = syn_rule->rule;
+	ebitmap_t source_types, target_types;
 	ebitmap_node_t *snode = NULL, *tnode = NULL;
 	unsigned int i, j;
 	class_perm_node_t *class_node = NULL;
 
-	if (!(new_rule = malloc(sizeof(struct qpol_syn_rule)))) {
-		error = errno;
-		ERR(policy, "%s", strerror(error));
-		goto err;
-	}
-	new_rule->rule = rule;
-	new_rule->cond = cond;
-	new_rule->cond_branch = branch;
-
-	policy->ext->syn_rule_master_list[policy->ext->master_list_sz] = new_rule;
-	policy->ext->master_list_sz++;
+	if (qpol_syn_rule_expand_types(policy, rule, &source_types, &target_types))
+		return -1;
 
-	if (type_set_expand(&rule->stypes, &source_types, &policy->p->p, 0) ||
-	    type_set_expand(&rule->stypes, &source_types2, &policy->p->p, 1)) {
-		ERR(policy, "%s", strerror(ENOMEM));
-		error = ENOMEM;
-		goto err;
-	}
-	if (type_set_expand(&rule->ttypes, &target_types, &policy->p->p, 0) ||
-	    type_set_expand(&rule->ttypes, &target_types2, &policy->p->p, 1)) {
-		ERR(policy, "%s", strerror(ENOMEM));
-		error = ENOMEM;
-		goto err;
-	}
-	if (ebitmap_union(&source_types, &source_types2) || ebitmap_union(&target_types, &target_types2)) {
-		ERR(policy, "%s", strerror(ENOMEM));
-		error = ENOMEM;
-		goto err;
-	}
+	key.rule_type = rule->specified;
+	key.cond = syn_rule->cond;
 	ebitmap_for_each_bit(&source_types, snode, i) {
 		if (!ebitmap_get_bit(&source_types, i))
 			continue;
 		if (rule->flags & RULE_SELF) {
 			for (class_node = rule->perms; class_node; class_node = class_node->next) {
-				key.rule_type = rule->specified;
 				key.source_val = key.target_val = i + 1;
 				key.class_val = class_node->tclass;
-				key.cond = cond;
-				if (qpol_syn_rule_table_insert_entry(policy, table, &key, new_rule))
+				if (qpol_syn_rule_table_insert_entry(policy, table, &key, rule_idx))
 					goto err;
 			}
 		}
@@ -853,116 +993,132 @@ static int qpol_syn_rule_table_insert_sepol_avrule(qpol_policy_t * policy, qpol_
 			if (!ebitmap_get_bit(&target_types, j))
 				continue;
 			for (class_node = rule->perms; class_node; class_node = class_node->next) {
-				key.rule_type = rule->specified;
 				key.source_val = i + 1;
 				key.target_val = j + 1;
 				key.class_val = class_node->tclass;
-				key.cond = cond;
-				if (qpol_syn_rule_table_insert_entry(policy, table, &key, new_rule))
+				if (qpol_syn_rule_table_insert_entry(policy, table, &key, rule_idx))
 					goto err;
 			}
 		}
 	}
 
 	ebitmap_destroy(&source_types);
-	ebitmap_destroy(&source_types2);
 	ebitmap_destroy(&target_types);
-	ebitmap_destroy(&target_types2);
 	return 0;
 
       err:
+	error = errno;
 	ebitmap_destroy(&source_types);
-	ebitmap_destroy(&source_types2);
 	ebitmap_destroy(&target_types);
-	ebitmap_destroy(&target_types2);
+	errno = error;
 	return -1;
 }
 
-int qpol_policy_build_syn_rule_table(qpol_policy_t * policy)
+/**
+ *  Append a syntactic rule to the master list.
+ *  @param policy Policy associated with the rule.
+ *  @param rule The rule to add.
+ *  @param cond The conditional associated with the rule (NULL if
+ *  unconditional).
+ *  @param branch If the rule is conditional, then 0 if in the true
+ *  branch, 1 if in else.
+ *  @return 0 on success and < 0 on failure; if the call fails,
+ *  errno will be set.
+ */
+static int qpol_syn_rule_master_list_append(qpol_policy_t * policy, avrule_t * rule, cond_node_t * cond, int branch)
+{
+	struct qpol_syn_rule *new_rule = NULL;
+	int error;
+
+	if (!(new_rule = malloc(sizeof(struct qpol_syn_rule)))) {
+		error = errno;
+		ERR(policy, "%s", strerror(error));
+		errno = error;
+		return -1;
+	}
+	new_rule->rule = rule;
+	new_rule->cond = cond;
+	new_rule->cond_branch = branch;
+
+	policy->ext->syn_rule_master_list[policy->ext->master_list_sz] = new_rule;
+	policy->ext->master_list_sz++;
+	return 0;
+}
+
+/**
+ *  Create the policy's extended image if needed, then gather every
+ *  enabled syntactic rule into its master list.  Subsequent calls to
+ *  this function have no effect.
+ *  @param policy The policy whose rules to gather.
+ *  @return 0 on success and < 0 on failure; if the call fails,
+ *  errno will be set.  On success the master list is empty if the
+ *  policy is not a source policy.
+ */
+static int qpol_syn_rule_master_list_build(qpol_policy_t * policy)
 {
 	int error = 0, created = 0;
 	avrule_block_t *cur_block = NULL;
 	avrule_decl_t *decl = NULL;
 	avrule_t *cur_rule = NULL;
 	cond_node_t *cur_cond = NULL, *remapped_cond;
-
-	if (!policy) {
-		ERR(policy, "%s", strerror(EINVAL));
-		errno = EINVAL;
-		return -1;
-	}
+	size_t num_rules = 0;
 
 	if (!policy->ext) {
 		policy->ext = calloc(1, sizeof(qpol_extended_image_t));
 		if (!policy->ext) {
 			error = errno;
 			ERR(policy, "%s", strerror(error));
-			goto err;
+			errno = error;
+			return -1;
 		}
 	}
 
-	if (policy->ext->syn_rule_table)
+	if (policy->ext->syn_rule_master_list)
 		return 0;	       /* already built */
 
-	policy->ext->syn_rule_table = calloc(1, sizeof(qpol_syn_rule_table_t));
-	if (!policy->ext->syn_rule_table) {
-		error = errno;
-		ERR(policy, "%s", strerror(error));
-		goto err;
-	}
-	policy->ext->syn_rule_table->buckets = calloc(QPOL_SYN_RULE_TABLE_SIZE, sizeof(qpol_syn_rule_node_t *));
-	if (!policy->ext->syn_rule_table->buckets) {
-		error = errno;
-		ERR(policy, "%s", strerror(error));
-		goto err;
-	}
-
-	policy->ext->master_list_sz = 0;
 	for (cur_block = policy->p->p.global; cur_block; cur_block = cur_block->next) {
 		decl = cur_block->enabled;
 		if (!decl)
 			continue;
 
 		for (cur_rule = decl->avrules; cur_rule; cur_rule = cur_rule->next) {
-			policy->ext->master_list_sz++;
+			num_rules++;
 		}
 		for (cur_cond = decl->cond_list; cur_cond; cur_cond = cur_cond->next) {
 			for (cur_rule = cur_cond->avtrue_list; cur_rule; cur_rule = cur_rule->next) {
-				policy->ext->master_list_sz++;
+				num_rules++;
 			}
 			for (cur_rule = cur_cond->avfalse_list; cur_rule; cur_rule = cur_rule->next) {
-				policy->ext->master_list_sz++;
+				num_rules++;
 			}
 		}
 	}
 
-	if (policy->ext->master_list_sz == 0) {
-		policy->ext->syn_rule_master_list = NULL;
+	policy->ext->master_list_sz = 0;
+	if (num_rules == 0)
 		return 0;	       /* policy is not a source policy */
+	if (num_rules >= QPOL_SYN_RULE_NONE) {
+		ERR(policy, "%s", strerror(ERANGE));
+		errno = ERANGE;
+		return -1;
 	}
 
-	INFO(policy, "%s", "Building syntactic rules tables.");
-
-	policy->ext->syn_rule_master_list = calloc(policy->ext->master_list_sz, sizeof(struct qpol_syn_rule *));
+	policy->ext->syn_rule_master_list = calloc(num_rules, sizeof(struct qpol_syn_rule *));
 	if (!policy->ext->syn_rule_master_list) {
 		error = errno;
 		ERR(policy, "%s", strerror(error));
-		goto err;
+		errno = error;
+		return -1;
 	}
 
-	/* reset size as it will represent the current number of elements inserted */
-	policy->ext->master_list_sz = 0;
-
 	for (cur_block = policy->p->p.global; cur_block; cur_block = cur_block->next) {
 		decl = cur_block->enabled;
 		if (!decl)
 			continue;
 
 		for (cur_rule = decl->avrules; cur_rule; cur_rule = cur_rule->next) {
-			if (qpol_syn_rule_table_insert_sepol_avrule(policy, policy->ext->syn_rule_table, cur_rule, NULL, 0)) {
-				error = errno;
+			if (qpol_syn_rule_master_list_append(policy, cur_rule, NULL, 0))
 				goto err;
-			}
 		}
 		for (cur_cond = decl->cond_list; cur_cond; cur_cond = cur_cond->next) {
 			/* convert the cond within an avrule_decl to
@@ -970,77 +1126,272 @@ int qpol_policy_build_syn_rule_table(qpol_policy_t * policy)
 			remapped_cond = cond_node_find(&policy->p->p, cur_cond, policy->p->p.cond_list, &created);
 			if (created || !remapped_cond) {
 				cond_node_destroy(remapped_cond);
-				error = EIO;
 				ERR(policy, "%s", "Inconsistent conditional records");
 				assert(0);
+				errno = EIO;
 				goto err;
 			}
 			for (cur_rule = cur_cond->avtrue_list; cur_rule; cur_rule = cur_rule->next) {
-				if (qpol_syn_rule_table_insert_sepol_avrule
-				    (policy, policy->ext->syn_rule_table, cur_rule, remapped_cond, 0)) {
-					error = errno;
+				if (qpol_syn_rule_master_list_append(policy, cur_rule, remapped_cond, 0))
 					goto err;
-				}
 			}
 			for (cur_rule = cur_cond->avfalse_list; cur_rule; cur_rule = cur_rule->next) {
-				if (qpol_syn_rule_table_insert_sepol_avrule
-				    (policy, policy->ext->syn_rule_table, cur_rule, remapped_cond, 1)) {
-					error = errno;
+				if (qpol_syn_rule_master_list_append(policy, cur_rule, remapped_cond, 1))
 					goto err;
-				}
 			}
 		}
 	}
 
+	return 0;
+
+      err:
+	/* leave no partial list behind, so that a later call starts over */
+	error = errno;
+	for (; policy->ext->master_list_sz > 0; policy->ext->master_list_sz--)
+		qpol_syn_rule_destroy(&policy->ext->syn_rule_master_list[policy->ext->master_list_sz - 1]);
+	free(policy->ext->syn_rule_master_list);
+	policy->ext->syn_rule_master_list = NULL;
+	errno = error;
+	return -1;
+}
+
+int qpol_policy_build_syn_rule_table(qpol_policy_t * policy)
+{
+	int error = 0;
+	size_t i;
+
+	if (!policy) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (policy->ext && policy->ext->syn_rule_table)
+		return 0;	       /* already built, or indexed */
+
+	if (qpol_syn_rule_master_list_build(policy))
+		return -1;
+	if (policy->ext->master_list_sz == 0)
+		return 0;	       /* policy is not a source policy */
+
+	INFO(policy, "%s", "Building syntactic rules tables.");
+
+	/* most rules name only a few types; the table grows for those that do not */
+	policy->ext->syn_rule_table = qpol_syn_rule_table_create(policy->ext->master_list_sz * 4);
+	if (!policy->ext->syn_rule_table) {
+		error = errno;
+		ERR(policy, "%s", strerror(error));
+		goto err;
+	}
+
+	for (i = 0; i < policy->ext->master_list_sz; i++) {
+		if (qpol_syn_rule_table_insert_sepol_avrule(policy, policy->ext->syn_rule_table, (uint32_t) i)) {
+			error = errno;
+			goto err;
+		}
+	}
+
 #ifdef SETOOLS_DEBUG
 	/*
 	 * Debugging code to measure the how well the syntactic rules
-	 * are being hashed.  Calculate the min, max, and std
-	 * deviation.
+	 * are being hashed.  Calculate the mean and max probe length.
 	 */
-	size_t bucket;
-	float o2 = 0.0f;
-	long total_entries = 0;
-	for (bucket = 0; bucket < QPOL_SYN_RULE_TABLE_SIZE; bucket++) {
-		qpol_syn_rule_node_t *n = policy->ext->syn_rule_table->buckets[bucket];
-		while (n != NULL) {
-			total_entries++;
-			n = n->next;
+	qpol_syn_rule_table_t *t = policy->ext->syn_rule_table;
+	size_t slot, total_probes = 0, max_probes = 0;
+	for (slot = 0; slot < t->size; slot++) {
+		if (t->nodes[slot].rules == QPOL_SYN_RULE_NONE)
+			continue;
+		size_t home = qpol_syn_rule_table_hash(&t->nodes[slot].key) & (t->size - 1);
+		size_t probes = ((slot - home) & (t->size - 1)) + 1;
+		total_probes += probes;
+		if (probes > max_probes)
+			max_probes = probes;
+	}
+	fprintf(stderr, "libqpol synrule table %zu slots:  %zu keys, %lu entries in %zu chunks\n", t->size, t->num_nodes,
+		(unsigned long)t->num_entries, t->num_chunks);
+	fprintf(stderr, "                        mean probes %g, max %zu\n",
+		t->num_nodes ? (double)total_probes / t->num_nodes : 0.0, max_probes);
+#endif
+
+	return 0;
+
+      err:
+	qpol_syn_rule_table_destroy(&policy->ext->syn_rule_table);
+	errno = error;
+	return -1;
+}
+
+/**
+ *  Free the lazy index of an extended image.
+ */
+static void qpol_syn_rule_index_destroy(qpol_extended_image_t * ext)
+{
+	size_t i;
+
+	if (ext->syn_rule_sources) {
+		for (i = 0; i < ext->master_list_sz; i++)
+			ebitmap_destroy(&ext->syn_rule_sources[i]);
+		free(ext->syn_rule_sources);
+		ext->syn_rule_sources = NULL;
+	}
+	if (ext->syn_rule_targets) {
+		for (i = 0; i < ext->master_list_sz; i++)
+			ebitmap_destroy(&ext->syn_rule_targets[i]);
+		free(ext->syn_rule_targets);
+		ext->syn_rule_targets = NULL;
+	}
+	if (ext->class_rules) {
+		for (i = 0; i < ext->num_classes; i++)
+			free(ext->class_rules[i]);
+		free(ext->class_rules);
+		ext->class_rules = NULL;
+	}
+	free(ext->class_num_rules);
+	ext->class_num_rules = NULL;
+	ext->num_classes = 0;
+	ext->lazy = 0;
+}
+
+int qpol_policy_build_syn_rule_index(qpol_policy_t * policy)
+{
+	qpol_extended_image_t *ext = NULL;
+	class_perm_node_t *class_node = NULL;
+	uint32_t *rules = NULL;
+	size_t i, c;
+	int error = 0;
+
+	if (!policy) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (policy->ext && policy->ext->syn_rule_table)
+		return 0;	       /* already built, or indexed */
+
+	if (qpol_syn_rule_master_list_build(policy))
+		return -1;
+	ext = policy->ext;
+	if (ext->master_list_sz == 0)
+		return 0;	       /* policy is not a source policy */
+
+	INFO(policy, "%s", "Indexing syntactic rules.");
+
+	ext->lazy = 1;
+	ext->num_classes = policy->p->p.p_classes.nprim;
+	if (!(ext->syn_rule_sources = calloc(ext->master_list_sz, sizeof(ebitmap_t))) ||
+	    !(ext->syn_rule_targets = calloc(ext->master_list_sz, sizeof(ebitmap_t))) ||
+	    !(ext->class_rules = calloc(ext->num_classes, sizeof(uint32_t *))) ||
+	    !(ext->class_num_rules = calloc(ext->num_classes, sizeof(size_t)))) {
+		error = errno;
+		ERR(policy, "%s", strerror(error));
+		goto err;
+	}
+
+	/* count the rules naming each class, so that each class's list
+	 * is allocated once */
+	for (i = 0; i < ext->master_list_sz; i++) {
+		for (class_node = ext->syn_rule_master_list[i]->rule->perms; class_node; class_node = class_node->next) {
+			if (class_node->tclass > 0 && class_node->tclass <= ext->num_classes)
+				ext->class_num_rules[class_node->tclass - 1]++;
 		}
 	}
-	float expected_value = total_entries * 1.0f / QPOL_SYN_RULE_TABLE_SIZE;
-	size_t min_items = total_entries;
-	size_t max_items = 0;
-	for (bucket = 0; bucket < QPOL_SYN_RULE_TABLE_SIZE; bucket++) {
-		size_t num_items = 0;
-		qpol_syn_rule_node_t *n = policy->ext->syn_rule_table->buckets[bucket];
-		while (n != NULL) {
-			num_items++;
-			n = n->next;
+	for (c = 0; c < ext->num_classes; c++) {
+		if (ext->class_num_rules[c] == 0)
+			continue;
+		if (!(ext->class_rules[c] = malloc(ext->class_num_rules[c] * sizeof(uint32_t)))) {
+			error = errno;
+			ERR(policy, "%s", strerror(error));
+			goto err;
 		}
-		if (num_items > max_items) {
-			max_items = num_items;
+		ext->class_num_rules[c] = 0;
+	}
+
+	for (i = 0; i < ext->master_list_sz; i++) {
+		avrule_t *rule = ext->syn_rule_master_list[i]->rule;
+		if (qpol_syn_rule_expand_types(policy, rule, &ext->syn_rule_sources[i], &ext->syn_rule_targets[i])) {
+			error = errno;
+			goto err;
 		}
-		if (num_items < min_items) {
-			min_items = num_items;
+		for (class_node = rule->perms; class_node; class_node = class_node->next) {
+			if (class_node->tclass == 0 || class_node->tclass > ext->num_classes)
+				continue;
+			rules = ext->class_rules[class_node->tclass - 1];
+			c = ext->class_num_rules[class_node->tclass - 1];
+			/* a rule may list the same class more than once */
+			if (c > 0 && rules[c - 1] == (uint32_t) i)
+				continue;
+			rules[c] = (uint32_t) i;
+			ext->class_num_rules[class_node->tclass - 1]++;
 		}
-		o2 += (num_items - expected_value) * (num_items - expected_value);
 	}
-	float stddev = sqrtf(o2 / (QPOL_SYN_RULE_TABLE_SIZE - 1));
-	fprintf(stderr, "libqpol synrule table %d bits:  total entries %lu, expected %g\n", QPOL_SYN_RULE_TABLE_BITS, total_entries,
-		expected_value);
-	fprintf(stderr, "                        min %zd, max %zd, stddev %g\n", min_items, max_items, stddev);
-#endif
+
+	/* the table starts empty, and caches each key as it is looked up */
+	if (!(ext->syn_rule_table = qpol_syn_rule_table_create(0))) {
+		error = errno;
+		ERR(policy, "%s", strerror(error));
+		goto err;
+	}
 
 	return 0;
 
       err:
-	if (policy->ext)
-		qpol_syn_rule_table_destroy(&policy->ext->syn_rule_table);
+	qpol_syn_rule_index_destroy(ext);
 	errno = error;
 	return -1;
 }
 
+/**
+ *  Find the syntactic rules for a key.  If the policy has a lazy
+ *  index and the key has not yet been looked up, the rules are found
+ *  by testing each rule naming the key's class for membership of the
+ *  key's types, and the result is added to the table.
+ *  @param policy The policy whose rules to search.
+ *  @param key The key for which to search.
+ *  @return the key's node, or NULL if there are no rules for the key
+ *  or on error; errno will be set.
+ */
+static const qpol_syn_rule_node_t *qpol_syn_rule_lookup(const qpol_policy_t * policy, const qpol_syn_rule_key_t * key)
+{
+	qpol_extended_image_t *ext = policy->ext;
+	const qpol_syn_rule_node_t *node = NULL;
+	qpol_syn_rule_key_t rule_key = *key;
+	struct qpol_syn_rule *syn_rule = NULL;
+	const uint32_t *rules = NULL;
+	size_t i, num_rules;
+
+	if ((node = qpol_syn_rule_table_find_node_by_key(ext->syn_rule_table, key)) || !ext->lazy) {
+		if (!node)
+			errno = ENOENT;
+		return node;
+	}
+	if (key->class_val == 0 || key->class_val > ext->num_classes || key->source_val == 0 || key->target_val == 0) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	rules = ext->class_rules[key->class_val - 1];
+	num_rules = ext->class_num_rules[key->class_val - 1];
+	for (i = 0; i < num_rules; i++) {
+		syn_rule = ext->syn_rule_master_list[rules[i]];
+		if (!(syn_rule->rule->specified & key->rule_type) || syn_rule->cond != key->cond)
+			continue;
+		if (!ebitmap_get_bit(&ext->syn_rule_sources[rules[i]], key->source_val - 1))
+			continue;
+		if (!ebitmap_get_bit(&ext->syn_rule_targets[rules[i]], key->target_val - 1) &&
+		    !((syn_rule->rule->flags & RULE_SELF) && key->source_val == key->target_val))
+			continue;
+		/* file the rule under its own type, as the full table does */
+		rule_key.rule_type = syn_rule->rule->specified;
+		if (qpol_syn_rule_table_insert_entry(policy, ext->syn_rule_table, &rule_key, rules[i]))
+			return NULL;
+	}
+
+	if (!(node = qpol_syn_rule_table_find_node_by_key(ext->syn_rule_table, key)))
+		errno = ENOENT;
+	return node;
+}
+
 /**
  *  Free all memory used by a qpol extended image and set it to NULL.
  *  @param ext The extended image to destroy.
@@ -1053,6 +1404,7 @@ void qpol_extended_image_destroy(qpol_extended_image_t ** ext)
 		return;
 
 	qpol_syn_rule_table_destroy(&((*ext)->syn_rule_table));
+	qpol_syn_rule_index_destroy(*ext);
 
 	for (i = 0; i < (*ext)->master_list_sz; i++) {
 		qpol_syn_rule_destroy(&((*ext)->syn_rule_master_list[i]));
@@ -1063,10 +1415,71 @@ void qpol_extended_image_destroy(qpol_extended_image_t ** ext)
 	*ext = NULL;
 }
 
+/** The steps of policy_extend(), for reporting their timings. */
+typedef enum extend_step
+{
+	EXTEND_STEP_ALIASES = 0,
+	EXTEND_STEP_ATTRS,
+	EXTEND_STEP_ISIDS,
+	EXTEND_STEP_OBJECT_R,
+	EXTEND_STEP_TRACEBACK,
+	EXTEND_NUM_STEPS
+} extend_step_e;
+
+static const char *extend_step_names[EXTEND_NUM_STEPS] = {
+	"removing disabled aliases",
+	"generating attributes",
+	"naming initial sids",
+	"assigning object_r",
+	"building conditional rules tables"
+};
+
+/**
+ *  Run the steps of policy_extend() which rewrite the symbol tables.
+ *  Each depends on the one before, so they run in order.
+ *  @param policy The policy to extend.
+ *  @param seconds Array into which to write each step's time.
+ *  @return 0 on success and < 0 on failure; if the call fails, errno
+ *  will be set.
+ */
+static int extend_symbols(qpol_policy_t * policy, double *seconds)
+{
+	policydb_t *db = &policy->p->p;
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (qpol_policy_remove_bogus_aliases(policy))
+		return STATUS_ERR;
+	seconds[EXTEND_STEP_ALIASES] = extend_elapsed(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (db->attr_type_map) {
+		if (qpol_policy_build_attrs_from_map(policy))
+			return STATUS_ERR;
+		if (db->policy_type == POLICY_KERN && qpol_policy_fill_attr_holes(policy))
+			return STATUS_ERR;
+	}
+	seconds[EXTEND_STEP_ATTRS] = extend_elapsed(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (qpol_policy_add_isid_names(policy))
+		return STATUS_ERR;
+	seconds[EXTEND_STEP_ISIDS] = extend_elapsed(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (qpol_policy_add_object_r(policy))
+		return STATUS_ERR;
+	seconds[EXTEND_STEP_OBJECT_R] = extend_elapsed(&start);
+
+	return STATUS_SUCCESS;
+}
+
 int policy_extend(qpol_policy_t * policy)
 {
-	int retv, error;
-	policydb_t *db = NULL;
+	int error = 0;
+	double seconds[EXTEND_NUM_STEPS];
+	struct timespec start, step_start;
+	size_t i;
 
 	if (policy == NULL) {
 		ERR(policy, "%s", strerror(EINVAL));
@@ -1074,51 +1487,39 @@ int policy_extend(qpol_policy_t * policy)
 		return -1;
 	}
 
-	db = &policy->p->p;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	memset(seconds, 0, sizeof(seconds));
 
-	retv = qpol_policy_remove_bogus_aliases(policy);
-	if (retv) {
+	if (extend_symbols(policy, seconds)) {
 		error = errno;
 		goto err;
 	}
-	if (db->attr_type_map) {
-		retv = qpol_policy_build_attrs_from_map(policy);
-		if (retv) {
+
+	/* the traceback spreads its walk over the avtabs among threads
+	 * of its own; it runs here so that its messages come from the
+	 * calling thread */
+	if (!(policy->options & QPOL_POLICY_OPTION_NO_RULES)) {
+		clock_gettime(CLOCK_MONOTONIC, &step_start);
+		if (qpol_policy_add_cond_rule_traceback(policy)) {
 			error = errno;
 			goto err;
 		}
-		if (db->policy_type == POLICY_KERN) {
-			retv = qpol_policy_fill_attr_holes(policy);
-			if (retv) {
-				error = errno;
-				goto err;
-			}
-		}
-	}
-	retv = qpol_policy_add_isid_names(policy);
-	if (retv) {
-		error = errno;
-		goto err;
-	}
-	retv = qpol_policy_add_object_r(policy);
-	if (retv) {
-		error = errno;
-		goto err;
+		seconds[EXTEND_STEP_TRACEBACK] = extend_elapsed(&step_start);
 	}
 
+	/* downgrading the policy changes how it is read, so wait for
+	 * every other step */
 	if ((policy->options & QPOL_POLICY_OPTION_MATCH_SYSTEM) && qpol_policy_match_system(policy)) {
 		error = errno;
 		goto err;
 	}
 
-	if (policy->options & QPOL_POLICY_OPTION_NO_RULES)
-		return STATUS_SUCCESS;
-
-	retv = qpol_policy_add_cond_rule_traceback(policy);
-	if (retv) {
-		error = errno;
-		goto err;
+	for (i = 0; i < EXTEND_NUM_STEPS; i++) {
+		if (i == EXTEND_STEP_TRACEBACK && (policy->options & QPOL_POLICY_OPTION_NO_RULES))
+			continue;
+		INFO(policy, "Finished %s in %.3f seconds.", extend_step_names[i], seconds[i]);
 	}
+	INFO(policy, "Extended policy in %.3f seconds.", extend_elapsed(&start));
 
 	return STATUS_SUCCESS;
 
@@ -1129,10 +1530,13 @@ int policy_extend(qpol_policy_t * policy)
 	return STATUS_ERR;
 }
 
+/* The node found for the key is not kept: a later lazy lookup may grow
+ * the table, which moves its nodes.  Entries never move. */
 typedef struct syn_rule_state
 {
-	qpol_syn_rule_node_t *node;
-	qpol_syn_rule_list_t *cur;
+	const qpol_extended_image_t *ext;
+	uint32_t num_rules;
+	uint32_t cur;
 } syn_rule_state_t;
 
 static int syn_rule_state_end(const qpol_iterator_t * iter)
@@ -1144,7 +1548,7 @@ static int syn_rule_state_end(const qpol_iterator_t * iter)
 		return STATUS_ERR;
 	}
 
-	return (srs->cur ? 0 : 1);
+	return (srs->cur != QPOL_SYN_RULE_NONE ? 0 : 1);
 }
 
 static void *syn_rule_state_get_cur(const qpol_iterator_t * iter)
@@ -1156,7 +1560,7 @@ static void *syn_rule_state_get_cur(const qpol_iterator_t * iter)
 		return NULL;
 	}
 
-	return srs->cur->rule;
+	return srs->ext->syn_rule_master_list[qpol_syn_rule_table_get_entry(srs->ext->syn_rule_table, srs->cur)->rule];
 }
 
 static int syn_rule_state_next(qpol_iterator_t * iter)
@@ -1172,15 +1576,13 @@ static int syn_rule_state_next(qpol_iterator_t * iter)
 		return STATUS_ERR;
 	}
 
-	srs->cur = srs->cur->next;
+	srs->cur = qpol_syn_rule_table_get_entry(srs->ext->syn_rule_table, srs->cur)->next;
 
 	return STATUS_SUCCESS;
 }
 
 static size_t syn_rule_state_size(const qpol_iterator_t * iter)
 {
-	size_t count = 0;
-	qpol_syn_rule_list_t *tmp = NULL;
 	syn_rule_state_t *srs = NULL;
 
 	if (!iter || !(srs = qpol_iterator_state(iter))) {
@@ -1188,10 +1590,7 @@ static size_t syn_rule_state_size(const qpol_iterator_t * iter)
 		return 0;
 	}
 
-	for (tmp = srs->node->rules; tmp; tmp = tmp->next)
-		count++;
-
-	return count;
+	return srs->num_rules;
 }
 
 int qpol_avrule_get_syn_avrule_iter(const qpol_policy_t * policy, const struct qpol_avrule *rule, qpol_iterator_t ** iter)
@@ -1201,6 +1600,7 @@ int qpol_avrule_get_syn_avrule_iter(const qpol_policy_t * policy, const struct q
 	const qpol_class_t *tmp_class;
 	const qpol_cond_t *tmp_cond;
 	syn_rule_state_t *srs = NULL;
+	const qpol_syn_rule_node_t *node;
 	uint32_t tmp_val;
 	int error = 0;
 
@@ -1269,13 +1669,15 @@ int qpol_avrule_get_syn_avrule_iter(const qpol_policy_t * policy, const struct q
 		goto err;
 	}
 
-	srs->node = qpol_syn_rule_table_find_node_by_key(policy->ext->syn_rule_table, key);
-	if (!srs->node) {
+	node = qpol_syn_rule_lookup(policy, key);
+	if (!node) {
+		error = errno;
 		ERR(policy, "%s", "Unable to locate syntactic rules for semantic av rule");
-		errno = ENOENT;
 		goto err;
 	}
-	srs->cur = srs->node->rules;
+	srs->ext = policy->ext;
+	srs->num_rules = node->num_rules;
+	srs->cur = node->rules;
 
 	if (qpol_iterator_create(policy, (void *)srs,
 				 syn_rule_state_get_cur, syn_rule_state_next, syn_rule_state_end, syn_rule_state_size, free, iter))
@@ -1302,6 +1704,7 @@ int qpol_terule_get_syn_terule_iter(const qpol_policy_t * policy, const struct q
 	const qpol_class_t *tmp_class;
 	const qpol_cond_t *tmp_cond;
 	syn_rule_state_t *srs = NULL;
+	const qpol_syn_rule_node_t *node;
 	uint32_t tmp_val;
 	int error = 0;
 
@@ -1370,13 +1773,15 @@ int qpol_terule_get_syn_terule_iter(const qpol_policy_t * policy, const struct q
 		goto err;
 	}
 
-	srs->node = qpol_syn_rule_table_find_node_by_key(policy->ext->syn_rule_table, key);
-	if (!srs->node) {
+	node = qpol_syn_rule_lookup(policy, key);
+	if (!node) {
+		error = errno;
 		ERR(policy, "%s", "Unable to locate syntactic rules for semantic te rule");
-		error = ENOENT;
 		goto err;
 	}
-	srs->cur = srs->node->rules;
+	srs->ext = policy->ext;
+	srs->num_rules = node->num_rules;
+	srs->cur = node->rules;
 
 	if (qpol_iterator_create(policy, (void *)srs,
 				 syn_rule_state_get_cur, syn_rule_state_next, syn_rule_state_end, syn_rule_state_size, free, iter))
@@ -43,6 +43,7 @@ extern "C"
 #define QPOL_MSG_INFO 3
 
 	struct qpol_extended_image;
+	struct qpol_summary;
 	struct qpol_policy;
 
 	struct qpol_module
@@ -66,11 +67,15 @@ extern "C"
 		int type;
 		int modified;
 		struct qpol_extended_image *ext;
+		/** computed by qpol_policy_build_summary(), or NULL */
+		struct qpol_summary *summary;
 		struct qpol_module **modules;
 		size_t num_modules;
 		char *file_data;
 		size_t file_data_sz;
 		int file_data_type;
+		/** incremented each time qpol_policy_rebuild() replaces p */
+		unsigned int generation;
 	};
 /* qpol_policy_t.file_data_type will be one of the following to denote
  * the proper method of destroying the data:
@@ -93,6 +98,23 @@ extern "C"
  */
 	int policy_extend(qpol_policy_t * policy);
 
+/**
+ *  Walks the conditional list and adds links for reverse look up from
+ *  a te/av rule to the conditional from which it came.  This is done
+ *  by policy_extend() unless the policy's rules were not loaded.
+ *  @param policy The policy to which to add conditional trace backs.
+ *  This policy will be altered by this function.
+ *  @return 0 on success and < 0 on failure; if the call fails,
+ *  errno will be set. On failure, the policy state may be inconsistent.
+ */
+	int qpol_policy_add_cond_rule_traceback(qpol_policy_t * policy);
+
+/**
+ *  Free all memory used by a policy summary and set it to NULL.
+ *  @param summary The summary to destroy.
+ */
+	void qpol_summary_destroy(struct qpol_summary **summary);
+
 	extern void qpol_handle_msg(const qpol_policy_t * policy, int level, const char *fmt, ...);
 	int qpol_is_file_binpol(FILE * fp);
 	int qpol_is_file_mod_pkg(FILE * fp);
@@ -0,0 +1,452 @@
+/**
+ *  @file
+ *  Implementation of the policy summary.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <qpol/iterator.h>
+#include <qpol/policy.h>
+#include <qpol/summary_query.h>
+#include <sepol/policydb/policydb.h>
+#include <sepol/policydb/expand.h>
+#include "qpol_internal.h"
+
+/** A run of members within a summary's member array. */
+typedef struct qpol_summary_span
+{
+	size_t start;
+	size_t num;
+} qpol_summary_span_t;
+
+/**
+ * Membership is kept as one array of members per kind, into which
+ * each symbol has a span indexed by its value less one.  Types and
+ * attributes share a value space, so one set of spans holds the types
+ * of each attribute and the attributes of each type.
+ */
+struct qpol_summary
+{
+	size_t counts[QPOL_SUMMARY_NUM_COUNTS];
+	qpol_summary_span_t *type_spans;
+	size_t num_type_spans;
+	const qpol_type_t **type_members;
+	size_t num_type_members, type_members_sz;
+	qpol_summary_span_t *role_spans;
+	size_t num_role_spans;
+	const qpol_type_t **role_members;
+	size_t num_role_members, role_members_sz;
+};
+
+void qpol_summary_destroy(struct qpol_summary **summary)
+{
+	if (summary != NULL && *summary != NULL) {
+		free((*summary)->type_spans);
+		free((*summary)->type_members);
+		free((*summary)->role_spans);
+		free((*summary)->role_members);
+		free(*summary);
+		*summary = NULL;
+	}
+}
+
+/**
+ * Append every type within a bitmap to a member array, growing it as
+ * needed.
+ */
+static int summary_append_types(const policydb_t * db, const ebitmap_t * map, const qpol_type_t *** members, size_t * num,
+				size_t * sz)
+{
+	ebitmap_node_t *node;
+	unsigned int bit;
+	const qpol_type_t **tmp;
+
+	ebitmap_for_each_bit(map, node, bit) {
+		if (!ebitmap_node_get_bit(node, bit))
+			continue;
+		if (*num >= *sz) {
+			size_t new_sz = (*sz > 0 ? *sz * 2 : 256);
+			if ((tmp = realloc(*members, new_sz * sizeof(*tmp))) == NULL)
+				return -1;
+			*members = tmp;
+			*sz = new_sz;
+		}
+		(*members)[(*num)++] = (const qpol_type_t *)db->type_val_to_struct[bit];
+	}
+	return 0;
+}
+
+/**
+ * Make sure a span array covers a value, zeroing any new spans.
+ */
+static int summary_grow_spans(qpol_summary_span_t ** spans, size_t * num, uint32_t value)
+{
+	qpol_summary_span_t *tmp;
+	if (value <= *num)
+		return 0;
+	if ((tmp = realloc(*spans, value * sizeof(*tmp))) == NULL)
+		return -1;
+	memset(tmp + *num, 0, (value - *num) * sizeof(*tmp));
+	*spans = tmp;
+	*num = value;
+	return 0;
+}
+
+static int summary_perm_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Count the distinct permission names within all classes and commons.
+ */
+static int summary_count_perms(const qpol_policy_t * policy, size_t * count)
+{
+	qpol_iterator_t *iter = NULL, *perm_iter = NULL;
+	char **names = NULL, **tmp, *name;
+	size_t num = 0, sz = 0, i;
+	void *datum;
+	int pass, retval = -1;
+
+	for (pass = 0; pass < 2; pass++) {
+		if ((pass == 0 ? qpol_policy_get_class_iter(policy, &iter) : qpol_policy_get_common_iter(policy, &iter)) < 0)
+			goto cleanup;
+		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+			if (qpol_iterator_get_item(iter, &datum) < 0 ||
+			    (pass == 0 ? qpol_class_get_perm_iter(policy, datum, &perm_iter) :
+			     qpol_common_get_perm_iter(policy, datum, &perm_iter)) < 0)
+				goto cleanup;
+			for (; !qpol_iterator_end(perm_iter); qpol_iterator_next(perm_iter)) {
+				if (qpol_iterator_get_item(perm_iter, (void **)&name) < 0)
+					goto cleanup;
+				if (num >= sz) {
+					sz = (sz > 0 ? sz * 2 : 256);
+					if ((tmp = realloc(names, sz * sizeof(*tmp))) == NULL)
+						goto cleanup;
+					names = tmp;
+				}
+				names[num++] = name;
+			}
+			qpol_iterator_destroy(&perm_iter);
+		}
+		qpol_iterator_destroy(&iter);
+	}
+	if (num > 0)
+		qsort(names, num, sizeof(*names), summary_perm_cmp);
+	*count = 0;
+	for (i = 0; i < num; i++) {
+		if (i == 0 || strcmp(names[i - 1], names[i]) != 0)
+			(*count)++;
+	}
+	retval = 0;
+      cleanup:
+	qpol_iterator_destroy(&iter);
+	qpol_iterator_destroy(&perm_iter);
+	free(names);
+	return retval;
+}
+
+typedef int (*summary_iter_fn_t) (const qpol_policy_t * policy, qpol_iterator_t ** iter);
+
+/** Counts taken from the size of a policy iterator. */
+static const struct
+{
+	qpol_summary_count_e which;
+	summary_iter_fn_t get_iter;
+} summary_iter_counts[] = {
+	{QPOL_SUMMARY_CLASSES, qpol_policy_get_class_iter},
+	{QPOL_SUMMARY_LEVELS, qpol_policy_get_level_iter},
+	{QPOL_SUMMARY_CATS, qpol_policy_get_cat_iter},
+	{QPOL_SUMMARY_USERS, qpol_policy_get_user_iter},
+	{QPOL_SUMMARY_BOOLS, qpol_policy_get_bool_iter},
+	{QPOL_SUMMARY_ROLE_ALLOWS, qpol_policy_get_role_allow_iter},
+	{QPOL_SUMMARY_ROLE_TRANS, qpol_policy_get_role_trans_iter},
+	{QPOL_SUMMARY_RANGE_TRANS, qpol_policy_get_range_trans_iter},
+	{QPOL_SUMMARY_CONSTRAINTS, qpol_policy_get_constraint_iter},
+	{QPOL_SUMMARY_VALIDATETRANS, qpol_policy_get_validatetrans_iter},
+	{QPOL_SUMMARY_ISIDS, qpol_policy_get_isid_iter},
+	{QPOL_SUMMARY_FS_USES, qpol_policy_get_fs_use_iter},
+	{QPOL_SUMMARY_GENFSCONS, qpol_policy_get_genfscon_iter},
+	{QPOL_SUMMARY_PORTCONS, qpol_policy_get_portcon_iter},
+	{QPOL_SUMMARY_NETIFCONS, qpol_policy_get_netifcon_iter},
+	{QPOL_SUMMARY_NODECONS, qpol_policy_get_nodecon_iter},
+	{QPOL_SUMMARY_PERMISSIVES, qpol_policy_get_permissive_iter},
+	{QPOL_SUMMARY_POLCAPS, qpol_policy_get_polcap_iter},
+	{QPOL_SUMMARY_NUM_COUNTS, NULL}
+};
+
+/**
+ * Count the conditionals, and every rule by kind in one walk over
+ * each rule table.  These counts are left at 0 if the policy was
+ * loaded without its rules.
+ */
+static int summary_count_rules(const qpol_policy_t * policy, struct qpol_summary *s)
+{
+	qpol_iterator_t *iter = NULL;
+	uint32_t mask = QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT, rule_type;
+	void *rule;
+
+	if (!qpol_policy_has_capability(policy, QPOL_CAP_RULES_LOADED))
+		return 0;
+	if (qpol_policy_get_cond_iter(policy, &iter) < 0 || qpol_iterator_get_size(iter, &s->counts[QPOL_SUMMARY_CONDS]) < 0) {
+		qpol_iterator_destroy(&iter);
+		return -1;
+	}
+	qpol_iterator_destroy(&iter);
+
+	if (qpol_policy_has_capability(policy, QPOL_CAP_NEVERALLOW))
+		mask |= QPOL_RULE_NEVERALLOW;
+	if (qpol_policy_get_avrule_iter(policy, mask, &iter) < 0)
+		return -1;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, &rule) < 0 || qpol_avrule_get_rule_type(policy, rule, &rule_type) < 0) {
+			qpol_iterator_destroy(&iter);
+			return -1;
+		}
+		switch (rule_type) {
+		case QPOL_RULE_ALLOW:
+			s->counts[QPOL_SUMMARY_ALLOWS]++;
+			break;
+		case QPOL_RULE_NEVERALLOW:
+			s->counts[QPOL_SUMMARY_NEVERALLOWS]++;
+			break;
+		case QPOL_RULE_AUDITALLOW:
+			s->counts[QPOL_SUMMARY_AUDITALLOWS]++;
+			break;
+		case QPOL_RULE_DONTAUDIT:
+			s->counts[QPOL_SUMMARY_DONTAUDITS]++;
+			break;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+
+	if (qpol_policy_get_terule_iter(policy, QPOL_RULE_TYPE_TRANS | QPOL_RULE_TYPE_CHANGE | QPOL_RULE_TYPE_MEMBER, &iter) < 0)
+		return -1;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, &rule) < 0 || qpol_terule_get_rule_type(policy, rule, &rule_type) < 0) {
+			qpol_iterator_destroy(&iter);
+			return -1;
+		}
+		switch (rule_type) {
+		case QPOL_RULE_TYPE_TRANS:
+			s->counts[QPOL_SUMMARY_TYPE_TRANS]++;
+			break;
+		case QPOL_RULE_TYPE_CHANGE:
+			s->counts[QPOL_SUMMARY_TYPE_CHANGES]++;
+			break;
+		case QPOL_RULE_TYPE_MEMBER:
+			s->counts[QPOL_SUMMARY_TYPE_MEMBERS]++;
+			break;
+		}
+	}
+	qpol_iterator_destroy(&iter);
+	return 0;
+}
+
+/**
+ * Gather the members of every type and attribute, and count them.
+ */
+static int summary_build_types(const qpol_policy_t * policy, struct qpol_summary *s)
+{
+	const policydb_t *db = &policy->p->p;
+	qpol_iterator_t *iter = NULL;
+	type_datum_t *type;
+	unsigned char isalias;
+
+	if (qpol_policy_get_type_iter(policy, &iter) < 0)
+		return -1;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&type) < 0 ||
+		    qpol_type_get_isalias(policy, (qpol_type_t *) type, &isalias) < 0)
+			goto err;
+		if (isalias)
+			continue;
+		s->counts[type->flavor == TYPE_ATTRIB ? QPOL_SUMMARY_ATTRIBUTES : QPOL_SUMMARY_TYPES]++;
+		if (summary_grow_spans(&s->type_spans, &s->num_type_spans, type->s.value) < 0)
+			goto err;
+		s->type_spans[type->s.value - 1].start = s->num_type_members;
+		if (summary_append_types(db, &type->types, &s->type_members, &s->num_type_members, &s->type_members_sz) < 0)
+			goto err;
+		s->type_spans[type->s.value - 1].num = s->num_type_members - s->type_spans[type->s.value - 1].start;
+	}
+	qpol_iterator_destroy(&iter);
+	return 0;
+      err:
+	qpol_iterator_destroy(&iter);
+	return -1;
+}
+
+/**
+ * Expand and gather the types of every role, and count the roles.
+ */
+static int summary_build_roles(const qpol_policy_t * policy, struct qpol_summary *s)
+{
+	policydb_t *db = &policy->p->p;
+	qpol_iterator_t *iter = NULL;
+	role_datum_t *role;
+	ebitmap_t expanded;
+
+	if (qpol_policy_get_role_iter(policy, &iter) < 0)
+		return -1;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&role) < 0)
+			goto err;
+		s->counts[QPOL_SUMMARY_ROLES]++;
+		if (summary_grow_spans(&s->role_spans, &s->num_role_spans, role->s.value) < 0)
+			goto err;
+		ebitmap_init(&expanded);
+		if (type_set_expand(&role->types, &expanded, db, 1)) {
+			ebitmap_destroy(&expanded);
+			ERR(policy, "error reading type set for role %s", db->p_role_val_to_name[role->s.value - 1]);
+			errno = EIO;
+			goto err;
+		}
+		s->role_spans[role->s.value - 1].start = s->num_role_members;
+		if (summary_append_types(db, &expanded, &s->role_members, &s->num_role_members, &s->role_members_sz) < 0) {
+			ebitmap_destroy(&expanded);
+			goto err;
+		}
+		s->role_spans[role->s.value - 1].num = s->num_role_members - s->role_spans[role->s.value - 1].start;
+		ebitmap_destroy(&expanded);
+	}
+	qpol_iterator_destroy(&iter);
+	return 0;
+      err:
+	qpol_iterator_destroy(&iter);
+	return -1;
+}
+
+int qpol_policy_build_summary(qpol_policy_t * policy)
+{
+	struct qpol_summary *s = NULL;
+	qpol_iterator_t *iter = NULL;
+	size_t i;
+	int error;
+
+	if (policy == NULL) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return STATUS_ERR;
+	}
+	if (policy->summary != NULL)
+		return STATUS_SUCCESS;
+
+	if ((s = calloc(1, sizeof(*s))) == NULL)
+		goto err;
+	for (i = 0; summary_iter_counts[i].get_iter != NULL; i++) {
+		if (summary_iter_counts[i].get_iter(policy, &iter) < 0 ||
+		    qpol_iterator_get_size(iter, &s->counts[summary_iter_counts[i].which]) < 0)
+			goto err;
+		qpol_iterator_destroy(&iter);
+	}
+	if (summary_count_perms(policy, &s->counts[QPOL_SUMMARY_PERMS]) < 0 || summary_count_rules(policy, s) < 0 ||
+	    summary_build_types(policy, s) < 0 || summary_build_roles(policy, s) < 0)
+		goto err;
+
+	policy->summary = s;
+	return STATUS_SUCCESS;
+
+      err:
+	error = errno;
+	ERR(policy, "%s", strerror(error));
+	qpol_iterator_destroy(&iter);
+	qpol_summary_destroy(&s);
+	errno = error;
+	return STATUS_ERR;
+}
+
+int qpol_summary_get_count(const qpol_policy_t * policy, qpol_summary_count_e which, size_t * count)
+{
+	if (count != NULL)
+		*count = 0;
+	if (policy == NULL || policy->summary == NULL || (int)which < 0 || which >= QPOL_SUMMARY_NUM_COUNTS || count == NULL) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return STATUS_ERR;
+	}
+	*count = policy->summary->counts[which];
+	return STATUS_SUCCESS;
+}
+
+/**
+ * Look up a symbol's span within a summary.
+ */
+static int summary_get_span(const qpol_policy_t * policy, const qpol_summary_span_t * spans, size_t num_spans,
+			    const qpol_type_t ** members, uint32_t value, const qpol_type_t * const **list, size_t * num)
+{
+	if (value == 0 || value > num_spans) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return STATUS_ERR;
+	}
+	*num = spans[value - 1].num;
+	*list = (*num > 0 ? members + spans[value - 1].start : NULL);
+	return STATUS_SUCCESS;
+}
+
+static int summary_get_type_members(const qpol_policy_t * policy, const qpol_type_t * datum, int want_attr,
+				    const qpol_type_t * const **list, size_t * num)
+{
+	const type_datum_t *internal_datum = (const type_datum_t *)datum;
+
+	if (list != NULL)
+		*list = NULL;
+	if (num != NULL)
+		*num = 0;
+	if (policy == NULL || policy->summary == NULL || datum == NULL || list == NULL || num == NULL) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return STATUS_ERR;
+	}
+	if ((internal_datum->flavor == TYPE_ATTRIB) != want_attr)
+		return STATUS_NODATA;
+	return summary_get_span(policy, policy->summary->type_spans, policy->summary->num_type_spans,
+				policy->summary->type_members, internal_datum->s.value, list, num);
+}
+
+int qpol_summary_get_attr_types(const qpol_policy_t * policy, const qpol_type_t * datum, const qpol_type_t * const **types,
+				size_t * num_types)
+{
+	return summary_get_type_members(policy, datum, 1, types, num_types);
+}
+
+int qpol_summary_get_type_attrs(const qpol_policy_t * policy, const qpol_type_t * datum, const qpol_type_t * const **attrs,
+				size_t * num_attrs)
+{
+	return summary_get_type_members(policy, datum, 0, attrs, num_attrs);
+}
+
+int qpol_summary_get_role_types(const qpol_policy_t * policy, const qpol_role_t * datum, const qpol_type_t * const **types,
+				size_t * num_types)
+{
+	if (types != NULL)
+		*types = NULL;
+	if (num_types != NULL)
+		*num_types = 0;
+	if (policy == NULL || policy->summary == NULL || datum == NULL || types == NULL || num_types == NULL) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return STATUS_ERR;
+	}
+	return summary_get_span(policy, policy->summary->role_spans, policy->summary->num_role_spans,
+				policy->summary->role_members, ((const role_datum_t *)datum)->s.value, types, num_types);
+}
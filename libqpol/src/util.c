@@ -31,6 +31,7 @@
 
 #include <glob.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -172,6 +173,84 @@ int qpol_default_policy_find(char **path)
 	return search_policy_binary_file(path);
 }
 
+/** One thread's share of a qpol_parallel_run(). */
+typedef struct parallel_part
+{
+	qpol_parallel_fn_t *fn;
+	void *arg;
+	size_t first, last;
+	int error;
+} parallel_part_t;
+
+static void *parallel_worker(void *arg)
+{
+	parallel_part_t *part = arg;
+	part->error = part->fn(part->arg, part->first, part->last);
+	return NULL;
+}
+
+/**
+ * Number of processors online, or 1 if unknown.
+ */
+static size_t parallel_num_cpus(void)
+{
+	long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return (num_cpus > 0 ? (size_t) num_cpus : 1);
+}
+
+int qpol_parallel_run(size_t num_items, size_t min_per_thread, qpol_parallel_fn_t * fn, void *arg)
+{
+	parallel_part_t *parts = NULL;
+	pthread_t *threads = NULL;
+	size_t num_threads, num_started = 0, i;
+	int error = 0;
+
+	if (fn == NULL) {
+		return EINVAL;
+	}
+	if (num_items == 0) {
+		return 0;
+	}
+	if (min_per_thread == 0) {
+		min_per_thread = 1;
+	}
+	num_threads = parallel_num_cpus();
+	if (num_threads > num_items / min_per_thread) {
+		num_threads = num_items / min_per_thread;
+	}
+	if (num_threads > 1 && (parts = calloc(num_threads, sizeof(*parts))) != NULL &&
+	    (threads = calloc(num_threads - 1, sizeof(*threads))) != NULL) {
+		for (i = 0; i < num_threads; i++) {
+			parts[i].fn = fn;
+			parts[i].arg = arg;
+			parts[i].first = num_items * i / num_threads;
+			parts[i].last = num_items * (i + 1) / num_threads;
+		}
+		for (; num_started < num_threads - 1; num_started++) {
+			if (pthread_create(threads + num_started, NULL, parallel_worker, parts + num_started + 1) != 0) {
+				break;
+			}
+		}
+		/* the calling thread does its own share, and any share
+		 * whose thread could not be started */
+		parallel_worker(parts);
+		for (i = num_started + 1; i < num_threads; i++) {
+			parallel_worker(parts + i);
+		}
+		for (i = 0; i < num_started; i++) {
+			pthread_join(threads[i], NULL);
+		}
+		for (i = 0; i < num_threads && error == 0; i++) {
+			error = parts[i].error;
+		}
+	} else {
+		error = fn(arg, 0, num_items);
+	}
+	free(threads);
+	free(parts);
+	return error;
+}
+
 #include <stdlib.h>
 #include <bzlib.h>
 #include <string.h>
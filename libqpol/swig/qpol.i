@@ -419,6 +419,16 @@ typedef enum qpol_capability
 	fail:
 		return;
 	};
+	%rename(build_syn_rule_index) wrap_build_syn_rule_index;
+	void wrap_build_syn_rule_index() {
+		BEGIN_EXCEPTION
+		if (qpol_policy_build_syn_rule_index(self)) {
+			SWIG_exception(SWIG_MemoryError, "Out of Memory");
+		}
+		END_EXCEPTION
+	fail:
+		return;
+	};
 	%newobject get_module_iter();
 	%rename(get_module_iter) wrap_get_module_iter;
 	qpol_iterator_t *wrap_get_module_iter() {
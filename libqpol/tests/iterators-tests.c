@@ -65,9 +65,113 @@ static void iterators_alias(void)
 	qpol_iterator_destroy(&iter);
 }
 
+/**
+ * Check that an iterator returns exactly the given types, in order.
+ */
+static void iterators_check_members(qpol_iterator_t * iter, const qpol_type_t * const *members, size_t num_members)
+{
+	size_t i = 0, size;
+	CU_ASSERT_FATAL(qpol_iterator_get_size(iter, &size) == 0);
+	CU_ASSERT(size == num_members);
+	for (; !qpol_iterator_end(iter) && i < num_members; qpol_iterator_next(iter), i++) {
+		void *v;
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, &v) == 0);
+		CU_ASSERT(v == members[i]);
+	}
+	CU_ASSERT(i == num_members && qpol_iterator_end(iter));
+}
+
+static void iterators_summary(void)
+{
+	qpol_iterator_t *iter = NULL, *member_iter = NULL;
+	const qpol_type_t *const *members;
+	size_t num_members, num_types = 0, num_attrs = 0, count;
+	CU_ASSERT_FATAL(qpol_policy_build_summary(qp) == 0);
+	/* a second build has no effect */
+	CU_ASSERT_FATAL(qpol_policy_build_summary(qp) == 0);
+
+	CU_ASSERT_FATAL(qpol_policy_get_type_iter(qp, &iter) == 0);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		void *v;
+		unsigned char isalias, isattr;
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, &v) == 0);
+		qpol_type_t *type = (qpol_type_t *) v;
+		CU_ASSERT_FATAL(qpol_type_get_isalias(qp, type, &isalias) == 0);
+		CU_ASSERT_FATAL(qpol_type_get_isattr(qp, type, &isattr) == 0);
+		if (isalias)
+			continue;
+		if (isattr) {
+			num_attrs++;
+			/* attributes have no attributes of their own */
+			CU_ASSERT(qpol_summary_get_type_attrs(qp, type, &members, &num_members) > 0);
+			CU_ASSERT_FATAL(qpol_summary_get_attr_types(qp, type, &members, &num_members) == 0);
+			CU_ASSERT_FATAL(qpol_type_get_type_iter(qp, type, &member_iter) == 0);
+		} else {
+			num_types++;
+			CU_ASSERT_FATAL(qpol_summary_get_type_attrs(qp, type, &members, &num_members) == 0);
+			CU_ASSERT_FATAL(qpol_type_get_attr_iter(qp, type, &member_iter) == 0);
+		}
+		iterators_check_members(member_iter, members, num_members);
+		qpol_iterator_destroy(&member_iter);
+	}
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT(qpol_summary_get_count(qp, QPOL_SUMMARY_TYPES, &count) == 0 && count == num_types);
+	CU_ASSERT(qpol_summary_get_count(qp, QPOL_SUMMARY_ATTRIBUTES, &count) == 0 && count == num_attrs);
+
+	CU_ASSERT_FATAL(qpol_policy_get_role_iter(qp, &iter) == 0);
+	CU_ASSERT_FATAL(qpol_iterator_get_size(iter, &num_members) == 0);
+	CU_ASSERT(qpol_summary_get_count(qp, QPOL_SUMMARY_ROLES, &count) == 0 && count == num_members);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		void *v;
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, &v) == 0);
+		CU_ASSERT_FATAL(qpol_summary_get_role_types(qp, (qpol_role_t *) v, &members, &num_members) == 0);
+		CU_ASSERT_FATAL(qpol_role_get_type_iter(qp, (qpol_role_t *) v, &member_iter) == 0);
+		iterators_check_members(member_iter, members, num_members);
+		qpol_iterator_destroy(&member_iter);
+	}
+	qpol_iterator_destroy(&iter);
+
+	CU_ASSERT_FATAL(qpol_policy_get_class_iter(qp, &iter) == 0);
+	CU_ASSERT_FATAL(qpol_iterator_get_size(iter, &num_members) == 0);
+	CU_ASSERT(qpol_summary_get_count(qp, QPOL_SUMMARY_CLASSES, &count) == 0 && count == num_members);
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT(qpol_summary_get_count(qp, QPOL_SUMMARY_NUM_COUNTS, &count) < 0);
+}
+
+static void iterators_summary_no_rules(void)
+{
+	qpol_policy_t *with_rules = NULL;
+	size_t count, with_count;
+	qpol_summary_count_e which;
+
+	/* the suite's policy was loaded without its rules, so the
+	 * summary leaves the conditional and rule counts at 0 */
+	CU_ASSERT_FATAL(!qpol_policy_has_capability(qp, QPOL_CAP_RULES_LOADED));
+	CU_ASSERT_FATAL(qpol_policy_build_summary(qp) == 0);
+	CU_ASSERT(qpol_summary_get_count(qp, QPOL_SUMMARY_CONDS, &count) == 0 && count == 0);
+	for (which = QPOL_SUMMARY_ALLOWS; which <= QPOL_SUMMARY_TYPE_MEMBERS; which++) {
+		CU_ASSERT(qpol_summary_get_count(qp, which, &count) == 0 && count == 0);
+	}
+
+	/* the symbol counts do not depend upon the rules */
+	CU_ASSERT_FATAL(qpol_policy_open_from_file(SOURCE_POLICY, &with_rules, NULL, NULL, 0) >= 0);
+	CU_ASSERT_FATAL(qpol_policy_build_summary(with_rules) == 0);
+	CU_ASSERT(qpol_summary_get_count(with_rules, QPOL_SUMMARY_ALLOWS, &count) == 0 && count > 0);
+	for (which = QPOL_SUMMARY_CLASSES; which <= QPOL_SUMMARY_BOOLS; which++) {
+		CU_ASSERT_FATAL(qpol_summary_get_count(qp, which, &count) == 0);
+		CU_ASSERT_FATAL(qpol_summary_get_count(with_rules, which, &with_count) == 0);
+		CU_ASSERT(count == with_count);
+	}
+	qpol_policy_destroy(&with_rules);
+}
+
 CU_TestInfo iterators_tests[] = {
 	{"alias iterator", iterators_alias}
 	,
+	{"policy summary", iterators_summary}
+	,
+	{"policy summary without rules", iterators_summary_no_rules}
+	,
 	CU_TEST_INFO_NULL
 };
 
@@ -26,13 +26,24 @@
 #include <config.h>
 
 #include <CUnit/CUnit.h>
+#include <qpol/avrule_query.h>
+#include <qpol/cond_query.h>
+#include <qpol/module.h>
 #include <qpol/policy.h>
+#include <qpol/type_query.h>
 #include "../src/qpol_internal.h"
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #define BROKEN_ALIAS_POLICY TEST_POLICIES "/setools-3.3/policy-features/broken-alias-mod.21"
 #define NOT_BROKEN_ALIAS_POLICY TEST_POLICIES "/setools-3.3/policy-features/not-broken-alias-mod.21"
 #define NOGENFS_POLICY TEST_POLICIES "/setools-3.3/policy-features/nogenfscon-policy.21"
+#define MODULE_6 TEST_POLICIES "/policy-versions/base-6.pp"
+#define MODULE_8 TEST_POLICIES "/policy-versions/base-8.pp"
+#define COND_POLICY TEST_POLICIES "/snapshots/fc4_targeted.policy.conf"
 
 static void policy_features_alias_count(void *varg, const qpol_policy_t * policy
 					__attribute__ ((unused)), int level, const char *fmt, va_list va_args)
@@ -126,11 +137,180 @@ static void policy_features_nogenfscon_iter(void)
 	qpol_policy_destroy(&qp);
 }
 
+/** Count a binary policy's rules of every kind. */
+static size_t policy_features_count_avrules(qpol_policy_t * qp)
+{
+	qpol_iterator_t *iter = NULL;
+	size_t num_rules = 0;
+	CU_ASSERT_FATAL(qpol_policy_get_avrule_iter(qp, QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT, &iter) == 0);
+	CU_ASSERT_FATAL(qpol_iterator_get_size(iter, &num_rules) == 0);
+	qpol_iterator_destroy(&iter);
+	return num_rules;
+}
+
+/** Test that a binary policy opened without its rules can load them
+ *  later, without disturbing its other components. */
+static void policy_features_binary_rules_on_demand(void)
+{
+	qpol_policy_t *qp = NULL;
+	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *type = NULL;
+	const char *name_before, *name_after;
+	size_t num_rules;
+
+	int policy_type = qpol_policy_open_from_file(NOT_BROKEN_ALIAS_POLICY, &qp, NULL, NULL, 0);
+	CU_ASSERT_FATAL(policy_type == QPOL_POLICY_KERNEL_BINARY);
+	CU_ASSERT(qpol_policy_has_capability(qp, QPOL_CAP_RULES_LOADED));
+	num_rules = policy_features_count_avrules(qp);
+	qpol_policy_destroy(&qp);
+
+	policy_type = qpol_policy_open_from_file(NOT_BROKEN_ALIAS_POLICY, &qp, NULL, NULL, QPOL_POLICY_OPTION_NO_RULES);
+	CU_ASSERT_FATAL(policy_type == QPOL_POLICY_KERNEL_BINARY);
+	CU_ASSERT(!qpol_policy_has_capability(qp, QPOL_CAP_RULES_LOADED));
+	CU_ASSERT(qpol_policy_get_avrule_iter(qp, QPOL_RULE_ALLOW, &iter) < 0);
+
+	CU_ASSERT_FATAL(qpol_policy_get_type_iter(qp, &iter) == 0);
+	CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&type) == 0);
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT_FATAL(qpol_type_get_name(qp, type, &name_before) == 0);
+
+	CU_ASSERT_FATAL(qpol_policy_rebuild(qp, 0) == 0);
+	CU_ASSERT(qpol_policy_has_capability(qp, QPOL_CAP_RULES_LOADED));
+	CU_ASSERT(policy_features_count_avrules(qp) == num_rules);
+
+	/* components read before the rules were loaded are still valid */
+	CU_ASSERT_FATAL(qpol_type_get_name(qp, type, &name_after) == 0);
+	CU_ASSERT_STRING_EQUAL(name_before, name_after);
+
+	/* once loaded, rebuilding again does nothing */
+	CU_ASSERT(qpol_policy_rebuild(qp, 0) == 0);
+	qpol_policy_destroy(&qp);
+}
+
+typedef struct module_msg_count
+{
+	pthread_t caller;
+	size_t num_msgs, num_elsewhere;
+} module_msg_count_t;
+
+static void policy_features_module_msg(void *varg, const qpol_policy_t * policy
+				       __attribute__ ((unused)), int level __attribute__ ((unused)), const char *fmt
+				       __attribute__ ((unused)), va_list va_args __attribute__ ((unused)))
+{
+	module_msg_count_t *c = varg;
+	c->num_msgs++;
+	if (!pthread_equal(pthread_self(), c->caller))
+		c->num_elsewhere++;
+}
+
+/** Test that reading several modules at once gives the same modules
+ *  as reading them one at a time, and that libsepol's messages about
+ *  them reach the caller's callback on the calling thread. */
+static void policy_features_concurrent_modules(void)
+{
+	const char *paths[] = { MODULE_6, MODULE_8, MODULE_6, MODULE_8 };
+	const char *bad_paths[] = { MODULE_6, TEST_POLICIES "/no-such-module.pp", MODULE_8 };
+	char truncated[] = "/tmp/qpol-module-XXXXXX";
+	const char *truncated_paths[] = { MODULE_6, truncated, MODULE_8 };
+	qpol_module_t *modules[4], *single = NULL;
+	qpol_policy_t *qp = NULL;
+	module_msg_count_t count;
+	const char *name, *single_name, *version, *single_version;
+	char buf[64];
+	size_t i, failed = 0, len;
+	FILE *in, *out;
+	int fd;
+
+	CU_ASSERT_FATAL(qpol_module_create_from_files(NULL, paths, 4, modules, 2, &failed) == 0);
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT_FATAL(modules[i] != NULL);
+		CU_ASSERT_FATAL(qpol_module_create_from_file(paths[i], &single) == 0);
+		CU_ASSERT(qpol_module_get_name(modules[i], &name) == 0);
+		CU_ASSERT(qpol_module_get_name(single, &single_name) == 0);
+		CU_ASSERT(qpol_module_get_version(modules[i], &version) == 0);
+		CU_ASSERT(qpol_module_get_version(single, &single_version) == 0);
+		CU_ASSERT((name == NULL && single_name == NULL) || (name != NULL && single_name != NULL && strcmp(name, single_name) == 0));
+		CU_ASSERT((version == NULL && single_version == NULL) ||
+			  (version != NULL && single_version != NULL && strcmp(version, single_version) == 0));
+		qpol_module_destroy(&single);
+		qpol_module_destroy(&modules[i]);
+	}
+
+	CU_ASSERT(qpol_module_create_from_files(NULL, bad_paths, 3, modules, 0, &failed) < 0);
+	CU_ASSERT(failed == 1);
+	for (i = 0; i < 3; i++) {
+		CU_ASSERT(modules[i] == NULL);
+	}
+
+	/* a package cut short after its header makes libsepol complain */
+	fd = mkstemp(truncated);
+	CU_ASSERT_FATAL(fd >= 0);
+	CU_ASSERT_FATAL((out = fdopen(fd, "wb")) != NULL);
+	CU_ASSERT_FATAL((in = fopen(MODULE_6, "rb")) != NULL);
+	len = fread(buf, 1, sizeof(buf), in);
+	CU_ASSERT_FATAL(len == sizeof(buf));
+	CU_ASSERT_FATAL(fwrite(buf, 1, len, out) == len);
+	fclose(in);
+	fclose(out);
+
+	memset(&count, 0, sizeof(count));
+	count.caller = pthread_self();
+	CU_ASSERT_FATAL(qpol_policy_open_from_file(NOGENFS_POLICY, &qp, policy_features_module_msg, &count,
+						   QPOL_POLICY_OPTION_NO_RULES) >= 0);
+	count.num_msgs = count.num_elsewhere = 0;
+	CU_ASSERT(qpol_module_create_from_files(qp, truncated_paths, 3, modules, 3, &failed) < 0);
+	CU_ASSERT(failed == 1);
+	CU_ASSERT(count.num_msgs > 0);
+	CU_ASSERT(count.num_elsewhere == 0);
+	qpol_policy_destroy(&qp);
+	unlink(truncated);
+}
+
+/** Test that every av rule is marked enabled exactly when its
+ *  conditional, if any, selects the list holding it.  The rules are
+ *  marked by several threads when the policy is large. */
+static void policy_features_rule_traceback(void)
+{
+	qpol_policy_t *qp = NULL;
+	qpol_iterator_t *iter = NULL;
+	size_t num_cond = 0;
+
+	int policy_type = qpol_policy_open_from_file(COND_POLICY, &qp, NULL, NULL, 0);
+	CU_ASSERT_FATAL(policy_type == QPOL_POLICY_KERNEL_SOURCE);
+	CU_ASSERT_FATAL(qpol_policy_get_avrule_iter(qp, QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT, &iter) ==
+			0);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		const qpol_avrule_t *rule;
+		const qpol_cond_t *cond;
+		uint32_t is_enabled, which_list, is_true;
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&rule) == 0);
+		CU_ASSERT_FATAL(qpol_avrule_get_cond(qp, rule, &cond) == 0);
+		CU_ASSERT_FATAL(qpol_avrule_get_is_enabled(qp, rule, &is_enabled) == 0);
+		if (cond == NULL) {
+			CU_ASSERT(is_enabled == 1);
+			continue;
+		}
+		num_cond++;
+		CU_ASSERT_FATAL(qpol_avrule_get_which_list(qp, rule, &which_list) == 0);
+		CU_ASSERT_FATAL(qpol_cond_eval(qp, cond, &is_true) == 0);
+		CU_ASSERT(is_enabled == (which_list ? is_true : !is_true));
+	}
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT(num_cond > 0);
+	qpol_policy_destroy(&qp);
+}
+
 CU_TestInfo policy_features_tests[] = {
 	{"invalid alias", policy_features_invalid_alias}
 	,
 	{"No genfscon", policy_features_nogenfscon_iter}
 	,
+	{"binary rules on demand", policy_features_binary_rules_on_demand}
+	,
+	{"concurrent modules", policy_features_concurrent_modules}
+	,
+	{"rule traceback", policy_features_rule_traceback}
+	,
 	CU_TEST_INFO_NULL
 };
 
@@ -0,0 +1,136 @@
+/**
+ *  @file
+ *
+ *  Benchmark building the syntactic rule table of a source policy,
+ *  then looking up the syntactic rules of every semantic av and te
+ *  rule.  Reports the time taken by each step and the growth in the
+ *  process's peak resident set size while building the table.
+ *
+ *  Build with "make synrule-bench", then run:
+ *
+ *    synrule-bench POLICY
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <qpol/avrule_query.h>
+#include <qpol/iterator.h>
+#include <qpol/policy.h>
+#include <qpol/policy_extend.h>
+#include <qpol/terule_query.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/** Peak resident set size, in kilobytes. */
+static long peak_rss(void)
+{
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) < 0) {
+		return 0;
+	}
+	return ru.ru_maxrss;
+}
+
+/**
+ * Look up the syntactic rules of every semantic rule, adding the
+ * number of rules found to *num_syn.
+ */
+static int lookup_all(qpol_policy_t * q, int is_av, size_t * num_rules, size_t * num_syn)
+{
+	qpol_iterator_t *iter = NULL, *syn_iter = NULL;
+	size_t size;
+	int retval = -1;
+	if ((is_av ? qpol_policy_get_avrule_iter(q, QPOL_RULE_ALLOW | QPOL_RULE_NEVERALLOW | QPOL_RULE_AUDITALLOW |
+						  QPOL_RULE_DONTAUDIT, &iter) :
+	     qpol_policy_get_terule_iter(q, QPOL_RULE_TYPE_TRANS | QPOL_RULE_TYPE_CHANGE | QPOL_RULE_TYPE_MEMBER, &iter)) < 0) {
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		void *rule;
+		if (qpol_iterator_get_item(iter, &rule) < 0 ||
+		    (is_av ? qpol_avrule_get_syn_avrule_iter(q, rule, &syn_iter) :
+		     qpol_terule_get_syn_terule_iter(q, rule, &syn_iter)) < 0 || qpol_iterator_get_size(syn_iter, &size) < 0) {
+			goto cleanup;
+		}
+		(*num_rules)++;
+		*num_syn += size;
+		qpol_iterator_destroy(&syn_iter);
+	}
+	retval = 0;
+      cleanup:
+	qpol_iterator_destroy(&syn_iter);
+	qpol_iterator_destroy(&iter);
+	return retval;
+}
+
+int main(int argc, char **argv)
+{
+	qpol_policy_t *q = NULL;
+	size_t num_rules = 0, num_syn = 0;
+	long rss_before, rss_after;
+	double start, build_time, lookup_time;
+	int retval = EXIT_FAILURE;
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s POLICY\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (qpol_policy_open_from_file(argv[1], &q, NULL, NULL, 0) < 0) {
+		perror("Error opening policy");
+		goto cleanup;
+	}
+	if (!qpol_policy_has_capability(q, QPOL_CAP_SYN_RULES)) {
+		fprintf(stderr, "%s does not have syntactic rules.\n", argv[1]);
+		goto cleanup;
+	}
+
+	rss_before = peak_rss();
+	start = now();
+	if (qpol_policy_build_syn_rule_table(q) < 0) {
+		perror("Error building syntactic rule table");
+		goto cleanup;
+	}
+	build_time = now() - start;
+	rss_after = peak_rss();
+
+	start = now();
+	if (lookup_all(q, 1, &num_rules, &num_syn) < 0 || lookup_all(q, 0, &num_rules, &num_syn) < 0) {
+		perror("Error looking up syntactic rules");
+		goto cleanup;
+	}
+	lookup_time = now() - start;
+
+	printf("build:  %.3f s, peak RSS grew by %ld kB\n", build_time, rss_after - rss_before);
+	printf("lookup: %.3f s for %zu rules (%.1f us/rule, %zu syntactic rules)\n", lookup_time, num_rules,
+	       num_rules > 0 ? lookup_time * 1e6 / num_rules : 0.0, num_syn);
+	retval = EXIT_SUCCESS;
+      cleanup:
+	qpol_policy_destroy(&q);
+	return retval;
+}
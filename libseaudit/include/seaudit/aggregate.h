@@ -0,0 +1,273 @@
+/**
+ *  @file
+ *
+ *  Public interface to a seaudit_aggregate.  An aggregate summarizes
+ *  a stream of audit messages in a single pass.  AVC messages are
+ *  grouped by (source context, target context, object class,
+ *  permission); each group records how many times it was seen along
+ *  with the first and last time it was seen.  Because an aggregate
+ *  does not hold onto the messages themselves, its memory usage is
+ *  bounded by the number of distinct groups rather than by the size
+ *  of the log.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SEAUDIT_AGGREGATE_H
+#define SEAUDIT_AGGREGATE_H
+
+#ifdef  __cplusplus
+extern "C"
+{
+#endif
+
+#include "avc_message.h"
+#include "log.h"
+#include "message.h"
+
+#include <apol/vector.h>
+#include <stddef.h>
+#include <time.h>
+
+	typedef struct seaudit_aggregate seaudit_aggregate_t;
+	typedef struct seaudit_aggregate_entry seaudit_aggregate_entry_t;
+
+/**
+ * Allocate and return a new, empty aggregate.
+ *
+ * @return A newly allocated aggregate, or NULL upon error.  The
+ * caller must call seaudit_aggregate_destroy() afterwards.
+ */
+	extern seaudit_aggregate_t *seaudit_aggregate_create(void);
+
+/**
+ * Destroy the referenced aggregate, including all of its entries.
+ *
+ * @param agg Aggregate to destroy.  The pointer will be set to NULL
+ * afterwards.  (If pointer is already NULL then do nothing.)
+ */
+	extern void seaudit_aggregate_destroy(seaudit_aggregate_t ** agg);
+
+/**
+ * Add a single message to an aggregate.  Message counters are always
+ * updated; AVC messages are additionally added to one group per
+ * permission within the message.  The aggregate does not keep a
+ * reference to the message itself, but it does keep pointers to the
+ * context, class, and permission strings stored within the message's
+ * log.  Therefore the log must not be destroyed or cleared while
+ * the aggregate is in use.
+ *
+ * @param agg Aggregate to which add the message.
+ * @param msg Message to add.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int seaudit_aggregate_add_message(seaudit_aggregate_t * agg, const seaudit_message_t * msg);
+
+/**
+ * Callback suitable for passing to seaudit_log_parse_stream().  The
+ * callback argument must be a seaudit_aggregate_t.  Each parsed
+ * message is added to the aggregate.  Policy load messages, boolean
+ * change messages, and granted setenforce messages are infrequent yet
+ * are listed individually by seaudit reports, so those messages are
+ * retained within the log; all other messages are discarded once
+ * added.
+ *
+ * @param arg Aggregate to which add messages.
+ * @param log Log that parsed the message.
+ * @param msg Message that was just parsed.
+ *
+ * @return > 0 if the message should be retained within the log, 0 if
+ * it may be discarded, < 0 on error.
+ */
+	extern int seaudit_aggregate_stream_fn(void *arg, const seaudit_log_t * log, const seaudit_message_t * msg);
+
+/**
+ * Return the total number of messages added to the aggregate.
+ *
+ * @param agg Aggregate to query.
+ *
+ * @return Number of messages.
+ */
+	extern size_t seaudit_aggregate_get_num_messages(const seaudit_aggregate_t * agg);
+
+/**
+ * Return the number of avc allow messages added to the aggregate.
+ *
+ * @param agg Aggregate to query.
+ *
+ * @return Number of allow messages.
+ */
+	extern size_t seaudit_aggregate_get_num_allows(const seaudit_aggregate_t * agg);
+
+/**
+ * Return the number of avc deny messages added to the aggregate.
+ *
+ * @param agg Aggregate to query.
+ *
+ * @return Number of deny messages.
+ */
+	extern size_t seaudit_aggregate_get_num_denies(const seaudit_aggregate_t * agg);
+
+/**
+ * Return the number of boolean change messages added to the
+ * aggregate.
+ *
+ * @param agg Aggregate to query.
+ *
+ * @return Number of boolean messages.
+ */
+	extern size_t seaudit_aggregate_get_num_bools(const seaudit_aggregate_t * agg);
+
+/**
+ * Return the number of policy load messages added to the aggregate.
+ *
+ * @param agg Aggregate to query.
+ *
+ * @return Number of load messages.
+ */
+	extern size_t seaudit_aggregate_get_num_loads(const seaudit_aggregate_t * agg);
+
+/**
+ * Return the number of distinct groups within the aggregate.
+ *
+ * @param agg Aggregate to query.
+ *
+ * @return Number of groups.
+ */
+	extern size_t seaudit_aggregate_get_num_entries(const seaudit_aggregate_t * agg);
+
+/**
+ * Return the groups for a particular kind of avc message, ordered by
+ * descending count.  Groups with equal counts are ordered by the time
+ * they were first seen.
+ *
+ * @param agg Aggregate to query.
+ * @param avc_type Kind of avc message, either SEAUDIT_AVC_GRANTED or
+ * SEAUDIT_AVC_DENIED.
+ * @param top If non-zero, return at most this many groups.
+ *
+ * @return Vector of seaudit_aggregate_entry_t pointers, or NULL upon
+ * error.  The caller must call apol_vector_destroy() upon the vector
+ * afterwards, but must not free the entries themselves.
+ */
+	extern apol_vector_t *seaudit_aggregate_get_entries(const seaudit_aggregate_t * agg, seaudit_avc_message_type_e avc_type,
+							    size_t top);
+
+/**
+ * Return the number of messages that fell into an aggregate group.
+ *
+ * @param entry Group to query.
+ *
+ * @return Number of messages.
+ */
+	extern size_t seaudit_aggregate_entry_get_count(const seaudit_aggregate_entry_t * entry);
+
+/**
+ * Return the time when an aggregate group was first seen.
+ *
+ * @param entry Group to query.
+ *
+ * @return Earliest time of the group, or NULL if none of its messages
+ * had a time.  Treat the contents of this struct as const.
+ */
+	extern const struct tm *seaudit_aggregate_entry_get_first_seen(const seaudit_aggregate_entry_t * entry);
+
+/**
+ * Return the time when an aggregate group was last seen.
+ *
+ * @param entry Group to query.
+ *
+ * @return Latest time of the group, or NULL if none of its messages
+ * had a time.  Treat the contents of this struct as const.
+ */
+	extern const struct tm *seaudit_aggregate_entry_get_last_seen(const seaudit_aggregate_entry_t * entry);
+
+/**
+ * Return the kind of avc message of an aggregate group.
+ *
+ * @param entry Group to query.
+ *
+ * @return One of SEAUDIT_AVC_DENIED or SEAUDIT_AVC_GRANTED, or
+ * SEAUDIT_AVC_UNKNOWN upon error.
+ */
+	extern seaudit_avc_message_type_e seaudit_aggregate_entry_get_message_type(const seaudit_aggregate_entry_t * entry);
+
+/**
+ * Return the source context of an aggregate group, formatted as
+ * user:role:type with an optional MLS level.
+ *
+ * @param entry Group to query.
+ *
+ * @return Allocated context string, or NULL upon error.  The caller
+ * must free() this string afterwards.
+ */
+	extern char *seaudit_aggregate_entry_get_source_context(const seaudit_aggregate_entry_t * entry);
+
+/**
+ * Return the target context of an aggregate group, formatted as
+ * user:role:type with an optional MLS level.
+ *
+ * @param entry Group to query.
+ *
+ * @return Allocated context string, or NULL upon error.  The caller
+ * must free() this string afterwards.
+ */
+	extern char *seaudit_aggregate_entry_get_target_context(const seaudit_aggregate_entry_t * entry);
+
+/**
+ * Return the source type of an aggregate group.
+ *
+ * @param entry Group to query.
+ *
+ * @return Source type, or NULL if unknown.  Do not free() this string.
+ */
+	extern const char *seaudit_aggregate_entry_get_source_type(const seaudit_aggregate_entry_t * entry);
+
+/**
+ * Return the target type of an aggregate group.
+ *
+ * @param entry Group to query.
+ *
+ * @return Target type, or NULL if unknown.  Do not free() this string.
+ */
+	extern const char *seaudit_aggregate_entry_get_target_type(const seaudit_aggregate_entry_t * entry);
+
+/**
+ * Return the object class of an aggregate group.
+ *
+ * @param entry Group to query.
+ *
+ * @return Object class, or NULL if unknown.  Do not free() this
+ * string.
+ */
+	extern const char *seaudit_aggregate_entry_get_object_class(const seaudit_aggregate_entry_t * entry);
+
+/**
+ * Return the permission of an aggregate group.
+ *
+ * @param entry Group to query.
+ *
+ * @return Permission name.  Do not free() this string.
+ */
+	extern const char *seaudit_aggregate_entry_get_perm(const seaudit_aggregate_entry_t * entry);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
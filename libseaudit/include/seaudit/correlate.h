@@ -0,0 +1,165 @@
+/**
+ *  @file
+ *
+ *  Public interface to a seaudit_correlation.  A correlation matches
+ *  the avc messages of a log against the access vector rules of a
+ *  policy, answering for each (source type, target type, object
+ *  class, permission) tuple which rules allow, audit, or dontaudit
+ *  it.  Logs tend to repeat the same few tuples many times, so each
+ *  distinct tuple is resolved against the policy only once and the
+ *  answer is shared by all messages bearing that tuple.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SEAUDIT_CORRELATE_H
+#define SEAUDIT_CORRELATE_H
+
+#ifdef  __cplusplus
+extern "C"
+{
+#endif
+
+#include "log.h"
+#include "message.h"
+
+#include <apol/policy.h>
+#include <apol/vector.h>
+
+	typedef struct seaudit_correlation seaudit_correlation_t;
+
+/** the tuple's type or class does not exist within the policy */
+#define SEAUDIT_CORRELATION_UNKNOWN        0x01
+/** an enabled allow rule grants the permission */
+#define SEAUDIT_CORRELATION_ALLOW          0x02
+/** an allow rule grants the permission, but only within a disabled
+ *  conditional */
+#define SEAUDIT_CORRELATION_COND_DISABLED  0x04
+/** an enabled dontaudit rule applies */
+#define SEAUDIT_CORRELATION_DONTAUDIT      0x08
+/** an enabled auditallow rule applies */
+#define SEAUDIT_CORRELATION_AUDITALLOW     0x10
+
+/**
+ * Create a correlation between a log and a policy.  This indexes the
+ * policy's allow, auditallow, and dontaudit rules.
+ *
+ * @param log Log whose messages will be correlated.  This is also
+ * used for error reporting.
+ * @param policy Policy against which to correlate.
+ *
+ * @return A newly allocated correlation, or NULL upon error.  The
+ * caller must call seaudit_correlation_destroy() afterwards.  Neither
+ * the log nor the policy may be destroyed while the correlation is in
+ * use.
+ */
+	extern seaudit_correlation_t *seaudit_correlation_create(const seaudit_log_t * log, const apol_policy_t * policy);
+
+/**
+ * Destroy the referenced correlation.
+ *
+ * @param c Correlation to destroy.  The pointer will be set to NULL
+ * afterwards.  (If pointer is already NULL then do nothing.)
+ */
+	extern void seaudit_correlation_destroy(seaudit_correlation_t ** c);
+
+/**
+ * Correlate a batch of messages.  The distinct tuples among all avc
+ * messages are collected first and then resolved in sorted order, so
+ * that consecutive lookups of the same source type share their
+ * policy queries.  Messages that are not avc messages are ignored.
+ * Calling this is optional, as the getters below will resolve
+ * unknown tuples on demand; it is simply faster for large logs.
+ *
+ * @param c Correlation to update.
+ * @param messages Vector of seaudit_message_t pointers, such as from
+ * seaudit_model_get_messages().
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int seaudit_correlation_add_messages(seaudit_correlation_t * c, const apol_vector_t * messages);
+
+/**
+ * Return the number of distinct tuples resolved thus far.
+ *
+ * @param c Correlation to query.
+ *
+ * @return Number of tuples.
+ */
+	extern size_t seaudit_correlation_get_num_tuples(const seaudit_correlation_t * c);
+
+/**
+ * Return how the policy treats a single tuple.
+ *
+ * @param c Correlation to query.
+ * @param stype Source type name.
+ * @param ttype Target type name.
+ * @param tclass Object class name.
+ * @param perm Permission name.
+ * @param status Reference to where to write a bit-wise or'ed set of
+ * SEAUDIT_CORRELATION_* flags.  This will be 0 if no rule applies.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int seaudit_correlation_get_status(seaudit_correlation_t * c, const char *stype, const char *ttype,
+						  const char *tclass, const char *perm, unsigned int *status);
+
+/**
+ * Return how the policy treats an avc message.  The result combines
+ * the status of each of the message's permissions:
+ * SEAUDIT_CORRELATION_ALLOW is set only if every permission is
+ * allowed; all other flags are set if they apply to any permission.
+ *
+ * @param c Correlation to query.
+ * @param msg Message to query.
+ * @param status Reference to where to write a bit-wise or'ed set of
+ * SEAUDIT_CORRELATION_* flags.
+ *
+ * @return 0 on success, < 0 on error (including if the message is not
+ * an avc message).
+ */
+	extern int seaudit_correlation_get_message_status(seaudit_correlation_t * c, const seaudit_message_t * msg,
+							  unsigned int *status);
+
+/**
+ * Return the rules that apply to an avc message, for any of its
+ * permissions.
+ *
+ * @param c Correlation to query.
+ * @param msg Message to query.
+ *
+ * @return Vector of qpol_avrule_t pointers, or NULL upon error.  The
+ * caller must call apol_vector_destroy() upon the vector afterwards,
+ * but must not free the rules themselves.
+ */
+	extern apol_vector_t *seaudit_correlation_get_rules(seaudit_correlation_t * c, const seaudit_message_t * msg);
+
+/**
+ * Return a short human-readable description of a status, such as
+ * "allow", "dontaudit", or "no rule".
+ *
+ * @param status Bit-wise or'ed set of SEAUDIT_CORRELATION_* flags.
+ *
+ * @return Description string.  Do not free() this string.
+ */
+	extern const char *seaudit_correlation_status_to_string(unsigned int status);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
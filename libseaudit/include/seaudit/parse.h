@@ -32,8 +32,22 @@ extern "C"
 #endif
 
 #include "log.h"
+#include "message.h"
 #include <stdio.h>
 
+/**
+ * Function invoked by seaudit_log_parse_stream() for each message as
+ * soon as it has been parsed.
+ *
+ * @param arg Arbitrary argument given to seaudit_log_parse_stream().
+ * @param log Log that parsed the message.
+ * @param msg Message that was just parsed.
+ *
+ * @return > 0 if the message should be retained within the log, 0 if
+ * it should be discarded, < 0 on error.
+ */
+	typedef int (*seaudit_message_fn_t) (void *arg, const seaudit_log_t * log, const seaudit_message_t * msg);
+
 /**
  * Parse the file specified by syslog and put all selinux audit
  * messages into the log.  It is assumed that log will be created
@@ -65,6 +79,26 @@ extern "C"
  */
 	extern int seaudit_log_parse_buffer(seaudit_log_t * log, const char *buffer, const size_t bufsize);
 
+/**
+ * Parse the file specified by syslog, handing each selinux audit
+ * message to a callback as soon as it has been parsed.  Only those
+ * messages for which the callback requests retention are kept within
+ * the log; all others are freed immediately.  This allows arbitrarily
+ * large logs to be processed in a single pass with bounded memory.
+ * (Malformed message strings are still kept within the log.)
+ * Afterwards all models watching this log will be notified of the
+ * changes.
+ *
+ * @param log Audit log to which append retained messages.
+ * @param syslog Handler to an opened file containing audit messages.
+ * @param fn Function to invoke for each parsed message.
+ * @param arg Arbitrary argument to pass to fn.
+ *
+ * @return 0 on success, > 0 on warnings, < 0 on error and errno will
+ * be set.
+ */
+	extern int seaudit_log_parse_stream(seaudit_log_t * log, FILE * syslog, seaudit_message_fn_t fn, void *arg);
+
 #ifdef  __cplusplus
 }
 #endif
@@ -37,6 +37,8 @@ extern "C"
 {
 #endif
 
+#include "aggregate.h"
+#include "correlate.h"
 #include "model.h"
 
 	typedef struct seaudit_report seaudit_report_t;
@@ -133,6 +135,41 @@ extern "C"
  */
 	extern int seaudit_report_set_malformed(const seaudit_log_t * log, seaudit_report_t * report, const int do_malformed);
 
+/**
+ * Set the report to take its statistics and its allow and deny
+ * listings from an aggregate rather than from the report's model.
+ * The listings will then show one line per aggregate group instead of
+ * one line per message.  This is intended for use with
+ * seaudit_log_parse_stream(), where the model only holds those
+ * messages that were retained by the stream callback.
+ *
+ * @param log Error handler.
+ * @param report Report whose aggregate to set.
+ * @param agg Aggregate from which to obtain statistics, or NULL to
+ * use the model.  The report does not take ownership of the
+ * aggregate.
+ * @param top If non-zero, then list at most this many groups within
+ * the allow and deny listings.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int seaudit_report_set_aggregate(const seaudit_log_t * log, seaudit_report_t * report, const seaudit_aggregate_t * agg,
+						size_t top);
+
+/**
+ * Annotate the report's allow and deny listings with the policy rules
+ * that apply to each message, as determined by a correlation.
+ *
+ * @param log Error handler.
+ * @param report Report whose correlation to set.
+ * @param corr Correlation against which to match messages, or NULL
+ * to not annotate the listings.  The report does not take ownership
+ * of the correlation.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+	extern int seaudit_report_set_correlation(const seaudit_log_t * log, seaudit_report_t * report, seaudit_correlation_t * corr);
+
 #ifdef  __cplusplus
 }
 #endif
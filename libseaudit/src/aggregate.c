@@ -0,0 +1,472 @@
+/**
+ *  @file
+ *  Implementation of a single-pass message aggregate.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "seaudit_internal.h"
+
+#include <seaudit/aggregate.h>
+
+#include <apol/bst.h>
+#include <apol/util.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct seaudit_aggregate
+{
+	/** BST of seaudit_aggregate_entry_t, keyed by
+	 * aggregate_entry_comp() */
+	apol_bst_t *entries;
+	size_t num_messages, num_allows, num_denies, num_bools, num_loads;
+};
+
+/**
+ * An aggregate group.  All character pointers are into the
+ * originating log's BSTs; the group does not own them.
+ */
+struct seaudit_aggregate_entry
+{
+	seaudit_avc_message_type_e msg;
+	const char *suser, *srole, *stype, *smls_lvl;
+	const char *tuser, *trole, *ttype, *tmls_lvl;
+	const char *tclass;
+	const char *perm;
+	size_t count;
+	/** non-zero if first and last have been set */
+	int has_time;
+	struct tm first, last;
+};
+
+/**
+ * Compare two possibly NULL strings.  Strings from the same log are
+ * interned, so equal pointers are caught before calling strcmp().
+ */
+static int aggregate_str_comp(const char *a, const char *b)
+{
+	if (a == b) {
+		return 0;
+	}
+	if (a == NULL) {
+		return -1;
+	}
+	if (b == NULL) {
+		return 1;
+	}
+	return strcmp(a, b);
+}
+
+static int aggregate_entry_comp(const void *x, const void *y, void *data __attribute__ ((unused)))
+{
+	const seaudit_aggregate_entry_t *a = x;
+	const seaudit_aggregate_entry_t *b = y;
+	int retval;
+	if ((retval = (int)a->msg - (int)b->msg) != 0 ||
+	    (retval = aggregate_str_comp(a->stype, b->stype)) != 0 ||
+	    (retval = aggregate_str_comp(a->ttype, b->ttype)) != 0 ||
+	    (retval = aggregate_str_comp(a->tclass, b->tclass)) != 0 ||
+	    (retval = aggregate_str_comp(a->perm, b->perm)) != 0 ||
+	    (retval = aggregate_str_comp(a->suser, b->suser)) != 0 ||
+	    (retval = aggregate_str_comp(a->srole, b->srole)) != 0 ||
+	    (retval = aggregate_str_comp(a->smls_lvl, b->smls_lvl)) != 0 ||
+	    (retval = aggregate_str_comp(a->tuser, b->tuser)) != 0 ||
+	    (retval = aggregate_str_comp(a->trole, b->trole)) != 0) {
+		return retval;
+	}
+	return aggregate_str_comp(a->tmls_lvl, b->tmls_lvl);
+}
+
+/**
+ * Compare two times, in the same manner as the date sort.
+ */
+static int aggregate_tm_comp(const struct tm *t1, const struct tm *t2)
+{
+	int retval;
+	if (t1->tm_year != 0 && t2->tm_year != 0 && (retval = t1->tm_year - t2->tm_year) != 0) {
+		return retval;
+	}
+	if ((retval = t1->tm_mon - t2->tm_mon) != 0) {
+		return retval;
+	}
+	if ((retval = t1->tm_mday - t2->tm_mday) != 0) {
+		return retval;
+	}
+	if ((retval = t1->tm_hour - t2->tm_hour) != 0) {
+		return retval;
+	}
+	if ((retval = t1->tm_min - t2->tm_min) != 0) {
+		return retval;
+	}
+	return t1->tm_sec - t2->tm_sec;
+}
+
+seaudit_aggregate_t *seaudit_aggregate_create(void)
+{
+	seaudit_aggregate_t *agg = calloc(1, sizeof(*agg));
+	if (agg == NULL) {
+		return NULL;
+	}
+	if ((agg->entries = apol_bst_create(aggregate_entry_comp, free)) == NULL) {
+		int error = errno;
+		free(agg);
+		errno = error;
+		return NULL;
+	}
+	return agg;
+}
+
+void seaudit_aggregate_destroy(seaudit_aggregate_t ** agg)
+{
+	if (agg == NULL || *agg == NULL) {
+		return;
+	}
+	apol_bst_destroy(&(*agg)->entries);
+	free(*agg);
+	*agg = NULL;
+}
+
+/**
+ * Add one permission of an avc message to its group, creating the
+ * group if this is the first time it was seen.
+ */
+static int aggregate_add_avc_perm(seaudit_aggregate_t * agg, const seaudit_message_t * msg, const seaudit_avc_message_t * avc,
+				  const char *perm)
+{
+	seaudit_aggregate_entry_t key, *entry;
+	memset(&key, 0, sizeof(key));
+	key.msg = avc->msg;
+	key.suser = avc->suser;
+	key.srole = avc->srole;
+	key.stype = avc->stype;
+	key.smls_lvl = avc->smls_lvl;
+	key.tuser = avc->tuser;
+	key.trole = avc->trole;
+	key.ttype = avc->ttype;
+	key.tmls_lvl = avc->tmls_lvl;
+	key.tclass = avc->tclass;
+	key.perm = perm;
+	if (apol_bst_get_element(agg->entries, &key, NULL, (void **)&entry) < 0) {
+		if ((entry = malloc(sizeof(*entry))) == NULL) {
+			return -1;
+		}
+		*entry = key;
+		if (apol_bst_insert(agg->entries, entry, NULL) < 0) {
+			int error = errno;
+			free(entry);
+			errno = error;
+			return -1;
+		}
+	}
+	entry->count++;
+	if (msg->date_stamp != NULL) {
+		if (!entry->has_time) {
+			entry->first = *msg->date_stamp;
+			entry->last = *msg->date_stamp;
+			entry->has_time = 1;
+		} else if (aggregate_tm_comp(msg->date_stamp, &entry->first) < 0) {
+			entry->first = *msg->date_stamp;
+		} else if (aggregate_tm_comp(msg->date_stamp, &entry->last) > 0) {
+			entry->last = *msg->date_stamp;
+		}
+	}
+	return 0;
+}
+
+int seaudit_aggregate_add_message(seaudit_aggregate_t * agg, const seaudit_message_t * msg)
+{
+	const seaudit_avc_message_t *avc;
+	size_t i;
+	if (agg == NULL || msg == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	agg->num_messages++;
+	switch (msg->type) {
+	case SEAUDIT_MESSAGE_TYPE_BOOL:
+		agg->num_bools++;
+		return 0;
+	case SEAUDIT_MESSAGE_TYPE_LOAD:
+		agg->num_loads++;
+		return 0;
+	case SEAUDIT_MESSAGE_TYPE_AVC:
+		break;
+	default:
+		return 0;
+	}
+	avc = msg->data.avc;
+	if (avc->msg == SEAUDIT_AVC_GRANTED) {
+		agg->num_allows++;
+	} else if (avc->msg == SEAUDIT_AVC_DENIED) {
+		agg->num_denies++;
+	} else {
+		return 0;
+	}
+	for (i = 0; i < apol_vector_get_size(avc->perms); i++) {
+		if (aggregate_add_avc_perm(agg, msg, avc, apol_vector_get_element(avc->perms, i)) < 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int seaudit_aggregate_stream_fn(void *arg, const seaudit_log_t * log, const seaudit_message_t * msg)
+{
+	seaudit_aggregate_t *agg = arg;
+	const seaudit_avc_message_t *avc;
+	size_t i;
+	if (seaudit_aggregate_add_message(agg, msg) < 0) {
+		int error = errno;
+		ERR(log, "%s", strerror(error));
+		errno = error;
+		return -1;
+	}
+	if (msg->type != SEAUDIT_MESSAGE_TYPE_AVC) {
+		return 1;
+	}
+	avc = msg->data.avc;
+	if (avc->msg == SEAUDIT_AVC_GRANTED && avc->tclass != NULL && strcmp(avc->tclass, "security") == 0 &&
+	    apol_vector_get_index(avc->perms, "setenforce", apol_str_strcmp, NULL, &i) == 0) {
+		return 1;
+	}
+	return 0;
+}
+
+size_t seaudit_aggregate_get_num_messages(const seaudit_aggregate_t * agg)
+{
+	if (agg == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return agg->num_messages;
+}
+
+size_t seaudit_aggregate_get_num_allows(const seaudit_aggregate_t * agg)
+{
+	if (agg == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return agg->num_allows;
+}
+
+size_t seaudit_aggregate_get_num_denies(const seaudit_aggregate_t * agg)
+{
+	if (agg == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return agg->num_denies;
+}
+
+size_t seaudit_aggregate_get_num_bools(const seaudit_aggregate_t * agg)
+{
+	if (agg == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return agg->num_bools;
+}
+
+size_t seaudit_aggregate_get_num_loads(const seaudit_aggregate_t * agg)
+{
+	if (agg == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return agg->num_loads;
+}
+
+size_t seaudit_aggregate_get_num_entries(const seaudit_aggregate_t * agg)
+{
+	if (agg == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return apol_bst_get_size(agg->entries);
+}
+
+/**
+ * Sort groups by descending count, then by ascending first seen
+ * time.
+ */
+static int aggregate_entry_count_comp(const void *x, const void *y, void *data __attribute__ ((unused)))
+{
+	const seaudit_aggregate_entry_t *a = x;
+	const seaudit_aggregate_entry_t *b = y;
+	if (a->count != b->count) {
+		return (a->count > b->count ? -1 : 1);
+	}
+	if (a->has_time && b->has_time) {
+		return aggregate_tm_comp(&a->first, &b->first);
+	}
+	return b->has_time - a->has_time;
+}
+
+struct aggregate_filter_arg
+{
+	apol_vector_t *v;
+	seaudit_avc_message_type_e msg;
+};
+
+static int aggregate_filter_entry(void *elem, void *data)
+{
+	seaudit_aggregate_entry_t *entry = elem;
+	struct aggregate_filter_arg *arg = data;
+	if (entry->msg != arg->msg) {
+		return 0;
+	}
+	return apol_vector_append(arg->v, entry);
+}
+
+apol_vector_t *seaudit_aggregate_get_entries(const seaudit_aggregate_t * agg, seaudit_avc_message_type_e avc_type, size_t top)
+{
+	struct aggregate_filter_arg arg;
+	if (agg == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((arg.v = apol_vector_create(NULL)) == NULL) {
+		return NULL;
+	}
+	arg.msg = avc_type;
+	if (apol_bst_inorder_map(agg->entries, aggregate_filter_entry, &arg) < 0) {
+		int error = errno;
+		apol_vector_destroy(&arg.v);
+		errno = error;
+		return NULL;
+	}
+	apol_vector_sort(arg.v, aggregate_entry_count_comp, NULL);
+	if (top > 0) {
+		while (apol_vector_get_size(arg.v) > top) {
+			apol_vector_remove(arg.v, apol_vector_get_size(arg.v) - 1);
+		}
+	}
+	return arg.v;
+}
+
+size_t seaudit_aggregate_entry_get_count(const seaudit_aggregate_entry_t * entry)
+{
+	if (entry == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return entry->count;
+}
+
+const struct tm *seaudit_aggregate_entry_get_first_seen(const seaudit_aggregate_entry_t * entry)
+{
+	if (entry == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return (entry->has_time ? &entry->first : NULL);
+}
+
+const struct tm *seaudit_aggregate_entry_get_last_seen(const seaudit_aggregate_entry_t * entry)
+{
+	if (entry == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return (entry->has_time ? &entry->last : NULL);
+}
+
+seaudit_avc_message_type_e seaudit_aggregate_entry_get_message_type(const seaudit_aggregate_entry_t * entry)
+{
+	if (entry == NULL) {
+		errno = EINVAL;
+		return SEAUDIT_AVC_UNKNOWN;
+	}
+	return entry->msg;
+}
+
+/**
+ * Build a context string from its components, substituting "?" for
+ * unknown components.
+ */
+static char *aggregate_context_to_string(const char *user, const char *role, const char *type, const char *mls_lvl)
+{
+	char *s = NULL;
+	int retval;
+	if (mls_lvl != NULL) {
+		retval = asprintf(&s, "%s:%s:%s:%s", (user ? user : "?"), (role ? role : "?"), (type ? type : "?"), mls_lvl);
+	} else {
+		retval = asprintf(&s, "%s:%s:%s", (user ? user : "?"), (role ? role : "?"), (type ? type : "?"));
+	}
+	if (retval < 0) {
+		return NULL;
+	}
+	return s;
+}
+
+char *seaudit_aggregate_entry_get_source_context(const seaudit_aggregate_entry_t * entry)
+{
+	if (entry == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return aggregate_context_to_string(entry->suser, entry->srole, entry->stype, entry->smls_lvl);
+}
+
+char *seaudit_aggregate_entry_get_target_context(const seaudit_aggregate_entry_t * entry)
+{
+	if (entry == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return aggregate_context_to_string(entry->tuser, entry->trole, entry->ttype, entry->tmls_lvl);
+}
+
+const char *seaudit_aggregate_entry_get_source_type(const seaudit_aggregate_entry_t * entry)
+{
+	if (entry == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return entry->stype;
+}
+
+const char *seaudit_aggregate_entry_get_target_type(const seaudit_aggregate_entry_t * entry)
+{
+	if (entry == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return entry->ttype;
+}
+
+const char *seaudit_aggregate_entry_get_object_class(const seaudit_aggregate_entry_t * entry)
+{
+	if (entry == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return entry->tclass;
+}
+
+const char *seaudit_aggregate_entry_get_perm(const seaudit_aggregate_entry_t * entry)
+{
+	if (entry == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return entry->perm;
+}
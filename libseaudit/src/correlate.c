@@ -0,0 +1,475 @@
+/**
+ *  @file
+ *  Implementation of a correlation between a log and a policy.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "seaudit_internal.h"
+
+#include <seaudit/correlate.h>
+
+#include <apol/avrule-index.h>
+#include <apol/bst.h>
+#include <qpol/policy.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct seaudit_correlation
+{
+	const seaudit_log_t *log;
+	const apol_policy_t *policy;
+	apol_avrule_index_t *index;
+	/** BST of correlate_tuple_t, keyed by correlate_tuple_comp() */
+	apol_bst_t *tuples;
+};
+
+/**
+ * A resolved tuple.  Unless the tuple was looked up by a caller
+ * directly, its strings are pointers into the log's BSTs.  Otherwise
+ * the strings are owned by the tuple.
+ */
+typedef struct correlate_tuple
+{
+	const char *stype, *ttype, *tclass, *perm;
+	unsigned int status;
+	/** vector of qpol_avrule_t pointers that apply to this tuple */
+	apol_vector_t *rules;
+	/** non-zero if this tuple owns its strings */
+	int owns_strings;
+} correlate_tuple_t;
+
+/**
+ * Compare two strings.  Strings from the same log are interned, so
+ * equal pointers are caught before calling strcmp().
+ */
+static int correlate_str_comp(const char *a, const char *b)
+{
+	if (a == b) {
+		return 0;
+	}
+	return strcmp(a, b);
+}
+
+static int correlate_tuple_comp(const void *x, const void *y, void *data __attribute__ ((unused)))
+{
+	const correlate_tuple_t *a = x;
+	const correlate_tuple_t *b = y;
+	int retval;
+	if ((retval = correlate_str_comp(a->stype, b->stype)) != 0 ||
+	    (retval = correlate_str_comp(a->ttype, b->ttype)) != 0 ||
+	    (retval = correlate_str_comp(a->tclass, b->tclass)) != 0) {
+		return retval;
+	}
+	return correlate_str_comp(a->perm, b->perm);
+}
+
+static void correlate_tuple_free(void *elem)
+{
+	correlate_tuple_t *t = elem;
+	if (t != NULL) {
+		apol_vector_destroy(&t->rules);
+		if (t->owns_strings) {
+			free((char *)t->stype);
+			free((char *)t->ttype);
+			free((char *)t->tclass);
+			free((char *)t->perm);
+		}
+		free(t);
+	}
+}
+
+seaudit_correlation_t *seaudit_correlation_create(const seaudit_log_t * log, const apol_policy_t * policy)
+{
+	seaudit_correlation_t *c = NULL;
+	int error;
+	if (policy == NULL) {
+		ERR(log, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((c = calloc(1, sizeof(*c))) == NULL) {
+		error = errno;
+		ERR(log, "%s", strerror(error));
+		goto err;
+	}
+	c->log = log;
+	c->policy = policy;
+	if ((c->tuples = apol_bst_create(correlate_tuple_comp, correlate_tuple_free)) == NULL) {
+		error = errno;
+		ERR(log, "%s", strerror(error));
+		goto err;
+	}
+	if ((c->index = apol_avrule_index_create(policy, QPOL_RULE_ALLOW | QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT)) == NULL) {
+		error = errno;
+		ERR(log, "%s", "Could not index policy rules.");
+		goto err;
+	}
+	return c;
+      err:
+	seaudit_correlation_destroy(&c);
+	errno = error;
+	return NULL;
+}
+
+void seaudit_correlation_destroy(seaudit_correlation_t ** c)
+{
+	if (c == NULL || *c == NULL) {
+		return;
+	}
+	apol_bst_destroy(&(*c)->tuples);
+	apol_avrule_index_destroy(&(*c)->index);
+	free(*c);
+	*c = NULL;
+}
+
+/**
+ * Cache of policy symbols from the previously resolved tuple.  Tuples
+ * are resolved in sorted order, so consecutive tuples usually share
+ * their source type and often their target type and class.
+ */
+typedef struct correlate_lookup
+{
+	const char *stype, *ttype, *tclass;
+	const qpol_type_t *source, *target;
+	const qpol_class_t *obj_class;
+} correlate_lookup_t;
+
+/**
+ * Look up a tuple's rules within the policy, and set its status
+ * accordingly.
+ */
+static int correlate_resolve(seaudit_correlation_t * c, correlate_tuple_t * t, correlate_lookup_t * l)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(c->policy);
+	const qpol_avrule_t *rule;
+	uint32_t rule_type, is_enabled;
+	size_t i;
+
+	if ((t->rules = apol_vector_create(NULL)) == NULL) {
+		return -1;
+	}
+	if (l->stype == NULL || strcmp(l->stype, t->stype) != 0) {
+		l->stype = t->stype;
+		if (qpol_policy_get_type_by_name(q, t->stype, &l->source) < 0) {
+			l->source = NULL;
+		}
+	}
+	if (l->ttype == NULL || strcmp(l->ttype, t->ttype) != 0) {
+		l->ttype = t->ttype;
+		if (qpol_policy_get_type_by_name(q, t->ttype, &l->target) < 0) {
+			l->target = NULL;
+		}
+	}
+	if (l->tclass == NULL || strcmp(l->tclass, t->tclass) != 0) {
+		l->tclass = t->tclass;
+		if (qpol_policy_get_class_by_name(q, t->tclass, &l->obj_class) < 0) {
+			l->obj_class = NULL;
+		}
+	}
+	if (l->source == NULL || l->target == NULL || l->obj_class == NULL) {
+		t->status = SEAUDIT_CORRELATION_UNKNOWN;
+		return 0;
+	}
+	if (apol_avrule_index_get_rules(c->index, l->source, l->target, l->obj_class, t->perm, t->rules) < 0) {
+		return -1;
+	}
+	t->status = 0;
+	for (i = 0; i < apol_vector_get_size(t->rules); i++) {
+		rule = apol_vector_get_element(t->rules, i);
+		if (qpol_avrule_get_rule_type(q, rule, &rule_type) < 0 || qpol_avrule_get_is_enabled(q, rule, &is_enabled) < 0) {
+			return -1;
+		}
+		switch (rule_type) {
+		case QPOL_RULE_ALLOW:
+			t->status |= (is_enabled ? SEAUDIT_CORRELATION_ALLOW : SEAUDIT_CORRELATION_COND_DISABLED);
+			break;
+		case QPOL_RULE_AUDITALLOW:
+			if (is_enabled) {
+				t->status |= SEAUDIT_CORRELATION_AUDITALLOW;
+			}
+			break;
+		case QPOL_RULE_DONTAUDIT:
+			if (is_enabled) {
+				t->status |= SEAUDIT_CORRELATION_DONTAUDIT;
+			}
+			break;
+		}
+	}
+	if (t->status & SEAUDIT_CORRELATION_ALLOW) {
+		t->status &= ~SEAUDIT_CORRELATION_COND_DISABLED;
+	}
+	return 0;
+}
+
+/**
+ * Callback for apol_bst_inorder_map() that resolves each tuple not yet
+ * resolved.
+ */
+typedef struct correlate_resolve_arg
+{
+	seaudit_correlation_t *c;
+	correlate_lookup_t lookup;
+} correlate_resolve_arg_t;
+
+static int correlate_resolve_map(void *elem, void *data)
+{
+	correlate_tuple_t *t = elem;
+	correlate_resolve_arg_t *arg = data;
+	if (t->rules != NULL) {
+		return 0;
+	}
+	return correlate_resolve(arg->c, t, &arg->lookup);
+}
+
+int seaudit_correlation_add_messages(seaudit_correlation_t * c, const apol_vector_t * messages)
+{
+	const seaudit_message_t *msg;
+	const seaudit_avc_message_t *avc;
+	correlate_tuple_t key, *t;
+	correlate_resolve_arg_t arg;
+	size_t i, j;
+	int error;
+
+	if (c == NULL || messages == NULL) {
+		ERR((c ? c->log : NULL), "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	memset(&key, 0, sizeof(key));
+	for (i = 0; i < apol_vector_get_size(messages); i++) {
+		msg = apol_vector_get_element(messages, i);
+		if (msg->type != SEAUDIT_MESSAGE_TYPE_AVC) {
+			continue;
+		}
+		avc = msg->data.avc;
+		if (avc->stype == NULL || avc->ttype == NULL || avc->tclass == NULL) {
+			continue;
+		}
+		key.stype = avc->stype;
+		key.ttype = avc->ttype;
+		key.tclass = avc->tclass;
+		for (j = 0; j < apol_vector_get_size(avc->perms); j++) {
+			key.perm = apol_vector_get_element(avc->perms, j);
+			if (apol_bst_get_element(c->tuples, &key, NULL, NULL) == 0) {
+				continue;
+			}
+			if ((t = calloc(1, sizeof(*t))) == NULL) {
+				error = errno;
+				goto err;
+			}
+			*t = key;
+			if (apol_bst_insert(c->tuples, t, NULL) < 0) {
+				error = errno;
+				free(t);
+				goto err;
+			}
+		}
+	}
+	memset(&arg, 0, sizeof(arg));
+	arg.c = c;
+	if (apol_bst_inorder_map(c->tuples, correlate_resolve_map, &arg) < 0) {
+		error = errno;
+		goto err;
+	}
+	return 0;
+      err:
+	ERR(c->log, "%s", strerror(error));
+	errno = error;
+	return -1;
+}
+
+size_t seaudit_correlation_get_num_tuples(const seaudit_correlation_t * c)
+{
+	if (c == NULL) {
+		errno = EINVAL;
+		return 0;
+	}
+	return apol_bst_get_size(c->tuples);
+}
+
+/**
+ * Return the resolved tuple for the given names, resolving and
+ * inserting it if it has not been seen before.
+ */
+static correlate_tuple_t *correlate_get_tuple(seaudit_correlation_t * c, const char *stype, const char *ttype, const char *tclass,
+					      const char *perm)
+{
+	correlate_tuple_t key, *t = NULL;
+	correlate_lookup_t lookup;
+	int error;
+
+	memset(&key, 0, sizeof(key));
+	key.stype = stype;
+	key.ttype = ttype;
+	key.tclass = tclass;
+	key.perm = perm;
+	if (apol_bst_get_element(c->tuples, &key, NULL, (void **)&t) == 0) {
+		return t;
+	}
+	if ((t = calloc(1, sizeof(*t))) == NULL ||
+	    (t->stype = strdup(stype)) == NULL ||
+	    (t->ttype = strdup(ttype)) == NULL || (t->tclass = strdup(tclass)) == NULL || (t->perm = strdup(perm)) == NULL) {
+		error = errno;
+		if (t != NULL) {
+			t->owns_strings = 1;
+		}
+		goto err;
+	}
+	t->owns_strings = 1;
+	memset(&lookup, 0, sizeof(lookup));
+	if (correlate_resolve(c, t, &lookup) < 0) {
+		error = errno;
+		goto err;
+	}
+	if (apol_bst_insert(c->tuples, t, NULL) < 0) {
+		error = errno;
+		goto err;
+	}
+	return t;
+      err:
+	correlate_tuple_free(t);
+	ERR(c->log, "%s", strerror(error));
+	errno = error;
+	return NULL;
+}
+
+int seaudit_correlation_get_status(seaudit_correlation_t * c, const char *stype, const char *ttype, const char *tclass,
+				   const char *perm, unsigned int *status)
+{
+	correlate_tuple_t *t;
+	if (status != NULL) {
+		*status = 0;
+	}
+	if (c == NULL || stype == NULL || ttype == NULL || tclass == NULL || perm == NULL || status == NULL) {
+		ERR((c ? c->log : NULL), "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	if ((t = correlate_get_tuple(c, stype, ttype, tclass, perm)) == NULL) {
+		return -1;
+	}
+	*status = t->status;
+	return 0;
+}
+
+/**
+ * Return the avc portion of a message, or NULL if the message is not
+ * an avc message or lacks the fields needed for correlation.
+ */
+static const seaudit_avc_message_t *correlate_get_avc(const seaudit_correlation_t * c, const seaudit_message_t * msg)
+{
+	const seaudit_avc_message_t *avc;
+	if (c == NULL || msg == NULL || msg->type != SEAUDIT_MESSAGE_TYPE_AVC) {
+		ERR((c ? c->log : NULL), "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return NULL;
+	}
+	avc = msg->data.avc;
+	if (avc->stype == NULL || avc->ttype == NULL || avc->tclass == NULL) {
+		ERR(c->log, "%s", "Message does not have a source type, target type, and object class.");
+		errno = EINVAL;
+		return NULL;
+	}
+	return avc;
+}
+
+int seaudit_correlation_get_message_status(seaudit_correlation_t * c, const seaudit_message_t * msg, unsigned int *status)
+{
+	const seaudit_avc_message_t *avc;
+	correlate_tuple_t *t;
+	unsigned int allowed = SEAUDIT_CORRELATION_ALLOW;
+	size_t i;
+	if (status != NULL) {
+		*status = 0;
+	}
+	if (status == NULL || (avc = correlate_get_avc(c, msg)) == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (i = 0; i < apol_vector_get_size(avc->perms); i++) {
+		if ((t = correlate_get_tuple(c, avc->stype, avc->ttype, avc->tclass, apol_vector_get_element(avc->perms, i))) == NULL) {
+			return -1;
+		}
+		*status |= t->status;
+		allowed &= t->status;
+	}
+	if (apol_vector_get_size(avc->perms) > 0) {
+		*status = (*status & ~SEAUDIT_CORRELATION_ALLOW) | allowed;
+	}
+	return 0;
+}
+
+apol_vector_t *seaudit_correlation_get_rules(seaudit_correlation_t * c, const seaudit_message_t * msg)
+{
+	const seaudit_avc_message_t *avc;
+	correlate_tuple_t *t;
+	apol_vector_t *v = NULL;
+	size_t i;
+	int error;
+	if ((avc = correlate_get_avc(c, msg)) == NULL) {
+		return NULL;
+	}
+	if ((v = apol_vector_create(NULL)) == NULL) {
+		error = errno;
+		goto err;
+	}
+	for (i = 0; i < apol_vector_get_size(avc->perms); i++) {
+		if ((t = correlate_get_tuple(c, avc->stype, avc->ttype, avc->tclass, apol_vector_get_element(avc->perms, i))) == NULL) {
+			error = errno;
+			apol_vector_destroy(&v);
+			errno = error;
+			return NULL;
+		}
+		if (apol_vector_cat(v, t->rules) < 0) {
+			error = errno;
+			goto err;
+		}
+	}
+	apol_vector_sort_uniquify(v, NULL, NULL);
+	return v;
+      err:
+	apol_vector_destroy(&v);
+	ERR(c->log, "%s", strerror(error));
+	errno = error;
+	return NULL;
+}
+
+const char *seaudit_correlation_status_to_string(unsigned int status)
+{
+	if (status & SEAUDIT_CORRELATION_UNKNOWN) {
+		return "not in policy";
+	}
+	if (status & SEAUDIT_CORRELATION_ALLOW) {
+		if (status & SEAUDIT_CORRELATION_AUDITALLOW) {
+			return "allow, auditallow";
+		}
+		return "allow";
+	}
+	if (status & SEAUDIT_CORRELATION_COND_DISABLED) {
+		if (status & SEAUDIT_CORRELATION_DONTAUDIT) {
+			return "disabled conditional allow, dontaudit";
+		}
+		return "disabled conditional allow";
+	}
+	if (status & SEAUDIT_CORRELATION_DONTAUDIT) {
+		return "dontaudit";
+	}
+	return "no rule";
+}
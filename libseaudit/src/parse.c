@@ -1389,14 +1389,47 @@ static int seaudit_log_parse_line(seaudit_log_t * log, char *line)
 	return has_warnings;
 }
 
-/******************** public functions below ********************/
+/**
+ * Hand every message after the first mark messages within the log to
+ * a stream callback, freeing those that the callback does not wish
+ * to retain.
+ *
+ * @param log Log containing messages.
+ * @param mark Reference to the number of messages already retained.
+ * This will be updated to include newly retained messages.
+ * @param fn Callback to invoke.
+ * @param arg Argument to pass to the callback.
+ *
+ * @return 0 on success, < 0 on error.
+ */
+static int seaudit_log_flush_stream(seaudit_log_t * log, size_t * mark, seaudit_message_fn_t fn, void *arg)
+{
+	seaudit_message_t *msg;
+	int retval;
+	while (*mark < apol_vector_get_size(log->messages)) {
+		msg = apol_vector_get_element(log->messages, *mark);
+		if ((retval = fn(arg, log, msg)) < 0) {
+			return retval;
+		} else if (retval > 0) {
+			(*mark)++;
+		} else {
+			apol_vector_remove(log->messages, *mark);
+			message_free(msg);
+		}
+	}
+	return 0;
+}
 
-int seaudit_log_parse(seaudit_log_t * log, FILE * syslog)
+/**
+ * Parse a file line by line.  If fn is not NULL then messages are
+ * handed to fn as they are parsed, as per seaudit_log_parse_stream().
+ */
+static int seaudit_log_parse_file(seaudit_log_t * log, FILE * syslog, seaudit_message_fn_t fn, void *arg)
 {
 	FILE *audit_file = syslog;
 	char *line = NULL;
 	int retval = -1, retval2, has_warnings = 0, error = 0;
-	size_t line_size = 0, i;
+	size_t line_size = 0, i, mark = 0;
 
 	if (log == NULL || syslog == NULL) {
 		ERR(log, "%s", strerror(EINVAL));
@@ -1410,6 +1443,7 @@ int seaudit_log_parse(seaudit_log_t * log, FILE * syslog)
 	}
 
 	clearerr(audit_file);
+	mark = apol_vector_get_size(log->messages);
 
 	while (1) {
 		if (getline(&line, &line_size, audit_file) < 0) {
@@ -1428,6 +1462,19 @@ int seaudit_log_parse(seaudit_log_t * log, FILE * syslog)
 		} else if (retval2 > 0) {
 			has_warnings = 1;
 		}
+		/* multi-line messages are only complete once the
+		 * parser is no longer in the middle of one */
+		if (fn != NULL && !log->next_line && seaudit_log_flush_stream(log, &mark, fn, arg) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+	}
+	if (fn != NULL) {
+		log->next_line = 0;
+		if (seaudit_log_flush_stream(log, &mark, fn, arg) < 0) {
+			error = errno;
+			goto cleanup;
+		}
 	}
 
 	retval = 0;
@@ -1447,6 +1494,23 @@ int seaudit_log_parse(seaudit_log_t * log, FILE * syslog)
 	return has_warnings;
 }
 
+/******************** public functions below ********************/
+
+int seaudit_log_parse(seaudit_log_t * log, FILE * syslog)
+{
+	return seaudit_log_parse_file(log, syslog, NULL, NULL);
+}
+
+int seaudit_log_parse_stream(seaudit_log_t * log, FILE * syslog, seaudit_message_fn_t fn, void *arg)
+{
+	if (fn == NULL) {
+		ERR(log, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	return seaudit_log_parse_file(log, syslog, fn, arg);
+}
+
 int seaudit_log_parse_buffer(seaudit_log_t * log, const char *buffer, const size_t bufsize)
 {
 	const char *s;
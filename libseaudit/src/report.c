@@ -54,6 +54,14 @@ struct seaudit_report
 	int malformed;
 	/** model from which messages will be obtained */
 	seaudit_model_t *model;
+	/** if not NULL, aggregate from which statistics and avc
+	 * listings will be obtained */
+	const seaudit_aggregate_t *agg;
+	/** maximum number of aggregate groups to list, or 0 for all */
+	size_t top;
+	/** if not NULL, correlation with which to annotate avc
+	 * listings */
+	seaudit_correlation_t *corr;
 };
 
 static const char *seaudit_report_node_names[] = {
@@ -224,6 +232,29 @@ int seaudit_report_set_malformed(const seaudit_log_t * log, seaudit_report_t * r
 	return 0;
 }
 
+int seaudit_report_set_aggregate(const seaudit_log_t * log, seaudit_report_t * report, const seaudit_aggregate_t * agg, size_t top)
+{
+	if (report == NULL) {
+		ERR(log, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	report->agg = agg;
+	report->top = top;
+	return 0;
+}
+
+int seaudit_report_set_correlation(const seaudit_log_t * log, seaudit_report_t * report, seaudit_correlation_t * corr)
+{
+	if (report == NULL) {
+		ERR(log, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+	report->corr = corr;
+	return 0;
+}
+
 /**
  * Insert the contents of the stylesheet into the output file.  If it
  * is not readable then generate a warning.  This is not an error
@@ -617,15 +648,156 @@ static int report_print_policy_loads(const seaudit_log_t * log, const seaudit_re
 	return 0;
 }
 
+/**
+ * Print one line per aggregate group for a particular kind of avc
+ * message, most frequent groups first.
+ */
+static int report_print_aggregate_listing(const seaudit_log_t * log, const seaudit_report_t * report,
+					  seaudit_avc_message_type_e avc_type, FILE * outfile)
+{
+	size_t i, num, num_entries;
+	apol_vector_t *v = NULL;
+	seaudit_aggregate_entry_t *entry;
+	const struct tm *first, *last;
+	char *scon = NULL, *tcon = NULL, first_str[256], last_str[256];
+	const char *policy_str;
+	int retval = -1, error = 0;
+
+	if (avc_type == SEAUDIT_AVC_GRANTED) {
+		num = seaudit_aggregate_get_num_allows(report->agg);
+	} else {
+		num = seaudit_aggregate_get_num_denies(report->agg);
+	}
+	if ((v = seaudit_aggregate_get_entries(report->agg, avc_type, report->top)) == NULL) {
+		error = errno;
+		ERR(log, "%s", strerror(error));
+		goto cleanup;
+	}
+	num_entries = apol_vector_get_size(v);
+	if (report->format == SEAUDIT_REPORT_FORMAT_HTML) {
+		fprintf(outfile,
+			"<font class=\"message_count_label\">Number of messages:</font> <b class=\"message_count\">%zd</b><br>\n",
+			num);
+		fprintf(outfile,
+			"<font class=\"message_count_label\">Number of groups listed:</font> <b class=\"message_count\">%zd</b><br>\n<br>\n",
+			num_entries);
+		fprintf(outfile, "<table>\n<tr><th>Count</th><th>First seen</th><th>Last seen</th>"
+			"<th>Source context</th><th>Target context</th><th>Class</th><th>Permission</th>%s</tr>\n",
+			(report->corr != NULL ? "<th>Policy</th>" : ""));
+	} else {
+		fprintf(outfile, "Number of messages: %zd\n", num);
+		fprintf(outfile, "Number of groups listed: %zd\n\n", num_entries);
+	}
+
+	for (i = 0; i < num_entries; i++) {
+		entry = apol_vector_get_element(v, i);
+		first = seaudit_aggregate_entry_get_first_seen(entry);
+		last = seaudit_aggregate_entry_get_last_seen(entry);
+		if (first == NULL || strftime(first_str, sizeof(first_str), "%b %d %H:%M:%S", first) == 0) {
+			strcpy(first_str, "-");
+		}
+		if (last == NULL || strftime(last_str, sizeof(last_str), "%b %d %H:%M:%S", last) == 0) {
+			strcpy(last_str, "-");
+		}
+		if ((scon = seaudit_aggregate_entry_get_source_context(entry)) == NULL ||
+		    (tcon = seaudit_aggregate_entry_get_target_context(entry)) == NULL) {
+			error = errno;
+			ERR(log, "%s", strerror(error));
+			goto cleanup;
+		}
+		policy_str = NULL;
+		if (report->corr != NULL) {
+			unsigned int status;
+			const char *stype = seaudit_aggregate_entry_get_source_type(entry);
+			const char *ttype = seaudit_aggregate_entry_get_target_type(entry);
+			const char *tclass = seaudit_aggregate_entry_get_object_class(entry);
+			if (stype == NULL || ttype == NULL || tclass == NULL) {
+				policy_str = "-";
+			} else if (seaudit_correlation_get_status(report->corr, stype, ttype, tclass,
+								  seaudit_aggregate_entry_get_perm(entry), &status) < 0) {
+				error = errno;
+				goto cleanup;
+			} else {
+				policy_str = seaudit_correlation_status_to_string(status);
+			}
+		}
+		if (report->format == SEAUDIT_REPORT_FORMAT_HTML) {
+			fprintf(outfile,
+				"<tr><td>%zd</td><td>%s</td><td>%s</td><td>%s</td><td>%s</td><td>%s</td><td>%s</td>",
+				seaudit_aggregate_entry_get_count(entry), first_str, last_str, scon, tcon,
+				seaudit_aggregate_entry_get_object_class(entry), seaudit_aggregate_entry_get_perm(entry));
+			if (policy_str != NULL) {
+				fprintf(outfile, "<td>%s</td>", policy_str);
+			}
+			fprintf(outfile, "</tr>\n");
+		} else {
+			fprintf(outfile, "%zd\t%s\t%s\t%s\t%s\t%s\t%s", seaudit_aggregate_entry_get_count(entry), first_str,
+				last_str, scon, tcon, seaudit_aggregate_entry_get_object_class(entry),
+				seaudit_aggregate_entry_get_perm(entry));
+			if (policy_str != NULL) {
+				fprintf(outfile, "\t%s", policy_str);
+			}
+			fputc('\n', outfile);
+		}
+		free(scon);
+		free(tcon);
+		scon = tcon = NULL;
+	}
+	if (report->format == SEAUDIT_REPORT_FORMAT_HTML) {
+		fprintf(outfile, "</table>\n");
+	}
+	retval = 0;
+      cleanup:
+	free(scon);
+	free(tcon);
+	apol_vector_destroy(&v);
+	if (retval < 0) {
+		errno = error;
+	}
+	return retval;
+}
+
+/**
+ * Append to a message's listing the kinds of policy rules that apply
+ * to it.  Messages lacking a complete context are left unannotated.
+ */
+static int report_print_correlation(const seaudit_report_t * report, const seaudit_message_t * msg, FILE * outfile)
+{
+	const seaudit_avc_message_t *avc = msg->data.avc;
+	unsigned int status;
+	if (avc->stype == NULL || avc->ttype == NULL || avc->tclass == NULL) {
+		return 0;
+	}
+	if (seaudit_correlation_get_message_status(report->corr, msg, &status) < 0) {
+		return -1;
+	}
+	if (report->format == SEAUDIT_REPORT_FORMAT_HTML) {
+		fprintf(outfile, "<font class=\"policy\">policy: %s</font><br>", seaudit_correlation_status_to_string(status));
+	} else {
+		fprintf(outfile, " policy: %s", seaudit_correlation_status_to_string(status));
+	}
+	return 0;
+}
+
 static int report_print_avc_listing(const seaudit_log_t * log, const seaudit_report_t * report, seaudit_avc_message_type_e avc_type,
 				    FILE * outfile)
 {
 	size_t i, num;
-	apol_vector_t *v = seaudit_model_get_messages(log, report->model);
+	apol_vector_t *v;
 	seaudit_message_t *m;
 	seaudit_avc_message_t *avc;
 	seaudit_message_type_e type;
 	char *s;
+	if (report->agg != NULL) {
+		return report_print_aggregate_listing(log, report, avc_type, outfile);
+	}
+	v = seaudit_model_get_messages(log, report->model);
+	if (report->corr != NULL && seaudit_correlation_add_messages(report->corr, v) < 0) {
+		int error = errno;
+		apol_vector_destroy(&v);
+		errno = error;
+		return -1;
+	}
 	if (avc_type == SEAUDIT_AVC_GRANTED) {
 		num = seaudit_model_get_num_allows(log, report->model);
 	} else {
@@ -655,8 +827,14 @@ static int report_print_avc_listing(const seaudit_log_t * log, const seaudit_rep
 				return -1;
 			}
 			fputs(s, outfile);
-			fputc('\n', outfile);
 			free(s);
+			if (report->corr != NULL && report_print_correlation(report, m, outfile) < 0) {
+				int error = errno;
+				apol_vector_destroy(&v);
+				errno = error;
+				return -1;
+			}
+			fputc('\n', outfile);
 		}
 	}
 	apol_vector_destroy(&v);
@@ -665,31 +843,52 @@ static int report_print_avc_listing(const seaudit_log_t * log, const seaudit_rep
 
 static int report_print_stats(const seaudit_log_t * log, const seaudit_report_t * report, FILE * outfile)
 {
-	apol_vector_t *v = seaudit_model_get_messages(log, report->model);
-	size_t num_messages = apol_vector_get_size(v);
-	apol_vector_destroy(&v);
+	size_t num_messages, num_loads, num_bools, num_allows, num_denies;
+	if (report->agg != NULL) {
+		num_messages = seaudit_aggregate_get_num_messages(report->agg);
+		num_loads = seaudit_aggregate_get_num_loads(report->agg);
+		num_bools = seaudit_aggregate_get_num_bools(report->agg);
+		num_allows = seaudit_aggregate_get_num_allows(report->agg);
+		num_denies = seaudit_aggregate_get_num_denies(report->agg);
+	} else {
+		apol_vector_t *v = seaudit_model_get_messages(log, report->model);
+		num_messages = apol_vector_get_size(v);
+		apol_vector_destroy(&v);
+		num_loads = seaudit_model_get_num_loads(log, report->model);
+		num_bools = seaudit_model_get_num_bools(log, report->model);
+		num_allows = seaudit_model_get_num_allows(log, report->model);
+		num_denies = seaudit_model_get_num_denies(log, report->model);
+	}
 	if (report->format == SEAUDIT_REPORT_FORMAT_HTML) {
 		fprintf(outfile,
 			"<font class=\"stats_label\">Number of total messages:</font> <b class=\"stats_count\">%zd</b><br>\n",
 			num_messages);
 		fprintf(outfile,
 			"<font class=\"stats_label\">Number of policy load messages:</font> <b class=\"stats_count\">%zd</b><br>\n",
-			seaudit_model_get_num_loads(log, report->model));
+			num_loads);
 		fprintf(outfile,
 			"<font class=\"stats_label\">Number of policy boolean messages:</font> <b class=\"stats_count\">%zd</b><br>\n",
-			seaudit_model_get_num_bools(log, report->model));
+			num_bools);
 		fprintf(outfile,
 			"<font class=\"stats_label\">Number of allow messages:</font> <b class=\"stats_count\">%zd</b><br>\n",
-			seaudit_model_get_num_allows(log, report->model));
+			num_allows);
 		fprintf(outfile,
 			"<font class=\"stats_label\">Number of denied messages:</font> <b class=\"stats_count\">%zd</b><br>\n",
-			seaudit_model_get_num_denies(log, report->model));
+			num_denies);
+		if (report->agg != NULL) {
+			fprintf(outfile,
+				"<font class=\"stats_label\">Number of distinct avc groups:</font> <b class=\"stats_count\">%zd</b><br>\n",
+				seaudit_aggregate_get_num_entries(report->agg));
+		}
 	} else {
 		fprintf(outfile, "Number of total messages: %zd\n", num_messages);
-		fprintf(outfile, "Number of policy load messages: %zd\n", seaudit_model_get_num_loads(log, report->model));
-		fprintf(outfile, "Number of policy boolean messages: %zd\n", seaudit_model_get_num_bools(log, report->model));
-		fprintf(outfile, "Number of allow messages: %zd\n", seaudit_model_get_num_allows(log, report->model));
-		fprintf(outfile, "Number of denied messages: %zd\n", seaudit_model_get_num_denies(log, report->model));
+		fprintf(outfile, "Number of policy load messages: %zd\n", num_loads);
+		fprintf(outfile, "Number of policy boolean messages: %zd\n", num_bools);
+		fprintf(outfile, "Number of allow messages: %zd\n", num_allows);
+		fprintf(outfile, "Number of denied messages: %zd\n", num_denies);
+		if (report->agg != NULL) {
+			fprintf(outfile, "Number of distinct avc groups: %zd\n", seaudit_aggregate_get_num_entries(report->agg));
+		}
 	}
 	return 0;
 }
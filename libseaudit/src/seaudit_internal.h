@@ -38,6 +38,7 @@
 #include <seaudit/sort.h>
 
 #include <apol/bst.h>
+#include <apol/policy.h>
 #include <apol/vector.h>
 
 #include <libxml/uri.h>
@@ -0,0 +1,112 @@
+/**
+ *  @file
+ *
+ *  Test libseaudit's ability to summarize a log in a single pass.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <CUnit/CUnit.h>
+#include <seaudit/aggregate.h>
+#include <seaudit/log.h>
+#include <seaudit/model.h>
+#include <seaudit/parse.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char aggregate_log[] =
+	"Jun 12 10:00:01 host kernel: audit(1181642401.100:10): avc:  denied  { read write } for  pid=1 comm=\"a\" scontext=system_u:system_r:httpd_t:s0 tcontext=system_u:object_r:etc_t:s0 tclass=file\n"
+	"Jun 12 10:00:02 host kernel: audit(1181642402.100:11): avc:  denied  { read } for  pid=1 comm=\"a\" scontext=system_u:system_r:httpd_t:s0 tcontext=system_u:object_r:etc_t:s0 tclass=file\n"
+	"Jun 12 10:00:03 host kernel: audit(1181642403.100:12): avc:  denied  { read } for  pid=1 comm=\"a\" scontext=system_u:system_r:httpd_t:s0 tcontext=system_u:object_r:etc_t:s0 tclass=file\n"
+	"Jun 12 10:00:04 host kernel: audit(1181642404.100:13): avc:  denied  { getattr } for  pid=2 comm=\"b\" scontext=system_u:system_r:sshd_t:s0 tcontext=system_u:object_r:shadow_t:s0 tclass=file\n"
+	"Jun 12 10:00:05 host kernel: audit(1181642405.100:14): avc:  granted  { setenforce } for  pid=3 comm=\"c\" scontext=root:sysadm_r:sysadm_t:s0 tcontext=system_u:object_r:security_t:s0 tclass=security\n";
+
+static void aggregate_stream(void)
+{
+	seaudit_log_t *l = seaudit_log_create(NULL, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(l);
+	seaudit_aggregate_t *agg = seaudit_aggregate_create();
+	CU_ASSERT_PTR_NOT_NULL_FATAL(agg);
+
+	FILE *f = fmemopen((void *)aggregate_log, strlen(aggregate_log), "r");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(f);
+	int retval = seaudit_log_parse_stream(l, f, seaudit_aggregate_stream_fn, agg);
+	CU_ASSERT(retval == 0);
+	fclose(f);
+
+	CU_ASSERT(seaudit_aggregate_get_num_messages(agg) == 5);
+	CU_ASSERT(seaudit_aggregate_get_num_denies(agg) == 4);
+	CU_ASSERT(seaudit_aggregate_get_num_allows(agg) == 1);
+	/* httpd_t read, httpd_t write, sshd_t getattr, sysadm_t setenforce */
+	CU_ASSERT(seaudit_aggregate_get_num_entries(agg) == 4);
+
+	apol_vector_t *v = seaudit_aggregate_get_entries(agg, SEAUDIT_AVC_DENIED, 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+	CU_ASSERT(apol_vector_get_size(v) == 3);
+	seaudit_aggregate_entry_t *entry = apol_vector_get_element(v, 0);
+	CU_ASSERT(seaudit_aggregate_entry_get_count(entry) == 3);
+	CU_ASSERT_STRING_EQUAL(seaudit_aggregate_entry_get_source_type(entry), "httpd_t");
+	CU_ASSERT_STRING_EQUAL(seaudit_aggregate_entry_get_target_type(entry), "etc_t");
+	CU_ASSERT_STRING_EQUAL(seaudit_aggregate_entry_get_object_class(entry), "file");
+	CU_ASSERT_STRING_EQUAL(seaudit_aggregate_entry_get_perm(entry), "read");
+	const struct tm *first = seaudit_aggregate_entry_get_first_seen(entry);
+	const struct tm *last = seaudit_aggregate_entry_get_last_seen(entry);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(first);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(last);
+	CU_ASSERT(first->tm_sec != last->tm_sec);
+	char *con = seaudit_aggregate_entry_get_source_context(entry);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(con);
+	CU_ASSERT_STRING_EQUAL(con, "system_u:system_r:httpd_t:s0");
+	free(con);
+	apol_vector_destroy(&v);
+
+	v = seaudit_aggregate_get_entries(agg, SEAUDIT_AVC_DENIED, 1);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+	CU_ASSERT(apol_vector_get_size(v) == 1);
+	apol_vector_destroy(&v);
+
+	/* only the setenforce message should have been retained */
+	seaudit_model_t *m = seaudit_model_create("aggregate", l);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(m);
+	v = seaudit_model_get_messages(l, m);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(v);
+	CU_ASSERT(apol_vector_get_size(v) == 1);
+	apol_vector_destroy(&v);
+	seaudit_model_destroy(&m);
+
+	seaudit_aggregate_destroy(&agg);
+	seaudit_log_destroy(&l);
+}
+
+CU_TestInfo aggregate_tests[] = {
+	{"stream aggregation", aggregate_stream},
+	CU_TEST_INFO_NULL
+};
+
+int aggregate_init()
+{
+	return 0;
+}
+
+int aggregate_cleanup()
+{
+	return 0;
+}
@@ -28,6 +28,7 @@
 #include <CUnit/CUnit.h>
 #include <CUnit/Basic.h>
 
+#include "aggregate.h"
 #include "filters.h"
 #include "parse_file.h"
 
@@ -42,6 +43,8 @@ int main(void)
 		,
 		{"Filters", filters_init, filters_cleanup, filters_tests}
 		,
+		{"Aggregate", aggregate_init, aggregate_cleanup, aggregate_tests}
+		,
 		CU_SUITE_INFO_NULL
 	};
 
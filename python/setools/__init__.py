@@ -4,6 +4,8 @@
 
 import _sesearch
 import _seinfo
+import copy
+import os
 import types
 
 TYPE = _seinfo.TYPE
@@ -21,7 +23,12 @@ TCONTEXT = 'tcontext'
 PERMS = 'permlist'
 CLASS = 'class'
 
-def sesearch(types, info):
+RULE_ALLOW = _sesearch.RULE_ALLOW
+RULE_AUDITALLOW = _sesearch.RULE_AUDITALLOW
+RULE_NEVERALLOW = _sesearch.RULE_NEVERALLOW
+RULE_DONTAUDIT = _sesearch.RULE_DONTAUDIT
+
+def _search_params(types, info):
     valid_types = [ALLOW, AUDITALLOW, NEVERALLOW, DONTAUDIT]
     for type in types:
         if type not in valid_types:
@@ -32,12 +39,53 @@ def sesearch(types, info):
     if PERMS in info:
         perms = info[PERMS]
         info[PERMS] = ",".join(info[PERMS])
-     
-    
-    dict_list = _sesearch.sesearch(info)
-    if dict_list and len(perms) != 0:
-        dict_list = filter(lambda x: dict_has_perms(x, perms), dict_list)
-    return dict_list
+    return perms
+
+def sesearch(types, info, path=None):
+    key = ("sesearch", tuple(sorted(set(types))), _normalize(info))
+    perms = _search_params(types, info)
+    entry = get_policy_entry(path, NEVERALLOW in types)
+    found, dict_list = entry.results.lookup(key)
+    if not found:
+        dict_list = _sesearch.sesearch(info, entry.policy)
+        if dict_list and len(perms) != 0:
+            dict_list = [d for d in dict_list if dict_has_perms(d, perms)]
+        entry.results.store(key, dict_list)
+    if dict_list is None:
+        return None
+    # copy what a caller could change, so the cached result is not
+    return [dict(d, permlist=list(d[PERMS])) for d in dict_list]
+
+class Policy(_sesearch.Policy):
+    """A policy that is loaded once and may then be searched any number
+    of times.  If no path is given the system's default policy is
+    loaded.  Searches take the same arguments as sesearch(); search()
+    returns AVRule objects, whose fields may be read either as
+    attributes or as keys (rule[SCONTEXT]).
+
+    export() returns the matching rules as columns of packed native
+    uint32 values, suitable for array.array('I', column) or
+    numpy.frombuffer(column, dtype=numpy.uint32).  The 'type' column
+    holds RULE_ALLOW and so on; 'scontext', 'tcontext' and 'class'
+    index 'type_names' and 'class_names'.  The permissions of rule i
+    are permlist[offsets[i]:offsets[i + 1]], indexing 'perm_names',
+    where offsets is the 'permlist_offsets' column.  Unlike search(),
+    export() matches rules having any of the given permissions.  A
+    Policy may be initialized only once."""
+
+    def __init__(self, path=None, neverallow=False):
+        _sesearch.Policy.__init__(self, path, neverallow)
+
+    def search(self, types, info):
+        perms = _search_params(types, info)
+        rules = _sesearch.Policy.search(self, info)
+        if len(perms) != 0:
+            rules = filter(lambda x: dict_has_perms(x, perms), rules)
+        return rules
+
+    def export(self, types, info):
+        _search_params(types, info)
+        return _sesearch.Policy.export(self, info)
 
 def dict_has_perms(dict, perms):
     for perm in perms:
@@ -45,6 +93,117 @@ def dict_has_perms(dict, perms):
             return False
     return True
 
-def seinfo(setype, name=None):
-    dict_list = _seinfo.seinfo(setype, name)
-    return dict_list
+def seinfo(setype, name=None, path=None):
+    key = ("seinfo", setype, name)
+    entry = get_policy_entry(path)
+    found, result = entry.results.lookup(key)
+    if not found:
+        result = _seinfo.seinfo(setype, name, entry.policy)
+        entry.results.store(key, result)
+    return copy.deepcopy(result)
+
+# Loaded policies, and the results of sesearch() and seinfo() against
+# them, are kept so that repeated calls need neither reload the policy
+# nor rerun the query.  A policy is reloaded, and its results dropped,
+# once its file's modification time changes.  At most POLICY_CACHE_SIZE
+# policies, and RESULTS_CACHE_SIZE results for each, are kept; the least
+# recently used are dropped first.
+
+POLICY_CACHE_SIZE = 4
+RESULTS_CACHE_SIZE = 64
+
+class _ResultCache:
+    def __init__(self):
+        # most recently used last
+        self._keys = []
+        self._values = {}
+
+    def __len__(self):
+        return len(self._keys)
+
+    def lookup(self, key):
+        """Return (True, value) if key is cached, else (False, None)."""
+        if key not in self._values:
+            return False, None
+        self._keys.remove(key)
+        self._keys.append(key)
+        return True, self._values[key]
+
+    def store(self, key, value):
+        if key in self._values:
+            self._keys.remove(key)
+        self._keys.append(key)
+        self._values[key] = value
+        _evict(self._keys, RESULTS_CACHE_SIZE, lambda k: self._values.pop(k))
+
+    def clear(self):
+        self._keys = []
+        self._values = {}
+
+def _evict(lru, size, drop):
+    """Remove all but the size most recently used items from the list
+    lru, calling drop on each."""
+    excess = lru[:max(len(lru) - size, 0)]
+    del lru[:len(excess)]
+    for item in excess:
+        drop(item)
+
+class _PolicyEntry:
+    def __init__(self, path, mtime, neverallow, load_path):
+        self.path = path
+        self.mtime = mtime
+        self.neverallow = neverallow
+        self.policy = Policy(load_path, neverallow)
+        self.results = _ResultCache()
+
+# most recently used last
+_policy_entries = []
+
+def _normalize(info):
+    items = []
+    for k, v in info.items():
+        if isinstance(v, (list, tuple)):
+            v = tuple(sorted(v))
+        elif isinstance(v, bool):
+            v = int(v)
+        items.append((k, v))
+    return tuple(sorted(items))
+
+def get_policy_entry(path=None, neverallow=False):
+    # the default policy is still loaded by Policy(None), so that it is
+    # matched against the running system
+    load_path = path
+    if path is None:
+        path = _sesearch.default_policy()
+    mtime = os.stat(path).st_mtime
+    for i, entry in enumerate(_policy_entries):
+        if entry.path == path:
+            del _policy_entries[i]
+            if entry.mtime == mtime and (entry.neverallow or not neverallow):
+                _policy_entries.append(entry)
+                return entry
+            entry.results.clear()
+            break
+    entry = _PolicyEntry(path, mtime, neverallow, load_path)
+    _policy_entries.append(entry)
+    _evict(_policy_entries, POLICY_CACHE_SIZE, lambda e: e.results.clear())
+    return entry
+
+def get_policy(path=None, neverallow=False):
+    """Return the cached Policy for path (by default, the system's
+    policy), loading it if it is not cached or has since changed."""
+    return get_policy_entry(path, neverallow).policy
+
+def invalidate(path=None, results_only=False):
+    """Forget the cached results of sesearch() and seinfo() for the
+    policy at path, or for every policy if path is None.  Unless
+    results_only is true, the loaded policies are dropped too."""
+    global _policy_entries
+    if path is None:
+        matching = list(_policy_entries)
+    else:
+        matching = [e for e in _policy_entries if e.path == path]
+    for entry in matching:
+        entry.results.clear()
+    if not results_only:
+        _policy_entries = [e for e in _policy_entries if e not in matching]
@@ -53,6 +53,9 @@
 #define COPYRIGHT_INFO "Copyright (C) 2003-2007 Tresys Technology, LLC"
 static char *policy_file = NULL;
 
+/** name of the capsules in which Policy objects carry their policy */
+#define APOL_POLICY_CAPSULE "setools.apol_policy_t"
+
 enum input
 {
 	TYPE, ATTRIBUTE, ROLE, USER, PORT,
@@ -685,15 +688,17 @@ cleanup:
 	return list;
 }
 
-PyObject* seinfo(int type, const char *name)
+/**
+ * Open the system's default policy.
+ *
+ * @return The policy, or NULL with a Python exception set.
+ */
+static apol_policy_t *load_default_policy(void)
 {
 	int rt = -1;
-
 	apol_policy_t *policydb = NULL;
 	apol_policy_path_t *pol_path = NULL;
-	apol_vector_t *mod_paths = NULL;
 	apol_policy_path_type_e path_type = APOL_POLICY_PATH_TYPE_MONOLITHIC;
-	PyObject* output = NULL;
 
 	rt = qpol_default_policy_find(&policy_file);
 	if (rt != 0) {
@@ -701,25 +706,38 @@ PyObject* seinfo(int type, const char *name)
 		return NULL;
 	}
 
-	pol_path = apol_policy_path_create(path_type, policy_file, mod_paths);
+	pol_path = apol_policy_path_create(path_type, policy_file, NULL);
+	free(policy_file);
+	policy_file = NULL;
 	if (!pol_path) {
-		free(policy_file);
-		apol_vector_destroy(&mod_paths);
 		PyErr_SetString(PyExc_RuntimeError,strerror(ENOMEM));
 		return NULL;
 	}
-	apol_vector_destroy(&mod_paths);
 
 	int policy_load_options = 0;
 	policy_load_options |= QPOL_POLICY_OPTION_MATCH_SYSTEM;
 	policydb = apol_policy_create_from_policy_path(pol_path, policy_load_options, NULL, NULL);
+	apol_policy_path_destroy(&pol_path);
 	if (!policydb) {
-		free(policy_file);
-		apol_policy_path_destroy(&pol_path);
 		PyErr_SetString(PyExc_RuntimeError,strerror(errno));
 		return NULL;
 	}
-	free(policy_file);
+	return policydb;
+}
+
+/**
+ * Report on a kind of policy component.
+ *
+ * @param policy An already loaded policy to report on, or NULL to
+ * open the system's default policy for this call only.
+ */
+PyObject* seinfo(int type, const char *name, apol_policy_t *policy)
+{
+	apol_policy_t *policydb = policy;
+	PyObject* output = NULL;
+
+	if (policydb == NULL && (policydb = load_default_policy()) == NULL)
+		return NULL;
 
 	/* display requested info */
 	if (type == TYPE)
@@ -737,19 +755,33 @@ PyObject* seinfo(int type, const char *name)
 	if (type == PORT)
 		output = get_ports(name, policydb);
 
-	apol_policy_destroy(&policydb);
-	apol_policy_path_destroy(&pol_path);
+	if (output == NULL && !PyErr_Occurred())
+		PyErr_SetString(PyExc_ValueError, "unknown kind of component");
+	if (policydb != policy)
+		apol_policy_destroy(&policydb);
 	return output;
 }
 
 PyObject *wrap_seinfo(PyObject *self, PyObject *args){
     unsigned int type;
     char *name;
-    
-    if (!PyArg_ParseTuple(args, "iz", &type, &name))
+    PyObject *obj = NULL, *capsule;
+    apol_policy_t *policy = NULL;
+
+    if (!PyArg_ParseTuple(args, "iz|O", &type, &name, &obj))
         return NULL;
 
-    return Py_BuildValue("O",seinfo(type, name));
+    /* a setools.Policy hands over its already loaded policy */
+    if (obj != NULL && obj != Py_None) {
+        if ((capsule = PyObject_GetAttrString(obj, "_capsule")) == NULL)
+            return NULL;
+        policy = PyCapsule_GetPointer(capsule, APOL_POLICY_CAPSULE);
+        Py_DECREF(capsule);
+        if (policy == NULL)
+            return NULL;
+    }
+
+    return seinfo(type, name, policy);
 
 }
 
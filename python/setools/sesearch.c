@@ -29,95 +29,190 @@
 /**
  * This is a modified version of sesearch to be used as part of a library for
  * Python bindings.
+ *
+ * A Policy object loads a policy once and may then be searched any
+ * number of times.  Its search() method returns AVRule objects, each
+ * of which holds only a pointer to its qpol_avrule_t; a rule's fields
+ * are converted to Python strings only when they are read.  For
+ * bulk processing, export() returns the matching rules as columns of
+ * packed unsigned 32 bit integers, along with tables of the names
+ * those integers refer to.
  */
 
 #include "Python.h"
 
 /* libapol */
 #include <apol/policy.h>
+#include <apol/policy-path.h>
 #include <apol/policy-query.h>
-#include <apol/render.h>
 #include <apol/util.h>
 #include <apol/vector.h>
 
 /* libqpol*/
+#include <qpol/avrule_query.h>
+#include <qpol/class_perm_query.h>
+#include <qpol/iterator.h>
 #include <qpol/policy.h>
-#include <qpol/policy_extend.h>
-#include <qpol/syn_rule_query.h>
+#include <qpol/type_query.h>
 #include <qpol/util.h>
 
 /* other */
 #include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <assert.h>
-#include <getopt.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
 
-#define COPYRIGHT_INFO "Copyright (C) 2003-2007 Tresys Technology, LLC"
-static char *policy_file = NULL;
-
-enum opt_values
-{
-	RULE_NEVERALLOW = 256, RULE_AUDIT, RULE_AUDITALLOW, RULE_DONTAUDIT,
-	RULE_ROLE_ALLOW, RULE_ROLE_TRANS, RULE_RANGE_TRANS, RULE_ALL,
-	EXPR_ROLE_SOURCE, EXPR_ROLE_TARGET
-};
-
-;
-
 typedef struct options
 {
-	char *src_name;
-	char *tgt_name;
-	char *src_role_name;
-	char *tgt_role_name;
-	char *class_name;
-	char *permlist;
-	char *bool_name;
-	apol_vector_t *class_vector;
+	const char *src_name;
+	const char *tgt_name;
+	const char *class_name;
+	const char *permlist;
+	const char *bool_name;
 	bool all;
-	bool lineno;
-	bool semantic;
 	bool indirect;
 	bool allow;
 	bool nallow;
 	bool auditallow;
 	bool dontaudit;
-	bool type;
-	bool rtrans;
-	bool role_allow;
-	bool role_trans;
 	bool useregex;
-	bool show_cond;
-	apol_vector_t *perm_vector;
 } options_t;
 
-static int perform_av_query(const apol_policy_t * policy, const options_t * opt, apol_vector_t ** v)
+typedef struct policy_object
 {
-	apol_avrule_query_t *avq = NULL;
-	unsigned int rules = 0;
-	int error = 0;
-	char *tmp = NULL, *tok = NULL, *s = NULL;
+	PyObject_HEAD apol_policy_t *policy;
+	/** names of types and attributes, indexed by value; the
+	 *  element at 0 is None */
+	PyObject *type_names;
+	/** names of object classes, indexed by value */
+	PyObject *class_names;
+} PolicyObject;
+
+/**
+ * A single av rule.  The rule only refers to its policy's
+ * qpol_avrule_t; it keeps the policy alive so that pointer remains
+ * valid, and converts the rule's fields only when they are read.
+ */
+typedef struct avrule_object
+{
+	PyObject_HEAD PolicyObject *policy;
+	const qpol_avrule_t *rule;
+} AVRuleObject;
+
+static PyTypeObject PolicyType;
+static PyTypeObject AVRuleType;
+
+/** name of the capsules in which Policy objects carry their policy */
+#define APOL_POLICY_CAPSULE "setools.apol_policy_t"
+
+static PyObject *set_error(void)
+{
+	if (!PyErr_Occurred())
+		PyErr_SetString(PyExc_RuntimeError, strerror(errno));
+	return NULL;
+}
+
+static int Dict_ContainsInt(PyObject *dict, const char *key)
+{
+	PyObject *item = PyDict_GetItemString(dict, key);
+	if (item)
+		return PyInt_AsLong(item);
+	return false;
+}
 
-	if (!policy || !opt || !v) {
-		PyErr_SetString(PyExc_RuntimeError,strerror(EINVAL));
-		errno = EINVAL;
+static const char *Dict_ContainsString(PyObject *dict, const char *key)
+{
+	PyObject *item = PyDict_GetItemString(dict, key);
+	if (item && item != Py_None)
+		return PyString_AsString(item);
+	return NULL;
+}
+
+/**
+ * Read search parameters from a dictionary.  Strings within opt are
+ * borrowed from the dictionary.
+ */
+static int options_from_dict(PyObject * dict, options_t * opt)
+{
+	if (!PyDict_Check(dict)) {
+		PyErr_SetString(PyExc_TypeError, "search parameters must be a dictionary");
 		return -1;
 	}
+	memset(opt, 0, sizeof(*opt));
+	opt->allow = Dict_ContainsInt(dict, "allow");
+	opt->nallow = Dict_ContainsInt(dict, "neverallow");
+	opt->auditallow = Dict_ContainsInt(dict, "auditallow");
+	opt->dontaudit = Dict_ContainsInt(dict, "dontaudit");
+	opt->all = Dict_ContainsInt(dict, "all");
+	opt->useregex = Dict_ContainsInt(dict, "regex");
+	opt->indirect = true;
+	if (PyDict_GetItemString(dict, "indirect"))
+		opt->indirect = Dict_ContainsInt(dict, "indirect");
+	opt->src_name = Dict_ContainsString(dict, "scontext");
+	opt->tgt_name = Dict_ContainsString(dict, "tcontext");
+	opt->class_name = Dict_ContainsString(dict, "class");
+	opt->permlist = Dict_ContainsString(dict, "permlist");
+	opt->bool_name = Dict_ContainsString(dict, "bool");
+	if (PyErr_Occurred())
+		return -1;
+	return 0;
+}
 
-	if (!opt->all && !opt->allow && !opt->nallow && !opt->auditallow && !opt->dontaudit) {
-		*v = NULL;
-		return 0;	       /* no search to do */
-	}
+static bool options_has_rules(const options_t * opt)
+{
+	return opt->all || opt->allow || opt->nallow || opt->auditallow || opt->dontaudit;
+}
 
-	avq = apol_avrule_query_create();
-	if (!avq) {
-		PyErr_SetString(PyExc_RuntimeError,strerror(ENOMEM));
-		errno = ENOMEM;
-		return -1;
+/**
+ * Add every class whose name matches a regular expression to an av
+ * rule query.
+ */
+static int append_class_regex(const apol_policy_t * policy, apol_avrule_query_t * avq, const char *expr)
+{
+	apol_class_query_t *cq = NULL;
+	apol_vector_t *v = NULL;
+	const char *class_name;
+	size_t i;
+	int retval = -1;
+
+	if ((cq = apol_class_query_create()) == NULL || apol_class_query_set_regex(policy, cq, 1) ||
+	    apol_class_query_set_class(policy, cq, expr) || apol_class_get_by_query(policy, cq, &v)) {
+		set_error();
+		goto cleanup;
 	}
+	if (apol_vector_get_size(v) == 0) {
+		PyErr_SetString(PyExc_ValueError, "No classes match expression");
+		goto cleanup;
+	}
+	for (i = 0; i < apol_vector_get_size(v); i++) {
+		if (qpol_class_get_name(apol_policy_get_qpol(policy), apol_vector_get_element(v, i), &class_name) ||
+		    apol_avrule_query_append_class(policy, avq, class_name)) {
+			set_error();
+			goto cleanup;
+		}
+	}
+	retval = 0;
+      cleanup:
+	apol_vector_destroy(&v);
+	apol_class_query_destroy(&cq);
+	return retval;
+}
+
+/**
+ * Build the av rule query described by a set of options.
+ *
+ * @return The query, or NULL with a Python exception set.
+ */
+static apol_avrule_query_t *create_av_query(const apol_policy_t * policy, const options_t * opt)
+{
+	apol_avrule_query_t *avq = NULL;
+	unsigned int rules = 0;
+	char *tmp = NULL, *tok = NULL;
+
+	if ((avq = apol_avrule_query_create()) == NULL)
+		goto err;
 
 	if (opt->allow || opt->all)
 		rules |= QPOL_RULE_ALLOW;
@@ -127,352 +222,765 @@ static int perform_av_query(const apol_policy_t * policy, const options_t * opt,
 		rules |= QPOL_RULE_AUDITALLOW;
 	if (opt->dontaudit || opt->all)
 		rules |= QPOL_RULE_DONTAUDIT;
-	apol_avrule_query_set_rules(policy, avq, rules);
-	apol_avrule_query_set_regex(policy, avq, opt->useregex);
-	if (opt->src_name)
-		apol_avrule_query_set_source(policy, avq, opt->src_name, opt->indirect);
-	if (opt->tgt_name)
-		apol_avrule_query_set_target(policy, avq, opt->tgt_name, opt->indirect);
-	if (opt->bool_name)
-		apol_avrule_query_set_bool(policy, avq, opt->bool_name);
+	if (apol_avrule_query_set_rules(policy, avq, rules) || apol_avrule_query_set_regex(policy, avq, opt->useregex))
+		goto err;
+	if (opt->src_name && apol_avrule_query_set_source(policy, avq, opt->src_name, opt->indirect))
+		goto err;
+	if (opt->tgt_name && apol_avrule_query_set_target(policy, avq, opt->tgt_name, opt->indirect))
+		goto err;
+	if (opt->bool_name && apol_avrule_query_set_bool(policy, avq, opt->bool_name))
+		goto err;
 	if (opt->class_name) {
-		if (opt->class_vector == NULL) {
-			if (apol_avrule_query_append_class(policy, avq, opt->class_name)) {
-				error = errno;
+		if (opt->useregex) {
+			if (append_class_regex(policy, avq, opt->class_name))
 				goto err;
-			}
-		} else {
-			size_t i;
-            for (i = 0; i < apol_vector_get_size(opt->class_vector); ++i) {
-				char *class_name;
-				class_name = apol_vector_get_element(opt->class_vector, i);
-				if (!class_name)
-					continue;
-				if (apol_avrule_query_append_class(policy, avq, class_name)) {
-					error = errno;
-					goto err;
-				}
-			}
+		} else if (apol_avrule_query_append_class(policy, avq, opt->class_name)) {
+			goto err;
 		}
 	}
-
 	if (opt->permlist) {
-		tmp = strdup(opt->permlist);
+		if ((tmp = strdup(opt->permlist)) == NULL)
+			goto err;
 		for (tok = strtok(tmp, ","); tok; tok = strtok(NULL, ",")) {
-			if (apol_avrule_query_append_perm(policy, avq, tok)) {
-				error = errno;
+			if (apol_avrule_query_append_perm(policy, avq, tok))
 				goto err;
-			}
-			if ((s = strdup(tok)) == NULL || apol_vector_append(opt->perm_vector, s) < 0) {
-				error = errno;
-				goto err;
-			}
-			s = NULL;
 		}
 		free(tmp);
 	}
+	return avq;
+
+      err:
+	set_error();
+	apol_avrule_query_destroy(&avq);
+	free(tmp);
+	return NULL;
+}
+
+/**
+ * Open a policy.  If path is NULL then the system's default policy is
+ * opened.  The Python interpreter lock is released while the policy
+ * loads.
+ *
+ * @return The policy, or NULL with a Python exception set.
+ */
+static apol_policy_t *policy_load(const char *path, bool neverallow)
+{
+	char *policy_file = NULL;
+	apol_policy_path_t *pol_path = NULL;
+	apol_policy_t *policy = NULL;
+	int pol_opt = 0;
+	int error = 0;
+
+	if (!neverallow)
+		pol_opt |= QPOL_POLICY_OPTION_NO_NEVERALLOWS;
+	if (path == NULL) {
+		if (qpol_default_policy_find(&policy_file)) {
+			PyErr_SetString(PyExc_RuntimeError, "No default policy found.");
+			return NULL;
+		}
+		pol_opt |= QPOL_POLICY_OPTION_MATCH_SYSTEM;
+		path = policy_file;
+	}
 
-	if (!(opt->semantic) && qpol_policy_has_capability(apol_policy_get_qpol(policy), QPOL_CAP_SYN_RULES)) {
-		if (apol_syn_avrule_get_by_query(policy, avq, v)) {
-			error = errno;
+	if (apol_file_is_policy_path_list(path) > 0) {
+		if ((pol_path = apol_policy_path_create_from_file(path)) == NULL) {
+			free(policy_file);
+			PyErr_SetString(PyExc_RuntimeError, "invalid policy list");
+			return NULL;
+		}
+	} else if ((pol_path = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, path, NULL)) == NULL) {
+		free(policy_file);
+		PyErr_SetString(PyExc_RuntimeError, strerror(ENOMEM));
+		return NULL;
+	}
+	free(policy_file);
+
+	Py_BEGIN_ALLOW_THREADS policy = apol_policy_create_from_policy_path(pol_path, pol_opt, NULL, NULL);
+	error = errno;
+	Py_END_ALLOW_THREADS apol_policy_path_destroy(&pol_path);
+	if (!policy) {
+		PyErr_SetString(PyExc_RuntimeError, strerror(error));
+		return NULL;
+	}
+	return policy;
+}
+
+/**
+ * Store a name within a table indexed by value, extending the table
+ * with None as needed.
+ */
+static int name_table_set(PyObject * table, uint32_t value, const char *name)
+{
+	PyObject *obj;
+	while ((size_t) PyList_GET_SIZE(table) <= value) {
+		if (PyList_Append(table, Py_None) < 0)
+			return -1;
+	}
+	if ((obj = PyString_FromString(name)) == NULL)
+		return -1;
+	/* PyList_SetItem steals the reference to obj */
+	return PyList_SetItem(table, value, obj);
+}
+
+/**
+ * Build the policy's type and class name tables, so that rules
+ * share a single string for each name no matter how many of them
+ * are read.
+ */
+static int policy_build_names(PolicyObject * self)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(self->policy);
+	qpol_iterator_t *iter = NULL;
+	const char *name;
+	uint32_t value;
+
+	if ((self->type_names = PyList_New(0)) == NULL || (self->class_names = PyList_New(0)) == NULL)
+		return -1;
+
+	if (qpol_policy_get_type_iter(q, &iter)) {
+		set_error();
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		const qpol_type_t *type;
+		unsigned char isalias;
+		if (qpol_iterator_get_item(iter, (void **)&type) || qpol_type_get_isalias(q, type, &isalias)) {
+			set_error();
 			goto err;
 		}
-	} else {
-		if (apol_avrule_get_by_query(policy, avq, v)) {
-			error = errno;
+		if (isalias)
+			continue;
+		if (qpol_type_get_value(q, type, &value) || qpol_type_get_name(q, type, &name)) {
+			set_error();
 			goto err;
 		}
+		if (name_table_set(self->type_names, value, name))
+			goto err;
 	}
+	qpol_iterator_destroy(&iter);
 
-	apol_avrule_query_destroy(&avq);
+	if (qpol_policy_get_class_iter(q, &iter)) {
+		set_error();
+		return -1;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		const qpol_class_t *obj_class;
+		if (qpol_iterator_get_item(iter, (void **)&obj_class) || qpol_class_get_value(q, obj_class, &value) ||
+		    qpol_class_get_name(q, obj_class, &name)) {
+			set_error();
+			goto err;
+		}
+		if (name_table_set(self->class_names, value, name))
+			goto err;
+	}
+	qpol_iterator_destroy(&iter);
 	return 0;
 
       err:
-	apol_vector_destroy(v);
-	apol_avrule_query_destroy(&avq);
-	free(tmp);
-	free(s);
-	PyErr_SetString(PyExc_RuntimeError,strerror(error));
-	errno = error;
+	qpol_iterator_destroy(&iter);
 	return -1;
 }
 
+static int Policy_init(PolicyObject * self, PyObject * args, PyObject * kwds)
+{
+	static char *kwlist[] = { "path", "neverallow", NULL };
+	const char *path = NULL;
+	int neverallow = 0;
 
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|zi", kwlist, &path, &neverallow))
+		return -1;
+	/* rules already found point into the loaded policy, so it may
+	 * not be replaced */
+	if (self->policy != NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "policy is already loaded");
+		return -1;
+	}
+	Py_CLEAR(self->type_names);
+	Py_CLEAR(self->class_names);
+	if ((self->policy = policy_load(path, neverallow)) == NULL)
+		return -1;
+	if (policy_build_names(self)) {
+		/* leave the object unloaded, so that it may be retried */
+		Py_CLEAR(self->type_names);
+		Py_CLEAR(self->class_names);
+		apol_policy_destroy(&self->policy);
+		return -1;
+	}
+	return 0;
+}
 
-static PyObject* get_av_results(const apol_policy_t * policy, const options_t * opt, const apol_vector_t * v)
+static void Policy_dealloc(PolicyObject * self)
 {
-	int retval = -1;
-	PyObject *list = PyList_New(0);
-	qpol_policy_t *q = apol_policy_get_qpol(policy);
-	size_t i, num_rules = 0;
-	const qpol_avrule_t *rule = NULL;
-	char *tmp = NULL, *rule_str = NULL, *expr = NULL;
-	char enable_char = ' ', branch_char = ' ';
-	qpol_iterator_t *iter = NULL;
-	uint32_t enabled = 0;
+	Py_XDECREF(self->type_names);
+	Py_XDECREF(self->class_names);
+	apol_policy_destroy(&self->policy);
+	self->ob_type->tp_free((PyObject *) self);
+}
 
-	if (!policy || !v)
-		return NULL;
+static int policy_check(PolicyObject * self)
+{
+	if (self->policy == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "policy is not loaded");
+		return -1;
+	}
+	return 0;
+}
 
-	if (!(num_rules = apol_vector_get_size(v)))
+/**
+ * Look up a name within a table indexed by value.
+ *
+ * @return New reference to the name, or NULL with a Python exception
+ * set.
+ */
+static PyObject *name_table_get(PyObject * table, uint32_t value)
+{
+	PyObject *obj;
+	if (value >= (size_t) PyList_GET_SIZE(table) || (obj = PyList_GET_ITEM(table, value)) == Py_None) {
+		PyErr_SetString(PyExc_RuntimeError, strerror(ENOENT));
 		return NULL;
+	}
+	Py_INCREF(obj);
+	return obj;
+}
 
-	for (i = 0; i < num_rules; i++) {
-		enable_char = branch_char = ' ';
-		if (!(rule = apol_vector_get_element(v, i)))
-			goto cleanup;
-		
-		if (qpol_avrule_get_is_enabled(q, rule, &enabled))
-			goto cleanup;
-		if (!enabled)
-			continue;
-        
-		const qpol_type_t *type;
-		const char *tmp_name;
-		uint32_t rule_type = 0;
-		
-		const qpol_class_t *obj_class = NULL;
-		
-		PyObject *dict = PyDict_New(); 
-		
-		qpol_avrule_get_rule_type(q, rule, &rule_type);
-		tmp_name = apol_rule_type_to_str(rule_type);
-		PyObject *obj = PyString_FromString(tmp_name);
-		PyDict_SetItemString(dict, "type", obj);
-		Py_DECREF(obj);
-		// source
-		qpol_avrule_get_source_type(q, rule, &type);
-		qpol_type_get_name(q, type, &tmp_name);
-		obj = PyString_FromString(tmp_name);
-		PyDict_SetItemString(dict, "scontext", obj);
-		Py_DECREF(obj);
-		
-		qpol_avrule_get_target_type(q, rule, &type);
-		qpol_type_get_name(q, type, &tmp_name);
-		obj = PyString_FromString(tmp_name);
-		PyDict_SetItemString(dict, "tcontext", obj);
-		Py_DECREF(obj);
-		
-		qpol_avrule_get_object_class(q, rule, &obj_class);
-		qpol_type_get_name(q, type, &tmp_name);
-		obj = PyString_FromString(tmp_name);
-		PyDict_SetItemString(dict, "class", obj);
-		Py_DECREF(obj);
-		qpol_avrule_get_perm_iter(q, rule, &iter);
-		PyObject *permlist = PyList_New(0);
-		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-			const char *perm_name = NULL;
-			qpol_iterator_get_item(iter, (void **)&perm_name);
-			obj = PyString_FromString(perm_name);
-			PyList_Append(permlist, obj);
-			Py_DECREF(obj);
-		}
-		PyDict_SetItemString(dict, "permlist", permlist);
-		Py_DECREF(permlist);
-		PyList_Append(list, dict); 
-		Py_DECREF(dict);
-		
-		free(rule_str);
-		rule_str = NULL;
-		free(expr);
-		expr = NULL;
+typedef struct search_state
+{
+	PolicyObject *self;
+	PyObject *list;
+} search_state_t;
+
+static int search_rule(void *arg, const apol_policy_t * p, const qpol_avrule_t * rule)
+{
+	search_state_t *s = arg;
+	AVRuleObject *r;
+	uint32_t enabled;
+
+	if (qpol_avrule_get_is_enabled(apol_policy_get_qpol(p), rule, &enabled))
+		return -1;
+	if (!enabled)
+		return 0;
+	if ((r = PyObject_New(AVRuleObject, &AVRuleType)) == NULL)
+		return -1;
+	Py_INCREF(s->self);
+	r->policy = s->self;
+	r->rule = rule;
+	if (PyList_Append(s->list, (PyObject *) r) < 0) {
+		Py_DECREF(r);
+		return -1;
 	}
-	retval = 0;
-      cleanup:
-	free(tmp);
-	free(rule_str);
-	free(expr);
-	if (retval) {
+	Py_DECREF(r);
+	return 0;
+}
+
+static PyObject *Policy_search(PolicyObject * self, PyObject * args)
+{
+	PyObject *dict, *list;
+	options_t opt;
+	apol_avrule_query_t *avq;
+	search_state_t s;
+
+	if (!PyArg_ParseTuple(args, "O", &dict) || options_from_dict(dict, &opt) || policy_check(self))
+		return NULL;
+	if ((list = PyList_New(0)) == NULL || !options_has_rules(&opt))
+		return list;
+	if ((avq = create_av_query(self->policy, &opt)) == NULL) {
 		Py_DECREF(list);
 		return NULL;
 	}
+	s.self = self;
+	s.list = list;
+	if (apol_avrule_foreach_by_query(self->policy, avq, search_rule, &s) < 0) {
+		set_error();
+		Py_CLEAR(list);
+	}
+	apol_avrule_query_destroy(&avq);
 	return list;
 }
 
+/** A growable array of unsigned 32 bit integers. */
+typedef struct u32_buf
+{
+	uint32_t *data;
+	size_t num, size;
+} u32_buf_t;
 
-PyObject* sesearch(bool allow,
-             bool neverallow, 
-             bool auditallow,
-             bool dontaudit,
-             const char *src_name,
-             const char *tgt_name,
-             const char *class_name,
-             const char *permlist
-             )
+static int u32_buf_append(u32_buf_t * b, uint32_t value)
 {
-	options_t cmd_opts;
-	int rt = -1;
-	PyObject *output = NULL;
-	
-	apol_policy_t *policy = NULL;
-	apol_vector_t *v = NULL;
-	apol_policy_path_t *pol_path = NULL;
-	apol_vector_t *mod_paths = NULL;
-	apol_policy_path_type_e path_type = APOL_POLICY_PATH_TYPE_MONOLITHIC;
-	
-	memset(&cmd_opts, 0, sizeof(cmd_opts));
-	cmd_opts.indirect = true;
-	cmd_opts.allow = allow;
-	cmd_opts.nallow = neverallow;
-	cmd_opts.auditallow = auditallow;
-	cmd_opts.dontaudit = dontaudit;
-	if (src_name)
-		cmd_opts.src_name = strdup(src_name);
-	if (tgt_name)
-		cmd_opts.tgt_name = strdup(tgt_name);
-	if (class_name)
-		cmd_opts.class_name = strdup(class_name);
-	if (permlist){
-		cmd_opts.perm_vector = apol_vector_create(free);
-		cmd_opts.permlist = strdup(permlist);
+	if (b->num >= b->size) {
+		size_t size = (b->size == 0 ? 1024 : b->size * 2);
+		uint32_t *data = realloc(b->data, size * sizeof(*data));
+		if (data == NULL)
+			return -1;
+		b->data = data;
+		b->size = size;
 	}
-	int pol_opt = 0;
-	if (!(cmd_opts.nallow || cmd_opts.all))
-		pol_opt |= QPOL_POLICY_OPTION_NO_NEVERALLOWS;
-	
-    
-	rt = qpol_default_policy_find(&policy_file);
-	if (rt) {
-		PyErr_SetString(PyExc_RuntimeError,"No default policy found.");
-		return NULL;
+	b->data[b->num++] = value;
+	return 0;
+}
+
+/** Convert an array to a string of packed native integers. */
+static PyObject *u32_buf_to_string(const u32_buf_t * b)
+{
+	return PyString_FromStringAndSize((const char *)b->data, b->num * sizeof(uint32_t));
+}
+
+typedef struct export_state
+{
+	qpol_policy_t *q;
+	u32_buf_t rule_type, source, target, obj_class, perms, perm_offsets;
+	/** names of the permissions within perms, in order of first use */
+	PyObject *perm_names;
+	/** map from permission name to its index within perm_names */
+	PyObject *perm_index;
+} export_state_t;
+
+static int export_perm(export_state_t * s, const char *name)
+{
+	PyObject *index = PyDict_GetItemString(s->perm_index, name), *obj;
+	long i;
+
+	if (index != NULL)
+		return u32_buf_append(&s->perms, (uint32_t) PyInt_AS_LONG(index));
+	i = PyList_GET_SIZE(s->perm_names);
+	if ((obj = PyString_FromString(name)) == NULL)
+		return -1;
+	if (PyList_Append(s->perm_names, obj) < 0 || (index = PyInt_FromLong(i)) == NULL) {
+		Py_DECREF(obj);
+		return -1;
 	}
-	pol_opt |= QPOL_POLICY_OPTION_MATCH_SYSTEM;
-	
-	if (apol_file_is_policy_path_list(policy_file) > 0) {
-		pol_path = apol_policy_path_create_from_file(policy_file);
-		if (!pol_path) {
-			free(policy_file);
-			PyErr_SetString(PyExc_RuntimeError,"invalid policy list");
-			return NULL;
-		}
+	if (PyDict_SetItem(s->perm_index, obj, index) < 0) {
+		Py_DECREF(obj);
+		Py_DECREF(index);
+		return -1;
 	}
+	Py_DECREF(obj);
+	Py_DECREF(index);
+	return u32_buf_append(&s->perms, (uint32_t) i);
+}
 
-	if (!pol_path)
-		pol_path = apol_policy_path_create(path_type, policy_file, mod_paths);
-	if (!pol_path) {
-		free(policy_file);
-		PyErr_SetString(PyExc_RuntimeError,strerror(ENOMEM));
-		return NULL;
+static int export_rule(void *arg, const apol_policy_t * p __attribute__ ((unused)), const qpol_avrule_t * rule)
+{
+	export_state_t *s = arg;
+	const qpol_type_t *source, *target;
+	const qpol_class_t *obj_class;
+	qpol_iterator_t *iter = NULL;
+	uint32_t enabled, rule_type, value;
+
+	if (qpol_avrule_get_is_enabled(s->q, rule, &enabled))
+		return -1;
+	if (!enabled)
+		return 0;
+	if (qpol_avrule_get_rule_type(s->q, rule, &rule_type) || u32_buf_append(&s->rule_type, rule_type) ||
+	    qpol_avrule_get_source_type(s->q, rule, &source) || qpol_type_get_value(s->q, source, &value) ||
+	    u32_buf_append(&s->source, value) ||
+	    qpol_avrule_get_target_type(s->q, rule, &target) || qpol_type_get_value(s->q, target, &value) ||
+	    u32_buf_append(&s->target, value) ||
+	    qpol_avrule_get_object_class(s->q, rule, &obj_class) || qpol_class_get_value(s->q, obj_class, &value) ||
+	    u32_buf_append(&s->obj_class, value) || qpol_avrule_get_perm_iter(s->q, rule, &iter))
+		return -1;
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		char *perm_name;
+		if (qpol_iterator_get_item(iter, (void **)&perm_name)) {
+			qpol_iterator_destroy(&iter);
+			return -1;
+		}
+		if (export_perm(s, perm_name)) {
+			free(perm_name);
+			qpol_iterator_destroy(&iter);
+			return -1;
+		}
+		free(perm_name);
 	}
-	free(policy_file);
-	apol_vector_destroy(&mod_paths);
-	
-	policy = apol_policy_create_from_policy_path(pol_path, pol_opt, NULL, NULL);
-	if (!policy) {
-		apol_policy_path_destroy(&pol_path);
-		PyErr_SetString(PyExc_RuntimeError,strerror(errno));
+	qpol_iterator_destroy(&iter);
+	return u32_buf_append(&s->perm_offsets, (uint32_t) s->perms.num);
+}
+
+/** Add a new reference to a dictionary, releasing the reference. */
+static int dict_set_steal(PyObject * dict, const char *key, PyObject * obj)
+{
+	int retval;
+	if (obj == NULL)
+		return -1;
+	retval = PyDict_SetItemString(dict, key, obj);
+	Py_DECREF(obj);
+	return retval;
+}
+
+static PyObject *Policy_export(PolicyObject * self, PyObject * args)
+{
+	PyObject *dict, *result = NULL;
+	options_t opt;
+	apol_avrule_query_t *avq = NULL;
+	export_state_t s;
+
+	if (!PyArg_ParseTuple(args, "O", &dict) || options_from_dict(dict, &opt) || policy_check(self))
 		return NULL;
+	memset(&s, 0, sizeof(s));
+	s.q = apol_policy_get_qpol(self->policy);
+	if ((s.perm_names = PyList_New(0)) == NULL || (s.perm_index = PyDict_New()) == NULL ||
+	    u32_buf_append(&s.perm_offsets, 0)) {
+		set_error();
+		goto cleanup;
 	}
-	/* handle regex for class name */
-	if (cmd_opts.useregex && cmd_opts.class_name != NULL) {
-		cmd_opts.class_vector = apol_vector_create(NULL);
-		apol_vector_t *qpol_matching_classes = NULL;
-		apol_class_query_t *regex_match_query = apol_class_query_create();
-		apol_class_query_set_regex(policy, regex_match_query, 1);
-		apol_class_query_set_class(policy, regex_match_query, cmd_opts.class_name);
-		if (apol_class_get_by_query(policy, regex_match_query, &qpol_matching_classes)) {
-			apol_class_query_destroy(&regex_match_query);
-			PyErr_SetString(PyExc_RuntimeError,"Query failed");
+	if (options_has_rules(&opt)) {
+		if ((avq = create_av_query(self->policy, &opt)) == NULL)
 			goto cleanup;
-		}
-		const qpol_class_t *class = NULL;
-		size_t i;
-		for (i = 0; i < apol_vector_get_size(qpol_matching_classes); ++i) {
-			const char *class_name;
-			class = apol_vector_get_element(qpol_matching_classes, i);
-			if (!class)
-				break;
-			qpol_class_get_name(apol_policy_get_qpol(policy), class, &class_name);
-			apol_vector_append(cmd_opts.class_vector, (void *)class_name);
-		}
-		if (!apol_vector_get_size(qpol_matching_classes)) {
-			apol_vector_destroy(&qpol_matching_classes);
-			apol_class_query_destroy(&regex_match_query);
-			PyErr_SetString(PyExc_RuntimeError,"No classes match expression");
+		if (apol_avrule_foreach_by_query(self->policy, avq, export_rule, &s) < 0) {
+			set_error();
 			goto cleanup;
 		}
-		apol_vector_destroy(&qpol_matching_classes);
-		apol_class_query_destroy(&regex_match_query);
 	}
+	if ((result = PyDict_New()) == NULL)
+		goto cleanup;
+	if (dict_set_steal(result, "count", PyInt_FromSize_t(s.source.num)) ||
+	    dict_set_steal(result, "type", u32_buf_to_string(&s.rule_type)) ||
+	    dict_set_steal(result, "scontext", u32_buf_to_string(&s.source)) ||
+	    dict_set_steal(result, "tcontext", u32_buf_to_string(&s.target)) ||
+	    dict_set_steal(result, "class", u32_buf_to_string(&s.obj_class)) ||
+	    dict_set_steal(result, "permlist", u32_buf_to_string(&s.perms)) ||
+	    dict_set_steal(result, "permlist_offsets", u32_buf_to_string(&s.perm_offsets)) ||
+	    dict_set_steal(result, "type_names", PyList_AsTuple(self->type_names)) ||
+	    dict_set_steal(result, "class_names", PyList_AsTuple(self->class_names)) ||
+	    dict_set_steal(result, "perm_names", PyList_AsTuple(s.perm_names))) {
+		Py_CLEAR(result);
+	}
+      cleanup:
+	apol_avrule_query_destroy(&avq);
+	free(s.rule_type.data);
+	free(s.source.data);
+	free(s.target.data);
+	free(s.obj_class.data);
+	free(s.perms.data);
+	free(s.perm_offsets.data);
+	Py_XDECREF(s.perm_names);
+	Py_XDECREF(s.perm_index);
+	return result;
+}
 
-	if (!cmd_opts.semantic && qpol_policy_has_capability(apol_policy_get_qpol(policy), QPOL_CAP_SYN_RULES)) {
-		if (qpol_policy_build_syn_rule_table(apol_policy_get_qpol(policy))) {
-			apol_policy_destroy(&policy);
-			PyErr_SetString(PyExc_RuntimeError,"Query failed");
-			goto cleanup;
+static PyMethodDef Policy_methods[] = {
+	{"search", (PyCFunction) Policy_search, METH_VARARGS,
+	 "search(params) -> list of AVRule\n\n"
+	 "Find the enabled av rules matching a dictionary of search parameters."},
+	{"export", (PyCFunction) Policy_export, METH_VARARGS,
+	 "export(params) -> dict\n\n"
+	 "Find the enabled av rules matching a dictionary of search parameters,\n"
+	 "returning them as columns of packed native uint32 values: 'type',\n"
+	 "'scontext', 'tcontext', and 'class' hold one value per rule, indexing\n"
+	 "'type_names' and 'class_names'; rule i's permissions are\n"
+	 "'permlist'[offsets[i]:offsets[i+1]], indexing 'perm_names', where\n"
+	 "offsets is 'permlist_offsets'."},
+	{NULL, NULL, 0, NULL}
+};
+
+/**
+ * Hand the loaded policy to the other setools modules.  The capsule
+ * does not keep the Policy alive; it is only valid while the Policy
+ * is.
+ */
+static PyObject *Policy_get_capsule(PyObject * obj, void *closure __attribute__ ((unused)))
+{
+	PolicyObject *self = (PolicyObject *) obj;
+	if (policy_check(self))
+		return NULL;
+	return PyCapsule_New(self->policy, APOL_POLICY_CAPSULE, NULL);
+}
+
+static PyGetSetDef Policy_getset[] = {
+	{"_capsule", Policy_get_capsule, NULL, "the loaded apol_policy_t", NULL},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject PolicyType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"_sesearch.Policy",	       /* tp_name */
+	sizeof(PolicyObject),	       /* tp_basicsize */
+	0,			       /* tp_itemsize */
+	(destructor) Policy_dealloc,   /* tp_dealloc */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,	/* tp_flags */
+	"Policy([path[, neverallow]])\n\n"
+	"A loaded policy, which may be searched any number of times.  If no\n"
+	"path is given the system's default policy is loaded; neverallow rules\n"
+	"are kept only if neverallow is true.",	/* tp_doc */
+	0, 0, 0, 0, 0, 0,
+	Policy_methods,		       /* tp_methods */
+	0,			       /* tp_members */
+	Policy_getset,		       /* tp_getset */
+	0, 0, 0, 0, 0,
+	(initproc) Policy_init,	       /* tp_init */
+	0,			       /* tp_alloc */
+	PyType_GenericNew,	       /* tp_new */
+};
+
+static qpol_policy_t *avrule_qpol(AVRuleObject * self)
+{
+	return apol_policy_get_qpol(self->policy->policy);
+}
+
+static void AVRule_dealloc(AVRuleObject * self)
+{
+	Py_XDECREF(self->policy);
+	PyObject_Del(self);
+}
+
+static PyObject *AVRule_get_type(PyObject * obj, void *closure __attribute__ ((unused)))
+{
+	AVRuleObject *self = (AVRuleObject *) obj;
+	uint32_t rule_type;
+	if (qpol_avrule_get_rule_type(avrule_qpol(self), self->rule, &rule_type))
+		return set_error();
+	return PyString_FromString(apol_rule_type_to_str(rule_type));
+}
+
+static PyObject *AVRule_get_source(PyObject * obj, void *closure __attribute__ ((unused)))
+{
+	AVRuleObject *self = (AVRuleObject *) obj;
+	const qpol_type_t *type;
+	uint32_t value;
+	if (qpol_avrule_get_source_type(avrule_qpol(self), self->rule, &type) ||
+	    qpol_type_get_value(avrule_qpol(self), type, &value))
+		return set_error();
+	return name_table_get(self->policy->type_names, value);
+}
+
+static PyObject *AVRule_get_target(PyObject * obj, void *closure __attribute__ ((unused)))
+{
+	AVRuleObject *self = (AVRuleObject *) obj;
+	const qpol_type_t *type;
+	uint32_t value;
+	if (qpol_avrule_get_target_type(avrule_qpol(self), self->rule, &type) ||
+	    qpol_type_get_value(avrule_qpol(self), type, &value))
+		return set_error();
+	return name_table_get(self->policy->type_names, value);
+}
+
+static PyObject *AVRule_get_class(PyObject * obj, void *closure __attribute__ ((unused)))
+{
+	AVRuleObject *self = (AVRuleObject *) obj;
+	const qpol_class_t *obj_class;
+	uint32_t value;
+	if (qpol_avrule_get_object_class(avrule_qpol(self), self->rule, &obj_class) ||
+	    qpol_class_get_value(avrule_qpol(self), obj_class, &value))
+		return set_error();
+	return name_table_get(self->policy->class_names, value);
+}
+
+static PyObject *AVRule_get_perms(PyObject * obj, void *closure __attribute__ ((unused)))
+{
+	AVRuleObject *self = (AVRuleObject *) obj;
+	qpol_iterator_t *iter = NULL;
+	PyObject *list;
+
+	if (qpol_avrule_get_perm_iter(avrule_qpol(self), self->rule, &iter))
+		return set_error();
+	if ((list = PyList_New(0)) == NULL) {
+		qpol_iterator_destroy(&iter);
+		return NULL;
+	}
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		char *perm_name;
+		PyObject *perm;
+		if (qpol_iterator_get_item(iter, (void **)&perm_name)) {
+			set_error();
+			goto err;
 		}
+		perm = PyString_FromString(perm_name);
+		free(perm_name);
+		if (perm == NULL || PyList_Append(list, perm) < 0) {
+			Py_XDECREF(perm);
+			goto err;
+		}
+		Py_DECREF(perm);
+	}
+	qpol_iterator_destroy(&iter);
+	return list;
+      err:
+	qpol_iterator_destroy(&iter);
+	Py_DECREF(list);
+	return NULL;
+}
+
+static PyObject *AVRule_get_conditional(PyObject * obj, void *closure __attribute__ ((unused)))
+{
+	AVRuleObject *self = (AVRuleObject *) obj;
+	const qpol_cond_t *cond;
+	if (qpol_avrule_get_cond(avrule_qpol(self), self->rule, &cond))
+		return set_error();
+	return PyBool_FromLong(cond != NULL);
+}
+
+static PyGetSetDef AVRule_getset[] = {
+	{"type", AVRule_get_type, NULL, "kind of rule, such as 'allow'", NULL},
+	{"scontext", AVRule_get_source, NULL, "source type", NULL},
+	{"tcontext", AVRule_get_target, NULL, "target type", NULL},
+	{"class", AVRule_get_class, NULL, "object class", NULL},
+	{"permlist", AVRule_get_perms, NULL, "list of permissions", NULL},
+	{"conditional", AVRule_get_conditional, NULL, "whether the rule is within a conditional", NULL},
+	{NULL, NULL, NULL, NULL, NULL}
+};
+
+/**
+ * Allow rule["scontext"] and so on, so that rules may be used where
+ * sesearch() results used to be.
+ */
+static PyObject *AVRule_subscript(PyObject * obj, PyObject * key)
+{
+	const char *name;
+	const PyGetSetDef *g;
+
+	if ((name = PyString_AsString(key)) == NULL)
+		return NULL;
+	for (g = AVRule_getset; g->name != NULL; g++) {
+		if (strcmp(g->name, name) == 0)
+			return g->get(obj, NULL);
 	}
+	PyErr_SetObject(PyExc_KeyError, key);
+	return NULL;
+}
 
-	/* if syntactic rules are not available always do semantic search */
-	if (!qpol_policy_has_capability(apol_policy_get_qpol(policy), QPOL_CAP_SYN_RULES)) {
-		cmd_opts.semantic = 1;
+static PyObject *AVRule_repr(PyObject * obj)
+{
+	AVRuleObject *self = (AVRuleObject *) obj;
+	PyObject *s;
+	char *rule_str;
+
+	if ((rule_str = apol_avrule_render(self->policy->policy, self->rule)) == NULL)
+		return set_error();
+	s = PyString_FromFormat("<AVRule %s>", rule_str);
+	free(rule_str);
+	return s;
+}
+
+static PyMappingMethods AVRule_mapping = {
+	0,			       /* mp_length */
+	AVRule_subscript,	       /* mp_subscript */
+	0,			       /* mp_ass_subscript */
+};
+
+static PyTypeObject AVRuleType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"_sesearch.AVRule",	       /* tp_name */
+	sizeof(AVRuleObject),	       /* tp_basicsize */
+	0,			       /* tp_itemsize */
+	(destructor) AVRule_dealloc,   /* tp_dealloc */
+	0, 0, 0, 0,
+	AVRule_repr,		       /* tp_repr */
+	0, 0,
+	&AVRule_mapping,	       /* tp_as_mapping */
+	0, 0, 0, 0, 0, 0,
+	Py_TPFLAGS_DEFAULT,	       /* tp_flags */
+	"An av rule within a Policy; fields are read as attributes or keys.",	/* tp_doc */
+	0, 0, 0, 0, 0, 0, 0, 0,
+	AVRule_getset,		       /* tp_getset */
+};
+
+static const char *const avrule_keys[] = { "type", "scontext", "tcontext", "class", "permlist", NULL };
+
+static PyObject *avrule_to_dict(PyObject * rule)
+{
+	PyObject *dict = PyDict_New(), *key;
+	size_t i;
+
+	if (dict == NULL)
+		return NULL;
+	for (i = 0; avrule_keys[i] != NULL; i++) {
+		if ((key = PyString_FromString(avrule_keys[i])) == NULL ||
+		    dict_set_steal(dict, avrule_keys[i], AVRule_subscript(rule, key))) {
+			Py_XDECREF(key);
+			Py_DECREF(dict);
+			return NULL;
+		}
+		Py_DECREF(key);
 	}
+	return dict;
+}
+
+/**
+ * Search a Policy, or else the system's default policy, returning a
+ * list of dictionaries (or None if nothing matched).  Without a
+ * Policy the default policy is loaded anew on every call.
+ */
+PyObject *wrap_sesearch(PyObject *self, PyObject *args)
+{
+	PyObject *dict, *policy = NULL, *search_args, *rules, *output;
+	Py_ssize_t i;
 
-	/* supress line numbers if doing semantic search or not available */
-	if (cmd_opts.semantic || !qpol_policy_has_capability(apol_policy_get_qpol(policy), QPOL_CAP_LINE_NUMBERS)) {
-		cmd_opts.lineno = 0;
+	if (!PyArg_ParseTuple(args, "O|O!", &dict, &PolicyType, &policy))
+		return NULL;
+	if (!PyDict_Check(dict)) {
+		PyErr_SetString(PyExc_TypeError, "search parameters must be a dictionary");
+		return NULL;
 	}
-	if (perform_av_query(policy, &cmd_opts, &v)) {
-		goto cleanup;
+	if (policy != NULL) {
+		Py_INCREF(policy);
+	} else if ((policy = PyObject_CallFunction((PyObject *) & PolicyType, "zi", NULL,
+						   Dict_ContainsInt(dict, "neverallow") || Dict_ContainsInt(dict, "all"))) == NULL) {
+		return NULL;
+	}
+	if ((search_args = PyTuple_Pack(1, dict)) == NULL) {
+		Py_DECREF(policy);
+		return NULL;
 	}
-	if (v) {
-		output =  get_av_results(policy, &cmd_opts, v);
+	rules = Policy_search((PolicyObject *) policy, search_args);
+	Py_DECREF(search_args);
+	Py_DECREF(policy);
+	if (rules == NULL)
+		return NULL;
+	if (PyList_GET_SIZE(rules) == 0) {
+		Py_DECREF(rules);
+		Py_RETURN_NONE;
 	}
-	apol_vector_destroy(&v);
-      cleanup:
-	apol_policy_destroy(&policy);
-	apol_policy_path_destroy(&pol_path);
-	free(cmd_opts.src_name);
-	free(cmd_opts.tgt_name);
-	free(cmd_opts.class_name);
-	free(cmd_opts.permlist);
-	free(cmd_opts.bool_name);
-	free(cmd_opts.src_role_name);
-	free(cmd_opts.tgt_role_name);
-	apol_vector_destroy(&cmd_opts.perm_vector);
-	apol_vector_destroy(&cmd_opts.class_vector);
-
-	if (output) return output;
-	return Py_None;
-}
-static int Dict_ContainsInt(PyObject *dict, const char *key){
-    PyObject *item = PyDict_GetItemString(dict, key);
-    if (item)
-        return PyInt_AsLong(item);
-    return false;
-}
-
-static const char *Dict_ContainsString(PyObject *dict, const char *key){
-    PyObject *item = PyDict_GetItemString(dict, key);
-    if (item)
-        return PyString_AsString(item);
-    return NULL;
-}
-
-PyObject *wrap_sesearch(PyObject *self, PyObject *args){
-    PyObject *dict;
-    if (!PyArg_ParseTuple(args, "O", &dict))
-        return NULL;
-    int allow = Dict_ContainsInt(dict, "allow");
-    int neverallow = Dict_ContainsInt(dict, "neverallow");
-    int auditallow = Dict_ContainsInt(dict, "auditallow");
-    int dontaudit = Dict_ContainsInt(dict, "dontaudit"); 
-   
-    const char *src_name = Dict_ContainsString(dict, "scontext");
-    const char *tgt_name = Dict_ContainsString(dict, "tcontext");
-    const char *class_name = Dict_ContainsString(dict, "class");
-    const char *permlist = Dict_ContainsString(dict, "permlist");
-    
-    return Py_BuildValue("O",sesearch(allow, neverallow, auditallow, dontaudit, src_name, tgt_name, class_name, permlist));
+	if ((output = PyList_New(PyList_GET_SIZE(rules))) == NULL) {
+		Py_DECREF(rules);
+		return NULL;
+	}
+	for (i = 0; i < PyList_GET_SIZE(rules); i++) {
+		PyObject *d = avrule_to_dict(PyList_GET_ITEM(rules, i));
+		if (d == NULL) {
+			Py_DECREF(output);
+			Py_DECREF(rules);
+			return NULL;
+		}
+		PyList_SET_ITEM(output, i, d);
+	}
+	Py_DECREF(rules);
+	return output;
+}
 
+/** Return the path to the system's default policy. */
+static PyObject *wrap_default_policy(PyObject *self, PyObject *args)
+{
+	char *policy_file = NULL;
+	PyObject *path;
+
+	if (qpol_default_policy_find(&policy_file)) {
+		PyErr_SetString(PyExc_RuntimeError, "No default policy found.");
+		return NULL;
+	}
+	path = PyString_FromString(policy_file);
+	free(policy_file);
+	return path;
 }
 
 static PyMethodDef methods[] = {
     {"sesearch", (PyCFunction) wrap_sesearch, METH_VARARGS},
+    {"default_policy", (PyCFunction) wrap_default_policy, METH_NOARGS},
     {NULL, NULL, 0, NULL}
 };
 
 void init_sesearch(){
     PyObject *m;
+    if (PyType_Ready(&PolicyType) < 0 || PyType_Ready(&AVRuleType) < 0)
+        return;
     m = Py_InitModule("_sesearch", methods);
+    if (m == NULL)
+        return;
+    Py_INCREF(&PolicyType);
+    PyModule_AddObject(m, "Policy", (PyObject *) & PolicyType);
+    Py_INCREF(&AVRuleType);
+    PyModule_AddObject(m, "AVRule", (PyObject *) & AVRuleType);
+    PyModule_AddIntConstant(m, "RULE_ALLOW", QPOL_RULE_ALLOW);
+    PyModule_AddIntConstant(m, "RULE_NEVERALLOW", QPOL_RULE_NEVERALLOW);
+    PyModule_AddIntConstant(m, "RULE_AUDITALLOW", QPOL_RULE_AUDITALLOW);
+    PyModule_AddIntConstant(m, "RULE_DONTAUDIT", QPOL_RULE_DONTAUDIT);
 }
@@ -3,7 +3,7 @@
 # Author: Thomas Liu <tliu@redhat.com>
 import os
 from distutils.core import setup, Extension
-LIBS=["apol", "qpol"]
+LIBS=["apol", "qpol", "pthread"]
 
 try:
     inc=os.getenv("INCLUDES").split(" ")    
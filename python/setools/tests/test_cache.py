@@ -0,0 +1,140 @@
+#!/usr/bin/env python
+
+# Tests of the policy and results caches within the setools module.
+# The compiled _sesearch and _seinfo modules are replaced by stand-ins
+# that count how often policies are loaded and queries are run, so no
+# policy or build is needed.
+
+import imp
+import os
+import sys
+import tempfile
+import types
+import unittest
+
+class _FakePolicy(object):
+    loads = 0
+
+    def __init__(self, path=None, neverallow=False):
+        _FakePolicy.loads += 1
+        self.path = path
+
+def _fake_sesearch(info, policy):
+    _fake_sesearch.runs += 1
+    return [{'scontext': info.get('scontext'), 'permlist': ['read']}]
+
+def _fake_seinfo(setype, name, policy):
+    _fake_seinfo.runs += 1
+    return [{'name': name}]
+
+def _load_setools():
+    sesearch = types.ModuleType('_sesearch')
+    sesearch.Policy = _FakePolicy
+    sesearch.sesearch = _fake_sesearch
+    sesearch.RULE_ALLOW, sesearch.RULE_AUDITALLOW, sesearch.RULE_NEVERALLOW, sesearch.RULE_DONTAUDIT = 1, 2, 128, 4
+    seinfo = types.ModuleType('_seinfo')
+    seinfo.seinfo = _fake_seinfo
+    seinfo.TYPE, seinfo.ROLE, seinfo.ATTRIBUTE, seinfo.PORT, seinfo.USER = range(5)
+    sys.modules['_sesearch'] = sesearch
+    sys.modules['_seinfo'] = seinfo
+    init = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '__init__.py')
+    return imp.load_source('setools', init)
+
+setools = _load_setools()
+
+class CacheTests(unittest.TestCase):
+    def setUp(self):
+        setools.invalidate()
+        _FakePolicy.loads = 0
+        _fake_sesearch.runs = 0
+        _fake_seinfo.runs = 0
+        self.paths = []
+
+    def tearDown(self):
+        setools.invalidate()
+        for path in self.paths:
+            os.unlink(path)
+
+    def make_policy(self, mtime=1000000000):
+        fd, path = tempfile.mkstemp()
+        os.close(fd)
+        os.utime(path, (mtime, mtime))
+        self.paths.append(path)
+        return path
+
+    def search(self, path, source='user_t'):
+        return setools.sesearch([setools.ALLOW], {'scontext': source}, path)
+
+    def test_reuse_handle(self):
+        path = self.make_policy()
+        policy = setools.get_policy(path)
+        self.assertTrue(setools.get_policy(path) is policy)
+        self.search(path)
+        self.assertTrue(setools.get_policy(path) is policy)
+        self.assertEqual(_FakePolicy.loads, 1)
+
+    def test_reuse_results(self):
+        path = self.make_policy()
+        first = self.search(path)
+        second = self.search(path)
+        self.assertEqual(first, second)
+        self.assertEqual(_fake_sesearch.runs, 1)
+        # callers may change what they are given without affecting
+        # the cached results
+        second[0]['permlist'].append('write')
+        self.assertEqual(self.search(path), first)
+        setools.seinfo(setools.TYPE, 'user_t', path)
+        setools.seinfo(setools.TYPE, 'user_t', path)
+        self.assertEqual(_fake_seinfo.runs, 1)
+
+    def test_mtime_change(self):
+        path = self.make_policy()
+        entry = setools.get_policy_entry(path)
+        self.search(path)
+        os.utime(path, (2000000000, 2000000000))
+        self.assertTrue(setools.get_policy(path) is not entry.policy)
+        self.assertEqual(len(entry.results), 0)
+        self.assertEqual(_FakePolicy.loads, 2)
+        self.search(path)
+        self.assertEqual(_fake_sesearch.runs, 2)
+
+    def test_results_bounded(self):
+        path = self.make_policy()
+        entry = setools.get_policy_entry(path)
+        for i in range(setools.RESULTS_CACHE_SIZE + 10):
+            self.search(path, 'type%d_t' % i)
+        self.assertEqual(len(entry.results), setools.RESULTS_CACHE_SIZE)
+        runs = _fake_sesearch.runs
+        # the most recent results are kept, the oldest are dropped
+        self.search(path, 'type%d_t' % (setools.RESULTS_CACHE_SIZE + 9))
+        self.assertEqual(_fake_sesearch.runs, runs)
+        self.search(path, 'type0_t')
+        self.assertEqual(_fake_sesearch.runs, runs + 1)
+
+    def test_results_lru(self):
+        path = self.make_policy()
+        self.search(path, 'type0_t')
+        for i in range(1, setools.RESULTS_CACHE_SIZE):
+            self.search(path, 'type%d_t' % i)
+        # using the oldest result makes it the most recently used
+        self.search(path, 'type0_t')
+        self.search(path, 'new_t')
+        runs = _fake_sesearch.runs
+        self.search(path, 'type0_t')
+        self.assertEqual(_fake_sesearch.runs, runs)
+        self.search(path, 'type1_t')
+        self.assertEqual(_fake_sesearch.runs, runs + 1)
+
+    def test_evicted_handle(self):
+        first = self.make_policy()
+        entry = setools.get_policy_entry(first)
+        self.search(first)
+        self.assertEqual(len(entry.results), 1)
+        for i in range(setools.POLICY_CACHE_SIZE):
+            setools.get_policy(self.make_policy())
+        self.assertEqual(len(entry.results), 0)
+        self.assertTrue(setools.get_policy_entry(first) is not entry)
+
+if __name__ == '__main__':
+    result = unittest.TextTestRunner(verbosity=2).run(unittest.defaultTestLoader.loadTestsFromTestCase(CacheTests))
+    sys.exit(not result.wasSuccessful())
@@ -31,10 +31,14 @@
 
 #include <config.h>
 
+#include <seaudit/aggregate.h>
+#include <seaudit/correlate.h>
 #include <seaudit/log.h>
 #include <seaudit/parse.h>
 #include <seaudit/report.h>
 
+#include <apol/policy.h>
+#include <apol/policy-path.h>
 #include <apol/vector.h>
 
 #include <errno.h>
@@ -47,7 +51,7 @@
 
 enum opts
 {
-	OPT_HTML = 256, OPT_STYLESHEET
+	OPT_HTML = 256, OPT_STYLESHEET, OPT_SUMMARY, OPT_TOP, OPT_POLICY
 };
 
 static struct option const longopts[] = {
@@ -56,6 +60,9 @@ static struct option const longopts[] = {
 	{"output", required_argument, NULL, 'o'},
 	{"stylesheet", required_argument, NULL, OPT_STYLESHEET},
 	{"stdin", no_argument, NULL, 's'},
+	{"summary", no_argument, NULL, OPT_SUMMARY},
+	{"top", required_argument, NULL, OPT_TOP},
+	{"policy", required_argument, NULL, OPT_POLICY},
 	{"config", required_argument, NULL, 'c'},
 	{"help", no_argument, NULL, 'h'},
 	{"version", no_argument, NULL, 'V'},
@@ -89,6 +96,23 @@ static seaudit_report_t *report = NULL;
  */
 static char *outfile = NULL;
 
+/**
+ * If non-NULL, then logs are parsed in a single streaming pass and
+ * avc messages are summarized within this aggregate instead of being
+ * kept within the model.
+ */
+static seaudit_aggregate_t *aggregate = NULL;
+
+/**
+ * If non-NULL, policy against which avc messages are correlated.
+ */
+static apol_policy_t *policy = NULL;
+
+/**
+ * Correlation between the first log and the above policy.
+ */
+static seaudit_correlation_t *correlation = NULL;
+
 static void seaudit_report_info_usage(const char *program_name, int brief)
 {
 	printf("Usage: %s [OPTIONS] LOGFILE ...\n\n", program_name);
@@ -104,18 +128,38 @@ static void seaudit_report_info_usage(const char *program_name, int brief)
 	printf("  --html                   set output format to HTML\n");
 	printf("  --stylesheet=FILE        HTML style sheet for formatting HTML report\n");
 	printf("                           (ignored if --html is not given)\n");
+	printf("  --summary                summarize avc messages in a single pass,\n");
+	printf("                           grouped by context, class, and permission\n");
+	printf("  --top=N                  list only the N most frequent groups\n");
+	printf("                           (ignored if --summary is not given)\n");
+	printf("  --policy=FILE            annotate avc messages with the rules from\n");
+	printf("                           policy FILE that apply to them\n");
 	printf("  -h, --help               print this help text and exit\n");
 	printf("  -V, --version            print version information and exit\n");
 	printf("\n");
 	printf("Default style sheet is at %s.\n", APOL_INSTALL_DIR);
 }
 
+/**
+ * Parse a log file, either into the log itself or, if summarizing,
+ * in a single pass into the aggregate.
+ */
+static int report_parse_log(seaudit_log_t * l, FILE * f)
+{
+	if (aggregate != NULL) {
+		return seaudit_log_parse_stream(l, f, seaudit_aggregate_stream_fn, aggregate);
+	}
+	return seaudit_log_parse(l, f);
+}
+
 static void parse_command_line_args(int argc, char **argv)
 {
 	int optc, i;
-	int do_malformed = 0, do_style = 0, read_stdin = 0;
+	int do_malformed = 0, do_style = 0, read_stdin = 0, do_summary = 0;
+	size_t top = 0;
+	char *endptr;
 	seaudit_report_format_e format = SEAUDIT_REPORT_FORMAT_TEXT;
-	char *configfile = NULL, *stylesheet = NULL;
+	char *configfile = NULL, *stylesheet = NULL, *policy_file = NULL;
 
 	/* get option arguments */
 	while ((optc = getopt_long(argc, argv, "smo:c:hV", longopts, NULL)) != -1) {
@@ -140,6 +184,19 @@ static void parse_command_line_args(int argc, char **argv)
 			stylesheet = optarg;
 			do_style = 1;
 			break;
+		case OPT_SUMMARY:     /* Aggregate avc messages while parsing */
+			do_summary = 1;
+			break;
+		case OPT_TOP:	       /* Number of aggregate groups to list */
+			top = strtoul(optarg, &endptr, 10);
+			if (*optarg == '\0' || *endptr != '\0') {
+				fprintf(stderr, "ERROR: Invalid number of groups %s.\n", optarg);
+				exit(-1);
+			}
+			break;
+		case OPT_POLICY:      /* Policy against which to correlate */
+			policy_file = optarg;
+			break;
 		case 'h':
 			/* display help */
 			seaudit_report_info_usage(argv[0], 0);
@@ -171,6 +228,10 @@ static void parse_command_line_args(int argc, char **argv)
 	if ((model = seaudit_model_create("seaudit-report", NULL)) == NULL) {
 		exit(-1);
 	}
+	if (do_summary && (aggregate = seaudit_aggregate_create()) == NULL) {
+		fprintf(stderr, "ERROR: %s\n", strerror(errno));
+		exit(-1);
+	}
 	if ((first_log = seaudit_log_create(NULL, NULL)) == NULL || seaudit_model_append_log(model, first_log) < 0) {
 		fprintf(stderr, "ERROR: %s\n", strerror(errno));
 		exit(-1);
@@ -185,7 +246,7 @@ static void parse_command_line_args(int argc, char **argv)
 		if (optind < argc) {
 			fprintf(stderr, "WARNING: %s\n", "Command line filename(s) will be ignored. Reading from stdin.");
 		}
-		if (seaudit_log_parse(first_log, stdin) < 0) {
+		if (report_parse_log(first_log, stdin) < 0) {
 			exit(-1);
 		}
 	} else {
@@ -196,7 +257,7 @@ static void parse_command_line_args(int argc, char **argv)
 			fprintf(stderr, "ERROR: %s\n", strerror(errno));
 			exit(-1);
 		}
-		if (seaudit_log_parse(first_log, f) < 0) {
+		if (report_parse_log(first_log, f) < 0) {
 			exit(-1);
 		}
 		fclose(f);
@@ -212,18 +273,37 @@ static void parse_command_line_args(int argc, char **argv)
 				fprintf(stderr, "ERROR: %s\n", strerror(errno));
 				exit(-1);
 			}
-			if (seaudit_log_parse(l, f) < 0) {
+			if (report_parse_log(l, f) < 0) {
 				exit(-1);
 			}
 			fclose(f);
 		}
 	}
 
+	if (policy_file != NULL) {
+		apol_policy_path_t *ppath;
+		if ((ppath = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, policy_file, NULL)) == NULL) {
+			fprintf(stderr, "ERROR: %s\n", strerror(errno));
+			exit(-1);
+		}
+		policy = apol_policy_create_from_policy_path(ppath, 0, NULL, NULL);
+		apol_policy_path_destroy(&ppath);
+		if (policy == NULL) {
+			fprintf(stderr, "ERROR: Could not open policy %s.\n", policy_file);
+			exit(-1);
+		}
+		if ((correlation = seaudit_correlation_create(first_log, policy)) == NULL) {
+			exit(-1);
+		}
+	}
+
 	if ((report = seaudit_report_create(model)) == NULL ||
 	    seaudit_report_set_format(first_log, report, format) < 0 ||
 	    seaudit_report_set_configuration(first_log, report, configfile) < 0 ||
 	    seaudit_report_set_stylesheet(first_log, report, stylesheet, do_style) < 0 ||
-	    seaudit_report_set_malformed(first_log, report, do_malformed) < 0) {
+	    seaudit_report_set_malformed(first_log, report, do_malformed) < 0 ||
+	    (aggregate != NULL && seaudit_report_set_aggregate(first_log, report, aggregate, top) < 0) ||
+	    (correlation != NULL && seaudit_report_set_correlation(first_log, report, correlation) < 0)) {
 		exit(-1);
 	}
 }
@@ -236,6 +316,9 @@ int main(int argc, char **argv)
 		return -1;
 	}
 	seaudit_report_destroy(&report);
+	seaudit_aggregate_destroy(&aggregate);
+	seaudit_correlation_destroy(&correlation);
+	apol_policy_destroy(&policy);
 	seaudit_model_destroy(&model);
 	for (i = 0; i < apol_vector_get_size(logs); i++) {
 		seaudit_log_t *l = apol_vector_get_element(logs, i);
@@ -69,6 +69,7 @@ int attribs_wo_types_register(sechk_lib_t * lib)
 		"Module requirements:\n" "   attribute names\n" "Module dependencies:\n" "   none\n" "Module options:\n"
 		"   none\n";
 	mod->severity = SECHK_SEV_LOW;
+	mod->inputs = SECHK_INPUT_TYPES | SECHK_INPUT_ATTRIBS;
 	/* assign requirements */
 	if (apol_vector_append(mod->requirements, sechk_name_value_new(SECHK_REQ_POLICY_CAP, SECHK_REQ_CAP_ATTRIB_NAMES)) < 0) {
 		ERR(NULL, "%s", strerror(ENOMEM));
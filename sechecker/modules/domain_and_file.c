@@ -64,6 +64,7 @@ int domain_and_file_register(sechk_lib_t * lib)
 		"   file_contexts\n"
 		"Module dependencies:\n" "   find_domains module\n" "   find_file_types module\n" "Module options:\n" "   none\n";
 	mod->severity = SECHK_SEV_LOW;
+	mod->inputs = SECHK_INPUT_DEPENDENCIES;
 	/* assign requirements */
 	nv = sechk_name_value_new(SECHK_REQ_POLICY_CAP, SECHK_REQ_CAP_ATTRIB_NAMES);
 	apol_vector_append(mod->requirements, (void *)nv);
@@ -67,6 +67,7 @@ int domains_wo_roles_register(sechk_lib_t * lib)
 		"Module requirements:\n"
 		"   attribute names\n" "Module dependencies:\n" "   find_domains\n" "Module options:\n" "   none\n";
 	mod->severity = SECHK_SEV_MED;
+	mod->inputs = SECHK_INPUT_ROLES;
 	/* assign requirements */
 	apol_vector_append(mod->requirements, sechk_name_value_new(SECHK_REQ_POLICY_CAP, SECHK_REQ_CAP_ATTRIB_NAMES));
 
@@ -66,6 +66,7 @@ int find_domains_register(sechk_lib_t * lib)
 		"   attribute names\n"
 		"Module dependencies:\n" "   none\n" "Module options:\n" "   domain_attributes can be set in a profile\n";
 	mod->severity = SECHK_SEV_NONE;
+	mod->inputs = SECHK_INPUT_TYPES | SECHK_INPUT_ATTRIBS | SECHK_INPUT_ROLES | SECHK_INPUT_AVRULES | SECHK_INPUT_TERULES;
 	/* assign requirements */
 	apol_vector_append(mod->requirements, sechk_name_value_new(SECHK_REQ_POLICY_CAP, SECHK_REQ_CAP_ATTRIB_NAMES));
 
@@ -69,6 +69,7 @@ int find_net_domains_register(sechk_lib_t * lib)
 		"  Module requirements:\n" "    none\n" "  Module dependencies:\n" "    none\n" "  Module options:\n"
 		"    net_obj\n";
 	mod->severity = SECHK_SEV_NONE;
+	mod->inputs = SECHK_INPUT_TYPES | SECHK_INPUT_ATTRIBS | SECHK_INPUT_AVRULES;
 
 	/* assign default options */
 	apol_vector_append(mod->options, sechk_name_value_new("net_obj", "netif"));
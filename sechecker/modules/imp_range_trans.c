@@ -71,6 +71,8 @@ int imp_range_trans_register(sechk_lib_t * lib)
 		"  Module requirements:\n" "    MLS policy\n" "  Module dependencies:\n" "    none\n" "  Module options:\n"
 		"    none\n";
 	mod->severity = SECHK_SEV_MED;
+	mod->inputs = SECHK_INPUT_TYPES | SECHK_INPUT_ATTRIBS | SECHK_INPUT_ROLES | SECHK_INPUT_USERS | SECHK_INPUT_AVRULES |
+		SECHK_INPUT_TERULES | SECHK_INPUT_RBAC_RULES | SECHK_INPUT_MLS;
 
 	/* assign requirements */
 	if (apol_vector_append(mod->requirements, sechk_name_value_new(SECHK_REQ_POLICY_CAP, SECHK_REQ_CAP_MLS)) < 0) {
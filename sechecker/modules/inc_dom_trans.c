@@ -73,6 +73,10 @@ int inc_dom_trans_register(sechk_lib_t * lib)
 		"Module requirements:\n"
 		"   attribute names\n" "Module dependencies:\n" "   find_domains\n" "Module options:\n" "   none\n";
 	mod->severity = SECHK_SEV_MED;
+	/* domain transition analysis builds and resets the policy's table */
+	mod->mutates_policy = true;
+	mod->inputs = SECHK_INPUT_TYPES | SECHK_INPUT_ATTRIBS | SECHK_INPUT_ROLES | SECHK_INPUT_USERS | SECHK_INPUT_AVRULES |
+		SECHK_INPUT_TERULES | SECHK_INPUT_RBAC_RULES;
 	/* assign requirements */
 	if (apol_vector_append(mod->requirements, sechk_name_value_new(SECHK_REQ_POLICY_CAP, SECHK_REQ_CAP_ATTRIB_NAMES)) < 0) {
 		ERR(NULL, "%s", strerror(ENOMEM));
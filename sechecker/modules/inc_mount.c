@@ -72,6 +72,7 @@ int inc_mount_register(sechk_lib_t * lib)
 	mod->opt_description =
 		"Module requirements:\n" "   none\n" "Module dependencies:\n" "   none\n" "Module options:\n" "   none\n";
 	mod->severity = SECHK_SEV_MED;
+	mod->inputs = SECHK_INPUT_TYPES | SECHK_INPUT_ATTRIBS | SECHK_INPUT_AVRULES;
 	/* register functions */
 	fn_struct = sechk_fn_new();
 	if (!fn_struct) {
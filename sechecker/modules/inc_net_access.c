@@ -79,6 +79,7 @@ int inc_net_access_register(sechk_lib_t * lib)
 		"  Module requirements:\n"
 		"    none\n" "  Module dependencies:\n" "    find_net_domains\n" "  Module options:\n" "    none\n";
 	mod->severity = SECHK_SEV_MED;
+	mod->inputs = SECHK_INPUT_TYPES | SECHK_INPUT_ATTRIBS | SECHK_INPUT_AVRULES;
 	/* assign dependencies */
 	if (apol_vector_append(mod->dependencies, sechk_name_value_new("module", "find_net_domains")) < 0) {
 		ERR(NULL, "%s", strerror(ENOMEM));
@@ -1304,7 +1305,6 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 	sechk_mod_fn_t run_fn = NULL;
 	size_t i = 0, j = 0;
 	int error = 0;
-	apol_avrule_query_t *avrule_query = NULL;
 	apol_vector_t *avrule_vector = NULL, *net_domain_vector = NULL;
 	const qpol_type_t *net_domain = NULL, *tmp_type = NULL;
 	const char *net_domain_name = NULL, *tgt_name = NULL;
@@ -1363,14 +1363,6 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 	}
 	net_domain_vector = (apol_vector_t *) net_domain_res->items;
 
-	avrule_query = apol_avrule_query_create();
-	if (!avrule_query) {
-		error = errno;
-		ERR(policy, "%s", strerror(error));
-		goto inc_net_access_run_fail;
-	}
-	apol_avrule_query_set_rules(policy, avrule_query, QPOL_RULE_ALLOW);
-
 	for (i = 0; i < apol_vector_get_size(net_domain_vector); i++) {
 		tmp_item = apol_vector_get_element(net_domain_vector, i);
 		net_domain = tmp_item->item;
@@ -1378,11 +1370,10 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 		state = net_state_create();
 
 		/* find any self sock_file perms */
-		apol_avrule_query_set_source(policy, avrule_query, net_domain_name, 1);
-		apol_avrule_query_set_target(policy, avrule_query, net_domain_name, 1);
-		apol_avrule_query_append_class(policy, avrule_query, NULL);
-		apol_avrule_query_append_class(policy, avrule_query, "sock_file");
-		apol_avrule_get_by_query(policy, avrule_query, &avrule_vector);
+		if (sechk_lib_get_avrules(mod->parent_lib, QPOL_RULE_ALLOW, net_domain, net_domain, "sock_file", &avrule_vector) < 0) {
+			error = errno;
+			goto inc_net_access_run_fail;
+		}
 		for (j = 0; j < apol_vector_get_size(avrule_vector); j++) {
 			rule = apol_vector_get_element(avrule_vector, j);
 			qpol_avrule_get_perm_iter(q, rule, &iter);
@@ -1403,9 +1394,10 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 		apol_vector_destroy(&avrule_vector);
 
 		/* find any self tcp_socket perms */
-		apol_avrule_query_append_class(policy, avrule_query, NULL);
-		apol_avrule_query_append_class(policy, avrule_query, "tcp_socket");
-		apol_avrule_get_by_query(policy, avrule_query, &avrule_vector);
+		if (sechk_lib_get_avrules(mod->parent_lib, QPOL_RULE_ALLOW, net_domain, net_domain, "tcp_socket", &avrule_vector) < 0) {
+			error = errno;
+			goto inc_net_access_run_fail;
+		}
 		for (j = 0; j < apol_vector_get_size(avrule_vector); j++) {
 			rule = apol_vector_get_element(avrule_vector, j);
 			qpol_avrule_get_perm_iter(q, rule, &iter);
@@ -1426,9 +1418,10 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 		apol_vector_destroy(&avrule_vector);
 
 		/* find any self udp_socket perms */
-		apol_avrule_query_append_class(policy, avrule_query, NULL);
-		apol_avrule_query_append_class(policy, avrule_query, "udp_socket");
-		apol_avrule_get_by_query(policy, avrule_query, &avrule_vector);
+		if (sechk_lib_get_avrules(mod->parent_lib, QPOL_RULE_ALLOW, net_domain, net_domain, "udp_socket", &avrule_vector) < 0) {
+			error = errno;
+			goto inc_net_access_run_fail;
+		}
 		for (j = 0; j < apol_vector_get_size(avrule_vector); j++) {
 			rule = apol_vector_get_element(avrule_vector, j);
 			qpol_avrule_get_perm_iter(q, rule, &iter);
@@ -1449,10 +1442,10 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 		apol_vector_destroy(&avrule_vector);
 
 		/* find any if_t netif perms */
-		apol_avrule_query_set_target(policy, avrule_query, NULL, 0);
-		apol_avrule_query_append_class(policy, avrule_query, NULL);
-		apol_avrule_query_append_class(policy, avrule_query, "netif");
-		apol_avrule_get_by_query(policy, avrule_query, &avrule_vector);
+		if (sechk_lib_get_avrules(mod->parent_lib, QPOL_RULE_ALLOW, net_domain, NULL, "netif", &avrule_vector) < 0) {
+			error = errno;
+			goto inc_net_access_run_fail;
+		}
 		for (j = 0; j < apol_vector_get_size(avrule_vector); j++) {
 			rule = apol_vector_get_element(avrule_vector, j);
 			qpol_avrule_get_target_type(q, rule, &tmp_type);
@@ -1481,9 +1474,10 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 		apol_vector_destroy(&avrule_vector);
 
 		/* find any node_t node perms */
-		apol_avrule_query_append_class(policy, avrule_query, NULL);
-		apol_avrule_query_append_class(policy, avrule_query, "node");
-		apol_avrule_get_by_query(policy, avrule_query, &avrule_vector);
+		if (sechk_lib_get_avrules(mod->parent_lib, QPOL_RULE_ALLOW, net_domain, NULL, "node", &avrule_vector) < 0) {
+			error = errno;
+			goto inc_net_access_run_fail;
+		}
 		for (j = 0; j < apol_vector_get_size(avrule_vector); j++) {
 			rule = apol_vector_get_element(avrule_vector, j);
 			qpol_avrule_get_target_type(q, rule, &tmp_type);
@@ -1512,9 +1506,10 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 		apol_vector_destroy(&avrule_vector);
 
 		/* find any port_t tcp_socket perms */
-		apol_avrule_query_append_class(policy, avrule_query, NULL);
-		apol_avrule_query_append_class(policy, avrule_query, "tcp_socket");
-		apol_avrule_get_by_query(policy, avrule_query, &avrule_vector);
+		if (sechk_lib_get_avrules(mod->parent_lib, QPOL_RULE_ALLOW, net_domain, NULL, "tcp_socket", &avrule_vector) < 0) {
+			error = errno;
+			goto inc_net_access_run_fail;
+		}
 		for (j = 0; j < apol_vector_get_size(avrule_vector); j++) {
 			rule = apol_vector_get_element(avrule_vector, j);
 			qpol_avrule_get_target_type(q, rule, &tmp_type);
@@ -1540,9 +1535,10 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 		apol_vector_destroy(&avrule_vector);
 
 		/* find any port_t udp_socket perms */
-		apol_avrule_query_append_class(policy, avrule_query, NULL);
-		apol_avrule_query_append_class(policy, avrule_query, "udp_socket");
-		apol_avrule_get_by_query(policy, avrule_query, &avrule_vector);
+		if (sechk_lib_get_avrules(mod->parent_lib, QPOL_RULE_ALLOW, net_domain, NULL, "udp_socket", &avrule_vector) < 0) {
+			error = errno;
+			goto inc_net_access_run_fail;
+		}
 		for (j = 0; j < apol_vector_get_size(avrule_vector); j++) {
 			rule = apol_vector_get_element(avrule_vector, j);
 			qpol_avrule_get_target_type(q, rule, &tmp_type);
@@ -1568,9 +1564,10 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 		apol_vector_destroy(&avrule_vector);
 
 		/* find any assoc_t association perms */
-		apol_avrule_query_append_class(policy, avrule_query, NULL);
-		apol_avrule_query_append_class(policy, avrule_query, "association");
-		apol_avrule_get_by_query(policy, avrule_query, &avrule_vector);
+		if (sechk_lib_get_avrules(mod->parent_lib, QPOL_RULE_ALLOW, net_domain, NULL, "association", &avrule_vector) < 0) {
+			error = errno;
+			goto inc_net_access_run_fail;
+		}
 		for (j = 0; j < apol_vector_get_size(avrule_vector); j++) {
 			rule = apol_vector_get_element(avrule_vector, j);
 			qpol_avrule_get_target_type(q, rule, &tmp_type);
@@ -1764,7 +1761,6 @@ int inc_net_access_run(sechk_module_t * mod, apol_policy_t * policy, void *arg _
 	return 0;
 
       inc_net_access_run_fail:
-	apol_avrule_query_destroy(&avrule_query);
 	apol_vector_destroy(&avrule_vector);
 	qpol_iterator_destroy(&iter);
 	free(perm_name);
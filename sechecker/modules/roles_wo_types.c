@@ -67,6 +67,7 @@ int roles_wo_types_register(sechk_lib_t * lib)
 	mod->opt_description =
 		"Module requirements:\n" "   none\n" "Module dependencies:\n" "   none\n" "Module options:\n" "   none\n";
 	mod->severity = SECHK_SEV_LOW;
+	mod->inputs = SECHK_INPUT_ROLES;
 	/* register functions */
 	fn_struct = sechk_fn_new();
 	if (!fn_struct) {
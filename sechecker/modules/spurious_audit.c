@@ -76,6 +76,7 @@ int spurious_audit_register(sechk_lib_t * lib)
 	mod->opt_description =
 		"  Module requirements:\n" "    none\n" "  Module dependencies:\n" "    none\n" "  Module options:\n" "    none\n";
 	mod->severity = SECHK_SEV_LOW;
+	mod->inputs = SECHK_INPUT_TYPES | SECHK_INPUT_ATTRIBS | SECHK_INPUT_CLASSES | SECHK_INPUT_AVRULES;
 
 	/* register functions */
 	fn_struct = sechk_fn_new();
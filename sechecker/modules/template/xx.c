@@ -79,6 +79,10 @@ int xx_register(sechk_lib_t * lib)
 	mod->opt_description =
 		"  Module requirements:\n" "    none\n" "  Module dependencies:\n" "    none\n" "  Module options:\n" "    none\n";
 	mod->severity = "TODO: set proper severity";
+	/* TODO: declare the policy components the run function reads
+	 * (SECHK_INPUT_*); modules declaring none are always re-run
+	 * instead of reusing baseline results */
+	mod->inputs = 0;
 
 	/* TODO: assign default options (remove if none)
 	 * fill name and value and repeat as needed */
@@ -203,6 +207,11 @@ int xx_init(sechk_module_t * mod, apol_policy_t * policy, void *arg __attribute_
  * even if called multiple times. All test logic should be placed below
  * as instructed. This function allocates the result structure and fills
  * in all relavant item and proof data. 
+ * Modules without a dependency between them may run concurrently, so
+ * this function must not modify any other module.  If it modifies the
+ * policy (for example, through a domain transition analysis), set
+ * mod->mutates_policy in the register function so that the module is
+ * run alone.
  * Return Values:
  *  -1 System error
  *   0 The module "succeeded"	- no negative results found
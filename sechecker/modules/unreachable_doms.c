@@ -84,6 +84,8 @@ int unreachable_doms_register(sechk_lib_t * lib)
 #endif
 		"  Module dependencies:\n" "    find_domains module\n" "  Module options:\n" "    none\n";
 	mod->severity = SECHK_SEV_MED;
+	/* domain transition analysis builds and resets the policy's table */
+	mod->mutates_policy = true;
 
 	/* assign requirements */
 	if (apol_vector_append(mod->requirements, sechk_name_value_new(SECHK_REQ_POLICY_CAP, SECHK_REQ_CAP_ATTRIB_NAMES)) < 0) {
@@ -29,6 +29,7 @@
 #include <assert.h>
 #include <dirent.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -93,6 +94,22 @@ static int sechk_lib_compare_sev(const char *a, const char *b)
 	return aval < bval ? -1 : 1;
 }
 
+int sechk_lib_set_num_jobs(size_t num_jobs, sechk_lib_t * lib)
+{
+	long num_cpus;
+
+	if (lib == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (num_jobs == 0) {
+		num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		num_jobs = (num_cpus > 0 ? (size_t) num_cpus : 1);
+	}
+	lib->num_jobs = num_jobs;
+	return 0;
+}
+
 int sechk_lib_set_minsev(const char *minsev, sechk_lib_t * lib)
 {
 	if (lib == NULL || lib->policy == NULL || minsev == NULL) {
@@ -193,6 +210,7 @@ sechk_lib_t *sechk_lib_new(void)
 	/* set the default output format */
 	lib->outputformat = SECHK_OUT_SHORT;
 	lib->minsev = SECHK_SEV_LOW;
+	sechk_lib_set_num_jobs(0, lib);
 
 	/* register modules */
 	if ((retv = sechk_lib_register_modules(reg_list, lib)) != 0) {
@@ -210,12 +228,15 @@ sechk_lib_t *sechk_lib_new(void)
 	goto exit;
 }
 
+static void sechk_rule_index_destroy(sechk_rule_index_t ** idx);
+
 void sechk_lib_destroy(sechk_lib_t ** lib)
 {
 	if (lib == NULL || *lib == NULL)
 		return;
 
 	apol_vector_destroy(&((*lib)->modules));
+	sechk_rule_index_destroy(&((*lib)->rule_index));
 	apol_policy_destroy(&((*lib)->policy));
 	apol_vector_destroy(&((*lib)->fc_entries));
 	free((*lib)->fc_path);
@@ -379,6 +400,51 @@ sechk_proof_t *sechk_proof_new(free_fn_t fn)
 	return proof;
 }
 
+struct sechk_rule_index
+{
+	/** all AV rules, of every rule type */
+	apol_avrule_index_t *avrules;
+};
+
+static void sechk_rule_index_destroy(sechk_rule_index_t ** idx)
+{
+	if (idx == NULL || *idx == NULL)
+		return;
+	apol_avrule_index_destroy(&(*idx)->avrules);
+	free(*idx);
+	*idx = NULL;
+}
+
+/**
+ *  Build the shared rule index for a library's policy.  Policies
+ *  without rules loaded get no index.
+ */
+static int sechk_lib_build_rule_index(sechk_lib_t * lib)
+{
+	sechk_rule_index_t *idx = NULL;
+	int error = 0;
+
+	if (!qpol_policy_has_capability(apol_policy_get_qpol(lib->policy), QPOL_CAP_RULES_LOADED))
+		return 0;
+	if (!(idx = calloc(1, sizeof(*idx)))) {
+		error = errno;
+		ERR(lib->policy, "%s", strerror(error));
+		goto err;
+	}
+	if (!(idx->avrules = apol_avrule_index_create(lib->policy, QPOL_RULE_ALLOW | QPOL_RULE_NEVERALLOW |
+						      QPOL_RULE_AUDITALLOW | QPOL_RULE_DONTAUDIT))) {
+		error = errno;
+		goto err;
+	}
+	lib->rule_index = idx;
+	return 0;
+
+      err:
+	sechk_rule_index_destroy(&idx);
+	errno = error;
+	return -1;
+}
+
 int sechk_lib_load_policy(apol_policy_path_t * policy_mods, sechk_lib_t * lib)
 {
 
@@ -416,6 +482,10 @@ int sechk_lib_load_policy(apol_policy_path_t * policy_mods, sechk_lib_t * lib)
 			goto err;
 		}
 	}
+	if (sechk_lib_build_rule_index(lib) < 0) {
+		fprintf(stderr, "Error: failed indexing policy rules: %s\n", strerror(errno));
+		goto err;
+	}
 	return 0;
 
       err:
@@ -423,6 +493,65 @@ int sechk_lib_load_policy(apol_policy_path_t * policy_mods, sechk_lib_t * lib)
 	return -1;
 }
 
+int sechk_lib_get_avrules(const sechk_lib_t * lib, uint32_t rule_type, const qpol_type_t * source, const qpol_type_t * target,
+			  const char *class_name, apol_vector_t ** v)
+{
+	qpol_policy_t *q;
+	const qpol_class_t *obj_class = NULL;
+	const qpol_avrule_t *rule;
+	apol_vector_t *matches = NULL;
+	uint32_t rt;
+	size_t i;
+	int error = 0;
+
+	if (v != NULL)
+		*v = NULL;
+	if (!lib || !lib->policy || !source || !v) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!lib->rule_index) {
+		ERR(lib->policy, "%s", "Policy does not have rules loaded.");
+		errno = ENOTSUP;
+		return -1;
+	}
+	q = apol_policy_get_qpol(lib->policy);
+	if (!(*v = apol_vector_create(NULL)) || !(matches = apol_vector_create(NULL))) {
+		error = errno;
+		ERR(lib->policy, "%s", strerror(error));
+		goto err;
+	}
+	if (class_name && qpol_policy_get_class_by_name(q, class_name, &obj_class) < 0) {
+		/* class is not within this policy, so nothing matches */
+		apol_vector_destroy(&matches);
+		return 0;
+	}
+	if (apol_avrule_index_get_rules(lib->rule_index->avrules, source, target, obj_class, NULL, matches) < 0) {
+		error = errno;
+		goto err;
+	}
+	for (i = 0; i < apol_vector_get_size(matches); i++) {
+		rule = apol_vector_get_element(matches, i);
+		if (qpol_avrule_get_rule_type(q, rule, &rt) < 0) {
+			error = errno;
+			goto err;
+		}
+		if ((rt & rule_type) && apol_vector_append(*v, (void *)rule) < 0) {
+			error = errno;
+			ERR(lib->policy, "%s", strerror(error));
+			goto err;
+		}
+	}
+	apol_vector_destroy(&matches);
+	return 0;
+
+      err:
+	apol_vector_destroy(&matches);
+	apol_vector_destroy(v);
+	errno = error;
+	return -1;
+}
+
 int sechk_lib_load_fc(const char *fcfilelocation, sechk_lib_t * lib)
 {
 	int error = 0;
@@ -581,7 +710,6 @@ sechk_result_t *sechk_lib_get_module_result(const char *module_name, const sechk
 {
 	size_t i;
 	sechk_module_t *mod = NULL;
-	sechk_mod_fn_t run = NULL;
 
 	if (!module_name || !lib) {
 		fprintf(stderr, "Error: failed to get module result\n");
@@ -596,8 +724,7 @@ sechk_result_t *sechk_lib_get_module_result(const char *module_name, const sechk
 		if (strcmp(mod->name, module_name))
 			continue;
 		if (!(mod->result)) {
-			if (!(run = sechk_lib_get_module_function(module_name, SECHK_MOD_FN_RUN, lib)) ||
-			    run(mod, lib->policy, NULL) < 0) {
+			if (sechk_lib_run_module(mod, lib) < 0) {
 				return NULL;	/* run or get function will set errno */
 			}
 		}
@@ -734,24 +861,179 @@ int sechk_lib_init_modules(sechk_lib_t * lib)
 	return 0;
 }
 
+int sechk_lib_run_module(sechk_module_t * mod, const sechk_lib_t * lib)
+{
+	sechk_mod_fn_t run_fn = NULL;
+
+	if (!mod || !lib) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (mod->run_done)
+		return mod->run_retv;
+	assert(mod->name);
+	run_fn = sechk_lib_get_module_function(mod->name, SECHK_MOD_FN_RUN, lib);
+	if (!run_fn) {
+		ERR(lib->policy, "Could not run module %s.", mod->name);
+		errno = ENOTSUP;
+		return -1;
+	}
+	mod->run_retv = run_fn(mod, lib->policy, NULL);
+	mod->run_done = true;
+	return mod->run_retv;
+}
+
+/** State shared by all threads running modules. */
+typedef struct sechk_run_state
+{
+	sechk_lib_t *lib;
+	pthread_mutex_t lock;
+	/** signalled whenever a module is queued or finishes */
+	pthread_cond_t cond;
+	/** held for reading by each running module, and for writing by a
+	 *  running module that modifies the policy */
+	pthread_rwlock_t policy_lock;
+	/** for each module, number of its dependencies not yet finished */
+	size_t *pending;
+	/** for each module, vector of indices of modules depending on it */
+	apol_vector_t **dependents;
+	/** FIFO of indices of modules ready to run */
+	size_t *queue;
+	size_t queue_head, queue_tail;
+	/** number of scheduled modules that have not yet finished */
+	size_t remaining;
+	/** set to stop dispatching further modules */
+	bool stop;
+	int rc;
+} sechk_run_state_t;
+
+/**
+ *  Worker loop: repeatedly take a ready module from the queue, run it,
+ *  and queue those dependents whose dependencies have all finished.
+ *  Returns once all scheduled modules have finished or running has
+ *  been stopped.
+ */
+static void *sechk_lib_run_worker(void *arg)
+{
+	sechk_run_state_t *state = arg;
+	sechk_lib_t *lib = state->lib;
+	sechk_module_t *mod;
+	size_t idx, i, dep_idx;
+	int retv;
+
+	pthread_mutex_lock(&state->lock);
+	for (;;) {
+		while (!state->stop && state->remaining > 0 && state->queue_head == state->queue_tail)
+			pthread_cond_wait(&state->cond, &state->lock);
+		if (state->stop || state->remaining == 0)
+			break;
+		idx = state->queue[state->queue_head++];
+		pthread_mutex_unlock(&state->lock);
+
+		mod = apol_vector_get_element(lib->modules, idx);
+		if (mod->mutates_policy)
+			pthread_rwlock_wrlock(&state->policy_lock);
+		else
+			pthread_rwlock_rdlock(&state->policy_lock);
+		retv = sechk_lib_run_module(mod, lib);
+		pthread_rwlock_unlock(&state->policy_lock);
+
+		pthread_mutex_lock(&state->lock);
+		if (retv < 0) {
+			/* module failure */
+			/* only put output failures if we are not in quiet mode */
+			if (lib->outputformat & ~(SECHK_OUT_QUIET))
+				ERR(lib->policy, "Module %s failed.", mod->name);
+			state->rc = -1;
+		} else if (retv > 0) {
+			/* a module looking for policy errors has found one
+			 * if in quiet mode stop since running additional
+			 * modules will not change the return code */
+			if (lib->outputformat & (SECHK_OUT_QUIET)) {
+				state->stop = true;
+				state->rc = -1;
+			}
+		}
+		for (i = 0; i < apol_vector_get_size(state->dependents[idx]); i++) {
+			dep_idx = (size_t) apol_vector_get_element(state->dependents[idx], i);
+			if (--state->pending[dep_idx] == 0)
+				state->queue[state->queue_tail++] = dep_idx;
+		}
+		state->remaining--;
+		pthread_cond_broadcast(&state->cond);
+	}
+	pthread_cond_broadcast(&state->cond);
+	pthread_mutex_unlock(&state->lock);
+	return NULL;
+}
+
+/**
+ *  Check that every scheduled module will eventually become ready, by
+ *  simulating the schedule on a copy of the pending counts.
+ *
+ *  @return 0 if the dependency graph is acyclic, or < 0 if it has a
+ *  cycle (errno will be ELOOP) or upon error.
+ */
+static int sechk_run_state_check_cycles(const sechk_run_state_t * state, size_t num_modules)
+{
+	size_t *pending = NULL, *queue = NULL, head = 0, tail = state->queue_tail, i, idx, dep_idx;
+
+	if (!(pending = malloc(num_modules * sizeof(*pending))) || !(queue = malloc(num_modules * sizeof(*queue)))) {
+		free(pending);
+		errno = ENOMEM;
+		return -1;
+	}
+	memcpy(pending, state->pending, num_modules * sizeof(*pending));
+	memcpy(queue, state->queue, tail * sizeof(*queue));
+	while (head < tail) {
+		idx = queue[head++];
+		for (i = 0; i < apol_vector_get_size(state->dependents[idx]); i++) {
+			dep_idx = (size_t) apol_vector_get_element(state->dependents[idx], i);
+			if (--pending[dep_idx] == 0)
+				queue[tail++] = dep_idx;
+		}
+	}
+	free(pending);
+	free(queue);
+	if (tail != state->remaining) {
+		errno = ELOOP;
+		return -1;
+	}
+	return 0;
+}
+
 int sechk_lib_run_modules(sechk_lib_t * lib)
 {
-	int retv, num_selected = 0, rc = 0;
-	size_t i;
+	int num_selected = 0, idx, rc = -1, error = 0;
+	size_t i, j, pos, num_modules, num_threads = 0, num_started = 0;
+	bool *scheduled = NULL, changed;
+	pthread_t *threads = NULL;
 	sechk_module_t *mod = NULL;
-	sechk_mod_fn_t run_fn = NULL;
+	sechk_name_value_t *nv = NULL;
+	sechk_run_state_t state;
 
 	if (!lib) {
 		fprintf(stderr, "Error: invalid library\n");
 		errno = EINVAL;
 		return -1;
 	}
-	for (i = 0; i < apol_vector_get_size(lib->modules); i++) {
+	memset(&state, 0, sizeof(state));
+	state.lib = lib;
+	num_modules = apol_vector_get_size(lib->modules);
+	for (i = 0; i < num_modules; i++) {
 		mod = apol_vector_get_element(lib->modules, i);
 		if (mod->selected)
 			num_selected++;
 	}
-	for (i = 0; i < apol_vector_get_size(lib->modules); i++) {
+	if (!(scheduled = calloc(num_modules, sizeof(*scheduled))) ||
+	    !(state.pending = calloc(num_modules, sizeof(*state.pending))) ||
+	    !(state.dependents = calloc(num_modules, sizeof(*state.dependents))) ||
+	    !(state.queue = calloc(num_modules, sizeof(*state.queue)))) {
+		error = errno;
+		ERR(lib->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	for (i = 0; i < num_modules; i++) {
 		mod = apol_vector_get_element(lib->modules, i);
 		/* if module is "off" do not run */
 		if (!mod->selected)
@@ -759,29 +1041,122 @@ int sechk_lib_run_modules(sechk_lib_t * lib)
 		/* if module is below the minsev do not run unless its exactly one module */
 		if (lib->minsev && sechk_lib_compare_sev(mod->severity, lib->minsev) < 0 && num_selected != 1)
 			continue;
-		assert(mod->name);
-		run_fn = sechk_lib_get_module_function(mod->name, SECHK_MOD_FN_RUN, lib);
-		if (!run_fn) {
-			ERR(lib->policy, "Could not run module %s.", mod->name);
-			errno = ENOTSUP;
-			return -1;
+		scheduled[i] = true;
+	}
+	/* modules needed by a scheduled module must also be scheduled,
+	 * regardless of their severity */
+	do {
+		changed = false;
+		for (i = 0; i < num_modules; i++) {
+			if (!scheduled[i])
+				continue;
+			mod = apol_vector_get_element(lib->modules, i);
+			for (j = 0; j < apol_vector_get_size(mod->dependencies); j++) {
+				nv = apol_vector_get_element(mod->dependencies, j);
+				if ((idx = sechk_lib_get_module_idx(nv->value, lib)) < 0) {
+					error = ENOENT;
+					ERR(lib->policy, "Dependency %s not found for %s.", nv->value, mod->name);
+					goto cleanup;
+				}
+				if (!scheduled[idx]) {
+					scheduled[idx] = true;
+					changed = true;
+				}
+			}
 		}
-		retv = run_fn(mod, lib->policy, NULL);
+	} while (changed);
 
-		if (retv < 0) {
-			/* module failure */
-			/* only put output failures if we are not in quiet mode */
-			if (lib->outputformat & ~(SECHK_OUT_QUIET))
-				ERR(lib->policy, "Module %s failed.", mod->name);
-			rc = -1;
-		} else if (retv > 0) {
-			/* a module looking for policy errors has found one
-			 * if in quiet mode stop since running additional
-			 * modules will not change the return code */
-			if (lib->outputformat & (SECHK_OUT_QUIET))
-				return -1;
+	/* build the dependency graph */
+	for (i = 0; i < num_modules; i++) {
+		if (!scheduled[i])
+			continue;
+		if (!(state.dependents[i] = apol_vector_create(NULL))) {
+			error = errno;
+			ERR(lib->policy, "%s", strerror(error));
+			goto cleanup;
+		}
+	}
+	for (i = 0; i < num_modules; i++) {
+		if (!scheduled[i])
+			continue;
+		state.remaining++;
+		mod = apol_vector_get_element(lib->modules, i);
+		for (j = 0; j < apol_vector_get_size(mod->dependencies); j++) {
+			nv = apol_vector_get_element(mod->dependencies, j);
+			idx = sechk_lib_get_module_idx(nv->value, lib);
+			if (apol_vector_get_index(state.dependents[idx], (void *)i, NULL, NULL, &pos) == 0)
+				continue;	/* duplicate dependency */
+			if (apol_vector_append(state.dependents[idx], (void *)i) < 0) {
+				error = errno;
+				ERR(lib->policy, "%s", strerror(error));
+				goto cleanup;
+			}
+			state.pending[i]++;
 		}
+		if (state.pending[i] == 0)
+			state.queue[state.queue_tail++] = i;
+	}
+
+	if (sechk_run_state_check_cycles(&state, num_modules) < 0) {
+		error = errno;
+		ERR(lib->policy, "%s", error == ELOOP ? "Module dependencies are circular." : strerror(error));
+		goto cleanup;
+	}
+
+	if (pthread_mutex_init(&state.lock, NULL) != 0) {
+		error = errno;
+		ERR(lib->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	if (pthread_cond_init(&state.cond, NULL) != 0) {
+		error = errno;
+		pthread_mutex_destroy(&state.lock);
+		ERR(lib->policy, "%s", strerror(error));
+		goto cleanup;
 	}
+	if (pthread_rwlock_init(&state.policy_lock, NULL) != 0) {
+		error = errno;
+		pthread_cond_destroy(&state.cond);
+		pthread_mutex_destroy(&state.lock);
+		ERR(lib->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+	/* the calling thread is itself a worker, so start one fewer */
+	num_threads = lib->num_jobs;
+	if (num_threads > state.remaining)
+		num_threads = state.remaining;
+	if (num_threads > 1) {
+		if (!(threads = calloc(num_threads - 1, sizeof(*threads)))) {
+			error = errno;
+			ERR(lib->policy, "%s", strerror(error));
+		}
+		for (num_started = 0; threads != NULL && num_started < num_threads - 1; num_started++) {
+			if (pthread_create(threads + num_started, NULL, sechk_lib_run_worker, &state) != 0) {
+				/* fall back to however many threads did start */
+				break;
+			}
+		}
+	}
+	sechk_lib_run_worker(&state);
+	for (i = 0; i < num_started; i++)
+		pthread_join(threads[i], NULL);
+	pthread_rwlock_destroy(&state.policy_lock);
+	pthread_cond_destroy(&state.cond);
+	pthread_mutex_destroy(&state.lock);
+	rc = state.rc;
+
+      cleanup:
+	if (state.dependents) {
+		for (i = 0; i < num_modules; i++)
+			apol_vector_destroy(&state.dependents[i]);
+	}
+	free(state.dependents);
+	free(state.pending);
+	free(state.queue);
+	free(scheduled);
+	free(threads);
+	if (error)
+		errno = error;
 	return rc;
 }
 
@@ -107,6 +107,25 @@ extern "C"
 /** Require that the running system supports MLS*/
 #define SECHK_REQ_SYS_MLS     "mls"
 
+/* module input flags: the parts of the policy and system from which a
+ * module computes its results, used to decide whether cached results
+ * from a previous run are still valid (see sechk_lib_load_baseline()).
+ * A module declaring no inputs is always re-run. */
+#define SECHK_INPUT_TYPES         0x0001	/**< type declarations */
+#define SECHK_INPUT_ATTRIBS       0x0002	/**< attributes and their types */
+#define SECHK_INPUT_ROLES         0x0004	/**< roles and their types */
+#define SECHK_INPUT_USERS         0x0008	/**< users and their roles and ranges */
+#define SECHK_INPUT_BOOLS         0x0010	/**< boolean default values */
+#define SECHK_INPUT_CLASSES       0x0020	/**< object classes and commons */
+#define SECHK_INPUT_AVRULES       0x0040	/**< allow, auditallow, dontaudit, and neverallow rules */
+#define SECHK_INPUT_TERULES       0x0080	/**< type_transition, type_change, and type_member rules */
+#define SECHK_INPUT_RBAC_RULES    0x0100	/**< role allow and role_transition rules */
+#define SECHK_INPUT_MLS           0x0200	/**< levels, categories, and range_transition rules */
+#define SECHK_INPUT_FILE_CONTEXTS 0x0400	/**< the file_contexts file */
+/** Set by modules whose results derive only from their dependencies'
+ *  results (or that have no other inputs than those listed above). */
+#define SECHK_INPUT_DEPENDENCIES  0x8000
+
 /** item and proof element types to denote casting of the void pointer */
 	typedef enum sechk_item_type
 	{
@@ -199,6 +218,11 @@ extern "C"
 		char *value;
 	} sechk_name_value_t;
 
+/** Index of the policy's AV rules, shared by all modules.
+ *  This is built once when the policy is loaded and is read-only
+ *  thereafter; see sechk_lib_get_avrules(). */
+	typedef struct sechk_rule_index sechk_rule_index_t;
+
 /** Module library:
  *  This structure tracks all modules that SEChecker can run,
  *  the policy, and other policy related data. */
@@ -222,6 +246,11 @@ extern "C"
 		apol_policy_path_t *policy_path;
 	/** Minimum severity level specified for the report. */
 		const char *minsev;
+	/** Maximum number of modules to run concurrently. */
+		size_t num_jobs;
+	/** Shared index of the policy's rules, or NULL if the policy
+	 *  has no rules loaded. */
+		sechk_rule_index_t *rule_index;
 	} sechk_lib_t;
 
 	typedef struct sechk_module
@@ -264,6 +293,20 @@ extern "C"
 		free_fn_t data_free;
 	/** Pointer to the module's parent library. */
 		const sechk_lib_t *parent_lib;
+	/** Set by the library once the module's run function has been
+	 *  called, so that it is never called twice. */
+		bool run_done;
+	/** Value returned by the module's run function, valid only if
+	 *  run_done is set. */
+		int run_retv;
+	/** Set by the module's register function if its run function
+	 *  modifies the policy (for example, by building or resetting the
+	 *  domain transition table); such a module never runs alongside
+	 *  another. */
+		bool mutates_policy;
+	/** Bit-wise or'ed set of SECHK_INPUT_* values declaring what the
+	 *  module's run function reads; set by its register function. */
+		unsigned int inputs;
 	} sechk_module_t;
 
 /* Module function signatures */
@@ -503,6 +546,12 @@ extern "C"
 
 /**
  *  Run all selected modules. The modules must have been initialized.
+ *  Modules are scheduled according to their dependencies: a module
+ *  starts only after all of the modules upon which it depends have
+ *  finished, and modules that do not depend upon each other may run
+ *  concurrently, up to the library's number of jobs.  Modules share
+ *  the library's policy; a module that modifies it must set
+ *  mutates_policy, and is then run while no other module runs.
  *
  *  @param lib The library containing the modules to run.
  *
@@ -511,6 +560,51 @@ extern "C"
  */
 	int sechk_lib_run_modules(sechk_lib_t * lib);
 
+/**
+ *  Run a single module unless it has already been run, in which case
+ *  return the value from that previous run.
+ *
+ *  @param mod The module to run.
+ *  @param lib The library containing the module.
+ *
+ *  @return The value returned by the module's run function: 0 on
+ *  success, > 0 if the module found results, or < 0 on error.
+ */
+	int sechk_lib_run_module(sechk_module_t * mod, const sechk_lib_t * lib);
+
+/**
+ *  Find AV rules using the library's shared rule index.  This is
+ *  equivalent to apol_avrule_get_by_query() with the source and target
+ *  set as indirect (i.e., a type also matches rules for the attributes
+ *  containing it), but does not scan every rule within the policy.
+ *
+ *  @param lib The library whose policy to search.
+ *  @param rule_type Bit-wise or'ed set of QPOL_RULE_* values.
+ *  @param source Source type or attribute.
+ *  @param target Target type or attribute, or NULL for any target.
+ *  @param class_name Object class name, or NULL for any class.
+ *  @param v Reference to a vector to allocate and fill with
+ *  qpol_avrule_t pointers.  The caller must call apol_vector_destroy()
+ *  afterwards.  If the class does not exist the vector will be empty.
+ *
+ *  @return 0 on success or < 0 on error; if the call fails, errno will
+ *  be set and *v will be NULL.
+ */
+	int sechk_lib_get_avrules(const sechk_lib_t * lib, uint32_t rule_type, const qpol_type_t * source, const qpol_type_t * target,
+				  const char *class_name, apol_vector_t ** v);
+
+/**
+ *  Set the maximum number of modules to run concurrently.
+ *
+ *  @param num_jobs Number of modules; 0 means to use the number of
+ *  online processors.
+ *  @param lib The library to modify.
+ *
+ *  @return 0 on success or < 0 on error; if the call fails, errno will
+ *  be set.
+ */
+	int sechk_lib_set_num_jobs(size_t num_jobs, sechk_lib_t * lib);
+
 /**
  *  Print a report of all selected modules' results to stdout.
  *  Modules must have been run.
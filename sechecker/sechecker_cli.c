@@ -24,8 +24,10 @@
 #include <config.h>
 
 #include "sechecker.h"
+#include "sechk_results.h"
 #include "register_list.h"
 #include <apol/policy.h>
+#include <poldiff/poldiff.h>
 
 #include <stdio.h>
 #include <string.h>
@@ -38,7 +40,7 @@ extern sechk_module_name_reg_t sechk_register_list[];
 
 enum opt_values
 {
-	OPT_FCFILE = 256, OPT_MIN_SEV
+	OPT_FCFILE = 256, OPT_MIN_SEV, OPT_BASELINE, OPT_BASELINE_POLICY, OPT_SAVE_RESULTS
 };
 
 /* command line options struct */
@@ -53,6 +55,10 @@ static struct option const longopts[] = {
 	{"fcfile", required_argument, NULL, OPT_FCFILE},
 	{"module", required_argument, NULL, 'm'},
 	{"min-sev", required_argument, NULL, OPT_MIN_SEV},
+	{"jobs", required_argument, NULL, 'j'},
+	{"baseline", required_argument, NULL, OPT_BASELINE},
+	{"baseline-policy", required_argument, NULL, OPT_BASELINE_POLICY},
+	{"save-results", required_argument, NULL, OPT_SAVE_RESULTS},
 	{NULL, 0, NULL, 0}
 };
 
@@ -77,6 +83,13 @@ void usage(const char *arg0, bool brief)
 		printf("   -s, --short                  print short output\n");
 		printf("   -v, --verbose                print verbose output\n");
 		printf("   --min-sev={low|med|high}     set the minimum severity to report\n");
+		printf("   -j N, --jobs=N               run up to N modules at once\n");
+		printf("                                (default is the number of processors)\n");
+		printf("\n");
+		printf("   --save-results=FILE          save module results to FILE\n");
+		printf("   --baseline=FILE              reuse results saved for a baseline policy\n");
+		printf("                                where unaffected by policy changes\n");
+		printf("   --baseline-policy=POLICY     baseline policy for --baseline\n");
 		printf("\n");
 		printf("   -l, --list                   print a list of profiles and modules and exit\n");
 		printf("   -h[MODULE], --help[=MODULE]  print this help text or help for MODULE\n");
@@ -112,6 +125,52 @@ int sechk_print_list(sechk_lib_t * lib)
 	return 0;
 }
 
+/* reuse results saved for the baseline policy, where still valid */
+static int sechk_load_baseline(sechk_lib_t * lib, const char *results_path, const char *baseline_policy)
+{
+	apol_policy_path_t *orig_path = NULL;
+	apol_policy_t *orig = NULL, *mod = NULL;
+	poldiff_t *diff = NULL;
+	int num_reused = -1;
+
+	if (apol_file_is_policy_path_list(baseline_policy) > 0)
+		orig_path = apol_policy_path_create_from_file(baseline_policy);
+	else
+		orig_path = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, baseline_policy, NULL);
+	if (!orig_path) {
+		fprintf(stderr, "Error: invalid baseline policy %s\n", baseline_policy);
+		goto cleanup;
+	}
+	/* the diff takes ownership of, and may rebuild, its policies, so
+	 * give it its own copy of the policy being checked */
+	if (!(orig = apol_policy_create_from_policy_path(orig_path, 0, NULL, NULL)) ||
+	    !(mod = apol_policy_create_from_policy_path(lib->policy_path, 0, NULL, NULL))) {
+		fprintf(stderr, "Error: failed opening policies to compare with baseline\n");
+		goto cleanup;
+	}
+	if (!(diff = poldiff_create(orig, mod, NULL, NULL))) {
+		fprintf(stderr, "Error: could not compare policy with baseline\n");
+		goto cleanup;
+	}
+	orig = mod = NULL;
+	if (poldiff_run(diff, POLDIFF_DIFF_ALL)) {
+		fprintf(stderr, "Error: could not compare policy with baseline\n");
+		goto cleanup;
+	}
+	num_reused = sechk_lib_load_baseline(lib, results_path, orig_path, diff);
+	if (num_reused < 0)
+		fprintf(stderr, "Error: could not load baseline results %s\n", results_path);
+	else if (!(lib->outputformat & SECHK_OUT_QUIET))
+		fprintf(stderr, "Reusing baseline results for %d module%s\n", num_reused, num_reused == 1 ? "" : "s");
+
+      cleanup:
+	poldiff_destroy(&diff);
+	apol_policy_destroy(&orig);
+	apol_policy_destroy(&mod);
+	apol_policy_path_destroy(&orig_path);
+	return num_reused < 0 ? -1 : 0;
+}
+
 /* main application */
 int main(int argc, char **argv)
 {
@@ -124,6 +183,9 @@ int main(int argc, char **argv)
 	apol_policy_path_t *pol_path = NULL;
 	apol_policy_path_type_e path_type = APOL_POLICY_PATH_TYPE_MONOLITHIC;
 	char *minsev = NULL;
+	char *baseline = NULL, *baseline_policy = NULL, *save_path = NULL;
+	size_t num_jobs = 0;
+	char *endptr = NULL;
 	unsigned char output_override = 0;
 	sechk_lib_t *lib;
 	sechk_module_t *mod = NULL;
@@ -131,7 +193,7 @@ int main(int argc, char **argv)
 	bool module_help = false;
 	apol_vector_t *policy_mods = NULL;
 
-	while ((optc = getopt_long(argc, argv, "p:m:qsvlh::V", longopts, NULL)) != -1) {
+	while ((optc = getopt_long(argc, argv, "p:m:j:qsvlh::V", longopts, NULL)) != -1) {
 		switch (optc) {
 		case 'p':
 			prof_name = strdup(optarg);
@@ -180,6 +242,22 @@ int main(int argc, char **argv)
 			}
 			minsev = strdup(optarg);
 			break;
+		case 'j':
+			num_jobs = strtoul(optarg, &endptr, 10);
+			if (*optarg == '\0' || *endptr != '\0' || num_jobs == 0) {
+				fprintf(stderr, "Error: invalid number of jobs %s.\n", optarg);
+				exit(1);
+			}
+			break;
+		case OPT_BASELINE:
+			baseline = strdup(optarg);
+			break;
+		case OPT_BASELINE_POLICY:
+			baseline_policy = strdup(optarg);
+			break;
+		case OPT_SAVE_RESULTS:
+			save_path = strdup(optarg);
+			break;
 		case 'l':
 			list_stop = true;
 			break;
@@ -200,6 +278,12 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if ((baseline == NULL) != (baseline_policy == NULL)) {
+		fprintf(stderr, "Error: --baseline and --baseline-policy must be given together\n\n");
+		usage(argv[0], 1);
+		exit(1);
+	}
+
 	if (!prof_name && !modname && !list_stop) {
 		fprintf(stderr, "Error: no module or profile specified\n\n");
 		usage(argv[0], 1);
@@ -281,6 +365,10 @@ int main(int argc, char **argv)
 	if (minsev && sechk_lib_set_minsev(minsev, lib) < 0)
 		goto exit_err;
 
+	/* set the number of modules to run at once */
+	if (num_jobs && sechk_lib_set_num_jobs(num_jobs, lib) < 0)
+		goto exit_err;
+
 	/* initialize the file contexts */
 	if (sechk_lib_load_fc(fcpath, lib) < 0)
 		goto exit_err;
@@ -317,10 +405,19 @@ int main(int argc, char **argv)
 	if (sechk_lib_init_modules(lib))
 		goto exit_err;
 
+	/* reuse baseline results for modules unaffected by policy changes */
+	if (baseline && sechk_load_baseline(lib, baseline, baseline_policy) < 0)
+		goto exit_err;
+
 	/* run the modules */
 	if (sechk_lib_run_modules(lib))
 		goto exit_err;
 
+	if (save_path && sechk_lib_save_results(lib, save_path) < 0) {
+		fprintf(stderr, "Error: could not save results to %s: %s\n", save_path, strerror(errno));
+		goto exit_err;
+	}
+
 	/* if running only one module, deselect all others again before printing */
 	if (modname) {
 		retv = sechk_lib_get_module_idx(modname, lib);
@@ -346,6 +443,9 @@ int main(int argc, char **argv)
 	free(minsev);
 	free(prof_name);
 	free(modname);
+	free(baseline);
+	free(baseline_policy);
+	free(save_path);
 	sechk_lib_destroy(&lib);
 	return 0;
 
@@ -355,6 +455,9 @@ int main(int argc, char **argv)
 	free(minsev);
 	free(prof_name);
 	free(modname);
+	free(baseline);
+	free(baseline_policy);
+	free(save_path);
 	apol_policy_path_destroy(&pol_path);
 	sechk_lib_destroy(&lib);
 	return 1;
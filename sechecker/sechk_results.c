@@ -0,0 +1,768 @@
+/**
+ * @file
+ * Implementation of saving and reusing sechecker module results.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include "sechecker.h"
+#include "sechk_results.h"
+#include <apol/policy-query.h>
+#include <sefs/entry.hh>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/entities.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* results file keywords */
+#define SECHK_RESULTS_ROOT_TAG         "sechecker_results"
+#define SECHK_RESULTS_POLICY_TAG       "policy_file"
+#define SECHK_RESULTS_FC_TAG           "file_contexts"
+#define SECHK_RESULTS_MODULE_TAG       "module"
+#define SECHK_RESULTS_ITEM_TAG         "item"
+#define SECHK_RESULTS_PROOF_TAG        "proof"
+#define SECHK_RESULTS_OPTION_TAG       "option"
+#define SECHK_RESULTS_VERSION_ATTRIB   "version"
+#define SECHK_RESULTS_NAME_ATTRIB      "name"
+#define SECHK_RESULTS_PATH_ATTRIB      "path"
+#define SECHK_RESULTS_SIZE_ATTRIB      "size"
+#define SECHK_RESULTS_MTIME_ATTRIB     "mtime"
+#define SECHK_RESULTS_SEVERITY_ATTRIB  "severity"
+#define SECHK_RESULTS_RETV_ATTRIB      "retv"
+#define SECHK_RESULTS_TYPE_ATTRIB      "type"
+#define SECHK_RESULTS_RESULT_ATTRIB    "test_result"
+#define SECHK_RESULTS_TEXT_ATTRIB      "text"
+#define SECHK_RESULTS_VALUE_ATTRIB     "value"
+#define SECHK_RESULTS_VERSION          "1"
+
+/* names for sechk_item_type_e, in enumeration order */
+static const char *const sechk_item_type_names[] = {
+	"class", "common", "perm", "constraint", "validatetrans", "qpol_level", "cat", "qpol_mls_level",
+	"qpol_mls_range", "apol_mls_level", "apol_mls_range", "type", "attribute", "role", "user", "cond",
+	"avrule", "terule", "role_allow", "role_trans", "range_trans", "bool", "fs_use", "genfscon", "isid",
+	"netifcon", "nodecon", "portcon", "context", "fc_entry", "string", "domain_trans", "other", "none"
+};
+
+static const char *sechk_item_type_to_name(sechk_item_type_e type)
+{
+	if ((size_t) type >= sizeof(sechk_item_type_names) / sizeof(sechk_item_type_names[0]))
+		return "other";
+	return sechk_item_type_names[type];
+}
+
+static int sechk_item_type_from_name(const char *name, sechk_item_type_e * type)
+{
+	size_t i;
+
+	for (i = 0; name && i < sizeof(sechk_item_type_names) / sizeof(sechk_item_type_names[0]); i++) {
+		if (!strcmp(name, sechk_item_type_names[i])) {
+			*type = (sechk_item_type_e) i;
+			return 0;
+		}
+	}
+	errno = EINVAL;
+	return -1;
+}
+
+/**
+ *  Return a newly allocated string identifying an item or proof
+ *  element, or an empty string if it has no textual form.
+ */
+static char *sechk_results_render(const apol_policy_t * policy, sechk_item_type_e type, const void *elem)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const char *name = NULL;
+	int rt = 0;
+
+	if (!elem)
+		return strdup("");
+	switch (type) {
+	case SECHK_ITEM_CLASS:
+		rt = qpol_class_get_name(q, elem, &name);
+		break;
+	case SECHK_ITEM_COMMON:
+		rt = qpol_common_get_name(q, elem, &name);
+		break;
+	case SECHK_ITEM_QLEVEL:
+		rt = qpol_level_get_name(q, elem, &name);
+		break;
+	case SECHK_ITEM_CAT:
+		rt = qpol_cat_get_name(q, elem, &name);
+		break;
+	case SECHK_ITEM_TYPE:
+	case SECHK_ITEM_ATTRIB:
+		rt = qpol_type_get_name(q, elem, &name);
+		break;
+	case SECHK_ITEM_ROLE:
+		rt = qpol_role_get_name(q, elem, &name);
+		break;
+	case SECHK_ITEM_USER:
+		rt = qpol_user_get_name(q, elem, &name);
+		break;
+	case SECHK_ITEM_BOOL:
+		rt = qpol_bool_get_name(q, elem, &name);
+		break;
+	case SECHK_ITEM_ISID:
+		rt = qpol_isid_get_name(q, elem, &name);
+		break;
+	case SECHK_ITEM_PERM:
+	case SECHK_ITEM_STR:
+		name = elem;
+		break;
+	case SECHK_ITEM_AMLSLEVEL:
+		return apol_mls_level_render(policy, elem);
+	case SECHK_ITEM_AMLSRANGE:
+		return apol_mls_range_render(policy, elem);
+	case SECHK_ITEM_AVRULE:
+		return apol_avrule_render(policy, elem);
+	case SECHK_ITEM_TERULE:
+		return apol_terule_render(policy, elem);
+	case SECHK_ITEM_RALLOW:
+		return apol_role_allow_render(policy, elem);
+	case SECHK_ITEM_RTRAMS:
+		return apol_role_trans_render(policy, elem);
+	case SECHK_ITEM_RANGETRANS:
+		return apol_range_trans_render(policy, elem);
+	case SECHK_ITEM_FCENT:
+		return sefs_entry_to_string(elem);
+	default:
+		return strdup("");
+	}
+	if (rt < 0)
+		return NULL;
+	return strdup(name);
+}
+
+/**
+ *  Find the policy component named by a saved item or proof element.
+ *  Only components that can be found by name are supported; rules and
+ *  other compound elements cannot be restored.
+ *
+ *  @return 0 on success, or < 0 if the element cannot be restored.
+ */
+static int sechk_results_resolve(const apol_policy_t * policy, sechk_item_type_e type, const char *name, void **elem,
+				 free_fn_t * free_fn)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const void *datum = NULL;
+	qpol_bool_t *bool_datum = NULL;
+	int rt;
+
+	*elem = NULL;
+	*free_fn = NULL;
+	switch (type) {
+	case SECHK_ITEM_CLASS:
+		rt = qpol_policy_get_class_by_name(q, name, (const qpol_class_t **)&datum);
+		break;
+	case SECHK_ITEM_COMMON:
+		rt = qpol_policy_get_common_by_name(q, name, (const qpol_common_t **)&datum);
+		break;
+	case SECHK_ITEM_QLEVEL:
+		rt = qpol_policy_get_level_by_name(q, name, (const qpol_level_t **)&datum);
+		break;
+	case SECHK_ITEM_CAT:
+		rt = qpol_policy_get_cat_by_name(q, name, (const qpol_cat_t **)&datum);
+		break;
+	case SECHK_ITEM_TYPE:
+	case SECHK_ITEM_ATTRIB:
+		rt = qpol_policy_get_type_by_name(q, name, (const qpol_type_t **)&datum);
+		break;
+	case SECHK_ITEM_ROLE:
+		rt = qpol_policy_get_role_by_name(q, name, (const qpol_role_t **)&datum);
+		break;
+	case SECHK_ITEM_USER:
+		rt = qpol_policy_get_user_by_name(q, name, (const qpol_user_t **)&datum);
+		break;
+	case SECHK_ITEM_BOOL:
+		rt = qpol_policy_get_bool_by_name(q, name, &bool_datum);
+		datum = bool_datum;
+		break;
+	case SECHK_ITEM_ISID:
+		rt = qpol_policy_get_isid_by_name(q, name, (const qpol_isid_t **)&datum);
+		break;
+	case SECHK_ITEM_PERM:
+	case SECHK_ITEM_STR:
+		if (!(*elem = strdup(name)))
+			return -1;
+		*free_fn = free;
+		return 0;
+	case SECHK_ITEM_NONE:
+		return 0;
+	default:
+		errno = ENOTSUP;
+		return -1;
+	}
+	if (rt < 0)
+		return -1;
+	*elem = (void *)datum;
+	return 0;
+}
+
+/**
+ *  Write an XML attribute, escaping its value.  Whitespace is written
+ *  as character references so that multi-line proof text survives
+ *  attribute value normalization when read back.  A NULL value, such
+ *  as an unset severity or option, is written as empty.
+ */
+static void sechk_results_write_attrib(FILE * out, const char *name, const char *value)
+{
+	const char *c;
+
+	fprintf(out, " %s=\"", name);
+	for (c = value; c != NULL && *c; c++) {
+		switch (*c) {
+		case '&':
+			fputs("&amp;", out);
+			break;
+		case '<':
+			fputs("&lt;", out);
+			break;
+		case '>':
+			fputs("&gt;", out);
+			break;
+		case '"':
+			fputs("&quot;", out);
+			break;
+		case '\n':
+			fputs("&#10;", out);
+			break;
+		case '\r':
+			fputs("&#13;", out);
+			break;
+		case '\t':
+			fputs("&#9;", out);
+			break;
+		default:
+			fputc(*c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+/**
+ *  Write an element recording a file's path, size, and modification
+ *  time.  Nothing is written if the file cannot be examined.
+ */
+static void sechk_results_write_file(FILE * out, const char *tag, const char *path)
+{
+	struct stat file_stat;
+
+	if (stat(path, &file_stat) != 0)
+		return;
+	fprintf(out, "  <%s", tag);
+	sechk_results_write_attrib(out, SECHK_RESULTS_PATH_ATTRIB, path);
+	fprintf(out, " %s=\"%lld\" %s=\"%lld\"/>\n", SECHK_RESULTS_SIZE_ATTRIB, (long long)file_stat.st_size,
+		SECHK_RESULTS_MTIME_ATTRIB, (long long)file_stat.st_mtime);
+}
+
+static int sechk_results_write_module(FILE * out, const sechk_lib_t * lib, const sechk_module_t * mod)
+{
+	const sechk_result_t *res = mod->result;
+	const sechk_item_t *item;
+	const sechk_proof_t *proof;
+	const sechk_name_value_t *opt;
+	char *s = NULL;
+	size_t i, j;
+
+	fprintf(out, "  <%s", SECHK_RESULTS_MODULE_TAG);
+	sechk_results_write_attrib(out, SECHK_RESULTS_NAME_ATTRIB, mod->name);
+	sechk_results_write_attrib(out, SECHK_RESULTS_SEVERITY_ATTRIB, mod->severity);
+	sechk_results_write_attrib(out, SECHK_RESULTS_TYPE_ATTRIB, sechk_item_type_to_name(res->item_type));
+	fprintf(out, " %s=\"%d\">\n", SECHK_RESULTS_RETV_ATTRIB, mod->run_retv);
+	for (i = 0; i < apol_vector_get_size(mod->options); i++) {
+		opt = apol_vector_get_element(mod->options, i);
+		fprintf(out, "    <%s", SECHK_RESULTS_OPTION_TAG);
+		sechk_results_write_attrib(out, SECHK_RESULTS_NAME_ATTRIB, opt->name);
+		sechk_results_write_attrib(out, SECHK_RESULTS_VALUE_ATTRIB, opt->value);
+		fprintf(out, "/>\n");
+	}
+	for (i = 0; i < apol_vector_get_size(res->items); i++) {
+		item = apol_vector_get_element(res->items, i);
+		if (!(s = sechk_results_render(lib->policy, res->item_type, item->item)))
+			return -1;
+		fprintf(out, "    <%s", SECHK_RESULTS_ITEM_TAG);
+		sechk_results_write_attrib(out, SECHK_RESULTS_NAME_ATTRIB, s);
+		free(s);
+		fprintf(out, " %s=\"%u\">\n", SECHK_RESULTS_RESULT_ATTRIB, (unsigned int)item->test_result);
+		for (j = 0; j < apol_vector_get_size(item->proof); j++) {
+			proof = apol_vector_get_element(item->proof, j);
+			if (!(s = sechk_results_render(lib->policy, proof->type, proof->elem)))
+				return -1;
+			fprintf(out, "      <%s", SECHK_RESULTS_PROOF_TAG);
+			sechk_results_write_attrib(out, SECHK_RESULTS_TYPE_ATTRIB, sechk_item_type_to_name(proof->type));
+			sechk_results_write_attrib(out, SECHK_RESULTS_NAME_ATTRIB, s);
+			sechk_results_write_attrib(out, SECHK_RESULTS_TEXT_ATTRIB, proof->text ? proof->text : "");
+			fprintf(out, "/>\n");
+			free(s);
+		}
+		fprintf(out, "    </%s>\n", SECHK_RESULTS_ITEM_TAG);
+	}
+	fprintf(out, "  </%s>\n", SECHK_RESULTS_MODULE_TAG);
+	return 0;
+}
+
+int sechk_lib_save_results(const sechk_lib_t * lib, const char *path)
+{
+	FILE *out = NULL;
+	const sechk_module_t *mod;
+	const apol_vector_t *policy_mods;
+	size_t i;
+	int error = 0;
+
+	if (!lib || !lib->policy || !lib->policy_path || !path) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!(out = fopen(path, "w"))) {
+		error = errno;
+		ERR(lib->policy, "Could not open %s for writing: %s", path, strerror(error));
+		errno = error;
+		return -1;
+	}
+	fprintf(out, "<?xml version=\"1.0\"?>\n<%s %s=\"%s\">\n", SECHK_RESULTS_ROOT_TAG, SECHK_RESULTS_VERSION_ATTRIB,
+		SECHK_RESULTS_VERSION);
+	sechk_results_write_file(out, SECHK_RESULTS_POLICY_TAG, apol_policy_path_get_primary(lib->policy_path));
+	if (apol_policy_path_get_type(lib->policy_path) == APOL_POLICY_PATH_TYPE_MODULAR) {
+		policy_mods = apol_policy_path_get_modules(lib->policy_path);
+		for (i = 0; i < apol_vector_get_size(policy_mods); i++)
+			sechk_results_write_file(out, SECHK_RESULTS_POLICY_TAG, apol_vector_get_element(policy_mods, i));
+	}
+	if (lib->fc_path)
+		sechk_results_write_file(out, SECHK_RESULTS_FC_TAG, lib->fc_path);
+	for (i = 0; i < apol_vector_get_size(lib->modules); i++) {
+		mod = apol_vector_get_element(lib->modules, i);
+		if (!mod->run_done || !mod->result || mod->run_retv < 0)
+			continue;
+		if (sechk_results_write_module(out, lib, mod) < 0) {
+			error = errno;
+			ERR(lib->policy, "Could not save results for module %s.", mod->name);
+			goto err;
+		}
+	}
+	fprintf(out, "</%s>\n", SECHK_RESULTS_ROOT_TAG);
+	if (fclose(out) != 0) {
+		error = errno;
+		ERR(lib->policy, "Could not write %s: %s", path, strerror(error));
+		errno = error;
+		return -1;
+	}
+	return 0;
+
+      err:
+	fclose(out);
+	errno = error;
+	return -1;
+}
+
+/**
+ *  Get a node's attribute as a newly allocated string, or NULL.
+ */
+static char *sechk_results_get_attrib(xmlNodePtr node, const char *name)
+{
+	xmlChar *value = xmlGetProp(node, (const xmlChar *)name);
+	char *s;
+
+	if (!value)
+		return NULL;
+	s = strdup((const char *)value);
+	xmlFree(value);
+	return s;
+}
+
+/**
+ *  Rebuild a module's result from its saved form.
+ *
+ *  @return 0 on success, or < 0 if the result cannot be restored
+ *  against the current policy.
+ */
+static int sechk_results_restore(const sechk_lib_t * lib, const sechk_module_t * mod, xmlNodePtr mod_node,
+				 sechk_result_t ** result, int *retv)
+{
+	sechk_result_t *res = NULL;
+	sechk_item_t *item = NULL;
+	sechk_proof_t *proof = NULL;
+	xmlNodePtr item_node, proof_node;
+	sechk_item_type_e proof_type;
+	char *s = NULL, *name = NULL;
+	int error = 0;
+
+	*result = NULL;
+	if (!(res = sechk_result_new()) || !(res->test_name = strdup(mod->name)) ||
+	    !(res->items = apol_vector_create(sechk_item_free))) {
+		error = errno;
+		goto err;
+	}
+	if (!(s = sechk_results_get_attrib(mod_node, SECHK_RESULTS_TYPE_ATTRIB)) || sechk_item_type_from_name(s, &res->item_type) < 0) {
+		error = EINVAL;
+		goto err;
+	}
+	free(s);
+	if (!(s = sechk_results_get_attrib(mod_node, SECHK_RESULTS_RETV_ATTRIB))) {
+		error = EINVAL;
+		goto err;
+	}
+	*retv = atoi(s);
+	free(s);
+	s = NULL;
+
+	for (item_node = mod_node->children; item_node; item_node = item_node->next) {
+		if (item_node->type != XML_ELEMENT_NODE || xmlStrcmp(item_node->name, (const xmlChar *)SECHK_RESULTS_ITEM_TAG))
+			continue;
+		if (!(item = sechk_item_new(NULL)) || !(item->proof = apol_vector_create(sechk_proof_free))) {
+			error = errno;
+			goto err;
+		}
+		if (!(name = sechk_results_get_attrib(item_node, SECHK_RESULTS_NAME_ATTRIB)) ||
+		    sechk_results_resolve(lib->policy, res->item_type, name, &item->item, &item->item_free_fn) < 0) {
+			error = ENOTSUP;
+			goto err;
+		}
+		free(name);
+		name = NULL;
+		if ((s = sechk_results_get_attrib(item_node, SECHK_RESULTS_RESULT_ATTRIB)) != NULL)
+			item->test_result = (unsigned char)atoi(s);
+		free(s);
+		s = NULL;
+		for (proof_node = item_node->children; proof_node; proof_node = proof_node->next) {
+			if (proof_node->type != XML_ELEMENT_NODE || xmlStrcmp(proof_node->name, (const xmlChar *)SECHK_RESULTS_PROOF_TAG))
+				continue;
+			if (!(proof = sechk_proof_new(NULL))) {
+				error = errno;
+				goto err;
+			}
+			proof->type = SECHK_ITEM_NONE;
+			proof->text = sechk_results_get_attrib(proof_node, SECHK_RESULTS_TEXT_ATTRIB);
+			s = sechk_results_get_attrib(proof_node, SECHK_RESULTS_TYPE_ATTRIB);
+			name = sechk_results_get_attrib(proof_node, SECHK_RESULTS_NAME_ATTRIB);
+			/* proof elements that cannot be found by name keep only
+			 * their text, which is all that reports print */
+			if (s && name && sechk_item_type_from_name(s, &proof_type) == 0 &&
+			    sechk_results_resolve(lib->policy, proof_type, name, &proof->elem, &proof->elem_free_fn) == 0 && proof->elem)
+				proof->type = proof_type;
+			free(s);
+			free(name);
+			s = name = NULL;
+			if (apol_vector_append(item->proof, proof) < 0) {
+				error = errno;
+				goto err;
+			}
+			proof = NULL;
+		}
+		if (apol_vector_append(res->items, item) < 0) {
+			error = errno;
+			goto err;
+		}
+		item = NULL;
+	}
+	*result = res;
+	return 0;
+
+      err:
+	free(s);
+	free(name);
+	sechk_proof_free(proof);
+	sechk_item_free(item);
+	sechk_result_destroy(&res);
+	errno = error;
+	return -1;
+}
+
+/**
+ *  Return true if any policy component among inputs differs.
+ */
+static bool sechk_results_inputs_changed(const poldiff_t * diff, unsigned int inputs)
+{
+	static const struct
+	{
+		unsigned int input;
+		uint32_t components;
+	} input_map[] = {
+		{SECHK_INPUT_TYPES, POLDIFF_DIFF_TYPES},
+		{SECHK_INPUT_ATTRIBS, POLDIFF_DIFF_ATTRIBS},
+		{SECHK_INPUT_ROLES, POLDIFF_DIFF_ROLES},
+		{SECHK_INPUT_USERS, POLDIFF_DIFF_USERS},
+		{SECHK_INPUT_BOOLS, POLDIFF_DIFF_BOOLS},
+		{SECHK_INPUT_CLASSES, POLDIFF_DIFF_CLASSES | POLDIFF_DIFF_COMMONS},
+		/* rules within conditionals also depend upon boolean defaults */
+		{SECHK_INPUT_AVRULES, POLDIFF_DIFF_AVRULES | POLDIFF_DIFF_BOOLS},
+		{SECHK_INPUT_TERULES, POLDIFF_DIFF_TERULES | POLDIFF_DIFF_BOOLS},
+		{SECHK_INPUT_RBAC_RULES, POLDIFF_DIFF_ROLE_ALLOWS | POLDIFF_DIFF_ROLE_TRANS},
+		{SECHK_INPUT_MLS, POLDIFF_DIFF_MLS}
+	};
+	size_t stats[5], i, j;
+
+	for (i = 0; i < sizeof(input_map) / sizeof(input_map[0]); i++) {
+		if (!(inputs & input_map[i].input))
+			continue;
+		if (poldiff_is_run(diff, input_map[i].components) != 1 ||
+		    poldiff_get_stats(diff, input_map[i].components, stats) < 0)
+			return true;
+		for (j = 0; j < 5; j++) {
+			if (stats[j])
+				return true;
+		}
+	}
+	return false;
+}
+
+/**
+ *  Return true if a file differs from that recorded by an element
+ *  written by sechk_results_write_file().
+ */
+static bool sechk_results_file_changed(xmlNodePtr node, const char *file)
+{
+	struct stat file_stat;
+	char *path = NULL, *size = NULL, *mtime = NULL;
+	bool changed = true;
+
+	path = sechk_results_get_attrib(node, SECHK_RESULTS_PATH_ATTRIB);
+	size = sechk_results_get_attrib(node, SECHK_RESULTS_SIZE_ATTRIB);
+	mtime = sechk_results_get_attrib(node, SECHK_RESULTS_MTIME_ATTRIB);
+	if (path && size && mtime && !strcmp(path, file) && stat(file, &file_stat) == 0 &&
+	    atoll(size) == (long long)file_stat.st_size && atoll(mtime) == (long long)file_stat.st_mtime)
+		changed = false;
+	free(path);
+	free(size);
+	free(mtime);
+	return changed;
+}
+
+/**
+ *  Return the next element after node (or the first child of root if
+ *  node is NULL) with the given tag, or NULL if there is none.
+ */
+static xmlNodePtr sechk_results_next_tag(xmlNodePtr root, xmlNodePtr node, const char *tag)
+{
+	for (node = (node ? node->next : root->children); node; node = node->next) {
+		if (node->type == XML_ELEMENT_NODE && !xmlStrcmp(node->name, (const xmlChar *)tag))
+			return node;
+	}
+	return NULL;
+}
+
+/**
+ *  Return true if the file_contexts file differs from that recorded
+ *  within the results file.
+ */
+static bool sechk_results_fc_changed(const sechk_lib_t * lib, xmlNodePtr root)
+{
+	xmlNodePtr node = sechk_results_next_tag(root, NULL, SECHK_RESULTS_FC_TAG);
+
+	if (!node || !lib->fc_path)
+		return (node != NULL || lib->fc_path != NULL);
+	return sechk_results_file_changed(node, lib->fc_path);
+}
+
+/**
+ *  Return true if the results file was not produced from the baseline
+ *  policy's files as they are now.
+ */
+static bool sechk_results_policy_changed(const apol_policy_path_t * baseline_path, xmlNodePtr root)
+{
+	const apol_vector_t *policy_mods;
+	xmlNodePtr node;
+	size_t i;
+
+	node = sechk_results_next_tag(root, NULL, SECHK_RESULTS_POLICY_TAG);
+	if (!node || sechk_results_file_changed(node, apol_policy_path_get_primary(baseline_path)))
+		return true;
+	if (apol_policy_path_get_type(baseline_path) == APOL_POLICY_PATH_TYPE_MODULAR) {
+		policy_mods = apol_policy_path_get_modules(baseline_path);
+		for (i = 0; i < apol_vector_get_size(policy_mods); i++) {
+			node = sechk_results_next_tag(root, node, SECHK_RESULTS_POLICY_TAG);
+			if (!node || sechk_results_file_changed(node, apol_vector_get_element(policy_mods, i)))
+				return true;
+		}
+	}
+	return (sechk_results_next_tag(root, node, SECHK_RESULTS_POLICY_TAG) != NULL);
+}
+
+/**
+ *  Return true if a module's options differ from those with which its
+ *  saved results were produced.  Options may repeat and their order
+ *  is not significant.
+ */
+static bool sechk_results_options_changed(const sechk_module_t * mod, xmlNodePtr mod_node)
+{
+	const sechk_name_value_t *opt;
+	xmlNodePtr node = NULL;
+	char *name = NULL, *value = NULL;
+	bool *matched = NULL, changed = false;
+	size_t num_opts = apol_vector_get_size(mod->options), num_saved = 0, i;
+
+	if (num_opts && !(matched = calloc(num_opts, sizeof(*matched))))
+		return true;
+	while (!changed && (node = sechk_results_next_tag(mod_node, node, SECHK_RESULTS_OPTION_TAG)) != NULL) {
+		num_saved++;
+		name = sechk_results_get_attrib(node, SECHK_RESULTS_NAME_ATTRIB);
+		value = sechk_results_get_attrib(node, SECHK_RESULTS_VALUE_ATTRIB);
+		changed = true;
+		for (i = 0; name && value && i < num_opts; i++) {
+			opt = apol_vector_get_element(mod->options, i);
+			if (!matched[i] && !strcmp(opt->name, name) && !strcmp(opt->value, value)) {
+				matched[i] = true;
+				changed = false;
+				break;
+			}
+		}
+		free(name);
+		free(value);
+	}
+	free(matched);
+	return (changed || num_saved != num_opts);
+}
+
+/**
+ *  Find the saved results for a module, or NULL if there are none.
+ */
+static xmlNodePtr sechk_results_find_module(xmlNodePtr root, const char *name)
+{
+	xmlNodePtr node;
+	xmlChar *value;
+	bool found;
+
+	for (node = root->children; node; node = node->next) {
+		if (node->type != XML_ELEMENT_NODE || xmlStrcmp(node->name, (const xmlChar *)SECHK_RESULTS_MODULE_TAG))
+			continue;
+		value = xmlGetProp(node, (const xmlChar *)SECHK_RESULTS_NAME_ATTRIB);
+		found = (value && !xmlStrcmp(value, (const xmlChar *)name));
+		xmlFree(value);
+		if (found)
+			return node;
+	}
+	return NULL;
+}
+
+int sechk_lib_load_baseline(sechk_lib_t * lib, const char *path, const apol_policy_path_t * baseline_path, const poldiff_t * diff)
+{
+	xmlDocPtr doc = NULL;
+	xmlNodePtr root, mod_node;
+	xmlChar *version = NULL;
+	sechk_module_t *mod;
+	sechk_name_value_t *dep;
+	sechk_result_t **cached = NULL;
+	int *cached_retv = NULL;
+	bool *dirty = NULL, *needed = NULL, policy_changed, fc_changed, changed;
+	size_t num_modules, i, j;
+	int idx, num_reused = 0, error = 0;
+
+	if (!lib || !lib->policy || !path || !baseline_path || !diff) {
+		errno = EINVAL;
+		return -1;
+	}
+	num_modules = apol_vector_get_size(lib->modules);
+	if (!(doc = xmlReadFile(path, NULL, XML_PARSE_NONET)) || !(root = xmlDocGetRootElement(doc)) ||
+	    xmlStrcmp(root->name, (const xmlChar *)SECHK_RESULTS_ROOT_TAG) ||
+	    !(version = xmlGetProp(root, (const xmlChar *)SECHK_RESULTS_VERSION_ATTRIB)) ||
+	    xmlStrcmp(version, (const xmlChar *)SECHK_RESULTS_VERSION)) {
+		ERR(lib->policy, "%s is not a sechecker results file.", path);
+		error = EINVAL;
+		goto cleanup;
+	}
+	if (!(cached = calloc(num_modules, sizeof(*cached))) || !(cached_retv = calloc(num_modules, sizeof(*cached_retv))) ||
+	    !(dirty = calloc(num_modules, sizeof(*dirty))) || !(needed = calloc(num_modules, sizeof(*needed)))) {
+		error = errno;
+		ERR(lib->policy, "%s", strerror(error));
+		goto cleanup;
+	}
+
+	/* a module is dirty if the results were saved for some other
+	 * policy, if its inputs or options changed, or if its saved
+	 * results cannot be restored against the new policy */
+	policy_changed = sechk_results_policy_changed(baseline_path, root);
+	if (policy_changed)
+		WARN(lib->policy, "%s was not saved for baseline policy %s; ignoring it.", path,
+		     apol_policy_path_get_primary(baseline_path));
+	fc_changed = sechk_results_fc_changed(lib, root);
+	for (i = 0; i < num_modules; i++) {
+		mod = apol_vector_get_element(lib->modules, i);
+		if (policy_changed || mod->run_done || !mod->inputs || sechk_results_inputs_changed(diff, mod->inputs) ||
+		    ((mod->inputs & SECHK_INPUT_FILE_CONTEXTS) && fc_changed) ||
+		    !(mod_node = sechk_results_find_module(root, mod->name)) || sechk_results_options_changed(mod, mod_node) ||
+		    sechk_results_restore(lib, mod, mod_node, &cached[i], &cached_retv[i]) < 0)
+			dirty[i] = true;
+	}
+
+	/* modules depending upon a dirty module are dirty as well */
+	do {
+		changed = false;
+		for (i = 0; i < num_modules; i++) {
+			if (dirty[i])
+				continue;
+			mod = apol_vector_get_element(lib->modules, i);
+			for (j = 0; j < apol_vector_get_size(mod->dependencies); j++) {
+				dep = apol_vector_get_element(mod->dependencies, j);
+				idx = sechk_lib_get_module_idx(dep->value, lib);
+				if (idx < 0 || dirty[idx]) {
+					dirty[i] = changed = true;
+					break;
+				}
+			}
+		}
+	} while (changed);
+
+	/* dirty modules read their dependencies' full results, including
+	 * proof elements that cannot be restored, so those dependencies
+	 * must be run anew too */
+	for (i = 0; i < num_modules; i++)
+		needed[i] = dirty[i];
+	do {
+		changed = false;
+		for (i = 0; i < num_modules; i++) {
+			if (!needed[i])
+				continue;
+			mod = apol_vector_get_element(lib->modules, i);
+			for (j = 0; j < apol_vector_get_size(mod->dependencies); j++) {
+				dep = apol_vector_get_element(mod->dependencies, j);
+				idx = sechk_lib_get_module_idx(dep->value, lib);
+				if (idx >= 0 && !needed[idx])
+					needed[idx] = changed = true;
+			}
+		}
+	} while (changed);
+
+	for (i = 0; i < num_modules; i++) {
+		if (needed[i] || !cached[i])
+			continue;
+		mod = apol_vector_get_element(lib->modules, i);
+		mod->result = cached[i];
+		mod->run_retv = cached_retv[i];
+		mod->run_done = true;
+		cached[i] = NULL;
+		num_reused++;
+	}
+      cleanup:
+	for (i = 0; cached && i < num_modules; i++)
+		sechk_result_destroy(&cached[i]);
+	free(cached);
+	free(cached_retv);
+	free(dirty);
+	free(needed);
+	xmlFree(version);
+	xmlFreeDoc(doc);
+	if (error) {
+		errno = error;
+		return -1;
+	}
+	return num_reused;
+}
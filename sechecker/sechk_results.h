@@ -0,0 +1,79 @@
+/**
+ * @file
+ * Routines to save module results to a file and to reuse them when
+ * checking a later revision of the same policy.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SECHK_RESULTS_H
+#define SECHK_RESULTS_H
+
+#ifdef	__cplusplus
+extern "C"
+{
+#endif
+
+#include "sechecker.h"
+
+#include <poldiff/poldiff.h>
+
+/**
+ *  Write the results of every module that has been run to a file, as
+ *  XML.  Each item and proof element is recorded by name (or, for
+ *  rules, its rendered text) so that the file may be read without the
+ *  policy.  The path, size, and modification time of the policy's
+ *  files and of the file_contexts file, and each module's options, are
+ *  also recorded.
+ *
+ *  @param lib The library whose results to save.
+ *  @param path Name of the file to write.
+ *
+ *  @return 0 on success or < 0 on error; if the call fails, errno will
+ *  be set.
+ */
+	int sechk_lib_save_results(const sechk_lib_t * lib, const char *path);
+
+/**
+ *  Reuse results saved by sechk_lib_save_results() for a baseline
+ *  policy.  A module's saved results are reused if none of its
+ *  declared inputs differ between the baseline and the library's
+ *  policy, none of its dependencies must be re-run, and no module
+ *  that must be re-run depends upon it.  Reused results are installed
+ *  as if the module had been run, so sechk_lib_run_modules() will
+ *  skip it.  This must be called after sechk_lib_init_modules() and
+ *  before sechk_lib_run_modules().  Nothing is reused if the file was
+ *  not saved for the baseline policy's files as they are now, and a
+ *  module's results are not reused if its options have changed.
+ *
+ *  @param lib The library into which to load results.
+ *  @param path Name of the file written by sechk_lib_save_results().
+ *  @param baseline_path Path of the baseline policy.
+ *  @param diff Difference from the baseline policy to the library's
+ *  policy.  Components of the policy whose differences have not been
+ *  run are treated as changed.
+ *
+ *  @return Number of modules whose results were reused, or < 0 on
+ *  error; if the call fails, errno will be set.
+ */
+	int sechk_lib_load_baseline(sechk_lib_t * lib, const char *path, const apol_policy_path_t * baseline_path,
+				    const poldiff_t * diff);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
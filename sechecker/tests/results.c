@@ -0,0 +1,211 @@
+/**
+ *  @file
+ *
+ *  Test that sechecker reuses saved results only for the baseline
+ *  policy and module options with which they were saved.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include "../sechecker.h"
+#include "../sechk_results.h"
+
+#include <CUnit/CUnit.h>
+#include <apol/policy-path.h>
+#include <poldiff/poldiff.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define POLICY TEST_POLICIES "/setools-3.3/apol/dta_test.policy.conf"
+
+static char policy_file[] = "/tmp/sechecker-policy-XXXXXX";
+static char results_file[] = "/tmp/sechecker-results-XXXXXX";
+
+/**
+ *  Create a library for the given policy file, with find_domains and
+ *  domains_wo_roles selected and initialized.  If domain_attrib is
+ *  not NULL it is added to find_domains' options.
+ */
+static sechk_lib_t *results_lib(const char *policy, const char *domain_attrib)
+{
+	sechk_lib_t *lib = sechk_lib_new();
+	apol_policy_path_t *path = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, policy, NULL);
+	sechk_module_t *mod;
+	size_t i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(lib);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(path);
+	CU_ASSERT_FATAL(sechk_lib_load_policy(path, lib) == 0);
+	for (i = 0; i < apol_vector_get_size(lib->modules); i++) {
+		mod = apol_vector_get_element(lib->modules, i);
+		mod->selected = false;
+	}
+	sechk_lib_get_module("domains_wo_roles", lib)->selected = true;
+	mod = sechk_lib_get_module("find_domains", lib);
+	if (domain_attrib != NULL)
+		CU_ASSERT_FATAL(apol_vector_append(mod->options, sechk_name_value_new("domain_attribute", domain_attrib)) == 0);
+	CU_ASSERT_FATAL(sechk_lib_check_module_dependencies(lib) == 0);
+	CU_ASSERT_FATAL(mod->selected);
+	CU_ASSERT_FATAL(sechk_lib_init_modules(lib) == 0);
+	return lib;
+}
+
+/**
+ *  Compare the baseline policy to itself.
+ */
+static poldiff_t *results_diff(void)
+{
+	apol_policy_path_t *path = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, POLICY, NULL);
+	apol_policy_t *orig, *mod;
+	poldiff_t *diff;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(path);
+	orig = apol_policy_create_from_policy_path(path, 0, NULL, NULL);
+	mod = apol_policy_create_from_policy_path(path, 0, NULL, NULL);
+	apol_policy_path_destroy(&path);
+	CU_ASSERT_FATAL(orig != NULL && mod != NULL);
+	diff = poldiff_create(orig, mod, NULL, NULL);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(diff);
+	CU_ASSERT_FATAL(poldiff_run(diff, POLDIFF_DIFF_ALL) == 0);
+	return diff;
+}
+
+/**
+ *  Run the selected modules against policy_file and save their results.
+ *
+ *  @return Number of items found by find_domains.
+ */
+static size_t results_save(void)
+{
+	sechk_lib_t *lib = results_lib(policy_file, NULL);
+	size_t num_items;
+
+	CU_ASSERT_FATAL(sechk_lib_run_modules(lib) == 0);
+	CU_ASSERT_FATAL(sechk_lib_save_results(lib, results_file) == 0);
+	num_items = apol_vector_get_size(sechk_lib_get_module("find_domains", lib)->result->items);
+	sechk_lib_destroy(&lib);
+	return num_items;
+}
+
+/**
+ *  Load the saved results for the given baseline policy into a new
+ *  library, returning the number of modules whose results were reused.
+ *  If num_items is not NULL, set it to the number of items find_domains
+ *  found once all modules have been run.
+ */
+static int results_reload(const char *baseline, const char *domain_attrib, size_t * num_items)
+{
+	sechk_lib_t *lib = results_lib(policy_file, domain_attrib);
+	apol_policy_path_t *path = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, baseline, NULL);
+	poldiff_t *diff = results_diff();
+	int num_reused;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(path);
+	num_reused = sechk_lib_load_baseline(lib, results_file, path, diff);
+	CU_ASSERT(sechk_lib_run_modules(lib) == 0);
+	if (num_items)
+		*num_items = apol_vector_get_size(sechk_lib_get_module("find_domains", lib)->result->items);
+	poldiff_destroy(&diff);
+	apol_policy_path_destroy(&path);
+	sechk_lib_destroy(&lib);
+	return num_reused;
+}
+
+static void results_same(void)
+{
+	size_t saved = results_save(), reloaded = 0;
+
+	CU_ASSERT(results_reload(policy_file, NULL, &reloaded) == 2);
+	CU_ASSERT_EQUAL(saved, reloaded);
+}
+
+static void results_options(void)
+{
+	results_save();
+	/* domains_wo_roles depends upon find_domains, so neither is reused */
+	CU_ASSERT(results_reload(policy_file, "not_a_domain_attribute", NULL) == 0);
+	CU_ASSERT(results_reload(policy_file, NULL, NULL) == 2);
+}
+
+static void results_policy(void)
+{
+	FILE *f;
+
+	results_save();
+	/* a different baseline policy, even one with the same content */
+	CU_ASSERT(results_reload(POLICY, NULL, NULL) == 0);
+
+	/* the baseline policy modified after the results were saved */
+	f = fopen(policy_file, "a");
+	CU_ASSERT_PTR_NOT_NULL_FATAL(f);
+	fprintf(f, "\n# modified after saving results\n");
+	fclose(f);
+	CU_ASSERT(results_reload(policy_file, NULL, NULL) == 0);
+}
+
+CU_TestInfo results_tests[] = {
+	{"reuse unchanged", results_same}
+	,
+	{"changed module options", results_options}
+	,
+	{"changed baseline policy", results_policy}
+	,
+	CU_TEST_INFO_NULL
+};
+
+int results_init()
+{
+	FILE *in = NULL, *out = NULL;
+	char buf[4096];
+	size_t len;
+	int fd, retv = 1;
+
+	if ((fd = mkstemp(results_file)) < 0)
+		return 1;
+	close(fd);
+	if ((fd = mkstemp(policy_file)) < 0)
+		return 1;
+	if ((out = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		return 1;
+	}
+	if ((in = fopen(POLICY, "r")) == NULL)
+		goto cleanup;
+	while ((len = fread(buf, 1, sizeof(buf), in)) > 0) {
+		if (fwrite(buf, 1, len, out) != len)
+			goto cleanup;
+	}
+	if (!ferror(in))
+		retv = 0;
+      cleanup:
+	if (in)
+		fclose(in);
+	if (fclose(out) != 0)
+		retv = 1;
+	return retv;
+}
+
+int results_cleanup()
+{
+	unlink(policy_file);
+	unlink(results_file);
+	return 0;
+}
@@ -0,0 +1,284 @@
+/**
+ *  @file
+ *
+ *  Test that sechecker runs modules concurrently without letting a
+ *  module that modifies the policy run alongside another, and that
+ *  modules share one index of the policy's rules.
+ *
+ *  Copyright (C) 2007 Tresys Technology, LLC
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include "../sechecker.h"
+
+#include <CUnit/CUnit.h>
+#include <apol/avrule-query.h>
+#include <apol/policy-path.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define POLICY TEST_POLICIES "/setools-3.3/apol/dta_test.policy.conf"
+
+#define NUM_READERS 4
+#define NUM_WRITERS 2
+
+static pthread_mutex_t fake_lock = PTHREAD_MUTEX_INITIALIZER;
+static int fake_running, fake_writers_running, fake_max_running;
+static bool fake_overlapped;
+
+/**
+ *  Run function for the fake modules: note how many modules are
+ *  running at once, and whether a module that modifies the policy
+ *  ever ran alongside another.
+ */
+static int fake_run(sechk_module_t * mod, apol_policy_t * policy __attribute__ ((unused)), void *arg __attribute__ ((unused)))
+{
+	pthread_mutex_lock(&fake_lock);
+	fake_running++;
+	if (mod->mutates_policy)
+		fake_writers_running++;
+	if (fake_writers_running > 0 && fake_running > 1)
+		fake_overlapped = true;
+	if (fake_running > fake_max_running)
+		fake_max_running = fake_running;
+	pthread_mutex_unlock(&fake_lock);
+
+	usleep(20000);
+
+	pthread_mutex_lock(&fake_lock);
+	fake_running--;
+	if (mod->mutates_policy)
+		fake_writers_running--;
+	pthread_mutex_unlock(&fake_lock);
+	return 0;
+}
+
+static sechk_module_t *fake_module_add(sechk_lib_t * lib, const char *name, bool mutates_policy, const char *dependency)
+{
+	sechk_module_t *mod = sechk_module_new();
+	sechk_fn_t *fn_struct = sechk_fn_new();
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(mod);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(fn_struct);
+	mod->name = strdup(name);
+	mod->parent_lib = lib;
+	mod->selected = true;
+	mod->mutates_policy = mutates_policy;
+	fn_struct->name = strdup(SECHK_MOD_FN_RUN);
+	fn_struct->fn = fake_run;
+	CU_ASSERT_FATAL(mod->name != NULL && fn_struct->name != NULL);
+	CU_ASSERT_FATAL(apol_vector_append(mod->functions, fn_struct) == 0);
+	if (dependency != NULL)
+		CU_ASSERT_FATAL(apol_vector_append(mod->dependencies, sechk_name_value_new("module", dependency)) == 0);
+	CU_ASSERT_FATAL(apol_vector_append(lib->modules, mod) == 0);
+	return mod;
+}
+
+static void run_modules_exclusive(void)
+{
+	sechk_lib_t *lib = sechk_lib_new();
+	sechk_module_t *mod;
+	char name[32];
+	size_t i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(lib);
+	for (i = 0; i < apol_vector_get_size(lib->modules); i++) {
+		mod = apol_vector_get_element(lib->modules, i);
+		mod->selected = false;
+	}
+	for (i = 0; i < NUM_READERS; i++) {
+		snprintf(name, sizeof(name), "fake_reader_%zu", i);
+		fake_module_add(lib, name, false, NULL);
+	}
+	for (i = 0; i < NUM_WRITERS; i++) {
+		snprintf(name, sizeof(name), "fake_writer_%zu", i);
+		fake_module_add(lib, name, true, NULL);
+	}
+	fake_module_add(lib, "fake_dependent", false, "fake_writer_0");
+	CU_ASSERT_FATAL(sechk_lib_set_num_jobs(NUM_READERS, lib) == 0);
+
+	fake_running = fake_writers_running = fake_max_running = 0;
+	fake_overlapped = false;
+	CU_ASSERT(sechk_lib_run_modules(lib) == 0);
+	for (i = 0; i < apol_vector_get_size(lib->modules); i++) {
+		mod = apol_vector_get_element(lib->modules, i);
+		if (mod->selected)
+			CU_ASSERT(mod->run_done);
+	}
+	CU_ASSERT(!fake_overlapped);
+	CU_ASSERT(fake_max_running > 1);
+	sechk_lib_destroy(&lib);
+}
+
+/**
+ *  Run the domain transition modules with the given number of jobs,
+ *  and record how many items each module found, or (size_t) -1 for a
+ *  module whose requirements were not met.
+ */
+static void run_modules_dta(size_t num_jobs, const char *const *names, size_t num_names, size_t * num_items)
+{
+	sechk_lib_t *lib = sechk_lib_new();
+	apol_policy_path_t *path = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, POLICY, NULL);
+	sechk_module_t *mod;
+	size_t i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(lib);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(path);
+	CU_ASSERT_FATAL(sechk_lib_load_policy(path, lib) == 0);
+	for (i = 0; i < apol_vector_get_size(lib->modules); i++) {
+		mod = apol_vector_get_element(lib->modules, i);
+		mod->selected = false;
+	}
+	for (i = 0; i < num_names; i++) {
+		mod = sechk_lib_get_module(names[i], lib);
+		CU_ASSERT_PTR_NOT_NULL_FATAL(mod);
+		CU_ASSERT(mod->mutates_policy);
+		mod->selected = true;
+	}
+	CU_ASSERT_FATAL(sechk_lib_check_module_dependencies(lib) == 0);
+	/* unreachable_doms needs the system's default contexts, and is
+	 * deselected where they are missing */
+	sechk_lib_check_module_requirements(lib);
+	CU_ASSERT_FATAL(sechk_lib_get_module(names[0], lib)->selected);
+	CU_ASSERT_FATAL(sechk_lib_set_num_jobs(num_jobs, lib) == 0);
+	CU_ASSERT_FATAL(sechk_lib_init_modules(lib) == 0);
+	CU_ASSERT_FATAL(sechk_lib_run_modules(lib) >= 0);
+	for (i = 0; i < num_names; i++) {
+		mod = sechk_lib_get_module(names[i], lib);
+		num_items[i] = (size_t) - 1;
+		if (!mod->selected)
+			continue;
+		CU_ASSERT_PTR_NOT_NULL_FATAL(mod->result);
+		num_items[i] = apol_vector_get_size(mod->result->items);
+	}
+	sechk_lib_destroy(&lib);
+}
+
+static void run_modules_domain_trans(void)
+{
+	const char *names[] = { "inc_dom_trans", "unreachable_doms" };
+	size_t num_names = sizeof(names) / sizeof(names[0]), serial[2], concurrent[2], i;
+
+	run_modules_dta(1, names, num_names, serial);
+	run_modules_dta(4, names, num_names, concurrent);
+	for (i = 0; i < num_names; i++)
+		CU_ASSERT_EQUAL(serial[i], concurrent[i]);
+}
+
+/**
+ *  Check that the library's shared index finds the same allow rules
+ *  for every type as a full apol query, with the type as an indirect
+ *  source.
+ */
+static void rule_index_check(sechk_lib_t * lib, const char *class_name)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(lib->policy);
+	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *type;
+	const char *name;
+	apol_avrule_query_t *aq = apol_avrule_query_create();
+	apol_vector_t *v = NULL, *expected = NULL;
+	size_t i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(aq);
+	CU_ASSERT_FATAL(apol_avrule_query_set_rules(lib->policy, aq, QPOL_RULE_ALLOW) == 0);
+	CU_ASSERT_FATAL(apol_avrule_query_append_class(lib->policy, aq, class_name) == 0);
+	CU_ASSERT_FATAL(qpol_policy_get_type_iter(q, &iter) == 0);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&type) == 0);
+		CU_ASSERT_FATAL(qpol_type_get_name(q, type, &name) == 0);
+		CU_ASSERT_FATAL(apol_avrule_query_set_source(lib->policy, aq, name, 1) == 0);
+		CU_ASSERT_FATAL(apol_avrule_get_by_query(lib->policy, aq, &expected) == 0);
+		CU_ASSERT_FATAL(sechk_lib_get_avrules(lib, QPOL_RULE_ALLOW, type, NULL, class_name, &v) == 0);
+		apol_vector_sort(expected, NULL, NULL);
+		apol_vector_sort(v, NULL, NULL);
+		CU_ASSERT(apol_vector_compare(v, expected, NULL, NULL, &i) == 0);
+		apol_vector_destroy(&expected);
+		apol_vector_destroy(&v);
+	}
+	qpol_iterator_destroy(&iter);
+	apol_avrule_query_destroy(&aq);
+}
+
+static void run_modules_rule_index(void)
+{
+	sechk_lib_t *lib = sechk_lib_new();
+	apol_policy_path_t *path = apol_policy_path_create(APOL_POLICY_PATH_TYPE_MONOLITHIC, POLICY, NULL);
+	const sechk_rule_index_t *idx;
+	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *type;
+	sechk_module_t *mod;
+	apol_vector_t *v = NULL;
+	size_t i;
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(lib);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(path);
+	CU_ASSERT_FATAL(sechk_lib_load_policy(path, lib) == 0);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(lib->rule_index);
+	idx = lib->rule_index;
+	rule_index_check(lib, NULL);
+	rule_index_check(lib, "file");
+
+	/* a class not within the policy matches nothing */
+	CU_ASSERT_FATAL(qpol_policy_get_type_iter(apol_policy_get_qpol(lib->policy), &iter) == 0);
+	CU_ASSERT_FATAL(qpol_iterator_get_item(iter, (void **)&type) == 0);
+	qpol_iterator_destroy(&iter);
+	CU_ASSERT_FATAL(sechk_lib_get_avrules(lib, QPOL_RULE_ALLOW, type, NULL, "no_such_class", &v) == 0);
+	CU_ASSERT(apol_vector_get_size(v) == 0);
+	apol_vector_destroy(&v);
+
+	/* run modules that query the index, and check that they left it
+	 * as it was */
+	for (i = 0; i < apol_vector_get_size(lib->modules); i++) {
+		mod = apol_vector_get_element(lib->modules, i);
+		mod->selected = (strcmp(mod->name, "inc_net_access") == 0);
+	}
+	CU_ASSERT_FATAL(sechk_lib_check_module_dependencies(lib) == 0);
+	sechk_lib_check_module_requirements(lib);
+	CU_ASSERT_FATAL(sechk_lib_get_module("inc_net_access", lib)->selected);
+	CU_ASSERT_FATAL(sechk_lib_set_num_jobs(4, lib) == 0);
+	CU_ASSERT_FATAL(sechk_lib_init_modules(lib) == 0);
+	CU_ASSERT_FATAL(sechk_lib_run_modules(lib) >= 0);
+	CU_ASSERT(sechk_lib_get_module("inc_net_access", lib)->run_done);
+	CU_ASSERT(lib->rule_index == idx);
+	rule_index_check(lib, NULL);
+	sechk_lib_destroy(&lib);
+}
+
+CU_TestInfo run_modules_tests[] = {
+	{"modifying modules run alone", run_modules_exclusive}
+	,
+	{"domain transition modules", run_modules_domain_trans}
+	,
+	{"shared rule index", run_modules_rule_index}
+	,
+	CU_TEST_INFO_NULL
+};
+
+int run_modules_init()
+{
+	return 0;
+}
+
+int run_modules_cleanup()
+{
+	return 0;
+}
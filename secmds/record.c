@@ -0,0 +1,229 @@
+/**
+ * @file
+ *
+ * Implementation of structured output for the command line tools.
+ *
+ * Copyright (C) 2009 Tresys Technology, LLC
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include "record.h"
+
+#include <errno.h>
+#include <string.h>
+
+int record_format_from_str(const char *str, record_format_e * format)
+{
+	if (strcmp(str, "text") == 0) {
+		*format = RECORD_FORMAT_TEXT;
+	} else if (strcmp(str, "json") == 0) {
+		*format = RECORD_FORMAT_JSON;
+	} else if (strcmp(str, "jsonl") == 0) {
+		*format = RECORD_FORMAT_JSONL;
+	} else if (strcmp(str, "tsv") == 0) {
+		*format = RECORD_FORMAT_TSV;
+	} else {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Write a string, escaping it a character at a time so that nothing
+ * needs to be allocated.
+ */
+static void record_escape(record_writer_t * w, const char *s)
+{
+	FILE *fp = w->fp;
+	for (; *s != '\0'; s++) {
+		unsigned char c = (unsigned char)*s;
+		if (w->format == RECORD_FORMAT_TSV) {
+			switch (c) {
+			case '\t':
+				fputs("\\t", fp);
+				break;
+			case '\n':
+				fputs("\\n", fp);
+				break;
+			case '\\':
+				fputs("\\\\", fp);
+				break;
+			default:
+				putc(c, fp);
+			}
+		} else {
+			if (c == '"' || c == '\\') {
+				putc('\\', fp);
+				putc(c, fp);
+			} else if (c < 0x20) {
+				fprintf(fp, "\\u%04x", c);
+			} else {
+				putc(c, fp);
+			}
+		}
+	}
+}
+
+/**
+ * Position the writer at a column: for TSV emit separators up to it,
+ * for JSON emit the field's key.
+ */
+static void record_field(record_writer_t * w, size_t column)
+{
+	if (w->format == RECORD_FORMAT_TSV) {
+		for (; w->column < column; w->column++) {
+			putc('\t', w->fp);
+		}
+	} else {
+		if (w->num_fields > 0) {
+			putc(',', w->fp);
+		}
+		putc('"', w->fp);
+		record_escape(w, w->columns[column]);
+		fputs("\":", w->fp);
+	}
+	w->num_fields++;
+}
+
+void record_writer_init(record_writer_t * w, FILE * fp, record_format_e format, const char *const *columns, size_t num_columns)
+{
+	size_t i;
+	memset(w, 0, sizeof(*w));
+	w->fp = fp;
+	w->format = format;
+	w->columns = columns;
+	w->num_columns = num_columns;
+	if (format == RECORD_FORMAT_TSV) {
+		for (i = 0; i < num_columns; i++) {
+			if (i > 0) {
+				putc('\t', fp);
+			}
+			record_escape(w, columns[i]);
+		}
+		putc('\n', fp);
+	}
+}
+
+void record_writer_finish(record_writer_t * w)
+{
+	if (w->format == RECORD_FORMAT_JSON) {
+		fputs(w->num_records > 0 ? "\n]\n" : "[]\n", w->fp);
+	}
+	fflush(w->fp);
+}
+
+void record_begin(record_writer_t * w)
+{
+	w->column = 0;
+	w->num_fields = 0;
+	switch (w->format) {
+	case RECORD_FORMAT_JSON:
+		fputs(w->num_records > 0 ? ",\n{" : "[\n{", w->fp);
+		break;
+	case RECORD_FORMAT_JSONL:
+		putc('{', w->fp);
+		break;
+	default:
+		break;
+	}
+}
+
+void record_end(record_writer_t * w)
+{
+	if (w->format == RECORD_FORMAT_TSV) {
+		if (w->num_columns > 0) {
+			record_field(w, w->num_columns - 1);
+		}
+		putc('\n', w->fp);
+	} else {
+		putc('}', w->fp);
+		if (w->format == RECORD_FORMAT_JSONL) {
+			putc('\n', w->fp);
+		}
+	}
+	w->num_records++;
+}
+
+void record_str(record_writer_t * w, size_t column, const char *value)
+{
+	if (value == NULL) {
+		return;
+	}
+	record_field(w, column);
+	if (w->format == RECORD_FORMAT_TSV) {
+		record_escape(w, value);
+	} else {
+		putc('"', w->fp);
+		record_escape(w, value);
+		putc('"', w->fp);
+	}
+}
+
+void record_ulong(record_writer_t * w, size_t column, unsigned long value)
+{
+	record_field(w, column);
+	fprintf(w->fp, "%lu", value);
+}
+
+void record_bool(record_writer_t * w, size_t column, int value)
+{
+	record_field(w, column);
+	fputs(value ? "true" : "false", w->fp);
+}
+
+void record_list_begin(record_writer_t * w, size_t column)
+{
+	record_field(w, column);
+	w->num_items = 0;
+	if (w->format != RECORD_FORMAT_TSV) {
+		putc('[', w->fp);
+	}
+}
+
+void record_list_item_prefix(record_writer_t * w, const char *prefix, const char *value)
+{
+	if (w->format == RECORD_FORMAT_TSV) {
+		if (w->num_items > 0) {
+			putc(' ', w->fp);
+		}
+		record_escape(w, prefix);
+		record_escape(w, value);
+	} else {
+		if (w->num_items > 0) {
+			putc(',', w->fp);
+		}
+		putc('"', w->fp);
+		record_escape(w, prefix);
+		record_escape(w, value);
+		putc('"', w->fp);
+	}
+	w->num_items++;
+}
+
+void record_list_item(record_writer_t * w, const char *value)
+{
+	record_list_item_prefix(w, "", value);
+}
+
+void record_list_end(record_writer_t * w)
+{
+	if (w->format != RECORD_FORMAT_TSV) {
+		putc(']', w->fp);
+	}
+}
@@ -0,0 +1,103 @@
+/**
+ * @file
+ *
+ * Structured output for the command line tools.  A record is a flat
+ * set of named fields, each either a string, a number, a boolean, or
+ * a list of strings.  Records are written straight to a stream as
+ * their fields are given, so no record is ever held in memory.
+ *
+ * Copyright (C) 2009 Tresys Technology, LLC
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SECMDS_RECORD_H
+#define SECMDS_RECORD_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+typedef enum record_format
+{
+	/** the tool's usual human readable output */
+	RECORD_FORMAT_TEXT = 0,
+	/** a single JSON array of objects */
+	RECORD_FORMAT_JSON,
+	/** one JSON object per line */
+	RECORD_FORMAT_JSONL,
+	/** a header row of column names, then one tab separated row per
+	 *  record; list items are separated by spaces */
+	RECORD_FORMAT_TSV
+} record_format_e;
+
+/**
+ * Writer state.  Every record written by a writer has the same
+ * columns; fields must be given in increasing column order, and
+ * columns without a field are omitted (JSON) or left empty (TSV).
+ */
+typedef struct record_writer
+{
+	FILE *fp;
+	record_format_e format;
+	const char *const *columns;
+	size_t num_columns;
+	size_t num_records;
+	/** column at which the next field will be written */
+	size_t column;
+	/** number of fields within the current record */
+	size_t num_fields;
+	/** number of items within the current list */
+	size_t num_items;
+} record_writer_t;
+
+/**
+ * Convert a format name ("text", "json", "jsonl", or "tsv").
+ *
+ * @return 0 on success, < 0 if the name is not recognized.
+ */
+extern int record_format_from_str(const char *str, record_format_e * format);
+
+/**
+ * Start writing records.  For TSV this writes the header row.
+ *
+ * @param w Writer to initialize.
+ * @param fp Stream to which to write.
+ * @param format Output format; must not be RECORD_FORMAT_TEXT.
+ * @param columns Names of the columns, which must remain valid until
+ * record_writer_finish() is called.
+ * @param num_columns Number of names in columns.
+ */
+extern void record_writer_init(record_writer_t * w, FILE * fp, record_format_e format, const char *const *columns,
+			       size_t num_columns);
+
+/**
+ * Finish writing records.  For JSON this closes the array.
+ */
+extern void record_writer_finish(record_writer_t * w);
+
+extern void record_begin(record_writer_t * w);
+extern void record_end(record_writer_t * w);
+
+extern void record_str(record_writer_t * w, size_t column, const char *value);
+extern void record_ulong(record_writer_t * w, size_t column, unsigned long value);
+extern void record_bool(record_writer_t * w, size_t column, int value);
+
+extern void record_list_begin(record_writer_t * w, size_t column);
+extern void record_list_item(record_writer_t * w, const char *value);
+/** Add a list item made of a prefix followed by a value. */
+extern void record_list_item_prefix(record_writer_t * w, const char *prefix, const char *value);
+extern void record_list_end(record_writer_t * w);
+
+#endif
@@ -37,8 +37,11 @@
 
 /* libqpol */
 #include <qpol/policy.h>
+#include <qpol/summary_query.h>
 #include <qpol/util.h>
 
+#include "record.h"
+
 /* other */
 #include <errno.h>
 #include <stdlib.h>
@@ -54,6 +57,16 @@
 
 static char *policy_file = NULL;
 
+/* columns of structured output */
+enum component_column
+{
+	COL_KIND = 0, COL_NAME, COL_MEMBERS, COL_STATE, NUM_COLUMNS
+};
+static const char *const component_columns[NUM_COLUMNS] = { "kind", "name", "members", "state" };
+
+/* if non-NULL, write structured records here instead of text */
+static record_writer_t *out = NULL;
+
 static int print_type_attrs(FILE * fp, const qpol_type_t * type_datum, const apol_policy_t * policydb, const int expand);
 static int print_attr_types(FILE * fp, const qpol_type_t * type_datum, const apol_policy_t * policydb, const int expand);
 static int print_user_roles(FILE * fp, const qpol_user_t * user_datum, const apol_policy_t * policydb, const int expand);
@@ -70,7 +83,7 @@ enum opt_values
 	OPT_INITIALSID, OPT_FS_USE, OPT_GENFSCON,
 	OPT_NETIFCON, OPT_NODECON, OPT_PORTCON, OPT_PROTOCOL,
 	OPT_PERMISSIVE, OPT_POLCAP,
-	OPT_ALL, OPT_STATS, OPT_CONSTRAIN
+	OPT_ALL, OPT_STATS, OPT_CONSTRAIN, OPT_FORMAT
 };
 
 static struct option const longopts[] = {
@@ -96,6 +109,7 @@ static struct option const longopts[] = {
 	{"all", no_argument, NULL, OPT_ALL},
 	{"line-breaks", no_argument, NULL, 'l'},
 	{"expand", no_argument, NULL, 'x'},
+	{"format", required_argument, NULL, OPT_FORMAT},
 	{"help", no_argument, NULL, 'h'},
 	{"version", no_argument, NULL, 'V'},
 	{NULL, 0, NULL, 0}
@@ -140,6 +154,7 @@ void usage(const char *program_name, int brief)
 	printf("  -x, --expand                     show more info for specified components\n");
 	printf("  --stats                          print useful policy statistics\n");
 	printf("  -l, --line-breaks                print line breaks in constrain statements\n");
+	printf("  --format=FORMAT                  output text (default), json, jsonl, or tsv\n");
 	printf("  -h, --help                       print this help text and exit\n");
 	printf("  -V, --version                    print version information and exit\n");
 	printf("\n");
@@ -151,6 +166,29 @@ void usage(const char *program_name, int brief)
 	printf("policy, will be opened if no policy is provided.\n\n");
 }
 
+/** pairs of counts printed by print_stats(), one pair per line */
+static const struct
+{
+	const char *label;
+	qpol_summary_count_e which;
+} stats_rows[] = {
+	{"Classes:      ", QPOL_SUMMARY_CLASSES}, {"Permissions:  ", QPOL_SUMMARY_PERMS},
+	{"Sensitivities:", QPOL_SUMMARY_LEVELS}, {"Categories:   ", QPOL_SUMMARY_CATS},
+	{"Types:        ", QPOL_SUMMARY_TYPES}, {"Attributes:   ", QPOL_SUMMARY_ATTRIBUTES},
+	{"Users:        ", QPOL_SUMMARY_USERS}, {"Roles:        ", QPOL_SUMMARY_ROLES},
+	{"Booleans:     ", QPOL_SUMMARY_BOOLS}, {"Cond. Expr.:  ", QPOL_SUMMARY_CONDS},
+	{"Allow:        ", QPOL_SUMMARY_ALLOWS}, {"Neverallow:   ", QPOL_SUMMARY_NEVERALLOWS},
+	{"Auditallow:   ", QPOL_SUMMARY_AUDITALLOWS}, {"Dontaudit:    ", QPOL_SUMMARY_DONTAUDITS},
+	{"Type_trans:   ", QPOL_SUMMARY_TYPE_TRANS}, {"Type_change:  ", QPOL_SUMMARY_TYPE_CHANGES},
+	{"Type_member:  ", QPOL_SUMMARY_TYPE_MEMBERS}, {"Role allow:   ", QPOL_SUMMARY_ROLE_ALLOWS},
+	{"Role_trans:   ", QPOL_SUMMARY_ROLE_TRANS}, {"Range_trans:  ", QPOL_SUMMARY_RANGE_TRANS},
+	{"Constraints:  ", QPOL_SUMMARY_CONSTRAINTS}, {"Validatetrans:", QPOL_SUMMARY_VALIDATETRANS},
+	{"Initial SIDs: ", QPOL_SUMMARY_ISIDS}, {"Fs_use:       ", QPOL_SUMMARY_FS_USES},
+	{"Genfscon:     ", QPOL_SUMMARY_GENFSCONS}, {"Portcon:      ", QPOL_SUMMARY_PORTCONS},
+	{"Netifcon:     ", QPOL_SUMMARY_NETIFCONS}, {"Nodecon:      ", QPOL_SUMMARY_NODECONS},
+	{"Permissives:  ", QPOL_SUMMARY_PERMISSIVES}, {"Polcap:       ", QPOL_SUMMARY_POLCAPS}
+};
+
 /**
  * Prints statistics regarding a policy's components.
  *
@@ -162,262 +200,31 @@ void usage(const char *program_name, int brief)
  */
 static int print_stats(FILE * fp, const apol_policy_t * policydb)
 {
-	int retval = -1;
-	unsigned int n_perms = 0;
-	qpol_iterator_t *iter = NULL;
-	apol_type_query_t *type_query = NULL;
-	apol_attr_query_t *attr_query = NULL;
-	apol_perm_query_t *perm_query = NULL;
-	apol_vector_t *perms = NULL, *v = NULL;
 	qpol_policy_t *q = apol_policy_get_qpol(policydb);
 	char *str = NULL;
-	size_t n_types = 0, n_attrs = 0;
-	size_t n_classes = 0, n_users = 0, n_roles = 0, n_bools = 0, n_conds = 0, n_levels = 0,
-		n_cats = 0, n_portcons = 0, n_netifcons = 0, n_nodecons = 0, n_fsuses = 0,
-		n_genfscons = 0, n_allows = 0, n_neverallows = 0, n_auditallows = 0, n_dontaudits = 0,
-		n_typetrans = 0, n_typechanges = 0, n_typemembers = 0, n_isids = 0, n_roleallows = 0,
-		n_roletrans = 0, n_rangetrans = 0, n_constr = 0, n_vtrans = 0, n_permissives = 0,
-		n_polcaps = 0;
+	size_t i, n1, n2;
 
 	assert(policydb != NULL);
 
 	fprintf(fp, "\nStatistics for policy file: %s\n", policy_file);
 
 	if (!(str = apol_policy_get_version_type_mls_str(policydb)))
-		goto cleanup;
+		return -1;
 
 	fprintf(fp, "Policy Version & Type: ");
 	fprintf(fp, "%s\n", str);
 	free(str);
 
-	if (qpol_policy_get_class_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_classes))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-
-	perm_query = apol_perm_query_create();
-	if (!perm_query)
-		goto cleanup;
-
-	/* Match all perms */
-	if (apol_perm_get_by_query(policydb, perm_query, &perms))
-		goto cleanup;
-
-	n_perms = apol_vector_get_size(perms);
-	apol_perm_query_destroy(&perm_query);
-	apol_vector_destroy(&perms);
-	fprintf(fp, "\n   Classes:       %7zd    Permissions:   %7d\n", n_classes, n_perms);
-
-	/* sensitivities/categories */
-	if (qpol_policy_get_level_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_levels))
-		goto cleanup;
-
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_cat_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_cats))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Sensitivities: %7zd    Categories:    %7zd\n", n_levels, n_cats);
-
-	/* types */
-	type_query = apol_type_query_create();
-	if (!type_query)
-		goto cleanup;
-	if (apol_type_get_by_query(policydb, type_query, &v) < 0)
-		goto cleanup;
-
-	n_types = apol_vector_get_size(v);
-	apol_type_query_destroy(&type_query);
-	apol_vector_destroy(&v);
-
-	attr_query = apol_attr_query_create();
-	if (!attr_query)
-		goto cleanup;
-	if (apol_attr_get_by_query(policydb, attr_query, &v) < 0)
-		goto cleanup;
-
-	n_attrs = apol_vector_get_size(v);
-	apol_attr_query_destroy(&attr_query);
-	apol_vector_destroy(&v);
-
-	fprintf(fp, "   Types:         %7zd    Attributes:    %7zd\n", n_types, n_attrs);
-	qpol_iterator_destroy(&iter);
-
-	/* users/roles */
-	if (qpol_policy_get_user_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_users))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_role_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_roles))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Users:         %7zd    Roles:         %7zd\n", n_users, n_roles);
-
-	/* booleans/cond. exprs. */
-	if (qpol_policy_get_bool_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_bools))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_cond_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_conds))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Booleans:      %7zd    Cond. Expr.:   %7zd\n", n_bools, n_conds);
-
-	/* allow/neverallow */
-	if (qpol_policy_get_avrule_iter(q, QPOL_RULE_ALLOW, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_allows))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_has_capability(q, QPOL_CAP_NEVERALLOW)) {
-		if (qpol_policy_get_avrule_iter(q, QPOL_RULE_NEVERALLOW, &iter))
-			goto cleanup;
-		if (qpol_iterator_get_size(iter, &n_neverallows))
-			goto cleanup;
-	} else {
-		n_neverallows = 0;
+	/* every count was taken when the policy's summary was built */
+	fprintf(fp, "\n");
+	for (i = 0; i + 1 < sizeof(stats_rows) / sizeof(stats_rows[0]); i += 2) {
+		if (qpol_summary_get_count(q, stats_rows[i].which, &n1) || qpol_summary_get_count(q, stats_rows[i + 1].which, &n2))
+			return -1;
+		fprintf(fp, "   %s %7zd    %s %7zd\n", stats_rows[i].label, n1, stats_rows[i + 1].label, n2);
 	}
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Allow:         %7zd    Neverallow:    %7zd\n", n_allows, n_neverallows);
-
-	/* auditallow/dontaudit */
-	if (qpol_policy_get_avrule_iter(q, QPOL_RULE_AUDITALLOW, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_auditallows))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_avrule_iter(q, QPOL_RULE_DONTAUDIT, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_dontaudits))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Auditallow:    %7zd    Dontaudit:     %7zd\n", n_auditallows, n_dontaudits);
-
-	/* type_transition/type_change */
-	if (qpol_policy_get_terule_iter(q, QPOL_RULE_TYPE_TRANS, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_typetrans))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_terule_iter(q, QPOL_RULE_TYPE_CHANGE, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_typechanges))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Type_trans:    %7zd    Type_change:   %7zd\n", n_typetrans, n_typechanges);
-
-	/* type_member/role allow */
-	if (qpol_policy_get_terule_iter(q, QPOL_RULE_TYPE_MEMBER, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_typemembers))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_role_allow_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_roleallows))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Type_member:   %7zd    Role allow:    %7zd\n", n_typemembers, n_roleallows);
-
-	/* role_trans/range_trans */
-	if (qpol_policy_get_role_trans_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_roletrans))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_range_trans_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_rangetrans))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Role_trans:    %7zd    Range_trans:   %7zd\n", n_roletrans, n_rangetrans);
-
-	/* constraints/validatetrans */
-	if (qpol_policy_get_constraint_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_constr))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_validatetrans_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_vtrans))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Constraints:   %7zd    Validatetrans: %7zd\n", n_constr, n_vtrans);
-
-	/* isids/fs_use */
-	if (qpol_policy_get_isid_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_isids))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_fs_use_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_fsuses))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Initial SIDs:  %7zd    Fs_use:        %7zd\n", n_isids, n_fsuses);
-
-	/* genfscon/portcon */
-	if (qpol_policy_get_genfscon_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_genfscons))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_portcon_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_portcons))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Genfscon:      %7zd    Portcon:       %7zd\n", n_genfscons, n_portcons);
-
-	/* netifcon/nodecon */
-	if (qpol_policy_get_netifcon_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_netifcons))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_nodecon_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_nodecons))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Netifcon:      %7zd    Nodecon:       %7zd\n", n_netifcons, n_nodecons);
-
-	/* permissives/polcaps */
-	if (qpol_policy_get_permissive_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_permissives))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	if (qpol_policy_get_polcap_iter(q, &iter))
-		goto cleanup;
-	if (qpol_iterator_get_size(iter, &n_polcaps))
-		goto cleanup;
-	qpol_iterator_destroy(&iter);
-	fprintf(fp, "   Permissives:   %7zd    Polcap:        %7zd\n", n_permissives, n_polcaps);
-	
 	fprintf(fp, "\n");
 
-	retval = 0;
-      cleanup:
-	qpol_iterator_destroy(&iter);
-	apol_type_query_destroy(&type_query);
-	apol_attr_query_destroy(&attr_query);
-	apol_perm_query_destroy(&perm_query);
-	apol_vector_destroy(&v);
-	apol_vector_destroy(&perms);
-	return retval;
+	return 0;
 }
 
 /**
@@ -453,7 +260,8 @@ static int print_classes(FILE * fp, const char *name, int expand, const apol_pol
 			goto cleanup;
 		if (qpol_iterator_get_size(iter, &n_classes))
 			goto cleanup;
-		fprintf(fp, "Object classes: %d\n", (int)n_classes);
+		if (!out)
+			fprintf(fp, "Object classes: %d\n", (int)n_classes);
 
 		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
 			if (qpol_iterator_get_item(iter, (void **)&class_datum))
@@ -489,7 +297,6 @@ static int print_types(FILE * fp, const char *name, int expand, const apol_polic
 	int retval = -1;
 	const qpol_type_t *type_datum = NULL;
 	qpol_iterator_t *iter = NULL;
-	apol_vector_t *type_vector = NULL;
 	qpol_policy_t *q = apol_policy_get_qpol(policydb);
 	size_t vector_sz;
 
@@ -499,12 +306,10 @@ static int print_types(FILE * fp, const char *name, int expand, const apol_polic
 	}
 
 	/* Find the number of types in the policy */
-	if (apol_type_get_by_query(policydb, NULL, &type_vector))
+	if (qpol_summary_get_count(q, QPOL_SUMMARY_TYPES, &vector_sz))
 		goto cleanup;
-	vector_sz = apol_vector_get_size(type_vector);
-	apol_vector_destroy(&type_vector);
 
-	if (name == NULL) {
+	if (name == NULL && !out) {
 		fprintf(fp, "\nTypes: %zd\n", vector_sz);
 	}
 
@@ -586,7 +391,8 @@ static int print_attribs(FILE * fp, const char *name, int expand, const apol_pol
 		apol_attr_query_destroy(&attr_query);
 		n_attrs = apol_vector_get_size(v);
 
-		fprintf(fp, "\nAttributes: %zd\n", n_attrs);
+		if (!out)
+			fprintf(fp, "\nAttributes: %zd\n", n_attrs);
 		for (i = 0; i < n_attrs; i++) {
 			/* get qpol_type_t* item from vector */
 			type_datum = (qpol_type_t *) apol_vector_get_element(v, (size_t) i);
@@ -638,7 +444,8 @@ static int print_roles(FILE * fp, const char *name, int expand, const apol_polic
 			goto cleanup;
 		if (qpol_iterator_get_size(iter, &n_roles))
 			goto cleanup;
-		fprintf(fp, "\nRoles: %d\n", (int)n_roles);
+		if (!out)
+			fprintf(fp, "\nRoles: %d\n", (int)n_roles);
 
 		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
 			if (qpol_iterator_get_item(iter, (void **)&role_datum))
@@ -688,7 +495,8 @@ static int print_booleans(FILE * fp, const char *name, int expand, const apol_po
 			goto cleanup;
 		if (qpol_iterator_get_size(iter, &n_bools))
 			goto cleanup;
-		fprintf(fp, "\nConditional Booleans: %zd\n", n_bools);
+		if (!out)
+			fprintf(fp, "\nConditional Booleans: %zd\n", n_bools);
 		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
 			if (qpol_iterator_get_item(iter, (void **)&bool_datum))
 				goto cleanup;
@@ -738,7 +546,8 @@ static int print_users(FILE * fp, const char *name, int expand, const apol_polic
 			goto cleanup;
 		if (qpol_iterator_get_size(iter, &n_users))
 			goto cleanup;
-		fprintf(fp, "\nUsers: %d\n", (int)n_users);
+		if (!out)
+			fprintf(fp, "\nUsers: %d\n", (int)n_users);
 
 		for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
 			if (qpol_iterator_get_item(iter, (void **)&user_datum))
@@ -1293,7 +1102,8 @@ static int print_permissives(FILE * fp, const char *name, int expand, const apol
 		goto cleanup;
 	if (qpol_iterator_get_size(iter, &n_permissives))
 		goto cleanup;
-	fprintf(fp, "\nPermissive Types: %zd\n", n_permissives);
+	if (!out)
+		fprintf(fp, "\nPermissive Types: %zd\n", n_permissives);
 	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
 		if (qpol_iterator_get_item(iter, (void **)&permissive_datum))
 			goto cleanup;
@@ -1301,6 +1111,13 @@ static int print_permissives(FILE * fp, const char *name, int expand, const apol
 			goto cleanup;
 		if (!tmp)
 			goto cleanup;
+		if (out) {
+			record_begin(out);
+			record_str(out, COL_KIND, "permissive");
+			record_str(out, COL_NAME, tmp);
+			record_end(out);
+			continue;
+		}
 		fprintf(fp, "   %s\n", tmp);
 	}
 		
@@ -1338,7 +1155,8 @@ static int print_polcaps(FILE * fp, const char *name, int expand, const apol_pol
 		goto cleanup;
 	if (qpol_iterator_get_size(iter, &n_polcaps))
 		goto cleanup;
-	fprintf(fp, "\nPolicy Capabilities: %zd\n", n_polcaps);
+	if (!out)
+		fprintf(fp, "\nPolicy Capabilities: %zd\n", n_polcaps);
 	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
 		if (qpol_iterator_get_item(iter, (void **)&polcap_datum))
 			goto cleanup;
@@ -1346,6 +1164,13 @@ static int print_polcaps(FILE * fp, const char *name, int expand, const apol_pol
 			goto cleanup;
 		if (!tmp)
 			goto cleanup;
+		if (out) {
+			record_begin(out);
+			record_str(out, COL_KIND, "polcap");
+			record_str(out, COL_NAME, tmp);
+			record_end(out);
+			continue;
+		}
 		fprintf(fp, "   %s\n", tmp);
 	}
 	
@@ -1670,6 +1495,8 @@ int main(int argc, char **argv)
 	apol_policy_path_t *pol_path = NULL;
 	apol_vector_t *mod_paths = NULL;
 	apol_policy_path_type_e path_type = APOL_POLICY_PATH_TYPE_MONOLITHIC;
+	record_format_e format = RECORD_FORMAT_TEXT;
+	record_writer_t writer;
 
 	char *class_name, *type_name, *attrib_name, *role_name, *user_name, *isid_name, *bool_name, *sens_name, *cat_name,
 		*fsuse_type, *genfs_type, *netif_name, *node_addr, *permissive_name, *polcap_name, *port_num = NULL, *protocol = NULL;
@@ -1781,6 +1608,13 @@ int main(int argc, char **argv)
 		case OPT_STATS:
 			stats = 1;
 			break;
+		case OPT_FORMAT:
+			if (record_format_from_str(optarg, &format)) {
+				usage(argv[0], 1);
+				fprintf(stderr, "Unknown output format %s.\n", optarg);
+				exit(1);
+			}
+			break;
 		case 'h':	       /* help */
 			usage(argv[0], 0);
 			exit(0);
@@ -1804,7 +1638,20 @@ int main(int argc, char **argv)
 		stats = 1;
 	}
 
-	int policy_load_options = ((stats || all) ? 0 : QPOL_POLICY_OPTION_NO_RULES);
+	/* structured output covers the components that are simple lists
+	 * of names; --all limits itself to those */
+	if (format != RECORD_FORMAT_TEXT) {
+		if (stats || sens || cats || isids || fsuse || genfs || netif || node || port || constrain) {
+			usage(argv[0], 1);
+			fprintf(stderr, "--format supports only --class, --type, --attribute, --role, --user,\n"
+				"--bool, --permissive, --polcap, and --all.\n");
+			exit(1);
+		}
+		record_writer_init(&writer, stdout, format, component_columns, NUM_COLUMNS);
+		out = &writer;
+	}
+
+	int policy_load_options = ((stats || (all && !out)) ? 0 : QPOL_POLICY_OPTION_NO_RULES);
 
 	if (argc - optind < 1) {
 		rt = qpol_default_policy_find(&policy_file);
@@ -1867,8 +1714,18 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
+	/* counts and memberships are taken once, here, rather than by
+	 * walking the policy again for each component printed */
+	if (qpol_policy_build_summary(apol_policy_get_qpol(policydb))) {
+		ERR(policydb, "%s", strerror(errno));
+		apol_policy_destroy(&policydb);
+		apol_policy_path_destroy(&pol_path);
+		free(policy_file);
+		exit(1);
+	}
+
 	/* display requested info */
-	if (stats || all)
+	if (stats || (all && !out))
 		rc = print_stats(stdout, policydb);
 	if (classes || all)
 		rc = print_classes(stdout, class_name, expand, policydb);
@@ -1882,29 +1739,31 @@ int main(int argc, char **argv)
 		rc = print_users(stdout, user_name, expand, policydb);
 	if (bools || all)
 		rc = print_booleans(stdout, bool_name, expand, policydb);
-	if (sens || all)
+	if (sens || (all && !out))
 		rc = print_sens(stdout, sens_name, expand, policydb);
-	if (cats || all)
+	if (cats || (all && !out))
 		rc = print_cats(stdout, cat_name, expand, policydb);
-	if (fsuse || all)
+	if (fsuse || (all && !out))
 		rc = print_fsuse(stdout, fsuse_type, policydb);
-	if (genfs || all)
+	if (genfs || (all && !out))
 		rc = print_genfscon(stdout, genfs_type, policydb);
-	if (netif || all)
+	if (netif || (all && !out))
 		rc = print_netifcon(stdout, netif_name, policydb);
-	if (node || all)
+	if (node || (all && !out))
 		rc = print_nodecon(stdout, node_addr, policydb);
-	if (port || all)
+	if (port || (all && !out))
 		rc = print_portcon(stdout, port_num, protocol, policydb);
-	if (isids || all)
+	if (isids || (all && !out))
 		rc = print_isids(stdout, isid_name, expand, policydb);
 	if (permissives || all)
 		rc = print_permissives(stdout, permissive_name, expand, policydb);
 	if (polcaps || all)
 		rc = print_polcaps(stdout, polcap_name, expand, policydb);
-	if (constrain || all)
+	if (constrain || (all && !out))
 		rc = print_constraints(stdout, expand, policydb, linebreaks);
 
+	if (out)
+		record_writer_finish(out);
 	apol_policy_destroy(&policydb);
 	apol_policy_path_destroy(&pol_path);
 	free(policy_file);
@@ -1923,39 +1782,47 @@ int main(int argc, char **argv)
  */
 static int print_type_attrs(FILE * fp, const qpol_type_t * type_datum, const apol_policy_t * policydb, const int expand)
 {
-	int retval = -1;
-	qpol_iterator_t *iter = NULL;
 	unsigned char isattr, isalias;
 	const char *type_name = NULL, *attr_name = NULL;
-	const qpol_type_t *attr_datum = NULL;
+	const qpol_type_t *const *attrs = NULL;
+	size_t num_attrs = 0, i;
 	qpol_policy_t *q = apol_policy_get_qpol(policydb);
 
 	if (qpol_type_get_name(q, type_datum, &type_name))
-		goto cleanup;
+		return -1;
 	if (qpol_type_get_isattr(q, type_datum, &isattr))
-		goto cleanup;
+		return -1;
 	if (qpol_type_get_isalias(q, type_datum, &isalias))
-		goto cleanup;
-
-	if (!isattr && !isalias) {
+		return -1;
+	if (isattr || isalias)
+		return 0;
+	if (expand && qpol_summary_get_type_attrs(q, type_datum, &attrs, &num_attrs))
+		return -1;
+
+	if (out) {
+		record_begin(out);
+		record_str(out, COL_KIND, "type");
+		record_str(out, COL_NAME, type_name);
+		if (expand)
+			record_list_begin(out, COL_MEMBERS);
+	} else {
 		fprintf(fp, "   %s\n", type_name);
-		if (expand) {	       /* Print this type's attributes */
-			if (qpol_type_get_attr_iter(q, type_datum, &iter))
-				goto cleanup;
-			for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-				if (qpol_iterator_get_item(iter, (void **)&attr_datum))
-					goto cleanup;
-				if (qpol_type_get_name(q, attr_datum, &attr_name))
-					goto cleanup;
-				fprintf(fp, "      %s\n", attr_name);
-			}
-		}
 	}
-
-	retval = 0;
-      cleanup:
-	qpol_iterator_destroy(&iter);
-	return retval;
+	/* print this type's attributes */
+	for (i = 0; i < num_attrs; i++) {
+		if (qpol_type_get_name(q, attrs[i], &attr_name))
+			return -1;
+		if (out)
+			record_list_item(out, attr_name);
+		else
+			fprintf(fp, "      %s\n", attr_name);
+	}
+	if (out) {
+		if (expand)
+			record_list_end(out);
+		record_end(out);
+	}
+	return 0;
 }
 
 /**
@@ -1970,42 +1837,40 @@ static int print_type_attrs(FILE * fp, const qpol_type_t * type_datum, const apo
  */
 static int print_attr_types(FILE * fp, const qpol_type_t * type_datum, const apol_policy_t * policydb, const int expand)
 {
-	int retval = -1;
-	const qpol_type_t *attr_datum = NULL;
-	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *const *types = NULL;
 	const char *attr_name = NULL, *type_name = NULL;
 	qpol_policy_t *q = apol_policy_get_qpol(policydb);
-	unsigned char isattr;
+	size_t num_types = 0, i;
 
 	if (qpol_type_get_name(q, type_datum, &attr_name))
-		goto cleanup;
-	fprintf(fp, "   %s\n", attr_name);
-
-	if (expand) {
-		/* get an iterator over all types this attribute has */
-		if (qpol_type_get_isattr(q, type_datum, &isattr))
-			goto cleanup;
-		if (isattr) {	       /* sanity check */
-			if (qpol_type_get_type_iter(q, type_datum, &iter))
-				goto cleanup;
-			for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-				if (qpol_iterator_get_item(iter, (void **)&attr_datum))
-					goto cleanup;
-				if (qpol_type_get_name(q, attr_datum, &type_name))
-					goto cleanup;
-				fprintf(fp, "      %s\n", type_name);
-			}
-			qpol_iterator_destroy(&iter);
-
-		} else		       /* this should never happen */
-			goto cleanup;
-
+		return -1;
+	/* fails if type_datum is not an attribute, which should never happen */
+	if (expand && qpol_summary_get_attr_types(q, type_datum, &types, &num_types))
+		return -1;
+
+	if (out) {
+		record_begin(out);
+		record_str(out, COL_KIND, "attribute");
+		record_str(out, COL_NAME, attr_name);
+		if (expand)
+			record_list_begin(out, COL_MEMBERS);
+	} else {
+		fprintf(fp, "   %s\n", attr_name);
 	}
-
-	retval = 0;
-      cleanup:
-	qpol_iterator_destroy(&iter);
-	return retval;
+	for (i = 0; i < num_types; i++) {
+		if (qpol_type_get_name(q, types[i], &type_name))
+			return -1;
+		if (out)
+			record_list_item(out, type_name);
+		else
+			fprintf(fp, "      %s\n", type_name);
+	}
+	if (out) {
+		if (expand)
+			record_list_end(out);
+		record_end(out);
+	}
+	return 0;
 }
 
 /**
@@ -2033,6 +1898,27 @@ static int print_user_roles(FILE * fp, const qpol_user_t * user_datum, const apo
 
 	if (qpol_user_get_name(q, user_datum, &user_name))
 		goto cleanup;
+	if (out) {
+		record_begin(out);
+		record_str(out, COL_KIND, "user");
+		record_str(out, COL_NAME, user_name);
+		if (expand) {
+			if (qpol_user_get_role_iter(q, user_datum, &iter))
+				goto cleanup;
+			record_list_begin(out, COL_MEMBERS);
+			for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+				if (qpol_iterator_get_item(iter, (void **)&role_datum))
+					goto cleanup;
+				if (qpol_role_get_name(q, role_datum, &role_name))
+					goto cleanup;
+				record_list_item(out, role_name);
+			}
+			record_list_end(out);
+		}
+		record_end(out);
+		retval = 0;
+		goto cleanup;
+	}
 	fprintf(fp, "   %s\n", user_name);
 
 	if (expand) {
@@ -2092,13 +1978,32 @@ static int print_role_types(FILE * fp, const qpol_role_t * role_datum, const apo
 	int retval = -1;
 	const char *role_name = NULL, *type_name = NULL;
 	const qpol_role_t *dom_datum = NULL;
-	const qpol_type_t *type_datum = NULL;
+	const qpol_type_t *const *types = NULL;
 	qpol_iterator_t *iter = NULL;
 	qpol_policy_t *q = apol_policy_get_qpol(policydb);
-	size_t n_dom = 0, n_types = 0;
+	size_t n_dom = 0, n_types = 0, i;
 
 	if (qpol_role_get_name(q, role_datum, &role_name))
 		goto cleanup;
+	if (expand && qpol_summary_get_role_types(q, role_datum, &types, &n_types))
+		goto cleanup;
+	if (out) {
+		record_begin(out);
+		record_str(out, COL_KIND, "role");
+		record_str(out, COL_NAME, role_name);
+		if (expand) {
+			record_list_begin(out, COL_MEMBERS);
+			for (i = 0; i < n_types; i++) {
+				if (qpol_type_get_name(q, types[i], &type_name))
+					goto cleanup;
+				record_list_item(out, type_name);
+			}
+			record_list_end(out);
+		}
+		record_end(out);
+		retval = 0;
+		goto cleanup;
+	}
 	fprintf(fp, "   %s\n", role_name);
 
 	if (expand) {
@@ -2119,17 +2024,11 @@ static int print_role_types(FILE * fp, const qpol_role_t * role_datum, const apo
 		}
 		qpol_iterator_destroy(&iter);
 
-		if (qpol_role_get_type_iter(q, role_datum, &iter))
-			goto cleanup;
-		if (qpol_iterator_get_size(iter, &n_types))
-			goto cleanup;
-		if ((int)n_types > 0) {
+		if (n_types > 0) {
 			fprintf(fp, "      Types:\n");
 			/* print types */
-			for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
-				if (qpol_iterator_get_item(iter, (void **)&type_datum))
-					goto cleanup;
-				if (qpol_type_get_name(q, type_datum, &type_name))
+			for (i = 0; i < n_types; i++) {
+				if (qpol_type_get_name(q, types[i], &type_name))
 					goto cleanup;
 				fprintf(fp, "         %s\n", type_name);
 			}
@@ -2161,6 +2060,19 @@ static int print_bool_state(FILE * fp, const qpol_bool_t * bool_datum, const apo
 
 	if (qpol_bool_get_name(q, bool_datum, &bool_name))
 		goto cleanup;
+	if (out) {
+		record_begin(out);
+		record_str(out, COL_KIND, "bool");
+		record_str(out, COL_NAME, bool_name);
+		if (expand) {
+			if (qpol_bool_get_state(q, bool_datum, &state))
+				goto cleanup;
+			record_bool(out, COL_STATE, state);
+		}
+		record_end(out);
+		retval = 0;
+		goto cleanup;
+	}
 	fprintf(fp, "   %s", bool_name);
 
 	if (expand) {
@@ -2198,6 +2110,37 @@ static int print_class_perms(FILE * fp, const qpol_class_t * class_datum, const
 
 	if (qpol_class_get_name(q, class_datum, &class_name))
 		goto cleanup;
+	if (out) {
+		record_begin(out);
+		record_str(out, COL_KIND, "class");
+		record_str(out, COL_NAME, class_name);
+		if (expand) {
+			record_list_begin(out, COL_MEMBERS);
+			if (qpol_class_get_common(q, class_datum, &common_datum))
+				goto cleanup;
+			if (common_datum) {
+				if (qpol_common_get_perm_iter(q, common_datum, &iter))
+					goto cleanup;
+				for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+					if (qpol_iterator_get_item(iter, (void **)&perm_name))
+						goto cleanup;
+					record_list_item(out, perm_name);
+				}
+				qpol_iterator_destroy(&iter);
+			}
+			if (qpol_class_get_perm_iter(q, class_datum, &iter))
+				goto cleanup;
+			for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+				if (qpol_iterator_get_item(iter, (void **)&perm_name))
+					goto cleanup;
+				record_list_item(out, perm_name);
+			}
+			record_list_end(out);
+		}
+		record_end(out);
+		retval = 0;
+		goto cleanup;
+	}
 	fprintf(fp, "   %s\n", class_name);
 
 	if (expand) {
@@ -38,6 +38,8 @@
 #include <qpol/syn_rule_query.h>
 #include <qpol/util.h>
 
+#include "record.h"
+
 /* other */
 #include <errno.h>
 #include <stdlib.h>
@@ -55,7 +57,7 @@ enum opt_values
 {
 	RULE_NEVERALLOW = 256, RULE_AUDIT, RULE_AUDITALLOW, RULE_DONTAUDIT,
 	RULE_ROLE_ALLOW, RULE_ROLE_TRANS, RULE_RANGE_TRANS, RULE_ALL,
-	EXPR_ROLE_SOURCE, EXPR_ROLE_TARGET
+	EXPR_ROLE_SOURCE, EXPR_ROLE_TARGET, OPT_FORMAT, OPT_BATCH
 };
 
 static struct option const longopts[] = {
@@ -84,6 +86,8 @@ static struct option const longopts[] = {
 	{"linenum", no_argument, NULL, 'n'},
 	{"semantic", no_argument, NULL, 'S'},
 	{"show_cond", no_argument, NULL, 'C'},
+	{"format", required_argument, NULL, OPT_FORMAT},
+	{"batch", required_argument, NULL, OPT_BATCH},
 	{"help", no_argument, NULL, 'h'},
 	{"version", no_argument, NULL, 'V'},
 	{NULL, 0, NULL, 0}
@@ -115,6 +119,10 @@ typedef struct options
 	bool useregex;
 	bool show_cond;
 	apol_vector_t *perm_vector;
+	/** if non-NULL, write structured records here instead of text */
+	record_writer_t *out;
+	/** if non-NULL, the batch query to which results belong */
+	char *query_id;
 } options_t;
 
 void usage(const char *program_name, int brief)
@@ -151,32 +159,241 @@ void usage(const char *program_name, int brief)
 	printf("  -n, --linenum             show line number for each rule if available\n");
 	printf("  -S, --semantic            search rules semantically instead of syntactically\n");
 	printf("  -C, --show_cond           show conditional expression for conditional rules\n");
+	printf("  --format=FORMAT           output text (default), json, jsonl, or tsv\n");
+	printf("  --batch=FILE              run each query within FILE, tagging results by query\n");
 	printf("  -h, --help                print this help text and exit\n");
 	printf("  -V, --version             print version information and exit\n");
 	printf("\n");
 	printf("If no expression is specified, then all rules are shown.\n");
 	printf("\n");
+	printf("Each line of a batch file is a query name followed by a rule type and an\n");
+	printf("expression, using the options above for av and te rules.\n");
+	printf("\n");
 	printf("The default source policy, or if that is unavailable the default binary\n");
 	printf("policy, will be opened if no policy is provided.\n\n");
 }
 
-static int perform_av_query(const apol_policy_t * policy, const options_t * opt, apol_vector_t ** v)
+/** columns of structured output */
+enum rule_column
+{
+	COL_RULE = 0, COL_SOURCE, COL_TARGET, COL_CLASS, COL_PERMS, COL_DEFAULT, COL_FILENAME,
+	COL_COND, COL_ENABLED, COL_BRANCH, COL_LINENO, COL_QUERY, NUM_COLUMNS
+};
+
+static const char *const rule_columns[NUM_COLUMNS] = {
+	"rule", "source", "target", "class", "perms", "default", "filename",
+	"cond", "enabled", "branch", "lineno", "query"
+};
+
+/**
+ * State shared by the callbacks that print semantic rules as they are
+ * found.  Rules within the same conditional block are found one after
+ * another, so the most recently rendered conditional expression is
+ * kept for reuse.
+ */
+typedef struct print_state
+{
+	const options_t *opt;
+	size_t num_rules;
+	const qpol_cond_t *cond;
+	char *cond_str;
+} print_state_t;
+
+static void print_state_fini(print_state_t * s)
+{
+	free(s->cond_str);
+	s->cond_str = NULL;
+	s->cond = NULL;
+}
+
+/**
+ * Return the rendered form of a conditional expression, rendering it
+ * only if it differs from the previous one.
+ */
+static const char *print_state_get_cond_str(const apol_policy_t * policy, print_state_t * s, const qpol_cond_t * cond)
+{
+	if (cond == s->cond && s->cond_str != NULL) {
+		return s->cond_str;
+	}
+	print_state_fini(s);
+	if ((s->cond_str = apol_cond_expr_render(policy, cond)) == NULL) {
+		return NULL;
+	}
+	s->cond = cond;
+	return s->cond_str;
+}
+
+/**
+ * Add a rule's conditional expression, its state, and the branch
+ * that the rule is in.  Unconditional rules have none of these.
+ */
+static void record_cond(record_writer_t * w, const char *expr, uint32_t enabled, uint32_t branch)
+{
+	if (expr == NULL)
+		return;
+	record_str(w, COL_COND, expr);
+	record_bool(w, COL_ENABLED, enabled);
+	record_bool(w, COL_BRANCH, branch);
+}
+
+/**
+ * Add a syntactic rule's type set as a list of the names within it.
+ * A set of all types is "*"; a complemented set starts with "~";
+ * subtracted types are prefixed with "-".
+ */
+static int record_type_set(qpol_policy_t * q, record_writer_t * w, size_t column, const qpol_type_set_t * set, uint32_t is_self)
+{
+	qpol_iterator_t *iter = NULL;
+	const qpol_type_t *type;
+	const char *name;
+	uint32_t star = 0, comp = 0;
+	int subtracted;
+
+	if (qpol_type_set_get_is_star(q, set, &star) || qpol_type_set_get_is_comp(q, set, &comp))
+		return -1;
+	record_list_begin(w, column);
+	if (star) {
+		record_list_item(w, "*");
+	} else {
+		if (comp)
+			record_list_item(w, "~");
+		for (subtracted = 0; subtracted < 2; subtracted++) {
+			if ((subtracted ? qpol_type_set_get_subtracted_types_iter(q, set, &iter) :
+			     qpol_type_set_get_included_types_iter(q, set, &iter)) < 0)
+				return -1;
+			for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+				if (qpol_iterator_get_item(iter, (void **)&type) || qpol_type_get_name(q, type, &name)) {
+					qpol_iterator_destroy(&iter);
+					return -1;
+				}
+				record_list_item_prefix(w, (subtracted ? "-" : ""), name);
+			}
+			qpol_iterator_destroy(&iter);
+		}
+	}
+	if (is_self)
+		record_list_item(w, "self");
+	record_list_end(w);
+	return 0;
+}
+
+/**
+ * Add the names of the classes from an iterator over qpol_class_t.
+ * The iterator is destroyed afterwards.
+ */
+static int record_class_iter(qpol_policy_t * q, record_writer_t * w, qpol_iterator_t ** iter)
+{
+	const qpol_class_t *obj_class;
+	const char *name;
+	int retval = 0;
+
+	record_list_begin(w, COL_CLASS);
+	for (; !qpol_iterator_end(*iter); qpol_iterator_next(*iter)) {
+		if (qpol_iterator_get_item(*iter, (void **)&obj_class) || qpol_class_get_name(q, obj_class, &name)) {
+			retval = -1;
+			break;
+		}
+		record_list_item(w, name);
+	}
+	record_list_end(w);
+	qpol_iterator_destroy(iter);
+	return retval;
+}
+
+static int record_av_rule(const apol_policy_t * policy, record_writer_t * w, const qpol_avrule_t * rule, const char *expr,
+			  uint32_t enabled, uint32_t list, const char *query_id)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const qpol_type_t *source, *target;
+	const qpol_class_t *obj_class;
+	const char *rule_type_str, *source_name, *target_name, *class_name;
+	qpol_iterator_t *iter = NULL;
+	uint32_t rule_type = 0;
+	char *perm;
+	int retval = 0;
+
+	if (qpol_avrule_get_rule_type(q, rule, &rule_type) || (rule_type_str = apol_rule_type_to_str(rule_type)) == NULL ||
+	    qpol_avrule_get_source_type(q, rule, &source) || qpol_type_get_name(q, source, &source_name) ||
+	    qpol_avrule_get_target_type(q, rule, &target) || qpol_type_get_name(q, target, &target_name) ||
+	    qpol_avrule_get_object_class(q, rule, &obj_class) || qpol_class_get_name(q, obj_class, &class_name) ||
+	    qpol_avrule_get_perm_iter(q, rule, &iter))
+		return -1;
+	record_begin(w);
+	record_str(w, COL_RULE, rule_type_str);
+	record_str(w, COL_SOURCE, source_name);
+	record_str(w, COL_TARGET, target_name);
+	record_str(w, COL_CLASS, class_name);
+	record_list_begin(w, COL_PERMS);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&perm)) {
+			retval = -1;
+			break;
+		}
+		record_list_item(w, perm);
+		free(perm);
+	}
+	record_list_end(w);
+	qpol_iterator_destroy(&iter);
+	record_cond(w, expr, enabled, list);
+	record_str(w, COL_QUERY, query_id);
+	record_end(w);
+	return retval;
+}
+
+static int print_av_rule(void *arg, const apol_policy_t * policy, const qpol_avrule_t * rule)
+{
+	print_state_t *s = (print_state_t *) arg;
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const char *expr = NULL;
+	char enable_char = ' ', branch_char = ' ';
+	const qpol_cond_t *cond = NULL;
+	uint32_t enabled = 0, list = 0;
+
+	if (s->opt->show_cond || s->opt->out) {
+		if (qpol_avrule_get_cond(q, rule, &cond))
+			return -1;
+		if (qpol_avrule_get_is_enabled(q, rule, &enabled))
+			return -1;
+		if (cond) {
+			if (qpol_avrule_get_which_list(q, rule, &list))
+				return -1;
+			if ((expr = print_state_get_cond_str(policy, s, cond)) == NULL)
+				return -1;
+			enable_char = (enabled ? 'E' : 'D');
+			branch_char = (list ? 'T' : 'F');
+		}
+	}
+	s->num_rules++;
+	if (s->opt->out)
+		return record_av_rule(policy, s->opt->out, rule, expr, enabled, list, s->opt->query_id);
+	if (s->opt->query_id)
+		fprintf(stdout, "%s: ", s->opt->query_id);
+	fprintf(stdout, "%c%c ", enable_char, branch_char);
+	if (apol_avrule_render_file(policy, rule, stdout))
+		return -1;
+	if (expr)
+		fprintf(stdout, " [ %s ]\n", expr);
+	else
+		fprintf(stdout, " \n");
+	return 0;
+}
+
+/**
+ * Build the av rule query described by a set of options.
+ *
+ * @return 0 on success, with *query set to NULL if the options name no
+ * av rules, or < 0 on error.
+ */
+static int create_av_query(const apol_policy_t * policy, const options_t * opt, apol_avrule_query_t ** query)
 {
 	apol_avrule_query_t *avq = NULL;
 	unsigned int rules = 0;
 	int error = 0;
 	char *tmp = NULL, *tok = NULL, *s = NULL;
 
-	if (!policy || !opt || !v) {
-		ERR(policy, "%s", strerror(EINVAL));
-		errno = EINVAL;
-		return -1;
-	}
-
-	if (!opt->all && !opt->allow && !opt->nallow && !opt->auditallow && !opt->dontaudit) {
-		*v = NULL;
+	*query = NULL;
+	if (!opt->all && !opt->allow && !opt->nallow && !opt->auditallow && !opt->dontaudit)
 		return 0;	       /* no search to do */
-	}
 
 	avq = apol_avrule_query_create();
 	if (!avq) {
@@ -238,16 +455,57 @@ static int perform_av_query(const apol_policy_t * policy, const options_t * opt,
 		free(tmp);
 	}
 
+	*query = avq;
+	return 0;
+
+      err:
+	apol_avrule_query_destroy(&avq);
+	free(tmp);
+	free(s);
+	ERR(policy, "%s", strerror(error));
+	errno = error;
+	return -1;
+}
+
+static int perform_av_query(const apol_policy_t * policy, const options_t * opt, apol_vector_t ** v)
+{
+	print_state_t state;
+	apol_avrule_query_t *avq = NULL;
+	int error = 0;
+
+	if (!policy || !opt || !v) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+
+	*v = NULL;
+	if (create_av_query(policy, opt, &avq))
+		return -1;
+	if (avq == NULL)
+		return 0;	       /* no search to do */
+
 	if (!(opt->semantic) && qpol_policy_has_capability(apol_policy_get_qpol(policy), QPOL_CAP_SYN_RULES)) {
 		if (apol_syn_avrule_get_by_query(policy, avq, v)) {
 			error = errno;
 			goto err;
 		}
 	} else {
-		if (apol_avrule_get_by_query(policy, avq, v)) {
+		/* print semantic rules as they are found, rather than
+		 * holding every match in memory */
+		memset(&state, 0, sizeof(state));
+		state.opt = opt;
+		if (apol_avrule_foreach_by_query(policy, avq, print_av_rule, &state)) {
 			error = errno;
+			print_state_fini(&state);
 			goto err;
 		}
+		print_state_fini(&state);
+		if (!opt->out && !opt->query_id) {
+			if (state.num_rules > 0)
+				fprintf(stdout, "Found %zd semantic av rules.\n", state.num_rules);
+			fprintf(stdout, "\n");
+		}
 	}
 
 	apol_avrule_query_destroy(&avq);
@@ -256,13 +514,54 @@ static int perform_av_query(const apol_policy_t * policy, const options_t * opt,
       err:
 	apol_vector_destroy(v);
 	apol_avrule_query_destroy(&avq);
-	free(tmp);
-	free(s);
 	ERR(policy, "%s", strerror(error));
 	errno = error;
 	return -1;
 }
 
+static int record_syn_av_rule(const apol_policy_t * policy, record_writer_t * w, const qpol_syn_avrule_t * rule,
+			      const char *expr, uint32_t enabled, uint32_t branch, const char *query_id)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const qpol_type_set_t *source, *target;
+	const char *rule_type_str, *perm;
+	qpol_iterator_t *iter = NULL;
+	uint32_t rule_type = 0, is_self = 0;
+	unsigned long lineno = 0;
+
+	if (qpol_syn_avrule_get_rule_type(q, rule, &rule_type) ||
+	    (rule_type_str = apol_rule_type_to_str(rule_type & (QPOL_RULE_ALLOW | QPOL_RULE_NEVERALLOW | QPOL_RULE_AUDITALLOW |
+								 QPOL_RULE_DONTAUDIT))) == NULL ||
+	    qpol_syn_avrule_get_source_type_set(q, rule, &source) || qpol_syn_avrule_get_target_type_set(q, rule, &target) ||
+	    qpol_syn_avrule_get_is_target_self(q, rule, &is_self))
+		return -1;
+	record_begin(w);
+	record_str(w, COL_RULE, rule_type_str);
+	if (record_type_set(q, w, COL_SOURCE, source, 0) || record_type_set(q, w, COL_TARGET, target, is_self) ||
+	    qpol_syn_avrule_get_class_iter(q, rule, &iter) || record_class_iter(q, w, &iter) ||
+	    qpol_syn_avrule_get_perm_iter(q, rule, &iter))
+		return -1;
+	record_list_begin(w, COL_PERMS);
+	for (; !qpol_iterator_end(iter); qpol_iterator_next(iter)) {
+		if (qpol_iterator_get_item(iter, (void **)&perm)) {
+			qpol_iterator_destroy(&iter);
+			return -1;
+		}
+		record_list_item(w, perm);
+	}
+	record_list_end(w);
+	qpol_iterator_destroy(&iter);
+	record_cond(w, expr, enabled, branch);
+	if (qpol_policy_has_capability(q, QPOL_CAP_LINE_NUMBERS)) {
+		if (qpol_syn_avrule_get_lineno(q, rule, &lineno))
+			return -1;
+		record_ulong(w, COL_LINENO, lineno);
+	}
+	record_str(w, COL_QUERY, query_id);
+	record_end(w);
+	return 0;
+}
+
 static void print_syn_av_results(const apol_policy_t * policy, const options_t * opt, const apol_vector_t * v)
 {
 	qpol_policy_t *q = apol_policy_get_qpol(policy);
@@ -272,7 +571,7 @@ static void print_syn_av_results(const apol_policy_t * policy, const options_t *
 	char *tmp = NULL, *rule_str = NULL, *expr = NULL;
 	char enable_char = ' ', branch_char = ' ';
 	const qpol_cond_t *cond = NULL;
-	uint32_t enabled = 0, is_true = 0;
+	uint32_t enabled = 0, is_true = 0, branch = 0;
 	unsigned long lineno = 0;
 
 	if (!policy || !v)
@@ -282,39 +581,47 @@ static void print_syn_av_results(const apol_policy_t * policy, const options_t *
 	if (!(num_rules = apol_vector_get_size(syn_list)))
 		goto cleanup;
 
-	fprintf(stdout, "Found %zd syntactic av rules:\n", num_rules);
+	if (!opt->out && !opt->query_id)
+		fprintf(stdout, "Found %zd syntactic av rules:\n", num_rules);
 
 	for (i = 0; i < num_rules; i++) {
 		rule = apol_vector_get_element(syn_list, i);
 		enable_char = branch_char = ' ';
-		if (opt->show_cond) {
+		if (opt->show_cond || opt->out) {
 			if (qpol_syn_avrule_get_cond(q, rule, &cond))
 				goto cleanup;
 			if (cond) {
 				if (qpol_syn_avrule_get_is_enabled(q, rule, &enabled) < 0 || qpol_cond_eval(q, cond, &is_true) < 0)
 					goto cleanup;
-				tmp = apol_cond_expr_render(policy, cond);
+				if ((tmp = apol_cond_expr_render(policy, cond)) == NULL)
+					goto cleanup;
+				branch = ((is_true && enabled) || (!is_true && !enabled));
 				enable_char = (enabled ? 'E' : 'D');
-				branch_char = ((is_true && enabled) || (!is_true && !enabled) ? 'T' : 'F');
+				branch_char = (branch ? 'T' : 'F');
 				if (asprintf(&expr, "[ %s ]", tmp) < 0) {
 					expr = NULL;
 					goto cleanup;
 				}
-				free(tmp);
-				tmp = NULL;
-				if (!expr)
-					goto cleanup;
 			}
 		}
-		if (!(rule_str = apol_syn_avrule_render(policy, rule)))
-			goto cleanup;
-		if (opt->lineno) {
-			if (qpol_syn_avrule_get_lineno(q, rule, &lineno))
+		if (opt->out) {
+			if (record_syn_av_rule(policy, opt->out, rule, tmp, enabled, branch, opt->query_id))
 				goto cleanup;
-			fprintf(stdout, "%c%c [%7lu] %s %s\n", enable_char, branch_char, lineno, rule_str, expr ? expr : "");
 		} else {
-			fprintf(stdout, "%c%c %s %s\n", enable_char, branch_char, rule_str, expr ? expr : "");
+			if (!(rule_str = apol_syn_avrule_render(policy, rule)))
+				goto cleanup;
+			if (opt->query_id)
+				fprintf(stdout, "%s: ", opt->query_id);
+			if (opt->lineno) {
+				if (qpol_syn_avrule_get_lineno(q, rule, &lineno))
+					goto cleanup;
+				fprintf(stdout, "%c%c [%7lu] %s %s\n", enable_char, branch_char, lineno, rule_str, expr ? expr : "");
+			} else {
+				fprintf(stdout, "%c%c %s %s\n", enable_char, branch_char, rule_str, expr ? expr : "");
+			}
 		}
+		free(tmp);
+		tmp = NULL;
 		free(rule_str);
 		rule_str = NULL;
 		free(expr);
@@ -327,84 +634,85 @@ static void print_syn_av_results(const apol_policy_t * policy, const options_t *
 	free(expr);
 }
 
-static void print_av_results(const apol_policy_t * policy, const options_t * opt, const apol_vector_t * v)
+static int record_te_rule(const apol_policy_t * policy, record_writer_t * w, const qpol_terule_t * rule, const char *expr,
+			  uint32_t enabled, uint32_t list, const char *query_id)
 {
 	qpol_policy_t *q = apol_policy_get_qpol(policy);
-	size_t i, num_rules = 0;
-	const qpol_avrule_t *rule = NULL;
-	char *tmp = NULL, *rule_str = NULL, *expr = NULL;
+	const qpol_type_t *source, *target, *dflt;
+	const qpol_class_t *obj_class;
+	const char *rule_type_str, *source_name, *target_name, *class_name, *default_name;
+	uint32_t rule_type = 0;
+
+	if (qpol_terule_get_rule_type(q, rule, &rule_type) || (rule_type_str = apol_rule_type_to_str(rule_type)) == NULL ||
+	    qpol_terule_get_source_type(q, rule, &source) || qpol_type_get_name(q, source, &source_name) ||
+	    qpol_terule_get_target_type(q, rule, &target) || qpol_type_get_name(q, target, &target_name) ||
+	    qpol_terule_get_object_class(q, rule, &obj_class) || qpol_class_get_name(q, obj_class, &class_name) ||
+	    qpol_terule_get_default_type(q, rule, &dflt) || qpol_type_get_name(q, dflt, &default_name))
+		return -1;
+	record_begin(w);
+	record_str(w, COL_RULE, rule_type_str);
+	record_str(w, COL_SOURCE, source_name);
+	record_str(w, COL_TARGET, target_name);
+	record_str(w, COL_CLASS, class_name);
+	record_str(w, COL_DEFAULT, default_name);
+	record_cond(w, expr, enabled, list);
+	record_str(w, COL_QUERY, query_id);
+	record_end(w);
+	return 0;
+}
+
+static int print_te_rule(void *arg, const apol_policy_t * policy, const qpol_terule_t * rule)
+{
+	print_state_t *s = (print_state_t *) arg;
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const char *expr = NULL;
 	char enable_char = ' ', branch_char = ' ';
-	qpol_iterator_t *iter = NULL;
 	const qpol_cond_t *cond = NULL;
 	uint32_t enabled = 0, list = 0;
 
-	if (!policy || !v)
-		return;
-
-	if (!(num_rules = apol_vector_get_size(v)))
-		return;
-
-	fprintf(stdout, "Found %zd semantic av rules:\n", num_rules);
-
-	for (i = 0; i < num_rules; i++) {
-		enable_char = branch_char = ' ';
-		if (!(rule = apol_vector_get_element(v, i)))
-			goto cleanup;
-		if (opt->show_cond) {
-			if (qpol_avrule_get_cond(q, rule, &cond))
-				goto cleanup;
-			if (qpol_avrule_get_is_enabled(q, rule, &enabled))
-				goto cleanup;
-			if (cond) {
-				if (qpol_avrule_get_which_list(q, rule, &list))
-					goto cleanup;
-				tmp = apol_cond_expr_render(policy, cond);
-				qpol_iterator_destroy(&iter);
-				enable_char = (enabled ? 'E' : 'D');
-				branch_char = (list ? 'T' : 'F');
-				if (asprintf(&expr, "[ %s ]", tmp) < 0) {
-					expr = NULL;
-					goto cleanup;
-				}
-				free(tmp);
-				tmp = NULL;
-				if (!expr)
-					goto cleanup;
-			}
+	if (s->opt->show_cond || s->opt->out) {
+		if (qpol_terule_get_cond(q, rule, &cond))
+			return -1;
+		if (qpol_terule_get_is_enabled(q, rule, &enabled))
+			return -1;
+		if (cond) {
+			if (qpol_terule_get_which_list(q, rule, &list))
+				return -1;
+			if ((expr = print_state_get_cond_str(policy, s, cond)) == NULL)
+				return -1;
+			enable_char = (enabled ? 'E' : 'D');
+			branch_char = (list ? 'T' : 'F');
 		}
-		if (!(rule_str = apol_avrule_render(policy, rule)))
-			goto cleanup;
-		fprintf(stdout, "%c%c %s %s\n", enable_char, branch_char, rule_str, expr ? expr : "");
-		free(rule_str);
-		rule_str = NULL;
-		free(expr);
-		expr = NULL;
 	}
-
-      cleanup:
-	free(tmp);
-	free(rule_str);
-	free(expr);
+	s->num_rules++;
+	if (s->opt->out)
+		return record_te_rule(policy, s->opt->out, rule, expr, enabled, list, s->opt->query_id);
+	if (s->opt->query_id)
+		fprintf(stdout, "%s: ", s->opt->query_id);
+	fprintf(stdout, "%c%c ", enable_char, branch_char);
+	if (apol_terule_render_file(policy, rule, stdout))
+		return -1;
+	if (expr)
+		fprintf(stdout, " [ %s ]\n", expr);
+	else
+		fprintf(stdout, " \n");
+	return 0;
 }
 
-static int perform_te_query(const apol_policy_t * policy, const options_t * opt, apol_vector_t ** v)
+/**
+ * Build the te rule query described by a set of options.
+ *
+ * @return 0 on success, with *query set to NULL if the options name no
+ * te rules, or < 0 on error.
+ */
+static int create_te_query(const apol_policy_t * policy, const options_t * opt, apol_terule_query_t ** query)
 {
 	apol_terule_query_t *teq = NULL;
-	unsigned int rules = 0;
 	int error = 0;
 
-	if (!policy || !opt || !v) {
-		ERR(policy, "%s", strerror(EINVAL));
-		errno = EINVAL;
-		return -1;
-	}
-
-	if (opt->all || opt->type) {
-		rules = (QPOL_RULE_TYPE_TRANS | QPOL_RULE_TYPE_CHANGE | QPOL_RULE_TYPE_MEMBER);
-	} else {
-		*v = NULL;
+	*query = NULL;
+	if (!opt->all && !opt->type)
 		return 0;	       /* no search to do */
-	}
 
 	teq = apol_terule_query_create();
 	if (!teq) {
@@ -413,7 +721,7 @@ static int perform_te_query(const apol_policy_t * policy, const options_t * opt,
 		return -1;
 	}
 
-	apol_terule_query_set_rules(policy, teq, rules);
+	apol_terule_query_set_rules(policy, teq, QPOL_RULE_TYPE_TRANS | QPOL_RULE_TYPE_CHANGE | QPOL_RULE_TYPE_MEMBER);
 	apol_terule_query_set_regex(policy, teq, opt->useregex);
 	if (opt->src_name)
 		apol_terule_query_set_source(policy, teq, opt->src_name, opt->indirect);
@@ -443,16 +751,55 @@ static int perform_te_query(const apol_policy_t * policy, const options_t * opt,
 		}
 	}
 
+	*query = teq;
+	return 0;
+
+      err:
+	apol_terule_query_destroy(&teq);
+	ERR(policy, "%s", strerror(error));
+	errno = error;
+	return -1;
+}
+
+static int perform_te_query(const apol_policy_t * policy, const options_t * opt, apol_vector_t ** v)
+{
+	print_state_t state;
+	apol_terule_query_t *teq = NULL;
+	int error = 0;
+
+	if (!policy || !opt || !v) {
+		ERR(policy, "%s", strerror(EINVAL));
+		errno = EINVAL;
+		return -1;
+	}
+
+	*v = NULL;
+	if (create_te_query(policy, opt, &teq))
+		return -1;
+	if (teq == NULL)
+		return 0;	       /* no search to do */
+
 	if (!(opt->semantic) && qpol_policy_has_capability(apol_policy_get_qpol(policy), QPOL_CAP_SYN_RULES)) {
 		if (apol_syn_terule_get_by_query(policy, teq, v)) {
 			error = errno;
 			goto err;
 		}
 	} else {
-		if (apol_terule_get_by_query(policy, teq, v)) {
+		/* print semantic rules as they are found, rather than
+		 * holding every match in memory */
+		memset(&state, 0, sizeof(state));
+		state.opt = opt;
+		if (apol_terule_foreach_by_query(policy, teq, print_te_rule, &state)) {
 			error = errno;
+			print_state_fini(&state);
 			goto err;
 		}
+		print_state_fini(&state);
+		if (!opt->out && !opt->query_id) {
+			if (state.num_rules > 0)
+				fprintf(stdout, "Found %zd semantic te rules.\n", state.num_rules);
+			fprintf(stdout, "\n");
+		}
 	}
 
 	apol_terule_query_destroy(&teq);
@@ -466,6 +813,40 @@ static int perform_te_query(const apol_policy_t * policy, const options_t * opt,
 	return -1;
 }
 
+static int record_syn_te_rule(const apol_policy_t * policy, record_writer_t * w, const qpol_syn_terule_t * rule,
+			      const char *expr, uint32_t enabled, uint32_t branch, const char *query_id)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const qpol_type_set_t *source, *target;
+	const qpol_type_t *dflt;
+	const char *rule_type_str, *default_name;
+	qpol_iterator_t *iter = NULL;
+	uint32_t rule_type = 0;
+	unsigned long lineno = 0;
+
+	if (qpol_syn_terule_get_rule_type(q, rule, &rule_type) ||
+	    (rule_type_str = apol_rule_type_to_str(rule_type & (QPOL_RULE_TYPE_TRANS | QPOL_RULE_TYPE_CHANGE |
+								 QPOL_RULE_TYPE_MEMBER))) == NULL ||
+	    qpol_syn_terule_get_source_type_set(q, rule, &source) || qpol_syn_terule_get_target_type_set(q, rule, &target) ||
+	    qpol_syn_terule_get_default_type(q, rule, &dflt) || qpol_type_get_name(q, dflt, &default_name))
+		return -1;
+	record_begin(w);
+	record_str(w, COL_RULE, rule_type_str);
+	if (record_type_set(q, w, COL_SOURCE, source, 0) || record_type_set(q, w, COL_TARGET, target, 0) ||
+	    qpol_syn_terule_get_class_iter(q, rule, &iter) || record_class_iter(q, w, &iter))
+		return -1;
+	record_str(w, COL_DEFAULT, default_name);
+	record_cond(w, expr, enabled, branch);
+	if (qpol_policy_has_capability(q, QPOL_CAP_LINE_NUMBERS)) {
+		if (qpol_syn_terule_get_lineno(q, rule, &lineno))
+			return -1;
+		record_ulong(w, COL_LINENO, lineno);
+	}
+	record_str(w, COL_QUERY, query_id);
+	record_end(w);
+	return 0;
+}
+
 static void print_syn_te_results(const apol_policy_t * policy, const options_t * opt, const apol_vector_t * v)
 {
 	qpol_policy_t *q = apol_policy_get_qpol(policy);
@@ -475,7 +856,7 @@ static void print_syn_te_results(const apol_policy_t * policy, const options_t *
 	char *tmp = NULL, *rule_str = NULL, *expr = NULL;
 	char enable_char = ' ', branch_char = ' ';
 	const qpol_cond_t *cond = NULL;
-	uint32_t enabled = 0, is_true = 0;
+	uint32_t enabled = 0, is_true = 0, branch = 0;
 	unsigned long lineno = 0;
 
 	if (!policy || !v)
@@ -485,101 +866,47 @@ static void print_syn_te_results(const apol_policy_t * policy, const options_t *
 	if (!(num_rules = apol_vector_get_size(syn_list)))
 		goto cleanup;
 
-	fprintf(stdout, "Found %zd syntactic te rules:\n", num_rules);
+	if (!opt->out && !opt->query_id)
+		fprintf(stdout, "Found %zd syntactic te rules:\n", num_rules);
 
 	for (i = 0; i < num_rules; i++) {
 		rule = apol_vector_get_element(syn_list, i);
 		enable_char = branch_char = ' ';
-		if (opt->show_cond) {
+		if (opt->show_cond || opt->out) {
 			if (qpol_syn_terule_get_cond(q, rule, &cond))
 				goto cleanup;
 			if (cond) {
 				if (qpol_syn_terule_get_is_enabled(q, rule, &enabled) < 0 || qpol_cond_eval(q, cond, &is_true) < 0)
 					goto cleanup;
-				tmp = apol_cond_expr_render(policy, cond);
+				if ((tmp = apol_cond_expr_render(policy, cond)) == NULL)
+					goto cleanup;
+				branch = ((is_true && enabled) || (!is_true && !enabled));
 				enable_char = (enabled ? 'E' : 'D');
-				branch_char = ((is_true && enabled) || (!is_true && !enabled) ? 'T' : 'F');
+				branch_char = (branch ? 'T' : 'F');
 				if (asprintf(&expr, "[ %s ]", tmp) < 0) {
 					expr = NULL;
 					goto cleanup;
 				}
-				free(tmp);
-				tmp = NULL;
-				if (!expr)
-					goto cleanup;
 			}
 		}
-		if (!(rule_str = apol_syn_terule_render(policy, rule)))
-			goto cleanup;
-		if (opt->lineno) {
-			if (qpol_syn_terule_get_lineno(q, rule, &lineno))
+		if (opt->out) {
+			if (record_syn_te_rule(policy, opt->out, rule, tmp, enabled, branch, opt->query_id))
 				goto cleanup;
-			fprintf(stdout, "%c%c [%7lu] %s %s\n", enable_char, branch_char, lineno, rule_str, expr ? expr : "");
 		} else {
-			fprintf(stdout, "%c%c %s %s\n", enable_char, branch_char, rule_str, expr ? expr : "");
-		}
-		free(rule_str);
-		rule_str = NULL;
-		free(expr);
-		expr = NULL;
-	}
-
-      cleanup:
-	free(tmp);
-	free(rule_str);
-	free(expr);
-}
-
-static void print_te_results(const apol_policy_t * policy, const options_t * opt, const apol_vector_t * v)
-{
-	qpol_policy_t *q = apol_policy_get_qpol(policy);
-	size_t i, num_rules = 0;
-	const qpol_terule_t *rule = NULL;
-	char *tmp = NULL, *rule_str = NULL, *expr = NULL;
-	char enable_char = ' ', branch_char = ' ';
-	qpol_iterator_t *iter = NULL;
-	const qpol_cond_t *cond = NULL;
-	uint32_t enabled = 0, list = 0;
-
-	if (!policy || !v)
-		goto cleanup;
-
-	if (!(num_rules = apol_vector_get_size(v)))
-		goto cleanup;
-
-	fprintf(stdout, "Found %zd semantic te rules:\n", num_rules);
-
-	for (i = 0; i < num_rules; i++) {
-		enable_char = branch_char = ' ';
-		if (!(rule = apol_vector_get_element(v, i)))
-			goto cleanup;
-		if (opt->show_cond) {
-			if (qpol_terule_get_cond(q, rule, &cond))
+			if (!(rule_str = apol_syn_terule_render(policy, rule)))
 				goto cleanup;
-			if (qpol_terule_get_is_enabled(q, rule, &enabled))
-				goto cleanup;
-			if (cond) {
-				if (qpol_terule_get_which_list(q, rule, &list))
-					goto cleanup;
-				if (qpol_cond_get_expr_node_iter(q, cond, &iter))
-					goto cleanup;
-				tmp = apol_cond_expr_render(policy, cond);
-				qpol_iterator_destroy(&iter);
-				enable_char = (enabled ? 'E' : 'D');
-				branch_char = (list ? 'T' : 'F');
-				if (asprintf(&expr, "[ %s ]", tmp) < 0) {
-					expr = NULL;
-					goto cleanup;
-				}
-				free(tmp);
-				tmp = NULL;
-				if (!expr)
+			if (opt->query_id)
+				fprintf(stdout, "%s: ", opt->query_id);
+			if (opt->lineno) {
+				if (qpol_syn_terule_get_lineno(q, rule, &lineno))
 					goto cleanup;
+				fprintf(stdout, "%c%c [%7lu] %s %s\n", enable_char, branch_char, lineno, rule_str, expr ? expr : "");
+			} else {
+				fprintf(stdout, "%c%c %s %s\n", enable_char, branch_char, rule_str, expr ? expr : "");
 			}
 		}
-		if (!(rule_str = apol_terule_render(policy, rule)))
-			goto cleanup;
-		fprintf(stdout, "%c%c %s %s\n", enable_char, branch_char, rule_str, expr ? expr : "");
+		free(tmp);
+		tmp = NULL;
 		free(rule_str);
 		rule_str = NULL;
 		free(expr);
@@ -673,6 +1000,30 @@ static int perform_ft_query(const apol_policy_t * policy, const options_t * opt,
 	return -1;
 }
 
+static int record_ft_rule(const apol_policy_t * policy, record_writer_t * w, const qpol_filename_trans_t * rule)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const qpol_type_t *source, *target, *dflt;
+	const qpol_class_t *obj_class;
+	const char *source_name, *target_name, *class_name, *default_name, *filename;
+
+	if (qpol_filename_trans_get_source_type(q, rule, &source) || qpol_type_get_name(q, source, &source_name) ||
+	    qpol_filename_trans_get_target_type(q, rule, &target) || qpol_type_get_name(q, target, &target_name) ||
+	    qpol_filename_trans_get_object_class(q, rule, &obj_class) || qpol_class_get_name(q, obj_class, &class_name) ||
+	    qpol_filename_trans_get_default_type(q, rule, &dflt) || qpol_type_get_name(q, dflt, &default_name) ||
+	    qpol_filename_trans_get_filename(q, rule, &filename))
+		return -1;
+	record_begin(w);
+	record_str(w, COL_RULE, "type_transition");
+	record_str(w, COL_SOURCE, source_name);
+	record_str(w, COL_TARGET, target_name);
+	record_str(w, COL_CLASS, class_name);
+	record_str(w, COL_DEFAULT, default_name);
+	record_str(w, COL_FILENAME, filename);
+	record_end(w);
+	return 0;
+}
+
 static void print_ft_results(const apol_policy_t * policy, const options_t * opt, const apol_vector_t * v)
 {
 	size_t i, num_filename_trans = 0;
@@ -683,12 +1034,18 @@ static void print_ft_results(const apol_policy_t * policy, const options_t * opt
 	if (!(num_filename_trans = apol_vector_get_size(v)))
 		goto cleanup;
 
-	fprintf(stdout, "Found %zd named file transition rules:\n", num_filename_trans);
+	if (!opt->out)
+		fprintf(stdout, "Found %zd named file transition rules:\n", num_filename_trans);
 
 	for (i = 0; i < num_filename_trans; i++) {
 		if (!(filename_trans = apol_vector_get_element(v, i)))
 			goto cleanup;
 
+		if (opt->out) {
+			if (record_ft_rule(policy, opt->out, filename_trans))
+				goto cleanup;
+			continue;
+		}
 		if (!(filename_trans_str = apol_filename_trans_render(policy, filename_trans)))
 			goto cleanup;
 		fprintf(stdout, "%s\n", filename_trans_str);
@@ -752,7 +1109,24 @@ static int perform_ra_query(const apol_policy_t * policy, const options_t * opt,
 	return -1;
 }
 
-static void print_ra_results(const apol_policy_t * policy, const options_t * opt __attribute__ ((unused)), const apol_vector_t * v)
+static int record_ra_rule(const apol_policy_t * policy, record_writer_t * w, const qpol_role_allow_t * rule)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const qpol_role_t *source, *target;
+	const char *source_name, *target_name;
+
+	if (qpol_role_allow_get_source_role(q, rule, &source) || qpol_role_get_name(q, source, &source_name) ||
+	    qpol_role_allow_get_target_role(q, rule, &target) || qpol_role_get_name(q, target, &target_name))
+		return -1;
+	record_begin(w);
+	record_str(w, COL_RULE, "allow");
+	record_str(w, COL_SOURCE, source_name);
+	record_str(w, COL_TARGET, target_name);
+	record_end(w);
+	return 0;
+}
+
+static void print_ra_results(const apol_policy_t * policy, const options_t * opt, const apol_vector_t * v)
 {
 	size_t i, num_rules = 0;
 	const qpol_role_allow_t *rule = NULL;
@@ -764,11 +1138,17 @@ static void print_ra_results(const apol_policy_t * policy, const options_t * opt
 	if (!(num_rules = apol_vector_get_size(v)))
 		return;
 
-	fprintf(stdout, "Found %zd role allow rules:\n", num_rules);
+	if (!opt->out)
+		fprintf(stdout, "Found %zd role allow rules:\n", num_rules);
 
 	for (i = 0; i < num_rules; i++) {
 		if (!(rule = apol_vector_get_element(v, i)))
 			break;
+		if (opt->out) {
+			if (record_ra_rule(policy, opt->out, rule))
+				break;
+			continue;
+		}
 		if (!(tmp = apol_role_allow_render(policy, rule)))
 			break;
 		fprintf(stdout, "   %s\n", tmp);
@@ -837,7 +1217,27 @@ static int perform_rt_query(const apol_policy_t * policy, const options_t * opt,
 	return -1;
 }
 
-static void print_rt_results(const apol_policy_t * policy, const options_t * opt __attribute__ ((unused)), const apol_vector_t * v)
+static int record_rt_rule(const apol_policy_t * policy, record_writer_t * w, const qpol_role_trans_t * rule)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const qpol_role_t *source, *dflt;
+	const qpol_type_t *target;
+	const char *source_name, *target_name, *default_name;
+
+	if (qpol_role_trans_get_source_role(q, rule, &source) || qpol_role_get_name(q, source, &source_name) ||
+	    qpol_role_trans_get_target_type(q, rule, &target) || qpol_type_get_name(q, target, &target_name) ||
+	    qpol_role_trans_get_default_role(q, rule, &dflt) || qpol_role_get_name(q, dflt, &default_name))
+		return -1;
+	record_begin(w);
+	record_str(w, COL_RULE, "role_transition");
+	record_str(w, COL_SOURCE, source_name);
+	record_str(w, COL_TARGET, target_name);
+	record_str(w, COL_DEFAULT, default_name);
+	record_end(w);
+	return 0;
+}
+
+static void print_rt_results(const apol_policy_t * policy, const options_t * opt, const apol_vector_t * v)
 {
 	size_t i, num_rules = 0;
 	const qpol_role_trans_t *rule = NULL;
@@ -849,11 +1249,17 @@ static void print_rt_results(const apol_policy_t * policy, const options_t * opt
 	if (!(num_rules = apol_vector_get_size(v)))
 		return;
 
-	fprintf(stdout, "Found %zd role_transition rules:\n", num_rules);
+	if (!opt->out)
+		fprintf(stdout, "Found %zd role_transition rules:\n", num_rules);
 
 	for (i = 0; i < num_rules; i++) {
 		if (!(rule = apol_vector_get_element(v, i)))
 			break;
+		if (opt->out) {
+			if (record_rt_rule(policy, opt->out, rule))
+				break;
+			continue;
+		}
 		if (!(tmp = apol_role_trans_render(policy, rule)))
 			break;
 		fprintf(stdout, "   %s\n", tmp);
@@ -934,8 +1340,38 @@ static int perform_range_query(const apol_policy_t * policy, const options_t * o
 	return -1;
 }
 
-static void print_range_results(const apol_policy_t * policy, const options_t * opt
-				__attribute__ ((unused)), const apol_vector_t * v)
+static int record_range_rule(const apol_policy_t * policy, record_writer_t * w, const qpol_range_trans_t * rule)
+{
+	qpol_policy_t *q = apol_policy_get_qpol(policy);
+	const qpol_type_t *source, *target;
+	const qpol_class_t *obj_class;
+	const qpol_mls_range_t *qrange;
+	const char *source_name, *target_name, *class_name;
+	apol_mls_range_t *range = NULL;
+	char *range_str = NULL;
+
+	if (qpol_range_trans_get_source_type(q, rule, &source) || qpol_type_get_name(q, source, &source_name) ||
+	    qpol_range_trans_get_target_type(q, rule, &target) || qpol_type_get_name(q, target, &target_name) ||
+	    qpol_range_trans_get_target_class(q, rule, &obj_class) || qpol_class_get_name(q, obj_class, &class_name) ||
+	    qpol_range_trans_get_range(q, rule, &qrange) ||
+	    (range = apol_mls_range_create_from_qpol_mls_range(policy, qrange)) == NULL ||
+	    (range_str = apol_mls_range_render(policy, range)) == NULL) {
+		apol_mls_range_destroy(&range);
+		return -1;
+	}
+	record_begin(w);
+	record_str(w, COL_RULE, "range_transition");
+	record_str(w, COL_SOURCE, source_name);
+	record_str(w, COL_TARGET, target_name);
+	record_str(w, COL_CLASS, class_name);
+	record_str(w, COL_DEFAULT, range_str);
+	record_end(w);
+	apol_mls_range_destroy(&range);
+	free(range_str);
+	return 0;
+}
+
+static void print_range_results(const apol_policy_t * policy, const options_t * opt, const apol_vector_t * v)
 {
 	size_t i, num_rules = 0;
 	const qpol_range_trans_t *rule = NULL;
@@ -947,11 +1383,17 @@ static void print_range_results(const apol_policy_t * policy, const options_t *
 	if (!(num_rules = apol_vector_get_size(v)))
 		return;
 
-	fprintf(stdout, "Found %zd range_transition rules:\n", num_rules);
+	if (!opt->out)
+		fprintf(stdout, "Found %zd range_transition rules:\n", num_rules);
 
 	for (i = 0; i < num_rules; i++) {
 		if (!(rule = apol_vector_get_element(v, i)))
 			break;
+		if (opt->out) {
+			if (record_range_rule(policy, opt->out, rule))
+				break;
+			continue;
+		}
 		if (!(tmp = apol_range_trans_render(policy, rule)))
 			break;
 		fprintf(stdout, "   %s\n", tmp);
@@ -960,10 +1402,364 @@ static void print_range_results(const apol_policy_t * policy, const options_t *
 	}
 }
 
+static void options_fini(options_t * opt)
+{
+	free(opt->src_name);
+	free(opt->tgt_name);
+	free(opt->default_name);
+	free(opt->class_name);
+	free(opt->permlist);
+	free(opt->bool_name);
+	free(opt->src_role_name);
+	free(opt->tgt_role_name);
+	free(opt->query_id);
+	apol_vector_destroy(&opt->perm_vector);
+	apol_vector_destroy(&opt->class_vector);
+}
+
+static void options_free(void *elem)
+{
+	options_t *opt = elem;
+	if (opt != NULL) {
+		options_fini(opt);
+		free(opt);
+	}
+}
+
+/**
+ * If regular expressions are in use, replace the options' class name
+ * with the list of classes that it matches.
+ */
+static int expand_class_regex(const apol_policy_t * policy, options_t * opt)
+{
+	apol_vector_t *qpol_matching_classes = NULL;
+	apol_class_query_t *regex_match_query = NULL;
+	const qpol_class_t *class = NULL;
+	const char *class_name;
+
+	if (!opt->useregex || opt->class_name == NULL)
+		return 0;
+	if ((opt->class_vector = apol_vector_create(NULL)) == NULL || (regex_match_query = apol_class_query_create()) == NULL) {
+		ERR(policy, "%s", strerror(ENOMEM));
+		return -1;
+	}
+	apol_class_query_set_regex(policy, regex_match_query, 1);
+	apol_class_query_set_class(policy, regex_match_query, opt->class_name);
+	if (apol_class_get_by_query(policy, regex_match_query, &qpol_matching_classes)) {
+		apol_class_query_destroy(&regex_match_query);
+		return -1;
+	}
+	for (size_t i = 0; i < apol_vector_get_size(qpol_matching_classes); ++i) {
+		class = apol_vector_get_element(qpol_matching_classes, i);
+		if (!class)
+			break;
+		qpol_class_get_name(apol_policy_get_qpol(policy), class, &class_name);
+		apol_vector_append(opt->class_vector, (void *)class_name);
+	}
+	if (!apol_vector_get_size(qpol_matching_classes)) {
+		apol_vector_destroy(&qpol_matching_classes);
+		apol_class_query_destroy(&regex_match_query);
+		ERR(policy, "No classes match expression %s", opt->class_name);
+		return -1;
+	}
+	apol_vector_destroy(&qpol_matching_classes);
+	apol_class_query_destroy(&regex_match_query);
+	return 0;
+}
+
+/**
+ * Parse one line of a batch file, of the form "NAME OPTION...", into
+ * a query.  Options that apply to the whole run (-S, -C, -n, and
+ * --format) come from the command line; -d and -R may be given on
+ * either.
+ *
+ * @return 0 on success, > 0 if the line is blank or a comment, or < 0
+ * on error.
+ */
+static int batch_parse_line(const char *file, size_t lineno, char *line, const options_t * global, options_t ** query)
+{
+	apol_vector_t *tokens = NULL;
+	options_t *opt = NULL;
+	char **args = NULL, *tok, **field;
+	size_t i, num_args;
+	int optc, retval = -1;
+
+	*query = NULL;
+	if ((tok = strchr(line, '#')) != NULL)
+		*tok = '\0';
+	if ((tokens = apol_vector_create(NULL)) == NULL)
+		goto cleanup;
+	for (tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+		if (apol_vector_append(tokens, tok) < 0)
+			goto cleanup;
+	}
+	if ((num_args = apol_vector_get_size(tokens)) == 0) {
+		retval = 1;
+		goto cleanup;
+	}
+
+	/* build an argument list for getopt_long(), using the query's
+	 * name in place of the program name */
+	if ((args = calloc(num_args + 1, sizeof(*args))) == NULL || (opt = calloc(1, sizeof(*opt))) == NULL)
+		goto cleanup;
+	for (i = 0; i < num_args; i++)
+		args[i] = apol_vector_get_element(tokens, i);
+	opt->indirect = global->indirect;
+	opt->useregex = global->useregex;
+	opt->show_cond = global->show_cond;
+	if ((opt->query_id = strdup(args[0])) == NULL)
+		goto cleanup;
+
+	optind = 0;
+	opterr = 0;
+	while ((optc = getopt_long((int)num_args, args, ":ATs:t:c:p:b:dD:R", longopts, NULL)) != -1) {
+		field = NULL;
+		switch (optc) {
+		case 's':
+			field = &opt->src_name;
+			break;
+		case 't':
+			field = &opt->tgt_name;
+			break;
+		case 'D':
+			field = &opt->default_name;
+			break;
+		case 'c':
+			field = &opt->class_name;
+			break;
+		case 'b':
+			field = &opt->bool_name;
+			break;
+		case 'p':
+			field = &opt->permlist;
+			if (opt->perm_vector == NULL && (opt->perm_vector = apol_vector_create(free)) == NULL)
+				goto cleanup;
+			break;
+		case 'd':
+			opt->indirect = false;
+			break;
+		case 'R':
+			opt->useregex = true;
+			break;
+		case 'A':
+			opt->allow = true;
+			break;
+		case RULE_NEVERALLOW:
+			opt->nallow = true;
+			break;
+		case RULE_AUDITALLOW:
+			opt->auditallow = true;
+			break;
+		case RULE_DONTAUDIT:
+			opt->dontaudit = true;
+			break;
+		case 'T':
+			opt->type = true;
+			break;
+		case RULE_ALL:
+			opt->all = true;
+			break;
+		case ':':
+			fprintf(stderr, "%s:%zu: Missing argument for %s.\n", file, lineno, args[optind - 1]);
+			errno = EINVAL;
+			goto cleanup;
+		default:
+			fprintf(stderr, "%s:%zu: Option %s is not allowed within a batch query.\n", file, lineno,
+				args[optind - 1]);
+			errno = EINVAL;
+			goto cleanup;
+		}
+		if (field != NULL) {
+			free(*field);
+			if ((*field = strdup(optarg)) == NULL)
+				goto cleanup;
+		}
+	}
+	if (optind < (int)num_args) {
+		fprintf(stderr, "%s:%zu: Unexpected argument %s.\n", file, lineno, args[optind]);
+		errno = EINVAL;
+		goto cleanup;
+	}
+	if (!(opt->allow || opt->nallow || opt->auditallow || opt->dontaudit || opt->type || opt->all)) {
+		fprintf(stderr, "%s:%zu: One of --all, --allow, --neverallow, --auditallow, --dontaudit,\n"
+			"or --type must be specified.\n", file, lineno);
+		errno = EINVAL;
+		goto cleanup;
+	}
+	*query = opt;
+	opt = NULL;
+	retval = 0;
+      cleanup:
+	if (retval < 0 && errno != EINVAL)
+		fprintf(stderr, "%s:%zu: %s\n", file, lineno, strerror(errno));
+	options_free(opt);
+	free(args);
+	apol_vector_destroy(&tokens);
+	return retval;
+}
+
+/**
+ * Read every query within a batch file.
+ *
+ * @return A vector of options_t, or NULL upon error.
+ */
+static apol_vector_t *batch_read(const char *file, const options_t * global)
+{
+	FILE *fp;
+	apol_vector_t *queries = NULL;
+	options_t *query = NULL;
+	char *line = NULL;
+	size_t line_len = 0, lineno = 0;
+	int retv, error = 0;
+
+	if ((fp = fopen(file, "r")) == NULL) {
+		fprintf(stderr, "Could not open %s: %s\n", file, strerror(errno));
+		return NULL;
+	}
+	if ((queries = apol_vector_create(options_free)) == NULL) {
+		error = errno;
+		fprintf(stderr, "%s\n", strerror(error));
+		goto cleanup;
+	}
+	while (getline(&line, &line_len, fp) >= 0) {
+		lineno++;
+		if ((retv = batch_parse_line(file, lineno, line, global, &query)) < 0) {
+			error = errno;
+			goto cleanup;
+		}
+		if (retv > 0)
+			continue;
+		if (apol_vector_append(queries, query) < 0) {
+			error = errno;
+			options_free(query);
+			fprintf(stderr, "%s\n", strerror(error));
+			goto cleanup;
+		}
+	}
+	if (ferror(fp)) {
+		error = errno;
+		fprintf(stderr, "Could not read %s: %s\n", file, strerror(error));
+	}
+      cleanup:
+	fclose(fp);
+	free(line);
+	if (error != 0) {
+		apol_vector_destroy(&queries);
+		errno = error;
+	}
+	return queries;
+}
+
+/**
+ * Callback state for batched semantic searches.  The n-th query
+ * within each batch is described by the n-th options within the
+ * matching vector.
+ */
+typedef struct batch_state
+{
+	print_state_t print;
+	apol_vector_t *av_opts, *te_opts;
+} batch_state_t;
+
+static int batch_av_rule(void *arg, const apol_policy_t * policy, size_t query_id, const qpol_avrule_t * rule)
+{
+	batch_state_t *s = (batch_state_t *) arg;
+	s->print.opt = apol_vector_get_element(s->av_opts, query_id);
+	return print_av_rule(&s->print, policy, rule);
+}
+
+static int batch_te_rule(void *arg, const apol_policy_t * policy, size_t query_id, const qpol_terule_t * rule)
+{
+	batch_state_t *s = (batch_state_t *) arg;
+	s->print.opt = apol_vector_get_element(s->te_opts, query_id);
+	return print_te_rule(&s->print, policy, rule);
+}
+
+/**
+ * Run every query within a batch.  Semantic searches are gathered
+ * into one batch per rule kind, so that the policy's rules are walked
+ * once regardless of the number of queries; syntactic searches are
+ * run one query after another against the same loaded policy.
+ */
+static int perform_batch(const apol_policy_t * policy, const options_t * global, apol_vector_t * queries)
+{
+	batch_state_t state;
+	apol_avrule_batch_t *avb = NULL;
+	apol_terule_batch_t *teb = NULL;
+	apol_avrule_query_t *avq = NULL;
+	apol_terule_query_t *teq = NULL;
+	apol_vector_t *v = NULL;
+	options_t *opt;
+	size_t i;
+	int retval = -1;
+
+	memset(&state, 0, sizeof(state));
+	for (i = 0; i < apol_vector_get_size(queries); i++) {
+		opt = apol_vector_get_element(queries, i);
+		opt->semantic = global->semantic;
+		opt->lineno = global->lineno;
+		opt->out = global->out;
+		if (expand_class_regex(policy, opt))
+			return -1;
+	}
+
+	/* syntactic rules cannot be batched; without them (as in a binary
+	 * policy) the search is semantic even if -S was not given */
+	if (!global->semantic && qpol_policy_has_capability(apol_policy_get_qpol(policy), QPOL_CAP_SYN_RULES)) {
+		for (i = 0; i < apol_vector_get_size(queries); i++) {
+			opt = apol_vector_get_element(queries, i);
+			if (perform_av_query(policy, opt, &v))
+				return -1;
+			print_syn_av_results(policy, opt, v);
+			apol_vector_destroy(&v);
+			if (perform_te_query(policy, opt, &v))
+				return -1;
+			print_syn_te_results(policy, opt, v);
+			apol_vector_destroy(&v);
+		}
+		return 0;
+	}
+
+	if ((avb = apol_avrule_batch_create(policy)) == NULL || (teb = apol_terule_batch_create(policy)) == NULL ||
+	    (state.av_opts = apol_vector_create(NULL)) == NULL || (state.te_opts = apol_vector_create(NULL)) == NULL) {
+		ERR(policy, "%s", strerror(errno));
+		goto cleanup;
+	}
+	for (i = 0; i < apol_vector_get_size(queries); i++) {
+		opt = apol_vector_get_element(queries, i);
+		if (create_av_query(policy, opt, &avq) || create_te_query(policy, opt, &teq))
+			goto cleanup;
+		if (avq != NULL && (apol_avrule_batch_append(avb, avq) < 0 || apol_vector_append(state.av_opts, opt) < 0))
+			goto cleanup;
+		if (teq != NULL && (apol_terule_batch_append(teb, teq) < 0 || apol_vector_append(state.te_opts, opt) < 0))
+			goto cleanup;
+		apol_avrule_query_destroy(&avq);
+		apol_terule_query_destroy(&teq);
+	}
+	if (apol_avrule_batch_get_size(avb) > 0 && apol_avrule_batch_run(avb, batch_av_rule, &state))
+		goto cleanup;
+	if (apol_terule_batch_get_size(teb) > 0 && apol_terule_batch_run(teb, batch_te_rule, &state))
+		goto cleanup;
+	retval = 0;
+      cleanup:
+	print_state_fini(&state.print);
+	apol_avrule_query_destroy(&avq);
+	apol_terule_query_destroy(&teq);
+	apol_avrule_batch_destroy(&avb);
+	apol_terule_batch_destroy(&teb);
+	apol_vector_destroy(&state.av_opts);
+	apol_vector_destroy(&state.te_opts);
+	return retval;
+}
+
 int main(int argc, char **argv)
 {
 	options_t cmd_opts;
 	int optc, rt = -1;
+	record_format_e format = RECORD_FORMAT_TEXT;
+	record_writer_t writer;
+	const char *batch_file = NULL;
+	apol_vector_t *queries = NULL;
 
 	apol_policy_t *policy = NULL;
 	apol_vector_t *v = NULL;
@@ -1120,6 +1916,16 @@ int main(int argc, char **argv)
 		case 'C':
 			cmd_opts.show_cond = true;
 			break;
+		case OPT_FORMAT:
+			if (record_format_from_str(optarg, &format)) {
+				usage(argv[0], 1);
+				fprintf(stderr, "Unknown output format %s.\n", optarg);
+				exit(1);
+			}
+			break;
+		case OPT_BATCH:
+			batch_file = optarg;
+			break;
 		case 'h':	       /* help */
 			usage(argv[0], 0);
 			exit(0);
@@ -1132,17 +1938,38 @@ int main(int argc, char **argv)
 		}
 	}
 
-	if (!(cmd_opts.allow || cmd_opts.nallow || cmd_opts.auditallow || cmd_opts.dontaudit || cmd_opts.role_allow ||
-	      cmd_opts.type || cmd_opts.rtrans || cmd_opts.role_trans || cmd_opts.all)) {
-		usage(argv[0], 1);
-		fprintf(stderr, "One of --all, --allow, --neverallow, --auditallow, --dontaudit,\n"
-			"--range_trans, --type, --role_allow, or --role_trans must be specified.\n");
-		exit(1);
-	}
-
 	int pol_opt = 0;
-	if (!(cmd_opts.nallow || cmd_opts.all))
+	if (batch_file != NULL) {
+		if (cmd_opts.allow || cmd_opts.nallow || cmd_opts.auditallow || cmd_opts.dontaudit || cmd_opts.role_allow ||
+		    cmd_opts.type || cmd_opts.rtrans || cmd_opts.role_trans || cmd_opts.all || cmd_opts.src_name ||
+		    cmd_opts.tgt_name || cmd_opts.default_name || cmd_opts.src_role_name || cmd_opts.tgt_role_name ||
+		    cmd_opts.class_name || cmd_opts.permlist || cmd_opts.bool_name) {
+			usage(argv[0], 1);
+			fprintf(stderr, "Rule types and expressions must be given within the batch file.\n");
+			exit(1);
+		}
+		/* getopt_long() is reused to parse each query */
+		int first_arg = optind;
+		if ((queries = batch_read(batch_file, &cmd_opts)) == NULL)
+			exit(1);
+		optind = first_arg;
 		pol_opt |= QPOL_POLICY_OPTION_NO_NEVERALLOWS;
+		for (size_t i = 0; i < apol_vector_get_size(queries); i++) {
+			options_t *q = apol_vector_get_element(queries, i);
+			if (q->nallow || q->all)
+				pol_opt &= ~QPOL_POLICY_OPTION_NO_NEVERALLOWS;
+		}
+	} else {
+		if (!(cmd_opts.allow || cmd_opts.nallow || cmd_opts.auditallow || cmd_opts.dontaudit || cmd_opts.role_allow ||
+		      cmd_opts.type || cmd_opts.rtrans || cmd_opts.role_trans || cmd_opts.all)) {
+			usage(argv[0], 1);
+			fprintf(stderr, "One of --all, --allow, --neverallow, --auditallow, --dontaudit,\n"
+				"--range_trans, --type, --role_allow, or --role_trans must be specified.\n");
+			exit(1);
+		}
+		if (!(cmd_opts.nallow || cmd_opts.all))
+			pol_opt |= QPOL_POLICY_OPTION_NO_NEVERALLOWS;
+	}
 
 	if (argc - optind < 1) {
 		rt = qpol_default_policy_find(&policy_file);
@@ -1203,37 +2030,16 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 	/* handle regex for class name */
-	if (cmd_opts.useregex && cmd_opts.class_name != NULL) {
-		cmd_opts.class_vector = apol_vector_create(NULL);
-		apol_vector_t *qpol_matching_classes = NULL;
-		apol_class_query_t *regex_match_query = apol_class_query_create();
-		apol_class_query_set_regex(policy, regex_match_query, 1);
-		apol_class_query_set_class(policy, regex_match_query, cmd_opts.class_name);
-		if (apol_class_get_by_query(policy, regex_match_query, &qpol_matching_classes)) {
-			apol_class_query_destroy(&regex_match_query);
-			goto cleanup;
-		}
-		const qpol_class_t *class = NULL;
-		for (size_t i = 0; i < apol_vector_get_size(qpol_matching_classes); ++i) {
-			const char *class_name;
-			class = apol_vector_get_element(qpol_matching_classes, i);
-			if (!class)
-				break;
-			qpol_class_get_name(apol_policy_get_qpol(policy), class, &class_name);
-			apol_vector_append(cmd_opts.class_vector, (void *)class_name);
-		}
-		if (!apol_vector_get_size(qpol_matching_classes)) {
-			apol_vector_destroy(&qpol_matching_classes);
-			apol_class_query_destroy(&regex_match_query);
-			ERR(policy, "No classes match expression %s", cmd_opts.class_name);
-			goto cleanup;
-		}
-		apol_vector_destroy(&qpol_matching_classes);
-		apol_class_query_destroy(&regex_match_query);
-	}
+	if (expand_class_regex(policy, &cmd_opts))
+		goto cleanup;
 
 	if (!cmd_opts.semantic && qpol_policy_has_capability(apol_policy_get_qpol(policy), QPOL_CAP_SYN_RULES)) {
-		if (qpol_policy_build_syn_rule_table(apol_policy_get_qpol(policy))) {
+		/* a query naming a type traces back few rules, so find
+		 * their syntactic rules on demand rather than building
+		 * the whole table */
+		int narrow = (batch_file == NULL && (cmd_opts.src_name != NULL || cmd_opts.tgt_name != NULL));
+		if ((narrow ? qpol_policy_build_syn_rule_index(apol_policy_get_qpol(policy)) :
+		     qpol_policy_build_syn_rule_table(apol_policy_get_qpol(policy)))) {
 			apol_policy_destroy(&policy);
 			exit(1);
 		}
@@ -1249,16 +2055,26 @@ int main(int argc, char **argv)
 		cmd_opts.lineno = 0;
 	}
 
+	if (format != RECORD_FORMAT_TEXT) {
+		/* only batched results are tagged with their query */
+		record_writer_init(&writer, stdout, format, rule_columns, (queries != NULL ? NUM_COLUMNS : COL_QUERY));
+		cmd_opts.out = &writer;
+	}
+
+	if (queries != NULL) {
+		rt = (perform_batch(policy, &cmd_opts, queries) ? 1 : 0);
+		goto cleanup;
+	}
+
 	if (perform_av_query(policy, &cmd_opts, &v)) {
 		rt = 1;
 		goto cleanup;
 	}
+	/* semantic results have already been printed */
 	if (v) {
-		if (!cmd_opts.semantic && qpol_policy_has_capability(apol_policy_get_qpol(policy), QPOL_CAP_SYN_RULES))
-			print_syn_av_results(policy, &cmd_opts, v);
-		else
-			print_av_results(policy, &cmd_opts, v);
-		fprintf(stdout, "\n");
+		print_syn_av_results(policy, &cmd_opts, v);
+		if (!cmd_opts.out)
+			fprintf(stdout, "\n");
 	}
 	apol_vector_destroy(&v);
 	if (perform_te_query(policy, &cmd_opts, &v)) {
@@ -1266,11 +2082,9 @@ int main(int argc, char **argv)
 		goto cleanup;
 	}
 	if (v) {
-		if (!cmd_opts.semantic && qpol_policy_has_capability(apol_policy_get_qpol(policy), QPOL_CAP_SYN_RULES))
-			print_syn_te_results(policy, &cmd_opts, v);
-		else
-			print_te_results(policy, &cmd_opts, v);
-		fprintf(stdout, "\n");
+		print_syn_te_results(policy, &cmd_opts, v);
+		if (!cmd_opts.out)
+			fprintf(stdout, "\n");
 	}
 
 	apol_vector_destroy(&v);
@@ -1280,7 +2094,8 @@ int main(int argc, char **argv)
 	}
 	if (v) {
 		print_ft_results(policy, &cmd_opts, v);
-		fprintf(stdout, "\n");
+		if (!cmd_opts.out)
+			fprintf(stdout, "\n");
 	}
 
 	apol_vector_destroy(&v);
@@ -1290,7 +2105,8 @@ int main(int argc, char **argv)
 	}
 	if (v) {
 		print_ra_results(policy, &cmd_opts, v);
-		fprintf(stdout, "\n");
+		if (!cmd_opts.out)
+			fprintf(stdout, "\n");
 	}
 	apol_vector_destroy(&v);
 	if (perform_rt_query(policy, &cmd_opts, &v)) {
@@ -1299,7 +2115,8 @@ int main(int argc, char **argv)
 	}
 	if (v) {
 		print_rt_results(policy, &cmd_opts, v);
-		fprintf(stdout, "\n");
+		if (!cmd_opts.out)
+			fprintf(stdout, "\n");
 	}
 	apol_vector_destroy(&v);
 	if (perform_range_query(policy, &cmd_opts, &v)) {
@@ -1308,22 +2125,17 @@ int main(int argc, char **argv)
 	}
 	if (v) {
 		print_range_results(policy, &cmd_opts, v);
-		fprintf(stdout, "\n");
+		if (!cmd_opts.out)
+			fprintf(stdout, "\n");
 	}
 	apol_vector_destroy(&v);
 	rt = 0;
       cleanup:
+	if (cmd_opts.out)
+		record_writer_finish(cmd_opts.out);
 	apol_policy_destroy(&policy);
 	apol_policy_path_destroy(&pol_path);
-	free(cmd_opts.src_name);
-	free(cmd_opts.tgt_name);
-	free(cmd_opts.default_name);
-	free(cmd_opts.class_name);
-	free(cmd_opts.permlist);
-	free(cmd_opts.bool_name);
-	free(cmd_opts.src_role_name);
-	free(cmd_opts.tgt_role_name);
-	apol_vector_destroy(&cmd_opts.perm_vector);
-	apol_vector_destroy(&cmd_opts.class_vector);
+	options_fini(&cmd_opts);
+	apol_vector_destroy(&queries);
 	exit(rt);
 }